@@ -17,8 +17,25 @@
 #include "pstorage.h"
 #include "fstorage.h"
 #include "sdk_common.h"
+#include "ble_hci.h"
+#include "app_timer.h"
+
+#define APP_TIMER_PRESCALER            0                   /**< Value of the RTC1 PRESCALER register, as set by the application. */
+#define BLE_ADV_PEER_COUNT             2                   /**< Peripheral links whose peer is tracked for directed advertising. */
+#define BLE_ADV_DIRECTED_EVENT_US      3750                /**< Longest time between high duty cycle directed advertising events. */
+#define BLE_ADV_LEARN_SHIFT            2                   /**< Weight of a new reconnection time in the learned one, as a power of two. */
+
+/**@brief Peer of a peripheral link. */
+typedef struct
+{
+    uint16_t       conn_handle;                            /**< Link of the peer, or BLE_CONN_HANDLE_INVALID. */
+    bool           bonded;                                 /**< The link was encrypted with a bonded key. */
+    ble_gap_addr_t addr;                                   /**< Address of the peer on this link. */
+} ble_adv_peer_t;
 
 static ble_gap_addr_t                  m_peer_address;     /**< Address of the most recently connected peer, used for direct advertising. */
+static bool                            m_peer_valid;       /**< m_peer_address is a bonded peer that disconnected unexpectedly, and not a resolvable private address. */
+static ble_adv_peer_t                  m_peers[BLE_ADV_PEER_COUNT];                /**< Peers of the connected links. */
 static ble_advdata_t                   m_advdata;          /**< Used by the initialization function to set name, appearance, and UUIDs and advertising flags visible to peer devices. */
 static ble_advdata_manuf_data_t        m_manuf_specific_data;                      /**< Manufacturer specific data structure*/
 static uint8_t                         m_manuf_data_array[BLE_GAP_ADV_MAX_SIZE];   /**< Array to store the Manufacturer specific data*/
@@ -27,6 +44,27 @@ static uint8_t                         m_service_data_array[BLE_GAP_ADV_MAX_SIZE
 static ble_advdata_conn_int_t          m_slave_conn_int;                           /**< Connection interval range structure.*/
 static int8_t                          m_tx_power_level;                           /**< TX power level*/
 
+static ble_adv_modes_config_t          m_config;                                   /**< Advertising modes and intervals. */
+static ble_advertising_evt_handler_t   m_evt_handler;                              /**< Handler for the advertising events. */
+static ble_advertising_error_handler_t m_error_handler;                            /**< Handler for the errors in the event handler, or NULL. */
+
+static ble_adv_evt_t                   m_stage = BLE_ADV_EVT_IDLE;                 /**< Current advertising stage. */
+static uint32_t                        m_stage_tick;                               /**< RTC1 counter when the current stage started. */
+static uint16_t                        m_slow_interval;                            /**< Interval of the current slow advertising stage. */
+static bool                            m_idle;                                     /**< Slow advertising is stretched to BLE_ADV_IDLE_INTERVAL. */
+
+static bool                            m_reconnecting;                             /**< A bonded peer disconnected unexpectedly and has not reconnected. */
+static bool                            m_reconnect_restart;                        /**< The reconnection stages have not been started for that disconnect yet. */
+static uint32_t                        m_reconnect_ms;                             /**< Time since the unexpected disconnect, up to the start of the current stage. */
+static uint32_t                        m_reconnect_charge_uc;                      /**< Charge spent since the unexpected disconnect, up to the start of the current stage. */
+
+static bool                            m_whitelist_requested;                      /**< The whitelist was requested and not set yet. */
+static ble_gap_whitelist_t             m_whitelist;                                /**< Whitelist used by the whitelist stage. */
+static ble_gap_addr_t                * mp_whitelist_addr[BLE_GAP_WHITELIST_ADDR_MAX_COUNT];
+static ble_gap_irk_t                 * mp_whitelist_irk[BLE_GAP_WHITELIST_IRK_MAX_COUNT];
+
+static ble_adv_stats_t                 m_stats;                                    /**< Reconnection and charge statistics. */
+
 ble_gap_adv_params_t g_adv_params;
 
 /**@brief Function for setting the stored peer address back to zero.
@@ -34,11 +72,373 @@ ble_gap_adv_params_t g_adv_params;
 static void ble_advertising_peer_address_clear()
 {
     memset(&m_peer_address, 0, sizeof(m_peer_address));
+    m_peer_valid = false;
+}
+
+
+/**@brief Function for reporting an error to the application.
+ */
+static void adv_error(uint32_t err_code)
+{
+    if (err_code == NRF_SUCCESS)
+    {
+        return;
+    }
+    if (m_error_handler != NULL)
+    {
+        m_error_handler(err_code);
+    }
+    else
+    {
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+
+static uint32_t adv_ms_since(uint32_t tick)
+{
+    uint32_t now;
+    uint32_t diff;
+
+    (void)app_timer_cnt_get(&now);
+    (void)app_timer_cnt_diff_compute(now, tick, &diff);
+    return (uint32_t)(((uint64_t)diff * 1000 * (APP_TIMER_PRESCALER + 1)) / APP_TIMER_CLOCK_FREQ);
+}
+
+
+static ble_adv_peer_t * adv_peer_get(uint16_t conn_handle)
+{
+    for (uint32_t i = 0; i < BLE_ADV_PEER_COUNT; i++)
+    {
+        if (m_peers[i].conn_handle == conn_handle)
+        {
+            return &m_peers[i];
+        }
+    }
+    return NULL;
+}
+
+
+/**@brief Function for estimating the charge of advertising for elapsed_ms in the current stage, in uC.
+ */
+static uint32_t adv_stage_charge(uint32_t elapsed_ms)
+{
+    uint32_t events;
+
+    if (m_stage == BLE_ADV_EVT_DIRECTED)
+    {
+        events = (elapsed_ms * 1000) / BLE_ADV_DIRECTED_EVENT_US;
+        return (events * BLE_ADV_DIRECTED_EVENT_CHARGE_NC) / 1000;
+    }
+
+    events = (elapsed_ms * 1000) / ((uint32_t)g_adv_params.interval * 625);
+    return (events * BLE_ADV_EVENT_CHARGE_NC) / 1000;
+}
+
+
+/**@brief Function for adding the time and the charge of the current stage to the statistics.
+ *
+ * @details Every stage has a time-out well within the range of the RTC1 counter, so the
+ *          elapsed time does not wrap.
+ */
+static void adv_stage_account(void)
+{
+    uint32_t elapsed_ms;
+    uint32_t charge_uc;
+
+    if (m_stage == BLE_ADV_EVT_IDLE)
+    {
+        return;
+    }
+
+    elapsed_ms = adv_ms_since(m_stage_tick);
+    charge_uc  = adv_stage_charge(elapsed_ms);
+
+    m_stats.stage_ms[m_stage]        += elapsed_ms;
+    m_stats.stage_charge_uc[m_stage] += charge_uc;
+
+    if (m_reconnecting)
+    {
+        m_reconnect_ms        += elapsed_ms;
+        m_reconnect_charge_uc += charge_uc;
+    }
+}
+
+
+/**@brief Function for choosing the stage that follows a stage.
+ */
+static ble_adv_evt_t adv_stage_next(ble_adv_evt_t stage)
+{
+    switch (stage)
+    {
+        case BLE_ADV_EVT_IDLE:
+            if (m_reconnecting && m_peer_valid && m_config.ble_adv_directed_enabled)
+            {
+                return BLE_ADV_EVT_DIRECTED;
+            }
+            // Fall through.
+
+        case BLE_ADV_EVT_DIRECTED:
+            if (m_reconnecting && m_config.ble_adv_whitelist_enabled)
+            {
+                return BLE_ADV_EVT_FAST_WHITELIST;
+            }
+            // Fall through.
+
+        case BLE_ADV_EVT_FAST_WHITELIST:
+            // A peer that did not come back in time may have been replaced by another phone.
+            if (m_config.ble_adv_fast_enabled)
+            {
+                return BLE_ADV_EVT_FAST;
+            }
+            // Fall through.
+
+        default:
+            return m_config.ble_adv_slow_enabled ? BLE_ADV_EVT_SLOW : BLE_ADV_EVT_IDLE;
+    }
+}
+
+
+/**@brief Function for getting the length of the whitelist stage, in seconds.
+ *
+ * @details Twice the learned reconnection time: long enough for the peer to come back in most
+ *          cases, short enough not to lock out other phones for long when it does not.
+ */
+static uint16_t adv_whitelist_timeout(void)
+{
+    uint32_t timeout;
+
+    if (m_stats.learned_reconnect_ms == 0)
+    {
+        return BLE_ADV_WHITELIST_TIMEOUT_INIT;
+    }
+
+    timeout = (2 * m_stats.learned_reconnect_ms + 999) / 1000;
+    if (timeout < BLE_ADV_WHITELIST_TIMEOUT_MIN)
+    {
+        timeout = BLE_ADV_WHITELIST_TIMEOUT_MIN;
+    }
+    if (timeout > BLE_ADV_WHITELIST_TIMEOUT_MAX)
+    {
+        timeout = BLE_ADV_WHITELIST_TIMEOUT_MAX;
+    }
+    return (uint16_t)timeout;
+}
+
+
+/**@brief Function for setting the advertising parameters of a stage.
+ *
+ * @return  false if the stage cannot run and must be skipped.
+ */
+static bool adv_stage_params_set(ble_adv_evt_t stage)
+{
+    g_adv_params.type        = BLE_GAP_ADV_TYPE_ADV_IND;
+    g_adv_params.p_peer_addr = NULL;
+    g_adv_params.fp          = BLE_GAP_ADV_FP_ANY;
+    g_adv_params.p_whitelist = NULL;
+
+    switch (stage)
+    {
+        case BLE_ADV_EVT_DIRECTED:
+            // High duty cycle: the SoftDevice ends it after 1.28 s.
+            g_adv_params.type        = BLE_GAP_ADV_TYPE_ADV_DIRECT_IND;
+            g_adv_params.p_peer_addr = &m_peer_address;
+            g_adv_params.interval    = 0;
+            g_adv_params.timeout     = 0;
+            return true;
+
+        case BLE_ADV_EVT_FAST_WHITELIST:
+            m_whitelist.addr_count = 0;
+            m_whitelist.irk_count  = 0;
+            m_whitelist_requested  = true;
+            if (m_evt_handler != NULL)
+            {
+                m_evt_handler(BLE_ADV_EVT_WHITELIST_REQUEST);
+            }
+            m_whitelist_requested = false;
+            if ((m_whitelist.addr_count == 0) && (m_whitelist.irk_count == 0))
+            {
+                return false;
+            }
+            // Scan requests stay open, so the phone app can still find the device.
+            g_adv_params.fp          = BLE_GAP_ADV_FP_FILTER_CONNREQ;
+            g_adv_params.p_whitelist = &m_whitelist;
+            g_adv_params.interval    = m_config.ble_adv_fast_interval;
+            g_adv_params.timeout     = adv_whitelist_timeout();
+            return true;
+
+        case BLE_ADV_EVT_FAST:
+            g_adv_params.interval = m_config.ble_adv_fast_interval;
+            g_adv_params.timeout  = m_config.ble_adv_fast_timeout;
+            return true;
+
+        case BLE_ADV_EVT_SLOW:
+            if (m_idle)
+            {
+                // m_slow_interval is kept, so the configured interval comes back without stepping.
+                g_adv_params.interval = BLE_ADV_IDLE_INTERVAL;
+                g_adv_params.timeout  = BLE_GAP_ADV_TIMEOUT_LIMITED_MAX;
+                return true;
+            }
+            if (m_stage != BLE_ADV_EVT_SLOW)
+            {
+                m_slow_interval = m_config.ble_adv_fast_interval;
+            }
+            m_slow_interval = MIN(2 * m_slow_interval, m_config.ble_adv_slow_interval);
+            g_adv_params.interval = m_slow_interval;
+            if (m_slow_interval < m_config.ble_adv_slow_interval)
+            {
+                g_adv_params.timeout = BLE_ADV_SLOW_STEP_TIMEOUT;
+            }
+            else if (m_config.ble_adv_slow_timeout != 0)
+            {
+                g_adv_params.timeout = m_config.ble_adv_slow_timeout;
+            }
+            else
+            {
+                // Restarted on time-out, so the statistics stay within the range of RTC1.
+                g_adv_params.timeout = BLE_GAP_ADV_TIMEOUT_LIMITED_MAX;
+            }
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+
+/**@brief Function for starting the first stage that can run, from a given stage on.
+ */
+static void adv_stage_start(ble_adv_evt_t stage)
+{
+    uint32_t err_code;
+
+    while ((stage != BLE_ADV_EVT_IDLE) && !adv_stage_params_set(stage))
+    {
+        stage = adv_stage_next(stage);
+    }
+
+    m_stage = stage;
+    if (stage == BLE_ADV_EVT_IDLE)
+    {
+        if (m_evt_handler != NULL)
+        {
+            m_evt_handler(BLE_ADV_EVT_IDLE);
+        }
+        return;
+    }
+
+    (void)app_timer_cnt_get(&m_stage_tick);
+    err_code = sd_ble_gap_adv_start(&g_adv_params);
+    if (err_code != NRF_SUCCESS)
+    {
+        m_stage = BLE_ADV_EVT_IDLE;
+        adv_error(err_code);
+        return;
+    }
+
+    if (m_evt_handler != NULL)
+    {
+        m_evt_handler(stage);
+    }
 }
 
+
+static void on_connected(ble_evt_t const * p_ble_evt)
+{
+    ble_gap_evt_t const * p_gap_evt = &p_ble_evt->evt.gap_evt;
+    ble_adv_peer_t      * p_peer    = adv_peer_get(BLE_CONN_HANDLE_INVALID);
+    ble_adv_evt_t         stage     = m_stage;
+    uint32_t              sample;
+
+    if (p_peer != NULL)
+    {
+        p_peer->conn_handle = p_gap_evt->conn_handle;
+        p_peer->bonded      = false;
+        p_peer->addr        = p_gap_evt->params.connected.peer_addr;
+    }
+
+    // The SoftDevice stops advertising on connect.
+    adv_stage_account();
+    m_stage = BLE_ADV_EVT_IDLE;
+
+    if (!m_reconnecting)
+    {
+        return;
+    }
+    m_reconnecting      = false;
+    m_reconnect_restart = false;
+
+    m_stats.reconnects++;
+    // Summed per stage: the time since the disconnect itself can outrun the RTC1 counter.
+    m_stats.last_reconnect_ms        = m_reconnect_ms;
+    m_stats.last_reconnect_charge_uc = m_reconnect_charge_uc;
+    m_stats.last_reconnect_stage     = stage;
+
+    // A peer that only came back in slow advertising still stretches the whitelist stage.
+    sample = MIN(m_stats.last_reconnect_ms, BLE_ADV_WHITELIST_TIMEOUT_MAX * 1000 / 2);
+    if (m_stats.learned_reconnect_ms == 0)
+    {
+        m_stats.learned_reconnect_ms = sample;
+    }
+    else
+    {
+        m_stats.learned_reconnect_ms = (uint32_t)((int32_t)m_stats.learned_reconnect_ms +
+                                       (((int32_t)sample - (int32_t)m_stats.learned_reconnect_ms) >> BLE_ADV_LEARN_SHIFT));
+    }
+}
+
+
+static void on_disconnected(ble_evt_t const * p_ble_evt)
+{
+    ble_gap_evt_t const * p_gap_evt = &p_ble_evt->evt.gap_evt;
+    ble_adv_peer_t      * p_peer    = adv_peer_get(p_gap_evt->conn_handle);
+    uint8_t               reason    = p_gap_evt->params.disconnected.reason;
+
+    if (p_peer == NULL)
+    {
+        return;
+    }
+    p_peer->conn_handle = BLE_CONN_HANDLE_INVALID;
+
+    // A peer that leaves on purpose does not come back soon, so there is nobody to wait for.
+    if (!p_peer->bonded ||
+        (reason == BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION) ||
+        (reason == BLE_HCI_LOCAL_HOST_TERMINATED_CONNECTION))
+    {
+        return;
+    }
+
+    // A phone with a resolvable private address only answers directed advertising to its
+    // current address, which may have changed since the link was set up. The whitelist stage
+    // finds it by its IRK instead.
+    m_peer_address        = p_peer->addr;
+    m_peer_valid          = (p_peer->addr.addr_type != BLE_GAP_ADDR_TYPE_RANDOM_PRIVATE_RESOLVABLE);
+    m_reconnecting        = true;
+    m_reconnect_restart   = true;
+    m_reconnect_ms        = 0;
+    m_reconnect_charge_uc = 0;
+}
+
+
+static void on_timeout(ble_evt_t const * p_ble_evt)
+{
+    if ((p_ble_evt->evt.gap_evt.params.timeout.src != BLE_GAP_TIMEOUT_SRC_ADVERTISING) ||
+        (m_stage == BLE_ADV_EVT_IDLE))
+    {
+        return;
+    }
+
+    adv_stage_account();
+    adv_stage_start(adv_stage_next(m_stage));
+}
+
+
 uint32_t ble_advertising_init(ble_advdata_t const                 * p_advdata,
                               ble_advdata_t const                 * p_srdata,
-                              ble_adv_modes_config_t const        * p_config)
+                              ble_adv_modes_config_t const        * p_config,
+                              ble_advertising_evt_handler_t const   evt_handler,
+                              ble_advertising_error_handler_t const error_handler)
 {
     uint32_t err_code;
 
@@ -47,6 +447,22 @@ uint32_t ble_advertising_init(ble_advdata_t const                 * p_advdata,
 
     ble_advertising_peer_address_clear();
 
+    m_config        = *p_config;
+    m_evt_handler   = evt_handler;
+    m_error_handler = error_handler;
+    m_stage         = BLE_ADV_EVT_IDLE;
+    m_reconnecting  = false;
+    m_reconnect_restart = false;
+
+    m_whitelist.pp_addrs = mp_whitelist_addr;
+    m_whitelist.pp_irks  = mp_whitelist_irk;
+
+    memset(&m_stats, 0, sizeof(m_stats));
+    for (uint32_t i = 0; i < BLE_ADV_PEER_COUNT; i++)
+    {
+        m_peers[i].conn_handle = BLE_CONN_HANDLE_INVALID;
+    }
+
     // Copy and set advertising data.
     memset(&m_advdata, 0, sizeof(m_advdata));
 
@@ -133,19 +549,132 @@ void advertising_parm_configer(ble_gap_adv_params_t *adv_params)
 	g_adv_params.interval		= adv_params->interval;
 }
 
+void ble_advertising_on_ble_evt(ble_evt_t const * p_ble_evt)
+{
+    ble_adv_peer_t * p_peer;
+
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GAP_EVT_CONNECTED:
+            on_connected(p_ble_evt);
+            break;
+
+        case BLE_GAP_EVT_CONN_SEC_UPDATE:
+            // Encryption without pairing first means the peer is bonded.
+            p_peer = adv_peer_get(p_ble_evt->evt.gap_evt.conn_handle);
+            if ((p_peer != NULL) &&
+                (p_ble_evt->evt.gap_evt.params.conn_sec_update.conn_sec.sec_mode.lv >= 2))
+            {
+                p_peer->bonded = true;
+            }
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            on_disconnected(p_ble_evt);
+            break;
+
+        case BLE_GAP_EVT_TIMEOUT:
+            on_timeout(p_ble_evt);
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+uint32_t ble_advertising_whitelist_reply(ble_gap_whitelist_t * p_whitelist)
+{
+    VERIFY_PARAM_NOT_NULL(p_whitelist);
+
+    if (!m_whitelist_requested)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    m_whitelist.addr_count = MIN(p_whitelist->addr_count, BLE_GAP_WHITELIST_ADDR_MAX_COUNT);
+    m_whitelist.irk_count  = MIN(p_whitelist->irk_count, BLE_GAP_WHITELIST_IRK_MAX_COUNT);
+
+    for (uint32_t i = 0; i < m_whitelist.addr_count; i++)
+    {
+        mp_whitelist_addr[i] = p_whitelist->pp_addrs[i];
+    }
+    for (uint32_t i = 0; i < m_whitelist.irk_count; i++)
+    {
+        mp_whitelist_irk[i] = p_whitelist->pp_irks[i];
+    }
+
+    return NRF_SUCCESS;
+}
+
 void advertising_start(void)
 {
-	uint32_t err_code;
-	
-	err_code = sd_ble_gap_adv_start(&g_adv_params);
-    APP_ERROR_CHECK(err_code);
+    if (m_stage != BLE_ADV_EVT_IDLE)
+    {
+        // Only a peer that just dropped out is worth interrupting the current stage for.
+        if (!m_reconnect_restart)
+        {
+            return;
+        }
+        adv_stage_account();
+        m_stage = BLE_ADV_EVT_IDLE;
+        (void)sd_ble_gap_adv_stop();
+
+        // The stage that was cut short ran before the disconnect.
+        m_reconnect_ms        = 0;
+        m_reconnect_charge_uc = 0;
+    }
+
+    m_reconnect_restart = false;
+    adv_stage_start(adv_stage_next(BLE_ADV_EVT_IDLE));
 }
 
 void advertising_stop(void)
 {	
-	uint32_t err_code;
+    if (m_stage == BLE_ADV_EVT_IDLE)
+    {
+        return;
+    }
+
+    adv_stage_account();
+    m_stage = BLE_ADV_EVT_IDLE;
+    adv_error(sd_ble_gap_adv_stop());
+}
+
+void ble_advertising_idle_set(bool idle)
+{
+    if (idle == m_idle)
+    {
+        return;
+    }
 
-    err_code = sd_ble_gap_adv_stop();
-    APP_ERROR_CHECK(err_code);
+    m_idle = idle;
+    if (m_stage != BLE_ADV_EVT_SLOW)
+    {
+        return;
+    }
+
+    // m_stage stays BLE_ADV_EVT_SLOW, so the interval does not start over from the fast one.
+    adv_stage_account();
+    adv_error(sd_ble_gap_adv_stop());
+    adv_stage_start(BLE_ADV_EVT_SLOW);
+}
+
+ble_adv_evt_t ble_advertising_stage_get(void)
+{
+    return m_stage;
+}
+
+void ble_advertising_stats_get(ble_adv_stats_t * p_stats)
+{
+    uint32_t elapsed_ms;
+
+    *p_stats = m_stats;
+    if (m_stage != BLE_ADV_EVT_IDLE)
+    {
+        elapsed_ms = adv_ms_since(m_stage_tick);
+        p_stats->stage_ms[m_stage]        += elapsed_ms;
+        p_stats->stage_charge_uc[m_stage] += adv_stage_charge(elapsed_ms);
+    }
 }
 
@@ -22,10 +22,20 @@
  *           Your main application can react to changes in advertising modes
  *           if an event handler is provided.
  *
- * @note     The Advertising Module supports only applications with a single peripheral link.
+ * @details  Advertising runs as a sequence of stages. After an unexpected disconnect of a
+ *           bonded peer, the module tries to get that peer back first: a burst of high duty
+ *           cycle directed advertising to its address, then fast advertising that only accepts
+ *           connect requests from the whitelist, for about twice the time the peer usually takes
+ *           to reconnect. Directed advertising is skipped if the peer used a resolvable private
+ *           address. Otherwise, and after the whitelist stage, advertising runs in fast mode.
+ *           Fast advertising ends in slow advertising, whose interval doubles every
+ *           @ref BLE_ADV_SLOW_STEP_TIMEOUT seconds until it reaches the slow advertising interval.
+ *
+ * @note     With several peripheral links, the module advertises for the free links. The
+ *           application calls @ref advertising_start while a link is free.
  *
  * The application must propagate BLE stack events to this module by calling
- * @ref ble_advertising_on_ble_evt() and system events by calling
+ * @ref ble_advertising_on_ble_evt().
  *
  */
 
@@ -90,6 +100,35 @@ typedef struct
 }ble_adv_modes_config_t;
 
 
+#define BLE_ADV_STAGE_COUNT             (BLE_ADV_EVT_SLOW_WHITELIST + 1)    /**< Size of the arrays indexed by the event that starts an advertising stage. */
+
+#define BLE_ADV_SLOW_STEP_TIMEOUT       30      /**< Time (in seconds) spent at each slow advertising interval before it doubles. */
+#define BLE_ADV_IDLE_INTERVAL           0x4000  /**< Slow advertising interval while the device idles (in units of 0.625 ms, 10.24 s, the largest allowed). */
+#define BLE_ADV_WHITELIST_TIMEOUT_MIN   3       /**< Shortest whitelist stage after an unexpected disconnect, in seconds. */
+#define BLE_ADV_WHITELIST_TIMEOUT_MAX   30      /**< Longest whitelist stage after an unexpected disconnect, in seconds. */
+#define BLE_ADV_WHITELIST_TIMEOUT_INIT  10      /**< Whitelist stage used until a reconnection time has been learned, in seconds. */
+
+#define BLE_ADV_EVENT_CHARGE_NC         9000    /**< Estimated charge of one connectable undirected advertising event on three channels, in nC. */
+#define BLE_ADV_DIRECTED_EVENT_CHARGE_NC 2500   /**< Estimated charge of one high duty cycle directed advertising event, in nC. */
+
+
+/**@brief Advertising statistics.
+ *
+ * @details Charge is estimated from the time spent in each stage, the advertising interval and
+ *          @ref BLE_ADV_EVENT_CHARGE_NC or @ref BLE_ADV_DIRECTED_EVENT_CHARGE_NC.
+ */
+typedef struct
+{
+    uint32_t      reconnects;                           /**< Peers that reconnected after an unexpected disconnect. */
+    uint32_t      last_reconnect_ms;                    /**< Time from the last unexpected disconnect to the reconnection. */
+    uint32_t      last_reconnect_charge_uc;             /**< Advertising charge spent on the last reconnection, in uC. */
+    ble_adv_evt_t last_reconnect_stage;                 /**< Stage in which the peer last reconnected. */
+    uint32_t      learned_reconnect_ms;                 /**< Smoothed reconnection time, 0 until the first reconnection. */
+    uint32_t      stage_ms[BLE_ADV_STAGE_COUNT];        /**< Time spent in each stage, indexed by the event that starts it. */
+    uint32_t      stage_charge_uc[BLE_ADV_STAGE_COUNT]; /**< Charge spent in each stage, in uC. */
+} ble_adv_stats_t;
+
+
 /**@brief BLE advertising event handler type. */
 typedef void (*ble_advertising_evt_handler_t) (ble_adv_evt_t const adv_evt);
 
@@ -140,14 +179,60 @@ typedef struct
  */
 uint32_t ble_advertising_init(ble_advdata_t const                 * p_advdata,
                               ble_advdata_t const                 * p_srdata,
-                              ble_adv_modes_config_t const        * p_config);
+                              ble_adv_modes_config_t const        * p_config,
+                              ble_advertising_evt_handler_t const   evt_handler,
+                              ble_advertising_error_handler_t const error_handler);
+
+/**@brief Function for handling BLE events.
+ *
+ * @details Tracks the peers, moves to the next stage when a stage times out, and learns how
+ *          long a peer takes to reconnect. Call it before the application's own handler, so
+ *          that @ref advertising_start sees a disconnect that has just happened.
+ *
+ * @param[in] p_ble_evt  BLE stack event.
+ */
+void ble_advertising_on_ble_evt(ble_evt_t const * p_ble_evt);
+
+/**@brief Function for setting a whitelist.
+ *
+ * @details Call this function when the module sends @ref BLE_ADV_EVT_WHITELIST_REQUEST. The
+ *          whitelist stage is skipped if the whitelist is empty or not set.
+ *
+ * @param[in] p_whitelist  The whitelist. The addresses and IRKs must stay valid while it is used.
+ *
+ * @retval NRF_SUCCESS              If the whitelist was set.
+ * @retval NRF_ERROR_INVALID_STATE  If no whitelist was requested.
+ */
+uint32_t ble_advertising_whitelist_reply(ble_gap_whitelist_t * p_whitelist);
 
 void advertising_parm_configer(ble_gap_adv_params_t *adv_params);
 
+/**@brief Function for starting advertising.
+ *
+ * @details Does nothing if advertising is already running, unless a bonded peer has just
+ *          disconnected unexpectedly: advertising then restarts with the reconnection stages.
+ */
 void advertising_start(void);
 
 void advertising_stop(void);
 
+/**@brief Function for stretching slow advertising while the device idles.
+ *
+ * @details While set, the slow stage advertises at @ref BLE_ADV_IDLE_INTERVAL. A running slow
+ *          stage is restarted at once; the directed, whitelist and fast stages run as usual and
+ *          fall back to the stretched slow stage. When cleared, a running slow stage returns
+ *          to the configured slow interval.
+ *
+ * @param[in] idle  true to stretch, false to return to the configured interval.
+ */
+void ble_advertising_idle_set(bool idle);
+
+/**@brief Function for getting the current advertising stage, @ref BLE_ADV_EVT_IDLE if none. */
+ble_adv_evt_t ble_advertising_stage_get(void);
+
+/**@brief Function for getting the advertising statistics, including the current stage so far. */
+void ble_advertising_stats_get(ble_adv_stats_t * p_stats);
+
 
 /** @} */
 
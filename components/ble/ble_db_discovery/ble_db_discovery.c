@@ -873,11 +873,15 @@ uint32_t ble_db_discovery_start(ble_db_discovery_t * const p_db_discovery,
 
     p_db_discovery->discoveries_count = 0;
     p_db_discovery->curr_srv_ind = 0;
+    p_db_discovery->curr_char_ind = 0;
 
     p_srv_being_discovered = &(p_db_discovery->services[p_db_discovery->curr_srv_ind]);
 
     p_srv_being_discovered->srv_uuid = m_registered_handlers[p_db_discovery->curr_srv_ind];
 
+    // The instance may have discovered the peer before, e.g. on a Service Changed indication.
+    p_srv_being_discovered->char_count = 0;
+
     DB_LOG("[DB]: Starting discovery of service with UUID 0x%02x for Connection handle %d\r\n",
            p_srv_being_discovered->srv_uuid.uuid, conn_handle);
     
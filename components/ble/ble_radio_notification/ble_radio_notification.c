@@ -11,13 +11,22 @@
 
 #include "ble_radio_notification.h"
 #include <stdlib.h>
+#include "nrf_nvic.h"
+
+#if defined(NRF52)
+    #define SWI_IRQn        SWI1_EGU1_IRQn
+    #define SWI_IRQHandler  SWI1_EGU1_IRQHandler
+#else
+    #define SWI_IRQn        SWI1_IRQn
+    #define SWI_IRQHandler  SWI1_IRQHandler
+#endif
 
 
 static bool                                 m_radio_active = false;  /**< Current radio state. */
 static ble_radio_notification_evt_handler_t m_evt_handler  = NULL;   /**< Application event handler for handling Radio Notification events. */
 
 
-void SWI1_IRQHandler(void)
+void SWI_IRQHandler(void)
 {
     m_radio_active = !m_radio_active;
     if (m_evt_handler != NULL)
@@ -28,7 +37,7 @@ void SWI1_IRQHandler(void)
 
 
 uint32_t ble_radio_notification_init(uint32_t                             irq_priority,
-                                     nrf_radio_notification_distance_t    distance,
+                                     uint8_t                              distance,
                                      ble_radio_notification_evt_handler_t evt_handler)
 {
     uint32_t err_code;
@@ -36,19 +45,19 @@ uint32_t ble_radio_notification_init(uint32_t                             irq_pr
     m_evt_handler = evt_handler;
 
     // Initialize Radio Notification software interrupt
-    err_code = sd_nvic_ClearPendingIRQ(SWI1_IRQn);
+    err_code = sd_nvic_ClearPendingIRQ(SWI_IRQn);
     if (err_code != NRF_SUCCESS)
     {
         return err_code;
     }
 
-    err_code = sd_nvic_SetPriority(SWI1_IRQn, irq_priority);
+    err_code = sd_nvic_SetPriority(SWI_IRQn, irq_priority);
     if (err_code != NRF_SUCCESS)
     {
         return err_code;
     }
 
-    err_code = sd_nvic_EnableIRQ(SWI1_IRQn);
+    err_code = sd_nvic_EnableIRQ(SWI_IRQn);
     if (err_code != NRF_SUCCESS)
     {
         return err_code;
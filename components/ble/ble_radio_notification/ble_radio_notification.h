@@ -37,7 +37,7 @@ typedef void (*ble_radio_notification_evt_handler_t) (bool radio_active);
  * @return     NRF_SUCCESS on successful initialization, otherwise an error code.
  */
 uint32_t ble_radio_notification_init(uint32_t                             irq_priority,
-                                     nrf_radio_notification_distance_t    distance,
+                                     uint8_t                              distance,
                                      ble_radio_notification_evt_handler_t evt_handler);
 
 #endif // BLE_RADIO_NOTIFICATION_H__
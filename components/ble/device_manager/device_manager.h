@@ -881,6 +881,23 @@ ret_code_t dm_distributed_keys_get(dm_handle_t const * p_handle,
  */
 ret_code_t dm_handle_get(uint16_t conn_handle, dm_handle_t * p_handle);
 
+/**
+ * @brief Function for setting the local LE Secure Connections public key.
+ *
+ * @details The key is given to the SoftDevice when a peer requests pairing. The peer's key is
+ *          received into memory owned by the module and reported in the
+ *          @ref BLE_GAP_EVT_LESC_DHKEY_REQUEST event, which the application must answer with
+ *          @ref sd_ble_gap_lesc_dhkey_reply.
+ *
+ * @param[in] p_public_key Public key, must stay valid while pairing is in progress. NULL if no
+ *                         key is available, LE Secure Connections pairing then fails.
+ *
+ * @retval NRF_SUCCESS On success.
+ *
+ * @note This routine is permitted before initialization of the module.
+ */
+ret_code_t dm_lesc_public_key_set(ble_gap_lesc_p256_pk_t * p_public_key);
+
 /** @} */
 /** @} */
 /** @} */
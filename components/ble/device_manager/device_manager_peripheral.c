@@ -482,6 +482,9 @@ static uint32_t               m_peer_addr_update;
 static ble_gap_id_key_t       m_local_id_info;                                      /**< ID information of central in case resolvable address is used. */
 static bool                   m_module_initialized = false;                         /**< State indicating if module is initialized or not. */
 static uint8_t                m_irk_index_table[DEVICE_MANAGER_MAX_BONDS];          /**< List maintaining IRK index list. */
+static ble_gap_lesc_p256_pk_t * mp_lesc_public_key = NULL;                          /**< Local LE Secure Connections public key, NULL if none is set. */
+__ALIGN(sizeof(uint32_t))
+static ble_gap_lesc_p256_pk_t m_lesc_peer_pk[DEVICE_MANAGER_MAX_CONNECTIONS];       /**< LE Secure Connections public keys received from peers during pairing. */
 
 SDK_MUTEX_DEFINE(m_dm_mutex) /**< Mutex variable. Currently unused, this declaration does not occupy any space in RAM. */
 /** @} */
@@ -831,6 +834,33 @@ static ret_code_t device_instance_find(ble_gap_addr_t const * p_addr, uint32_t *
 }
 
 
+/**@brief Function for checking if a master identification is null, as for all LE Secure
+ *        Connections keys.
+ *
+ * @param[in] p_master_id Master identification.
+ *
+ * @retval true  If both EDIV and Rand are 0.
+ * @retval false Otherwise.
+ */
+static bool master_id_is_null(ble_gap_master_id_t const * p_master_id)
+{
+    uint32_t index;
+
+    if (p_master_id->ediv != 0)
+    {
+        return false;
+    }
+    for (index = 0; index < BLE_GAP_SEC_RAND_LEN; index++)
+    {
+        if (p_master_id->rand[index] != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
 /**@brief Function for notifying connection manager event to the application.
  *
  * @param[in] p_handle     Device handle identifying device.
@@ -2652,8 +2682,18 @@ void dm_ble_evt_handler(ble_evt_t * p_ble_evt)
             //If the device is already bonded, respond with existing info, else NULL.
             if (m_connection_table[index].bonded_dev_id == DM_INVALID_ID)
             {
-                //Find device based on div.
-                err_code = device_instance_find(NULL,&device_index, p_ble_evt->evt.gap_evt.params.sec_info_request.master_id.ediv);
+                if (master_id_is_null(&p_ble_evt->evt.gap_evt.params.sec_info_request.master_id))
+                {
+                    //Every LE Secure Connections bond has a null EDIV, so it is found by the peer
+                    //address only. A resolvable address was matched to its IRK on connection.
+                    err_code = device_instance_find(&m_connection_table[index].peer_addr,
+                                                    &device_index, EDIV_INIT_VAL);
+                }
+                else
+                {
+                    //Find device based on div.
+                    err_code = device_instance_find(NULL,&device_index, p_ble_evt->evt.gap_evt.params.sec_info_request.master_id.ediv);
+                }
                 if (err_code == NRF_SUCCESS)
                 {
                     //Load needed bonding information.
@@ -2729,11 +2769,11 @@ void dm_ble_evt_handler(ble_evt_t * p_ble_evt)
                 keys_exchanged.keys_peer.p_enc_key  = NULL;
                 keys_exchanged.keys_peer.p_id_key   = &m_peer_table[m_connection_table[index].bonded_dev_id].peer_id; 
                 keys_exchanged.keys_peer.p_sign_key = NULL;
-                keys_exchanged.keys_peer.p_pk       = NULL;
+                keys_exchanged.keys_peer.p_pk       = &m_lesc_peer_pk[index];
                 keys_exchanged.keys_own.p_enc_key   = &m_bond_table[index].peer_enc_key;
                 keys_exchanged.keys_own.p_id_key    = NULL;
                 keys_exchanged.keys_own.p_sign_key  = NULL;
-                keys_exchanged.keys_own.p_pk        = NULL;
+                keys_exchanged.keys_own.p_pk        = mp_lesc_public_key;
 
                 err_code = sd_ble_gap_sec_params_reply(p_ble_evt->evt.gap_evt.conn_handle,
                                                        BLE_GAP_SEC_STATUS_SUCCESS,
@@ -2926,6 +2966,14 @@ void dm_ble_evt_handler(ble_evt_t * p_ble_evt)
 }
 
 
+ret_code_t dm_lesc_public_key_set(ble_gap_lesc_p256_pk_t * p_public_key)
+{
+    mp_lesc_public_key = p_public_key;
+
+    return NRF_SUCCESS;
+}
+
+
 ret_code_t dm_handle_get(uint16_t conn_handle, dm_handle_t * p_handle)
 {
     ret_code_t err_code;
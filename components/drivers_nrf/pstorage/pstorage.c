@@ -21,6 +21,7 @@
 #include "nrf_soc.h"
 #include "app_util.h"
 #include "app_error.h"
+#include "flash_sched.h"
 
 #define INVALID_OPCODE             0x00                                /**< Invalid op code identifier. */
 #define SOC_MAX_WRITE_SIZE         PSTORAGE_FLASH_PAGE_SIZE            /**< Maximum write size allowed for a single call to \ref sd_flash_write as specified in the SoC API. */
@@ -36,6 +37,27 @@
 #define MASK_SINGLE_PAGE_OPERATION (1 << 1)                            /**< Flag for checking if command is a single flash page operation. */
 #define MASK_MODULE_INITIALIZED    (1 << 2)                            /**< Flag for checking if the module has been initialized. */
 #define MASK_FLASH_API_ERR_BUSY    (1 << 3)                            /**< Flag for checking if flash API returned NRF_ERROR_BUSY. */
+#define MASK_RADIO_WAIT            (1 << 4)                            /**< Flag for checking if a flash operation is held back until a gap in radio activity. */
+#define MASK_LAYOUT_RESET          (1 << 5)                            /**< Flag for checking if the pages of the module are being erased because they were written with another layout. */
+
+#ifdef PSTORAGE_REMAP_ENABLE
+#define REMAP_RECORD_MAGIC         0x5A5A0000                          /**< Marks the first word of a log record. The low half holds the length of the record data in words. */
+#define REMAP_MAGIC_MASK           0xFFFF0000                          /**< Mask for the magic part of the first word of a log record. */
+#define REMAP_LENGTH_MASK          0x0000FFFF                          /**< Mask for the length part of the first word of a log record. */
+#define REMAP_RECORD_OVERHEAD      2                                   /**< Words added to the data of a log record: the header word in front and the commit word, which holds the block ID, behind. */
+#define REMAP_PAGE_HEADER_SIZE     2                                   /**< Words at the start of a log page, which hold its generation and @ref PSTORAGE_LAYOUT_VERSION. */
+#define REMAP_MAX_RECORD_WORDS     ((PSTORAGE_REMAP_MAX_BLOCK_SIZE / sizeof(uint32_t)) + REMAP_RECORD_OVERHEAD)
+
+#if defined(NRF52)
+#define REMAP_PAGE_SIZE            4096                                /**< Flash page size, used to check the log configuration at compile time. */
+#else
+#define REMAP_PAGE_SIZE            1024                                /**< Flash page size, used to check the log configuration at compile time. */
+#endif
+
+// Compaction must always leave room for one more record.
+STATIC_ASSERT(((PSTORAGE_REMAP_MAX_BLOCKS + 1) * REMAP_MAX_RECORD_WORDS + REMAP_PAGE_HEADER_SIZE) <= 
+              (REMAP_PAGE_SIZE / sizeof(uint32_t)));
+#endif // PSTORAGE_REMAP_ENABLE
 
 /**
  * @defgroup api_param_check API Parameters check macros.
@@ -146,6 +168,8 @@ typedef enum
     STATE_STORE,                                                       /**< State for storing data when using store/update API. */
     STATE_DATA_ERASE_WITH_SWAP,                                        /**< State for erasing the data page when using update/clear API when use of swap page is required. */
     STATE_DATA_ERASE,                                                  /**< State for erasing the data page when using update/clear API without the need to use the swap page. */
+    STATE_REMAP,                                                       /**< State for writing to the log when using store/update/clear API on a remapped block. */
+    STATE_LAYOUT_RESET,                                                /**< State for erasing all pages of the module at init, when they were written with another layout. */
     STATE_ERROR                                                        /**< State entered when command processing is terminated abnormally. */
 } pstorage_state_t;  
 
@@ -160,6 +184,26 @@ typedef enum
     SWAP_SUB_STATE_MAX                                                 /**< Enumeration upper bound. */   
 } flash_swap_sub_state_t;
 
+#ifdef PSTORAGE_REMAP_ENABLE
+/**@brief Steps of the @ref STATE_REMAP state. */
+typedef enum
+{
+    REMAP_STEP_COMPACT_ERASE,                                          /**< Erase the spare log page. */
+    REMAP_STEP_COMPACT_COPY,                                           /**< Copy the live records to the spare log page. */
+    REMAP_STEP_COMPACT_HEADER,                                         /**< Write the generation of the spare log page, which makes it the active one. */
+    REMAP_STEP_WRITE,                                                  /**< Append a new version of a block to the log. */
+    REMAP_STEP_UNMAP                                                   /**< Append a record that returns a block to its home location. */
+} remap_step_t;
+
+/**@brief Location of a block which has been remapped into the log. */
+typedef struct
+{
+    pstorage_block_t  block_id;                                        /**< Home address of the block. */
+    uint32_t const *  p_data;                                          /**< Current data of the block in the log. */
+} remap_entry_t;
+#endif // PSTORAGE_REMAP_ENABLE
+
+
 /**@brief Application registration information.
  *
  * @details Defines application specific information that the application needs to maintain to be able 
@@ -234,8 +278,27 @@ static uint32_t                m_flags = 0;                            /**< Stor
 static pstorage_raw_module_table_t m_raw_app_table;                    /**< Registered application information table for raw mode. */
 #endif // PSTORAGE_RAW_MODE_ENABLE
 
+#ifdef PSTORAGE_REMAP_ENABLE
+static remap_entry_t           m_remap_table[PSTORAGE_REMAP_MAX_BLOCKS]; /**< Blocks which are currently remapped into the log. */
+static uint32_t                m_remap_count;                          /**< Number of entries in use in @ref m_remap_table. */
+static uint32_t                m_remap_page;                           /**< Address of the active log page, zero if there is none. */
+static uint32_t                m_remap_write_addr;                     /**< Address at which the next log record is written. */
+static remap_step_t            m_remap_step;                           /**< Step of the @ref STATE_REMAP state in progress. */
+static remap_step_t            m_remap_pending_step;                   /**< Step to continue with once compaction has finished. */
+static uint32_t                m_remap_target;                         /**< Address of the log page being compacted into. */
+static uint32_t                m_remap_target_addr;                    /**< Address at which the next live record is copied. */
+static uint32_t                m_remap_copy_index;                     /**< Index of the next entry to be copied during compaction. */
+static pstorage_block_t        m_remap_block_id;                       /**< Block being written or unmapped. */
+static uint32_t                m_remap_buf[REMAP_MAX_RECORD_WORDS];    /**< Record being appended to the log. */
+#endif // PSTORAGE_REMAP_ENABLE
+
 // Required forward declarations.
 static void cmd_process(void);
+#ifdef PSTORAGE_REMAP_ENABLE
+static void remap_step_execute(void);
+static bool remap_clear_continue(void);
+static void state_layout_reset_entry_run(void);
+#endif // PSTORAGE_REMAP_ENABLE
 static void store_operation_execute(void);
 static void app_notify(uint32_t result, cmd_queue_element_t * p_elem);
 static void cmd_queue_element_init(uint32_t index);
@@ -299,7 +362,10 @@ static void state_idle_entry_run(void)
  */
 static void app_notify_error_state_transit(uint32_t result)
 {
-    app_notify(result, &m_cmd_queue.cmd[m_cmd_queue.rp]);
+    if (!(m_flags & MASK_LAYOUT_RESET))
+    {
+        app_notify(result, &m_cmd_queue.cmd[m_cmd_queue.rp]);
+    }
     sm_state_change(STATE_ERROR);                
 }
 
@@ -338,6 +404,13 @@ static void flash_write(uint32_t * const       p_dst,
                         uint32_t const * const p_src, 
                         uint32_t               size_in_words)
 {
+    if (!flash_sched_write_allowed(size_in_words))
+    {
+        // The write is reissued by radio_gap_handler().
+        m_flags |= MASK_RADIO_WAIT;
+        return;
+    }
+
     flash_api_err_code_process(sd_flash_write(p_dst, p_src, size_in_words));    
 }
 
@@ -351,24 +424,24 @@ static void flash_write(uint32_t * const       p_dst,
 static void store_cmd_flash_write_execute(void)
 {
     const cmd_queue_element_t * p_cmd = &m_cmd_queue.cmd[m_cmd_queue.rp];
-    
-    if (p_cmd->size > SOC_MAX_WRITE_SIZE)    
-    {
-        const uint32_t offset = p_cmd->size - PSTORAGE_FLASH_PAGE_SIZE;
-        flash_write((uint32_t *)(p_cmd->storage_addr.block_id + p_cmd->offset + offset),
-                    (uint32_t *)(p_cmd->p_data_addr + offset), 
-                    PSTORAGE_FLASH_PAGE_SIZE / sizeof(uint32_t));   
+    uint32_t                    size  = MIN(p_cmd->size, SOC_MAX_WRITE_SIZE);
 
-        m_num_of_bytes_written = PSTORAGE_FLASH_PAGE_SIZE;    
-    }
-    else
+    // Only write as much as fits before the next radio event.
+    size = flash_sched_write_words(size / sizeof(uint32_t)) * sizeof(uint32_t);
+
+    if (size == 0)
     {
-        flash_write((uint32_t *)(p_cmd->storage_addr.block_id + p_cmd->offset),
-                    (uint32_t *)(p_cmd->p_data_addr), 
-                    p_cmd->size / sizeof(uint32_t));   
+        // The write is reissued by radio_gap_handler().
+        m_flags |= MASK_RADIO_WAIT;
+        return;
+    }
 
-        m_num_of_bytes_written = p_cmd->size;        
-    }    
+    const uint32_t offset = p_cmd->size - size;
+    flash_write((uint32_t *)(p_cmd->storage_addr.block_id + p_cmd->offset + offset),
+                (uint32_t *)(p_cmd->p_data_addr + offset), 
+                size / sizeof(uint32_t));   
+
+    m_num_of_bytes_written = size;
 }
 
 
@@ -434,6 +507,13 @@ static void state_data_erase_swap_entry_run(void)
  */
 static void flash_page_erase(uint32_t page_number)
 {
+    if (!flash_sched_erase_allowed())
+    {
+        // The erase is reissued by radio_gap_handler().
+        m_flags |= MASK_RADIO_WAIT;
+        return;
+    }
+
     flash_api_err_code_process(sd_flash_page_erase(page_number));
 }
 
@@ -469,6 +549,16 @@ static void state_entry_action_run(void)
         case STATE_DATA_ERASE:
             state_data_erase_entry_run();        
             break;
+
+#ifdef PSTORAGE_REMAP_ENABLE
+        case STATE_REMAP:
+            remap_step_execute();
+            break;
+
+        case STATE_LAYOUT_RESET:
+            state_layout_reset_entry_run();
+            break;
+#endif // PSTORAGE_REMAP_ENABLE
                         
         default:
             // No action needed.
@@ -748,6 +838,14 @@ static void clear_post_processing_run(void)
     
     if (p_cmd->op_code != PSTORAGE_UPDATE_OP_CODE)
     {
+#ifdef PSTORAGE_REMAP_ENABLE
+        // Blocks in the cleared area which are remapped into the log must be returned to their 
+        // home location, which is now erased.
+        if (remap_clear_continue())
+        {
+            return;
+        }
+#endif // PSTORAGE_REMAP_ENABLE
         command_end_procedure_run();    
     }
     else
@@ -1050,6 +1148,12 @@ static void store_sub_state_sm_run(void)
 }
 
 
+#ifdef PSTORAGE_REMAP_ENABLE
+static void remap_sm_run(void);
+static void layout_reset_sm_run(void);
+#endif // PSTORAGE_REMAP_ENABLE
+
+
 /**@brief Function for doing action upon flash operation success event.
  */
 static void flash_operation_success_run(void)
@@ -1067,6 +1171,16 @@ static void flash_operation_success_run(void)
         case STATE_DATA_ERASE_WITH_SWAP:
             swap_sub_state_sm_run();                        
             break;                        
+
+#ifdef PSTORAGE_REMAP_ENABLE
+        case STATE_REMAP:
+            remap_sm_run();
+            break;
+
+        case STATE_LAYOUT_RESET:
+            layout_reset_sm_run();
+            break;
+#endif // PSTORAGE_REMAP_ENABLE
             
         default:
             // No implementation needed.
@@ -1115,6 +1229,12 @@ static void flash_operation_failure_run(void)
  */
 void pstorage_sys_event_handler(uint32_t sys_evt)
 {  
+    if (m_flags & MASK_RADIO_WAIT)
+    {
+        // No flash operation of this module is executing.
+        return;
+    }
+
     if (m_state != STATE_IDLE && m_state != STATE_ERROR)
     {        
         switch (sys_evt)
@@ -1254,6 +1374,515 @@ static void update_operation_execute(void)
 }
 
 
+#ifdef PSTORAGE_REMAP_ENABLE
+
+/**@brief Function for finding the log entry of a block.
+ *
+ * @param[in] block_id Home address of the block.
+ *
+ * @return Pointer to the entry, or NULL if the block is not remapped.
+ */
+static remap_entry_t * remap_find(pstorage_block_t block_id)
+{
+    for (uint32_t i = 0; i < m_remap_count; i++)
+    {
+        if (m_remap_table[i].block_id == block_id)
+        {
+            return &m_remap_table[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+/**@brief Function for recording the current location of a block in the log.
+ *
+ * @param[in] block_id Home address of the block.
+ * @param[in] p_data   Location of the block data in the log.
+ */
+static void remap_set(pstorage_block_t block_id, uint32_t const * p_data)
+{
+    remap_entry_t * p_entry = remap_find(block_id);
+
+    if (p_entry == NULL)
+    {
+        if (m_remap_count == PSTORAGE_REMAP_MAX_BLOCKS)
+        {
+            // Should not happen, as no more blocks than this are ever remapped.
+            return;
+        }
+
+        p_entry           = &m_remap_table[m_remap_count++];
+        p_entry->block_id = block_id;
+    }
+
+    p_entry->p_data = p_data;
+}
+
+
+/**@brief Function for returning a block to its home location.
+ *
+ * @param[in] block_id Home address of the block.
+ */
+static void remap_remove(pstorage_block_t block_id)
+{
+    remap_entry_t * p_entry = remap_find(block_id);
+
+    if (p_entry != NULL)
+    {
+        // Keep the table packed.
+        *p_entry = m_remap_table[--m_remap_count];
+    }
+}
+
+
+/**@brief Function for rebuilding the remap table from the log in flash.
+ *
+ * @details The active log page is the one with the highest generation, among the pages written 
+ *          with the current @ref PSTORAGE_LAYOUT_VERSION. Records are replayed in order, so that 
+ *          the last committed record of each block wins. Records without a commit word were 
+ *          interrupted by a reset and are skipped.
+ */
+static void remap_scan(void)
+{
+    uint32_t gen = 0;
+
+    m_remap_count      = 0;
+    m_remap_page       = 0;
+    m_remap_write_addr = 0;
+
+    for (uint32_t i = 0; i < PSTORAGE_REMAP_LOG_PAGES; i++)
+    {
+        const uint32_t   page_addr = PSTORAGE_REMAP_LOG_ADDR + (i * PSTORAGE_FLASH_PAGE_SIZE);
+        const uint32_t   page_gen  = ((uint32_t *)page_addr)[0];
+        const uint32_t   layout    = ((uint32_t *)page_addr)[1];
+
+        if ((layout == PSTORAGE_LAYOUT_VERSION) &&
+            (page_gen != PSTORAGE_FLASH_EMPTY_MASK) && (page_gen > gen))
+        {
+            gen          = page_gen;
+            m_remap_page = page_addr;
+        }
+    }
+
+    if (m_remap_page == 0)
+    {
+        // There is no log yet.
+        return;
+    }
+
+    const uint32_t   page_end = m_remap_page + PSTORAGE_FLASH_PAGE_SIZE;
+    uint32_t const * p_rec    = (uint32_t *)m_remap_page + REMAP_PAGE_HEADER_SIZE;
+
+    while ((uint32_t)p_rec < page_end)
+    {
+        const uint32_t header = *p_rec;
+
+        if (header == PSTORAGE_FLASH_EMPTY_MASK)
+        {
+            break;
+        }
+
+        const uint32_t length = header & REMAP_LENGTH_MASK;
+
+        if (((header & REMAP_MAGIC_MASK) != REMAP_RECORD_MAGIC) ||
+            ((uint32_t)(p_rec + length + REMAP_RECORD_OVERHEAD) > page_end))
+        {
+            // The log is corrupt. Do not append to it; the next write compacts it.
+            p_rec = (uint32_t *)page_end;
+            break;
+        }
+
+        const uint32_t commit = p_rec[length + 1];
+
+        if (commit != PSTORAGE_FLASH_EMPTY_MASK)
+        {
+            if (length == 0)
+            {
+                remap_remove(commit);
+            }
+            else
+            {
+                remap_set(commit, p_rec + 1);
+            }
+        }
+
+        p_rec += length + REMAP_RECORD_OVERHEAD;
+    }
+
+    m_remap_write_addr = (uint32_t)p_rec;
+}
+
+
+/**@brief Function for finding the block a command operates on, if that block is remapped or may 
+ *        be remapped.
+ *
+ * @param[in]  p_cmd      The command.
+ * @param[out] p_block_id Home address of the block.
+ *
+ * @retval true  If the block size of the module allows the block to be remapped.
+ * @retval false If the command always operates on the home location.
+ */
+static bool remap_block_get(const cmd_queue_element_t * p_cmd, pstorage_block_t * p_block_id)
+{
+    const uint32_t module_id = p_cmd->storage_addr.module_id;
+
+    if ((module_id >= PSTORAGE_NUM_OF_PAGES) ||
+        (m_app_table[module_id].block_size > PSTORAGE_REMAP_MAX_BLOCK_SIZE))
+    {
+        return false;
+    }
+
+    const pstorage_block_t block_size = m_app_table[module_id].block_size;
+    const pstorage_block_t base_id    = m_app_table[module_id].base_id;
+
+    *p_block_id = base_id + (((p_cmd->storage_addr.block_id - base_id) / block_size) * block_size);
+
+    return true;
+}
+
+
+/**@brief Function for starting a log step, compacting the log first if there is not enough room.
+ *
+ * @param[in] step  The step to start.
+ * @param[in] words The size of the record the step appends.
+ */
+static void remap_step_start(remap_step_t step, uint32_t words)
+{
+    if ((m_remap_page != 0) && 
+        (m_remap_write_addr + (words * sizeof(uint32_t)) <= m_remap_page + PSTORAGE_FLASH_PAGE_SIZE))
+    {
+        m_remap_step = step;
+    }
+    else
+    {
+        // Move the live records to the other log page.
+        m_remap_pending_step = step;
+        m_remap_step         = REMAP_STEP_COMPACT_ERASE;
+        m_remap_target       = (m_remap_page == PSTORAGE_REMAP_LOG_ADDR) ? 
+                               (PSTORAGE_REMAP_LOG_ADDR + PSTORAGE_FLASH_PAGE_SIZE) :
+                               PSTORAGE_REMAP_LOG_ADDR;
+    }
+
+    sm_state_change(STATE_REMAP);
+}
+
+
+/**@brief Function for appending a new version of the block written by the current command.
+ *
+ * @details The record holds the complete block: the current content, read from the log or from 
+ *          the home location, with the data of the command written over it.
+ */
+static void remap_write_start(void)
+{
+    const cmd_queue_element_t * p_cmd       = &m_cmd_queue.cmd[m_cmd_queue.rp];
+    const uint32_t              block_words = m_app_table[p_cmd->storage_addr.module_id].block_size /
+                                              sizeof(uint32_t);
+
+    (void)remap_block_get(p_cmd, &m_remap_block_id);
+
+    remap_step_start(REMAP_STEP_WRITE, block_words + REMAP_RECORD_OVERHEAD);
+}
+
+
+/**@brief Function for returning the next remapped block in the area cleared by the current 
+ *        command to its home location.
+ *
+ * @retval true  If a block is being returned to its home location.
+ * @retval false If no remapped blocks remain in the cleared area.
+ */
+static bool remap_clear_continue(void)
+{
+    const cmd_queue_element_t * p_cmd = &m_cmd_queue.cmd[m_cmd_queue.rp];
+    const pstorage_block_t      start = p_cmd->storage_addr.block_id;
+    const pstorage_block_t      end   = start + p_cmd->size;
+
+    for (uint32_t i = 0; i < m_remap_count; i++)
+    {
+        if ((m_remap_table[i].block_id >= start) && (m_remap_table[i].block_id < end))
+        {
+            m_remap_block_id = m_remap_table[i].block_id;
+            remap_step_start(REMAP_STEP_UNMAP, REMAP_RECORD_OVERHEAD);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**@brief Function for the @ref STATE_REMAP state entry action, which executes the current step.
+ */
+static void remap_step_execute(void)
+{
+    switch (m_remap_step)
+    {
+        case REMAP_STEP_COMPACT_ERASE:
+            flash_page_erase(m_remap_target / PSTORAGE_FLASH_PAGE_SIZE);
+            break;
+
+        case REMAP_STEP_COMPACT_COPY:
+            if (m_remap_copy_index < m_remap_count)
+            {
+                // A record is contiguous in flash: header, data and commit word.
+                uint32_t const * p_rec  = m_remap_table[m_remap_copy_index].p_data - 1;
+                const uint32_t   length = (*p_rec & REMAP_LENGTH_MASK) + REMAP_RECORD_OVERHEAD;
+
+                flash_write((uint32_t *)m_remap_target_addr, p_rec, length);
+                break;
+            }
+
+            // All live records have been copied.
+            m_remap_step = REMAP_STEP_COMPACT_HEADER;
+            // Fall through.
+
+        case REMAP_STEP_COMPACT_HEADER:
+            // The new page only becomes active once its header is written, so a reset during 
+            // compaction leaves the old page in use.
+            m_remap_buf[0] = (m_remap_page == 0) ? 1 : (*(uint32_t *)m_remap_page + 1);
+            m_remap_buf[1] = PSTORAGE_LAYOUT_VERSION;
+            flash_write((uint32_t *)m_remap_target, m_remap_buf, REMAP_PAGE_HEADER_SIZE);
+            break;
+
+        case REMAP_STEP_WRITE:
+        {
+            const cmd_queue_element_t * p_cmd       = &m_cmd_queue.cmd[m_cmd_queue.rp];
+            const uint32_t              block_size  = m_app_table[p_cmd->storage_addr.module_id].block_size;
+            const uint32_t              block_words = block_size / sizeof(uint32_t);
+            const remap_entry_t       * p_entry     = remap_find(m_remap_block_id);
+            const uint32_t              offset      = (p_cmd->storage_addr.block_id - m_remap_block_id) + 
+                                                      p_cmd->offset;
+
+            m_remap_buf[0] = REMAP_RECORD_MAGIC | block_words;
+            memcpy(&m_remap_buf[1], 
+                   (p_entry != NULL) ? (void *)p_entry->p_data : (void *)m_remap_block_id, 
+                   block_size);
+            memcpy((uint8_t *)&m_remap_buf[1] + offset, p_cmd->p_data_addr, p_cmd->size);
+            m_remap_buf[block_words + 1] = m_remap_block_id;
+
+            flash_write((uint32_t *)m_remap_write_addr, m_remap_buf, block_words + REMAP_RECORD_OVERHEAD);
+            break;
+        }
+
+        case REMAP_STEP_UNMAP:
+            m_remap_buf[0] = REMAP_RECORD_MAGIC;
+            m_remap_buf[1] = m_remap_block_id;
+
+            flash_write((uint32_t *)m_remap_write_addr, m_remap_buf, REMAP_RECORD_OVERHEAD);
+            break;
+
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+
+/**@brief Function for doing @ref STATE_REMAP state action upon flash operation success event.
+ */
+static void remap_sm_run(void)
+{
+    if (m_flags & MASK_FLASH_API_ERR_BUSY)
+    {
+        // As operation request was rejected by the flash API reissue the request.
+        main_state_err_busy_process();
+        return;
+    }
+
+    switch (m_remap_step)
+    {
+        case REMAP_STEP_COMPACT_ERASE:
+            m_remap_copy_index  = 0;
+            m_remap_target_addr = m_remap_target + (REMAP_PAGE_HEADER_SIZE * sizeof(uint32_t));
+            m_remap_step        = REMAP_STEP_COMPACT_COPY;
+            break;
+
+        case REMAP_STEP_COMPACT_COPY:
+        {
+            uint32_t const * p_rec = m_remap_table[m_remap_copy_index].p_data - 1;
+
+            m_remap_target_addr += ((*p_rec & REMAP_LENGTH_MASK) + REMAP_RECORD_OVERHEAD) * 
+                                   sizeof(uint32_t);
+            m_remap_copy_index++;
+            break;
+        }
+
+        case REMAP_STEP_COMPACT_HEADER:
+            // Switch to the compacted page.
+            remap_scan();
+
+            if ((m_remap_page != m_remap_target) ||
+                (m_remap_write_addr >= m_remap_page + PSTORAGE_FLASH_PAGE_SIZE))
+            {
+                app_notify_error_state_transit(NRF_ERROR_INTERNAL);
+                return;
+            }
+
+            m_remap_step = m_remap_pending_step;
+
+            if (m_remap_step == REMAP_STEP_WRITE)
+            {
+                // Compaction always leaves room for one more record.
+                remap_write_start();
+                return;
+            }
+            break;
+
+        case REMAP_STEP_WRITE:
+            remap_set(m_remap_block_id, (uint32_t *)m_remap_write_addr + 1);
+            m_remap_write_addr += ((m_remap_buf[0] & REMAP_LENGTH_MASK) + REMAP_RECORD_OVERHEAD) * 
+                                  sizeof(uint32_t);
+            command_end_procedure_run();
+            return;
+
+        case REMAP_STEP_UNMAP:
+            remap_remove(m_remap_block_id);
+            m_remap_write_addr += REMAP_RECORD_OVERHEAD * sizeof(uint32_t);
+
+            if (!remap_clear_continue())
+            {
+                command_end_procedure_run();
+            }
+            return;
+
+        default:
+            // No implementation needed.
+            return;
+    }
+
+    // Execute the next step.
+    sm_state_change(STATE_REMAP);
+}
+
+
+/**@brief Function for the @ref STATE_LAYOUT_RESET state entry action.
+ *
+ * @details Erases the pages of the module one at a time, from the log up to the swap page, then 
+ *          writes the header of the first log page. The header is written last, so a reset 
+ *          before that starts the erase over at the next init.
+ */
+static void state_layout_reset_entry_run(void)
+{
+    if (m_current_page_id < PSTORAGE_FLASH_PAGE_END)
+    {
+        flash_page_erase(m_current_page_id);
+    }
+    else
+    {
+        m_remap_buf[0] = 1;
+        m_remap_buf[1] = PSTORAGE_LAYOUT_VERSION;
+        flash_write((uint32_t *)PSTORAGE_REMAP_LOG_ADDR, m_remap_buf, REMAP_PAGE_HEADER_SIZE);
+    }
+}
+
+
+/**@brief Function for doing @ref STATE_LAYOUT_RESET state action upon flash operation success 
+ *        event.
+ */
+static void layout_reset_sm_run(void)
+{
+    if (m_flags & MASK_FLASH_API_ERR_BUSY)
+    {
+        // As operation request was rejected by the flash API reissue the request.
+        main_state_err_busy_process();
+        return;
+    }
+
+    if (m_current_page_id++ < PSTORAGE_FLASH_PAGE_END)
+    {
+        // Erase the next page, or write the log header once all pages are erased.
+        sm_state_change(STATE_LAYOUT_RESET);
+        return;
+    }
+
+    remap_scan();
+    m_flags &= ~MASK_LAYOUT_RESET;
+
+    // Execute the commands queued by the modules in the meantime.
+    sm_state_change(STATE_IDLE);
+}
+
+
+/**@brief Function for checking whether a store or update command is executed through the log.
+ *
+ * @details Updates of small blocks always go through the log, as long as there is room in the 
+ *          remap table. Stores go through the log only if the block is already remapped, since 
+ *          its home location then holds stale data.
+ */
+static bool remap_cmd_applies(const cmd_queue_element_t * p_cmd)
+{
+    pstorage_block_t block_id;
+
+    if (!remap_block_get(p_cmd, &block_id))
+    {
+        return false;
+    }
+
+    if (remap_find(block_id) != NULL)
+    {
+        return true;
+    }
+
+    return ((p_cmd->op_code == PSTORAGE_UPDATE_OP_CODE) && 
+            (m_remap_count < PSTORAGE_REMAP_MAX_BLOCKS));
+}
+
+
+/**@brief Function for finding the flash address where a block is currently stored.
+ *
+ * @param[in] p_handle Identifies the module and block.
+ *
+ * @return Address of the block data in the log if the block is remapped, the home address 
+ *         otherwise.
+ */
+static uint32_t remap_addr_get(pstorage_handle_t const * p_handle)
+{
+    cmd_queue_element_t cmd;
+    pstorage_block_t    block_id;
+
+    cmd.storage_addr = *p_handle;
+
+    if (remap_block_get(&cmd, &block_id))
+    {
+        const remap_entry_t * p_entry = remap_find(block_id);
+
+        if (p_entry != NULL)
+        {
+            return (uint32_t)p_entry->p_data + (p_handle->block_id - block_id);
+        }
+    }
+
+    return p_handle->block_id;
+}
+
+
+/**@brief Function for checking that an access stays within one block if the block may be 
+ *        remapped.
+ *
+ * @retval true  If the access is valid.
+ * @retval false If the access spans more than one remappable block.
+ */
+static bool remap_range_is_valid(pstorage_handle_t const * p_handle, 
+                                 pstorage_size_t           size, 
+                                 pstorage_size_t           offset)
+{
+    cmd_queue_element_t cmd;
+    pstorage_block_t    block_id;
+
+    cmd.storage_addr = *p_handle;
+
+    if (!remap_block_get(&cmd, &block_id))
+    {
+        return true;
+    }
+
+    return ((p_handle->block_id - block_id) + offset + size) <= MODULE_BLOCK_SIZE(p_handle);
+}
+
+#endif // PSTORAGE_REMAP_ENABLE
+
+
 /**@brief Function for dispatching the flash access operation.
  */  
 static void cmd_process(void)
@@ -1261,6 +1890,16 @@ static void cmd_process(void)
     const cmd_queue_element_t * p_cmd = &m_cmd_queue.cmd[m_cmd_queue.rp];
     m_app_data_size                   = p_cmd->size;
 
+#ifdef PSTORAGE_REMAP_ENABLE
+    if (((p_cmd->op_code == PSTORAGE_STORE_OP_CODE) || 
+         (p_cmd->op_code == PSTORAGE_UPDATE_OP_CODE)) && 
+        remap_cmd_applies(p_cmd))
+    {
+        remap_write_start();
+        return;
+    }
+#endif // PSTORAGE_REMAP_ENABLE
+
     switch (p_cmd->op_code)
     {
         case PSTORAGE_STORE_OP_CODE:                   
@@ -1282,8 +1921,36 @@ static void cmd_process(void)
 }
 
 
+/**@brief Function for reissuing a flash operation which was held back by the flash scheduler.
+ *
+ * @details Called by the flash scheduler when a gap in radio activity begins.
+ */
+static void radio_gap_handler(void)
+{
+    if (m_flags & MASK_RADIO_WAIT)
+    {
+        m_flags &= ~MASK_RADIO_WAIT;
+
+        // Reissue the operation the same way as a retry after a failure.
+        if (m_state != STATE_DATA_ERASE_WITH_SWAP)
+        {
+            sm_state_change(m_state);
+        }
+        else
+        {
+            swap_sub_state_state_change(m_swap_sub_state);
+        }
+    }
+}
+
+
 uint32_t pstorage_init(void)
 {
+    if (!(m_flags & MASK_MODULE_INITIALIZED))
+    {
+        (void)flash_sched_register(radio_gap_handler);
+    }
+
     cmd_queue_init();
 
     m_next_app_instance = 0;
@@ -1306,6 +1973,20 @@ uint32_t pstorage_init(void)
     m_flags                     = 0;
     m_num_of_bytes_written      = 0;
     m_flags                    |= MASK_MODULE_INITIALIZED;
+
+#ifdef PSTORAGE_REMAP_ENABLE
+    remap_scan();
+
+    if (m_remap_page == 0)
+    {
+        // The pages were not written with the current layout, or never written at all. Erase 
+        // them before they are used. Commands are queued until the erase is done, and loads 
+        // return erased data.
+        m_flags           |= MASK_LAYOUT_RESET;
+        m_current_page_id  = PSTORAGE_REMAP_LOG_ADDR / PSTORAGE_FLASH_PAGE_SIZE;
+        sm_state_change(STATE_LAYOUT_RESET);
+    }
+#endif // PSTORAGE_REMAP_ENABLE
        
     return NRF_SUCCESS;
 }
@@ -1394,6 +2075,13 @@ uint32_t pstorage_store(pstorage_handle_t * p_dest,
         return NRF_ERROR_INVALID_ADDR;
     }
 
+#ifdef PSTORAGE_REMAP_ENABLE
+    if (!remap_range_is_valid(p_dest, size, offset))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+#endif // PSTORAGE_REMAP_ENABLE
+
     return cmd_queue_enqueue(PSTORAGE_STORE_OP_CODE, p_dest, p_src, size, offset);
 }
 
@@ -1418,6 +2106,13 @@ uint32_t pstorage_update(pstorage_handle_t * p_dest,
         return NRF_ERROR_INVALID_ADDR;
     }
 
+#ifdef PSTORAGE_REMAP_ENABLE
+    if (!remap_range_is_valid(p_dest, size, offset))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+#endif // PSTORAGE_REMAP_ENABLE
+
     return cmd_queue_enqueue(PSTORAGE_UPDATE_OP_CODE, p_dest, p_src, size, offset);
 }
 
@@ -1442,7 +2137,19 @@ uint32_t pstorage_load(uint8_t           * p_dest,
         return NRF_ERROR_INVALID_ADDR;
     }
 
+#ifdef PSTORAGE_REMAP_ENABLE
+    if (m_flags & MASK_LAYOUT_RESET)
+    {
+        // The pages still hold data of another layout, which is being erased.
+        memset(p_dest, 0xFF, size);
+    }
+    else
+    {
+        memcpy(p_dest, (((uint8_t *)remap_addr_get(p_src)) + offset), size);
+    }
+#else
     memcpy(p_dest, (((uint8_t *)p_src->block_id) + offset), size);
+#endif // PSTORAGE_REMAP_ENABLE
 
     m_app_table[p_src->module_id].cb(p_src, PSTORAGE_LOAD_OP_CODE, NRF_SUCCESS, p_dest, size);
 
@@ -1502,6 +2209,12 @@ uint32_t pstorage_access_status_get(uint32_t * p_count)
 
     (*p_count) = m_cmd_queue.count;
 
+    if (m_flags & MASK_LAYOUT_RESET)
+    {
+        // The erase of the pages at init is pending as well.
+        ++(*p_count);
+    }
+
     return NRF_SUCCESS;
 }
 
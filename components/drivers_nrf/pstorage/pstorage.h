@@ -108,6 +108,10 @@ typedef struct
  * @details Function for initializing the module. This function is called once before any other APIs 
  *          of the module are used.
  *
+ * @note       If the pages of the module were written with another PSTORAGE_LAYOUT_VERSION, they 
+ *             are erased. Until the erase is done, loads return erased data and other commands 
+ *             are queued behind it.
+ *
  * @retval     NRF_SUCCESS             Operation success.
  */
 uint32_t pstorage_init(void);
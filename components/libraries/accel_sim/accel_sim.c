@@ -0,0 +1,624 @@
+/* Copyright (c) 2016 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is property of Nordic Semiconductor ASA.
+ * Terms and conditions of usage are described in detail in NORDIC
+ * SEMICONDUCTOR STANDARD SOFTWARE LICENSE AGREEMENT.
+ *
+ * Licensees are granted free, non-transferable use of the information. NO
+ * WARRANTY of ANY KIND is provided. This heading must NOT be removed from
+ * the file.
+ *
+ */
+
+#include "accel_sim.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "nrf_error.h"
+#include "app_util.h"
+#include "app_twi.h"
+#include "nrf_drv_gpiote.h"
+
+
+#define REG_WHO_AM_I            (0x0F)
+#define REG_CTRL_REG1           (0x20)
+#define REG_CTRL_REG3           (0x22)
+#define REG_CTRL_REG5           (0x24)
+#define REG_OUT_X_L             (0x28)
+#define REG_OUT_Z_H             (0x2D)
+#define REG_FIFO_CTRL_REG       (0x2E)
+#define REG_FIFO_SRC_REG        (0x2F)
+#define REG_COUNT               (0x40)
+#define REG_AUTO_INCREMENT      (0x80)
+
+#define WHO_AM_I_VALUE          (0x33)
+#define CTRL_REG3_I1_WTM        (0x04)
+#define CTRL_REG5_FIFO_EN       (0x40)
+#define FIFO_MODE_BYPASS        (0)
+#define FIFO_MODE_FIFO          (1)
+#define FIFO_SRC_WTM            (0x80)
+#define FIFO_SRC_OVRN           (0x40)
+#define FIFO_SRC_EMPTY          (0x20)
+
+#define SAMPLE_BYTES            (6)
+#define MG_PER_LSB              (2)         // +-4 g, high resolution.
+
+#define POLL_BUS_BYTES          ((1 + 1) + (1 + SAMPLE_BYTES))
+
+#define DEFAULT_TWI_FREQUENCY   (400000)
+#define TWI_BITS_PER_BYTE       (9)         // Eight data bits and the acknowledge.
+#define TWI_START_STOP_BITS     (2)
+
+#define QUEUE_SIZE_MAX          (8)
+
+
+// Output data rates of CTRL_REG1 ODR[3:0] in normal and high resolution mode.
+static const uint16_t m_odr_hz[16] = {0, 1, 10, 25, 50, 100, 200, 400, 0, 1344};
+
+static accel_sim_config_t            m_config;
+static uint64_t                      m_time_us;
+static accel_sim_stats_t             m_stats;
+static uint64_t                      m_stats_start_us;
+
+static uint8_t                       m_regs[REG_COUNT];
+static uint8_t                       m_fifo[ACCEL_SIM_FIFO_SIZE][SAMPLE_BYTES];
+static uint8_t                       m_fifo_level;
+static bool                          m_fifo_ovrn;
+static uint8_t                       m_out[SAMPLE_BYTES];   // Latest sample, read in bypass mode.
+static uint32_t                      m_trace_index;
+static uint64_t                      m_next_sample_us;      // Zero while the sensor is powered down.
+static uint8_t                       m_sub_addr;
+
+static bool                          m_int1;
+static nrf_drv_gpiote_evt_handler_t  m_int_handler;
+static nrf_drv_gpiote_pin_t          m_int_pin;
+static bool                          m_int_enabled;
+static bool                          m_gpiote_init;
+
+static app_twi_transaction_t const * m_queue[QUEUE_SIZE_MAX];
+static uint8_t                       m_queue_size;
+static uint8_t                       m_queue_count;
+static uint8_t                       m_queue_head;
+static bool                          m_bus_busy;
+static uint64_t                      m_bus_done_us;
+static ret_code_t                    m_bus_result;
+
+
+static uint8_t fifo_threshold(void)
+{
+    return m_regs[REG_FIFO_CTRL_REG] & 0x1F;
+}
+
+
+static uint8_t fifo_mode(void)
+{
+    if ((m_regs[REG_CTRL_REG5] & CTRL_REG5_FIFO_EN) == 0)
+    {
+        return FIFO_MODE_BYPASS;
+    }
+    return m_regs[REG_FIFO_CTRL_REG] >> 6;
+}
+
+
+static bool fifo_wtm(void)
+{
+    return (fifo_mode() != FIFO_MODE_BYPASS) && (m_fifo_level > fifo_threshold());
+}
+
+
+// Follows INT1 and calls the handler on a rising edge.
+static void int1_update(void)
+{
+    bool level = ((m_regs[REG_CTRL_REG3] & CTRL_REG3_I1_WTM) != 0) && fifo_wtm();
+
+    if (level && !m_int1 && m_int_enabled && (m_int_handler != NULL))
+    {
+        m_int1 = level;
+        m_stats.wakeups++;
+        m_int_handler(m_int_pin, NRF_GPIOTE_POLARITY_LOTOHI);
+        return;
+    }
+    m_int1 = level;
+}
+
+
+static uint32_t sample_period_us(void)
+{
+    uint16_t odr = m_odr_hz[m_regs[REG_CTRL_REG1] >> 4];
+
+    if ((odr == 0) || ((m_regs[REG_CTRL_REG1] & 0x07) == 0))
+    {
+        return 0;
+    }
+    return 1000000 / odr;
+}
+
+
+static void sample_encode(accel_sim_sample_t const * p_sample, uint8_t * p_raw)
+{
+    int16_t axis[3] = {p_sample->x, p_sample->y, p_sample->z};
+
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        int16_t raw = (int16_t)((axis[i] / MG_PER_LSB) * 16);
+
+        p_raw[2 * i]     = (uint8_t)raw;
+        p_raw[2 * i + 1] = (uint8_t)((uint16_t)raw >> 8);
+    }
+}
+
+
+static void sample_take(void)
+{
+    accel_sim_sample_t const * p_sample = &m_config.p_trace[m_trace_index];
+
+    sample_encode(p_sample, m_out);
+    if (m_trace_index + 1 < m_config.trace_length)
+    {
+        m_trace_index++;
+    }
+    else if (m_config.loop)
+    {
+        m_trace_index = 0;
+    }
+
+    m_stats.samples++;
+    m_stats.poll_wakeups++;
+    m_stats.poll_transactions++;
+    m_stats.poll_bus_bytes += POLL_BUS_BYTES;
+
+    if (fifo_mode() == FIFO_MODE_BYPASS)
+    {
+        return;
+    }
+
+    if (m_fifo_level == ACCEL_SIM_FIFO_SIZE)
+    {
+        m_stats.overruns++;
+        m_fifo_ovrn = true;
+        if (fifo_mode() == FIFO_MODE_FIFO)
+        {
+            return;
+        }
+        // Stream mode: the oldest sample is overwritten.
+        memmove(m_fifo[0], m_fifo[1], (ACCEL_SIM_FIFO_SIZE - 1) * SAMPLE_BYTES);
+        m_fifo_level--;
+    }
+    memcpy(m_fifo[m_fifo_level], m_out, SAMPLE_BYTES);
+    m_fifo_level++;
+
+    int1_update();
+}
+
+
+static void sensor_schedule(void)
+{
+    uint32_t period = sample_period_us();
+
+    if (period == 0)
+    {
+        m_next_sample_us = 0;
+    }
+    else if (m_next_sample_us == 0)
+    {
+        m_next_sample_us = m_time_us + period;
+    }
+}
+
+
+static void reg_write(uint8_t reg, uint8_t value)
+{
+    if ((reg >= REG_COUNT) || (reg == REG_WHO_AM_I) || (reg == REG_FIFO_SRC_REG))
+    {
+        return;
+    }
+    m_regs[reg] = value;
+
+    if ((reg == REG_FIFO_CTRL_REG) && ((value >> 6) == FIFO_MODE_BYPASS))
+    {
+        m_fifo_level = 0;
+        m_fifo_ovrn  = false;
+    }
+    if (reg == REG_CTRL_REG1)
+    {
+        sensor_schedule();
+    }
+}
+
+
+static uint8_t reg_read(uint8_t reg)
+{
+    uint8_t value;
+
+    if ((reg >= REG_OUT_X_L) && (reg <= REG_OUT_Z_H))
+    {
+        if ((fifo_mode() == FIFO_MODE_BYPASS) || (m_fifo_level == 0))
+        {
+            return m_out[reg - REG_OUT_X_L];
+        }
+        value = m_fifo[0][reg - REG_OUT_X_L];
+        if (reg == REG_OUT_Z_H)
+        {
+            // The oldest sample leaves the FIFO once its last byte is read.
+            memmove(m_fifo[0], m_fifo[1], (m_fifo_level - 1) * SAMPLE_BYTES);
+            m_fifo_level--;
+            m_fifo_ovrn = false;
+        }
+        return value;
+    }
+    if (reg == REG_FIFO_SRC_REG)
+    {
+        value = MIN(m_fifo_level, 0x1F);
+        if (fifo_wtm())
+        {
+            value |= FIFO_SRC_WTM;
+        }
+        if (m_fifo_ovrn)
+        {
+            value |= FIFO_SRC_OVRN;
+        }
+        if (m_fifo_level == 0)
+        {
+            value |= FIFO_SRC_EMPTY;
+        }
+        return value;
+    }
+    if (reg < REG_COUNT)
+    {
+        return m_regs[reg];
+    }
+    return 0;
+}
+
+
+// Next register of a burst: the output registers wrap so that the FIFO can be read in one go.
+static uint8_t sub_addr_next(uint8_t reg)
+{
+    if ((reg == REG_OUT_Z_H) && (fifo_mode() != FIFO_MODE_BYPASS))
+    {
+        return REG_OUT_X_L;
+    }
+    return reg + 1;
+}
+
+
+static ret_code_t transfer_run(app_twi_transfer_t const * p_transfer, uint32_t * p_bits)
+{
+    uint8_t reg;
+    bool    increment;
+
+    *p_bits += (1 + p_transfer->length) * TWI_BITS_PER_BYTE;
+    if ((p_transfer->flags & APP_TWI_NO_STOP) == 0)
+    {
+        *p_bits += TWI_START_STOP_BITS;
+    }
+    m_stats.bus_bytes += 1 + p_transfer->length;
+
+    if (APP_TWI_OP_ADDRESS(p_transfer->operation) != ACCEL_SIM_TWI_ADDR)
+    {
+        return NRF_ERROR_INTERNAL;
+    }
+
+    if (!APP_TWI_IS_READ_OP(p_transfer->operation))
+    {
+        if (p_transfer->length == 0)
+        {
+            return NRF_SUCCESS;
+        }
+        m_sub_addr = p_transfer->p_data[0];
+        reg        = m_sub_addr & ~REG_AUTO_INCREMENT;
+        increment  = (m_sub_addr & REG_AUTO_INCREMENT) != 0;
+        for (uint8_t i = 1; i < p_transfer->length; i++)
+        {
+            reg_write(reg, p_transfer->p_data[i]);
+            if (increment)
+            {
+                reg = sub_addr_next(reg);
+            }
+        }
+        return NRF_SUCCESS;
+    }
+
+    reg       = m_sub_addr & ~REG_AUTO_INCREMENT;
+    increment = (m_sub_addr & REG_AUTO_INCREMENT) != 0;
+    for (uint8_t i = 0; i < p_transfer->length; i++)
+    {
+        p_transfer->p_data[i] = reg_read(reg);
+        if (increment)
+        {
+            reg = sub_addr_next(reg);
+        }
+    }
+    return NRF_SUCCESS;
+}
+
+
+// Runs the transfers at once and returns the time they take on the bus.
+static ret_code_t transaction_run(app_twi_transfer_t const * p_transfers,
+                                  uint8_t                    count,
+                                  uint32_t                 * p_time_us)
+{
+    ret_code_t result = NRF_SUCCESS;
+    uint32_t   bits   = 0;
+
+    for (uint8_t i = 0; (i < count) && (result == NRF_SUCCESS); i++)
+    {
+        result = transfer_run(&p_transfers[i], &bits);
+    }
+
+    m_stats.transactions++;
+    *p_time_us = (uint32_t)(((uint64_t)bits * 1000000 + m_config.twi_frequency - 1) /
+                            m_config.twi_frequency);
+    m_stats.bus_time_us += *p_time_us;
+
+    int1_update();
+    return result;
+}
+
+
+static void bus_start_next(void)
+{
+    app_twi_transaction_t const * p_transaction;
+    uint32_t                      time_us;
+
+    if (m_bus_busy || (m_queue_count == 0))
+    {
+        return;
+    }
+
+    p_transaction = m_queue[m_queue_head];
+    m_bus_result  = transaction_run(p_transaction->p_transfers,
+                                    p_transaction->number_of_transfers,
+                                    &time_us);
+    m_bus_busy    = true;
+    m_bus_done_us = m_time_us + time_us;
+}
+
+
+static void bus_done(void)
+{
+    app_twi_transaction_t const * p_transaction = m_queue[m_queue_head];
+
+    m_queue_head = (m_queue_head + 1) % QUEUE_SIZE_MAX;
+    m_queue_count--;
+    m_bus_busy = false;
+
+    if (p_transaction->callback != NULL)
+    {
+        p_transaction->callback(m_bus_result, p_transaction->p_user_data);
+    }
+    bus_start_next();
+}
+
+
+uint32_t accel_sim_init(accel_sim_config_t const * p_config)
+{
+    if ((p_config == NULL) || (p_config->p_trace == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (p_config->trace_length == 0)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_config = *p_config;
+    if (m_config.twi_frequency == 0)
+    {
+        m_config.twi_frequency = DEFAULT_TWI_FREQUENCY;
+    }
+
+    m_time_us = 0;
+    memset(m_regs, 0, sizeof(m_regs));
+    m_regs[REG_WHO_AM_I] = WHO_AM_I_VALUE;
+    m_regs[REG_CTRL_REG1] = 0x07;
+    m_fifo_level      = 0;
+    m_fifo_ovrn       = false;
+    m_trace_index     = 0;
+    m_next_sample_us  = 0;
+    m_sub_addr        = 0;
+    m_int1            = false;
+    m_int_handler     = NULL;
+    m_int_enabled     = false;
+    m_gpiote_init     = false;
+    m_queue_size      = 0;
+    m_queue_count     = 0;
+    m_queue_head      = 0;
+    m_bus_busy        = false;
+    sample_encode(&m_config.p_trace[0], m_out);
+
+    accel_sim_stats_reset();
+
+    return NRF_SUCCESS;
+}
+
+
+void accel_sim_run_for(uint32_t us)
+{
+    uint64_t end_us = m_time_us + us;
+
+    for (;;)
+    {
+        uint64_t next_us = UINT64_MAX;
+        bool     sample  = false;
+
+        if (m_next_sample_us != 0)
+        {
+            next_us = m_next_sample_us;
+            sample  = true;
+        }
+        if (m_bus_busy && (m_bus_done_us < next_us))
+        {
+            next_us = m_bus_done_us;
+            sample  = false;
+        }
+        if (next_us > end_us)
+        {
+            break;
+        }
+
+        m_time_us = next_us;
+        if (sample)
+        {
+            sample_take();
+            m_next_sample_us = (sample_period_us() != 0) ? (m_time_us + sample_period_us()) : 0;
+        }
+        else
+        {
+            bus_done();
+        }
+    }
+
+    m_time_us = end_us;
+}
+
+
+uint64_t accel_sim_time_us(void)
+{
+    return m_time_us;
+}
+
+
+void accel_sim_stats_get(accel_sim_stats_t * p_stats)
+{
+    *p_stats            = m_stats;
+    p_stats->elapsed_us = m_time_us - m_stats_start_us;
+}
+
+
+uint32_t accel_sim_per_hour(uint32_t count, accel_sim_stats_t const * p_stats)
+{
+    if (p_stats->elapsed_us == 0)
+    {
+        return 0;
+    }
+    return (uint32_t)(((uint64_t)count * 3600000000ULL) / p_stats->elapsed_us);
+}
+
+
+void accel_sim_stats_reset(void)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_stats_start_us = m_time_us;
+}
+
+
+ret_code_t app_twi_init(app_twi_t *                     p_app_twi,
+                        nrf_drv_twi_config_t const *    p_twi_config,
+                        uint8_t                         queue_size,
+                        app_twi_transaction_t const * * p_queue_buffer)
+{
+    UNUSED_PARAMETER(p_app_twi);
+    UNUSED_PARAMETER(p_twi_config);
+    UNUSED_PARAMETER(p_queue_buffer);
+
+    m_queue_size  = MIN(queue_size, QUEUE_SIZE_MAX);
+    m_queue_count = 0;
+    m_queue_head  = 0;
+    m_bus_busy    = false;
+
+    return NRF_SUCCESS;
+}
+
+
+void app_twi_uninit(app_twi_t * p_app_twi)
+{
+    UNUSED_PARAMETER(p_app_twi);
+
+    m_queue_size  = 0;
+    m_queue_count = 0;
+}
+
+
+ret_code_t app_twi_schedule(app_twi_t *                   p_app_twi,
+                            app_twi_transaction_t const * p_transaction)
+{
+    UNUSED_PARAMETER(p_app_twi);
+
+    if (p_transaction == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (m_queue_count >= m_queue_size)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    m_queue[(m_queue_head + m_queue_count) % QUEUE_SIZE_MAX] = p_transaction;
+    m_queue_count++;
+    bus_start_next();
+
+    return NRF_SUCCESS;
+}
+
+
+ret_code_t app_twi_perform(app_twi_t *                p_app_twi,
+                           app_twi_transfer_t const * p_transfers,
+                           uint8_t                    number_of_transfers,
+                           void (* user_function)(void))
+{
+    uint32_t time_us;
+
+    UNUSED_PARAMETER(p_app_twi);
+    UNUSED_PARAMETER(user_function);
+
+    if (m_bus_busy || (m_queue_count != 0))
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    return transaction_run(p_transfers, number_of_transfers, &time_us);
+}
+
+
+ret_code_t nrf_drv_gpiote_init(void)
+{
+    if (m_gpiote_init)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    m_gpiote_init = true;
+    return NRF_SUCCESS;
+}
+
+
+bool nrf_drv_gpiote_is_init(void)
+{
+    return m_gpiote_init;
+}
+
+
+ret_code_t nrf_drv_gpiote_in_init(nrf_drv_gpiote_pin_t               pin,
+                                  nrf_drv_gpiote_in_config_t const * p_config,
+                                  nrf_drv_gpiote_evt_handler_t       evt_handler)
+{
+    UNUSED_PARAMETER(p_config);
+
+    if (!m_gpiote_init)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    m_int_pin     = pin;
+    m_int_handler = evt_handler;
+    return NRF_SUCCESS;
+}
+
+
+void nrf_drv_gpiote_in_event_enable(nrf_drv_gpiote_pin_t pin, bool int_enable)
+{
+    if (pin == m_int_pin)
+    {
+        m_int_enabled = int_enable;
+        int1_update();
+    }
+}
+
+
+void nrf_drv_gpiote_in_event_disable(nrf_drv_gpiote_pin_t pin)
+{
+    if (pin == m_int_pin)
+    {
+        m_int_enabled = false;
+    }
+}
@@ -0,0 +1,133 @@
+/* Copyright (c) 2016 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is property of Nordic Semiconductor ASA.
+ * Terms and conditions of usage are described in detail in NORDIC
+ * SEMICONDUCTOR STANDARD SOFTWARE LICENSE AGREEMENT.
+ *
+ * Licensees are granted free, non-transferable use of the information. NO
+ * WARRANTY of ANY KIND is provided. This heading must NOT be removed from
+ * the file.
+ *
+ */
+
+/** @file
+ *
+ * @defgroup accel_sim Accelerometer simulator
+ * @{
+ * @ingroup app_common
+ * @brief Host-side model of a LIS3DH accelerometer on the TWI transaction manager.
+ *
+ * @details This module implements @ref app_twi and the GPIOTE input functions of
+ *          nrf_drv_gpiote on a Linux host, and connects them to a model of a LIS3DH that
+ *          replays a recorded trace. The motion acquisition code then runs unmodified
+ *          off-target.
+ *
+ *          The model is deterministic: all timing follows a simulated clock. It covers:
+ *          - The registers used by the application, with address auto-increment.
+ *          - Sampling at the configured output data rate into the 32-sample FIFO, in bypass
+ *            or stream mode, with the overrun flag.
+ *          - The FIFO watermark on INT1, as a level. A rising edge calls the GPIOTE handler.
+ *          - Transactions scheduled with @ref app_twi_schedule, which complete after the
+ *            time they take on the bus. @ref app_twi_perform completes at once.
+ *
+ *          Every call of the GPIOTE handler counts as a CPU wakeup. For comparison, the
+ *          counters also give the cost of reading each sample on its own: one timer wakeup
+ *          and one transaction of a register write and a 6-byte read per sample.
+ *
+ * @note    Build for the host with TWI1_ENABLED and TWI1_USE_EASY_DMA set as on the target,
+ *          against the host nrf.h in test/host: components/device/nrf.h leaves out the device
+ *          headers on a host. test/CMakeLists.txt builds it with source/motion.c.
+ */
+
+#ifndef ACCEL_SIM_H__
+#define ACCEL_SIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define ACCEL_SIM_FIFO_SIZE     (32)    /**< LIS3DH FIFO depth, in samples. */
+#define ACCEL_SIM_TWI_ADDR      (0x19)  /**< TWI address of the modelled LIS3DH. */
+
+
+/**@brief   Recorded sample, in mg. */
+typedef struct
+{
+    int16_t x;
+    int16_t y;
+    int16_t z;
+} accel_sim_sample_t;
+
+
+/**@brief   Accelerometer simulator configuration.
+ *
+ * @details The trace is replayed at the output data rate the application configures,
+ *          whatever rate it was recorded at.
+ */
+typedef struct
+{
+    accel_sim_sample_t const * p_trace;         //!< The recorded samples.
+    uint32_t                   trace_length;    //!< Number of samples in the trace.
+    bool                       loop;            //!< Restart the trace at its end, otherwise repeat the last sample.
+    uint32_t                   twi_frequency;   //!< TWI clock in Hz (400000).
+} accel_sim_config_t;
+
+
+/**@brief   Accelerometer simulator counters. */
+typedef struct
+{
+    uint64_t elapsed_us;            //!< Simulated time covered by the counters.
+    uint32_t samples;               //!< Samples taken by the sensor.
+    uint32_t overruns;              //!< Samples lost to a full FIFO.
+    uint32_t wakeups;               //!< Calls of the GPIOTE handler.
+    uint32_t transactions;          //!< TWI transactions, scheduled or performed.
+    uint32_t bus_bytes;             //!< Bytes on the bus, including address bytes.
+    uint32_t bus_time_us;           //!< Time the bus was busy.
+    uint32_t poll_wakeups;          //!< Wakeups if every sample were read on its own.
+    uint32_t poll_transactions;     //!< Transactions if every sample were read on its own.
+    uint32_t poll_bus_bytes;        //!< Bus bytes if every sample were read on its own.
+} accel_sim_stats_t;
+
+
+/**@brief   Function for resetting the simulated sensor, the bus and the clock.
+ *
+ * @retval  NRF_SUCCESS             If the simulator was reset.
+ * @retval  NRF_ERROR_NULL          If @p p_config or the trace is NULL.
+ * @retval  NRF_ERROR_INVALID_PARAM If the trace is empty.
+ */
+uint32_t accel_sim_init(accel_sim_config_t const * p_config);
+
+
+/**@brief   Function for advancing the simulated clock.
+ *
+ * @details Takes every sample, completes every transaction and calls every handler that falls
+ *          in the time span, in order.
+ *
+ * @param[in]   us  The time span, in microseconds.
+ */
+void accel_sim_run_for(uint32_t us);
+
+
+/**@brief   Function for getting the simulated time, in microseconds. */
+uint64_t accel_sim_time_us(void);
+
+
+/**@brief   Function for getting the counters. */
+void accel_sim_stats_get(accel_sim_stats_t * p_stats);
+
+
+/**@brief   Function for scaling a counter to one hour of the time it covers.
+ *
+ * @param[in]   count       The counter.
+ * @param[in]   p_stats     The counters it comes from.
+ */
+uint32_t accel_sim_per_hour(uint32_t count, accel_sim_stats_t const * p_stats);
+
+
+/**@brief   Function for resetting the counters. */
+void accel_sim_stats_reset(void);
+
+
+#endif // ACCEL_SIM_H__
+
+/** @} */
@@ -0,0 +1,2980 @@
+/* Copyright (c) 2016 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is property of Nordic Semiconductor ASA.
+ * Terms and conditions of usage are described in detail in NORDIC
+ * SEMICONDUCTOR STANDARD SOFTWARE LICENSE AGREEMENT.
+ *
+ * Licensees are granted free, non-transferable use of the information. NO
+ * WARRANTY of ANY KIND is provided. This heading must NOT be removed from
+ * the file.
+ *
+ */
+
+#include "ble_sim.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nrf_error.h"
+#include "app_util.h"
+#include "ble.h"
+#include "ble_err.h"
+#include "ble_hci.h"
+#include "ble_gap.h"
+#include "ble_gatts.h"
+#include "ble_gattc.h"
+
+
+#define SIM_ATT_DATA_MAX        (BLE_SIM_ATT_MTU_MAX - 3)   // Attribute data in one ATT packet.
+#define SIM_EVT_QUEUE_SIZE      (32)
+#define SIM_EVT_BUF_WORDS       ((sizeof(ble_evt_t) + SIM_ATT_DATA_MAX + 3) / 4)
+
+#define SIM_LL_PAYLOAD_MAX      (27)        // LL payload without data length extension.
+#define SIM_LL_OVERHEAD_BYTES   (10)        // Preamble, access address, header and CRC.
+#define SIM_L2CAP_HDR_LEN       (4)
+#define SIM_IFS_US              (150)
+#define SIM_EVENT_GUARD_US      (300)       // End of the connection event before the next anchor.
+#define SIM_DIRECT_ADV_US       (1280000)   // Length of high duty cycle directed advertising.
+#define SIM_DIRECT_ADV_EVENT_US (3750)      // Interval of high duty cycle directed advertising events.
+
+#define SIM_GAP_HANDLE_END      (7)         // GAP service: handles 1 to 7.
+#define SIM_ATT_WRITE_RSP_LEN   (1)
+#define SIM_ATT_CONFIRM_LEN     (1)
+#define SIM_ATT_REQ_LEN         (7)         // Discovery or read request, without a UUID to match.
+#define SIM_ATT_ERROR_RSP_LEN   (5)
+#define SIM_ATT_LIST_RSP_HDR    (2)         // Opcode and entry length of a list response.
+#define SIM_ATT_CHAR_ENTRY_LEN  (5)         // Characteristic entry without its UUID.
+
+#define SIM_CCCD_LEN            (2)
+
+#define DEFAULT_SEED            (1)
+#define DEFAULT_TX_BUFFERS      (7)
+#define DEFAULT_PACKETS         (6)
+#define DEFAULT_PEER_INTERVAL   (12)        // 15 ms.
+#define DEFAULT_CONFIRM_EVENTS  (1)
+
+
+// Attribute in the GATT server table.
+typedef struct
+{
+    uint16_t   handle;
+    uint16_t   value_handle;    // For a CCCD, the characteristic value it configures.
+    uint16_t   cccd_handle;     // For a characteristic value, its CCCD or BLE_GATT_HANDLE_INVALID.
+    ble_uuid_t uuid;
+    uint8_t  * p_value;
+    uint16_t   len;
+    uint16_t   max_len;
+    bool       vlen;
+    bool       is_cccd;
+    bool       is_system;       // Belongs to the GATT service.
+    uint8_t    cccd_index;      // For a CCCD, the slot of its per-link value.
+} sim_attr_t;
+
+// Attribute in the peer's GATT server. Its handle is its index plus one.
+typedef struct
+{
+    uint16_t              type;         // Declaration or descriptor UUID, zero for a characteristic value.
+    ble_uuid_t            uuid;         // Service or characteristic UUID.
+    ble_gatt_char_props_t props;        // For a characteristic declaration.
+    uint16_t              end_handle;   // For a service declaration, its last handle.
+} sim_peer_attr_t;
+
+// ATT packet queued in either direction.
+typedef struct
+{
+    uint16_t handle;
+    uint8_t  op;                // HVX type or write operation.
+    bool     hvx;               // Sent by the peer's GATT server, op is the HVX type.
+    uint16_t len;
+    uint64_t queued_us;
+    uint8_t  data[SIM_ATT_DATA_MAX];
+} sim_pdu_t;
+
+typedef struct
+{
+    uint16_t len;
+    uint32_t buf[SIM_EVT_BUF_WORDS];
+} sim_evt_t;
+
+// What the device or the peer sends in a packet exchange.
+typedef enum
+{
+    SIM_TX_NONE,
+    SIM_TX_WRITE_RSP,
+    SIM_TX_CLIENT_REQ,
+    SIM_TX_HV_CONFIRM,
+    SIM_TX_INDICATION,
+    SIM_TX_NOTIFICATION,
+} sim_slave_tx_t;
+
+typedef enum
+{
+    SIM_RX_NONE,
+    SIM_RX_CONFIRM,
+    SIM_RX_CLIENT_RSP,
+    SIM_RX_WRITE,
+    SIM_RX_HVX,
+} sim_master_tx_t;
+
+// Pending GATT client procedure.
+typedef struct
+{
+    bool      busy;
+    bool      sent;
+    uint32_t  rsp_event;
+    uint16_t  req_len;          // ATT request and response lengths.
+    uint16_t  rsp_len;
+    sim_pdu_t write;            // Write request to the peer's server, handle is invalid for other procedures.
+    sim_evt_t rsp;              // Response event, built when the procedure starts.
+} sim_client_req_t;
+
+typedef struct
+{
+    uint16_t              conn_handle;          // BLE_CONN_HANDLE_INVALID if the link is free.
+    ble_gap_conn_params_t params;
+    ble_gap_conn_params_t new_params;
+    bool                  params_pending;
+    uint32_t              params_instant;
+    uint32_t              event_counter;
+    uint64_t              next_event_us;
+    uint64_t              last_rx_us;
+    uint16_t              latency_used;
+    bool                  sys_attr_set;
+    bool                  sys_attr_missing_sent;
+    uint16_t              cccd[BLE_SIM_ATTR_MAX];
+    bool                  disconnect_pending;
+
+    sim_pdu_t             tx[BLE_SIM_TX_BUFFER_MAX];
+    uint8_t               tx_head;
+    uint8_t               tx_count;
+    uint8_t               tx_done;              // Buffers released in this connection event.
+    sim_slave_tx_t        tx_kind;              // Packet being fragmented.
+    uint8_t               tx_frags;             // Fragments of it sent so far.
+
+    sim_pdu_t             ind;
+    bool                  ind_queued;
+    bool                  ind_sent;
+    uint32_t              ind_confirm_event;
+
+    sim_pdu_t             rx[BLE_SIM_PEER_QUEUE_SIZE];
+    uint8_t               rx_head;
+    uint8_t               rx_count;
+    sim_master_tx_t       rx_kind;
+    uint8_t               rx_frags;
+    bool                  write_rsp_pending;    // Peer waits for a write response.
+    bool                  write_rsp_due;        // The device has the response ready.
+    uint32_t              write_rsp_event;
+    bool                  hvc_pending;          // Peer waits for the confirmation of an indication.
+    bool                  hvc_due;              // The device has confirmed it.
+
+    sim_client_req_t      client;
+
+    ble_sim_link_stats_t  stats;                // elapsed_us is filled in when read.
+    uint64_t              stats_start_us;
+} sim_link_t;
+
+
+static ble_sim_config_t      m_config;
+static ble_sim_stats_t       m_stats;
+static uint64_t              m_time_us;
+static uint32_t              m_rand_state;
+static bool                  m_enabled;
+static bool                  m_dispatching;
+
+static sim_evt_t             m_evt_queue[SIM_EVT_QUEUE_SIZE];
+static uint8_t               m_evt_head;
+static uint8_t               m_evt_count;
+
+static sim_attr_t            m_attrs[BLE_SIM_ATTR_MAX];
+static uint16_t              m_attr_count;
+static uint8_t               m_cccd_count;
+static uint16_t              m_next_handle;
+static uint8_t               m_attr_pool[BLE_SIM_ATTR_POOL_SIZE];
+static uint16_t              m_attr_pool_used;
+static uint16_t              m_sc_value_handle;
+
+static ble_uuid128_t         m_vs_uuids[BLE_SIM_VS_UUID_MAX];
+static uint8_t               m_vs_uuid_count;
+static uint8_t               m_vs_uuid_max;
+
+static ble_gap_addr_t        m_addr;
+static uint8_t               m_dev_name[BLE_GAP_DEVNAME_MAX_LEN];
+static uint16_t              m_dev_name_len;
+static uint16_t              m_appearance;
+static ble_gap_conn_params_t m_ppcp;
+static uint8_t               m_adv_data[BLE_GAP_ADV_MAX_SIZE];
+static uint8_t               m_adv_data_len;
+static bool                  m_advertising;
+static uint64_t              m_adv_deadline_us;     // Zero if advertising does not time out.
+static uint64_t              m_adv_start_us;
+static uint32_t              m_adv_event_us;        // Zero for high duty cycle directed advertising.
+
+static sim_link_t            m_links[BLE_SIM_LINK_COUNT];
+static uint8_t               m_link_max;
+static ble_gap_addr_t        m_peer_addr;
+static bool                  m_peer_addr_set;       // False to give each link its own random static address.
+static sim_peer_attr_t       m_peer_attrs[BLE_SIM_PEER_ATTR_MAX];
+static uint16_t              m_peer_attr_count;
+
+
+// xorshift32, so that runs with the same seed are identical on every host.
+static uint32_t rand_next(void)
+{
+    uint32_t x = m_rand_state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    m_rand_state = x;
+
+    return x;
+}
+
+
+static bool exchange_lost(void)
+{
+    return (m_config.loss_permille != 0) && ((rand_next() % 1000) < m_config.loss_permille);
+}
+
+
+static uint16_t att_payload_max(void)
+{
+    return m_config.att_mtu - 3;
+}
+
+
+static uint32_t interval_us(sim_link_t const * p_link)
+{
+    return (uint32_t)p_link->params.max_conn_interval * 1250;
+}
+
+
+// LL packets needed to carry an ATT packet of the given length.
+static uint8_t frag_count(uint16_t att_len)
+{
+    return (uint8_t)((att_len + SIM_L2CAP_HDR_LEN + SIM_LL_PAYLOAD_MAX - 1) / SIM_LL_PAYLOAD_MAX);
+}
+
+
+// Air time of the LL packet carrying fragment frag of an ATT packet, zero length if empty.
+static uint32_t ll_packet_us(uint16_t att_len, uint8_t frag)
+{
+    uint32_t payload = 0;
+
+    if (att_len != 0)
+    {
+        uint32_t const l2cap_len = att_len + SIM_L2CAP_HDR_LEN;
+        uint32_t const offset    = (uint32_t)frag * SIM_LL_PAYLOAD_MAX;
+
+        payload = l2cap_len - offset;
+        if (payload > SIM_LL_PAYLOAD_MAX)
+        {
+            payload = SIM_LL_PAYLOAD_MAX;
+        }
+    }
+
+    return (SIM_LL_OVERHEAD_BYTES + payload) * 8;
+}
+
+
+/**@brief Function for reserving an event in the queue.
+ *
+ * @return  The zeroed event, with the header filled in.
+ */
+static ble_evt_t * evt_alloc(uint16_t evt_id, uint16_t data_len)
+{
+    sim_evt_t * p_entry;
+    ble_evt_t * p_evt;
+
+    if (m_evt_count == SIM_EVT_QUEUE_SIZE)
+    {
+        // The application stopped pulling events. A real SoftDevice would stall the link.
+        abort();
+    }
+
+    p_entry = &m_evt_queue[(m_evt_head + m_evt_count) % SIM_EVT_QUEUE_SIZE];
+    m_evt_count++;
+
+    memset(p_entry, 0, sizeof(*p_entry));
+    p_entry->len = sizeof(ble_evt_t) + data_len;
+
+    p_evt                  = (ble_evt_t *)p_entry->buf;
+    p_evt->header.evt_id   = evt_id;
+    p_evt->header.evt_len  = p_entry->len;
+
+    return p_evt;
+}
+
+
+static sim_link_t * link_get(uint16_t conn_handle)
+{
+    if ((conn_handle >= BLE_SIM_LINK_COUNT) ||
+        (m_links[conn_handle].conn_handle == BLE_CONN_HANDLE_INVALID))
+    {
+        return NULL;
+    }
+
+    return &m_links[conn_handle];
+}
+
+
+static sim_attr_t * attr_find(uint16_t handle)
+{
+    for (uint16_t i = 0; i < m_attr_count; i++)
+    {
+        if (m_attrs[i].handle == handle)
+        {
+            return &m_attrs[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+static sim_peer_attr_t const * peer_attr_get(uint16_t handle)
+{
+    if ((handle == BLE_GATT_HANDLE_INVALID) || (handle > m_peer_attr_count))
+    {
+        return NULL;
+    }
+
+    return &m_peer_attrs[handle - 1];
+}
+
+
+// Whether the peer accepts writes to an attribute: characteristic values and CCCDs.
+static bool peer_attr_writable(uint16_t handle)
+{
+    sim_peer_attr_t const * p_attr = peer_attr_get(handle);
+
+    return (p_attr != NULL) &&
+           (p_attr->type != BLE_UUID_SERVICE_PRIMARY) && (p_attr->type != BLE_UUID_CHARACTERISTIC);
+}
+
+
+// The type of a peer attribute, as descriptor discovery reports it.
+static ble_uuid_t peer_attr_uuid(sim_peer_attr_t const * p_attr)
+{
+    ble_uuid_t uuid = {p_attr->type, BLE_UUID_TYPE_BLE};
+
+    return (p_attr->type == 0) ? p_attr->uuid : uuid;
+}
+
+
+// Length of a UUID on air.
+static uint8_t uuid_len(ble_uuid_t const * p_uuid)
+{
+    return (p_uuid->type >= BLE_UUID_TYPE_VENDOR_BEGIN) ? 16 : 2;
+}
+
+
+/**@brief Function for adding an attribute to the table.
+ *
+ * @details Values kept in the stack are allocated from the attribute pool and initialised from
+ *          @p p_attr. User values are used in place.
+ */
+static uint32_t attr_add(ble_gatts_attr_t const * p_attr, sim_attr_t ** pp_attr)
+{
+    sim_attr_t * p_new;
+    uint8_t      vloc;
+
+    if ((p_attr == NULL) || (p_attr->p_uuid == NULL) || (p_attr->p_attr_md == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    vloc = p_attr->p_attr_md->vloc;
+
+    if ((p_attr->max_len > BLE_GATTS_VAR_ATTR_LEN_MAX) ||
+        (p_attr->init_offs + p_attr->init_len > p_attr->max_len) ||
+        ((vloc != BLE_GATTS_VLOC_STACK) && (vloc != BLE_GATTS_VLOC_USER)))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    if ((vloc == BLE_GATTS_VLOC_USER) && (p_attr->p_value == NULL))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    if (m_attr_count == BLE_SIM_ATTR_MAX)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    p_new = &m_attrs[m_attr_count];
+    memset(p_new, 0, sizeof(*p_new));
+
+    if (vloc == BLE_GATTS_VLOC_STACK)
+    {
+        if (m_attr_pool_used + p_attr->max_len > BLE_SIM_ATTR_POOL_SIZE)
+        {
+            return NRF_ERROR_NO_MEM;
+        }
+        p_new->p_value    = &m_attr_pool[m_attr_pool_used];
+        m_attr_pool_used += p_attr->max_len;
+
+        if (p_attr->p_value != NULL)
+        {
+            memcpy(p_new->p_value + p_attr->init_offs,
+                   p_attr->p_value + p_attr->init_offs,
+                   p_attr->init_len);
+        }
+    }
+    else
+    {
+        p_new->p_value = p_attr->p_value;
+    }
+
+    m_attr_count++;
+
+    p_new->handle      = m_next_handle++;
+    p_new->cccd_handle = BLE_GATT_HANDLE_INVALID;
+    p_new->uuid        = *p_attr->p_uuid;
+    p_new->max_len     = p_attr->max_len;
+    p_new->vlen        = p_attr->p_attr_md->vlen;
+    p_new->len         = p_new->vlen ? (p_attr->init_offs + p_attr->init_len) : p_attr->max_len;
+
+    *pp_attr = p_new;
+
+    return NRF_SUCCESS;
+}
+
+
+// Adds the CCCD of the characteristic value p_value_attr.
+static uint32_t cccd_add(sim_attr_t * p_value_attr, bool is_system)
+{
+    static uint8_t       cccd_init[SIM_CCCD_LEN];
+    ble_uuid_t           uuid    = {BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG, BLE_UUID_TYPE_BLE};
+    ble_gatts_attr_md_t  attr_md = {.vloc = BLE_GATTS_VLOC_STACK};
+    ble_gatts_attr_t     attr    =
+    {
+        .p_uuid    = &uuid,
+        .p_attr_md = &attr_md,
+        .init_len  = SIM_CCCD_LEN,
+        .max_len   = SIM_CCCD_LEN,
+        .p_value   = cccd_init,
+    };
+    uint16_t const value_handle = p_value_attr->handle;
+    sim_attr_t   * p_cccd;
+    uint32_t       err_code;
+
+    err_code = attr_add(&attr, &p_cccd);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    // attr_add() may not move entries, so p_value_attr is still valid.
+    p_cccd->is_cccd      = true;
+    p_cccd->is_system    = is_system;
+    p_cccd->value_handle = value_handle;
+    p_cccd->cccd_index   = m_cccd_count++;
+    p_value_attr->cccd_handle = p_cccd->handle;
+
+    return NRF_SUCCESS;
+}
+
+
+static uint16_t cccd_get(sim_link_t const * p_link, uint16_t value_handle)
+{
+    sim_attr_t const * p_value = attr_find(value_handle);
+    sim_attr_t const * p_cccd;
+
+    if ((p_value == NULL) || (p_value->cccd_handle == BLE_GATT_HANDLE_INVALID))
+    {
+        return 0;
+    }
+
+    p_cccd = attr_find(p_value->cccd_handle);
+
+    return p_link->cccd[p_cccd->cccd_index];
+}
+
+
+// Writes data to an attribute value, as sd_ble_gatts_value_set() and peer writes do.
+static void attr_write(sim_attr_t * p_attr, uint16_t offset, uint8_t const * p_data, uint16_t len)
+{
+    if (offset + len > p_attr->max_len)
+    {
+        len = (offset < p_attr->max_len) ? (p_attr->max_len - offset) : 0;
+    }
+
+    if ((p_data != NULL) && (len != 0))
+    {
+        memcpy(p_attr->p_value + offset, p_data, len);
+    }
+
+    if (p_attr->vlen)
+    {
+        p_attr->len = offset + len;
+    }
+}
+
+
+static uint16_t crc16(uint8_t const * p_data, uint32_t size)
+{
+    uint16_t crc = 0xFFFF;
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        crc  = (uint8_t)(crc >> 8) | (crc << 8);
+        crc ^= p_data[i];
+        crc ^= (uint8_t)(crc & 0xFF) >> 4;
+        crc ^= (crc << 8) << 4;
+        crc ^= ((crc & 0xFF) << 4) << 1;
+    }
+
+    return crc;
+}
+
+
+static bool sys_attr_selected(sim_attr_t const * p_attr, uint32_t flags)
+{
+    if (!p_attr->is_cccd)
+    {
+        return false;
+    }
+    if (flags == 0)
+    {
+        return true;
+    }
+    if ((flags & BLE_GATTS_SYS_ATTR_FLAG_SYS_SRVCS) && p_attr->is_system)
+    {
+        return true;
+    }
+    if ((flags & BLE_GATTS_SYS_ATTR_FLAG_USR_SRVCS) && !p_attr->is_system)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+
+static void link_close(sim_link_t * p_link, uint8_t reason)
+{
+    ble_evt_t * p_evt = evt_alloc(BLE_GAP_EVT_DISCONNECTED, 0);
+
+    p_evt->evt.gap_evt.conn_handle                = p_link->conn_handle;
+    p_evt->evt.gap_evt.params.disconnected.reason = reason;
+
+    memset(p_link, 0, sizeof(*p_link));
+    p_link->conn_handle = BLE_CONN_HANDLE_INVALID;
+}
+
+
+// Whether the device has a packet to send in the current connection event.
+static sim_slave_tx_t slave_tx_next(sim_link_t const * p_link, uint16_t * p_att_len)
+{
+    sim_slave_tx_t kind = SIM_TX_NONE;
+
+    if (p_link->tx_kind != SIM_TX_NONE)
+    {
+        kind = p_link->tx_kind;
+    }
+    else if (p_link->write_rsp_due && (p_link->event_counter >= p_link->write_rsp_event))
+    {
+        kind = SIM_TX_WRITE_RSP;
+    }
+    else if (p_link->hvc_due)
+    {
+        kind = SIM_TX_HV_CONFIRM;
+    }
+    else if (p_link->client.busy && !p_link->client.sent)
+    {
+        kind = SIM_TX_CLIENT_REQ;
+    }
+    else if (p_link->ind_queued && !p_link->ind_sent)
+    {
+        kind = SIM_TX_INDICATION;
+    }
+    else if (p_link->tx_count != 0)
+    {
+        kind = SIM_TX_NOTIFICATION;
+    }
+
+    switch (kind)
+    {
+        case SIM_TX_WRITE_RSP:    *p_att_len = SIM_ATT_WRITE_RSP_LEN;                       break;
+        case SIM_TX_CLIENT_REQ:   *p_att_len = p_link->client.req_len;                      break;
+        case SIM_TX_HV_CONFIRM:   *p_att_len = SIM_ATT_CONFIRM_LEN;                         break;
+        case SIM_TX_INDICATION:   *p_att_len = 3 + p_link->ind.len;                         break;
+        case SIM_TX_NOTIFICATION: *p_att_len = 3 + p_link->tx[p_link->tx_head].len;         break;
+        default:                  *p_att_len = 0;                                           break;
+    }
+
+    return kind;
+}
+
+
+// Whether the peer has a packet to send in the current connection event.
+static sim_master_tx_t master_tx_next(sim_link_t const * p_link, uint16_t * p_att_len)
+{
+    sim_master_tx_t kind = SIM_RX_NONE;
+
+    if (p_link->rx_kind != SIM_RX_NONE)
+    {
+        kind = p_link->rx_kind;
+    }
+    else if (p_link->ind_sent && (p_link->event_counter >= p_link->ind_confirm_event))
+    {
+        kind = SIM_RX_CONFIRM;
+    }
+    else if (p_link->client.sent && (p_link->event_counter >= p_link->client.rsp_event))
+    {
+        kind = SIM_RX_CLIENT_RSP;
+    }
+    else if (p_link->rx_count != 0)
+    {
+        sim_pdu_t const * p_head = &p_link->rx[p_link->rx_head];
+
+        if (p_head->hvx)
+        {
+            // An indication waits for the confirmation of the previous one.
+            if ((p_head->op != BLE_GATT_HVX_INDICATION) || !p_link->hvc_pending)
+            {
+                kind = SIM_RX_HVX;
+            }
+        }
+        // A write request waits for the response to the previous one.
+        else if ((p_head->op != BLE_GATT_OP_WRITE_REQ) || !p_link->write_rsp_pending)
+        {
+            kind = SIM_RX_WRITE;
+        }
+    }
+
+    switch (kind)
+    {
+        case SIM_RX_CONFIRM:    *p_att_len = SIM_ATT_CONFIRM_LEN;                           break;
+        case SIM_RX_CLIENT_RSP: *p_att_len = p_link->client.rsp_len;                        break;
+        case SIM_RX_WRITE:
+        case SIM_RX_HVX:        *p_att_len = 3 + p_link->rx[p_link->rx_head].len;           break;
+        default:                *p_att_len = 0;                                             break;
+    }
+
+    return kind;
+}
+
+
+static void peer_rx(sim_link_t * p_link, sim_pdu_t const * p_pdu)
+{
+    m_stats.bytes_to_peer += p_pdu->len;
+    p_link->stats.bytes_to_peer += p_pdu->len;
+
+    if (m_config.peer_rx_handler != NULL)
+    {
+        m_config.peer_rx_handler(p_link->conn_handle, p_pdu->handle, p_pdu->op, p_pdu->data, p_pdu->len);
+    }
+}
+
+
+// Hands a write from the GATT client to the peer's server, which drops writes it does not accept.
+static void peer_write(sim_link_t * p_link, sim_pdu_t const * p_pdu)
+{
+    if ((m_config.peer_write_handler != NULL) && peer_attr_writable(p_pdu->handle))
+    {
+        m_config.peer_write_handler(p_link->conn_handle, p_pdu->handle, p_pdu->op, p_pdu->data, p_pdu->len);
+    }
+}
+
+
+static void slave_tx_complete(sim_link_t * p_link, sim_slave_tx_t kind, uint64_t now_us)
+{
+    switch (kind)
+    {
+        case SIM_TX_WRITE_RSP:
+            p_link->write_rsp_due     = false;
+            p_link->write_rsp_pending = false;
+            break;
+
+        case SIM_TX_CLIENT_REQ:
+            p_link->client.sent      = true;
+            p_link->client.rsp_event = p_link->event_counter + 1;
+            if (p_link->client.write.handle != BLE_GATT_HANDLE_INVALID)
+            {
+                peer_write(p_link, &p_link->client.write);
+            }
+            break;
+
+        case SIM_TX_HV_CONFIRM:
+            p_link->hvc_pending = false;
+            p_link->hvc_due     = false;
+            break;
+
+        case SIM_TX_INDICATION:
+            p_link->ind_sent          = true;
+            p_link->ind_confirm_event = p_link->event_counter + m_config.peer_confirm_events;
+            peer_rx(p_link, &p_link->ind);
+            break;
+
+        case SIM_TX_NOTIFICATION:
+        {
+            sim_pdu_t const * p_pdu   = &p_link->tx[p_link->tx_head];
+            uint64_t const    latency = now_us - p_pdu->queued_us;
+
+            if (latency > m_stats.max_tx_latency_us)
+            {
+                m_stats.max_tx_latency_us = (uint32_t)latency;
+            }
+            // Write commands from the GATT client share the buffers, and go to the peer's server.
+            if (p_pdu->op != BLE_GATT_OP_WRITE_CMD)
+            {
+                m_stats.notifications++;
+                p_link->stats.notifications++;
+                peer_rx(p_link, p_pdu);
+            }
+            else
+            {
+                peer_write(p_link, p_pdu);
+            }
+
+            p_link->tx_head = (p_link->tx_head + 1) % BLE_SIM_TX_BUFFER_MAX;
+            p_link->tx_count--;
+            p_link->tx_done++;
+        } break;
+
+        default:
+            break;
+    }
+}
+
+
+// Applies a write from the peer. Returns false if it must wait for the system attributes.
+static bool peer_write_apply(sim_link_t * p_link, sim_pdu_t const * p_pdu)
+{
+    sim_attr_t * p_attr = attr_find(p_pdu->handle);
+    ble_evt_t  * p_evt;
+
+    if ((p_attr != NULL) && p_attr->is_cccd)
+    {
+        if (!p_link->sys_attr_set)
+        {
+            if (!p_link->sys_attr_missing_sent)
+            {
+                p_evt = evt_alloc(BLE_GATTS_EVT_SYS_ATTR_MISSING, 0);
+                p_evt->evt.gatts_evt.conn_handle = p_link->conn_handle;
+                p_link->sys_attr_missing_sent    = true;
+            }
+            return false;
+        }
+        p_link->cccd[p_attr->cccd_index] = uint16_decode(p_pdu->data);
+    }
+    else if (p_attr != NULL)
+    {
+        attr_write(p_attr, 0, p_pdu->data, p_pdu->len);
+    }
+
+    if (p_pdu->op == BLE_GATT_OP_WRITE_REQ)
+    {
+        p_link->write_rsp_pending = true;
+        p_link->write_rsp_due     = true;
+        p_link->write_rsp_event   = p_link->event_counter + 1;
+    }
+
+    if (p_attr == NULL)
+    {
+        // The stack answers with an ATT error and the application is not told.
+        return true;
+    }
+
+    p_evt = evt_alloc(BLE_GATTS_EVT_WRITE, p_pdu->len);
+    p_evt->evt.gatts_evt.conn_handle         = p_link->conn_handle;
+    p_evt->evt.gatts_evt.params.write.handle = p_pdu->handle;
+    p_evt->evt.gatts_evt.params.write.uuid   = p_attr->uuid;
+    p_evt->evt.gatts_evt.params.write.op     = p_pdu->op;
+    p_evt->evt.gatts_evt.params.write.len    = p_pdu->len;
+    memcpy(p_evt->evt.gatts_evt.params.write.data, p_pdu->data, p_pdu->len);
+
+    m_stats.peer_writes++;
+    m_stats.bytes_from_peer += p_pdu->len;
+    p_link->stats.peer_writes++;
+    p_link->stats.bytes_from_peer += p_pdu->len;
+
+    return true;
+}
+
+
+// Returns false if the packet could not be delivered and the peer must resend it.
+static bool master_tx_complete(sim_link_t * p_link, sim_master_tx_t kind)
+{
+    ble_evt_t * p_evt;
+
+    switch (kind)
+    {
+        case SIM_RX_CONFIRM:
+            p_link->ind_queued = false;
+            p_link->ind_sent   = false;
+            m_stats.indications++;
+            p_link->stats.indications++;
+
+            p_evt = evt_alloc(BLE_GATTS_EVT_HVC, 0);
+            p_evt->evt.gatts_evt.conn_handle       = p_link->conn_handle;
+            p_evt->evt.gatts_evt.params.hvc.handle = p_link->ind.handle;
+            break;
+
+        case SIM_RX_CLIENT_RSP:
+        {
+            sim_evt_t const * p_rsp = &p_link->client.rsp;
+
+            p_evt = evt_alloc(((ble_evt_t const *)p_rsp->buf)->header.evt_id,
+                              p_rsp->len - sizeof(ble_evt_t));
+            memcpy(p_evt, p_rsp->buf, p_rsp->len);
+            memset(&p_link->client, 0, sizeof(p_link->client));
+        } break;
+
+        case SIM_RX_HVX:
+        {
+            sim_pdu_t const * p_pdu = &p_link->rx[p_link->rx_head];
+
+            p_evt = evt_alloc(BLE_GATTC_EVT_HVX, p_pdu->len);
+            p_evt->evt.gattc_evt.conn_handle       = p_link->conn_handle;
+            p_evt->evt.gattc_evt.params.hvx.handle = p_pdu->handle;
+            p_evt->evt.gattc_evt.params.hvx.type   = p_pdu->op;
+            p_evt->evt.gattc_evt.params.hvx.len    = p_pdu->len;
+            memcpy(p_evt->evt.gattc_evt.params.hvx.data, p_pdu->data, p_pdu->len);
+
+            if (p_pdu->op == BLE_GATT_HVX_INDICATION)
+            {
+                p_link->hvc_pending = true;
+            }
+            m_stats.bytes_from_peer += p_pdu->len;
+            p_link->stats.bytes_from_peer += p_pdu->len;
+
+            p_link->rx_head = (p_link->rx_head + 1) % BLE_SIM_PEER_QUEUE_SIZE;
+            p_link->rx_count--;
+        } break;
+
+        case SIM_RX_WRITE:
+            if (!peer_write_apply(p_link, &p_link->rx[p_link->rx_head]))
+            {
+                return false;
+            }
+            p_link->rx_head = (p_link->rx_head + 1) % BLE_SIM_PEER_QUEUE_SIZE;
+            p_link->rx_count--;
+            break;
+
+        default:
+            break;
+    }
+
+    return true;
+}
+
+
+/**@brief Function for holding one connection event.
+ *
+ * @details Each packet exchange carries one LL packet from the peer and one from the device.
+ *          ATT packets longer than an LL payload take several exchanges. The event ends when
+ *          neither side has more to send, when the packet budget or the interval is used up, or
+ *          when an exchange is lost.
+ */
+static void conn_event(sim_link_t * p_link)
+{
+    uint64_t const anchor_us   = p_link->next_event_us;
+    uint32_t       elapsed_us  = 0;
+    uint8_t        packets     = 0;
+    bool           peer_blocked = false;
+
+    p_link->event_counter++;
+    p_link->next_event_us += interval_us(p_link);
+
+    if (anchor_us - p_link->last_rx_us > (uint64_t)p_link->params.conn_sup_timeout * 10000)
+    {
+        m_stats.supervision_timeouts++;
+        link_close(p_link, BLE_HCI_CONNECTION_TIMEOUT);
+        return;
+    }
+
+    if (p_link->disconnect_pending)
+    {
+        link_close(p_link, BLE_HCI_LOCAL_HOST_TERMINATED_CONNECTION);
+        return;
+    }
+
+    if (p_link->params_pending && (p_link->event_counter == p_link->params_instant))
+    {
+        ble_evt_t * p_evt = evt_alloc(BLE_GAP_EVT_CONN_PARAM_UPDATE, 0);
+
+        p_link->params         = p_link->new_params;
+        p_link->params_pending = false;
+        p_link->next_event_us  = anchor_us + interval_us(p_link);
+
+        p_evt->evt.gap_evt.conn_handle                          = p_link->conn_handle;
+        p_evt->evt.gap_evt.params.conn_param_update.conn_params = p_link->params;
+    }
+
+    p_link->tx_done = 0;
+
+    for (;;)
+    {
+        uint16_t        s_len;
+        uint16_t        m_len;
+        sim_slave_tx_t  s_kind = slave_tx_next(p_link, &s_len);
+        sim_master_tx_t m_kind = peer_blocked ? SIM_RX_NONE : master_tx_next(p_link, &m_len);
+        uint32_t        exchange_us;
+
+        if (m_kind == SIM_RX_NONE)
+        {
+            m_len = 0;
+        }
+
+        if (packets == 0)
+        {
+            // Slave latency lets the device sleep through events with no traffic.
+            if ((s_kind == SIM_TX_NONE) && (m_kind == SIM_RX_NONE) &&
+                (p_link->latency_used < p_link->params.slave_latency))
+            {
+                p_link->latency_used++;
+                m_stats.skipped_events++;
+                return;
+            }
+            p_link->latency_used = 0;
+            m_stats.conn_events++;
+            p_link->stats.conn_events++;
+        }
+        else if ((s_kind == SIM_TX_NONE) && (m_kind == SIM_RX_NONE))
+        {
+            break;
+        }
+
+        exchange_us = ll_packet_us(m_len, p_link->rx_frags) + SIM_IFS_US +
+                      ll_packet_us(s_len, p_link->tx_frags) + SIM_IFS_US;
+
+        if ((packets != 0) &&
+            ((packets >= m_config.packets_per_event) ||
+             (elapsed_us + exchange_us + SIM_EVENT_GUARD_US > interval_us(p_link))))
+        {
+            break;
+        }
+
+        elapsed_us += exchange_us;
+        packets++;
+
+        if (exchange_lost())
+        {
+            m_stats.lost_exchanges++;
+            break;
+        }
+
+        m_stats.exchanges++;
+        p_link->last_rx_us = anchor_us + elapsed_us;
+
+        if (m_kind != SIM_RX_NONE)
+        {
+            p_link->rx_kind = m_kind;
+            if (++p_link->rx_frags == frag_count(m_len))
+            {
+                p_link->rx_kind  = SIM_RX_NONE;
+                p_link->rx_frags = 0;
+                peer_blocked     = !master_tx_complete(p_link, m_kind);
+            }
+        }
+
+        if (s_kind != SIM_TX_NONE)
+        {
+            p_link->tx_kind = s_kind;
+            if (++p_link->tx_frags == frag_count(s_len))
+            {
+                p_link->tx_kind  = SIM_TX_NONE;
+                p_link->tx_frags = 0;
+                slave_tx_complete(p_link, s_kind, anchor_us + elapsed_us);
+            }
+        }
+    }
+
+    if (p_link->tx_done != 0)
+    {
+        ble_evt_t * p_evt = evt_alloc(BLE_EVT_TX_COMPLETE, 0);
+
+        p_evt->evt.common_evt.conn_handle              = p_link->conn_handle;
+        p_evt->evt.common_evt.params.tx_complete.count = p_link->tx_done;
+    }
+}
+
+
+// Counts the advertising events sent since advertising started, the first one at the start.
+static void adv_end(void)
+{
+    uint64_t elapsed_us = m_time_us - m_adv_start_us;
+
+    m_advertising = false;
+
+    if (m_adv_event_us == 0)
+    {
+        m_stats.directed_adv_events += (uint32_t)(elapsed_us / SIM_DIRECT_ADV_EVENT_US) + 1;
+    }
+    else
+    {
+        m_stats.adv_events += (uint32_t)(elapsed_us / m_adv_event_us) + 1;
+    }
+}
+
+
+static void adv_timeout(void)
+{
+    ble_evt_t * p_evt = evt_alloc(BLE_GAP_EVT_TIMEOUT, 0);
+
+    adv_end();
+
+    p_evt->evt.gap_evt.conn_handle        = BLE_CONN_HANDLE_INVALID;
+    p_evt->evt.gap_evt.params.timeout.src = BLE_GAP_TIMEOUT_SRC_ADVERTISING;
+}
+
+
+// Queues a packet in the application TX buffers.
+static uint32_t tx_queue(sim_link_t    * p_link,
+                         uint16_t        handle,
+                         uint8_t         op,
+                         uint8_t const * p_data,
+                         uint16_t        len)
+{
+    sim_pdu_t * p_pdu;
+
+    if (p_link->tx_count == m_config.tx_buffer_count)
+    {
+        m_stats.no_tx_packets++;
+        return BLE_ERROR_NO_TX_PACKETS;
+    }
+
+    p_pdu = &p_link->tx[(p_link->tx_head + p_link->tx_count) % BLE_SIM_TX_BUFFER_MAX];
+    p_link->tx_count++;
+
+    p_pdu->handle    = handle;
+    p_pdu->op        = op;
+    p_pdu->len       = len;
+    p_pdu->queued_us = m_time_us;
+    memcpy(p_pdu->data, p_data, len);
+
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t indication_queue(sim_link_t * p_link, uint16_t handle, uint8_t const * p_data, uint16_t len)
+{
+    if (p_link->ind_queued)
+    {
+        m_stats.busy_rejects++;
+        return NRF_ERROR_BUSY;
+    }
+
+    p_link->ind.handle    = handle;
+    p_link->ind.op        = BLE_GATT_HVX_INDICATION;
+    p_link->ind.len       = len;
+    p_link->ind.queued_us = m_time_us;
+    memcpy(p_link->ind.data, p_data, len);
+
+    p_link->ind_queued = true;
+    p_link->ind_sent   = false;
+
+    return NRF_SUCCESS;
+}
+
+
+// Queues a packet from the peer.
+static uint32_t peer_queue(sim_link_t    * p_link,
+                           uint16_t        handle,
+                           uint8_t         op,
+                           bool            hvx,
+                           uint8_t const * p_data,
+                           uint16_t        len)
+{
+    sim_pdu_t * p_pdu;
+
+    if (p_link->rx_count == BLE_SIM_PEER_QUEUE_SIZE)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    p_pdu = &p_link->rx[(p_link->rx_head + p_link->rx_count) % BLE_SIM_PEER_QUEUE_SIZE];
+    p_link->rx_count++;
+
+    p_pdu->handle    = handle;
+    p_pdu->op        = op;
+    p_pdu->hvx       = hvx;
+    p_pdu->len       = len;
+    p_pdu->queued_us = m_time_us;
+    memcpy(p_pdu->data, p_data, len);
+
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for starting a GATT client procedure.
+ *
+ * @details The response comes from the peer's server as it is when the procedure starts. The
+ *          caller builds it in the returned request, which answers with an ATT error until the
+ *          caller sets a response length.
+ */
+static uint32_t client_req_start(uint16_t            conn_handle,
+                                 uint16_t            evt_id,
+                                 uint16_t            req_len,
+                                 sim_client_req_t ** pp_req)
+{
+    sim_link_t       * p_link = link_get(conn_handle);
+    sim_client_req_t * p_req;
+    ble_evt_t        * p_rsp;
+
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if (p_link->client.busy)
+    {
+        m_stats.busy_rejects++;
+        return NRF_ERROR_BUSY;
+    }
+
+    p_req = &p_link->client;
+    memset(p_req, 0, sizeof(*p_req));
+    p_req->busy    = true;
+    p_req->req_len = req_len;
+    p_req->rsp_len = SIM_ATT_ERROR_RSP_LEN;
+    p_req->rsp.len = sizeof(ble_evt_t);
+
+    p_rsp = (ble_evt_t *)p_req->rsp.buf;
+    p_rsp->header.evt_id             = evt_id;
+    p_rsp->header.evt_len            = p_req->rsp.len;
+    p_rsp->evt.gattc_evt.conn_handle = conn_handle;
+
+    *pp_req = p_req;
+
+    return NRF_SUCCESS;
+}
+
+
+static ble_gattc_evt_t * client_rsp(sim_client_req_t * p_req)
+{
+    return &((ble_evt_t *)p_req->rsp.buf)->evt.gattc_evt;
+}
+
+
+static void client_error(sim_client_req_t * p_req, uint16_t gatt_status, uint16_t error_handle)
+{
+    p_req->rsp_len                  = SIM_ATT_ERROR_RSP_LEN;
+    client_rsp(p_req)->gatt_status  = gatt_status;
+    client_rsp(p_req)->error_handle = error_handle;
+}
+
+
+// Grows the response event up to p_end. Returns false if it would not fit in an event buffer.
+static bool client_rsp_extend(sim_client_req_t * p_req, void const * p_end)
+{
+    size_t const len = (size_t)((uint8_t const *)p_end - (uint8_t const *)p_req->rsp.buf);
+
+    if (len > sizeof(p_req->rsp.buf))
+    {
+        return false;
+    }
+    if (len > p_req->rsp.len)
+    {
+        p_req->rsp.len = (uint16_t)len;
+        ((ble_evt_t *)p_req->rsp.buf)->header.evt_len = p_req->rsp.len;
+    }
+
+    return true;
+}
+
+
+/**@brief Function for sending the next due event: a connection event or an advertising timeout.
+ *
+ * @return  false if nothing is due at or before end_us.
+ */
+static bool next_event_run(uint64_t end_us)
+{
+    sim_link_t * p_next = NULL;
+    uint64_t     next_us = UINT64_MAX;
+
+    for (uint8_t i = 0; i < BLE_SIM_LINK_COUNT; i++)
+    {
+        if ((m_links[i].conn_handle != BLE_CONN_HANDLE_INVALID) &&
+            (m_links[i].next_event_us < next_us))
+        {
+            p_next  = &m_links[i];
+            next_us = m_links[i].next_event_us;
+        }
+    }
+
+    if (m_advertising && (m_adv_deadline_us != 0) && (m_adv_deadline_us < next_us))
+    {
+        p_next  = NULL;
+        next_us = m_adv_deadline_us;
+    }
+
+    if (next_us > end_us)
+    {
+        return false;
+    }
+
+    m_time_us = next_us;
+
+    if (p_next != NULL)
+    {
+        conn_event(p_next);
+    }
+    else
+    {
+        adv_timeout();
+    }
+
+    (void)ble_sim_process();
+
+    return true;
+}
+
+
+uint32_t ble_sim_init(ble_sim_config_t const * p_config)
+{
+    if (p_config == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    if ((p_config->att_mtu > BLE_SIM_ATT_MTU_MAX) ||
+        ((p_config->att_mtu != 0) && (p_config->att_mtu < GATT_MTU_SIZE_DEFAULT)) ||
+        (p_config->tx_buffer_count > BLE_SIM_TX_BUFFER_MAX) ||
+        (p_config->loss_permille > 1000))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_config = *p_config;
+
+    if (m_config.seed == 0)
+    {
+        m_config.seed = DEFAULT_SEED;
+    }
+    if (m_config.att_mtu == 0)
+    {
+        m_config.att_mtu = GATT_MTU_SIZE_DEFAULT;
+    }
+    if (m_config.tx_buffer_count == 0)
+    {
+        m_config.tx_buffer_count = DEFAULT_TX_BUFFERS;
+    }
+    if (m_config.packets_per_event == 0)
+    {
+        m_config.packets_per_event = DEFAULT_PACKETS;
+    }
+    if (m_config.peer_min_interval == 0)
+    {
+        m_config.peer_min_interval = DEFAULT_PEER_INTERVAL;
+    }
+    if (m_config.peer_confirm_events == 0)
+    {
+        m_config.peer_confirm_events = DEFAULT_CONFIRM_EVENTS;
+    }
+
+    m_rand_state    = m_config.seed;
+    m_time_us       = 0;
+    m_enabled       = false;
+    m_dispatching   = false;
+    m_evt_head      = 0;
+    m_evt_count     = 0;
+    m_attr_count    = 0;
+    m_cccd_count    = 0;
+    m_attr_pool_used = 0;
+    m_vs_uuid_count = 0;
+    m_dev_name_len  = 0;
+    m_appearance    = 0;
+    m_adv_data_len  = 0;
+    m_advertising   = false;
+    m_peer_addr_set = false;
+    m_peer_attr_count = 0;
+
+    memset(&m_addr, 0, sizeof(m_addr));
+    memset(&m_ppcp, 0, sizeof(m_ppcp));
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    // A fixed random static address, so that runs are repeatable.
+    m_addr.addr_type = BLE_GAP_ADDR_TYPE_RANDOM_STATIC;
+    m_addr.addr[5]   = 0xC0;
+
+    for (uint8_t i = 0; i < BLE_SIM_LINK_COUNT; i++)
+    {
+        memset(&m_links[i], 0, sizeof(m_links[i]));
+        m_links[i].conn_handle = BLE_CONN_HANDLE_INVALID;
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+bool ble_sim_process(void)
+{
+    uint32_t evt_buf[SIM_EVT_BUF_WORDS];
+    uint16_t evt_len;
+    bool     sent = false;
+
+    if ((m_config.evt_handler == NULL) || m_dispatching)
+    {
+        return false;
+    }
+
+    m_dispatching = true;
+
+    for (;;)
+    {
+        evt_len = sizeof(evt_buf);
+        if (sd_ble_evt_get((uint8_t *)evt_buf, &evt_len) != NRF_SUCCESS)
+        {
+            break;
+        }
+        m_config.evt_handler((ble_evt_t *)evt_buf);
+        sent = true;
+    }
+
+    m_dispatching = false;
+
+    return sent;
+}
+
+
+void ble_sim_run_for(uint32_t us)
+{
+    uint64_t const end_us = m_time_us + us;
+
+    (void)ble_sim_process();
+
+    while (next_event_run(end_us))
+    {
+        // Nothing to do, events are sent as they occur.
+    }
+
+    m_time_us = end_us;
+}
+
+
+uint32_t ble_sim_run_events(uint16_t conn_handle, uint32_t count)
+{
+    sim_link_t * p_link = link_get(conn_handle);
+
+    while (count-- != 0)
+    {
+        if (p_link == NULL)
+        {
+            return BLE_ERROR_INVALID_CONN_HANDLE;
+        }
+
+        ble_sim_run_for((uint32_t)(p_link->next_event_us - m_time_us));
+        p_link = link_get(conn_handle);
+    }
+
+    return (p_link == NULL) ? BLE_ERROR_INVALID_CONN_HANDLE : NRF_SUCCESS;
+}
+
+
+uint64_t ble_sim_time_us(void)
+{
+    return m_time_us;
+}
+
+
+uint32_t ble_sim_peer_connect(ble_gap_conn_params_t const * p_conn_params,
+                              uint16_t                    * p_conn_handle)
+{
+    sim_link_t * p_link = NULL;
+    ble_evt_t  * p_evt;
+    uint16_t     conn_handle;
+
+    if ((p_conn_params == NULL) || (p_conn_handle == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (!m_advertising)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    for (conn_handle = 0; conn_handle < m_link_max; conn_handle++)
+    {
+        if (m_links[conn_handle].conn_handle == BLE_CONN_HANDLE_INVALID)
+        {
+            p_link = &m_links[conn_handle];
+            break;
+        }
+    }
+    if (p_link == NULL)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    memset(p_link, 0, sizeof(*p_link));
+    p_link->conn_handle                = conn_handle;
+    p_link->params                     = *p_conn_params;
+    p_link->params.min_conn_interval   = p_conn_params->max_conn_interval;
+    p_link->next_event_us              = m_time_us + interval_us(p_link);
+    p_link->last_rx_us                 = m_time_us;
+    p_link->stats_start_us             = m_time_us;
+
+    adv_end();
+
+    p_evt = evt_alloc(BLE_GAP_EVT_CONNECTED, 0);
+    p_evt->evt.gap_evt.conn_handle                       = conn_handle;
+    if (m_peer_addr_set)
+    {
+        p_evt->evt.gap_evt.params.connected.peer_addr           = m_peer_addr;
+    }
+    else
+    {
+        p_evt->evt.gap_evt.params.connected.peer_addr.addr_type = BLE_GAP_ADDR_TYPE_RANDOM_STATIC;
+        p_evt->evt.gap_evt.params.connected.peer_addr.addr[0]   = (uint8_t)(conn_handle + 1);
+        p_evt->evt.gap_evt.params.connected.peer_addr.addr[5]   = 0xC0;
+    }
+    p_evt->evt.gap_evt.params.connected.own_addr            = m_addr;
+    p_evt->evt.gap_evt.params.connected.role                = BLE_GAP_ROLE_PERIPH;
+    p_evt->evt.gap_evt.params.connected.conn_params         = p_link->params;
+
+    *p_conn_handle = conn_handle;
+
+    (void)ble_sim_process();
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t ble_sim_peer_addr_set(ble_gap_addr_t const * p_addr)
+{
+    if (p_addr == NULL)
+    {
+        m_peer_addr_set = false;
+        return NRF_SUCCESS;
+    }
+    if (p_addr->addr_type > BLE_GAP_ADDR_TYPE_RANDOM_PRIVATE_NON_RESOLVABLE)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_peer_addr     = *p_addr;
+    m_peer_addr_set = true;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t ble_sim_peer_disconnect(uint16_t conn_handle, uint8_t reason)
+{
+    sim_link_t * p_link = link_get(conn_handle);
+
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+
+    link_close(p_link, reason);
+    (void)ble_sim_process();
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t ble_sim_peer_write(uint16_t        conn_handle,
+                            uint16_t        handle,
+                            uint8_t const * p_data,
+                            uint16_t        len,
+                            uint8_t         write_op)
+{
+    sim_link_t * p_link = link_get(conn_handle);
+
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if (p_data == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if ((write_op != BLE_GATT_OP_WRITE_REQ) && (write_op != BLE_GATT_OP_WRITE_CMD))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (len > att_payload_max())
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    return peer_queue(p_link, handle, write_op, false, p_data, len);
+}
+
+
+uint32_t ble_sim_peer_cccd_write(uint16_t conn_handle, uint16_t value_handle, uint16_t cccd_value)
+{
+    sim_attr_t const * p_value = attr_find(value_handle);
+    uint8_t            data[SIM_CCCD_LEN];
+
+    if ((p_value == NULL) || (p_value->cccd_handle == BLE_GATT_HANDLE_INVALID))
+    {
+        return BLE_ERROR_INVALID_ATTR_HANDLE;
+    }
+
+    (void)uint16_encode(cccd_value, data);
+
+    return ble_sim_peer_write(conn_handle, p_value->cccd_handle, data, sizeof(data), BLE_GATT_OP_WRITE_REQ);
+}
+
+
+uint32_t ble_sim_peer_db_set(ble_sim_peer_service_t const * p_services, uint8_t count)
+{
+    uint32_t attr_count = 0;
+
+    if ((p_services == NULL) && (count != 0))
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if ((p_services[i].p_chars == NULL) && (p_services[i].char_count != 0))
+        {
+            return NRF_ERROR_NULL;
+        }
+
+        attr_count++;
+        for (uint8_t j = 0; j < p_services[i].char_count; j++)
+        {
+            ble_gatt_char_props_t const * p_props = &p_services[i].p_chars[j].props;
+
+            attr_count += (p_props->notify || p_props->indicate) ? 3 : 2;
+        }
+    }
+    if (attr_count > BLE_SIM_PEER_ATTR_MAX)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    memset(m_peer_attrs, 0, sizeof(m_peer_attrs));
+    m_peer_attr_count = 0;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        sim_peer_attr_t * p_service = &m_peer_attrs[m_peer_attr_count++];
+
+        p_service->type = BLE_UUID_SERVICE_PRIMARY;
+        p_service->uuid = p_services[i].uuid;
+
+        for (uint8_t j = 0; j < p_services[i].char_count; j++)
+        {
+            ble_sim_peer_char_t const * p_char = &p_services[i].p_chars[j];
+            sim_peer_attr_t           * p_attr = &m_peer_attrs[m_peer_attr_count++];
+
+            p_attr->type  = BLE_UUID_CHARACTERISTIC;
+            p_attr->uuid  = p_char->uuid;
+            p_attr->props = p_char->props;
+
+            p_attr       = &m_peer_attrs[m_peer_attr_count++];
+            p_attr->uuid = p_char->uuid;
+
+            if (p_char->props.notify || p_char->props.indicate)
+            {
+                p_attr       = &m_peer_attrs[m_peer_attr_count++];
+                p_attr->type = BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG;
+                p_attr->uuid = p_char->uuid;
+            }
+        }
+
+        p_service->end_handle = m_peer_attr_count;
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t ble_sim_peer_char_handles_get(ble_uuid_t const * p_uuid,
+                                       uint16_t         * p_value_handle,
+                                       uint16_t         * p_cccd_handle)
+{
+    if ((p_uuid == NULL) || (p_value_handle == NULL) || (p_cccd_handle == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    for (uint16_t handle = 1; handle <= m_peer_attr_count; handle++)
+    {
+        sim_peer_attr_t const * p_decl = peer_attr_get(handle);
+        sim_peer_attr_t const * p_cccd = peer_attr_get(handle + 2);
+
+        if ((p_decl->type == BLE_UUID_CHARACTERISTIC) && BLE_UUID_EQ(&p_decl->uuid, p_uuid))
+        {
+            *p_value_handle = handle + 1;
+            *p_cccd_handle  = BLE_GATT_HANDLE_INVALID;
+            if ((p_cccd != NULL) && (p_cccd->type == BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG))
+            {
+                *p_cccd_handle = handle + 2;
+            }
+            return NRF_SUCCESS;
+        }
+    }
+
+    return NRF_ERROR_NOT_FOUND;
+}
+
+
+uint32_t ble_sim_peer_hvx(uint16_t        conn_handle,
+                          uint16_t        handle,
+                          uint8_t         type,
+                          uint8_t const * p_data,
+                          uint16_t        len)
+{
+    sim_link_t            * p_link = link_get(conn_handle);
+    sim_peer_attr_t const * p_attr = peer_attr_get(handle);
+
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if (p_data == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if ((type != BLE_GATT_HVX_NOTIFICATION) && (type != BLE_GATT_HVX_INDICATION))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if ((p_attr == NULL) || (p_attr->type != 0))
+    {
+        return BLE_ERROR_INVALID_ATTR_HANDLE;
+    }
+    if (len > att_payload_max())
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    return peer_queue(p_link, handle, type, true, p_data, len);
+}
+
+
+void ble_sim_loss_set(uint16_t loss_permille)
+{
+    m_config.loss_permille = (loss_permille > 1000) ? 1000 : loss_permille;
+}
+
+
+uint32_t ble_sim_conn_params_get(uint16_t conn_handle, ble_gap_conn_params_t * p_conn_params)
+{
+    sim_link_t const * p_link = link_get(conn_handle);
+
+    if (p_conn_params == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+
+    *p_conn_params = p_link->params;
+
+    return NRF_SUCCESS;
+}
+
+
+uint8_t ble_sim_tx_queued(uint16_t conn_handle)
+{
+    sim_link_t const * p_link = link_get(conn_handle);
+
+    return (p_link == NULL) ? 0 : p_link->tx_count;
+}
+
+
+bool ble_sim_is_advertising(void)
+{
+    return m_advertising;
+}
+
+
+void ble_sim_stats_get(ble_sim_stats_t * p_stats)
+{
+    if (p_stats != NULL)
+    {
+        *p_stats = m_stats;
+    }
+}
+
+
+uint32_t ble_sim_link_stats_get(uint16_t conn_handle, ble_sim_link_stats_t * p_stats)
+{
+    sim_link_t const * p_link = link_get(conn_handle);
+
+    if (p_stats == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+
+    *p_stats            = p_link->stats;
+    p_stats->elapsed_us = (uint32_t)(m_time_us - p_link->stats_start_us);
+
+    return NRF_SUCCESS;
+}
+
+
+void ble_sim_stats_reset(void)
+{
+    uint8_t i;
+
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    for (i = 0; i < BLE_SIM_LINK_COUNT; i++)
+    {
+        memset(&m_links[i].stats, 0, sizeof(m_links[i].stats));
+        m_links[i].stats_start_us = m_time_us;
+    }
+}
+
+
+/* SoftDevice BLE API. */
+
+
+uint32_t sd_ble_enable(ble_enable_params_t * p_ble_enable_params, uint32_t * p_app_ram_base)
+{
+    uint8_t periph_count;
+
+    if ((p_ble_enable_params == NULL) || (p_app_ram_base == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (m_enabled)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_ble_enable_params->common_enable_params.vs_uuid_count > BLE_SIM_VS_UUID_MAX)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    periph_count = p_ble_enable_params->gap_enable_params.periph_conn_count;
+    if (periph_count > BLE_SIM_LINK_COUNT)
+    {
+        return NRF_ERROR_CONN_COUNT;
+    }
+
+    m_link_max    = (periph_count == 0) ? 1 : periph_count;
+    m_vs_uuid_max = (uint8_t)p_ble_enable_params->common_enable_params.vs_uuid_count;
+    m_next_handle = SIM_GAP_HANDLE_END + 1;
+    m_enabled     = true;
+
+    // GATT service. The Service Changed characteristic follows its declaration.
+    m_next_handle++;
+    m_sc_value_handle = BLE_GATT_HANDLE_INVALID;
+
+    if (p_ble_enable_params->gatts_enable_params.service_changed)
+    {
+        static uint8_t      sc_init[4];
+        ble_uuid_t          uuid    = {BLE_UUID_GATT_CHARACTERISTIC_SERVICE_CHANGED, BLE_UUID_TYPE_BLE};
+        ble_gatts_attr_md_t attr_md = {.vloc = BLE_GATTS_VLOC_STACK};
+        ble_gatts_attr_t    attr    =
+        {
+            .p_uuid    = &uuid,
+            .p_attr_md = &attr_md,
+            .init_len  = sizeof(sc_init),
+            .max_len   = sizeof(sc_init),
+            .p_value   = sc_init,
+        };
+        sim_attr_t        * p_attr;
+
+        m_next_handle++;
+        (void)attr_add(&attr, &p_attr);
+        (void)cccd_add(p_attr, true);
+        m_sc_value_handle = p_attr->handle;
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_evt_get(uint8_t * p_dest, uint16_t * p_len)
+{
+    sim_evt_t const * p_entry;
+
+    if (p_len == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (m_evt_count == 0)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    p_entry = &m_evt_queue[m_evt_head];
+
+    if (p_dest == NULL)
+    {
+        *p_len = p_entry->len;
+        return NRF_SUCCESS;
+    }
+    if (*p_len < p_entry->len)
+    {
+        *p_len = p_entry->len;
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    memcpy(p_dest, p_entry->buf, p_entry->len);
+    *p_len = p_entry->len;
+
+    m_evt_head = (m_evt_head + 1) % SIM_EVT_QUEUE_SIZE;
+    m_evt_count--;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_tx_packet_count_get(uint16_t conn_handle, uint8_t * p_count)
+{
+    if (p_count == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (link_get(conn_handle) == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+
+    *p_count = m_config.tx_buffer_count;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_uuid_vs_add(ble_uuid128_t const * p_vs_uuid, uint8_t * p_uuid_type)
+{
+    if ((p_vs_uuid == NULL) || (p_uuid_type == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (!m_enabled)
+    {
+        return BLE_ERROR_NOT_ENABLED;
+    }
+
+    for (uint8_t i = 0; i < m_vs_uuid_count; i++)
+    {
+        if (memcmp(&m_vs_uuids[i], p_vs_uuid, sizeof(ble_uuid128_t)) == 0)
+        {
+            *p_uuid_type = BLE_UUID_TYPE_VENDOR_BEGIN + i;
+            return NRF_SUCCESS;
+        }
+    }
+
+    if (m_vs_uuid_count == m_vs_uuid_max)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    m_vs_uuids[m_vs_uuid_count] = *p_vs_uuid;
+    *p_uuid_type = BLE_UUID_TYPE_VENDOR_BEGIN + m_vs_uuid_count;
+    m_vs_uuid_count++;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_uuid_encode(ble_uuid_t const * p_uuid, uint8_t * p_uuid_le_len, uint8_t * p_uuid_le)
+{
+    if ((p_uuid == NULL) || (p_uuid_le_len == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    if (p_uuid->type == BLE_UUID_TYPE_BLE)
+    {
+        *p_uuid_le_len = 2;
+        if (p_uuid_le != NULL)
+        {
+            (void)uint16_encode(p_uuid->uuid, p_uuid_le);
+        }
+        return NRF_SUCCESS;
+    }
+
+    if ((p_uuid->type >= BLE_UUID_TYPE_VENDOR_BEGIN) &&
+        (p_uuid->type < BLE_UUID_TYPE_VENDOR_BEGIN + m_vs_uuid_count))
+    {
+        *p_uuid_le_len = 16;
+        if (p_uuid_le != NULL)
+        {
+            memcpy(p_uuid_le, m_vs_uuids[p_uuid->type - BLE_UUID_TYPE_VENDOR_BEGIN].uuid128, 16);
+            (void)uint16_encode(p_uuid->uuid, &p_uuid_le[12]);
+        }
+        return NRF_SUCCESS;
+    }
+
+    return NRF_ERROR_INVALID_PARAM;
+}
+
+
+uint32_t sd_ble_gap_address_set(uint8_t addr_cycle_mode, ble_gap_addr_t const * p_addr)
+{
+    (void)addr_cycle_mode;
+
+    if (p_addr == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    m_addr = *p_addr;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_address_get(ble_gap_addr_t * p_addr)
+{
+    if (p_addr == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    *p_addr = m_addr;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_adv_data_set(uint8_t const * p_data, uint8_t dlen, uint8_t const * p_sr_data, uint8_t srdlen)
+{
+    (void)p_sr_data;
+
+    if ((dlen > BLE_GAP_ADV_MAX_SIZE) || (srdlen > BLE_GAP_ADV_MAX_SIZE))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    if (p_data != NULL)
+    {
+        memcpy(m_adv_data, p_data, dlen);
+        m_adv_data_len = dlen;
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_adv_start(ble_gap_adv_params_t const * p_adv_params)
+{
+    uint8_t link_count = 0;
+
+    if (p_adv_params == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (!m_enabled)
+    {
+        return BLE_ERROR_NOT_ENABLED;
+    }
+    if (m_advertising)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    for (uint8_t i = 0; i < m_link_max; i++)
+    {
+        if (m_links[i].conn_handle != BLE_CONN_HANDLE_INVALID)
+        {
+            link_count++;
+        }
+    }
+    if (link_count == m_link_max)
+    {
+        return NRF_ERROR_CONN_COUNT;
+    }
+
+    m_adv_start_us = m_time_us;
+    m_adv_event_us = (uint32_t)p_adv_params->interval * 625;
+
+    if ((p_adv_params->type == BLE_GAP_ADV_TYPE_ADV_DIRECT_IND) && (p_adv_params->interval == 0))
+    {
+        m_adv_deadline_us = m_time_us + SIM_DIRECT_ADV_US;
+    }
+    else if (p_adv_params->timeout != 0)
+    {
+        m_adv_deadline_us = m_time_us + (uint64_t)p_adv_params->timeout * 1000000;
+    }
+    else
+    {
+        m_adv_deadline_us = 0;
+    }
+
+    m_advertising = true;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_adv_stop(void)
+{
+    if (!m_advertising)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    adv_end();
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_conn_param_update(uint16_t conn_handle, ble_gap_conn_params_t const * p_conn_params)
+{
+    sim_link_t * p_link = link_get(conn_handle);
+    uint16_t     interval;
+
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if (p_link->params_pending)
+    {
+        m_stats.busy_rejects++;
+        return NRF_ERROR_BUSY;
+    }
+    if (p_conn_params == NULL)
+    {
+        p_conn_params = &m_ppcp;
+    }
+    if (p_conn_params->min_conn_interval > p_conn_params->max_conn_interval)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    // The peer picks the shortest interval it supports. If none is in range it rejects the
+    // request and the device sees no event, as with a phone answering with a reject.
+    interval = p_conn_params->min_conn_interval;
+    if (interval < m_config.peer_min_interval)
+    {
+        interval = m_config.peer_min_interval;
+    }
+    if (interval > p_conn_params->max_conn_interval)
+    {
+        return NRF_SUCCESS;
+    }
+
+    p_link->new_params                   = *p_conn_params;
+    p_link->new_params.min_conn_interval = interval;
+    p_link->new_params.max_conn_interval = interval;
+    p_link->params_pending               = true;
+    p_link->params_instant               = p_link->event_counter + 1 + BLE_SIM_CONN_PARAM_INSTANT;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_disconnect(uint16_t conn_handle, uint8_t hci_status_code)
+{
+    sim_link_t * p_link = link_get(conn_handle);
+
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if ((hci_status_code != BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION) &&
+        (hci_status_code != BLE_HCI_CONN_INTERVAL_UNACCEPTABLE))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (p_link->disconnect_pending)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    p_link->disconnect_pending = true;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_appearance_set(uint16_t appearance)
+{
+    m_appearance = appearance;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_appearance_get(uint16_t * p_appearance)
+{
+    if (p_appearance == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    *p_appearance = m_appearance;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_ppcp_set(ble_gap_conn_params_t const * p_conn_params)
+{
+    if (p_conn_params == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    m_ppcp = *p_conn_params;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_ppcp_get(ble_gap_conn_params_t * p_conn_params)
+{
+    if (p_conn_params == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    *p_conn_params = m_ppcp;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_device_name_set(ble_gap_conn_sec_mode_t const * p_write_perm,
+                                    uint8_t const                 * p_dev_name,
+                                    uint16_t                        len)
+{
+    (void)p_write_perm;
+
+    if (p_dev_name == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (len > BLE_GAP_DEVNAME_MAX_LEN)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    memcpy(m_dev_name, p_dev_name, len);
+    m_dev_name_len = len;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_device_name_get(uint8_t * p_dev_name, uint16_t * p_len)
+{
+    if (p_len == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (p_dev_name == NULL)
+    {
+        *p_len = m_dev_name_len;
+        return NRF_SUCCESS;
+    }
+    if (*p_len < m_dev_name_len)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    memcpy(p_dev_name, m_dev_name, m_dev_name_len);
+    *p_len = m_dev_name_len;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_authenticate(uint16_t conn_handle, ble_gap_sec_params_t const * p_sec_params)
+{
+    (void)p_sec_params;
+
+    // The peer ignores security requests.
+    return (link_get(conn_handle) == NULL) ? BLE_ERROR_INVALID_CONN_HANDLE : NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_sec_params_reply(uint16_t                     conn_handle,
+                                     uint8_t                      sec_status,
+                                     ble_gap_sec_params_t const * p_sec_params,
+                                     ble_gap_sec_keyset_t const * p_sec_keyset)
+{
+    (void)sec_status;
+    (void)p_sec_params;
+    (void)p_sec_keyset;
+
+    // The peer never starts pairing, so there is no request to reply to.
+    return (link_get(conn_handle) == NULL) ? BLE_ERROR_INVALID_CONN_HANDLE : NRF_ERROR_INVALID_STATE;
+}
+
+
+uint32_t sd_ble_gap_sec_info_reply(uint16_t                    conn_handle,
+                                   ble_gap_enc_info_t const  * p_enc_info,
+                                   ble_gap_irk_t const       * p_id_info,
+                                   ble_gap_sign_info_t const * p_sign_info)
+{
+    (void)p_enc_info;
+    (void)p_id_info;
+    (void)p_sign_info;
+
+    return (link_get(conn_handle) == NULL) ? BLE_ERROR_INVALID_CONN_HANDLE : NRF_ERROR_INVALID_STATE;
+}
+
+
+uint32_t sd_ble_gatts_service_add(uint8_t type, ble_uuid_t const * p_uuid, uint16_t * p_handle)
+{
+    if ((p_uuid == NULL) || (p_handle == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (!m_enabled)
+    {
+        return BLE_ERROR_NOT_ENABLED;
+    }
+    if ((type != BLE_GATTS_SRVC_TYPE_PRIMARY) && (type != BLE_GATTS_SRVC_TYPE_SECONDARY))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    *p_handle = m_next_handle++;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_characteristic_add(uint16_t                   service_handle,
+                                         ble_gatts_char_md_t const * p_char_md,
+                                         ble_gatts_attr_t const    * p_attr_char_value,
+                                         ble_gatts_char_handles_t  * p_handles)
+{
+    sim_attr_t * p_value;
+    uint32_t     err_code;
+
+    if ((p_char_md == NULL) || (p_attr_char_value == NULL) || (p_handles == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (!m_enabled)
+    {
+        return BLE_ERROR_NOT_ENABLED;
+    }
+    if ((service_handle == BLE_GATT_HANDLE_INVALID) || (service_handle >= m_next_handle))
+    {
+        return BLE_ERROR_INVALID_ATTR_HANDLE;
+    }
+
+    // Characteristic declaration.
+    m_next_handle++;
+
+    err_code = attr_add(p_attr_char_value, &p_value);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    p_handles->value_handle     = p_value->handle;
+    p_handles->user_desc_handle = BLE_GATT_HANDLE_INVALID;
+    p_handles->cccd_handle      = BLE_GATT_HANDLE_INVALID;
+    p_handles->sccd_handle      = BLE_GATT_HANDLE_INVALID;
+
+    if (p_char_md->char_props.notify || p_char_md->char_props.indicate)
+    {
+        err_code = cccd_add(p_value, false);
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+        p_handles->cccd_handle = p_value->cccd_handle;
+    }
+
+    if (p_char_md->p_char_user_desc != NULL)
+    {
+        ble_uuid_t          uuid    = {BLE_UUID_DESCRIPTOR_CHAR_USER_DESC, BLE_UUID_TYPE_BLE};
+        ble_gatts_attr_md_t attr_md = {.vloc = BLE_GATTS_VLOC_STACK, .vlen = 1};
+        ble_gatts_attr_t    attr    =
+        {
+            .p_uuid    = &uuid,
+            .p_attr_md = &attr_md,
+            .init_len  = p_char_md->char_user_desc_size,
+            .max_len   = p_char_md->char_user_desc_max_size,
+            .p_value   = p_char_md->p_char_user_desc,
+        };
+        sim_attr_t        * p_desc;
+
+        err_code = attr_add(&attr, &p_desc);
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+        p_handles->user_desc_handle = p_desc->handle;
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_descriptor_add(uint16_t char_handle, ble_gatts_attr_t const * p_attr, uint16_t * p_handle)
+{
+    sim_attr_t * p_desc;
+    uint32_t     err_code;
+
+    if (p_handle == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (!m_enabled)
+    {
+        return BLE_ERROR_NOT_ENABLED;
+    }
+    if (attr_find(char_handle) == NULL)
+    {
+        return BLE_ERROR_INVALID_ATTR_HANDLE;
+    }
+
+    err_code = attr_add(p_attr, &p_desc);
+    if (err_code == NRF_SUCCESS)
+    {
+        *p_handle = p_desc->handle;
+    }
+
+    return err_code;
+}
+
+
+uint32_t sd_ble_gatts_value_set(uint16_t conn_handle, uint16_t handle, ble_gatts_value_t * p_value)
+{
+    sim_attr_t * p_attr = attr_find(handle);
+
+    if (p_value == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (p_attr == NULL)
+    {
+        return BLE_ERROR_INVALID_ATTR_HANDLE;
+    }
+    if (p_value->offset > p_attr->max_len)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    if (p_attr->is_cccd)
+    {
+        sim_link_t * p_link = link_get(conn_handle);
+
+        if (p_link == NULL)
+        {
+            return BLE_ERROR_INVALID_CONN_HANDLE;
+        }
+        if ((p_value->offset != 0) || (p_value->len != SIM_CCCD_LEN) || (p_value->p_value == NULL))
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        p_link->cccd[p_attr->cccd_index] = uint16_decode(p_value->p_value);
+        return NRF_SUCCESS;
+    }
+
+    attr_write(p_attr, p_value->offset, p_value->p_value, p_value->len);
+    p_value->len = (p_attr->vlen ? p_attr->len : p_attr->max_len) - p_value->offset;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_value_get(uint16_t conn_handle, uint16_t handle, ble_gatts_value_t * p_value)
+{
+    sim_attr_t const * p_attr = attr_find(handle);
+    uint8_t            cccd[SIM_CCCD_LEN];
+    uint8_t const    * p_src;
+    uint16_t           len;
+
+    if (p_value == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (p_attr == NULL)
+    {
+        return BLE_ERROR_INVALID_ATTR_HANDLE;
+    }
+
+    if (p_attr->is_cccd)
+    {
+        sim_link_t const * p_link = link_get(conn_handle);
+
+        if (p_link == NULL)
+        {
+            return BLE_ERROR_INVALID_CONN_HANDLE;
+        }
+        (void)uint16_encode(p_link->cccd[p_attr->cccd_index], cccd);
+        p_src = cccd;
+        len   = SIM_CCCD_LEN;
+    }
+    else
+    {
+        p_src = p_attr->p_value;
+        len   = p_attr->len;
+    }
+
+    if (p_value->offset > len)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    len -= p_value->offset;
+
+    if (p_value->p_value != NULL)
+    {
+        if (p_value->len < len)
+        {
+            len = p_value->len;
+        }
+        memcpy(p_value->p_value, p_src + p_value->offset, len);
+    }
+
+    p_value->len = len;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const * p_hvx_params)
+{
+    sim_link_t * p_link = link_get(conn_handle);
+    sim_attr_t * p_attr;
+    uint16_t     cccd;
+    uint16_t     len;
+
+    if (p_hvx_params == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+
+    p_attr = attr_find(p_hvx_params->handle);
+    if ((p_attr == NULL) || p_attr->is_cccd)
+    {
+        return BLE_ERROR_INVALID_ATTR_HANDLE;
+    }
+    if (p_hvx_params->offset > p_attr->max_len)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    if ((p_hvx_params->type != BLE_GATT_HVX_NOTIFICATION) &&
+        (p_hvx_params->type != BLE_GATT_HVX_INDICATION))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (!p_link->sys_attr_set)
+    {
+        return BLE_ERROR_GATTS_SYS_ATTR_MISSING;
+    }
+
+    cccd = cccd_get(p_link, p_hvx_params->handle);
+    if ((cccd & p_hvx_params->type) == 0)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    // The attribute value is updated even if the packet cannot be queued.
+    if (p_hvx_params->p_data != NULL)
+    {
+        len = (p_hvx_params->p_len != NULL) ? *p_hvx_params->p_len : 0;
+        attr_write(p_attr, p_hvx_params->offset, p_hvx_params->p_data, len);
+    }
+
+    len = (p_attr->vlen ? p_attr->len : p_attr->max_len);
+    len = (len > p_hvx_params->offset) ? (len - p_hvx_params->offset) : 0;
+    if ((p_hvx_params->p_len != NULL) && (p_hvx_params->p_data != NULL) && (*p_hvx_params->p_len < len))
+    {
+        len = *p_hvx_params->p_len;
+    }
+    if (len > att_payload_max())
+    {
+        len = att_payload_max();
+    }
+    if (p_hvx_params->p_len != NULL)
+    {
+        *p_hvx_params->p_len = len;
+    }
+
+    if (p_hvx_params->type == BLE_GATT_HVX_INDICATION)
+    {
+        return indication_queue(p_link, p_attr->handle, p_attr->p_value + p_hvx_params->offset, len);
+    }
+
+    return tx_queue(p_link, p_attr->handle, BLE_GATT_HVX_NOTIFICATION,
+                    p_attr->p_value + p_hvx_params->offset, len);
+}
+
+
+uint32_t sd_ble_gatts_service_changed(uint16_t conn_handle, uint16_t start_handle, uint16_t end_handle)
+{
+    sim_link_t * p_link = link_get(conn_handle);
+    uint8_t      data[4];
+
+    if (m_sc_value_handle == BLE_GATT_HANDLE_INVALID)
+    {
+        return NRF_ERROR_NOT_SUPPORTED;
+    }
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if ((start_handle == BLE_GATT_HANDLE_INVALID) || (start_handle > end_handle))
+    {
+        return BLE_ERROR_INVALID_ATTR_HANDLE;
+    }
+    if (!p_link->sys_attr_set)
+    {
+        return BLE_ERROR_GATTS_SYS_ATTR_MISSING;
+    }
+    if ((cccd_get(p_link, m_sc_value_handle) & BLE_GATT_HVX_INDICATION) == 0)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    (void)uint16_encode(start_handle, &data[0]);
+    (void)uint16_encode(end_handle, &data[2]);
+
+    return indication_queue(p_link, m_sc_value_handle, data, sizeof(data));
+}
+
+
+uint32_t sd_ble_gatts_rw_authorize_reply(uint16_t                                      conn_handle,
+                                         ble_gatts_rw_authorize_reply_params_t const * p_rw_authorize_reply_params)
+{
+    (void)p_rw_authorize_reply_params;
+
+    // Authorization is never requested, see the module description.
+    return (link_get(conn_handle) == NULL) ? BLE_ERROR_INVALID_CONN_HANDLE : NRF_ERROR_INVALID_STATE;
+}
+
+
+/**@brief System attributes are stored as a list of CCCDs, each written as its handle, its length
+ *        and its value, followed by a CRC-16 over the list.
+ */
+uint32_t sd_ble_gatts_sys_attr_set(uint16_t        conn_handle,
+                                   uint8_t const * p_sys_attr_data,
+                                   uint16_t        len,
+                                   uint32_t        flags)
+{
+    sim_link_t * p_link = link_get(conn_handle);
+    uint16_t     offset = 0;
+
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+
+    for (uint16_t i = 0; i < m_attr_count; i++)
+    {
+        if (sys_attr_selected(&m_attrs[i], flags))
+        {
+            p_link->cccd[m_attrs[i].cccd_index] = 0;
+        }
+    }
+
+    if (p_sys_attr_data != NULL)
+    {
+        if ((len < sizeof(uint16_t)) ||
+            (crc16(p_sys_attr_data, len - sizeof(uint16_t)) !=
+             uint16_decode(&p_sys_attr_data[len - sizeof(uint16_t)])))
+        {
+            return NRF_ERROR_INVALID_DATA;
+        }
+
+        len -= sizeof(uint16_t);
+
+        while (offset + 4 + SIM_CCCD_LEN <= len)
+        {
+            uint16_t const     handle = uint16_decode(&p_sys_attr_data[offset]);
+            uint16_t const     size   = uint16_decode(&p_sys_attr_data[offset + 2]);
+            sim_attr_t const * p_attr = attr_find(handle);
+
+            if ((size != SIM_CCCD_LEN) || (p_attr == NULL) || !p_attr->is_cccd)
+            {
+                return NRF_ERROR_INVALID_DATA;
+            }
+            if (sys_attr_selected(p_attr, flags))
+            {
+                p_link->cccd[p_attr->cccd_index] = uint16_decode(&p_sys_attr_data[offset + 4]);
+            }
+            offset += 4 + SIM_CCCD_LEN;
+        }
+
+        if (offset != len)
+        {
+            return NRF_ERROR_INVALID_DATA;
+        }
+    }
+
+    p_link->sys_attr_set = true;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_sys_attr_get(uint16_t   conn_handle,
+                                   uint8_t  * p_sys_attr_data,
+                                   uint16_t * p_len,
+                                   uint32_t   flags)
+{
+    sim_link_t const * p_link = link_get(conn_handle);
+    uint16_t           needed = sizeof(uint16_t);
+    uint16_t           offset = 0;
+
+    if (p_len == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+
+    for (uint16_t i = 0; i < m_attr_count; i++)
+    {
+        if (sys_attr_selected(&m_attrs[i], flags))
+        {
+            needed += 4 + SIM_CCCD_LEN;
+        }
+    }
+
+    if (needed == sizeof(uint16_t))
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    if (p_sys_attr_data == NULL)
+    {
+        *p_len = needed;
+        return NRF_SUCCESS;
+    }
+    if (*p_len < needed)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    for (uint16_t i = 0; i < m_attr_count; i++)
+    {
+        if (sys_attr_selected(&m_attrs[i], flags))
+        {
+            offset += uint16_encode(m_attrs[i].handle, &p_sys_attr_data[offset]);
+            offset += uint16_encode(SIM_CCCD_LEN, &p_sys_attr_data[offset]);
+            offset += uint16_encode(p_link->cccd[m_attrs[i].cccd_index], &p_sys_attr_data[offset]);
+        }
+    }
+    offset += uint16_encode(crc16(p_sys_attr_data, offset), &p_sys_attr_data[offset]);
+
+    *p_len = offset;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gattc_primary_services_discover(uint16_t           conn_handle,
+                                                uint16_t           start_handle,
+                                                ble_uuid_t const * p_srvc_uuid)
+{
+    sim_client_req_t    * p_req;
+    ble_gattc_evt_t     * p_rsp;
+    ble_gattc_service_t * p_services;
+    uint16_t              att_len;
+    uint16_t              entry_len = 0;
+    uint32_t              err_code;
+
+    // Find By Type Value for a given UUID, Read By Group Type otherwise.
+    err_code = client_req_start(conn_handle, BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP,
+                                SIM_ATT_REQ_LEN + ((p_srvc_uuid != NULL) ? uuid_len(p_srvc_uuid) : 0),
+                                &p_req);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    p_rsp      = client_rsp(p_req);
+    p_services = p_rsp->params.prim_srvc_disc_rsp.services;
+    att_len    = (p_srvc_uuid != NULL) ? 1 : SIM_ATT_LIST_RSP_HDR;
+
+    for (uint32_t handle = start_handle; handle <= m_peer_attr_count; handle++)
+    {
+        sim_peer_attr_t const * p_attr = peer_attr_get((uint16_t)handle);
+        uint16_t const          count  = p_rsp->params.prim_srvc_disc_rsp.count;
+        uint16_t                len;
+
+        if ((p_attr == NULL) || (p_attr->type != BLE_UUID_SERVICE_PRIMARY) ||
+            ((p_srvc_uuid != NULL) && !BLE_UUID_EQ(&p_attr->uuid, p_srvc_uuid)))
+        {
+            continue;
+        }
+
+        // The handle range, and the UUID unless it was given. All entries have one length.
+        len = 4 + ((p_srvc_uuid != NULL) ? 0 : uuid_len(&p_attr->uuid));
+        if (((count != 0) && (len != entry_len)) ||
+            (att_len + len > m_config.att_mtu) ||
+            !client_rsp_extend(p_req, &p_services[count + 1]))
+        {
+            break;
+        }
+
+        p_services[count].uuid                      = p_attr->uuid;
+        p_services[count].handle_range.start_handle = (uint16_t)handle;
+        p_services[count].handle_range.end_handle   = p_attr->end_handle;
+        p_rsp->params.prim_srvc_disc_rsp.count++;
+        att_len  += len;
+        entry_len = len;
+    }
+
+    if (p_rsp->params.prim_srvc_disc_rsp.count == 0)
+    {
+        client_error(p_req, BLE_GATT_STATUS_ATTERR_ATTRIBUTE_NOT_FOUND, start_handle);
+    }
+    else
+    {
+        p_req->rsp_len = att_len;
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gattc_characteristics_discover(uint16_t                         conn_handle,
+                                               ble_gattc_handle_range_t const * p_handle_range)
+{
+    sim_client_req_t * p_req;
+    ble_gattc_evt_t  * p_rsp;
+    ble_gattc_char_t * p_chars;
+    uint16_t           att_len   = SIM_ATT_LIST_RSP_HDR;
+    uint16_t           entry_len = 0;
+    uint32_t           err_code;
+
+    if (p_handle_range == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    // Read By Type of the characteristic declarations.
+    err_code = client_req_start(conn_handle, BLE_GATTC_EVT_CHAR_DISC_RSP, SIM_ATT_REQ_LEN, &p_req);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    p_rsp   = client_rsp(p_req);
+    p_chars = p_rsp->params.char_disc_rsp.chars;
+
+    for (uint32_t handle = p_handle_range->start_handle;
+         (handle <= p_handle_range->end_handle) && (handle <= m_peer_attr_count);
+         handle++)
+    {
+        sim_peer_attr_t const * p_attr = peer_attr_get((uint16_t)handle);
+        uint16_t const          count  = p_rsp->params.char_disc_rsp.count;
+        uint16_t                len;
+
+        if ((p_attr == NULL) || (p_attr->type != BLE_UUID_CHARACTERISTIC))
+        {
+            continue;
+        }
+
+        len = SIM_ATT_CHAR_ENTRY_LEN + uuid_len(&p_attr->uuid);
+        if (((count != 0) && (len != entry_len)) ||
+            (att_len + len > m_config.att_mtu) ||
+            !client_rsp_extend(p_req, &p_chars[count + 1]))
+        {
+            break;
+        }
+
+        p_chars[count].uuid         = p_attr->uuid;
+        p_chars[count].char_props   = p_attr->props;
+        p_chars[count].handle_decl  = (uint16_t)handle;
+        p_chars[count].handle_value = (uint16_t)(handle + 1);
+        p_rsp->params.char_disc_rsp.count++;
+        att_len  += len;
+        entry_len = len;
+    }
+
+    if (p_rsp->params.char_disc_rsp.count == 0)
+    {
+        client_error(p_req, BLE_GATT_STATUS_ATTERR_ATTRIBUTE_NOT_FOUND, p_handle_range->start_handle);
+    }
+    else
+    {
+        p_req->rsp_len = att_len;
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gattc_descriptors_discover(uint16_t                         conn_handle,
+                                           ble_gattc_handle_range_t const * p_handle_range)
+{
+    sim_client_req_t * p_req;
+    ble_gattc_evt_t  * p_rsp;
+    ble_gattc_desc_t * p_descs;
+    uint16_t           att_len   = SIM_ATT_LIST_RSP_HDR;
+    uint16_t           entry_len = 0;
+    uint32_t           err_code;
+
+    if (p_handle_range == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    // Find Information, which lists every attribute in the range.
+    err_code = client_req_start(conn_handle, BLE_GATTC_EVT_DESC_DISC_RSP, SIM_ATT_REQ_LEN - 2, &p_req);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    p_rsp   = client_rsp(p_req);
+    p_descs = p_rsp->params.desc_disc_rsp.descs;
+
+    for (uint32_t handle = p_handle_range->start_handle;
+         (handle <= p_handle_range->end_handle) && (handle <= m_peer_attr_count);
+         handle++)
+    {
+        sim_peer_attr_t const * p_attr = peer_attr_get((uint16_t)handle);
+        uint16_t const          count  = p_rsp->params.desc_disc_rsp.count;
+        ble_uuid_t              uuid;
+        uint16_t                len;
+
+        if (p_attr == NULL)
+        {
+            continue;
+        }
+
+        uuid = peer_attr_uuid(p_attr);
+        len  = 2 + uuid_len(&uuid);
+        if (((count != 0) && (len != entry_len)) ||
+            (att_len + len > m_config.att_mtu) ||
+            !client_rsp_extend(p_req, &p_descs[count + 1]))
+        {
+            break;
+        }
+
+        p_descs[count].handle = (uint16_t)handle;
+        p_descs[count].uuid   = uuid;
+        p_rsp->params.desc_disc_rsp.count++;
+        att_len  += len;
+        entry_len = len;
+    }
+
+    if (p_rsp->params.desc_disc_rsp.count == 0)
+    {
+        client_error(p_req, BLE_GATT_STATUS_ATTERR_ATTRIBUTE_NOT_FOUND, p_handle_range->start_handle);
+    }
+    else
+    {
+        p_req->rsp_len = att_len;
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gattc_read(uint16_t conn_handle, uint16_t handle, uint16_t offset)
+{
+    sim_client_req_t * p_req;
+    uint32_t           err_code;
+
+    (void)offset;
+
+    err_code = client_req_start(conn_handle, BLE_GATTC_EVT_READ_RSP, 3, &p_req);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    // The peer's attribute values are not modelled.
+    client_error(p_req,
+                 (peer_attr_get(handle) != NULL) ? BLE_GATT_STATUS_ATTERR_READ_NOT_PERMITTED :
+                                                   BLE_GATT_STATUS_ATTERR_INVALID_HANDLE,
+                 handle);
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gattc_write(uint16_t conn_handle, ble_gattc_write_params_t const * p_write_params)
+{
+    sim_link_t       * p_link = link_get(conn_handle);
+    sim_client_req_t * p_req;
+    ble_gattc_evt_t  * p_rsp;
+    uint32_t           err_code;
+
+    if (p_write_params == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if ((p_write_params->len > att_payload_max()) || (p_write_params->offset != 0))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    switch (p_write_params->write_op)
+    {
+        case BLE_GATT_OP_WRITE_CMD:
+            return tx_queue(p_link, p_write_params->handle, BLE_GATT_OP_WRITE_CMD,
+                            p_write_params->p_value, p_write_params->len);
+
+        case BLE_GATT_OP_WRITE_REQ:
+            err_code = client_req_start(conn_handle, BLE_GATTC_EVT_WRITE_RSP,
+                                        3 + p_write_params->len, &p_req);
+            if (err_code != NRF_SUCCESS)
+            {
+                return err_code;
+            }
+
+            if (peer_attr_get(p_write_params->handle) == NULL)
+            {
+                client_error(p_req, BLE_GATT_STATUS_ATTERR_INVALID_HANDLE, p_write_params->handle);
+                return NRF_SUCCESS;
+            }
+            if (!peer_attr_writable(p_write_params->handle))
+            {
+                client_error(p_req, BLE_GATT_STATUS_ATTERR_WRITE_NOT_PERMITTED, p_write_params->handle);
+                return NRF_SUCCESS;
+            }
+
+            p_rsp = client_rsp(p_req);
+            (void)client_rsp_extend(p_req, &p_rsp->params.write_rsp.data[p_write_params->len]);
+            p_rsp->params.write_rsp.handle   = p_write_params->handle;
+            p_rsp->params.write_rsp.write_op = BLE_GATT_OP_WRITE_REQ;
+            p_rsp->params.write_rsp.len      = p_write_params->len;
+            memcpy(p_rsp->params.write_rsp.data, p_write_params->p_value, p_write_params->len);
+            p_req->rsp_len = SIM_ATT_WRITE_RSP_LEN;
+
+            // The peer's server sees the value once the request reaches it.
+            p_req->write.handle = p_write_params->handle;
+            p_req->write.op     = BLE_GATT_OP_WRITE_REQ;
+            p_req->write.len    = p_write_params->len;
+            memcpy(p_req->write.data, p_write_params->p_value, p_write_params->len);
+            return NRF_SUCCESS;
+
+        default:
+            return NRF_ERROR_NOT_SUPPORTED;
+    }
+}
+
+
+uint32_t sd_ble_gattc_hv_confirm(uint16_t conn_handle, uint16_t handle)
+{
+    sim_link_t * p_link = link_get(conn_handle);
+
+    (void)handle;
+
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if (!p_link->hvc_pending || p_link->hvc_due)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    p_link->hvc_due = true;
+
+    return NRF_SUCCESS;
+}
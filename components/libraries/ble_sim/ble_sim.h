@@ -0,0 +1,413 @@
+/* Copyright (c) 2016 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is property of Nordic Semiconductor ASA.
+ * Terms and conditions of usage are described in detail in NORDIC
+ * SEMICONDUCTOR STANDARD SOFTWARE LICENSE AGREEMENT.
+ *
+ * Licensees are granted free, non-transferable use of the information. NO
+ * WARRANTY of ANY KIND is provided. This heading must NOT be removed from
+ * the file.
+ *
+ */
+
+/** @file
+ *
+ * @defgroup ble_sim BLE link simulator
+ * @{
+ * @ingroup app_common
+ * @brief Host-side model of the SoftDevice BLE API and of a phone connected to it.
+ *
+ * @details This module implements the subset of the S132 BLE API used by the application on a
+ *          Linux host, so that the services, the connection parameter negotiation and the data
+ *          transfer paths can run unmodified off-target. A scripted phone peer drives the
+ *          link, and events reach the application's BLE event handler in the order and at the
+ *          rate the SoftDevice would send them.
+ *
+ *          The model is deterministic: all timing follows a simulated clock, and packet loss
+ *          comes from a pseudo-random generator seeded from the configuration. The link model
+ *          covers:
+ *          - Connection events at the connection interval, skipped as allowed by the slave
+ *            latency when neither side has anything to send.
+ *          - A packet budget per connection event, limited both by the configured number of
+ *            packets and by the air time left in the interval.
+ *          - A fixed number of application TX buffers for notifications and write commands,
+ *            released by @ref BLE_EVT_TX_COMPLETE at the end of each connection event.
+ *          - One outstanding indication, confirmed by the peer a number of connection events
+ *            after reception.
+ *          - Write requests from the peer, answered one at a time.
+ *          - Connection parameter updates, applied at an instant six connection events after
+ *            the peer accepts them.
+ *          - Packet loss, which ends the connection event, and the supervision timeout.
+ *          - Advertising time-outs, including the 1.28 s of high duty cycle directed advertising,
+ *            and the number of advertising events sent, to weigh advertising policies.
+ *
+ *          The peer's GATT server holds the services set with @ref ble_sim_peer_db_set, none
+ *          after @ref ble_sim_init. It answers discovery and write requests from the GATT client
+ *          API, one procedure at a time, and hands the writes to the peer write handler. The
+ *          peer sends notifications and indications to the client with @ref ble_sim_peer_hvx.
+ *          Attribute values are not kept, so reads are answered with an ATT error. Pairing and
+ *          encryption are not modelled.
+ *
+ * @note    Build for the host with SVCALL_AS_NORMAL_FUNCTION defined, so that the SoftDevice
+ *          headers declare plain functions.
+ */
+
+#ifndef BLE_SIM_H__
+#define BLE_SIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+
+
+#define BLE_SIM_LINK_COUNT          (2)     /**< Maximum number of simultaneous connections. */
+#define BLE_SIM_ATT_MTU_MAX         (247)   /**< Largest ATT MTU that can be configured. */
+#define BLE_SIM_ATTR_MAX            (96)    /**< Maximum number of attributes in the table. */
+#define BLE_SIM_ATTR_POOL_SIZE      (4096)  /**< Bytes available for attribute values kept in the stack. */
+#define BLE_SIM_TX_BUFFER_MAX       (16)    /**< Largest number of application TX buffers. */
+#define BLE_SIM_PEER_QUEUE_SIZE     (8)     /**< Number of peer writes that can be queued per link. */
+#define BLE_SIM_VS_UUID_MAX         (8)     /**< Maximum number of vendor specific UUID bases. */
+#define BLE_SIM_PEER_ATTR_MAX       (48)    /**< Maximum number of attributes in the peer's GATT server. */
+
+#define BLE_SIM_CONN_PARAM_INSTANT  (6)     /**< Connection events between accepting and applying new parameters. */
+
+
+/**@brief   BLE event handler, normally the application's ble_evt_dispatch(). */
+typedef void (*ble_sim_evt_handler_t)(ble_evt_t * p_ble_evt);
+
+
+/**@brief   Handler for the notifications and indications received by the peer.
+ *
+ * @param[in]   conn_handle The connection on which the packet was received.
+ * @param[in]   handle      The attribute handle.
+ * @param[in]   type        @ref BLE_GATT_HVX_NOTIFICATION or @ref BLE_GATT_HVX_INDICATION.
+ * @param[in]   p_data      The attribute data.
+ * @param[in]   len         The length of the data.
+ */
+typedef void (*ble_sim_peer_rx_handler_t)(uint16_t        conn_handle,
+                                          uint16_t        handle,
+                                          uint8_t         type,
+                                          uint8_t const * p_data,
+                                          uint16_t        len);
+
+
+/**@brief   Handler for the writes received by the peer's GATT server.
+ *
+ * @param[in]   conn_handle The connection on which the write was received.
+ * @param[in]   handle      The attribute handle, of a characteristic value or a CCCD.
+ * @param[in]   write_op    @ref BLE_GATT_OP_WRITE_REQ or @ref BLE_GATT_OP_WRITE_CMD.
+ * @param[in]   p_data      The data written.
+ * @param[in]   len         The length of the data.
+ */
+typedef void (*ble_sim_peer_write_handler_t)(uint16_t        conn_handle,
+                                             uint16_t        handle,
+                                             uint8_t         write_op,
+                                             uint8_t const * p_data,
+                                             uint16_t        len);
+
+
+/**@brief   Characteristic of the peer's GATT server. */
+typedef struct
+{
+    ble_uuid_t            uuid;         //!< Characteristic UUID.
+    ble_gatt_char_props_t props;        //!< Properties. A CCCD follows the value if notify or indicate is set.
+} ble_sim_peer_char_t;
+
+
+/**@brief   Primary service of the peer's GATT server. */
+typedef struct
+{
+    ble_uuid_t                  uuid;       //!< Service UUID.
+    ble_sim_peer_char_t const * p_chars;    //!< Characteristics, in handle order.
+    uint8_t                     char_count; //!< Number of characteristics.
+} ble_sim_peer_service_t;
+
+
+/**@brief   BLE link simulator configuration.
+ *
+ * @details Fields left at zero take the default in parentheses.
+ */
+typedef struct
+{
+    ble_sim_evt_handler_t        evt_handler;         //!< Handler which receives BLE events, or NULL to pull them with @ref sd_ble_evt_get.
+    ble_sim_peer_rx_handler_t    peer_rx_handler;     //!< Handler which receives the packets sent to the peer, or NULL.
+    ble_sim_peer_write_handler_t peer_write_handler;  //!< Handler which receives the writes to the peer's GATT server, or NULL.
+    uint32_t                     seed;                //!< Seed of the packet loss generator (1).
+    uint16_t                     att_mtu;             //!< ATT MTU of every link (@ref GATT_MTU_SIZE_DEFAULT).
+    uint8_t                      tx_buffer_count;     //!< Application TX buffers per link (7).
+    uint8_t                      packets_per_event;   //!< Packets the peer accepts per connection event (6).
+    uint16_t                     loss_permille;       //!< Probability that an exchange of packets is lost, in 1/1000.
+    uint16_t                     peer_min_interval;   //!< Shortest connection interval the peer accepts, in 1.25 ms units (12).
+    uint8_t                      peer_confirm_events; //!< Connection events the peer takes to confirm an indication (1).
+} ble_sim_config_t;
+
+
+/**@brief   BLE link simulator counters. */
+typedef struct
+{
+    uint32_t conn_events;           //!< Connection events held.
+    uint32_t skipped_events;        //!< Connection events skipped using slave latency.
+    uint32_t exchanges;             //!< Packet exchanges completed.
+    uint32_t lost_exchanges;        //!< Packet exchanges lost.
+    uint32_t notifications;         //!< Notifications delivered to the peer.
+    uint32_t indications;           //!< Indications confirmed by the peer.
+    uint32_t peer_writes;           //!< Writes delivered from the peer.
+    uint32_t no_tx_packets;         //!< Calls rejected with BLE_ERROR_NO_TX_PACKETS.
+    uint32_t busy_rejects;          //!< Calls rejected with NRF_ERROR_BUSY.
+    uint32_t bytes_to_peer;         //!< Attribute bytes delivered to the peer.
+    uint32_t bytes_from_peer;       //!< Attribute bytes delivered from the peer.
+    uint32_t max_tx_latency_us;     //!< Longest time from queuing a notification to delivering it.
+    uint32_t supervision_timeouts;  //!< Links lost to the supervision timeout.
+    uint32_t adv_events;            //!< Undirected and low duty cycle directed advertising events sent.
+    uint32_t directed_adv_events;   //!< High duty cycle directed advertising events sent.
+} ble_sim_stats_t;
+
+
+/**@brief   BLE link simulator counters of one link. */
+typedef struct
+{
+    uint32_t elapsed_us;            //!< Simulated time covered by the counters, since the link connected or the last reset.
+    uint32_t conn_events;           //!< Connection events held.
+    uint32_t notifications;         //!< Notifications delivered to the peer.
+    uint32_t indications;           //!< Indications confirmed by the peer.
+    uint32_t peer_writes;           //!< Writes delivered from the peer.
+    uint32_t bytes_to_peer;         //!< Attribute bytes delivered to the peer.
+    uint32_t bytes_from_peer;       //!< Attribute bytes delivered from the peer.
+} ble_sim_link_stats_t;
+
+
+/**@brief   Function for resetting the simulated SoftDevice.
+ *
+ * @details Clears the attribute table, the links and the counters, and sets the simulated
+ *          clock to zero. The application then calls @ref sd_ble_enable and builds its
+ *          services, as after a reset.
+ *
+ * @param[in]   p_config    The configuration.
+ *
+ * @retval  NRF_SUCCESS                 If the simulator was reset.
+ * @retval  NRF_ERROR_NULL              If @p p_config is NULL.
+ * @retval  NRF_ERROR_INVALID_PARAM     If a value in @p p_config is out of range.
+ */
+uint32_t ble_sim_init(ble_sim_config_t const * p_config);
+
+
+/**@brief   Function for sending the queued events to the event handler.
+ *
+ * @details Events produced while the handler runs are sent as well.
+ *
+ * @retval  true    If at least one event was sent.
+ * @retval  false   If there was nothing to send, or no event handler is configured.
+ */
+bool ble_sim_process(void);
+
+
+/**@brief   Function for advancing the simulated clock.
+ *
+ * @details Holds every connection event and checks every advertising timeout that falls in
+ *          the time span, sending the resulting events to the event handler as they occur.
+ *
+ * @param[in]   us  The time span, in microseconds.
+ */
+void ble_sim_run_for(uint32_t us);
+
+
+/**@brief   Function for advancing the simulated clock by a number of connection events.
+ *
+ * @param[in]   conn_handle The link whose connection events are counted.
+ * @param[in]   count       The number of connection events, including skipped ones.
+ *
+ * @retval  NRF_SUCCESS                     If the connection events were held.
+ * @retval  BLE_ERROR_INVALID_CONN_HANDLE   If the link is not connected, or was lost while running.
+ */
+uint32_t ble_sim_run_events(uint16_t conn_handle, uint32_t count);
+
+
+/**@brief   Function for getting the simulated time, in microseconds. */
+uint64_t ble_sim_time_us(void);
+
+
+/**@brief   Function for connecting the peer to the advertising device.
+ *
+ * @param[in]   p_conn_params   The connection parameters chosen by the peer. The link runs at
+ *                              max_conn_interval.
+ * @param[out]  p_conn_handle   The handle of the new link.
+ *
+ * @retval  NRF_SUCCESS             If the link was established.
+ * @retval  NRF_ERROR_NULL          If a parameter is NULL.
+ * @retval  NRF_ERROR_INVALID_STATE If the device is not advertising.
+ * @retval  NRF_ERROR_NO_MEM        If all links are in use.
+ */
+uint32_t ble_sim_peer_connect(ble_gap_conn_params_t const * p_conn_params,
+                              uint16_t                    * p_conn_handle);
+
+
+/**@brief   Function for setting the address the peer connects with, e.g. a resolvable private
+ *          address as a phone uses.
+ *
+ * @param[in]   p_addr  The address, or NULL to give each link its own random static address,
+ *                      as after @ref ble_sim_init.
+ *
+ * @retval  NRF_SUCCESS             If the address was set.
+ * @retval  NRF_ERROR_INVALID_PARAM If the address type is not valid.
+ */
+uint32_t ble_sim_peer_addr_set(ble_gap_addr_t const * p_addr);
+
+
+/**@brief   Function for disconnecting the peer.
+ *
+ * @param[in]   conn_handle The link.
+ * @param[in]   reason      The HCI reason sent to the device, e.g.
+ *                          @ref BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION.
+ *
+ * @retval  NRF_SUCCESS                     If the link was terminated.
+ * @retval  BLE_ERROR_INVALID_CONN_HANDLE   If the link is not connected.
+ */
+uint32_t ble_sim_peer_disconnect(uint16_t conn_handle, uint8_t reason);
+
+
+/**@brief   Function for queuing a write from the peer.
+ *
+ * @details The write reaches the device in a later connection event. A write request is sent
+ *          only once the response to the previous one has arrived.
+ *
+ * @param[in]   conn_handle The link.
+ * @param[in]   handle      The attribute handle.
+ * @param[in]   p_data      The data.
+ * @param[in]   len         The length of the data, at most the ATT MTU minus three.
+ * @param[in]   write_op    @ref BLE_GATT_OP_WRITE_REQ or @ref BLE_GATT_OP_WRITE_CMD.
+ *
+ * @retval  NRF_SUCCESS                     If the write was queued.
+ * @retval  NRF_ERROR_NULL                  If @p p_data is NULL.
+ * @retval  NRF_ERROR_INVALID_PARAM         If @p write_op is not supported.
+ * @retval  NRF_ERROR_DATA_SIZE             If the data does not fit in one packet.
+ * @retval  NRF_ERROR_NO_MEM                If the peer queue is full.
+ * @retval  BLE_ERROR_INVALID_CONN_HANDLE   If the link is not connected.
+ */
+uint32_t ble_sim_peer_write(uint16_t        conn_handle,
+                            uint16_t        handle,
+                            uint8_t const * p_data,
+                            uint16_t        len,
+                            uint8_t         write_op);
+
+
+/**@brief   Function for queuing a write to the CCCD of a characteristic from the peer.
+ *
+ * @param[in]   conn_handle     The link.
+ * @param[in]   value_handle    The handle of the characteristic value.
+ * @param[in]   cccd_value      The new CCCD value, e.g. @ref BLE_GATT_HVX_NOTIFICATION.
+ *
+ * @retval  NRF_SUCCESS                     If the write was queued.
+ * @retval  BLE_ERROR_INVALID_ATTR_HANDLE   If the characteristic has no CCCD.
+ * @retval  BLE_ERROR_INVALID_CONN_HANDLE   If the link is not connected.
+ * @retval  NRF_ERROR_NO_MEM                If the peer queue is full.
+ */
+uint32_t ble_sim_peer_cccd_write(uint16_t conn_handle, uint16_t value_handle, uint16_t cccd_value);
+
+
+/**@brief   Function for setting the services of the peer's GATT server.
+ *
+ * @details Handles are given in order from 1: for each service its declaration, then for each
+ *          characteristic its declaration, its value and its CCCD if it has one. Procedures
+ *          already started are answered from the previous services, as when the peer's database
+ *          changes during a procedure.
+ *
+ * @param[in]   p_services  The services, in handle order.
+ * @param[in]   count       The number of services, zero for an empty server.
+ *
+ * @retval  NRF_SUCCESS         If the services were set.
+ * @retval  NRF_ERROR_NULL      If @p p_services, or the characteristics of a service, are NULL.
+ * @retval  NRF_ERROR_NO_MEM    If the services need more than @ref BLE_SIM_PEER_ATTR_MAX
+ *                              attributes. The server is not changed.
+ */
+uint32_t ble_sim_peer_db_set(ble_sim_peer_service_t const * p_services, uint8_t count);
+
+
+/**@brief   Function for getting the handles the peer gave to a characteristic.
+ *
+ * @param[in]   p_uuid          The characteristic UUID. The first characteristic with it is used.
+ * @param[out]  p_value_handle  The value handle.
+ * @param[out]  p_cccd_handle   The CCCD handle, or @ref BLE_GATT_HANDLE_INVALID if it has none.
+ *
+ * @retval  NRF_SUCCESS         If the handles were found.
+ * @retval  NRF_ERROR_NULL      If a parameter is NULL.
+ * @retval  NRF_ERROR_NOT_FOUND If the peer has no such characteristic.
+ */
+uint32_t ble_sim_peer_char_handles_get(ble_uuid_t const * p_uuid,
+                                       uint16_t         * p_value_handle,
+                                       uint16_t         * p_cccd_handle);
+
+
+/**@brief   Function for queuing a notification or an indication from the peer's GATT server.
+ *
+ * @details The packet reaches the device as @ref BLE_GATTC_EVT_HVX in a later connection event,
+ *          in order with the writes from the peer. An indication is sent only once the device
+ *          has confirmed the previous one with @ref sd_ble_gattc_hv_confirm. The peer's
+ *          application decides whether the CCCD allows the packet.
+ *
+ * @param[in]   conn_handle The link.
+ * @param[in]   handle      The characteristic value handle.
+ * @param[in]   type        @ref BLE_GATT_HVX_NOTIFICATION or @ref BLE_GATT_HVX_INDICATION.
+ * @param[in]   p_data      The data.
+ * @param[in]   len         The length of the data, at most the ATT MTU minus three.
+ *
+ * @retval  NRF_SUCCESS                     If the packet was queued.
+ * @retval  NRF_ERROR_NULL                  If @p p_data is NULL.
+ * @retval  NRF_ERROR_INVALID_PARAM         If @p type is not supported.
+ * @retval  BLE_ERROR_INVALID_ATTR_HANDLE   If @p handle is not a characteristic value of the peer.
+ * @retval  NRF_ERROR_DATA_SIZE             If the data does not fit in one packet.
+ * @retval  NRF_ERROR_NO_MEM                If the peer queue is full.
+ * @retval  BLE_ERROR_INVALID_CONN_HANDLE   If the link is not connected.
+ */
+uint32_t ble_sim_peer_hvx(uint16_t        conn_handle,
+                          uint16_t        handle,
+                          uint8_t         type,
+                          uint8_t const * p_data,
+                          uint16_t        len);
+
+
+/**@brief   Function for changing the packet loss of every link.
+ *
+ * @param[in]   loss_permille   The probability that an exchange of packets is lost, in 1/1000.
+ */
+void ble_sim_loss_set(uint16_t loss_permille);
+
+
+/**@brief   Function for getting the current connection parameters of a link.
+ *
+ * @retval  NRF_SUCCESS                     If the parameters were copied.
+ * @retval  NRF_ERROR_NULL                  If @p p_conn_params is NULL.
+ * @retval  BLE_ERROR_INVALID_CONN_HANDLE   If the link is not connected.
+ */
+uint32_t ble_sim_conn_params_get(uint16_t conn_handle, ble_gap_conn_params_t * p_conn_params);
+
+
+/**@brief   Function for getting the number of TX buffers currently in use on a link. */
+uint8_t ble_sim_tx_queued(uint16_t conn_handle);
+
+
+/**@brief   Function for checking whether the device is advertising. */
+bool ble_sim_is_advertising(void);
+
+
+/**@brief   Function for getting the counters. */
+void ble_sim_stats_get(ble_sim_stats_t * p_stats);
+
+
+/**@brief   Function for getting the counters of one link.
+ *
+ * @details The counters of a link are dropped when it disconnects.
+ *
+ * @retval  NRF_SUCCESS                     If the counters were copied.
+ * @retval  NRF_ERROR_NULL                  If @p p_stats is NULL.
+ * @retval  BLE_ERROR_INVALID_CONN_HANDLE   If the link is not connected.
+ */
+uint32_t ble_sim_link_stats_get(uint16_t conn_handle, ble_sim_link_stats_t * p_stats);
+
+
+/**@brief   Function for resetting the counters, including those of every link. */
+void ble_sim_stats_reset(void);
+
+
+#endif // BLE_SIM_H__
+
+/** @} */
@@ -0,0 +1,347 @@
+/* Copyright (c) 2016 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is property of Nordic Semiconductor ASA.
+ * Terms and conditions of usage are described in detail in NORDIC
+ * SEMICONDUCTOR STANDARD SOFTWARE LICENSE AGREEMENT.
+ *
+ * Licensees are granted free, non-transferable use of the information. NO
+ * WARRANTY of ANY KIND is provided. This heading must NOT be removed from
+ * the file.
+ *
+ */
+
+#include "dsp_kernels.h"
+
+#include <stdint.h>
+#include <string.h>
+
+
+#if DSP_KERNELS_SIMD
+
+/** Two adjacent q15 samples as one word, the lower address in the low half. Unaligned is fine. */
+#define PAIR_READ(p)        (*__SIMD32_CONST(p))
+#define PAIR_WRITE(p, v)    (*__SIMD32_CONST(p) = (v))
+
+static int32_t ssat16(int32_t value)
+{
+    return __SSAT(value, 16);
+}
+
+#else
+
+static int32_t ssat16(int32_t value)
+{
+    if (value > INT16_MAX)
+    {
+        return INT16_MAX;
+    }
+    if (value < INT16_MIN)
+    {
+        return INT16_MIN;
+    }
+    return value;
+}
+
+#endif // DSP_KERNELS_SIMD
+
+
+static q31_t ssat32(q63_t value)
+{
+    if (value > INT32_MAX)
+    {
+        return INT32_MAX;
+    }
+    if (value < INT32_MIN)
+    {
+        return INT32_MIN;
+    }
+    return (q31_t)value;
+}
+
+
+static uint16_t isqrt(uint32_t value)
+{
+    uint32_t root = 0;
+    uint32_t bit  = 1UL << 30;
+
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+
+    while (bit)
+    {
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root   = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint16_t)root;
+}
+
+
+void dsp_dcblock_q15_init(dsp_dcblock_q15_t * p_filter, q15_t a)
+{
+    p_filter->a      = a;
+    p_filter->primed = false;
+    p_filter->x1     = 0;
+    p_filter->y1     = 0;
+}
+
+
+void dsp_dcblock_q15(dsp_dcblock_q15_t * p_filter, q15_t const * p_src, q15_t * p_dst, uint16_t count)
+{
+    q15_t    x1 = p_filter->x1;
+    q15_t    y1 = p_filter->y1;
+    uint32_t acc;
+
+    if (count && !p_filter->primed)
+    {
+        x1               = p_src[0];
+        p_filter->primed = true;
+    }
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        const q15_t x = p_src[i];
+
+        // Wraps like the 32-bit ALU; a difference of two q15 samples fits in 17 bits.
+        acc  = (uint32_t)((int32_t)x - x1) << 15;
+        acc += (uint32_t)((int32_t)p_filter->a * y1);
+        x1   = x;
+        y1   = (q15_t)ssat16((int32_t)acc >> 15);
+        p_dst[i] = y1;
+    }
+
+    p_filter->x1 = x1;
+    p_filter->y1 = y1;
+}
+
+
+void dsp_biquad_q15_init(dsp_biquad_q15_t * p_filter, q15_t const p_coef[5], uint8_t frac_bits)
+{
+    memcpy(p_filter->coef, p_coef, sizeof(p_filter->coef));
+    p_filter->frac_bits = frac_bits;
+    p_filter->x1        = 0;
+    p_filter->x2        = 0;
+    p_filter->y1        = 0;
+    p_filter->y2        = 0;
+}
+
+
+void dsp_biquad_q15(dsp_biquad_q15_t * p_filter, q15_t const * p_src, q15_t * p_dst, uint16_t count)
+{
+    q15_t x1 = p_filter->x1;
+    q15_t x2 = p_filter->x2;
+    q15_t y1 = p_filter->y1;
+    q15_t y2 = p_filter->y2;
+
+#if DSP_KERNELS_SIMD
+    const uint32_t b01 = __PKHBT(p_filter->coef[0], p_filter->coef[1], 16);
+    const uint32_t a12 = __PKHBT(p_filter->coef[3], p_filter->coef[4], 16);
+    const int32_t  b2  = p_filter->coef[2];
+    int32_t        acc;
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        const q15_t x = p_src[i];
+
+        acc = __SMLAD(__PKHBT(x, x1, 16), b01, b2 * x2);
+        acc = __SMLAD(__PKHBT(y1, y2, 16), a12, acc);
+        x2  = x1;
+        x1  = x;
+        y2  = y1;
+        y1  = (q15_t)ssat16(acc >> p_filter->frac_bits);
+        p_dst[i] = y1;
+    }
+#else
+    q15_t const * p_coef = p_filter->coef;
+    uint32_t      acc;
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        const q15_t x = p_src[i];
+
+        acc  = (uint32_t)((int32_t)p_coef[0] * x);
+        acc += (uint32_t)((int32_t)p_coef[1] * x1);
+        acc += (uint32_t)((int32_t)p_coef[2] * x2);
+        acc += (uint32_t)((int32_t)p_coef[3] * y1);
+        acc += (uint32_t)((int32_t)p_coef[4] * y2);
+        x2   = x1;
+        x1   = x;
+        y2   = y1;
+        y1   = (q15_t)ssat16((int32_t)acc >> p_filter->frac_bits);
+        p_dst[i] = y1;
+    }
+#endif // DSP_KERNELS_SIMD
+
+    p_filter->x1 = x1;
+    p_filter->x2 = x2;
+    p_filter->y1 = y1;
+    p_filter->y2 = y2;
+}
+
+
+void dsp_fir_q15_init(dsp_fir_q15_t * p_filter,
+                      q15_t const   * p_coef,
+                      uint16_t        taps,
+                      q15_t         * p_state,
+                      uint16_t        max_block)
+{
+    p_filter->p_coef    = p_coef;
+    p_filter->p_state   = p_state;
+    p_filter->taps      = taps;
+    p_filter->max_block = max_block;
+    memset(p_state, 0, (taps - 1 + max_block) * sizeof(q15_t));
+}
+
+
+/**@brief Function for computing the sum of h[k] * p_newest[-k] over all taps. */
+static q63_t fir_dot(q15_t const * p_coef, uint16_t taps, q15_t const * p_newest)
+{
+    q63_t    acc = 0;
+    uint16_t k   = 0;
+
+#if DSP_KERNELS_SIMD
+    // The samples run backwards: the pair at p_newest[-k-1] holds x[-k-1] low and x[-k] high.
+    for (; k + 1 < taps; k += 2)
+    {
+        acc = __SMLALDX(PAIR_READ(&p_coef[k]), PAIR_READ(&p_newest[-k - 1]), acc);
+    }
+#endif // DSP_KERNELS_SIMD
+
+    for (; k < taps; k++)
+    {
+        acc += (int32_t)p_coef[k] * p_newest[-(int32_t)k];
+    }
+    return acc;
+}
+
+
+static q15_t fir_output(q63_t acc)
+{
+    return (q15_t)ssat16((int32_t)ssat32(acc >> 15));
+}
+
+
+/**@brief Function for appending a block to the history.
+ *
+ * @return Position of the first sample of the block in the history.
+ */
+static q15_t * fir_block_start(dsp_fir_q15_t * p_filter, q15_t const * p_src, uint16_t count)
+{
+    q15_t * p_history = p_filter->p_state + p_filter->taps - 1;
+
+    memcpy(p_history, p_src, count * sizeof(q15_t));
+    return p_history;
+}
+
+
+static void fir_block_end(dsp_fir_q15_t * p_filter, uint16_t count)
+{
+    memmove(p_filter->p_state, p_filter->p_state + count, (p_filter->taps - 1) * sizeof(q15_t));
+}
+
+
+void dsp_fir_q15(dsp_fir_q15_t * p_filter, q15_t const * p_src, q15_t * p_dst, uint16_t count)
+{
+    q15_t const * p_block = fir_block_start(p_filter, p_src, count);
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        p_dst[i] = fir_output(fir_dot(p_filter->p_coef, p_filter->taps, &p_block[i]));
+    }
+
+    fir_block_end(p_filter, count);
+}
+
+
+void dsp_fir_decimate_q15(dsp_fir_q15_t * p_filter,
+                          uint8_t         factor,
+                          q15_t const   * p_src,
+                          q15_t         * p_dst,
+                          uint16_t        count)
+{
+    q15_t const * p_block = fir_block_start(p_filter, p_src, count);
+
+    // Keep the last output of each group of factor samples.
+    for (uint16_t i = factor - 1; i < count; i += factor)
+    {
+        *p_dst++ = fir_output(fir_dot(p_filter->p_coef, p_filter->taps, &p_block[i]));
+    }
+
+    fir_block_end(p_filter, count);
+}
+
+
+void dsp_vmag3_q15(int16_t const * p_xyz, q15_t * p_dst, uint16_t count, uint8_t shift)
+{
+    for (uint16_t i = 0; i < count; i++, p_xyz += 3)
+    {
+        uint32_t sum;
+        uint32_t mag;
+
+#if DSP_KERNELS_SIMD
+        const uint32_t xy = PAIR_READ(p_xyz);
+
+        // x*x + y*y can reach 2^31 and wraps to negative, which is still right unsigned.
+        sum = (uint32_t)__SMUAD(xy, xy);
+#else
+        sum  = (uint32_t)((int32_t)p_xyz[0] * p_xyz[0]);
+        sum += (uint32_t)((int32_t)p_xyz[1] * p_xyz[1]);
+#endif // DSP_KERNELS_SIMD
+        sum += (uint32_t)((int32_t)p_xyz[2] * p_xyz[2]);
+
+        mag = (uint32_t)isqrt(sum) << shift;
+        p_dst[i] = (mag > INT16_MAX) ? INT16_MAX : (q15_t)mag;
+    }
+}
+
+
+void dsp_add_q15(q15_t const * p_src_a, q15_t const * p_src_b, q15_t * p_dst, uint16_t count)
+{
+    uint16_t i = 0;
+
+#if DSP_KERNELS_SIMD
+    for (; i + 1 < count; i += 2)
+    {
+        PAIR_WRITE(&p_dst[i], __QADD16(PAIR_READ(&p_src_a[i]), PAIR_READ(&p_src_b[i])));
+    }
+#endif // DSP_KERNELS_SIMD
+
+    for (; i < count; i++)
+    {
+        p_dst[i] = (q15_t)ssat16((int32_t)p_src_a[i] + p_src_b[i]);
+    }
+}
+
+
+void dsp_autocorr_q15(q15_t const * p_src, uint16_t count, q31_t * p_dst, uint16_t lags, uint8_t shift)
+{
+    for (uint16_t k = 0; k < lags; k++)
+    {
+        const uint16_t n   = (k < count) ? (count - k) : 0;
+        q63_t          acc = 0;
+        uint16_t       i   = 0;
+
+#if DSP_KERNELS_SIMD
+        for (; i + 1 < n; i += 2)
+        {
+            acc = __SMLALD(PAIR_READ(&p_src[i]), PAIR_READ(&p_src[i + k]), acc);
+        }
+#endif // DSP_KERNELS_SIMD
+
+        for (; i < n; i++)
+        {
+            acc += (int32_t)p_src[i] * p_src[i + k];
+        }
+
+        p_dst[k] = ssat32(acc >> shift);
+    }
+}
@@ -0,0 +1,162 @@
+/* Copyright (c) 2016 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is property of Nordic Semiconductor ASA.
+ * Terms and conditions of usage are described in detail in NORDIC
+ * SEMICONDUCTOR STANDARD SOFTWARE LICENSE AGREEMENT.
+ *
+ * Licensees are granted free, non-transferable use of the information. NO
+ * WARRANTY of ANY KIND is provided. This heading must NOT be removed from
+ * the file.
+ *
+ */
+
+/** @file
+ *
+ * @defgroup dsp_kernels Fixed-point DSP kernels
+ * @{
+ * @ingroup app_common
+ * @brief Q15/Q31 block kernels for the motion and PPG pipelines.
+ *
+ * @details The kernels cover filtering (DC blocker, biquad, FIR), decimation, 3-axis vector
+ *          magnitude, saturating addition and autocorrelation. The CMSIS-DSP library is not
+ *          linked; only the types and SIMD intrinsics of the CMSIS headers are used.
+ *
+ *          With ARM_MATH_CM4 defined the kernels use the Cortex-M4 DSP instructions: dual 16-bit
+ *          loads with SMLAD/SMLADX/SMLALD/SMLALDX multiply-accumulates, SMUAD and QADD16. Without
+ *          it, or with DSP_KERNELS_PORTABLE defined, they are built from plain C that wraps and
+ *          saturates exactly like those instructions, so both builds give bit-identical results
+ *          on any input and the portable build can be checked on a host.
+ *
+ *          Accumulators follow the instructions: FIR, decimation and autocorrelation sums are 64
+ *          bit and cannot overflow for blocks below 65536 samples. The biquad sum is 32 bit and
+ *          wraps; it cannot wrap when the magnitudes of its five coefficients add up to at most
+ *          65536. The filters and @ref dsp_add_q15 may write their output over their input.
+ */
+
+#ifndef DSP_KERNELS_H__
+#define DSP_KERNELS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(ARM_MATH_CM4) && !defined(DSP_KERNELS_PORTABLE)
+    #define DSP_KERNELS_SIMD    1
+#else
+    #define DSP_KERNELS_SIMD    0
+#endif
+
+#if defined(ARM_MATH_CM4)
+    #include "nrf.h"
+    #include "arm_math.h"
+#elif !defined(_ARM_MATH_H)
+    typedef int16_t q15_t;
+    typedef int32_t q31_t;
+    typedef int64_t q63_t;
+#endif
+
+
+/**@brief First-order DC blocker: y[n] = x[n] - x[n-1] + a * y[n-1], a in Q15.
+ *
+ * @details The first sample after @ref dsp_dcblock_q15_init is taken as the previous input, so
+ *          a constant input gives zero output from the start.
+ */
+typedef struct
+{
+    q15_t a;            /**< Pole, Q15. */
+    bool  primed;       /**< False until the first sample has been seen. */
+    q15_t x1;           /**< Previous input. */
+    q15_t y1;           /**< Previous output. */
+} dsp_dcblock_q15_t;
+
+/**@brief Direct form I biquad with coefficients b0, b1, b2, -a1, -a2 in Q(@p frac_bits). */
+typedef struct
+{
+    q15_t   coef[5];    /**< b0, b1, b2, -a1, -a2. */
+    uint8_t frac_bits;  /**< Fractional bits of the coefficients, the output shift. */
+    q15_t   x1;         /**< Input history. */
+    q15_t   x2;
+    q15_t   y1;         /**< Output history. */
+    q15_t   y2;
+} dsp_biquad_q15_t;
+
+/**@brief FIR filter with Q15 coefficients and a caller-provided history buffer.
+ *
+ * @details The history buffer holds @p taps - 1 + @p max_block samples.
+ */
+typedef struct
+{
+    q15_t const * p_coef;       /**< h[0] .. h[taps - 1], h[0] applies to the newest sample. */
+    q15_t       * p_state;      /**< History buffer. */
+    uint16_t      taps;
+    uint16_t      max_block;    /**< Largest block accepted by @ref dsp_fir_q15. */
+} dsp_fir_q15_t;
+
+
+/**@brief Function for initializing a DC blocker. */
+void dsp_dcblock_q15_init(dsp_dcblock_q15_t * p_filter, q15_t a);
+
+/**@brief Function for running a DC blocker over a block of samples. */
+void dsp_dcblock_q15(dsp_dcblock_q15_t * p_filter, q15_t const * p_src, q15_t * p_dst, uint16_t count);
+
+/**@brief Function for initializing a biquad.
+ *
+ * @param[out] p_filter  Filter.
+ * @param[in]  p_coef    b0, b1, b2, -a1, -a2.
+ * @param[in]  frac_bits Fractional bits of the coefficients, 14 for coefficients up to 2.
+ */
+void dsp_biquad_q15_init(dsp_biquad_q15_t * p_filter, q15_t const p_coef[5], uint8_t frac_bits);
+
+/**@brief Function for running a biquad over a block of samples. The output saturates. */
+void dsp_biquad_q15(dsp_biquad_q15_t * p_filter, q15_t const * p_src, q15_t * p_dst, uint16_t count);
+
+/**@brief Function for initializing a FIR filter and clearing its history.
+ *
+ * @param[out] p_filter  Filter.
+ * @param[in]  p_coef    Coefficients, Q15, kept by reference.
+ * @param[in]  taps      Number of coefficients, at least 1.
+ * @param[in]  p_state   History buffer of @p taps - 1 + @p max_block samples.
+ * @param[in]  max_block Largest block that will be filtered.
+ */
+void dsp_fir_q15_init(dsp_fir_q15_t * p_filter,
+                      q15_t const   * p_coef,
+                      uint16_t        taps,
+                      q15_t         * p_state,
+                      uint16_t        max_block);
+
+/**@brief Function for running a FIR filter over a block of at most max_block samples. */
+void dsp_fir_q15(dsp_fir_q15_t * p_filter, q15_t const * p_src, q15_t * p_dst, uint16_t count);
+
+/**@brief Function for FIR filtering and keeping every @p factor-th output.
+ *
+ * @details Only the kept outputs are computed. @p count must be a multiple of @p factor and the
+ *          filter must have been initialized for blocks of @p count samples. @p p_dst receives
+ *          @p count / @p factor samples.
+ */
+void dsp_fir_decimate_q15(dsp_fir_q15_t * p_filter,
+                          uint8_t         factor,
+                          q15_t const   * p_src,
+                          q15_t         * p_dst,
+                          uint16_t        count);
+
+/**@brief Function for computing |v| of interleaved 3-axis samples.
+ *
+ * @param[in]  p_xyz Samples, x, y, z for each.
+ * @param[out] p_dst isqrt(x*x + y*y + z*z) << @p shift, saturated to Q15.
+ * @param[in]  count Number of 3-axis samples.
+ * @param[in]  shift Left shift applied to the magnitude.
+ */
+void dsp_vmag3_q15(int16_t const * p_xyz, q15_t * p_dst, uint16_t count, uint8_t shift);
+
+/**@brief Function for adding two blocks with saturation. */
+void dsp_add_q15(q15_t const * p_src_a, q15_t const * p_src_b, q15_t * p_dst, uint16_t count);
+
+/**@brief Function for computing the autocorrelation of a block.
+ *
+ * @details p_dst[k] = (sum of x[i] * x[i + k] over the block) >> @p shift, saturated to Q31,
+ *          for k = 0 .. @p lags - 1. Lags at or beyond @p count give 0.
+ */
+void dsp_autocorr_q15(q15_t const * p_src, uint16_t count, q31_t * p_dst, uint16_t lags, uint8_t shift);
+
+#endif // DSP_KERNELS_H__
+
+/** @} */
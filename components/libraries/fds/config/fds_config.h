@@ -28,6 +28,43 @@
 /**@brief   Determines how many @ref fds_record_chunk_t structures can be buffered at any time. */
 #define FDS_CHUNK_QUEUE_SIZE        (8)
 
+/**@brief   Configures the number of entries in the RAM index used to look up records.
+ *
+ * The index maps each valid record to its location in flash, ordered by file ID, so that
+ * @ref fds_record_find, @ref fds_record_find_by_key and @ref fds_record_find_in_file do not
+ * need to walk every record header on every page. Each entry takes 8 bytes of RAM.
+ * If more records are stored than the index can hold, lookups fall back to scanning flash
+ * until records are deleted or updated, which rebuilds the index. Set to 0 to disable the index.
+ */
+#define FDS_RAM_INDEX_SIZE          (64)
+
+/**@brief   Configures how much data, in 4-byte words, garbage collection copies before it lets
+ *          other queued operations run.
+ *
+ * Garbage collection then proceeds in slices and queued writes are not stalled until a whole
+ * collection completes. Set to 0 to run garbage collection to completion in one go.
+ */
+#define FDS_GC_SLICE_WORDS          (128)
+
+/**@brief   Configures the free space watermark, in 4-byte words.
+ *
+ * When a write leaves less free space than this across all data pages, garbage collection of
+ * the page with the most deleted data is queued automatically. Completion is reported with
+ * an @ref FDS_EVT_GC event. Set to 0 to disable automatic garbage collection.
+ */
+#define FDS_GC_WATERMARK_WORDS      (FDS_VIRTUAL_PAGE_SIZE / 4)
+
+/**@brief   Configures the number of updates that can be held back by
+ *          @ref fds_record_update_deferred before they are written to flash.
+ *
+ * Deferred updates to the same record are merged, so that only the latest version is written
+ * when @ref fds_flush is called. Set to 0 to disable deferred updates.
+ */
+#define FDS_WRITE_BEHIND_SIZE       (4)
+
+/**@brief   Configures the maximum number of chunks in a deferred update. */
+#define FDS_WRITE_BEHIND_CHUNKS     (2)
+
 /**@brief   Configures the maximum number of callbacks that can be registered. */
 #define FDS_MAX_USERS               (3)
 
@@ -66,6 +66,16 @@ static fds_swap_page_t      m_swap_page;
 // Garbage collection data.
 static fds_gc_data_t        m_gc;
 
+#if (FDS_RAM_INDEX_SIZE > 0)
+// RAM index of record locations.
+static fds_index_t          m_index;
+#endif
+
+#if (FDS_WRITE_BEHIND_SIZE > 0)
+// Updates held back by fds_record_update_deferred().
+static fds_pending_update_t m_pending[FDS_WRITE_BEHIND_SIZE];
+#endif
+
 
 static void flag_set(fds_flags_t flag)
 {
@@ -199,9 +209,19 @@ static fds_page_type_t page_identify(uint32_t const * const p_page_addr)
 }
 
 
+// A page whose tag has only its first word written counts as erased: power was lost while
+// the page was being tagged, right after it was erased.
 static bool page_is_erased(uint32_t const * const p_page_addr)
 {
-    for (uint32_t i = 0; i < FDS_PAGE_SIZE; i++)
+    uint32_t i = 0;
+
+    if ((p_page_addr[FDS_PAGE_TAG_WORD_0] == FDS_PAGE_TAG_MAGIC) &&
+        (p_page_addr[FDS_PAGE_TAG_WORD_1] == FDS_ERASED_WORD))
+    {
+        i = FDS_PAGE_TAG_SIZE;
+    }
+
+    for (; i < FDS_PAGE_SIZE; i++)
     {
         if (*(p_page_addr + i) != FDS_ERASED_WORD)
         {
@@ -444,6 +464,258 @@ static bool record_find_by_desc(fds_record_desc_t * const p_desc, uint16_t * con
 }
 
 
+#if (FDS_RAM_INDEX_SIZE > 0)
+
+// Compares an index entry against a record location.
+// Returns a negative value if the entry sorts before the location, zero if it matches it and
+// a positive value if it sorts after it.
+static int32_t index_entry_cmp(fds_index_entry_t const * const p_entry,
+                               uint16_t                        file_id,
+                               uint16_t                        page,
+                               uint16_t                        offset)
+{
+    if (p_entry->file_id != file_id)
+    {
+        return (int32_t)p_entry->file_id - (int32_t)file_id;
+    }
+
+    if (p_entry->page != page)
+    {
+        return (int32_t)p_entry->page - (int32_t)page;
+    }
+
+    return (int32_t)p_entry->offset - (int32_t)offset;
+}
+
+
+// Returns the position of the first entry which does not sort before the given location.
+// NOTE: Must be called from within a critical section.
+static uint16_t index_lower_bound(uint16_t file_id, uint16_t page, uint16_t offset)
+{
+    uint16_t lo = 0;
+    uint16_t hi = m_index.count;
+
+    while (lo < hi)
+    {
+        uint16_t const mid = lo + ((hi - lo) / 2);
+
+        if (index_entry_cmp(&m_index.entry[mid], file_id, page, offset) < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+
+// Add a record to the index. If the index is full, it is invalidated and lookups
+// will scan flash until records are deleted and it is rebuilt.
+static void index_insert(uint16_t page, uint32_t const * const p_rec)
+{
+    fds_header_t const * const p_header = (fds_header_t*)p_rec;
+    uint16_t             const offset   = (uint16_t)(p_rec - m_pages[page].p_addr);
+    uint16_t                   pos;
+
+    CRITICAL_SECTION_ENTER();
+    if (m_index.valid)
+    {
+        pos = index_lower_bound(p_header->ic.file_id, page, offset);
+
+        if ((pos == m_index.count) ||
+            (index_entry_cmp(&m_index.entry[pos], p_header->ic.file_id, page, offset) != 0))
+        {
+            if (m_index.count == FDS_RAM_INDEX_SIZE)
+            {
+                m_index.valid = false;
+            }
+            else
+            {
+                memmove(&m_index.entry[pos + 1], &m_index.entry[pos],
+                        (m_index.count - pos) * sizeof(fds_index_entry_t));
+
+                m_index.entry[pos].file_id    = p_header->ic.file_id;
+                m_index.entry[pos].record_key = p_header->tl.record_key;
+                m_index.entry[pos].page       = page;
+                m_index.entry[pos].offset     = offset;
+                m_index.count++;
+            }
+        }
+    }
+    CRITICAL_SECTION_EXIT();
+}
+
+
+// Remove a record from the index.
+// The file ID is read from flash; it is left untouched when a record is flagged as dirty.
+static void index_remove(uint32_t const * const p_rec)
+{
+    fds_header_t const * const p_header = (fds_header_t*)p_rec;
+    uint16_t                   page;
+    uint16_t                   offset;
+    uint16_t                   pos;
+
+    if (page_from_record(&page, p_rec) != FDS_SUCCESS)
+    {
+        return;
+    }
+
+    offset = (uint16_t)(p_rec - m_pages[page].p_addr);
+
+    CRITICAL_SECTION_ENTER();
+    pos = index_lower_bound(p_header->ic.file_id, page, offset);
+
+    if ((pos < m_index.count) &&
+        (index_entry_cmp(&m_index.entry[pos], p_header->ic.file_id, page, offset) == 0))
+    {
+        m_index.count--;
+        memmove(&m_index.entry[pos], &m_index.entry[pos + 1],
+                (m_index.count - pos) * sizeof(fds_index_entry_t));
+    }
+    CRITICAL_SECTION_EXIT();
+}
+
+
+// Add all valid records stored on a page to the index.
+static void index_page_add(uint16_t page)
+{
+    uint32_t const * p_rec = NULL;
+
+    while (m_index.valid && record_find_next(page, &p_rec))
+    {
+        index_insert(page, p_rec);
+    }
+}
+
+
+// Drop all the entries referring to a page, e.g., because the page has been garbage collected.
+static void index_page_drop(uint16_t page)
+{
+    uint16_t kept = 0;
+
+    CRITICAL_SECTION_ENTER();
+    for (uint16_t i = 0; i < m_index.count; i++)
+    {
+        if (m_index.entry[i].page != page)
+        {
+            m_index.entry[kept++] = m_index.entry[i];
+        }
+    }
+    m_index.count = kept;
+    CRITICAL_SECTION_EXIT();
+}
+
+
+// (Re)build the index from the contents of flash.
+// If the records still do not fit, the scan stops at the first one left out.
+static void index_build(void)
+{
+    CRITICAL_SECTION_ENTER();
+    m_index.count = 0;
+    m_index.valid = true;
+    CRITICAL_SECTION_EXIT();
+
+    for (uint16_t page = 0; page < FDS_MAX_PAGES; page++)
+    {
+        if (m_pages[page].page_type == FDS_PAGE_DATA)
+        {
+            index_page_add(page);
+        }
+    }
+}
+
+
+// Search the index for a record. Same semantics as record_find(), but p_file_id and
+// p_record_key cannot both be NULL.
+static ret_code_t index_find(uint16_t          const * const p_file_id,
+                             uint16_t          const * const p_record_key,
+                             fds_record_desc_t       * const p_desc,
+                             fds_find_token_t        * const p_token)
+{
+    ret_code_t ret = FDS_ERR_NOT_FOUND;
+    uint16_t   pos = 0;
+
+    if (p_token->page >= FDS_MAX_PAGES)
+    {
+        // A previous search has already gone through all records.
+        return FDS_ERR_NOT_FOUND;
+    }
+
+    CRITICAL_SECTION_ENTER();
+    if (p_token->p_addr != NULL)
+    {
+        // Resume searching after the last record found. The record may have been deleted since,
+        // but its file ID and location are still known.
+        uint16_t const file_id = ((fds_header_t*)p_token->p_addr)->ic.file_id;
+        uint16_t const offset  = (uint16_t)(p_token->p_addr - m_pages[p_token->page].p_addr);
+
+        pos = index_lower_bound(file_id, p_token->page, offset);
+
+        if ((pos < m_index.count) &&
+            (index_entry_cmp(&m_index.entry[pos], file_id, p_token->page, offset) == 0))
+        {
+            pos++;
+        }
+    }
+    else if (p_file_id != NULL)
+    {
+        // Records of a file are contiguous in the index.
+        pos = index_lower_bound(*p_file_id, 0, 0);
+    }
+
+    for (; pos < m_index.count; pos++)
+    {
+        fds_index_entry_t const * const p_entry = &m_index.entry[pos];
+
+        if (p_file_id != NULL)
+        {
+            if (p_entry->file_id > *p_file_id)
+            {
+                // Past the records of this file.
+                break;
+            }
+
+            if (p_entry->file_id != *p_file_id)
+            {
+                continue;
+            }
+        }
+
+        if ((p_record_key != NULL) &&
+            (p_entry->record_key != *p_record_key))
+        {
+            continue;
+        }
+
+        // Record found; update the token and the descriptor.
+        p_token->page   = p_entry->page;
+        p_token->p_addr = m_pages[p_entry->page].p_addr + p_entry->offset;
+
+        p_desc->record_id    = ((fds_header_t*)p_token->p_addr)->record_id;
+        p_desc->p_record     = p_token->p_addr;
+        p_desc->gc_run_count = m_gc.run_count;
+
+        ret = FDS_SUCCESS;
+        break;
+    }
+
+    if (ret != FDS_SUCCESS)
+    {
+        p_token->page   = FDS_MAX_PAGES;
+        p_token->p_addr = NULL;
+    }
+    CRITICAL_SECTION_EXIT();
+
+    return ret;
+}
+
+#endif // FDS_RAM_INDEX_SIZE
+
+
 // Search for a record and return its descriptor.
 // If p_file_id is NULL, only the record key will be used for matching.
 // If p_record_key is NULL, only the file ID will be used for matching.
@@ -463,6 +735,14 @@ static ret_code_t record_find(uint16_t          const * const p_file_id,
         return FDS_ERR_NULL_ARG;
     }
 
+#if (FDS_RAM_INDEX_SIZE > 0)
+    // Iterating through all records is done in flash order, hence it does not use the index.
+    if ((m_index.valid) && ((p_file_id != NULL) || (p_record_key != NULL)))
+    {
+        return index_find(p_file_id, p_record_key, p_desc, p_token);
+    }
+#endif
+
     // Begin (or resume) searching for a record.
     for (; p_token->page < FDS_MAX_PAGES; p_token->page++)
     {
@@ -526,10 +806,8 @@ static void dirty_records_stat(uint16_t         page,
             (*p_dirty_records) += 1;
             (*p_word_count)    += p_header->tl.length_words;
         }
-        else
-        {
-            p_rec += (FDS_HEADER_SIZE + (p_header->tl.length_words));
-        }
+
+        p_rec += (FDS_HEADER_SIZE + (p_header->tl.length_words));
     }
 }
 
@@ -785,6 +1063,10 @@ static ret_code_t record_find_and_delete(fds_op_t * const p_op)
 
         // This page can now be garbage collected.
         m_pages[page].can_gc = true;
+
+#if (FDS_RAM_INDEX_SIZE > 0)
+        index_remove(desc.p_record);
+#endif
     }
     else
     {
@@ -815,6 +1097,10 @@ static ret_code_t file_find_and_delete(fds_op_t * const p_op)
 
         // This page can now be garbage collected.
         m_pages[tok.page].can_gc = true;
+
+#if (FDS_RAM_INDEX_SIZE > 0)
+        index_remove(desc.p_record);
+#endif
     }
     else // FDS_ERR_NOT_FOUND
     {
@@ -879,11 +1165,60 @@ static bool crc_verify_success(uint16_t crc, uint16_t len_words, uint32_t const
 #endif
 
 
-static void gc_init(void)
+// Obtain the next page to be garbage collected. Pages with the most dirty data are collected first.
+// Returns true if there are pages left to garbage collect, returns false otherwise.
+static bool gc_page_next(uint16_t * const p_next_page)
+{
+    bool     ret       = false;
+    uint16_t max_words = 0;
+
+    for (uint16_t i = 0; i < FDS_MAX_PAGES; i++)
+    {
+        if (!m_gc.do_gc_page[i])
+        {
+            continue;
+        }
+
+        // Only GC pages with no open records and with some records which have been deleted.
+        if ((m_pages[i].records_open != 0) || (m_pages[i].can_gc == false))
+        {
+            // Do not attempt to GC this page again.
+            m_gc.do_gc_page[i] = false;
+            continue;
+        }
+
+        uint16_t dirty_records = 0;
+        uint16_t dirty_words   = 0;
+
+        dirty_records_stat(i, &dirty_records, &dirty_words);
+
+        // Account for the headers of the dirty records, too.
+        dirty_words += (dirty_records * FDS_HEADER_SIZE);
+
+        if ((!ret) || (dirty_words > max_words))
+        {
+            *p_next_page = i;
+            max_words    = dirty_words;
+            ret          = true;
+        }
+    }
+
+    if (ret)
+    {
+        // Do not attempt to GC this page again.
+        m_gc.do_gc_page[*p_next_page] = false;
+    }
+
+    return ret;
+}
+
+
+static void gc_init(bool single_page)
 {
     m_gc.run_count++;
-    m_gc.cur_page = 0;
-    m_gc.resume   = false;
+    m_gc.cur_page    = 0;
+    m_gc.resume      = false;
+    m_gc.slice_words = 0;
 
     // Setup which pages to GC. Defer checking for open records and the can_gc flag,
     // as other operations might change those while GC is running.
@@ -891,33 +1226,124 @@ static void gc_init(void)
     {
         m_gc.do_gc_page[i] = (m_pages[i].page_type == FDS_PAGE_DATA);
     }
+
+    if (single_page)
+    {
+        // Only collect the page which frees up the most space.
+        uint16_t   page;
+        bool const found = gc_page_next(&page);
+
+        memset(m_gc.do_gc_page, 0x00, sizeof(m_gc.do_gc_page));
+
+        if (found)
+        {
+            m_gc.do_gc_page[page] = true;
+        }
+    }
 }
 
 
-// Obtain the next page to be garbage collected.
-// Returns true if there are pages left to garbage collect, returns false otherwise.
-static bool gc_page_next(uint16_t * const p_next_page)
+// Returns true if a GC operation is in the queue.
+static bool gc_op_queued(void)
 {
     bool ret = false;
 
-    for (uint16_t i = 0; i < FDS_MAX_PAGES; i++)
+    CRITICAL_SECTION_ENTER();
+    for (uint32_t i = 0; i < m_op_queue.count; i++)
     {
-        if (m_gc.do_gc_page[i])
+        if (m_op_queue.op[(m_op_queue.rp + i) % FDS_OP_QUEUE_SIZE].op_code == FDS_OP_GC)
         {
-            // Do not attempt to GC this page again.
-            m_gc.do_gc_page[i] = false;
+            ret = true;
+            break;
+        }
+    }
+    CRITICAL_SECTION_EXIT();
+
+    return ret;
+}
+
+
+// Determine whether GC should let other queued operations run before taking its next step.
+// GC only yields once its slice is used up, and only at points where the queued operations
+// cannot corrupt the page being collected: in between pages, or in between record copies
+// if all queued operations are plain writes. Writes appended to the page being collected
+// are copied to swap like any other record, but flagging a record as dirty after it has been
+// copied would leave a stale copy in swap.
+static bool gc_should_yield(void)
+{
+#if (FDS_GC_SLICE_WORDS > 0)
+    bool ret = false;
 
-            // Only GC pages with no open records and with some records which have been deleted.
-            if ((m_pages[i].records_open == 0) && (m_pages[i].can_gc == true))
+    if (m_gc.slice_words < FDS_GC_SLICE_WORDS)
+    {
+        return false;
+    }
+
+    CRITICAL_SECTION_ENTER();
+    // The GC operation itself is at the head of the queue.
+    if (m_op_queue.count > 1)
+    {
+        if (m_gc.state == GC_NEXT_PAGE)
+        {
+            ret = true;
+        }
+        else if (m_gc.state == GC_FIND_NEXT_RECORD)
+        {
+            ret = true;
+            for (uint32_t i = 1; i < m_op_queue.count; i++)
             {
-                *p_next_page = i;
-                ret = true;
-                break;
+                if (m_op_queue.op[(m_op_queue.rp + i) % FDS_OP_QUEUE_SIZE].op_code != FDS_OP_WRITE)
+                {
+                    ret = false;
+                    break;
+                }
             }
         }
     }
+    CRITICAL_SECTION_EXIT();
 
     return ret;
+#else
+    return false;
+#endif
+}
+
+
+// Queue garbage collection of the dirtiest page if free space is running low.
+static void gc_auto_trigger(void)
+{
+#if (FDS_GC_WATERMARK_WORDS > 0)
+    uint32_t free_words = 0;
+    bool     can_gc     = false;
+    fds_op_t op;
+
+    if ((m_gc.state != GC_BEGIN) || gc_op_queued())
+    {
+        return;
+    }
+
+    CRITICAL_SECTION_ENTER();
+    for (uint16_t i = 0; i < FDS_MAX_PAGES; i++)
+    {
+        if (m_pages[i].page_type == FDS_PAGE_DATA)
+        {
+            free_words += FDS_PAGE_SIZE - (m_pages[i].write_offset + m_pages[i].words_reserved);
+            can_gc     |= m_pages[i].can_gc;
+        }
+    }
+    CRITICAL_SECTION_EXIT();
+
+    if ((free_words >= FDS_GC_WATERMARK_WORDS) || (!can_gc))
+    {
+        return;
+    }
+
+    op.op_code        = FDS_OP_GC;
+    op.gc.single_page = true;
+
+    // If the queue is full, try again on the next write.
+    (void)op_enqueue(&op, 0, NULL);
+#endif
 }
 
 
@@ -1013,6 +1439,14 @@ static ret_code_t gc_next_page(void)
         m_gc.cur_page     = 0;
         m_gc.p_record_src = NULL;
 
+#if (FDS_RAM_INDEX_SIZE > 0)
+        if (!m_index.valid)
+        {
+            // The index overflowed earlier; GC might have freed enough entries.
+            index_build();
+        }
+#endif
+
         return FDS_OP_COMPLETED;
     }
 
@@ -1027,6 +1461,7 @@ static void gc_update_swap_offset(void)
     uint16_t     const         record_len = FDS_HEADER_SIZE + p_header->tl.length_words;
 
     m_swap_page.write_offset += record_len;
+    m_gc.slice_words         += record_len;
 }
 
 
@@ -1045,12 +1480,12 @@ static void gc_swap_pages(void)
 }
 
 
-static void gc_state_advance(void)
+static void gc_state_advance(fds_op_t const * const p_op)
 {
     switch (m_gc.state)
     {
         case GC_BEGIN:
-            gc_init();
+            gc_init(p_op->gc.single_page);
             m_gc.state = GC_NEXT_PAGE;
             break;
 
@@ -1063,6 +1498,11 @@ static void gc_state_advance(void)
         // A page was successfully erased. Prepare to promote the swap.
         case GC_ERASE_PAGE:
             gc_swap_pages();
+#if (FDS_RAM_INDEX_SIZE > 0)
+            // The records of this page now live in what used to be the swap.
+            index_page_drop(m_gc.cur_page);
+            index_page_add(m_gc.cur_page);
+#endif
             m_gc.state = GC_PROMOTE_SWAP;
             break;
 
@@ -1076,6 +1516,8 @@ static void gc_state_advance(void)
 
         case GC_TAG_NEW_SWAP:
             m_gc.state = GC_NEXT_PAGE;
+            // A page erase is the longest flash operation; end the slice here.
+            m_gc.slice_words = FDS_GC_SLICE_WORDS;
             break;
 
         default:
@@ -1121,6 +1563,9 @@ static ret_code_t init_execute(uint32_t prev_ret, fds_op_t * const p_op)
             }
             if (!write_reqd)
             {
+#if (FDS_RAM_INDEX_SIZE > 0)
+                index_build();
+#endif
                 flag_set(FDS_FLAG_INITIALIZED);
                 flag_clear(FDS_FLAG_INITIALIZING);
                 return FDS_OP_COMPLETED;
@@ -1237,6 +1682,14 @@ static ret_code_t write_execute(uint32_t prev_ret, fds_op_t * const p_op)
         case FDS_OP_WRITE_DONE:
             ret = FDS_OP_COMPLETED;
 
+#if (FDS_RAM_INDEX_SIZE > 0)
+            index_insert(p_op->write.page, p_write_addr);
+            if (p_op->op_code == FDS_OP_UPDATE)
+            {
+                index_remove(desc.p_record);
+            }
+#endif
+
 #if defined(FDS_CRC_ENABLED)
             if (flag_is_set(FDS_FLAG_VERIFY_CRC))
             {
@@ -1306,7 +1759,7 @@ static ret_code_t delete_execute(uint32_t prev_ret, fds_op_t * const p_op)
 }
 
 
-static ret_code_t gc_execute(uint32_t prev_ret)
+static ret_code_t gc_execute(uint32_t prev_ret, fds_op_t const * const p_op)
 {
     ret_code_t ret;
 
@@ -1317,11 +1770,19 @@ static ret_code_t gc_execute(uint32_t prev_ret)
 
     if (m_gc.resume)
     {
-        m_gc.resume = false;
+        m_gc.resume      = false;
+        m_gc.slice_words = 0;
     }
     else
     {
-        gc_state_advance();
+        gc_state_advance(p_op);
+
+        if (gc_should_yield())
+        {
+            // Retry the current step once the other queued operations have been processed.
+            m_gc.resume = true;
+            return FDS_OP_YIELD;
+        }
     }
 
     switch (m_gc.state)
@@ -1383,7 +1844,7 @@ static void queue_process(fs_ret_t result)
             break;
 
         case FDS_OP_GC:
-            ret = gc_execute(result);
+            ret = gc_execute(result, p_op);
             break;
 
         default:
@@ -1391,6 +1852,21 @@ static void queue_process(fs_ret_t result)
             break;
     }
 
+    if (ret == FDS_OP_YIELD)
+    {
+        // Move the operation to the back of the queue and process the operations behind it.
+        // Re-enqueuing cannot fail, since advancing the queue has just freed one element.
+        fds_op_t const op = *p_op;
+
+        CRITICAL_SECTION_ENTER();
+        (void)queue_advance();
+        (void)op_enqueue(&op, 0, NULL);
+        CRITICAL_SECTION_EXIT();
+
+        queue_process(FS_SUCCESS);
+        return;
+    }
+
     if (ret != FDS_OP_EXECUTING)
     {
         fds_evt_t evt;
@@ -1409,6 +1885,19 @@ static void queue_process(fs_ret_t result)
             chunk_queue_skip(p_op);
         }
 
+#if (FDS_RAM_INDEX_SIZE > 0)
+        if ((ret == FDS_OP_COMPLETED) && (!m_index.valid) &&
+            ((p_op->op_code == FDS_OP_UPDATE)     ||
+             (p_op->op_code == FDS_OP_DEL_RECORD) ||
+             (p_op->op_code == FDS_OP_DEL_FILE)))
+        {
+            // The index overflowed earlier and records have now been flagged as dirty in flash,
+            // so they might all fit again. Rebuilding here, rather than once garbage collection
+            // completes, keeps the rebuild in line with the other flash operations.
+            index_build();
+        }
+#endif
+
         event_prepare(p_op, &evt);
         event_send(&evt);
 
@@ -1557,6 +2046,9 @@ static ret_code_t write_enqueue(fds_record_desc_t         * const p_desc,
         p_desc->gc_run_count   = m_gc.run_count;
     }
 
+    // Reclaim space in the background if the file system is getting full.
+    gc_auto_trigger();
+
     // Start processing the queue, if necessary.
     queue_start();
 
@@ -1617,6 +2109,9 @@ ret_code_t fds_init(void)
 
     if (init_opts == ALREADY_INSTALLED)
     {
+#if (FDS_RAM_INDEX_SIZE > 0)
+        index_build();
+#endif
         // No initialization is necessary. Notify the application immediately.
         flag_set(FDS_FLAG_INITIALIZED);
         flag_clear(FDS_FLAG_INITIALIZING);
@@ -1815,6 +2310,120 @@ ret_code_t fds_reserve_cancel(fds_reserve_token_t * const p_tok)
 }
 
 
+#if (FDS_WRITE_BEHIND_SIZE > 0)
+
+// Returns the held back update to the given file ID and record key, or NULL if there is none.
+static fds_pending_update_t * pending_find(uint16_t file_id, uint16_t record_key)
+{
+    for (uint32_t i = 0; i < FDS_WRITE_BEHIND_SIZE; i++)
+    {
+        if ((m_pending[i].num_chunks != 0)       &&
+            (m_pending[i].file_id    == file_id) &&
+            (m_pending[i].record_key == record_key))
+        {
+            return &m_pending[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+// Returns the held back update which replaces the given record, or NULL if there is none.
+static fds_pending_update_t * pending_find_by_record(uint32_t record_id)
+{
+    for (uint32_t i = 0; i < FDS_WRITE_BEHIND_SIZE; i++)
+    {
+        if ((m_pending[i].num_chunks != 0) && (m_pending[i].record_to_delete == record_id))
+        {
+            return &m_pending[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+static fds_pending_update_t * pending_find_free(void)
+{
+    for (uint32_t i = 0; i < FDS_WRITE_BEHIND_SIZE; i++)
+    {
+        if (m_pending[i].num_chunks == 0)
+        {
+            return &m_pending[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+// Discards held back updates to records in the given file.
+static void pending_discard_file(uint16_t file_id)
+{
+    for (uint32_t i = 0; i < FDS_WRITE_BEHIND_SIZE; i++)
+    {
+        if (m_pending[i].file_id == file_id)
+        {
+            m_pending[i].num_chunks = 0;
+        }
+    }
+}
+
+
+// Queues a held back update and frees its slot.
+static ret_code_t pending_flush_one(fds_pending_update_t * const p_pending)
+{
+    ret_code_t        ret;
+    fds_record_desc_t desc   = {0};
+    fds_record_t      record;
+
+    desc.record_id          = p_pending->record_to_delete;
+    record.file_id          = p_pending->file_id;
+    record.key              = p_pending->record_key;
+    record.data.p_chunks    = p_pending->chunk;
+    record.data.num_chunks  = p_pending->num_chunks;
+
+    ret = write_enqueue(&desc, &record, NULL, FDS_OP_UPDATE);
+
+    // Keep the update if it can be retried once the queue has drained.
+    if (ret != FDS_ERR_NO_SPACE_IN_QUEUES)
+    {
+        p_pending->num_chunks = 0;
+    }
+
+    return ret;
+}
+
+
+// Queues all held back updates.
+static ret_code_t pending_flush(void)
+{
+    ret_code_t ret = FDS_SUCCESS;
+
+    for (uint32_t i = 0; i < FDS_WRITE_BEHIND_SIZE; i++)
+    {
+        if (m_pending[i].num_chunks != 0)
+        {
+            ret_code_t const err = pending_flush_one(&m_pending[i]);
+
+            if (err == FDS_ERR_NO_SPACE_IN_QUEUES)
+            {
+                return err;
+            }
+            else if (ret == FDS_SUCCESS)
+            {
+                ret = err;
+            }
+        }
+    }
+
+    return ret;
+}
+
+#endif
+
+
 ret_code_t fds_record_write(fds_record_desc_t       * const p_desc,
                             fds_record_t      const * const p_record)
 {
@@ -1845,7 +2454,121 @@ ret_code_t fds_record_update(fds_record_desc_t       * const p_desc,
         return FDS_ERR_NULL_ARG;
     }
 
-    return write_enqueue(p_desc, p_record, NULL, FDS_OP_UPDATE);
+#if (FDS_WRITE_BEHIND_SIZE > 0)
+    fds_pending_update_t * const p_pending = (p_record != NULL) ?
+                                             pending_find(p_record->file_id, p_record->key) :
+                                             NULL;
+#endif
+
+    ret_code_t const ret = write_enqueue(p_desc, p_record, NULL, FDS_OP_UPDATE);
+
+#if (FDS_WRITE_BEHIND_SIZE > 0)
+    // This update supersedes the one which was held back.
+    if ((ret == FDS_SUCCESS) && (p_pending != NULL))
+    {
+        p_pending->num_chunks = 0;
+    }
+#endif
+
+    return ret;
+}
+
+
+ret_code_t fds_record_update_deferred(fds_record_desc_t const * const p_desc,
+                                      fds_record_t      const * const p_record)
+{
+#if (FDS_WRITE_BEHIND_SIZE > 0)
+    fds_pending_update_t * p_pending;
+
+    if (!flag_is_set(FDS_FLAG_INITIALIZED))
+    {
+        return FDS_ERR_NOT_INITIALIZED;
+    }
+
+    if ((p_desc == NULL) || (p_record == NULL))
+    {
+        return FDS_ERR_NULL_ARG;
+    }
+
+    if ((p_record->file_id == FDS_FILE_ID_INVALID) ||
+        (p_record->key     == FDS_RECORD_KEY_DIRTY))
+    {
+        return FDS_ERR_INVALID_ARG;
+    }
+
+    if (!chunk_is_aligned(p_record->data.p_chunks,
+                          p_record->data.num_chunks))
+    {
+        return FDS_ERR_UNALIGNED_ADDR;
+    }
+
+    // Records with too many chunks to be held back are updated right away.
+    if ((p_record->data.num_chunks == 0) ||
+        (p_record->data.num_chunks > FDS_WRITE_BEHIND_CHUNKS))
+    {
+        fds_record_desc_t desc = *p_desc;
+        return fds_record_update(&desc, p_record);
+    }
+
+    // Merge with an update to the same file ID and record key. The descriptor of the merged
+    // update might not be the one held back, e.g. if the record was looked up again in the
+    // meantime, so the merged update keeps replacing the record it was first given.
+    p_pending = pending_find(p_record->file_id, p_record->key);
+
+    if (p_pending == NULL)
+    {
+        // Use a free slot, making one if necessary.
+        p_pending = pending_find_free();
+
+        if (p_pending == NULL)
+        {
+            (void)pending_flush();
+            p_pending = pending_find_free();
+        }
+
+        if (p_pending == NULL)
+        {
+            return FDS_ERR_NO_SPACE_IN_QUEUES;
+        }
+
+        p_pending->record_to_delete = p_desc->record_id;
+    }
+
+    // Replace any older version of the record.
+    p_pending->file_id          = p_record->file_id;
+    p_pending->record_key       = p_record->key;
+    p_pending->num_chunks       = p_record->data.num_chunks;
+
+    memcpy(p_pending->chunk, p_record->data.p_chunks,
+           p_record->data.num_chunks * sizeof(fds_record_chunk_t));
+
+    return FDS_SUCCESS;
+#else
+    fds_record_desc_t desc;
+
+    if (p_desc == NULL)
+    {
+        return FDS_ERR_NULL_ARG;
+    }
+
+    desc = *p_desc;
+    return fds_record_update(&desc, p_record);
+#endif
+}
+
+
+ret_code_t fds_flush(void)
+{
+    if (!flag_is_set(FDS_FLAG_INITIALIZED))
+    {
+        return FDS_ERR_NOT_INITIALIZED;
+    }
+
+#if (FDS_WRITE_BEHIND_SIZE > 0)
+    return pending_flush();
+#else
+    return FDS_SUCCESS;
+#endif
 }
 
 
@@ -1869,6 +2592,13 @@ ret_code_t fds_record_delete(fds_record_desc_t * const p_desc)
 
     if (op_enqueue(&op, 0, NULL))
     {
+#if (FDS_WRITE_BEHIND_SIZE > 0)
+        fds_pending_update_t * const p_pending = pending_find_by_record(p_desc->record_id);
+        if (p_pending != NULL)
+        {
+            p_pending->num_chunks = 0;
+        }
+#endif
         queue_start();
         return FDS_SUCCESS;
     }
@@ -1897,6 +2627,9 @@ ret_code_t fds_file_delete(uint16_t file_id)
 
     if (op_enqueue(&op, 0, NULL))
     {
+#if (FDS_WRITE_BEHIND_SIZE > 0)
+        pending_discard_file(file_id);
+#endif
         queue_start();
         return FDS_SUCCESS;
     }
@@ -1914,11 +2647,15 @@ ret_code_t fds_gc(void)
         return FDS_ERR_NOT_INITIALIZED;
     }
 
-    op.op_code = FDS_OP_GC;
+    op.op_code        = FDS_OP_GC;
+    op.gc.single_page = false;
+
+    // If GC is in progress but no GC operation is queued, then the previous one has failed.
+    bool const resume = (m_gc.state != GC_BEGIN) && !gc_op_queued();
 
     if (op_enqueue(&op, 0, NULL))
     {
-        if (m_gc.state != GC_BEGIN)
+        if (resume)
         {
             // Resume GC by retrying the last step.
             m_gc.resume = true;
@@ -510,6 +510,51 @@ ret_code_t fds_record_update(fds_record_desc_t       * const p_desc,
                              fds_record_t      const * const p_record);
 
 
+/**@brief   Function for updating a record at a later time.
+ *
+ * The update is held back in RAM until @ref fds_flush is called or until there is no room to
+ * hold it. If an update with the same file ID and record key is already held back, it is
+ * replaced, so that only the latest version is written to flash. The merged update replaces
+ * the record given to the first one. Deleting that record or its file discards the update.
+ *
+ * Until the update is flushed, searching for the record returns the old version, and
+ * @p p_desc still refers to it. The data must be kept in memory until the callback for the
+ * update has been received. A single @ref FDS_EVT_UPDATE event is sent for merged updates.
+ *
+ * Call @ref fds_flush periodically and before the system is shut down, for example when the
+ * battery is running low.
+ *
+ * @param[in]   p_desc      The descriptor of the record to update.
+ * @param[in]   p_record    The updated record to be written to flash.
+ *
+ * @retval  FDS_SUCCESS                 If the update was held back or queued successfully.
+ * @retval  FDS_ERR_NOT_INITIALIZED     If the module is not initialized.
+ * @retval  FDS_ERR_NULL_ARG            If @p p_desc or @p p_record is NULL.
+ * @retval  FDS_ERR_INVALID_ARG         If the file ID or the record key is invalid.
+ * @retval  FDS_ERR_UNALIGNED_ADDR      If the record data is not aligned to a 4 byte boundary.
+ * @retval  FDS_ERR_NO_SPACE_IN_QUEUES  If the update could be neither held back nor queued.
+ * @retval  FDS_ERR_NO_SPACE_IN_FLASH   If there is not enough free space in flash to store the
+ *                                      updated record.
+ */
+ret_code_t fds_record_update_deferred(fds_record_desc_t const * const p_desc,
+                                      fds_record_t      const * const p_record);
+
+
+/**@brief   Function for writing all updates held back by @ref fds_record_update_deferred.
+ *
+ * This function is asynchronous. Completion of each update is reported through an
+ * @ref FDS_EVT_UPDATE event that is sent to the registered event handler function.
+ *
+ * @retval  FDS_SUCCESS                 If all held back updates were queued successfully.
+ * @retval  FDS_ERR_NOT_INITIALIZED     If the module is not initialized.
+ * @retval  FDS_ERR_NO_SPACE_IN_QUEUES  If the operation queue is full. The updates which could
+ *                                      not be queued remain held back.
+ * @retval  FDS_ERR_NO_SPACE_IN_FLASH   If there is not enough free space in flash to store an
+ *                                      updated record. That update is discarded.
+ */
+ret_code_t fds_flush(void);
+
+
 /**@brief   Function for iterating through all records in flash.
  *
  * To search for the next record, call the function again and supply the same @ref fds_find_token_t
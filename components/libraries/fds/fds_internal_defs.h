@@ -45,6 +45,7 @@
 
 #define FDS_OP_EXECUTING        (FS_SUCCESS)
 #define FDS_OP_COMPLETED        (0x1D1D)
+#define FDS_OP_YIELD            (0x1D1E)    // The operation must be resumed after other queued operations.
 
 // The size of a physical page, in 4-byte words.
 #if   defined(NRF51)
@@ -189,6 +190,10 @@ typedef struct
             uint16_t          record_key;
             uint32_t          record_to_delete;
         } del;
+        struct
+        {
+            bool single_page;                   // Only collect the page with the most dirty data.
+        } gc;
     };
 } fds_op_t;
 
@@ -285,9 +290,49 @@ typedef struct
     uint16_t         run_count;                 // Total number of times GC was run.
     bool             do_gc_page[FDS_MAX_PAGES]; // Controls which pages to garbage collect.
     bool             resume;                    // Whether or not GC should be resumed.
+    uint16_t         slice_words;               // Words copied since GC last yielded.
 } fds_gc_data_t;
 
 
+#if (FDS_RAM_INDEX_SIZE > 0)
+
+// Location of a valid record, as kept in the RAM index.
+typedef struct
+{
+    uint16_t file_id;       // The ID of the file that the record belongs to.
+    uint16_t record_key;    // The record key.
+    uint16_t page;          // The page (index in m_pages) on which the record is stored.
+    uint16_t offset;        // Offset of the record from the page address, in 4-byte words.
+} fds_index_entry_t;
+
+
+// RAM index of valid records, sorted by file ID, page and offset. Within a file, entries are
+// therefore in the same order in which record_find_next() would visit them in flash.
+typedef struct
+{
+    fds_index_entry_t entry[FDS_RAM_INDEX_SIZE];
+    uint16_t          count;    // Number of entries in use.
+    bool              valid;    // False if the index overflowed; lookups then scan flash.
+} fds_index_t;
+
+#endif
+
+
+#if (FDS_WRITE_BEHIND_SIZE > 0)
+
+// An update held back by fds_record_update_deferred().
+typedef struct
+{
+    uint32_t           record_to_delete;                    // ID of the record being updated.
+    uint16_t           file_id;
+    uint16_t           record_key;
+    uint16_t           num_chunks;                          // Zero if the slot is free.
+    fds_record_chunk_t chunk[FDS_WRITE_BEHIND_CHUNKS];
+} fds_pending_update_t;
+
+#endif
+
+
 // Macros to enable and disable application interrupts.
 #if defined (FDS_THREADS)
 
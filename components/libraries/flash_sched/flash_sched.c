@@ -0,0 +1,280 @@
+/* Copyright (c) 2016 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is property of Nordic Semiconductor ASA.
+ * Terms and conditions of usage are described in detail in NORDIC
+ * SEMICONDUCTOR STANDARD SOFTWARE LICENSE AGREEMENT.
+ *
+ * Licensees are granted free, non-transferable use of the information. NO
+ * WARRANTY of ANY KIND is provided. This heading must NOT be removed from
+ * the file.
+ *
+ */
+
+#include "flash_sched.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrf.h"
+#include "nrf_error.h"
+#include "nrf_soc.h"
+#include "app_timer.h"
+#include "ble_radio_notification.h"
+
+
+#if   (FLASH_SCHED_DISTANCE_US == 800)
+    #define FLASH_SCHED_DISTANCE    NRF_RADIO_NOTIFICATION_DISTANCE_800US
+#elif (FLASH_SCHED_DISTANCE_US == 1740)
+    #define FLASH_SCHED_DISTANCE    NRF_RADIO_NOTIFICATION_DISTANCE_1740US
+#elif (FLASH_SCHED_DISTANCE_US == 2680)
+    #define FLASH_SCHED_DISTANCE    NRF_RADIO_NOTIFICATION_DISTANCE_2680US
+#elif (FLASH_SCHED_DISTANCE_US == 3620)
+    #define FLASH_SCHED_DISTANCE    NRF_RADIO_NOTIFICATION_DISTANCE_3620US
+#elif (FLASH_SCHED_DISTANCE_US == 4560)
+    #define FLASH_SCHED_DISTANCE    NRF_RADIO_NOTIFICATION_DISTANCE_4560US
+#elif (FLASH_SCHED_DISTANCE_US == 5500)
+    #define FLASH_SCHED_DISTANCE    NRF_RADIO_NOTIFICATION_DISTANCE_5500US
+#else
+    #error "FLASH_SCHED_DISTANCE_US must be a radio notification distance."
+#endif
+
+
+static bool                 m_initialized;                      // Whether radio notifications are enabled.
+static bool                 m_radio_seen;                       // Whether a radio event has been notified.
+static volatile bool        m_radio_active;                     // Whether a radio event is in progress.
+static uint32_t             m_last_active;                      // RTC1 ticks at the last radio event notification.
+static uint32_t             m_period_us;                        // Estimated time between radio events, zero if unknown.
+static bool                 m_waiting;                          // Whether an operation is being held back.
+static uint8_t              m_defer_count;                      // Gaps the current operation has been held back for.
+static flash_sched_resume_t m_users[FLASH_SCHED_MAX_USERS];     // Handlers to call when a new gap begins.
+static uint8_t              m_user_count;
+
+APP_TIMER_DEF(m_idle_timer_id);                                 // Resumes held back operations if the radio goes quiet.
+
+
+// Converts RTC1 ticks to microseconds.
+static uint32_t ticks_to_us(uint32_t ticks)
+{
+    return (uint32_t)(((uint64_t)ticks * 1000000 * (NRF_RTC1->PRESCALER + 1)) /
+                      APP_TIMER_CLOCK_FREQ);
+}
+
+
+// Microseconds since the last radio event notification.
+static uint32_t since_last_active_us(void)
+{
+    uint32_t now;
+    uint32_t diff;
+
+    (void)app_timer_cnt_get(&now);
+    (void)app_timer_cnt_diff_compute(now, m_last_active, &diff);
+
+    return ticks_to_us(diff);
+}
+
+
+static void resume_users(void)
+{
+    m_waiting = false;
+
+    for (uint32_t i = 0; i < m_user_count; i++)
+    {
+        m_users[i]();
+    }
+}
+
+
+static void idle_timeout_handler(void * p_context)
+{
+    if (m_waiting)
+    {
+        // No radio event has ended since the operation was held back.
+        resume_users();
+    }
+}
+
+
+static void radio_notification_evt_handler(bool radio_active)
+{
+    if (radio_active)
+    {
+        uint32_t const since = since_last_active_us();
+
+        if (m_radio_seen && (since < FLASH_SCHED_IDLE_TIMEOUT_US))
+        {
+            // Follow shorter intervals at once, longer ones slowly: overestimating the gap
+            // costs a failed flash operation, underestimating it only costs some throughput.
+            if ((m_period_us == 0) || (since < m_period_us))
+            {
+                m_period_us = since;
+            }
+            else
+            {
+                m_period_us = ((m_period_us * 3) + since) / 4;
+            }
+        }
+        else
+        {
+            m_period_us = 0;
+        }
+
+        (void)app_timer_cnt_get(&m_last_active);
+        m_radio_seen   = true;
+        m_radio_active = true;
+    }
+    else
+    {
+        m_radio_active = false;
+
+        if (m_waiting)
+        {
+            m_defer_count++;
+            resume_users();
+        }
+    }
+}
+
+
+// Returns the idle time left before the next radio event, in microseconds.
+static uint32_t gap_left_us(void)
+{
+    uint32_t since;
+
+    if (!m_initialized || !m_radio_seen)
+    {
+        return UINT32_MAX;
+    }
+
+    since = since_last_active_us();
+
+    if (since >= FLASH_SCHED_IDLE_TIMEOUT_US)
+    {
+        // The radio has gone quiet, e.g. because the link is down.
+        return UINT32_MAX;
+    }
+
+    if (m_radio_active || (m_period_us == 0))
+    {
+        return 0;
+    }
+
+    if (since + FLASH_SCHED_MARGIN_US >= m_period_us)
+    {
+        return 0;
+    }
+
+    return m_period_us - since - FLASH_SCHED_MARGIN_US;
+}
+
+
+// Holds an operation back until the next gap, unless it has been held back for too long.
+// Returns true if the operation must wait.
+static bool defer(void)
+{
+    if (m_defer_count >= FLASH_SCHED_MAX_DEFER)
+    {
+        m_defer_count = 0;
+        return false;
+    }
+
+    if (!m_waiting)
+    {
+        m_waiting = true;
+        (void)app_timer_start(m_idle_timer_id,
+                              APP_TIMER_TICKS(FLASH_SCHED_IDLE_TIMEOUT_US / 1000,
+                                              NRF_RTC1->PRESCALER),
+                              NULL);
+    }
+
+    return true;
+}
+
+
+uint32_t flash_sched_init(uint32_t irq_priority)
+{
+    uint32_t err_code;
+
+    err_code = app_timer_create(&m_idle_timer_id, APP_TIMER_MODE_SINGLE_SHOT, idle_timeout_handler);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    err_code = ble_radio_notification_init(irq_priority,
+                                           FLASH_SCHED_DISTANCE,
+                                           radio_notification_evt_handler);
+    if (err_code == NRF_SUCCESS)
+    {
+        m_initialized = true;
+    }
+
+    return err_code;
+}
+
+
+uint32_t flash_sched_register(flash_sched_resume_t resume)
+{
+    if (m_user_count == FLASH_SCHED_MAX_USERS)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    m_users[m_user_count++] = resume;
+
+    return NRF_SUCCESS;
+}
+
+
+uint16_t flash_sched_write_words(uint16_t max_words)
+{
+    uint32_t const gap_us = gap_left_us();
+    uint32_t       words;
+
+    if (gap_us == UINT32_MAX)
+    {
+        return max_words;
+    }
+
+    words = gap_us / FLASH_SCHED_WRITE_WORD_US;
+
+    if (words == 0)
+    {
+        return defer() ? 0 : max_words;
+    }
+
+    m_defer_count = 0;
+
+    return (words < max_words) ? (uint16_t)words : max_words;
+}
+
+
+bool flash_sched_write_allowed(uint16_t words)
+{
+    if ((gap_left_us() / FLASH_SCHED_WRITE_WORD_US) >= words)
+    {
+        m_defer_count = 0;
+        return true;
+    }
+
+    return !defer();
+}
+
+
+bool flash_sched_erase_allowed(void)
+{
+    if (gap_left_us() >= FLASH_SCHED_ERASE_PAGE_US)
+    {
+        m_defer_count = 0;
+        return true;
+    }
+
+    // A page erase can be neither split nor suspended. If radio events come too often for any
+    // gap to hold one, e.g. on a connection, holding the erase back would only delay it by
+    // FLASH_SCHED_MAX_DEFER gaps: issue it now and let the SoftDevice find time for it.
+    if ((m_period_us != 0) && (m_period_us < FLASH_SCHED_ERASE_PAGE_US + FLASH_SCHED_MARGIN_US))
+    {
+        m_defer_count = 0;
+        return true;
+    }
+
+    return !defer();
+}
@@ -0,0 +1,148 @@
+/* Copyright (c) 2016 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is property of Nordic Semiconductor ASA.
+ * Terms and conditions of usage are described in detail in NORDIC
+ * SEMICONDUCTOR STANDARD SOFTWARE LICENSE AGREEMENT.
+ *
+ * Licensees are granted free, non-transferable use of the information. NO
+ * WARRANTY of ANY KIND is provided. This heading must NOT be removed from
+ * the file.
+ *
+ */
+
+/** @file
+ *
+ * @defgroup flash_sched Radio-aware flash scheduler
+ * @{
+ * @ingroup app_common
+ * @brief Module for timing flash operations in between radio events.
+ *
+ * @details The SoftDevice rejects flash operations that do not fit in between radio events with
+ *          @ref NRF_EVT_FLASH_OPERATION_ERROR, and the flash modules then retry them. This module
+ *          uses @ref ble_radio_notification to estimate the idle time left until the next radio
+ *          event, so that @ref fstorage and @ref pstorage only issue operations that can complete
+ *          in that time.
+ *
+ *          Until @ref flash_sched_init has been called, or while no radio activity has been
+ *          seen for @ref FLASH_SCHED_IDLE_TIMEOUT_US, every operation is allowed right away.
+ *
+ * @note    Page erases are only scheduled when radio events are further apart than
+ *          @ref FLASH_SCHED_ERASE_PAGE_US, e.g. while advertising. On a connection no gap can
+ *          hold an erase, because the nRF52832 can neither split nor suspend one. Erases are
+ *          then issued at once and left to the SoftDevice, which either makes room for them in
+ *          the radio schedule or fails them, and the flash modules retry. Keep erases off the
+ *          connection where possible, e.g. by running garbage collection when the link is down.
+ */
+
+#ifndef FLASH_SCHED_H__
+#define FLASH_SCHED_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/**@brief   Time from the radio notification until the radio is active, in microseconds.
+ *          Must match one of the @ref nrf_radio_notification_distance_t values.
+ */
+#ifndef FLASH_SCHED_DISTANCE_US
+    #define FLASH_SCHED_DISTANCE_US         (800)
+#endif
+
+/**@brief   Time left unused at the end of each gap, to absorb timing jitter, in microseconds. */
+#ifndef FLASH_SCHED_MARGIN_US
+    #define FLASH_SCHED_MARGIN_US           (500)
+#endif
+
+/**@brief   Worst case time to write one word of flash, in microseconds. */
+#ifndef FLASH_SCHED_WRITE_WORD_US
+    #define FLASH_SCHED_WRITE_WORD_US       (68)
+#endif
+
+/**@brief   Worst case time to erase one flash page, in microseconds. */
+#ifndef FLASH_SCHED_ERASE_PAGE_US
+    #define FLASH_SCHED_ERASE_PAGE_US       (90000)
+#endif
+
+/**@brief   Time without radio activity after which flash operations are no longer held back,
+ *          in microseconds.
+ */
+#ifndef FLASH_SCHED_IDLE_TIMEOUT_US
+    #define FLASH_SCHED_IDLE_TIMEOUT_US     (1000000)
+#endif
+
+/**@brief   Number of radio gaps an operation may be held back for before it is issued anyway,
+ *          leaving it to the SoftDevice to find time for it.
+ */
+#ifndef FLASH_SCHED_MAX_DEFER
+    #define FLASH_SCHED_MAX_DEFER           (8)
+#endif
+
+/**@brief   Maximum number of modules that can register to be resumed. */
+#ifndef FLASH_SCHED_MAX_USERS
+    #define FLASH_SCHED_MAX_USERS           (2)
+#endif
+
+
+/**@brief   Handler called when an operation that was held back may be retried.
+ *
+ * @details The handler is called from the radio notification interrupt, right after a radio
+ *          event has ended.
+ */
+typedef void (*flash_sched_resume_t)(void);
+
+
+/**@brief   Function for initializing the flash scheduler.
+ *
+ * @details Configures radio notifications to be sent to this module. The application must not
+ *          use @ref ble_radio_notification_init for other purposes.
+ *
+ * @param[in]   irq_priority    Priority of the radio notification interrupt. Use the same
+ *                              priority at which SoftDevice events are handled.
+ *
+ * @return  NRF_SUCCESS on successful initialization, otherwise an error code.
+ */
+uint32_t flash_sched_init(uint32_t irq_priority);
+
+
+/**@brief   Function for registering a handler to be called when held back operations may be
+ *          retried.
+ *
+ * @retval  NRF_SUCCESS         If the handler was registered.
+ * @retval  NRF_ERROR_NO_MEM    If @ref FLASH_SCHED_MAX_USERS handlers are already registered.
+ */
+uint32_t flash_sched_register(flash_sched_resume_t resume);
+
+
+/**@brief   Function for obtaining how many words can be written to flash right now.
+ *
+ * @param[in]   max_words   The number of words the caller wants to write.
+ *
+ * @return  The number of words, up to @p max_words, which fit in the current radio gap.
+ *          Zero if the caller must wait. Registered handlers are then called once another
+ *          gap begins.
+ */
+uint16_t flash_sched_write_words(uint16_t max_words);
+
+
+/**@brief   Function for checking whether a write that cannot be split can be issued right now.
+ *
+ * @param[in]   words   The number of words to write.
+ *
+ * @return  True if the write fits in the current radio gap. If false, the caller must wait.
+ *          Registered handlers are then called once another gap begins.
+ */
+bool flash_sched_write_allowed(uint16_t words);
+
+
+/**@brief   Function for checking whether a flash page can be erased right now.
+ *
+ * @return  True if the erase fits in the current radio gap, or if no gap between the current
+ *          radio events can hold it. If false, the caller must wait. Registered handlers are
+ *          then called once another gap begins.
+ */
+bool flash_sched_erase_allowed(void);
+
+
+#endif // FLASH_SCHED_H__
+
+/** @} */
@@ -0,0 +1,402 @@
+/* Copyright (c) 2016 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is property of Nordic Semiconductor ASA.
+ * Terms and conditions of usage are described in detail in NORDIC
+ * SEMICONDUCTOR STANDARD SOFTWARE LICENSE AGREEMENT.
+ *
+ * Licensees are granted free, non-transferable use of the information. NO
+ * WARRANTY of ANY KIND is provided. This heading must NOT be removed from
+ * the file.
+ *
+ */
+
+#include "flash_sim.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "nrf_error.h"
+#include "nrf_soc.h"
+
+
+#define FLASH_SIM_WORDS_PER_PAGE    (FLASH_SIM_PAGE_SIZE / sizeof(uint32_t))
+
+
+// Flash operation waiting for flash_sim_process().
+typedef enum
+{
+    SIM_OP_NONE,
+    SIM_OP_WRITE,
+    SIM_OP_ERASE
+} sim_op_code_t;
+
+typedef struct
+{
+    sim_op_code_t    op_code;
+    uint32_t       * p_dst;
+    uint32_t const * p_src;
+    uint32_t         size;
+    uint32_t         page_number;
+} sim_op_t;
+
+
+static flash_sim_config_t m_config;
+static uint32_t         * m_p_flash;            // Simulated flash, mapped at m_config.base_addr.
+static uint8_t          * m_p_write_count;      // Writes to each word since its page was erased.
+static uint32_t         * m_p_erase_count;      // Erases of each page.
+static sim_op_t           m_op;
+static flash_sim_stats_t  m_stats;
+static uint64_t           m_time_us;
+static uint32_t           m_fail_count;         // Operations left to fail.
+static bool               m_power_loss_armed;
+static uint32_t           m_power_loss_words;   // Words left to program before power is lost.
+static bool               m_power_lost;
+
+
+static uint32_t flash_size(void)
+{
+    return (uint32_t)m_config.page_count * FLASH_SIM_PAGE_SIZE;
+}
+
+
+static bool addr_is_simulated(uint32_t addr, uint32_t size_bytes)
+{
+    return (addr >= m_config.base_addr) &&
+           ((uint64_t)addr + size_bytes <= (uint64_t)m_config.base_addr + flash_size());
+}
+
+
+// Programs one word. Returns false if power was lost before the word was written.
+static bool word_program(uint32_t * p_dst, uint32_t value)
+{
+    uint32_t const index = (uint32_t)(p_dst - m_p_flash);
+
+    if (m_power_loss_armed)
+    {
+        if (m_power_loss_words == 0)
+        {
+            m_power_lost = true;
+            return false;
+        }
+        m_power_loss_words--;
+    }
+
+    if (value & ~(*p_dst))
+    {
+        m_stats.bit_set_attempts++;
+    }
+
+    if (++m_p_write_count[index] > FLASH_SIM_MAX_WRITES_PER_WORD)
+    {
+        m_stats.overwrites++;
+    }
+
+    // NOR flash can only clear bits.
+    *p_dst &= value;
+
+    m_stats.words_written++;
+    m_stats.busy_time_us += FLASH_SIM_WRITE_WORD_US;
+    m_time_us            += FLASH_SIM_WRITE_WORD_US;
+
+    return true;
+}
+
+
+static void op_write_execute(void)
+{
+    for (uint32_t i = 0; i < m_op.size; i++)
+    {
+        if (!word_program(&m_op.p_dst[i], m_op.p_src[i]))
+        {
+            return;
+        }
+    }
+
+    m_stats.write_ops++;
+}
+
+
+static void op_erase_execute(void)
+{
+    uint32_t const page = m_op.page_number - (m_config.base_addr / FLASH_SIM_PAGE_SIZE);
+
+    if (m_power_loss_armed && (m_power_loss_words == 0))
+    {
+        m_power_lost = true;
+        return;
+    }
+
+    memset(&m_p_flash[page * FLASH_SIM_WORDS_PER_PAGE], 0xFF, FLASH_SIM_PAGE_SIZE);
+    memset(&m_p_write_count[page * FLASH_SIM_WORDS_PER_PAGE], 0x00, FLASH_SIM_WORDS_PER_PAGE);
+
+    m_p_erase_count[page]++;
+
+    m_stats.erase_ops++;
+    m_stats.busy_time_us += FLASH_SIM_ERASE_PAGE_US;
+    m_time_us            += FLASH_SIM_ERASE_PAGE_US;
+}
+
+
+static uint32_t op_accept(void)
+{
+    if ((m_p_flash == NULL) || m_power_lost)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (m_op.op_code != SIM_OP_NONE)
+    {
+        m_stats.busy_rejects++;
+        return NRF_ERROR_BUSY;
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_flash_write(uint32_t * const p_dst, uint32_t const * const p_src, uint32_t size)
+{
+    uint32_t const err_code = op_accept();
+
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    if (((uintptr_t)p_dst & 0x03) || ((uintptr_t)p_src & 0x03))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    if ((size == 0) || (size > FLASH_SIM_MAX_WRITE_WORDS))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    if (!addr_is_simulated((uint32_t)(uintptr_t)p_dst, size * sizeof(uint32_t)))
+    {
+        return NRF_ERROR_FORBIDDEN;
+    }
+
+    m_op.op_code = SIM_OP_WRITE;
+    m_op.p_dst   = p_dst;
+    m_op.p_src   = p_src;
+    m_op.size    = size;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_flash_page_erase(uint32_t page_number)
+{
+    uint32_t const err_code = op_accept();
+
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    if (!addr_is_simulated(page_number * FLASH_SIM_PAGE_SIZE, FLASH_SIM_PAGE_SIZE))
+    {
+        return NRF_ERROR_FORBIDDEN;
+    }
+
+    m_op.op_code     = SIM_OP_ERASE;
+    m_op.page_number = page_number;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t flash_sim_init(flash_sim_config_t const * p_config)
+{
+    void * p_map;
+
+    if (p_config == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    if ((p_config->base_addr % FLASH_SIM_PAGE_SIZE) != 0)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    flash_sim_uninit();
+
+    m_config = *p_config;
+
+    // The storage modules dereference flash addresses, so map the flash where it really is.
+    p_map = mmap((void *)(uintptr_t)m_config.base_addr, flash_size(),
+                 PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (p_map == MAP_FAILED)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    if ((uintptr_t)p_map != m_config.base_addr)
+    {
+        (void)munmap(p_map, flash_size());
+        return NRF_ERROR_NO_MEM;
+    }
+
+    m_p_flash       = (uint32_t *)p_map;
+    m_p_write_count = calloc(flash_size() / sizeof(uint32_t), sizeof(uint8_t));
+    m_p_erase_count = calloc(m_config.page_count, sizeof(uint32_t));
+
+    if ((m_p_write_count == NULL) || (m_p_erase_count == NULL))
+    {
+        flash_sim_uninit();
+        return NRF_ERROR_NO_MEM;
+    }
+
+    memset(m_p_flash, 0xFF, flash_size());
+
+    memset(&m_op,    0x00, sizeof(m_op));
+    memset(&m_stats, 0x00, sizeof(m_stats));
+
+    m_time_us          = 0;
+    m_fail_count       = 0;
+    m_power_loss_armed = false;
+    m_power_lost       = false;
+
+    return NRF_SUCCESS;
+}
+
+
+void flash_sim_uninit(void)
+{
+    if (m_p_flash != NULL)
+    {
+        (void)munmap(m_p_flash, flash_size());
+        m_p_flash = NULL;
+    }
+
+    free(m_p_write_count);
+    free(m_p_erase_count);
+
+    m_p_write_count = NULL;
+    m_p_erase_count = NULL;
+}
+
+
+bool flash_sim_process(void)
+{
+    uint32_t sys_evt = NRF_EVT_FLASH_OPERATION_SUCCESS;
+
+    if (m_op.op_code == SIM_OP_NONE)
+    {
+        return false;
+    }
+
+    if (m_fail_count > 0)
+    {
+        // The SoftDevice gave up on the operation without touching flash.
+        m_fail_count--;
+        m_stats.failed_ops++;
+        sys_evt = NRF_EVT_FLASH_OPERATION_ERROR;
+    }
+    else if (m_op.op_code == SIM_OP_WRITE)
+    {
+        op_write_execute();
+    }
+    else
+    {
+        op_erase_execute();
+    }
+
+    m_op.op_code = SIM_OP_NONE;
+
+    if (!m_power_lost && (m_config.evt_handler != NULL))
+    {
+        m_config.evt_handler(sys_evt);
+    }
+
+    return true;
+}
+
+
+void flash_sim_run(void)
+{
+    while (flash_sim_process())
+    {
+        // Keep going until the event handlers stop issuing operations.
+    }
+}
+
+
+void flash_sim_fail_next(uint32_t count)
+{
+    m_fail_count = count;
+}
+
+
+void flash_sim_power_loss_arm(uint32_t words)
+{
+    m_power_loss_armed = true;
+    m_power_loss_words = words;
+}
+
+
+bool flash_sim_power_lost(void)
+{
+    return m_power_lost;
+}
+
+
+void flash_sim_power_restore(void)
+{
+    m_power_loss_armed = false;
+    m_power_lost       = false;
+    m_op.op_code       = SIM_OP_NONE;
+}
+
+
+uint64_t flash_sim_time_us(void)
+{
+    return m_time_us;
+}
+
+
+void flash_sim_time_advance(uint32_t us)
+{
+    m_time_us += us;
+}
+
+
+void flash_sim_stats_get(flash_sim_stats_t * p_stats)
+{
+    if (p_stats != NULL)
+    {
+        *p_stats = m_stats;
+    }
+}
+
+
+void flash_sim_stats_reset(void)
+{
+    memset(&m_stats, 0x00, sizeof(m_stats));
+
+    if (m_p_erase_count != NULL)
+    {
+        memset(m_p_erase_count, 0x00, m_config.page_count * sizeof(uint32_t));
+    }
+}
+
+
+uint32_t flash_sim_page_erase_count(uint32_t page_number)
+{
+    uint32_t const first_page = m_config.base_addr / FLASH_SIM_PAGE_SIZE;
+
+    if ((m_p_erase_count == NULL) ||
+        (page_number < first_page) ||
+        (page_number >= first_page + m_config.page_count))
+    {
+        return 0;
+    }
+
+    return m_p_erase_count[page_number - first_page];
+}
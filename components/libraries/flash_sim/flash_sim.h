@@ -0,0 +1,184 @@
+/* Copyright (c) 2016 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is property of Nordic Semiconductor ASA.
+ * Terms and conditions of usage are described in detail in NORDIC
+ * SEMICONDUCTOR STANDARD SOFTWARE LICENSE AGREEMENT.
+ *
+ * Licensees are granted free, non-transferable use of the information. NO
+ * WARRANTY of ANY KIND is provided. This heading must NOT be removed from
+ * the file.
+ *
+ */
+
+/** @file
+ *
+ * @defgroup flash_sim Flash simulator
+ * @{
+ * @ingroup app_common
+ * @brief Host-side model of the nRF52 flash behind the SoftDevice flash API.
+ *
+ * @details This module implements @ref sd_flash_write and @ref sd_flash_page_erase on a Linux host,
+ *          so that @ref fds, @ref fstorage, @ref pstorage and the DFU banks can run unmodified
+ *          off-target. The simulated flash is mapped at its real address, because the storage
+ *          modules read flash through plain pointers.
+ *
+ *          The model follows the nRF52 flash:
+ *          - Pages are @ref FLASH_SIM_PAGE_SIZE bytes and erase to all ones.
+ *          - Writes can only clear bits. Attempts to set a bit are counted and have no effect.
+ *          - A word may only be written @ref FLASH_SIM_MAX_WRITES_PER_WORD times between erases.
+ *          - Each operation takes the datasheet time, which advances a simulated clock.
+ *
+ *          Operations complete when @ref flash_sim_process is called, which then sends
+ *          NRF_EVT_FLASH_OPERATION_SUCCESS or NRF_EVT_FLASH_OPERATION_ERROR to the system event
+ *          handler, as the SoftDevice would. Power loss can be injected after any number of
+ *          programmed words, to check that the storage modules recover.
+ *
+ * @note    Build for the host with SVCALL_AS_NORMAL_FUNCTION defined, so that the SoftDevice
+ *          headers declare plain functions, and as a position dependent program (-fno-pie,
+ *          -no-pie), since the storage modules keep flash and RAM addresses in 32-bit integers.
+ *          test/CMakeLists.txt does this in nrf_target().
+ */
+
+#ifndef FLASH_SIM_H__
+#define FLASH_SIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define FLASH_SIM_PAGE_SIZE             (4096)  /**< Size of a flash page, in bytes. */
+#define FLASH_SIM_MAX_WRITE_WORDS       (1024)  /**< Maximum length of a single write, in words. */
+#define FLASH_SIM_MAX_WRITES_PER_WORD   (2)     /**< Number of times a word may be written between erases. */
+
+#ifndef FLASH_SIM_WRITE_WORD_US
+    #define FLASH_SIM_WRITE_WORD_US     (41)    /**< Time to write one word, in microseconds. */
+#endif
+
+#ifndef FLASH_SIM_ERASE_PAGE_US
+    #define FLASH_SIM_ERASE_PAGE_US     (85000) /**< Time to erase one page, in microseconds. */
+#endif
+
+
+/**@brief   System event handler, normally the application's sys_evt_dispatch(). */
+typedef void (*flash_sim_evt_handler_t)(uint32_t sys_evt);
+
+
+/**@brief   Flash simulator configuration. */
+typedef struct
+{
+    uint32_t                base_addr;      //!< Address of the first simulated page. Must be page aligned.
+    uint16_t                page_count;     //!< Number of simulated pages.
+    flash_sim_evt_handler_t evt_handler;    //!< Handler which receives flash operation events.
+} flash_sim_config_t;
+
+
+/**@brief   Flash simulator counters. */
+typedef struct
+{
+    uint32_t write_ops;         //!< Completed write operations.
+    uint32_t erase_ops;         //!< Completed page erases.
+    uint32_t words_written;     //!< Words programmed, including interrupted writes.
+    uint32_t failed_ops;        //!< Operations completed with NRF_EVT_FLASH_OPERATION_ERROR.
+    uint32_t busy_rejects;      //!< Calls rejected with NRF_ERROR_BUSY.
+    uint32_t bit_set_attempts;  //!< Words in which a write tried to change a zero bit to one.
+    uint32_t overwrites;        //!< Words written more than FLASH_SIM_MAX_WRITES_PER_WORD times.
+    uint64_t busy_time_us;      //!< Time spent executing flash operations.
+} flash_sim_stats_t;
+
+
+/**@brief   Function for creating the simulated flash.
+ *
+ * @details All pages start out erased. Calling this function again discards the previous flash
+ *          content.
+ *
+ * @param[in]   p_config    The configuration.
+ *
+ * @retval  NRF_SUCCESS             If the flash was created.
+ * @retval  NRF_ERROR_NULL          If @p p_config is NULL.
+ * @retval  NRF_ERROR_INVALID_ADDR  If the base address is not page aligned.
+ * @retval  NRF_ERROR_NO_MEM        If the flash could not be mapped at the base address.
+ */
+uint32_t flash_sim_init(flash_sim_config_t const * p_config);
+
+
+/**@brief   Function for removing the simulated flash. */
+void flash_sim_uninit(void);
+
+
+/**@brief   Function for completing the pending flash operation, if any.
+ *
+ * @details Applies the operation to the flash, advances the simulated clock and sends the
+ *          result to the event handler. Nothing is sent if power loss was injected during the
+ *          operation.
+ *
+ * @retval  true    If an operation was pending.
+ * @retval  false   If there was nothing to do.
+ */
+bool flash_sim_process(void);
+
+
+/**@brief   Function for completing flash operations until none are pending.
+ *
+ * @details Operations started by the event handler are completed as well.
+ */
+void flash_sim_run(void);
+
+
+/**@brief   Function for making the next flash operations fail, as they do when the SoftDevice
+ *          cannot fit them in between radio events.
+ *
+ * @param[in]   count   The number of operations that fail.
+ */
+void flash_sim_fail_next(uint32_t count);
+
+
+/**@brief   Function for injecting power loss.
+ *
+ * @details Power is lost once @p words more words have been programmed. The write in progress
+ *          stops at that word. An erase in progress when the count runs out leaves the page
+ *          unchanged. No more flash operations are accepted until @ref flash_sim_power_restore
+ *          is called.
+ *
+ * @param[in]   words   The number of words programmed before power is lost.
+ */
+void flash_sim_power_loss_arm(uint32_t words);
+
+
+/**@brief   Function for checking whether injected power loss has occurred. */
+bool flash_sim_power_lost(void);
+
+
+/**@brief   Function for restoring power. Flash content is kept and any pending operation is
+ *          dropped, as after a reset.
+ */
+void flash_sim_power_restore(void);
+
+
+/**@brief   Function for getting the simulated time, in microseconds. */
+uint64_t flash_sim_time_us(void);
+
+
+/**@brief   Function for advancing the simulated time, e.g. for time spent outside flash. */
+void flash_sim_time_advance(uint32_t us);
+
+
+/**@brief   Function for getting the counters. */
+void flash_sim_stats_get(flash_sim_stats_t * p_stats);
+
+
+/**@brief   Function for resetting the counters, including the page erase counters. */
+void flash_sim_stats_reset(void);
+
+
+/**@brief   Function for getting the number of times a page was erased.
+ *
+ * @param[in]   page_number The page number, as given to @ref sd_flash_page_erase.
+ *
+ * @return  The erase count, or zero if the page is not simulated.
+ */
+uint32_t flash_sim_page_erase_count(uint32_t page_number);
+
+
+#endif // FLASH_SIM_H__
+
+/** @} */
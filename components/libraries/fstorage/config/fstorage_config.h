@@ -53,6 +53,13 @@
     #define FS_MAX_WRITE_SIZE_WORDS     (1024)
 #endif
 
+/**@brief   Configures the size of the buffer used to merge adjacent writes, in words.
+ * @details When a write ends where the next queued write begins, both are copied to this buffer
+ *          and written to flash in a single operation, if they fit in the current radio gap.
+ *          Set to 0 to disable merging.
+ */
+#define FS_MERGE_BUFFER_WORDS       (32)
+
 /** @} */
 
 #endif // FS_CONFIG_H__
@@ -19,12 +19,18 @@
 #include <stdbool.h>
 #include "nrf_error.h"
 #include "nrf_soc.h"
+#include "flash_sched.h"
 
 
 static uint8_t       m_flags;       // fstorage status flags.
 static fs_op_queue_t m_queue;       // Queue of requested operations.
 static uint8_t       m_retry_count; // Number of times the last flash operation was retried.
 
+#if (FS_MERGE_BUFFER_WORDS > 0)
+static uint32_t      m_merge_buf[FS_MERGE_BUFFER_WORDS];    // Data of merged writes.
+#endif
+static uint16_t      m_merged_words;    // Words of the next queued write included in the current one.
+
 
 // Sends events to the application.
 static void send_event(fs_op_t const * const p_op, fs_ret_t result)
@@ -69,20 +75,80 @@ static bool check_config(fs_config_t const * const config)
 }
 
 
+// Attempts to merge the rest of a store operation with the next one in the queue.
+// Returns true if the merged data is ready to be written from m_merge_buf.
+static bool store_merge(fs_op_t const * const p_op, uint16_t remaining)
+{
+#if (FS_MERGE_BUFFER_WORDS > 0)
+    fs_op_t const * p_next;
+    uint16_t        total;
+
+    if (m_queue.count < 2)
+    {
+        return false;
+    }
+
+    p_next = &m_queue.op[(m_queue.rp + 1) % FS_QUEUE_SIZE];
+    total  = remaining + p_next->store.length_words;
+
+    if ((p_next->op_code != FS_OP_STORE) ||
+        (p_next->store.p_dest != p_op->store.p_dest + p_op->store.length_words) ||
+        (total > FS_MERGE_BUFFER_WORDS) ||
+        (flash_sched_write_words(total) < total))
+    {
+        return false;
+    }
+
+    memcpy(m_merge_buf,
+           p_op->store.p_src + p_op->store.offset,
+           remaining * sizeof(uint32_t));
+    memcpy(&m_merge_buf[remaining],
+           p_next->store.p_src,
+           p_next->store.length_words * sizeof(uint32_t));
+
+    m_merged_words = p_next->store.length_words;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+
 // Executes a store operation.
-static uint32_t store_execute(fs_op_t const * const p_op)
+static uint32_t store_execute(fs_op_t * const p_op)
 {
-    uint16_t chunk_len;
+    uint16_t const remaining = p_op->store.length_words - p_op->store.offset;
+    uint16_t       chunk_len;
+
+    m_merged_words = 0;
 
-    if ((p_op->store.length_words - p_op->store.offset) < FS_MAX_WRITE_SIZE_WORDS)
+    if (remaining < FS_MAX_WRITE_SIZE_WORDS)
     {
-        chunk_len = p_op->store.length_words - p_op->store.offset;
+        chunk_len = remaining;
     }
     else
     {
         chunk_len = FS_MAX_WRITE_SIZE_WORDS;
     }
 
+    // Only write as much as fits before the next radio event.
+    chunk_len = flash_sched_write_words(chunk_len);
+
+    if (chunk_len == 0)
+    {
+        return FS_OP_DEFERRED;
+    }
+
+    p_op->store.chunk_len = chunk_len;
+
+    if ((chunk_len == remaining) && store_merge(p_op, remaining))
+    {
+        return sd_flash_write((uint32_t*)p_op->store.p_dest + p_op->store.offset,
+                              m_merge_buf,
+                              remaining + m_merged_words);
+    }
+
     return sd_flash_write((uint32_t*)p_op->store.p_dest + p_op->store.offset,
                           (uint32_t*)p_op->store.p_src  + p_op->store.offset,
                           chunk_len);
@@ -92,6 +158,12 @@ static uint32_t store_execute(fs_op_t const * const p_op)
 // Executes an erase operation.
 static uint32_t erase_execute(fs_op_t const * const p_op)
 {
+    // Only erase if the erase can finish before the next radio event.
+    if (!flash_sched_erase_allowed())
+    {
+        return FS_OP_DEFERRED;
+    }
+
     return sd_flash_page_erase(p_op->erase.page);
 }
 
@@ -142,6 +214,11 @@ static void queue_process(void)
             m_flags &= ~FS_FLAG_PROCESSING;
             m_flags |= FS_FLAG_FLASH_REQ_PENDING;
         }
+        else if (ret == FS_OP_DEFERRED)
+        {
+            // Wait for the flash scheduler to resume processing.
+            m_flags |= FS_FLAG_RADIO_WAIT;
+        }
         else if (ret != NRF_SUCCESS)
         {
             // An error has occurred.
@@ -178,24 +255,25 @@ static void on_operation_success(fs_op_t * const p_op)
     {
         case FS_OP_STORE:
         {
-            uint16_t chunk_len;
-
-            if ((p_op->store.length_words - p_op->store.offset) < FS_MAX_WRITE_SIZE_WORDS)
-            {
-                chunk_len = p_op->store.length_words - p_op->store.offset;
-            }
-            else
-            {
-                chunk_len = FS_MAX_WRITE_SIZE_WORDS;
-            }
-
-            p_op->store.offset += chunk_len;
+            p_op->store.offset += p_op->store.chunk_len;
 
             if (p_op->store.offset == p_op->store.length_words)
             {
                 // The operation has finished.
                 send_event(p_op, FS_SUCCESS);
                 queue_advance();
+
+                if (m_merged_words != 0)
+                {
+                    // The next operation was written together with this one.
+                    fs_op_t * const p_next = &m_queue.op[m_queue.rp];
+
+                    m_merged_words        = 0;
+                    p_next->store.offset  = p_next->store.length_words;
+
+                    send_event(p_next, FS_SUCCESS);
+                    queue_advance();
+                }
             }
         }
         break;
@@ -259,6 +337,17 @@ static bool queue_get_next_free(fs_op_t ** p_op)
 }
 
 
+// Called by the flash scheduler when a gap in radio activity begins.
+static void radio_gap_handler(void)
+{
+    if (m_flags & FS_FLAG_RADIO_WAIT)
+    {
+        m_flags &= ~FS_FLAG_RADIO_WAIT;
+        queue_process();
+    }
+}
+
+
 fs_ret_t fs_init(void)
 {
     uint32_t const   users         = FS_SECTION_VARS_COUNT;
@@ -323,6 +412,8 @@ fs_ret_t fs_init(void)
         index_last = index_max;
     }
 
+    (void)flash_sched_register(radio_gap_handler);
+
     m_flags |= FS_FLAG_INITIALIZED;
 
     return FS_SUCCESS;
@@ -460,6 +551,12 @@ fs_ret_t fs_queued_op_count_get(uint32_t * const p_op_count)
 void fs_sys_event_handler(uint32_t sys_evt)
 {
     fs_op_t * const p_op = &m_queue.op[m_queue.rp];
+
+    if (m_flags & FS_FLAG_RADIO_WAIT)
+    {
+        // No operation of this module is executing. It is resumed by the flash scheduler.
+        return;
+    }
     
     if (m_flags & FS_FLAG_PROCESSING)
     {
@@ -20,6 +20,11 @@
 #define FS_FLAG_PROCESSING          (1 << 1)  // The module is processing flash operations.
 // The module is waiting for a flash operation initiated by another module to complete.
 #define FS_FLAG_FLASH_REQ_PENDING   (1 << 2)
+// The module is waiting for a gap in radio activity which is long enough for the next operation.
+#define FS_FLAG_RADIO_WAIT          (1 << 3)
+
+// Returned internally when the flash scheduler holds an operation back.
+#define FS_OP_DEFERRED              (0x1D1E)
 
 #define FS_ERASED_WORD              (0xFFFFFFFF)
 
@@ -73,6 +78,7 @@ typedef struct
             uint32_t const * p_dest;        // Destination of the data in flash.
             uint16_t         length_words;  // Length of the data to be written, in words.
             uint16_t         offset;        // Write offset.
+            uint16_t         chunk_len;     // Length of the write in progress, in words.
         } store;
         struct
         {
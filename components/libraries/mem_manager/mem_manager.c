@@ -11,6 +11,7 @@
  */
 #include "sdk_config.h"
 #include "sdk_common.h"
+#include "nrf.h"
 #include "mem_manager.h"
 #include "app_trace.h"
 #include "nrf_assert.h"
@@ -173,9 +174,6 @@
 #ifndef MEMORY_MANAGER_XXSMALL_BLOCK_COUNT
     #define MEMORY_MANAGER_XXSMALL_BLOCK_COUNT 0
     #define MEMORY_MANAGER_XXSMALL_BLOCK_SIZE  0
-    #define XXSMALL_BLOCK_START                0
-    #define XXSMALL_BLOCK_END                  0
-    #define XXSMALL_MEMORY_START               0
 #endif // MEMORY_MANAGER_XXSMALL_BLOCK_SIZE
 
 
@@ -183,9 +181,6 @@
 #ifndef MEMORY_MANAGER_XSMALL_BLOCK_COUNT
    #define MEMORY_MANAGER_XSMALL_BLOCK_COUNT   0
    #define MEMORY_MANAGER_XSMALL_BLOCK_SIZE    0
-   #define XSMALL_BLOCK_START                  0
-   #define XSMALL_BLOCK_END                    0
-   #define XSMALL_MEMORY_START                 0
 #endif // MEMORY_MANAGER_XSMALL_BLOCK_SIZE
 
 
@@ -193,9 +188,6 @@
 #ifndef MEMORY_MANAGER_SMALL_BLOCK_COUNT
    #define MEMORY_MANAGER_SMALL_BLOCK_COUNT    0
    #define MEMORY_MANAGER_SMALL_BLOCK_SIZE     0
-   #define SMALL_BLOCK_START                   0
-   #define SMALL_BLOCK_END                     0
-   #define SMALL_MEMORY_START                  0
 #endif // MEMORY_MANAGER_SMALL_BLOCK_COUNT
 
 
@@ -203,9 +195,6 @@
 #ifndef MEMORY_MANAGER_MEDIUM_BLOCK_COUNT
    #define MEMORY_MANAGER_MEDIUM_BLOCK_COUNT   0
    #define MEMORY_MANAGER_MEDIUM_BLOCK_SIZE    0
-   #define MEDIUM_BLOCK_START                  0
-   #define MEDIUM_BLOCK_END                    0
-   #define MEDIUM_MEMORY_START                 0
 #endif // MEMORY_MANAGER_MEDIUM_BLOCK_COUNT
 
 
@@ -213,9 +202,6 @@
 #ifndef MEMORY_MANAGER_LARGE_BLOCK_COUNT
    #define MEMORY_MANAGER_LARGE_BLOCK_COUNT    0
    #define MEMORY_MANAGER_LARGE_BLOCK_SIZE     0
-   #define LARGE_BLOCK_START                   0
-   #define LARGE_BLOCK_END                     0
-   #define LARGE_MEMORY_START                  0
 #endif // MEMORY_MANAGER_LARGE_BLOCK_COUNT
 
 
@@ -223,9 +209,6 @@
 #ifndef MEMORY_MANAGER_XLARGE_BLOCK_COUNT
    #define MEMORY_MANAGER_XLARGE_BLOCK_COUNT   0
    #define MEMORY_MANAGER_XLARGE_BLOCK_SIZE    0
-   #define XLARGE_BLOCK_START                  0
-   #define XLARGE_BLOCK_END                    0
-   #define XLARGE_MEMORY_START                 0
 #endif // MEMORY_MANAGER_XLARGE_BLOCK_COUNT
 
 
@@ -233,9 +216,6 @@
 #ifndef MEMORY_MANAGER_XXLARGE_BLOCK_COUNT
    #define MEMORY_MANAGER_XXLARGE_BLOCK_COUNT  0
    #define MEMORY_MANAGER_XXLARGE_BLOCK_SIZE   0
-   #define XXLARGE_BLOCK_START                 0
-   #define XXLARGE_BLOCK_END                   0
-   #define XXLARGE_MEMORY_START                0
 #endif // MEMORY_MANAGER_XXLARGE_BLOCK_COUNT
 
 
@@ -402,7 +382,7 @@
                            MEMORY_MANAGER_MEDIUM_BLOCK_COUNT  +                                     \
                            MEMORY_MANAGER_LARGE_BLOCK_COUNT   +                                     \
                            MEMORY_MANAGER_XLARGE_BLOCK_COUNT  +                                     \
-                           MEMORY_MANAGER_XLARGE_BLOCK_COUNT)
+                           MEMORY_MANAGER_XXLARGE_BLOCK_COUNT)
 
 
 /**@brief Total memory managed by the module. */
@@ -425,7 +405,31 @@
 #define BLOCK_CAT_XXL                  6                                                            /**< Extra Extra Large category identifier. */
 
 #define BITMAP_SIZE                    32                                                           /**< Bitmap size for each word used to contain block information. */
-#define BLOCK_BITMAP_ARRAY_SIZE        CEIL_DIV(TOTAL_BLOCK_COUNT, BITMAP_SIZE)                     /**< Determines number of blocks needed for book keeping availability status of all blocks. */
+#define BITMAP_WORDS(COUNT)            CEIL_DIV((COUNT), BITMAP_SIZE)                               /**< Number of bitmap words needed for a block category of COUNT blocks. */
+#define BLOCK_CAT_MAX_COUNT            (BITMAP_SIZE * BITMAP_SIZE)                                  /**< Largest block count of a category, one summary bit per bitmap word. */
+
+#ifndef MEM_MANAGER_ENABLE_FALLTHROUGH
+#define MEM_MANAGER_ENABLE_FALLTHROUGH 1                                                            /**< Serve a request from a larger category when its own is exhausted. */
+#endif // MEM_MANAGER_ENABLE_FALLTHROUGH
+
+/**@brief First bitmap word of each block category. Every category starts on a word boundary. */
+#define XXSMALL_BITMAP_START           0
+#define XSMALL_BITMAP_START            (XXSMALL_BITMAP_START + BITMAP_WORDS(MEMORY_MANAGER_XXSMALL_BLOCK_COUNT))
+#define SMALL_BITMAP_START             (XSMALL_BITMAP_START  + BITMAP_WORDS(MEMORY_MANAGER_XSMALL_BLOCK_COUNT))
+#define MEDIUM_BITMAP_START            (SMALL_BITMAP_START   + BITMAP_WORDS(MEMORY_MANAGER_SMALL_BLOCK_COUNT))
+#define LARGE_BITMAP_START             (MEDIUM_BITMAP_START  + BITMAP_WORDS(MEMORY_MANAGER_MEDIUM_BLOCK_COUNT))
+#define XLARGE_BITMAP_START            (LARGE_BITMAP_START   + BITMAP_WORDS(MEMORY_MANAGER_LARGE_BLOCK_COUNT))
+#define XXLARGE_BITMAP_START           (XLARGE_BITMAP_START  + BITMAP_WORDS(MEMORY_MANAGER_XLARGE_BLOCK_COUNT))
+#define BLOCK_BITMAP_ARRAY_SIZE        (XXLARGE_BITMAP_START + BITMAP_WORDS(MEMORY_MANAGER_XXLARGE_BLOCK_COUNT)) /**< Determines number of words needed for book keeping availability status of all blocks. */
+
+STATIC_ASSERT(MEMORY_MANAGER_XXSMALL_BLOCK_COUNT <= BLOCK_CAT_MAX_COUNT);
+STATIC_ASSERT(MEMORY_MANAGER_XSMALL_BLOCK_COUNT  <= BLOCK_CAT_MAX_COUNT);
+STATIC_ASSERT(MEMORY_MANAGER_SMALL_BLOCK_COUNT   <= BLOCK_CAT_MAX_COUNT);
+STATIC_ASSERT(MEMORY_MANAGER_MEDIUM_BLOCK_COUNT  <= BLOCK_CAT_MAX_COUNT);
+STATIC_ASSERT(MEMORY_MANAGER_LARGE_BLOCK_COUNT   <= BLOCK_CAT_MAX_COUNT);
+STATIC_ASSERT(MEMORY_MANAGER_XLARGE_BLOCK_COUNT  <= BLOCK_CAT_MAX_COUNT);
+STATIC_ASSERT(MEMORY_MANAGER_XXLARGE_BLOCK_COUNT <= BLOCK_CAT_MAX_COUNT);
+STATIC_ASSERT(NRF_MEM_BLOCK_CAT_COUNT == BLOCK_CAT_COUNT);
 
 
 /**@brief Lookup table for maximum memory size per block category. */
@@ -440,30 +444,6 @@ static const uint32_t m_block_size[BLOCK_CAT_COUNT] =
     MEMORY_MANAGER_XXLARGE_BLOCK_SIZE
 };
 
-/**@brief Lookup table for block start index for each block caetgory. */
-static const uint32_t m_block_start[BLOCK_CAT_COUNT] =
-{
-    XXSMALL_BLOCK_START,
-    XSMALL_BLOCK_START,
-    SMALL_BLOCK_START,
-    MEDIUM_BLOCK_START,
-    LARGE_BLOCK_START,
-    XLARGE_BLOCK_START,
-    XXLARGE_BLOCK_START
-};
-
-/**@brief Lookup table for last block index for each block category. */
-static const uint32_t m_block_end[BLOCK_CAT_COUNT] =
-{
-    XXSMALL_BLOCK_END,
-    XSMALL_BLOCK_END,
-    SMALL_BLOCK_END,
-    MEDIUM_BLOCK_END,
-    LARGE_BLOCK_END,
-    XLARGE_BLOCK_END,
-    XXLARGE_BLOCK_END
-};
-
 /**@brief Lookup table for memory start range for each block category. */
 static const uint32_t m_block_mem_start[BLOCK_CAT_COUNT] =
 {
@@ -476,8 +456,35 @@ static const uint32_t m_block_mem_start[BLOCK_CAT_COUNT] =
     XXLARGE_MEMORY_START
 };
 
+/**@brief Lookup table for count of block available in each block category. */
+static const uint32_t m_block_count[BLOCK_CAT_COUNT] =
+{
+    MEMORY_MANAGER_XXSMALL_BLOCK_COUNT,
+    MEMORY_MANAGER_XSMALL_BLOCK_COUNT,
+    MEMORY_MANAGER_SMALL_BLOCK_COUNT,
+    MEMORY_MANAGER_MEDIUM_BLOCK_COUNT,
+    MEMORY_MANAGER_LARGE_BLOCK_COUNT,
+    MEMORY_MANAGER_XLARGE_BLOCK_COUNT,
+    MEMORY_MANAGER_XXLARGE_BLOCK_COUNT
+};
+
+/**@brief Lookup table for the first bitmap word of each block category. */
+static const uint32_t m_block_bitmap_start[BLOCK_CAT_COUNT] =
+{
+    XXSMALL_BITMAP_START,
+    XSMALL_BITMAP_START,
+    SMALL_BITMAP_START,
+    MEDIUM_BITMAP_START,
+    LARGE_BITMAP_START,
+    XLARGE_BITMAP_START,
+    XXLARGE_BITMAP_START
+};
+
 static uint8_t  m_memory[TOTAL_MEMORY_SIZE];                                                        /**< Memory managed by the module. */
-static uint32_t m_mem_pool[BLOCK_BITMAP_ARRAY_SIZE];                                                /**< Bitmap used for book-keeping availability of all blocks managed by the module.  */
+static uint32_t m_mem_pool[BLOCK_BITMAP_ARRAY_SIZE];                                                /**< Free bitmap of each block category. Block n of a category is bit (31 - n % 32) of word n / 32, so that CLZ finds the lowest free block. */
+static uint32_t m_free_words[BLOCK_CAT_COUNT];                                                      /**< Summary of each category bitmap. Bit (31 - w) is set if word w has a free block. */
+static uint32_t m_free_cats;                                                                        /**< Summary of the categories. Bit (31 - c) is set if category c has a free block. */
+static nrf_mem_block_stats_t m_stats[BLOCK_CAT_COUNT];                                              /**< Usage statistics of each block category. */
 
 #ifdef MEM_MANAGER_ENABLE_DIAGNOSTICS
 
@@ -508,24 +515,6 @@ static uint32_t m_min_size[BLOCK_CAT_COUNT]  =
 /**@brief Table for book keeping largest size allocated in each block range. */
 static uint32_t m_max_size[BLOCK_CAT_COUNT];
 
-/**@brief Global pointing to minimum size holder for block type being allocated. */
-static uint32_t * p_min_size;
-
-/**@brief Global pointing to maximum size holder for block type being allocated. */
-static uint32_t * p_max_size;
-
-/**@brief Lookup table for count of block available in each block category. */
-static uint32_t m_block_count[BLOCK_CAT_COUNT] =
-{
-    MEMORY_MANAGER_XXSMALL_BLOCK_COUNT,
-    MEMORY_MANAGER_XSMALL_BLOCK_COUNT,
-    MEMORY_MANAGER_SMALL_BLOCK_COUNT,
-    MEMORY_MANAGER_MEDIUM_BLOCK_COUNT,
-    MEMORY_MANAGER_LARGE_BLOCK_COUNT,
-    MEMORY_MANAGER_XLARGE_BLOCK_COUNT,
-    MEMORY_MANAGER_XXLARGE_BLOCK_COUNT
-};
-
 #endif // MEM_MANAGER_ENABLE_DIAGNOSTICS
 
 SDK_MUTEX_DEFINE(m_mm_mutex)                                                                        /**< Mutex variable. Currently unused, this declaration does not occupy any space in RAM. */
@@ -534,50 +523,76 @@ static bool     m_module_initialized = false;
 #endif // MEM_MANAGER_DISABLE_API_PARAM_CHECK
 
 
-/**@brief Function to get X and Y coordinates.
+/**@brief Mask of the bit representing entry n of a summary or bitmap word, MSB first. */
+#define MSB_FIRST_BIT(n)    (0x80000000UL >> (n))
+
+
+/**@brief Function to set a block free.
  *
- * @details Function to get X and Y co-ordinates for the block identified by index.
- *          Here, X determines relevant word for the block. Y determines the actual bit in the word.
+ * @details Sets the bit of the block in the category bitmap, and the summary bits of its word
+ *          and category, which may have been clear.
  *
- * @param[in]  index Identifies the block.
- * @param[out] p_x   Points to the word that contains the bit representing the block.
- * @param[out] p_y   Contains the bitnumber in the the word 'X' relevant to the block.
+ * @param[in] block_cat Identifies the category of the block.
+ * @param[in] index     Identifies the block within the category.
  */
-static __INLINE void get_block_coordinates(uint32_t block_index, uint32_t * p_x, uint32_t * p_y)
+static void block_init(uint32_t block_cat, uint32_t index)
 {
-    // Determine position of the block in the bitmap.
     // X determines relevant word for the block. Y determines the actual bit in the word.
-    const uint32_t x = block_index/BITMAP_SIZE;
-    const uint32_t y = (block_index - x*BITMAP_SIZE);
+    const uint32_t x = index / BITMAP_SIZE;
+    const uint32_t y = index % BITMAP_SIZE;
 
-    (*p_x) = x;
-    (*p_y) = y;
+    m_mem_pool[m_block_bitmap_start[block_cat] + x] |= MSB_FIRST_BIT(y);
+    m_free_words[block_cat]                        |= MSB_FIRST_BIT(x);
+    m_free_cats                                    |= MSB_FIRST_BIT(block_cat);
 }
 
 
-/**@brief Initializes the block by setting it to be free. */
-static void block_init (uint32_t block_index)
+/**@brief Function to check whether a block is free. */
+static bool is_block_free(uint32_t block_cat, uint32_t index)
 {
-    uint32_t x;
-    uint32_t y;
+    const uint32_t x = index / BITMAP_SIZE;
+    const uint32_t y = index % BITMAP_SIZE;
 
-    // Determine position of the block in the bitmap.
-    // X determines relevant word for the block. Y determines the actual bit in the word.
-    get_block_coordinates(block_index, &x, &y);
+    return ((m_mem_pool[m_block_bitmap_start[block_cat] + x] & MSB_FIRST_BIT(y)) != 0);
+}
+
+
+/**@brief Function to allocate the lowest free block of a category.
+ *
+ * @details Two count leading zeros find the first bitmap word with a free block and the first
+ *          free block in it, so the cost does not depend on the number of blocks. The category
+ *          must have a free block.
+ *
+ * @return Index of the block within the category.
+ */
+static uint32_t block_allocate(uint32_t block_cat)
+{
+    const uint32_t x        = __CLZ(m_free_words[block_cat]);
+    uint32_t     * p_word   = &m_mem_pool[m_block_bitmap_start[block_cat] + x];
+    const uint32_t y        = __CLZ(*p_word);
+
+    (*p_word) &= ~MSB_FIRST_BIT(y);
+
+    if ((*p_word) == 0)
+    {
+        m_free_words[block_cat] &= ~MSB_FIRST_BIT(x);
+
+        if (m_free_words[block_cat] == 0)
+        {
+            m_free_cats &= ~MSB_FIRST_BIT(block_cat);
+        }
+    }
 
-    // Set bit related to the block to indicate that the block is free.
-    SET_BIT(m_mem_pool[x], y);
+    return (x * BITMAP_SIZE + y);
 }
 
 
-/**@brief Function to get the category of the block of size 'size' or block number 'block_index'.*/
-static __INLINE uint32_t get_block_cat(uint32_t size, uint32_t block_index)
+/**@brief Function to get the smallest category of blocks of size 'size' or more. */
+static __INLINE uint32_t get_block_cat(uint32_t size)
 {
     for (uint32_t block_cat = 0; block_cat < BLOCK_CAT_COUNT; block_cat++)
     {
-        if (((size != 0) && (size <= m_block_size[block_cat]) &&
-            (m_block_end[block_cat] != m_block_start[block_cat])) ||
-            (block_index < m_block_end[block_cat]))
+        if ((size <= m_block_size[block_cat]) && (m_block_count[block_cat] != 0))
         {
             return block_cat;
         }
@@ -587,45 +602,47 @@ static __INLINE uint32_t get_block_cat(uint32_t size, uint32_t block_index)
 }
 
 
-/**@brief Function to get the size of the block number 'block_index'. */
-static __INLINE uint32_t get_block_size(uint32_t block_index)
+/**@brief Function to find the block holding the memory at 'p_mem'.
+ *
+ * @param[in]  p_mem       Start of the block.
+ * @param[out] p_block_cat Category of the block.
+ * @param[out] p_index     Index of the block within the category.
+ *
+ * @retval true  If p_mem is the start of a block managed by the module.
+ * @retval false Otherwise.
+ */
+static bool get_block_location(void const * p_mem, uint32_t * p_block_cat, uint32_t * p_index)
 {
-    const uint32_t block_cat = get_block_cat(0, block_index);
-
-    #ifdef MEM_MANAGER_ENABLE_DIAGNOSTICS
-        p_min_size = &m_min_size[block_cat];
-        p_max_size = &m_max_size[block_cat];
-    #endif // MEM_MANAGER_ENABLE_DIAGNOSTICS
-
-    return m_block_size[block_cat];
-}
+    const uint8_t * p_byte = (const uint8_t *)p_mem;
 
+    if ((p_byte < &m_memory[0]) || (p_byte >= &m_memory[TOTAL_MEMORY_SIZE]))
+    {
+        return false;
+    }
 
-/**@brief Function to free the block identified by block number 'block_index'. */
-static bool is_block_free(uint32_t block_index)
-{
-    uint32_t x;
-    uint32_t y;
+    const uint32_t offset = (uint32_t)(p_byte - &m_memory[0]);
 
-    // Determine position of the block in the bitmap.
-    // X determines relevant word for the block. Y determines the actual bit in the word.
-    get_block_coordinates(block_index, &x, &y);
+    for (uint32_t block_cat = 0; block_cat < BLOCK_CAT_COUNT; block_cat++)
+    {
+        const uint32_t cat_size = m_block_count[block_cat] * m_block_size[block_cat];
 
-    return IS_SET(m_mem_pool[x], y);
-}
+        if (offset < m_block_mem_start[block_cat] + cat_size)
+        {
+            const uint32_t cat_offset = offset - m_block_mem_start[block_cat];
 
+            if ((cat_offset % m_block_size[block_cat]) != 0)
+            {
+                return false;
+            }
 
-/**@brief Function to allocate the block identified by block number 'block_index'. */
-static void block_allocate(uint32_t block_index)
-{
-    uint32_t x;
-    uint32_t y;
+            (*p_block_cat) = block_cat;
+            (*p_index)     = cat_offset / m_block_size[block_cat];
 
-    // Determine position of the block in the bitmap.
-    // X determines relevant word for the block. Y determines the actual bit in the word.
-    get_block_coordinates(block_index, &x, &y);
+            return true;
+        }
+    }
 
-    CLR_BIT(m_mem_pool[x], y);
+    return false;
 }
 
 
@@ -637,11 +654,20 @@ uint32_t nrf_mem_init(void)
 
     MM_MUTEX_LOCK();
 
-    uint32_t block_index = 0;
+    memset(m_mem_pool, 0, sizeof(m_mem_pool));
+    memset(m_free_words, 0, sizeof(m_free_words));
+    memset(m_stats, 0, sizeof(m_stats));
+    m_free_cats = 0;
 
-    for(block_index = 0; block_index < TOTAL_BLOCK_COUNT; block_index++)
+    for (uint32_t block_cat = 0; block_cat < BLOCK_CAT_COUNT; block_cat++)
     {
-        block_init(block_index);
+        m_stats[block_cat].block_size  = m_block_size[block_cat];
+        m_stats[block_cat].block_count = m_block_count[block_cat];
+
+        for (uint32_t index = 0; index < m_block_count[block_cat]; index++)
+        {
+            block_init(block_cat, index);
+        }
     }
 
 #if (MEM_MANAGER_DISABLE_API_PARAM_CHECK == 0)
@@ -674,43 +700,45 @@ uint32_t nrf_mem_reserve(uint8_t ** pp_buffer, uint32_t * p_size)
 
     MM_MUTEX_LOCK();
 
-    const uint32_t block_cat    = get_block_cat(requested_size, TOTAL_BLOCK_COUNT);
-    uint32_t       block_index  = m_block_start[block_cat];
-    uint32_t       memory_index = m_block_mem_start[block_cat];
-    uint32_t       err_code     = (NRF_ERROR_NO_MEM | MEMORY_MANAGER_ERR_BASE);
+    const uint32_t requested_cat = get_block_cat(requested_size);
+    uint32_t       candidates    = m_free_cats & (0xFFFFFFFFUL >> requested_cat);
+    uint32_t       err_code      = (NRF_ERROR_NO_MEM | MEMORY_MANAGER_ERR_BASE);
 
-    MM_LOG("[MM]: Start index for the pool = 0x%08lX, total block count 0x%08X\r\n",
-           block_index,
-           TOTAL_BLOCK_COUNT);
+#if (MEM_MANAGER_ENABLE_FALLTHROUGH == 0)
+    candidates &= MSB_FIRST_BIT(requested_cat);
+#endif // MEM_MANAGER_ENABLE_FALLTHROUGH
 
-    for (; block_index < TOTAL_BLOCK_COUNT; block_index++)
+    if (candidates != 0)
     {
-        uint32_t block_size = get_block_size(block_index);
+        // Smallest category at or above the requested one that has a free block.
+        const uint32_t block_cat = __CLZ(candidates);
+        const uint32_t index     = block_allocate(block_cat);
 
-        if (is_block_free(block_index) == true)
-        {
-            MM_LOG("[MM]: Reserving block 0x%08lX\r\n", block_index);
-
-            // Search succeeded, found free block.
-            err_code     = NRF_SUCCESS;
+        MM_LOG("[MM]: Reserving block 0x%08lX of category %d\r\n", index, block_cat);
 
-            // Allocate block.
-            block_allocate(block_index);
+        // Search succeeded, found free block.
+        err_code = NRF_SUCCESS;
 
-            (*pp_buffer) = &m_memory[memory_index];
-            (*p_size)    = block_size;
+        (*pp_buffer) = &m_memory[m_block_mem_start[block_cat] + index * m_block_size[block_cat]];
+        (*p_size)    = m_block_size[block_cat];
 
-            #ifdef MEM_MANAGER_ENABLE_DIAGNOSTICS
-                (*p_min_size) = MIN((*p_min_size), requested_size);
-                (*p_max_size) = MAX((*p_max_size), requested_size);
-            #endif // MEM_MANAGER_ENABLE_DIAGNOSTICS
+        m_stats[block_cat].in_use++;
+        m_stats[block_cat].peak = MAX(m_stats[block_cat].peak, m_stats[block_cat].in_use);
 
-            break;
+        if (block_cat != requested_cat)
+        {
+            m_stats[requested_cat].fallthroughs++;
         }
-        memory_index += block_size;
+
+        #ifdef MEM_MANAGER_ENABLE_DIAGNOSTICS
+            m_min_size[block_cat] = MIN(m_min_size[block_cat], requested_size);
+            m_max_size[block_cat] = MAX(m_max_size[block_cat], requested_size);
+        #endif // MEM_MANAGER_ENABLE_DIAGNOSTICS
     }
-    if (err_code != NRF_SUCCESS)
+    else
     {
+        m_stats[requested_cat].failures++;
+
         MM_LOG ("[MM]: Memory reservation result %d, memory %p, size %d!",
                 err_code,
                 (*pp_buffer),
@@ -777,19 +805,14 @@ void nrf_free(void * p_mem)
 
     MM_MUTEX_LOCK();
 
+    uint32_t block_cat;
     uint32_t index;
-    uint32_t memory_index = 0;
 
-    for (index = 0; index < TOTAL_BLOCK_COUNT; index++)
+    if (get_block_location(p_mem, &block_cat, &index) && !is_block_free(block_cat, index))
     {
-        if (&m_memory[memory_index] == p_mem)
-        {
-            // Found a free block of memory, assign.
-            MM_LOG("[MM]: << Freeing block %d.\r\n", index);
-            block_init(index);
-            break;
-        }
-        memory_index += get_block_size(index);
+        MM_LOG("[MM]: << Freeing block %d of category %d.\r\n", index, block_cat);
+        block_init(block_cat, index);
+        m_stats[block_cat].in_use--;
     }
 
     MM_MUTEX_UNLOCK();
@@ -805,6 +828,38 @@ void * nrf_realloc(void * p_mem, uint32_t size)
 }
 
 
+uint32_t nrf_mem_stats_get(uint32_t block_cat, nrf_mem_block_stats_t * p_stats)
+{
+    NULL_PARAM_CHECK(p_stats);
+
+    if (block_cat >= BLOCK_CAT_COUNT)
+    {
+        return (NRF_ERROR_INVALID_PARAM | MEMORY_MANAGER_ERR_BASE);
+    }
+
+    MM_MUTEX_LOCK();
+    (*p_stats) = m_stats[block_cat];
+    MM_MUTEX_UNLOCK();
+
+    return NRF_SUCCESS;
+}
+
+
+void nrf_mem_stats_reset(void)
+{
+    MM_MUTEX_LOCK();
+
+    for (uint32_t block_cat = 0; block_cat < BLOCK_CAT_COUNT; block_cat++)
+    {
+        m_stats[block_cat].peak         = m_stats[block_cat].in_use;
+        m_stats[block_cat].failures     = 0;
+        m_stats[block_cat].fallthroughs = 0;
+    }
+
+    MM_MUTEX_UNLOCK();
+}
+
+
 #ifdef MEM_MANAGER_ENABLE_DIAGNOSTICS
 
 /**@brief Function to format and print information with respect to each block.
@@ -823,10 +878,8 @@ void print_block_info(uint32_t block_cat, uint32_t * p_mem_in_use)
     #define ASCII_VALUE_FOR_SPACE   32
 
     char           print_buffer[PRINT_BUFFER_SIZE];
-    const uint32_t total_count   = (m_block_start[block_cat] + m_block_count[block_cat]);
-    uint32_t       in_use        = 0;
-    uint32_t       num_of_blocks = 0;
-    uint32_t       index         = m_block_start[block_cat];
+    const uint32_t num_of_blocks = m_stats[block_cat].in_use;
+    const uint32_t in_use        = num_of_blocks * m_block_size[block_cat];
     uint32_t       column_number;
 
     // No statistic provided in case block category is not included.
@@ -834,15 +887,6 @@ void print_block_info(uint32_t block_cat, uint32_t * p_mem_in_use)
     {
         memset(print_buffer, ASCII_VALUE_FOR_SPACE, PRINT_BUFFER_SIZE);
 
-        for (; index < total_count; index++)
-        {
-            if (is_block_free(index) == false)
-            {
-                num_of_blocks++;
-                in_use += m_block_size[block_cat];
-            }
-        }
-
         column_number = 0;
         snprintf(&print_buffer[column_number * PRINT_COLUMN_WIDTH],
                  PRINT_COLUMN_WIDTH,
@@ -29,6 +29,11 @@
  * To use fewer than seven buffer pools, do not define the count for the unwanted block
  * or explicitly set it to zero. At least one block category must be configured
  * for this module to function as expected.
+ *
+ * @note The firmware does not use this module: nothing reserves memory through it, it is not in
+ *       the Keil project, and nrf_mem_init() is not called. This SDK has no @c sdk_config.h, so
+ *       a project that adds it also provides one with the block settings. test/host/sdk_config.h
+ *       is the one the host test uses.
  */
 
 #ifndef MEM_MANAGER_H__
@@ -37,6 +42,21 @@
 #include "sdk_common.h"
 
 
+#define NRF_MEM_BLOCK_CAT_COUNT     7   /**< Number of block categories, from xxsmall to xxlarge. */
+
+
+/**@brief Usage statistics of one block category. */
+typedef struct
+{
+    uint32_t block_size;    /**< Size of each block in the category. */
+    uint32_t block_count;   /**< Number of blocks in the category. Zero if the category is not used. */
+    uint32_t in_use;        /**< Number of blocks currently reserved. */
+    uint32_t peak;          /**< Largest number of blocks reserved at the same time. */
+    uint32_t failures;      /**< Requests sized for this category which could not be served. */
+    uint32_t fallthroughs;  /**< Requests sized for this category served from a larger one. */
+} nrf_mem_block_stats_t;
+
+
 /**@brief Initializes Memory Manager.
  *
  * @details API to initialize the Memory Manager. Always call this API before using any of the other
@@ -120,6 +140,30 @@ void nrf_free(void * p_buffer);
  */
 void * nrf_realloc(void *p_buffer, uint32_t size);
 
+
+/**@brief Function for reading the usage statistics of a block category.
+ *
+ * @details Requests are counted against the smallest category their size fits in, so a high
+ *          fallthrough or failure count shows which category is undersized.
+ *
+ * @param[in]  block_cat  Block category, from 0 (xxsmall) to @ref NRF_MEM_BLOCK_CAT_COUNT - 1
+ *                        (xxlarge).
+ * @param[out] p_stats    Statistics of the category.
+ *
+ * @retval NRF_SUCCESS             If the statistics were read.
+ * @retval NRF_ERROR_NULL          If p_stats is NULL.
+ * @retval NRF_ERROR_INVALID_PARAM If block_cat is out of range.
+ */
+uint32_t nrf_mem_stats_get(uint32_t block_cat, nrf_mem_block_stats_t * p_stats);
+
+
+/**@brief Function for restarting the usage statistics.
+ *
+ * @details Clears the failure and fallthrough counts, and sets the peak of each category to the
+ *          number of blocks currently in use.
+ */
+void nrf_mem_stats_reset(void);
+
 #ifdef MEM_MANAGER_ENABLE_DIAGNOSTICS
 
 /**@brief Function to print statstics related to memory blocks managed by memory manager.
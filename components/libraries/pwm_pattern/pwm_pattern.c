@@ -0,0 +1,162 @@
+/* Copyright (c) 2016 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is property of Nordic Semiconductor ASA.
+ * Terms and conditions of usage are described in detail in NORDIC
+ * SEMICONDUCTOR STANDARD SOFTWARE LICENSE AGREEMENT.
+ *
+ * Licensees are granted free, non-transferable use of the information. NO
+ * WARRANTY of ANY KIND is provided. This heading must NOT be removed from
+ * the file.
+ *
+ */
+
+#include "pwm_pattern.h"
+#include <stddef.h>
+#include "nrf_error.h"
+
+#define PWM_PATTERN_FALLING_EDGE    0x8000  /**< Polarity bit: the output starts high and falls at the compare value. */
+
+
+/**@brief Function for getting the greatest common divisor, gcd(0, b) being b. */
+static uint16_t pattern_gcd(uint16_t a, uint16_t b)
+{
+    uint16_t t;
+
+    while (a != 0)
+    {
+        t = b % a;
+        b = a;
+        a = t;
+    }
+    return b;
+}
+
+
+/**@brief Function for getting the longest time a step can hold each of its values. */
+static uint16_t step_tick(pwm_pattern_step_t const * p_step)
+{
+    if (p_step->from == p_step->to)
+    {
+        return p_step->ms;
+    }
+    return pattern_gcd(p_step->ms, PWM_PATTERN_RAMP_TICK_MS);
+}
+
+
+/**@brief Function for encoding a duty cycle, in permille, as a value of the sequence.
+ *
+ * @details With the falling edge polarity the output is high for the compare value, with the
+ *          rising edge polarity it is low for it.
+ */
+static uint16_t duty_value(uint16_t duty, bool active_low)
+{
+    return active_low ? duty : (duty | PWM_PATTERN_FALLING_EDGE);
+}
+
+
+/**@brief Function for rendering steps first to last into a new segment holding each value for tick ms.
+ *
+ * @details A ramp takes the duty cycle at the middle of each tick, so that a ramp and the same ramp
+ *          reversed give the same values in reverse.
+ */
+static uint32_t segment_add(pwm_pattern_step_t const * p_steps,
+                            uint8_t                    first,
+                            uint8_t                    last,
+                            uint16_t                   tick,
+                            bool                       active_low,
+                            pwm_pattern_compiled_t   * p_compiled)
+{
+    pwm_pattern_segment_t * p_segment;
+    uint32_t                length = 0;
+    uint16_t                count;
+    uint16_t                k;
+    int32_t                 span;
+    uint8_t                 i;
+
+    for (i = first; i <= last; i++)
+    {
+        length += p_steps[i].ms / tick;
+    }
+    if ((p_compiled->segment_count == PWM_PATTERN_SEGMENTS_MAX) ||
+        (p_compiled->value_count + length > PWM_PATTERN_VALUES_MAX))
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    p_segment          = &p_compiled->segments[p_compiled->segment_count++];
+    p_segment->first   = p_compiled->value_count;
+    p_segment->length  = (uint16_t)length;
+    p_segment->refresh = ((uint32_t)tick * 1000) / PWM_PATTERN_PERIOD_US - 1;
+
+    for (i = first; i <= last; i++)
+    {
+        count = p_steps[i].ms / tick;
+        span  = (int32_t)p_steps[i].to - p_steps[i].from;
+        for (k = 0; k < count; k++)
+        {
+            p_compiled->values[p_compiled->value_count++] =
+                duty_value((uint16_t)(p_steps[i].from + (span * (2 * k + 1)) / (2 * count)), active_low);
+        }
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t pwm_pattern_compile(pwm_pattern_t const * p_pattern, bool active_low, pwm_pattern_compiled_t * p_compiled)
+{
+    pwm_pattern_step_t const * p_steps = p_pattern->p_steps;
+    uint32_t                   err_code;
+    uint32_t                   segment_ms = 0;
+    uint16_t                   tick       = 0;
+    uint16_t                   merged;
+    uint8_t                    first      = 0;
+    uint8_t                    i;
+
+    if ((p_steps == NULL) || (p_pattern->step_count == 0))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    for (i = 0; i < p_pattern->step_count; i++)
+    {
+        if ((p_steps[i].ms == 0) || (p_steps[i].ms % PWM_PATTERN_TICK_MIN_MS != 0) ||
+            (p_steps[i].from > PWM_PATTERN_TOP) || (p_steps[i].to > PWM_PATTERN_TOP))
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+    }
+
+    p_compiled->value_count   = 0;
+    p_compiled->segment_count = 0;
+    p_compiled->repeats       = p_pattern->repeats;
+    p_compiled->duration_ms   = 0;
+
+    for (i = 0; i < p_pattern->step_count; i++)
+    {
+        p_compiled->duration_ms += p_steps[i].ms;
+
+        // Sharing a segment saves a SEQEND wakeup per play, as long as the finer tick does not
+        // multiply the values.
+        merged = pattern_gcd(tick, step_tick(&p_steps[i]));
+        if ((tick != 0) && ((segment_ms + p_steps[i].ms) / merged > PWM_PATTERN_SEGMENT_VALUES_MAX))
+        {
+            err_code = segment_add(p_steps, first, i - 1, tick, active_low, p_compiled);
+            if (err_code != NRF_SUCCESS)
+            {
+                return err_code;
+            }
+            first      = i;
+            segment_ms = 0;
+            merged     = step_tick(&p_steps[i]);
+        }
+        tick        = merged;
+        segment_ms += p_steps[i].ms;
+    }
+
+    return segment_add(p_steps, first, p_pattern->step_count - 1, tick, active_low, p_compiled);
+}
+
+
+uint16_t pwm_pattern_off_value(bool active_low)
+{
+    return duty_value(0, active_low);
+}
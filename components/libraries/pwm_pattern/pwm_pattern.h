@@ -0,0 +1,112 @@
+/* Copyright (c) 2016 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is property of Nordic Semiconductor ASA.
+ * Terms and conditions of usage are described in detail in NORDIC
+ * SEMICONDUCTOR STANDARD SOFTWARE LICENSE AGREEMENT.
+ *
+ * Licensees are granted free, non-transferable use of the information. NO
+ * WARRANTY of ANY KIND is provided. This heading must NOT be removed from
+ * the file.
+ *
+ */
+
+/** @file
+ *
+ * @defgroup pwm_pattern PWM pattern compiler
+ * @{
+ * @ingroup app_common
+ * @brief Compiles vibration and LED effects into PWM peripheral sequences.
+ *
+ * @details A pattern is a list of steps, each a constant duty cycle or a linear ramp, played a
+ *          number of times. The compiler turns it into duty cycle values and segments: a segment
+ *          is one SEQ[n] of the PWM peripheral, all its values held for the same number of PWM
+ *          periods (SEQ[n].REFRESH). Consecutive steps share a segment, on the greatest common
+ *          divisor of their durations, as long as the segment stays within
+ *          @ref PWM_PATTERN_SEGMENT_VALUES_MAX values. Ramps are held at most
+ *          @ref PWM_PATTERN_RAMP_TICK_MS per value.
+ *
+ *          A pattern of one or two segments loops in the peripheral without the CPU. Longer
+ *          patterns are chained from the SEQEND events, one per segment played.
+ *
+ *          The PWM runs at 1 kHz with a 1 MHz base clock and a top of
+ *          @ref PWM_PATTERN_TOP, so a duty cycle in permille is a compare value and a
+ *          millisecond is a PWM period. The compiler has no hardware dependency.
+ */
+
+#ifndef PWM_PATTERN_H__
+#define PWM_PATTERN_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PWM_PATTERN_TOP                 1000    /**< Counter top value, the full duty cycle in permille. */
+#define PWM_PATTERN_PERIOD_US           1000    /**< PWM period at the 1 MHz base clock. */
+#define PWM_PATTERN_TICK_MIN_MS         10      /**< Step durations are multiples of this. */
+#define PWM_PATTERN_RAMP_TICK_MS        20      /**< Longest time a ramp holds one duty cycle. */
+#define PWM_PATTERN_VALUES_MAX          128     /**< Duty cycle values of a compiled pattern. */
+#define PWM_PATTERN_SEGMENT_VALUES_MAX  64      /**< Values beyond which steps start a new segment. */
+#define PWM_PATTERN_SEGMENTS_MAX        8       /**< Segments of a compiled pattern. */
+#define PWM_PATTERN_FOREVER             0       /**< Repeat count of a pattern played until stopped. */
+
+/**@brief Step held at one duty cycle, in permille, for @p ms milliseconds. */
+#define PWM_PATTERN_HOLD(duty, ms)      {(duty), (duty), (ms)}
+
+/**@brief Step ramping linearly from one duty cycle to another over @p ms milliseconds. */
+#define PWM_PATTERN_RAMP(from, to, ms)  {(from), (to), (ms)}
+
+/**@brief Step of a pattern. */
+typedef struct
+{
+    uint16_t from;      /**< Duty cycle at the start, in permille. */
+    uint16_t to;        /**< Duty cycle at the end, in permille. Equal to @p from for a hold. */
+    uint16_t ms;        /**< Duration, a multiple of @ref PWM_PATTERN_TICK_MIN_MS. */
+} pwm_pattern_step_t;
+
+/**@brief Pattern, kept in flash. */
+typedef struct
+{
+    pwm_pattern_step_t const * p_steps;
+    uint8_t                    step_count;
+    uint16_t                   repeats;     /**< Plays of the whole pattern, or @ref PWM_PATTERN_FOREVER. */
+} pwm_pattern_t;
+
+/**@brief Segment of a compiled pattern, one SEQ[n] of the PWM peripheral. */
+typedef struct
+{
+    uint16_t first;     /**< Index of the first value in @ref pwm_pattern_compiled_t::values. */
+    uint16_t length;    /**< Number of values. */
+    uint32_t refresh;   /**< PWM periods each value is held after the first, SEQ[n].REFRESH. */
+} pwm_pattern_segment_t;
+
+/**@brief Compiled pattern. Must be in RAM while it plays, the peripheral reads it by EasyDMA. */
+typedef struct
+{
+    uint16_t              values[PWM_PATTERN_VALUES_MAX];       /**< Duty cycle values, polarity bit included. */
+    pwm_pattern_segment_t segments[PWM_PATTERN_SEGMENTS_MAX];
+    uint16_t              value_count;
+    uint8_t               segment_count;
+    uint16_t              repeats;                              /**< Plays of the whole pattern, or @ref PWM_PATTERN_FOREVER. */
+    uint32_t              duration_ms;                          /**< Length of one play. */
+} pwm_pattern_compiled_t;
+
+
+/**@brief Function for compiling a pattern.
+ *
+ * @param[in]  p_pattern   Pattern.
+ * @param[in]  active_low  The output is on when the pin is low, as for an LED to VDD.
+ * @param[out] p_compiled  Compiled pattern.
+ *
+ * @retval NRF_SUCCESS              If the pattern was compiled.
+ * @retval NRF_ERROR_INVALID_PARAM  If the pattern has no steps, a duty cycle above
+ *                                  @ref PWM_PATTERN_TOP, or a duration that is 0 or not a
+ *                                  multiple of @ref PWM_PATTERN_TICK_MIN_MS.
+ * @retval NRF_ERROR_NO_MEM         If the values or the segments do not fit.
+ */
+uint32_t pwm_pattern_compile(pwm_pattern_t const * p_pattern, bool active_low, pwm_pattern_compiled_t * p_compiled);
+
+/**@brief Function for getting the duty cycle value a compiled pattern uses for off. */
+uint16_t pwm_pattern_off_value(bool active_low);
+
+#endif // PWM_PATTERN_H__
+
+/** @} */
@@ -5,13 +5,16 @@
 #include "channel_select.h"
 #include "transfer_usrdesign.h"
 #include "time.h"
+#include "usr_session.h"
+#include "usr_login.h"
+#include "alarm.h"
 
 extern void sys_start_pair_mode(void);
 
 void app_trans_connection(void)
 {
 	QPRINTF("app_trans_connection\r\n");
-	memset(&g_communication_statue,0,sizeof(communication_statue_st));
+	memset(g_communication_statue,0,sizeof(communication_statue_st));
 }
 
 void app_trans_disconnection(void)
@@ -34,8 +37,11 @@ void app_trans_indicate_statue_set(ble_trans_evt_type_t statue)
 	{
 		case BLE_TRANS_EVT_INDICATION_ENABLED:
 			QPRINTF("BLE_TRANS_EVT_INDICATION_ENABLED\r\n");
-			g_trans_evt_hander.bit.lifesense_login_bit_0 = 1;
+			g_trans_evt_hander->bit.lifesense_login_bit_0 = 1;
 			usr_set_app_type(LIFESENSE_APP);
+			//ֻiOS, ȵ¼ظͿʼ
+			if(usr_session_begin(LIFESENSE_APP) && g_communication_statue->phone_type == IOS_TYPE)
+				sys_start_pair_mode();
 			break;
 			
 		case BLE_TRANS_EVT_INDICATION_DISABLED:
@@ -83,23 +89,29 @@ void app_trans_receive(uint8_t *data,uint8_t length)
 {
 	uint8_t cmd = 0,*pData,data_len;
 	uint32_t time = 0;
+	bool resumed,cached;
+	uint8_t resume_cap;
 	if(*data == CMD_VERSION_0 && *(data+1) == CMD_VERSION_1)
 	{
 		cmd = *(data+2);
 		data_len = length - 7;
 		pData = data+2;
 			
-		if(g_communication_statue.transfer_statue == LOGIN_STATUE)//״ӳɹҪ¼״̬յ¼Ϣж
+		if(g_communication_statue->transfer_statue == LOGIN_STATUE)//״ӳɹҪ¼״̬յ¼Ϣж
 		{
-			if(data_len == 6)
+			if(data_len == 6 || data_len == 7)		//7ֽAPP, ɵAPPû
 			{
+				usr_session_reply();
+				resumed = usr_session_resuming();
+				cached = usr_session_cached();
+				resume_cap = (data_len == 7) ? (*(pData+7) & USR_SESSION_CAP_RESUME) : 0;
 				if(cmd == 0x01)
 				{
 					QPRINTF("log in success\r\n");
 					QPRINTF("UTC:%02x,%02x,%02x,%02x\r\n",*(pData+1),*(pData+2),*(pData+3),*(pData+4));
 					QPRINTF("time:%02x\r\n",*(pData+5));
 					QPRINTF("phone type:%02x\r\n",*(pData+6));
-					g_communication_statue.transfer_statue = DATA_STATUE;
+					g_communication_statue->transfer_statue = DATA_STATUE;
 
 					system_timezone_set(*(pData+5));
 					time |= (uint32_t)(*(pData+1)<<24);
@@ -107,19 +119,26 @@ void app_trans_receive(uint8_t *data,uint8_t length)
 					time |= (uint32_t)(*(pData+3)<<8);
 					time |= (uint32_t)(*(pData+4));
 					system_sec_set(time);
+					alarm_time_changed();
 					
-					if(*(pData+6) == 1)//phone == ios
+					if(*(pData+6) == 1 && !(cached && g_communication_statue->phone_type == IOS_TYPE))//phone == ios
 						sys_start_pair_mode();
+					g_communication_statue->phone_type = (*(pData+6) == 1) ? IOS_TYPE : ANDROID_TYPE;
 
-					g_trans_evt_hander.bit.wechat_send_data_bit_3 = 1; 
+					usr_session_save(LIFESENSE_APP,g_communication_statue->phone_type,*(pData+5),usr_login_token(pData+1),resume_cap);
+					usr_session_ready();
+
+					g_trans_evt_hander->bit.wechat_send_data_bit_3 = 1; 
 				}
 				else
 				{
 					QPRINTF("log in false\r\n");
+					if(resumed)
+						usr_session_fallback();
 				}
 			}
 		}
-		else if(g_communication_statue.transfer_statue == DATA_STATUE)//¼ɹûݴ״̬
+		else if(g_communication_statue->transfer_statue == DATA_STATUE)//¼ɹûݴ״̬
 		{	
 			data_process(pData,data_len);
 		}
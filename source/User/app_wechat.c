@@ -15,18 +15,24 @@
 #include "usr_data.h"
 #include "channel_select.h"
 #include "wechat_usrdesign.h"
+#include "aes_session.h"
+#include "usr_session.h"
+#include "time.h"
 
 extern void sys_start_pair_mode(void);
 
 void app_wechat_connection(void)
 {
 	QPRINTF("app_wechat_connection\r\n");
-	memset(&g_communication_statue,0,sizeof(communication_statue_st));
+	memset(g_communication_statue,0,sizeof(communication_statue_st));
 }
 
 void app_wechat_disconnection(void)
 {
 	QPRINTF("app_wechat_disconnection\r\n");
+	//the session key belongs to the one WeChat link, keep it when another link drops
+	if(g_communication_statue->app_type & WECHAT_APP)
+		wechat_session_key_clear();
 }
 
 /*****************************************************************************
@@ -44,9 +50,16 @@ void app_wechat_indicate_statue_set(ble_wechat_evt_type_t statue)
 	{
 		case BLE_WECHAT_EVT_INDICATION_ENABLED:
 			QPRINTF("BLE_WECHAT_EVT_INDICATION_ENABLED\r\n");
-			g_trans_evt_hander.bit.wechat_login_bit_1 = 1;
+			g_trans_evt_hander->bit.wechat_login_bit_1 = 1;
 			usTxWeChatPackSeq = 1;
 			usr_set_app_type(WECHAT_APP);
+			//лʱinit¼󷢳, ֻһλظ
+			if(usr_session_begin(WECHAT_APP))
+			{
+				g_trans_evt_hander->bit.wechat_init_bit_2 = 1;
+				if(g_communication_statue->phone_type == IOS_TYPE)
+					sys_start_pair_mode();
+			}
 			break;
 			
 		case BLE_WECHAT_EVT_INDICATION_DISABLED:
@@ -112,6 +125,9 @@ void app_wechat_receive(uint16_t cmd_id,uint8_t *data,uint8_t length)
 		dest_field = DATA_DATA_FIELD;
 	}
 
+	if(cmd_id == WECHAT_CMDID_RESQ_ENTRY || cmd_id == WECHAT_CMDID_RESQ_INIT)
+		usr_session_reply();
+
 	error = response_unpack(dest_field,data, length, rcv_data, &datalen,&offset);
 	
 	if(error == false)       //Ͽ
@@ -141,15 +157,18 @@ void app_wechat_receive(uint16_t cmd_id,uint8_t *data,uint8_t length)
 	        }
 	        else                                                            //½΢
 	        {
+	        	if(datalen == AES_SESSION_KEY_SIZE)
+	        		wechat_session_key_set(rcv_data);
 	        	QPRINTF("send initerq\r\n");
-	            g_trans_evt_hander.bit.wechat_init_bit_2 = 1;
-				g_communication_statue.transfer_statue = INIT_STATUE;
+	        	if(!usr_session_resuming())		//ָʱinitѾ
+	            	g_trans_evt_hander->bit.wechat_init_bit_2 = 1;
+				g_communication_statue->transfer_statue = INIT_STATUE;
 	        }
 		break;
 		
 		case WECHAT_CMDID_RESQ_INIT:                      //жǷinitظID
-			g_trans_evt_hander.bit.wechat_send_data_bit_3 = 1;
-			g_communication_statue.transfer_statue = DATA_STATUE;
+			g_trans_evt_hander->bit.wechat_send_data_bit_3 = 1;
+			g_communication_statue->transfer_statue = DATA_STATUE;
 
 			error = response_unpack(INIT_TIME_STRING_FIELD,data, length, rcv_data, &datalen,&offset);
             if(error ==false)
@@ -175,9 +194,12 @@ void app_wechat_receive(uint16_t cmd_id,uint8_t *data,uint8_t length)
 				for(i=0;i<datalen;i++)
 					QPRINTF("%02x,",rcv_data[i]);
 				QPRINTF("\r\n");
-				if(rcv_data[0] == 1)//phone == ios
+				if(rcv_data[0] == 1 && !(usr_session_cached() && g_communication_statue->phone_type == IOS_TYPE))//phone == ios
 					sys_start_pair_mode();
+				g_communication_statue->phone_type = (rcv_data[0] == 1) ? IOS_TYPE : ANDROID_TYPE;
+				usr_session_save(WECHAT_APP,g_communication_statue->phone_type,system_timezone_get(),0,0);
 			}
+			usr_session_ready();
 		break;
 		
 		case WECHAT_CMDID_RESQ_USERINFO:
@@ -203,12 +225,12 @@ void app_wechat_receive(uint16_t cmd_id,uint8_t *data,uint8_t length)
 	            //Ϊ޷ֱ̨ǹرգͳһرմֻ̨
 	            //ڷǰ̨ʱָ־λ
 				QPRINTF("wechat in background\r\n");
-				g_communication_statue.app_statue = BACKGROUND_STATUE;
+				g_communication_statue->app_statue = BACKGROUND_STATUE;
 	        }
 	        else if((*(data + 2) == 0x10) && (*(data + 3) == 0x02))   //΢ŷǰ̨
 	        {
 				QPRINTF("wechat in fornt\r\n");
-				g_communication_statue.app_statue = FRONT_STATUE;
+				g_communication_statue->app_statue = FRONT_STATUE;
 	        }
 		break;
 
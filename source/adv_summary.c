@@ -0,0 +1,206 @@
+#include "adv_summary.h"
+#include <string.h>
+#include "nrf_soc.h"
+#include "ble_gap.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "debug.h"
+
+#define APP_TIMER_PRESCALER			0
+#define ADV_SUMMARY_REFRESH_TICKS	APP_TIMER_TICKS(ADV_SUMMARY_REFRESH_MS, APP_TIMER_PRESCALER)
+
+#define ADV_SUMMARY_COMPANY_ID		(0x0000)	//͹㲥ĳһ
+#define ADV_SUMMARY_MARK			(0xFE)
+#define ADV_SUMMARY_TYPE			(0x02)		//㲥0x01
+
+#define ADV_SUMMARY_BODY_LENGTH		(13)		//0xFEbattery
+#define ADV_SUMMARY_AD_HEAD			(4)			//len, type, company
+
+APP_TIMER_DEF(m_summary_timer_id);
+
+static uint8_t 					m_sr[BLE_GAP_ADV_MAX_SIZE];		//õɨӦ, ˢʱԭظ
+static uint8_t 					m_sr_len;
+static adv_summary_st 			m_summary;
+static bool 					m_dirty;
+static uint16_t 				m_seq;
+static nrf_ecb_hal_data_t 		m_ecb;
+static bool 					m_key_valid;
+static bool 					m_suspended;
+static adv_summary_stats_st 	m_stats;
+
+static void put_be(uint8_t *p,uint32_t value,uint8_t size)
+{
+	while(size--)
+	{
+		p[size] = (uint8_t)value;
+		value >>= 8;
+	}
+}
+
+//body: 0xFEʼ13ֽ, tagдbody
+static void summary_tag(const uint8_t *body,uint8_t *tag)
+{
+	memset(m_ecb.cleartext,0,sizeof(m_ecb.cleartext));
+	memcpy(m_ecb.cleartext,body,ADV_SUMMARY_BODY_LENGTH);
+	if(sd_ecb_block_encrypt(&m_ecb) != NRF_SUCCESS)
+		memset(m_ecb.ciphertext,0,sizeof(m_ecb.ciphertext));
+	memcpy(tag,m_ecb.ciphertext,ADV_SUMMARY_TAG_LENGTH);
+}
+
+/*****************************************************************************
+ *    : adv_summary_encode
+ *  : ժҪһĳADṹ
+ *  : const adv_summary_st *p_summary  ժҪ
+               uint16_t seq                      ˢ
+ *  : uint8_t *p_out                    ADṹ, BLE_GAP_ADV_MAX_SIZEֽ
+ *   ֵ : ADṹĳ
+ * ޸ʷ : 
+ * ˵     : ûԿʱǩ. ǩУ, ֤ܵ
+*****************************************************************************/
+uint8_t adv_summary_encode(const adv_summary_st *p_summary,uint16_t seq,uint8_t *p_out)
+{
+	uint8_t *body = p_out + ADV_SUMMARY_AD_HEAD;
+	uint8_t flags = 0;
+	uint8_t length = ADV_SUMMARY_AD_HEAD + ADV_SUMMARY_BODY_LENGTH;
+	uint32_t steps = p_summary->steps;
+
+	if(steps > 0xFFFFFF)
+		steps = 0xFFFFFF;
+	if(p_summary->sync_needed == ADV_SUMMARY_UNKNOWN)
+		flags |= ADV_SUMMARY_FLAG_SYNC_UNKNOWN;
+	else if(p_summary->sync_needed)
+		flags |= ADV_SUMMARY_FLAG_SYNC;
+	if(m_key_valid)
+		flags |= ADV_SUMMARY_FLAG_TAG;
+
+	p_out[2] = (uint8_t)ADV_SUMMARY_COMPANY_ID;
+	p_out[3] = (uint8_t)(ADV_SUMMARY_COMPANY_ID >> 8);
+	body[0]  = ADV_SUMMARY_MARK;
+	body[1]  = ADV_SUMMARY_TYPE;
+	body[2]  = ADV_SUMMARY_VERSION;
+	body[3]  = flags;
+	put_be(&body[4],seq,2);
+	put_be(&body[6],steps,3);
+	put_be(&body[9],p_summary->active_minutes,2);
+	body[11] = p_summary->sleep_score;
+	body[12] = (p_summary->battery > 100 && p_summary->battery != ADV_SUMMARY_UNKNOWN) ? 100 : p_summary->battery;
+
+	if(m_key_valid)
+	{
+		summary_tag(body,&body[ADV_SUMMARY_BODY_LENGTH]);
+		length += ADV_SUMMARY_TAG_LENGTH;
+	}
+
+	p_out[0] = length - 1;
+	p_out[1] = BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA;
+	return length;
+}
+
+//ֻرɨӦһADṹ, 㲥NULLSoftDevice, ֲ
+static void summary_refresh(void)
+{
+	uint32_t err_code;
+
+	m_seq++;
+	m_sr_len = adv_summary_encode(&m_summary,m_seq,m_sr);
+	m_dirty  = false;
+
+	err_code = sd_ble_gap_adv_data_set(NULL,0,m_sr,m_sr_len);
+	if(err_code != NRF_SUCCESS)
+	{
+		QPRINTF("adv summary set 0x%x\r\n",err_code);
+		m_dirty = true;
+		return;
+	}
+	m_stats.refreshes++;
+	m_stats.bytes += m_sr_len;
+	m_stats.length = m_sr_len;
+}
+
+static void summary_timeout_handler(void *p_context)
+{
+	if(m_dirty)
+		summary_refresh();
+	else
+		m_stats.skipped++;
+}
+
+void adv_summary_init(const uint8_t *key)
+{
+	uint32_t err_code;
+
+	memset(&m_ecb,0,sizeof(m_ecb));
+	m_key_valid = false;
+#if ADV_SUMMARY_TAG
+	if(key != NULL)
+	{
+		memcpy(m_ecb.key,key,SOC_ECB_KEY_LENGTH);
+		m_key_valid = true;
+	}
+#endif
+
+	memset(&m_summary,0,sizeof(m_summary));
+	m_summary.sleep_score = ADV_SUMMARY_UNKNOWN;
+	m_summary.battery     = ADV_SUMMARY_UNKNOWN;
+	m_summary.sync_needed = ADV_SUMMARY_UNKNOWN;
+	memset(&m_stats,0,sizeof(m_stats));
+	summary_refresh();
+
+	err_code = app_timer_create(&m_summary_timer_id,APP_TIMER_MODE_REPEATED,summary_timeout_handler);
+	APP_ERROR_CHECK(err_code);
+	err_code = app_timer_start(m_summary_timer_id,ADV_SUMMARY_REFRESH_TICKS,NULL);
+	APP_ERROR_CHECK(err_code);
+}
+
+void adv_summary_set(const adv_summary_st *p_summary)
+{
+	if(p_summary->steps != m_summary.steps ||
+	   p_summary->active_minutes != m_summary.active_minutes ||
+	   p_summary->sleep_score != m_summary.sleep_score ||
+	   p_summary->battery != m_summary.battery ||
+	   p_summary->sync_needed != m_summary.sync_needed)
+	{
+		m_summary = *p_summary;
+		m_dirty = true;
+	}
+}
+
+/*****************************************************************************
+ *    : adv_summary_suspend
+ *  : ָͣˢ¶ʱ
+ *  : bool suspend  true:ͣ  false:ָ
+ *  : 
+ *   ֵ : 
+ * ޸ʷ : 
+ * ˵     : ȿʱժҪ, ÿһ; ͣڼĸĶڻָʱˢ
+*****************************************************************************/
+void adv_summary_suspend(bool suspend)
+{
+	uint32_t err_code;
+
+	if(suspend == m_suspended)
+		return;
+
+	m_suspended = suspend;
+	if(suspend)
+	{
+		err_code = app_timer_stop(m_summary_timer_id);
+		APP_ERROR_CHECK(err_code);
+		return;
+	}
+
+	if(m_dirty)
+		summary_refresh();
+	err_code = app_timer_start(m_summary_timer_id,ADV_SUMMARY_REFRESH_TICKS,NULL);
+	APP_ERROR_CHECK(err_code);
+}
+
+void adv_summary_get(adv_summary_st *p_summary)
+{
+	*p_summary = m_summary;
+}
+
+void adv_summary_stats_get(adv_summary_stats_st *p_stats)
+{
+	*p_stats = m_stats;
+}
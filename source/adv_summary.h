@@ -0,0 +1,54 @@
+#ifndef _ADV_SUMMARY_H_
+#define _ADV_SUMMARY_H_
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ADV_SUMMARY_VERSION			(2)			//2: ûݵֶ0xFF, FLAG_SYNC_UNKNOWN
+#define ADV_SUMMARY_TAG				(1)			//1:4ֽԱǩ  0:ǩ
+#define ADV_SUMMARY_REFRESH_MS		(60000)		//ɨӦˢ, û䲻ˢ
+
+#define ADV_SUMMARY_FLAG_SYNC		(0x01)		//ûͬ, Ӧͬ
+#define ADV_SUMMARY_FLAG_TAG		(0x02)		//ǩ
+#define ADV_SUMMARY_FLAG_SYNC_UNKNOWN	(0x04)	//֪ûûͬ, ʱFLAG_SYNCλ
+
+#define ADV_SUMMARY_UNKNOWN			(0xFF)		//sleep_score, battery, sync_needed: û
+#define ADV_SUMMARY_TAG_LENGTH		(4)
+
+/*****************************************************************************
+ * ɨӦĳ, ֽڴ:
+ * [len][0xFF][company 2][0xFE][0x02][version][flags][seq 2][steps 3]
+ * [active minutes 2][sleep score][battery %][tag 4, ѡ]
+ * sleep scorebatteryûʱ0xFF.
+ * tag = AES-128(MD5(device type+device ID), ǰ13ֽڲ016ֽ)ǰ4ֽ.
+ * ǩֻУ, ֤: Կ豸ID, ֪豸IDα.
+ * ܵסմİͱ豸ͬ. seqÿˢ¼1, Զɵ.
+*****************************************************************************/
+typedef struct
+{
+	uint32_t steps;
+	uint16_t active_minutes;
+	uint8_t  sleep_score;		//ADV_SUMMARY_UNKNOWN: û˯
+	uint8_t  battery;			//0~100, ADV_SUMMARY_UNKNOWN: û
+	uint8_t  sync_needed;		//0, 1, ADV_SUMMARY_UNKNOWN: ֪
+}adv_summary_st;
+
+typedef struct
+{
+	uint32_t refreshes;			//scan response updates sent to the SoftDevice
+	uint32_t skipped;			//refresh periods with nothing changed
+	uint32_t bytes;				//bytes handed to the SoftDevice, scan response only
+	uint8_t  length;			//scan response length
+}adv_summary_stats_st;
+
+
+/*****************************************************************************
+ * advertising_init֮, keyΪNULLʱǩ
+*****************************************************************************/
+void adv_summary_init(const uint8_t *key);
+void adv_summary_set(const adv_summary_st *p_summary);		//ֻ, ¸ˢڲű
+void adv_summary_get(adv_summary_st *p_summary);
+void adv_summary_suspend(bool suspend);						//ͣ/ָˢ¶ʱ, ָʱиĶˢ
+uint8_t adv_summary_encode(const adv_summary_st *p_summary,uint16_t seq,uint8_t *p_out);	//س
+void adv_summary_stats_get(adv_summary_stats_st *p_stats);
+
+#endif
@@ -0,0 +1,373 @@
+#include "alarm.h"
+#include <string.h>
+#include "app_timer.h"
+#include "app_scheduler.h"
+#include "app_util_platform.h"
+#include "time.h"
+#include "debug.h"
+
+#define APP_TIMER_PRESCALER			0
+#define ALARM_TICKS_PER_SEC			APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER)
+
+#define ALARM_DAY_SEC				(86400)
+#define ALARM_NEVER					(0xFFFFFFFF)
+#define ALARM_LONG_SIT_ID			(ALARM_MAX)			//ѵı, Ӻ
+#define ALARM_ENTRY_SIZE			(3)					//ÿ: [flags][hour][minute]
+#define ALARM_FLAG_ENABLE			(0x80)
+#define ALARM_WEEK_MASK				(0x7F)
+
+#define ALARM_STAGED_ALARMS			(0x01)
+#define ALARM_STAGED_LONG_SIT		(0x02)
+#define ALARM_STAGED_TIME			(0x04)
+
+typedef struct
+{
+	uint32_t fire;			//һεı
+	uint8_t id;				//±ALARM_LONG_SIT_ID
+}alarm_entry_st;
+
+APP_TIMER_DEF(m_timer_id);
+
+static alarm_handler_t m_handler;
+static alarm_st m_alarms[ALARM_MAX];
+static long_sit_st m_long_sit;
+static uint32_t m_sit_since;					//ʱ俪ʼû߹·
+
+static alarm_entry_st m_heap[ALARM_MAX + 1];	//fireŵС
+static uint8_t m_heap_count;
+
+//Эջ¼յ, ѭ
+static alarm_st m_alarms_staged[ALARM_MAX];
+static long_sit_st m_long_sit_staged;
+static uint8_t m_staged;
+static bool m_sched_pending;
+
+static alarm_stats_st m_stats;
+
+//1970-01-01, һ0
+static uint8_t alarm_weekday(uint32_t day)
+{
+	return (uint8_t)((day + 3) % 7);
+}
+
+static bool alarm_day_match(uint8_t week,uint32_t day)
+{
+	return (week & (1 << alarm_weekday(day))) != 0;
+}
+
+static uint32_t alarm_next(const alarm_st *p_alarm,uint32_t now)
+{
+	uint32_t day = now / ALARM_DAY_SEC;
+	uint32_t fire;
+	uint8_t i;
+
+	for(i=0;i<=7;i++)
+	{
+		fire = (day + i) * ALARM_DAY_SEC + p_alarm->hour * 3600UL + p_alarm->minute * 60UL;
+		if(fire > now && (p_alarm->week == 0 || alarm_day_match(p_alarm->week,day + i)))
+			return fire;
+	}
+	return ALARM_NEVER;
+}
+
+//ʱm_sit_since(ʱοʼ)˵ʱ, Ѿ
+static uint32_t alarm_long_sit_next(uint32_t now)
+{
+	uint32_t day = now / ALARM_DAY_SEC;
+	uint32_t start,end,fire;
+	uint8_t i;
+
+	for(i=0;i<=7;i++)
+	{
+		if(m_long_sit.week && !alarm_day_match(m_long_sit.week,day + i))
+			continue;
+
+		start = (day + i) * ALARM_DAY_SEC + m_long_sit.start * 60UL;
+		end   = (day + i) * ALARM_DAY_SEC + m_long_sit.end * 60UL;
+		fire  = ((m_sit_since > start) ? m_sit_since : start) + m_long_sit.minutes * 60UL;
+		if(end > now && fire <= end)
+			return fire;
+	}
+	return ALARM_NEVER;
+}
+
+static void alarm_heap_swap(uint8_t a,uint8_t b)
+{
+	alarm_entry_st entry = m_heap[a];
+
+	m_heap[a] = m_heap[b];
+	m_heap[b] = entry;
+}
+
+static void alarm_heap_down(uint8_t i)
+{
+	uint8_t child;
+
+	for(;;)
+	{
+		child = 2 * i + 1;
+		if(child >= m_heap_count)
+			break;
+		if(child + 1 < m_heap_count && m_heap[child + 1].fire < m_heap[child].fire)
+			child++;
+		if(m_heap[i].fire <= m_heap[child].fire)
+			break;
+		alarm_heap_swap(i,child);
+		i = child;
+	}
+}
+
+//Ѷµʱ, ALARM_NEVERͰѶѶȥ
+static void alarm_heap_replace_top(uint32_t fire)
+{
+	if(fire == ALARM_NEVER)
+		m_heap[0] = m_heap[--m_heap_count];
+	else
+		m_heap[0].fire = fire;
+	alarm_heap_down(0);
+}
+
+static void alarm_heap_build(uint32_t now)
+{
+	uint32_t fire;
+	uint8_t i;
+
+	m_heap_count = 0;
+	for(i=0;i<ALARM_MAX;i++)
+	{
+		if(!m_alarms[i].enable)
+			continue;
+		fire = alarm_next(&m_alarms[i],now);
+		if(fire != ALARM_NEVER)
+		{
+			m_heap[m_heap_count].fire = fire;
+			m_heap[m_heap_count].id   = i;
+			m_heap_count++;
+		}
+	}
+
+	if(m_long_sit.enable)
+	{
+		fire = alarm_long_sit_next(now);
+		if(fire != ALARM_NEVER)
+		{
+			m_heap[m_heap_count].fire = fire;
+			m_heap[m_heap_count].id   = ALARM_LONG_SIT_ID;
+			m_heap_count++;
+		}
+	}
+
+	for(i=m_heap_count/2;i>0;i--)
+		alarm_heap_down(i - 1);
+}
+
+static void alarm_arm(uint32_t now)
+{
+	uint32_t delay;
+	uint32_t err_code;
+
+	(void)app_timer_stop(m_timer_id);
+	if(m_heap_count == 0)
+		return;
+
+	delay = (m_heap[0].fire > now) ? m_heap[0].fire - now : 1;
+	if(delay > ALARM_TIMER_MAX_SEC)
+		delay = ALARM_TIMER_MAX_SEC;
+
+	err_code = app_timer_start(m_timer_id,delay * ALARM_TICKS_PER_SEC,NULL);
+	if(err_code != NRF_SUCCESS)
+		QPRINTF("alarm timer 0x%x\r\n",err_code);
+}
+
+static void alarm_timeout_handler(void *p_context)
+{
+	uint32_t now = system_sec_get();
+	uint32_t fire;
+	uint8_t id;
+	bool idle = true;
+
+	m_stats.wakeups++;
+	while(m_heap_count && m_heap[0].fire <= now)
+	{
+		idle = false;
+		id = m_heap[0].id;
+		if(id == ALARM_LONG_SIT_ID)
+		{
+			//ʱſû߹·, ߹Ͱµʱ
+			fire = alarm_long_sit_next(now);
+			if(fire <= now)
+			{
+				m_stats.long_sits++;
+				m_sit_since = now;
+				m_handler(ALARM_EVT_LONG_SIT,0);
+				fire = alarm_long_sit_next(now);
+			}
+			else
+				m_stats.deferred++;
+		}
+		else
+		{
+			m_stats.alarms++;
+			m_handler(ALARM_EVT_ALARM,id);
+			if(m_alarms[id].week == 0)
+				m_alarms[id].enable = false;
+			fire = m_alarms[id].enable ? alarm_next(&m_alarms[id],now) : ALARM_NEVER;
+		}
+		alarm_heap_replace_top(fire);
+	}
+
+	if(idle)
+		m_stats.idle_wakeups++;
+	alarm_arm(now);
+}
+
+static void alarm_reschedule(void *p_event_data,uint16_t event_size)
+{
+	uint32_t now = system_sec_get();
+	uint8_t staged;
+
+	CRITICAL_REGION_ENTER();
+	staged = m_staged;
+	if(staged & ALARM_STAGED_ALARMS)
+		memcpy(m_alarms,m_alarms_staged,sizeof(m_alarms));
+	if(staged & ALARM_STAGED_LONG_SIT)
+		m_long_sit = m_long_sit_staged;
+	m_staged = 0;
+	m_sched_pending = false;
+	CRITICAL_REGION_EXIT();
+
+	//ʱ߾ñ, ڿʼ˶
+	if(staged & (ALARM_STAGED_LONG_SIT | ALARM_STAGED_TIME))
+		m_sit_since = now;
+
+	m_stats.reschedules++;
+	alarm_heap_build(now);
+	alarm_arm(now);
+}
+
+//һúͶʱֻһ
+static void alarm_stage(uint8_t flag)
+{
+	bool post;
+
+	CRITICAL_REGION_ENTER();
+	m_staged |= flag;
+	post = !m_sched_pending;
+	m_sched_pending = true;
+	CRITICAL_REGION_EXIT();
+
+	if(post && app_sched_event_put(NULL,0,alarm_reschedule) != NRF_SUCCESS)
+	{
+		m_sched_pending = false;
+		QPRINTF("alarm reschedule dropped\r\n");
+	}
+}
+
+/*****************************************************************************
+ *    : alarm_init
+ *  : õĶʱ, ʼʱûҲûо
+ *  : alarm_handler_t handler  ʱѭ
+ *  : 
+ *   ֵ : app_timer_createĽ
+ * ޸ʷ : 
+ * ˵     : Ҫtimers_initscheduler_init֮
+*****************************************************************************/
+uint32_t alarm_init(alarm_handler_t handler)
+{
+	m_handler = handler;
+	memset(m_alarms,0,sizeof(m_alarms));
+	memset(&m_long_sit,0,sizeof(m_long_sit));
+	m_sit_since = system_sec_get();
+	m_heap_count = 0;
+	m_staged = 0;
+	m_sched_pending = false;
+	memset(&m_stats,0,sizeof(m_stats));
+
+	return app_timer_create(&m_timer_id,APP_TIMER_MODE_SINGLE_SHOT,alarm_timeout_handler);
+}
+
+/*****************************************************************************
+ *    : alarm_setting_put
+ *  : յAPP
+ *  : const uint8_t *p_data  [count][flags hour minute]*count
+               uint8_t length         ݳ
+ *  : 
+ *   ֵ : 
+ * ޸ʷ : 
+ * ˵     : flagsbit7ǿ, bit0~6һ, 0ֻһ.
+              бһ, ûӶص. Эջ¼
+*****************************************************************************/
+void alarm_setting_put(const uint8_t *p_data,uint8_t length)
+{
+	uint8_t i,count;
+
+	if(length < 1)
+		return;
+	count = p_data[0];
+	if(count > ALARM_MAX || length < 1 + count * ALARM_ENTRY_SIZE)
+		return;
+
+	CRITICAL_REGION_ENTER();
+	memset(m_alarms_staged,0,sizeof(m_alarms_staged));
+	for(i=0,p_data++;i<count;i++,p_data+=ALARM_ENTRY_SIZE)
+	{
+		if(p_data[1] > 23 || p_data[2] > 59)
+			continue;
+		m_alarms_staged[i].enable = (p_data[0] & ALARM_FLAG_ENABLE) != 0;
+		m_alarms_staged[i].week   = p_data[0] & ALARM_WEEK_MASK;
+		m_alarms_staged[i].hour   = p_data[1];
+		m_alarms_staged[i].minute = p_data[2];
+	}
+	CRITICAL_REGION_EXIT();
+
+	alarm_stage(ALARM_STAGED_ALARMS);
+}
+
+/*****************************************************************************
+ *    : alarm_long_sit_put
+ *  : յAPPľ
+ *  : const uint8_t *p_data  [enable][week][start h][start m][end h][end m][minutes]
+               uint8_t length         ݳ
+ *  : 
+ *   ֵ : 
+ * ޸ʷ : 
+ * ˵     : weekbit0~6һ, 0ÿ. Эջ¼
+*****************************************************************************/
+void alarm_long_sit_put(const uint8_t *p_data,uint8_t length)
+{
+	long_sit_st setting;
+
+	if(length < 7)
+		return;
+
+	setting.enable  = (p_data[0] != 0);
+	setting.week    = p_data[1] & ALARM_WEEK_MASK;
+	setting.start   = p_data[2] * 60 + p_data[3];
+	setting.end     = p_data[4] * 60 + p_data[5];
+	setting.minutes = p_data[6];
+	if(setting.end > 24 * 60 || setting.start >= setting.end || setting.minutes == 0)
+		setting.enable = false;
+
+	CRITICAL_REGION_ENTER();
+	m_long_sit_staged = setting;
+	CRITICAL_REGION_EXIT();
+
+	alarm_stage(ALARM_STAGED_LONG_SIT);
+}
+
+void alarm_time_changed(void)
+{
+	alarm_stage(ALARM_STAGED_TIME);
+}
+
+//ֻʱ, ʱٿ
+void alarm_activity(uint32_t sec)
+{
+	if(sec > m_sit_since)
+		m_sit_since = sec;
+}
+
+void alarm_stats_get(alarm_stats_st *p_stats)
+{
+	*p_stats = m_stats;
+}
@@ -0,0 +1,56 @@
+#ifndef _ALARM_H_
+#define _ALARM_H_
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ALARM_MAX					(8)			//APPӸ
+#define ALARM_TIMER_MAX_SEC			(240)		//app_timerһඨô, Զͷּ
+
+#define ALARM_EVT_ALARM				(0)			//ӵ, indexǵڼ
+#define ALARM_EVT_LONG_SIT			(1)			//, indexû
+
+typedef struct
+{
+	bool enable;
+	uint8_t week;			//bit0~6һ, 0ʾֻһ
+	uint8_t hour;
+	uint8_t minute;
+}alarm_st;
+
+typedef struct
+{
+	bool enable;
+	uint8_t week;			//bit0~6һ, 0ʾÿ
+	uint16_t start;			//һĵڼӿʼ
+	uint16_t end;			//ڼӽ, Ҫstart
+	uint8_t minutes;		//ôû·
+}long_sit_st;
+
+typedef struct
+{
+	uint32_t wakeups;			//ʱʱĴ
+	uint32_t idle_wakeups;		//ûҪĵʱ, ALARM_TIMER_MAX_SECּζ
+	uint32_t alarms;			//
+	uint32_t long_sits;			//ľ
+	uint32_t deferred;			//ʱ߹·, Ƶľ
+	uint32_t reschedules;		//ûʱԺŵĴ
+}alarm_stats_st;
+
+typedef void (*alarm_handler_t)(uint8_t evt,uint8_t index);
+
+
+/*****************************************************************************
+ * Ӻ;: ÿӺ;ѰһεʱһС,
+ * ֻѶһεapp_timer, ÿȥ. úʱЭջ
+ * ¼, ȴ, ѭһ. ·ʱֻʱ, ʱ,
+ * ѵʱٿʱû߹·, ߹.
+ * ʱ䶼system_sec_getı.
+*****************************************************************************/
+uint32_t alarm_init(alarm_handler_t handler);
+void alarm_setting_put(const uint8_t *p_data,uint8_t length);		//APP_PUSH_ALARM_SETTING_CMD
+void alarm_long_sit_put(const uint8_t *p_data,uint8_t length);		//APP_PUSH_LONG_SIT_SETTING_CMD
+void alarm_time_changed(void);										//ĹʱʱԺ
+void alarm_activity(uint32_t sec);									//secʱ߹·
+void alarm_stats_get(alarm_stats_st *p_stats);
+
+#endif
@@ -20,7 +20,7 @@ ble_android_ancs_t          m_android_ancs;
 
 static void android_ancs_on_connect(ble_android_ancs_t * p_android_ancs, ble_evt_t * p_ble_evt)
 {
-    p_android_ancs->conn_handle = p_ble_evt->evt.gatts_evt.conn_handle;
+    UNUSED_PARAMETER(p_ble_evt);
 	android_ancs_connection();
 }
 
@@ -315,6 +315,13 @@ static void android_ancs_on_cccd_write(ble_android_ancs_t * p_android_ancs, ble_
 static void android_ancs_on_write(ble_android_ancs_t * p_android_ancs, ble_evt_t * p_ble_evt)
 {
     ble_gatts_evt_write_t * p_evt_write = &p_ble_evt->evt.gatts_evt.params.write;
+
+    //һдռֱͨϿ
+    if((p_evt_write->handle == p_android_ancs->indicate_handles.cccd_handle) ||
+       (p_evt_write->handle == p_android_ancs->write_handles.value_handle))
+    {
+        p_android_ancs->conn_handle = p_ble_evt->evt.gatts_evt.conn_handle;
+    }
 	
     if(p_evt_write->handle == p_android_ancs->indicate_handles.cccd_handle)						//indicateͨ
     {
@@ -350,6 +357,13 @@ static void android_ancs_on_hvc(ble_android_ancs_t * p_android_ancs, ble_evt_t *
 ***************************************************************************************************************/
 void ble_ancs_on_ble_evt(ble_android_ancs_t * p_android_ancs, ble_evt_t * p_ble_evt)
 {
+    //ͬһʱֻһӣһӵ¼
+    if((p_android_ancs->conn_handle != BLE_CONN_HANDLE_INVALID) &&
+       (p_android_ancs->conn_handle != p_ble_evt->evt.gap_evt.conn_handle))
+    {
+        return;
+    }
+
     switch(p_ble_evt->header.evt_id)
     {
         case BLE_GAP_EVT_CONNECTED:
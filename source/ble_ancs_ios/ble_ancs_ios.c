@@ -36,6 +36,12 @@ ble_ancs_c_t              		m_ios_ancs;                                 /**< Str
 #define TX_BUFFER_SIZE                   (TX_BUFFER_MASK + 1)     /**< Size of send buffer, which is 1 higher than the mask. */
 #define WRITE_MESSAGE_LENGTH             20                       /**< Length of the write message for CCCD/control point. */
 #define BLE_CCCD_NOTIFY_BIT_MASK         0x0001                   /**< Enable notification bit. */
+#define BLE_CCCD_INDICATE_BIT_MASK       0x0002                   /**< Enable indication bit. */
+
+#define ANCS_CACHE_MAGIC                 0xA5C1                   /**< Marks a valid handle cache record in the application context of a bond. */
+#define ANCS_CACHE_NS_CCCD               0x0001                   /**< The peer acknowledged the Notification Source CCCD write. */
+#define ANCS_CACHE_DS_CCCD               0x0002                   /**< The peer acknowledged the Data Source CCCD write. */
+#define ANCS_CACHE_SC_CCCD               0x0004                   /**< The peer acknowledged the Service Changed CCCD write. */
 
 #define BLE_ANCS_MAX_DISCOVERED_CENTRALS DEVICE_MANAGER_MAX_BONDS /**< Maximum number of discovered services that can be stored in the flash. This number should be identical to maximum number of bonded peer devices. */
 
@@ -83,6 +89,32 @@ static uint32_t     m_tx_index        = 0;                                 /**<
 
 static uint8_t             incoming_call_uid[4];
 
+
+/**@brief Handles of the peer's ANCS and Service Changed characteristics, kept per bond in the
+ *        Device Manager application context so that discovery can be skipped on reconnection.
+ */
+typedef struct
+{
+    uint16_t magic;                    /**< @ref ANCS_CACHE_MAGIC if the record is valid. */
+    uint16_t cccd_state;               /**< CCCD writes acknowledged by the peer, ANCS_CACHE_xx_CCCD bits. */
+    uint16_t control_point_handle;     /**< Control Point value handle. */
+    uint16_t notif_source_handle;      /**< Notification Source value handle. */
+    uint16_t notif_source_cccd_handle; /**< Notification Source CCCD handle. */
+    uint16_t data_source_handle;       /**< Data Source value handle. */
+    uint16_t data_source_cccd_handle;  /**< Data Source CCCD handle. */
+    uint16_t service_changed_handle;   /**< Service Changed value handle, BLE_GATT_HANDLE_INVALID if the peer has none. */
+} ancs_handle_cache_t;
+
+STATIC_ASSERT(sizeof(ancs_handle_cache_t) == DEVICE_MANAGER_APP_CONTEXT_SIZE);
+
+static ancs_handle_cache_t        m_cache;              /**< Handles in use on the current link. */
+static ancs_handle_cache_t        m_cache_record;       /**< Copy being written to flash, must stay valid until the write has completed. */
+static dm_application_context_t   m_cache_context;      /**< Context passed to the Device Manager, read by the flash write as well. */
+static dm_handle_t                m_cache_peer;         /**< Bonded peer of the current link, device_id is DM_INVALID_ID if unknown. */
+static bool                       m_cache_stored;       /**< The handles of the current link are already in flash. */
+static uint16_t                   m_sc_cccd_handle;     /**< Service Changed CCCD handle found by the last discovery. */
+static ble_db_discovery_t       * mp_db_discovery;      /**< Discovery instance to restart when the peer's database changed. */
+
 /**@brief 128-bit service UUID for the Apple Notification Center Service.
  */
 const ble_uuid128_t ble_ancs_base_uuid128 =
@@ -130,28 +162,159 @@ const ble_uuid128_t ble_ancs_ds_base_uuid128 =
 };
 
 
+/**@brief Function for storing the handles of the current link for its bonded peer.
+ *
+ * @details Only done once the peer acknowledged the CCCD writes, so that a reconnection using
+ *          the stored record needs neither discovery nor CCCD writes.
+ */
+static void ancs_cache_store(void)
+{
+    uint16_t expected = ANCS_CACHE_NS_CCCD | ANCS_CACHE_DS_CCCD;
+    uint32_t err_code;
+
+    if (m_cache.service_changed_handle != BLE_GATT_HANDLE_INVALID)
+    {
+        // Without Service Changed indications a changed database would go unnoticed.
+        expected |= ANCS_CACHE_SC_CCCD;
+    }
+
+    if (m_cache_stored || (m_cache_peer.device_id == DM_INVALID_ID) || (m_cache.cccd_state != expected))
+    {
+        return;
+    }
+
+    m_cache.magic          = ANCS_CACHE_MAGIC;
+    m_cache_record         = m_cache;
+    m_cache_context.len    = sizeof(m_cache_record);
+    m_cache_context.p_data = (uint8_t *)&m_cache_record;
+
+    // Fails for peers that did not bond, they are discovered on every connection.
+    err_code = dm_application_context_set(&m_cache_peer, &m_cache_context);
+    QPRINTF("[ANCS]: Store handle cache, result 0x%x\r\n", err_code);
+
+    m_cache_stored = (err_code == NRF_SUCCESS);
+}
+
+
+/**@brief Function for dropping the stored handles of the current link's peer.
+ */
+static void ancs_cache_delete(void)
+{
+    if (m_cache_peer.device_id != DM_INVALID_ID)
+    {
+        (void)dm_application_context_delete(&m_cache_peer);
+    }
+    memset(&m_cache, 0, sizeof(m_cache));
+    m_cache_stored = false;
+}
+
+
+/**@brief Function for tracking which CCCD writes the peer acknowledged.
+ *
+ * @param[in] p_gattc_evt  Write response event.
+ */
+static void ancs_cache_on_write_rsp(const ble_gattc_evt_t * p_gattc_evt)
+{
+    uint16_t handle = p_gattc_evt->params.write_rsp.handle;
+
+    if (p_gattc_evt->gatt_status != BLE_GATT_STATUS_SUCCESS)
+    {
+        return;
+    }
+
+    if (handle == m_cache.notif_source_cccd_handle)
+    {
+        m_cache.cccd_state |= ANCS_CACHE_NS_CCCD;
+    }
+    else if (handle == m_cache.data_source_cccd_handle)
+    {
+        m_cache.cccd_state |= ANCS_CACHE_DS_CCCD;
+    }
+    else if (handle == m_sc_cccd_handle)
+    {
+        m_cache.cccd_state |= ANCS_CACHE_SC_CCCD;
+    }
+    else
+    {
+        return;
+    }
+
+    ancs_cache_store();
+}
+
+
 /**@brief  Function for handling Disconnected event received from the SoftDevice.
  *
  * @details This function check if the disconnect event is happening on the link
  *          associated with the current instance of the module, if so it will set its
- *          conn_handle to invalid.
+ *          conn_handle to invalid and drop the handle cache of that link.
  *
  * @param[in] p_ancs    Pointer to the ANCS client structure.
  * @param[in] p_ble_evt Pointer to the BLE event received.
  */
 static void on_disconnected(ble_ancs_c_t * p_ancs, const ble_evt_t * p_ble_evt)
 {
-    if (p_ancs->conn_handle == p_ble_evt->evt.gap_evt.conn_handle)
+    if (p_ancs->conn_handle != p_ble_evt->evt.gap_evt.conn_handle)
     {
-        p_ancs->conn_handle = BLE_CONN_HANDLE_INVALID;
+        return;
     }
+
+    p_ancs->conn_handle = BLE_CONN_HANDLE_INVALID;
+    (void)dm_handle_initialize(&m_cache_peer);
+    memset(&m_cache, 0, sizeof(m_cache));
+    m_cache_stored   = false;
+    m_sc_cccd_handle = BLE_GATT_HANDLE_INVALID;
 }
 
+/**@brief  Function for handling Connected event received from the SoftDevice.
+ *
+ * @details The client serves one link, the first one to connect while it is free.
+ */
 static void on_connected(ble_ancs_c_t * p_ancs, const ble_evt_t * p_ble_evt)
 {
-    p_ancs->conn_handle = p_ble_evt->evt.gatts_evt.conn_handle;
+    if (p_ancs->conn_handle == BLE_CONN_HANDLE_INVALID)
+    {
+        p_ancs->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+    }
+}
+
+static uint32_t cccd_write(const uint16_t conn_handle, const uint16_t handle_cccd, uint16_t cccd_val);
+
+
+/**@brief Function for handling the discovery of the peer's GATT service.
+ *
+ * @details Enables Service Changed indications, which tell whether the handles stored for a
+ *          bonded peer are still valid.
+ *
+ * @param[in] p_evt  Event from the database discovery module.
+ */
+static void on_gatt_srv_disc(ble_db_discovery_evt_t * p_evt)
+{
+    ble_gatt_db_char_t * p_chars = p_evt->params.discovered_db.charateristics;
+
+    m_cache.service_changed_handle = BLE_GATT_HANDLE_INVALID;
+    m_sc_cccd_handle               = BLE_GATT_HANDLE_INVALID;
+
+    if (p_evt->evt_type != BLE_DB_DISCOVERY_COMPLETE)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < p_evt->params.discovered_db.char_count; i++)
+    {
+        if ((p_chars[i].characteristic.uuid.uuid == BLE_UUID_GATT_CHARACTERISTIC_SERVICE_CHANGED) &&
+            (p_chars[i].cccd_handle != BLE_GATT_HANDLE_INVALID))
+        {
+            m_cache.service_changed_handle = p_chars[i].characteristic.handle_value;
+            m_sc_cccd_handle               = p_chars[i].cccd_handle;
+
+            (void)cccd_write(p_evt->conn_handle, m_sc_cccd_handle, BLE_CCCD_INDICATE_BIT_MASK);
+            break;
+        }
+    }
 }
 
+
 void ble_ancs_c_on_db_disc_evt(ble_ancs_c_t * p_ancs, ble_db_discovery_evt_t * p_evt)
 {
     QPRINTF("[ANCS]: Database Discovery handler called with event 0x%02x\r\n", p_evt->evt_type);
@@ -161,6 +324,14 @@ void ble_ancs_c_on_db_disc_evt(ble_ancs_c_t * p_ancs, ble_db_discovery_evt_t * p
 
     p_chars = p_evt->params.discovered_db.charateristics;
 
+    if (p_evt->evt_type != BLE_DB_DISCOVERY_ERROR &&
+        p_evt->params.discovered_db.srv_uuid.uuid == BLE_UUID_GATT &&
+        p_evt->params.discovered_db.srv_uuid.type == BLE_UUID_TYPE_BLE)
+    {
+        on_gatt_srv_disc(p_evt);
+        return;
+    }
+
     // Check if the ANCS Service was discovered.
     if (p_evt->evt_type == BLE_DB_DISCOVERY_COMPLETE &&
         p_evt->params.discovered_db.srv_uuid.uuid == ANCS_UUID_SERVICE &&
@@ -273,7 +444,18 @@ static void on_evt_gattc_notif(ble_ancs_c_t * p_ancs, const ble_evt_t * p_ble_ev
         return;
     }
 
-    if (p_notif->handle == p_ancs->service.notif_source_char.handle_value)
+    if ((p_notif->handle == m_cache.service_changed_handle) &&
+        (p_notif->handle != BLE_GATT_HANDLE_INVALID))
+    {
+        ble_ancs_c_evt_t evt;
+
+        (void)sd_ble_gattc_hv_confirm(p_ancs->conn_handle, p_notif->handle);
+
+        evt.evt_type    = BLE_ANCS_C_EVT_SERVICE_CHANGED;
+        evt.conn_handle = p_ancs->conn_handle;
+        p_ancs->evt_handler(&evt);
+    }
+    else if (p_notif->handle == p_ancs->service.notif_source_char.handle_value)
     {
         parse_notif( p_notif->data, p_notif->len);
     }
@@ -295,6 +477,8 @@ static void on_write_rsp(ble_ancs_c_t * p_ancs, const ble_evt_t * p_ble_evt)
     {
         return;
     }
+    ancs_cache_on_write_rsp(&p_ble_evt->evt.gattc_evt);
+
     // Check if there is any message to be sent across to the peer and send it.
     tx_buffer_process();
 }
@@ -348,7 +532,7 @@ uint32_t ble_ancs_c_init(ble_ancs_c_t * p_ancs, const ble_ancs_c_init_t * p_ancs
 
     // Make sure instance of service is clear. GATT handles inside the service and characteristics are set to @ref BLE_GATT_HANDLE_INVALID.
     memset(&p_ancs->service, 0, sizeof(ble_ancs_c_service_t));
-    memset(m_tx_buffer, 0, TX_BUFFER_SIZE);
+    memset(m_tx_buffer, 0, sizeof(m_tx_buffer));
 
     // Assign UUID types.
     err_code = sd_ble_uuid_vs_add(&ble_ancs_base_uuid128, &p_ancs->service.service.uuid.type);
@@ -381,9 +565,22 @@ uint32_t ble_ancs_c_init(ble_ancs_c_t * p_ancs, const ble_ancs_c_init_t * p_ancs
  * @retval NRF_ERROR_INVALID_PARAM  If one of the input parameters was invalid.
  */
 static uint32_t cccd_configure(const uint16_t conn_handle, const uint16_t handle_cccd, bool enable)
+{
+    return cccd_write(conn_handle, handle_cccd, enable ? BLE_CCCD_NOTIFY_BIT_MASK : 0);
+}
+
+
+/**@brief Function for creating a TX message writing a value to a CCCD.
+ *
+ * @param[in] conn_handle  Connection handle on which to perform the configuration.
+ * @param[in] handle_cccd  Handle of the CCCD.
+ * @param[in] cccd_val     Value to write, BLE_CCCD_xx_BIT_MASK bits.
+ *
+ * @retval NRF_SUCCESS  If the message was created successfully.
+ */
+static uint32_t cccd_write(const uint16_t conn_handle, const uint16_t handle_cccd, uint16_t cccd_val)
 {
     tx_message_t * p_msg;
-    uint16_t       cccd_val = enable ? BLE_CCCD_NOTIFY_BIT_MASK : 0;
 
     p_msg              = &m_tx_buffer[m_tx_insert_index++];
     m_tx_insert_index &= TX_BUFFER_MASK;
@@ -656,10 +853,30 @@ static void on_ancs_c_evt(ble_ancs_c_evt_t * p_evt)
             QPRINTF("Apple Notification Service discovered on the server.\r\n");
             err_code = ble_ancs_c_handles_assign(&m_ios_ancs,p_evt->conn_handle, &p_evt->service);
             APP_ERROR_CHECK(err_code);
+
+            m_cache.cccd_state               = 0;
+            m_cache.control_point_handle     = p_evt->service.control_point_char.handle_value;
+            m_cache.notif_source_handle      = p_evt->service.notif_source_char.handle_value;
+            m_cache.notif_source_cccd_handle = p_evt->service.notif_source_cccd.handle;
+            m_cache.data_source_handle       = p_evt->service.data_source_char.handle_value;
+            m_cache.data_source_cccd_handle  = p_evt->service.data_source_cccd.handle;
             apple_notification_setup();
 
             break;
 
+        case BLE_ANCS_C_EVT_SERVICE_CHANGED:
+            QPRINTF("Service Changed, discovering the server again.\r\n");
+            ancs_cache_delete();
+            if (mp_db_discovery != NULL)
+            {
+                err_code = ble_db_discovery_start(mp_db_discovery, p_evt->conn_handle);
+                if (err_code != NRF_ERROR_BUSY)
+                {
+                    APP_ERROR_CHECK(err_code);
+                }
+            }
+            break;
+
         case BLE_ANCS_C_EVT_NOTIF:
 			evt_ios_notification(&p_evt->notif);
             break;
@@ -679,9 +896,10 @@ static void apple_notification_error_handler(uint32_t nrf_error)
     APP_ERROR_HANDLER(nrf_error);
 }
 
-void ios_ancs_service_init(void)
+void ios_ancs_service_init(ble_db_discovery_t * p_db_discovery)
 {
     ble_ancs_c_init_t ancs_init_obj;
+    ble_uuid_t        gatt_uuid;
     uint32_t          err_code;
 
     memset(&ancs_init_obj, 0, sizeof(ancs_init_obj));
@@ -691,5 +909,65 @@ void ios_ancs_service_init(void)
 
     err_code = ble_ancs_c_init(&m_ios_ancs, &ancs_init_obj);
     APP_ERROR_CHECK(err_code);
+
+    // Discovered after ANCS, for the Service Changed characteristic.
+    gatt_uuid.uuid = BLE_UUID_GATT;
+    gatt_uuid.type = BLE_UUID_TYPE_BLE;
+    err_code = ble_db_discovery_evt_register(&gatt_uuid);
+    APP_ERROR_CHECK(err_code);
+
+    mp_db_discovery  = p_db_discovery;
+    m_sc_cccd_handle = BLE_GATT_HANDLE_INVALID;
+    (void)dm_handle_initialize(&m_cache_peer);
+}
+
+
+/**@brief Function for restoring the ANCS handles stored for a bonded peer.
+ *
+ * @details Called when the link is secured. The peer keeps the CCCDs of a bond, so on success
+ *          notifications arrive without discovery or CCCD writes. A Service Changed indication
+ *          from the peer drops the stored handles and restarts discovery.
+ *
+ * @param[in] p_handle     Device Manager handle of the peer.
+ * @param[in] conn_handle  Connection handle of the link.
+ *
+ * @retval true  If the handles were restored, discovery is not needed.
+ * @retval false If the peer has no stored handles.
+ */
+bool ios_ancs_handles_restore(dm_handle_t const * p_handle, uint16_t conn_handle)
+{
+    dm_application_context_t context;
+    ble_ancs_c_service_t     service;
+    uint32_t                 err_code;
+
+    m_cache_peer   = *p_handle;
+    m_cache_stored = false;
+
+    context.len    = 0;
+    context.p_data = (uint8_t *)&m_cache;
+
+    err_code = dm_application_context_get(p_handle, &context);
+    if ((err_code != NRF_SUCCESS) ||
+        (context.len != sizeof(m_cache)) ||
+        (m_cache.magic != ANCS_CACHE_MAGIC))
+    {
+        memset(&m_cache, 0, sizeof(m_cache));
+        return false;
+    }
+
+    memset(&service, 0, sizeof(service));
+    service.control_point_char.handle_value = m_cache.control_point_handle;
+    service.notif_source_char.handle_value  = m_cache.notif_source_handle;
+    service.notif_source_cccd.handle        = m_cache.notif_source_cccd_handle;
+    service.data_source_char.handle_value   = m_cache.data_source_handle;
+    service.data_source_cccd.handle         = m_cache.data_source_cccd_handle;
+
+    err_code = ble_ancs_c_handles_assign(&m_ios_ancs, conn_handle, &service);
+    APP_ERROR_CHECK(err_code);
+
+    m_cache_stored = true;
+    QPRINTF("[ANCS]: Handles restored from bond, skipping discovery.\r\n");
+
+    return true;
 }
 
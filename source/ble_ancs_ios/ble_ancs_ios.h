@@ -104,7 +104,8 @@ typedef enum
     BLE_ANCS_C_EVT_DISCOVERY_FAILED,           /**< It was not possible to discover the service or characteristics of the connected peer. */
     BLE_ANCS_C_EVT_NOTIF,                      /**< An iOS notification was received on the notification source control point. */
     BLE_ANCS_C_EVT_INVALID_NOTIF,              /**< An iOS notification was received on the notification source control point, but the format is invalid. */
-    BLE_ANCS_C_EVT_NOTIF_ATTRIBUTE             /**< A received iOS notification attribute has been parsed. */
+    BLE_ANCS_C_EVT_NOTIF_ATTRIBUTE,            /**< A received iOS notification attribute has been parsed. */
+    BLE_ANCS_C_EVT_SERVICE_CHANGED             /**< The peer indicated Service Changed. Handles of the service may no longer be valid. */
 } ble_ancs_c_evt_type_t;
 
 /**@brief Category IDs for iOS notifications. */
@@ -391,7 +392,8 @@ uint32_t ble_ancs_c_handles_assign(ble_ancs_c_t * p_ancs, const uint16_t conn_ha
 
 extern void ble_ancs_ccc_read(ble_ancs_c_t * p_ancs);
 extern void Hang_up_Photo(bool action_state);
-extern void ios_ancs_service_init(void);
+extern void ios_ancs_service_init(ble_db_discovery_t * p_db_discovery);
+extern bool ios_ancs_handles_restore(dm_handle_t const * p_handle, uint16_t conn_handle);
 
 #endif // BLE_ANCS_C_H__
 
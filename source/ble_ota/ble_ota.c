@@ -7,7 +7,7 @@
 ble_ota_t      m_ota;
 static void on_ota_connect(ble_ota_t * p_ota, ble_evt_t * p_ble_evt)
 {
-    p_ota->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+    UNUSED_PARAMETER(p_ble_evt);
 	ota_connection();
 }
 
@@ -83,6 +83,14 @@ static void on_ota_write(ble_ota_t * p_ota, ble_evt_t * p_ble_evt)
 {
     ble_gatts_evt_write_t * p_evt_write = &p_ble_evt->evt.gatts_evt.params.write;
 
+    // The first link writing to the service owns the OTA session until it disconnects.
+    if((p_evt_write->handle == p_ota->write_wirsp_handle.value_handle) ||
+       (p_evt_write->handle == p_ota->write_worsp_handle.value_handle) ||
+       (p_evt_write->handle == p_ota->indicate_handle.cccd_handle))
+    {
+        p_ota->conn_handle = p_ble_evt->evt.gatts_evt.conn_handle;
+    }
+
     if(p_evt_write->handle == p_ota->write_wirsp_handle.value_handle)
     {
         wirsp_on_value_write(p_ota,p_evt_write);
@@ -314,6 +322,13 @@ void ble_ota_on_ble_evt(ble_ota_t * p_ota, ble_evt_t * p_ble_evt)
         return;
     }
 
+    // One OTA session at a time, events of the other link are ignored.
+    if((p_ota->conn_handle != BLE_CONN_HANDLE_INVALID) &&
+       (p_ota->conn_handle != p_ble_evt->evt.gap_evt.conn_handle))
+    {
+        return;
+    }
+
     switch(p_ble_evt->header.evt_id)
     {
         case BLE_GAP_EVT_CONNECTED:
@@ -63,7 +63,7 @@ typedef struct ble_ota_s
     ble_gatts_char_handles_t indicate_handle;             /**< Handles related to the TX characteristic. (as provided by the S110 SoftDevice)*/
     ble_gatts_char_handles_t write_wirsp_handle;          /**< Handles related to the RX characteristic. (as provided by the S110 SoftDevice)*/
     ble_gatts_char_handles_t write_worsp_handle;          /**< Handles related to the RX characteristic. (as provided by the S110 SoftDevice)*/
-    uint16_t                 conn_handle;                 /**< Handle of the current connection (as provided by the S110 SoftDevice). This will be BLE_CONN_HANDLE_INVALID if not in a connection. */
+    uint16_t                 conn_handle;                 /**< Link that owns the OTA session, set on its first write to the service. BLE_CONN_HANDLE_INVALID if no link has written yet. */
     ble_ota_evt_handler_t evt_handler;                 /**< Event handler to be called for confirm data received. */
 } ble_ota_t;
 
@@ -24,14 +24,15 @@ static uint8_t uuid_index = 0;
 
 static void on_trans_connect(ble_trans_t * p_trans, ble_evt_t * p_ble_evt)
 {
-    p_trans->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+    UNUSED_PARAMETER(p_ble_evt);
+    p_trans->notification_enabled[link_current()] = 0;
 	transfer_connection();
 }
 
 static void on_trans_disconnect(ble_trans_t * p_trans, ble_evt_t * p_ble_evt)
 {
     UNUSED_PARAMETER(p_ble_evt);
-    p_trans->conn_handle = BLE_CONN_HANDLE_INVALID;
+    p_trans->notification_enabled[link_current()] = 0;
 	transfer_disconnection();
 }
 
@@ -46,6 +47,7 @@ static void trans_notify_on_cccd_write(ble_trans_t * p_trans, ble_gatts_evt_writ
     {
         // CCCD written, update notify state
         uint8_t len = sizeof(p_trans->notify_handles)/sizeof(p_trans->notify_handles[0]);
+        uint16_t * p_enabled = &p_trans->notification_enabled[link_current()];
         for(uint8_t i=0;i<len;i++)
         {
             if (p_evt_write->handle == p_trans->notify_handles[i].cccd_handle)
@@ -54,11 +56,11 @@ static void trans_notify_on_cccd_write(ble_trans_t * p_trans, ble_gatts_evt_writ
                 val = val << i;
                 if (ble_srv_is_notification_enabled(p_evt_write->data))
                 {
-                    p_trans->notification_enabled |= val;
+                    *p_enabled |= val;
                 }
                 else
                 {
-                    p_trans->notification_enabled &= (~val);
+                    *p_enabled &= (~val);
                 }
             }
         }
@@ -331,11 +333,22 @@ static uint32_t notify_char_add(ble_trans_t * p_trans, const ble_trans_init_t *
 
 void ble_trans_on_ble_evt(ble_trans_t * p_trans, ble_evt_t * p_ble_evt)
 {
+    uint8_t link;
+    uint8_t prev;
+
     if ((p_trans == NULL) || (p_ble_evt == NULL))
     {
         return;
     }
 
+    // The connection handle leads both the GAP and the GATTS events.
+    link = link_index(p_ble_evt->evt.gap_evt.conn_handle);
+    if (link >= LINK_MAX)
+    {
+        return;
+    }
+    prev = link_select(link);
+
     switch (p_ble_evt->header.evt_id)
     {
         case BLE_GAP_EVT_CONNECTED:
@@ -358,6 +371,8 @@ void ble_trans_on_ble_evt(ble_trans_t * p_trans, ble_evt_t * p_ble_evt)
             // No implementation needed.
             break;
     }
+
+    (void)link_select(prev);
 }
 
 
@@ -373,10 +388,9 @@ uint32_t ble_trans_init(ble_trans_t * p_trans, const ble_trans_init_t * p_trans_
     }
     
     // Initialize service structure.
-    p_trans->conn_handle              = BLE_CONN_HANDLE_INVALID;
     p_trans->evt_handler              = p_trans_init->evt_handler;
     
-    p_trans->notification_enabled     = 0;
+    memset(p_trans->notification_enabled, 0, sizeof(p_trans->notification_enabled));
 
     /**@snippet [Adding proprietary Service to S110 SoftDevice] */
 	ble_uuid.type = BLE_UUID_TYPE_BLE;
@@ -422,7 +436,7 @@ uint32_t ble_trans_init(ble_trans_t * p_trans, const ble_trans_init_t * p_trans_
 }
 
 
-uint32_t ble_trans_notify_send(ble_trans_t * p_trans, uint8_t chnl, uint8_t * string)
+uint32_t ble_trans_notify_send(ble_trans_t * p_trans, uint16_t conn_handle, uint8_t chnl, uint8_t * string)
 {
     uint16_t len = 0;
     ble_gatts_hvx_params_t hvx_params;
@@ -431,8 +445,8 @@ uint32_t ble_trans_notify_send(ble_trans_t * p_trans, uint8_t chnl, uint8_t * st
         return NRF_ERROR_NULL;
     }
 
-    uint8_t is_notify = (p_trans->notification_enabled >> chnl) & 0x01;
-    if ((p_trans->conn_handle == BLE_CONN_HANDLE_INVALID) || (is_notify == 0))
+    uint8_t link = link_index(conn_handle);
+    if ((link >= LINK_MAX) || (((p_trans->notification_enabled[link] >> chnl) & 0x01) == 0))
     {
         return NRF_ERROR_INVALID_STATE;
     }
@@ -445,10 +459,10 @@ uint32_t ble_trans_notify_send(ble_trans_t * p_trans, uint8_t chnl, uint8_t * st
     hvx_params.p_len  = &len;
     hvx_params.type   = BLE_GATT_HVX_NOTIFICATION;
     
-    return sd_ble_gatts_hvx(p_trans->conn_handle, &hvx_params);
+    return sd_ble_gatts_hvx(conn_handle, &hvx_params);
 }
 
-uint32_t ble_trans_indicate_send(ble_trans_t * p_trans, uint8_t * string)
+uint32_t ble_trans_indicate_send(ble_trans_t * p_trans, uint16_t conn_handle, uint8_t * string)
 {
     uint16_t len = 0;
     ble_gatts_hvx_params_t hvx_params;
@@ -457,7 +471,7 @@ uint32_t ble_trans_indicate_send(ble_trans_t * p_trans, uint8_t * string)
         return NRF_ERROR_NULL;
     }
     
-    if (p_trans->conn_handle == BLE_CONN_HANDLE_INVALID)
+    if (conn_handle == BLE_CONN_HANDLE_INVALID)
     {
         return NRF_ERROR_INVALID_STATE;
     }
@@ -470,7 +484,7 @@ uint32_t ble_trans_indicate_send(ble_trans_t * p_trans, uint8_t * string)
     hvx_params.p_len  = &len;
     hvx_params.type   = BLE_GATT_HVX_INDICATION;
     
-    return sd_ble_gatts_hvx(p_trans->conn_handle, &hvx_params);
+    return sd_ble_gatts_hvx(conn_handle, &hvx_params);
 }
 
 /**@brief    Function for handling the indicate from the transfer Service.
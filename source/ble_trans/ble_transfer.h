@@ -17,6 +17,7 @@
 #include "ble_srv_common.h"
 #include <stdint.h>
 #include <stdbool.h>
+#include "channel_select.h"
 
 #define BLE_TRANS_MAX_DATA_LEN            (GATT_MTU_SIZE_DEFAULT - 3)  /**< Maximum length of data (in bytes) that can be transmitted by the Nordic UART service module to the peer. */
 
@@ -66,8 +67,7 @@ typedef struct ble_trans_s
     ble_gatts_char_handles_t indicate_handle;             /**< Handles related to the TX characteristic. (as provided by the S110 SoftDevice)*/
     ble_gatts_char_handles_t write_handle;                /**< Handles related to the RX characteristic. (as provided by the S110 SoftDevice)*/
     ble_gatts_char_handles_t notify_handles[6];           /**< Handles related to the RX characteristic. (as provided by the S110 SoftDevice)*/
-    uint16_t                 notification_enabled;        /**< Variable to indicate if the peer has enabled notification of the RX characteristic.*/
-	uint16_t                 conn_handle;                 /**< Handle of the current connection (as provided by the S110 SoftDevice). This will be BLE_CONN_HANDLE_INVALID if not in a connection. */
+    uint16_t                 notification_enabled[LINK_MAX]; /**< Notify characteristics enabled by the peer of each link, one bit per characteristic. */
     ble_trans_evt_handler_t  evt_handler;                 /**< Event handler to be called for confirm data received. */
 } ble_trans_t;
 extern ble_trans_t    m_trans;
@@ -89,7 +89,8 @@ uint32_t ble_trans_init(ble_trans_t * p_trans, const ble_trans_init_t * p_trans_
  * @details     The transfer service expects the application to call this function each time an
  *              event is received from the S110 SoftDevice. This function processes the event if it
  *              is relevant for it and calls the Nordic UART Service event handler of the
- *              application if necessary.
+ *              application if necessary. The link of the event is selected while it is handled,
+ *              see @ref link_select.
  *
  * @param[in]   p_trans    transfer Service structure.
  * @param[in]   p_ble_evt  Event received from the S110 SoftDevice.
@@ -102,8 +103,9 @@ void ble_trans_on_ble_evt(ble_trans_t * p_trans, ble_evt_t * p_ble_evt);
  *              peer.
   *
  * @param[in]   p_trans          Pointer to the Nordic UART Service structure.
- * @param[in]   string         String to be sent.
- * @param[in]   length         Length of string.
+ * @param[in]   conn_handle    Link to send on.
+ * @param[in]   chnl           Notify characteristic to send on.
+ * @param[in]   string         String to be sent, 20 bytes.
  *
  * @return      NRF_SUCCESS if the DFU Service has successfully requested the S110 SoftDevice to
  *              send the notification. Otherwise an error code.
@@ -111,9 +113,9 @@ void ble_trans_on_ble_evt(ble_trans_t * p_trans, ble_evt_t * p_ble_evt);
  *              peer or if the notification of the RX characteristic was not enabled by the peer.
  *              It returns NRF_ERROR_NULL if the pointer p_trans is NULL.
  */
-uint32_t ble_trans_notify_send(ble_trans_t * p_trans, uint8_t chnl, uint8_t * string);
+uint32_t ble_trans_notify_send(ble_trans_t * p_trans, uint16_t conn_handle, uint8_t chnl, uint8_t * string);
 
-uint32_t ble_trans_indicate_send(ble_trans_t * p_trans, uint8_t * string);
+uint32_t ble_trans_indicate_send(ble_trans_t * p_trans, uint16_t conn_handle, uint8_t * string);
 
 void on_trans_evt(ble_trans_t * p_trans, ble_trans_evt_t *p_evt);
 #endif // BLE_TRANS_H__
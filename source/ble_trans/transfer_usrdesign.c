@@ -11,25 +11,27 @@
 #include "app_trans.h"
 #include "debug.h"
 #include "usr_design.h"
+#include "channel_select.h"
 
 #define TRANS_PACKAGE_HEAP_SIZE		(4)
 
 #if DATA_TYPE == DATA_POINTER_TYPE
-uint8_t g_trans_common_tx_buffer[TRANS_TX_SIZE];
-uint8_t g_trans_common_rx_buffer[TRANS_RX_SIZE];
+uint8_t g_trans_common_tx_buffer[LINK_MAX][TRANS_TX_SIZE];
+uint8_t g_trans_common_rx_buffer[LINK_MAX][TRANS_RX_SIZE];
 #endif
 
-static trans_receive_pack_st g_receive_st = {0};
-static trans_send_pack_st g_send_st = {0};
+//ÿһշ״̬, ±channel_selectlinkһ
+static trans_receive_pack_st g_receive_st[LINK_MAX] = {0};
+static trans_send_pack_st g_send_st[LINK_MAX] = {0};
 
-static uint32_t transfer_indicate_send(uint8_t *data,uint16_t length)
+static uint32_t transfer_indicate_send(uint16_t conn_handle,uint8_t *data,uint16_t length)
 {
-	return ble_trans_indicate_send(&m_trans, data);
+	return ble_trans_indicate_send(&m_trans, conn_handle, data);
 }
 
-static uint32_t transfer_notify_send(uint8_t *data,uint16_t length,uint8_t chnl)
+static uint32_t transfer_notify_send(uint16_t conn_handle,uint8_t *data,uint16_t length,uint8_t chnl)
 {
-	return ble_trans_notify_send(&m_trans, chnl, data);
+	return ble_trans_notify_send(&m_trans, conn_handle, chnl, data);
 }
 
 /*****************************************************************************
@@ -48,88 +50,94 @@ static uint32_t transfer_notify_send(uint8_t *data,uint16_t length,uint8_t chnl)
 static uint8_t transfer_receive_parse(uint8_t *data,uint16_t length)
 {
 	uint8_t framelen = 0,offset = 0;
+	uint8_t link = link_current();
+	trans_receive_pack_st *p_rx = &g_receive_st[link];
 	
-	if(g_receive_st.rec_flg == TRANS_RECEIVE_ED)
+	if(p_rx->rec_flg == TRANS_RECEIVE_ED)
 	{
 		if(*data & 0x80)
 		{
-			g_receive_st.package_i 		= (*data & 0x7F);
-			g_receive_st.package_i 		<<= 8;
-			g_receive_st.package_i 		+= *(data+1);
-			g_receive_st.package_len 	= *(data+2);
-			g_receive_st.frame_i 		= *(data+3);
+			p_rx->package_i 		= (*data & 0x7F);
+			p_rx->package_i 		<<= 8;
+			p_rx->package_i 		+= *(data+1);
+			p_rx->package_len 	= *(data+2);
+			p_rx->frame_i 		= *(data+3);
 
-			g_receive_st.data_len		= length - 4;
+			p_rx->data_len		= length - 4;
 
-			if(g_receive_st.data_len > g_receive_st.package_len)
-				g_receive_st.data_len = g_receive_st.package_len;
+			if(p_rx->data_len > p_rx->package_len)
+				p_rx->data_len = p_rx->package_len;
 			
-			if(g_receive_st.package_len > TRANS_RECEIVE_DATA_SIZE)
-				g_receive_st.package_len = TRANS_RECEIVE_DATA_SIZE;
+			if(p_rx->package_len > TRANS_RECEIVE_DATA_SIZE)
+				p_rx->package_len = TRANS_RECEIVE_DATA_SIZE;
 			
 			#if DATA_TYPE == DATA_BUFFER_TYPE			
-			memset(g_receive_st.data, 0, sizeof(g_receive_st.data)); 
-        	memcpy(g_receive_st.data, data + TRANS_PACKAGE_HEAP_SIZE, g_receive_st.data_len); 
+			memset(p_rx->data, 0, sizeof(p_rx->data)); 
+        	memcpy(p_rx->data, data + TRANS_PACKAGE_HEAP_SIZE, p_rx->data_len); 
         	#elif DATA_TYPE == DATA_POINTER_TYPE
-			if(g_receive_st.data_len > TRANS_RX_SIZE)
-				g_receive_st.data_len = TRANS_RX_SIZE;
-			memset(&g_trans_common_rx_buffer[TRANS_RX_START_ADDR], 0, TRANS_RX_SIZE); 
-        	memcpy(&g_trans_common_rx_buffer[TRANS_RX_START_ADDR], data + TRANS_PACKAGE_HEAP_SIZE, g_receive_st.data_len);
-			g_receive_st.data = &(g_trans_common_rx_buffer[TRANS_RX_START_ADDR]);
+			if(p_rx->data_len > TRANS_RX_SIZE)
+				p_rx->data_len = TRANS_RX_SIZE;
+			memset(&g_trans_common_rx_buffer[link][TRANS_RX_START_ADDR], 0, TRANS_RX_SIZE); 
+        	memcpy(&g_trans_common_rx_buffer[link][TRANS_RX_START_ADDR], data + TRANS_PACKAGE_HEAP_SIZE, p_rx->data_len);
+			p_rx->data = &(g_trans_common_rx_buffer[link][TRANS_RX_START_ADDR]);
 			#endif
 
-			g_receive_st.rec_flg = TRANS_RECEIVE_ING;
+			p_rx->rec_flg = TRANS_RECEIVE_ING;
 		}
 		else
 			return 3;
 	}
-	else if(g_receive_st.rec_flg == TRANS_RECEIVE_ING)
+	else if(p_rx->rec_flg == TRANS_RECEIVE_ING)
 	{
-		g_receive_st.frame_i = *data;                        // ֡
+		p_rx->frame_i = *data;                        // ֡
         framelen = (length - 1);                     // һ֡ݵĳ
-        offset = 16 + (g_receive_st.frame_i - 1) * 19; // bufferƫƵַ
+        offset = 16 + (p_rx->frame_i - 1) * 19; // bufferƫƵַ
 
-        if(g_receive_st.frame_i > TRANS_DEF_MAX_FRAME_SIZE) // ֡ųһ֡buffer½
+        if(p_rx->frame_i > TRANS_DEF_MAX_FRAME_SIZE) // ֡ųһ֡buffer½
         {
-            g_receive_st.data_len = 0; // սճ
-            g_receive_st.package_len = 0;
-            memset(g_receive_st.data, 0, sizeof(g_receive_st.data)); // buffer
-            g_receive_st.rec_flg = 0;
+            p_rx->data_len = 0; // սճ
+            p_rx->package_len = 0;
+            memset(p_rx->data, 0, sizeof(p_rx->data)); // buffer
+            p_rx->rec_flg = 0;
 			return 2;
         }
 
-        if((g_receive_st.data_len + framelen) > g_receive_st.package_len) // ݳȳǰȣض϶
+        if((p_rx->data_len + framelen) > p_rx->package_len) // ݳȳǰȣض϶
         {
-            framelen = g_receive_st.package_len - g_receive_st.data_len;
+            framelen = p_rx->package_len - p_rx->data_len;
         }
-        g_receive_st.data_len += framelen;
-        memcpy(&g_receive_st.data[offset], data + 1, framelen); // 
+        p_rx->data_len += framelen;
+        memcpy(&p_rx->data[offset], data + 1, framelen); // 
 	}
 
 	// жϵǰǷ
-    if(g_receive_st.data_len < g_receive_st.package_len)
+    if(p_rx->data_len < p_rx->package_len)
     {
         return 1;
     }
 	else
 	{
-		g_receive_st.rec_flg = TRANS_RECEIVE_ED;
+		p_rx->rec_flg = TRANS_RECEIVE_ED;
 		return 0;
 	}	
 }
 
 void transfer_connection(void)
 {
-	memset(&g_send_st, 0, sizeof(g_send_st));
-	memset(&g_receive_st, 0, sizeof(g_receive_st));
+	uint8_t link = link_current();
+
+	memset(&g_send_st[link], 0, sizeof(trans_send_pack_st));
+	memset(&g_receive_st[link], 0, sizeof(trans_receive_pack_st));
 
 	app_trans_connection();
 }
 
 void transfer_disconnection(void)
 {
-	memset(&g_send_st, 0, sizeof(g_send_st));
-	memset(&g_receive_st, 0, sizeof(g_receive_st));
+	uint8_t link = link_current();
+
+	memset(&g_send_st[link], 0, sizeof(trans_send_pack_st));
+	memset(&g_receive_st[link], 0, sizeof(trans_receive_pack_st));
 
 	app_trans_disconnection();
 }
@@ -138,7 +146,7 @@ void trans_indicate_statue_set(ble_trans_evt_type_t statue)
 	app_trans_indicate_statue_set(statue);
 
 	if(statue == BLE_TRANS_EVT_INDICATION_CONFIRMED)
-		g_send_st.indicate_available_flg = 0;
+		g_send_st[link_current()].indicate_available_flg = 0;
 }
 
 /*****************************************************************************
@@ -157,10 +165,12 @@ void trans_indicate_statue_set(ble_trans_evt_type_t statue)
 uint32_t transfer_receive(uint8_t *data,uint16_t length)
 {
 	uint32_t error = 0;
+	trans_receive_pack_st *p_rx = &g_receive_st[link_current()];
+
 	error = transfer_receive_parse(data,length);
 	if(error == 0)
 	{
-		app_trans_receive(g_receive_st.data,g_receive_st.data_len);
+		app_trans_receive(p_rx->data,p_rx->data_len);
 	}
 	else
 	{
@@ -186,6 +196,8 @@ uint32_t transfer_receive(uint8_t *data,uint16_t length)
 uint32_t transfer_send_data(uint8_t *data,uint16_t length,trans_channel_enum channel_type,uint8_t channel)
 {
 	uint32_t error = 0,i = 0;
+	uint8_t link = link_current();
+	trans_send_pack_st *p_tx = &g_send_st[link];
 
 	if(length > TRANS_SEND_DATA_SIZE)
 		length = TRANS_SEND_DATA_SIZE;
@@ -193,78 +205,101 @@ uint32_t transfer_send_data(uint8_t *data,uint16_t length,trans_channel_enum cha
 	if(channel_type >= TRANS_CHANNEL_MAX)
 		return 1;
 
-	if(g_send_st.send_flg)//ϴΪ
+	if(p_tx->send_flg)//ϴΪ
 		return 2;
 
 	#if DATA_TYPE == DATA_BUFFER_TYPE
-	memset(g_send_st.data,0,TRANS_SEND_DATA_SIZE);
+	memset(p_tx->data,0,TRANS_SEND_DATA_SIZE);
 	
 	for(i=0;i<length;i++)
-		g_send_st.data[i] = data[i];
+		p_tx->data[i] = data[i];
 	#elif DATA_TYPE == DATA_POINTER_TYPE
-	memset(&g_trans_common_tx_buffer[TRANS_TX_START_ADDR], 0, TRANS_TX_SIZE);
+	memset(&g_trans_common_tx_buffer[link][TRANS_TX_START_ADDR], 0, TRANS_TX_SIZE);
 	for(i=0;i<length;i++)
-		g_trans_common_tx_buffer[TRANS_TX_START_ADDR+i] = data[i];
-	g_send_st.data = &g_trans_common_tx_buffer[TRANS_TX_START_ADDR];
+		g_trans_common_tx_buffer[link][TRANS_TX_START_ADDR+i] = data[i];
+	p_tx->data = &g_trans_common_tx_buffer[link][TRANS_TX_START_ADDR];
 	#endif
 	
-	g_send_st.send_index 	= 0;
-	g_send_st.data_len 		= length;
-	g_send_st.channel_type 	= channel_type;
-	g_send_st.channel 		= channel;
-	g_send_st.send_flg 		= 1;
+	p_tx->send_index 	= 0;
+	p_tx->data_len 		= length;
+	p_tx->channel_type 	= channel_type;
+	p_tx->channel 		= channel;
+	p_tx->send_flg 		= 1;
 	
 	return error;
 }
 
-/*****************************************************************************
- *    : transfer_periodic_send_data
- *  : 
- *  : void  void
- *  : void
- *   ֵ : 	0:ɻûݷ		
- 				1:ݷ
- * ޸ʷ : 
- * ˵     : A500 1ݷֶ֡ͣÿ֡20bytemainloopѭ淢
-*****************************************************************************/
-uint8_t transfer_periodic_send_data(void)
+static uint8_t transfer_link_send_data(uint8_t link)
 {
-	uint32_t error;
+	uint32_t error = NRF_SUCCESS;
 	uint16_t length = 0;
+	uint16_t conn_handle = link_conn_handle(link);
+	trans_send_pack_st *p_tx = &g_send_st[link];
+
+	if(conn_handle == BLE_CONN_HANDLE_INVALID)
+	{
+		p_tx->send_flg = 0;
+		return 0;
+	}
 	
-	if(g_send_st.send_flg == 1 && g_send_st.channel_type < TRANS_CHANNEL_MAX)
+	if(p_tx->send_flg == 1 && p_tx->channel_type < TRANS_CHANNEL_MAX)
 	{
-		length = g_send_st.data_len - g_send_st.send_index;
+		length = p_tx->data_len - p_tx->send_index;
 		if(length > 20)
 		{
 			length = 20;
 		}
 		
-		if(g_send_st.channel_type == TRANS_INDICATE_CHANNEL)
+		if(p_tx->channel_type == TRANS_INDICATE_CHANNEL)
 		{
-			if(g_send_st.indicate_available_flg == 0)
+			if(p_tx->indicate_available_flg == 0)
 			{
-				g_send_st.indicate_available_flg = 1;
-				error = transfer_indicate_send(&g_send_st.data[g_send_st.send_index],length);
+				p_tx->indicate_available_flg = 1;
+				error = transfer_indicate_send(conn_handle,&p_tx->data[p_tx->send_index],length);
 			}
 			else
-				error = g_send_st.indicate_available_flg;//incadicate is busy!!!
+				error = p_tx->indicate_available_flg;//incadicate is busy!!!
 		}
-		else if(g_send_st.channel_type == TRANS_NOTIFI_CHANNEL)
+		else if(p_tx->channel_type == TRANS_NOTIFI_CHANNEL)
 		{
-			error = transfer_notify_send(&g_send_st.data[g_send_st.send_index],length,g_send_st.channel);
+			error = transfer_notify_send(conn_handle,&p_tx->data[p_tx->send_index],length,p_tx->channel);
 		}
 
 		if(error == NRF_SUCCESS)
 		{
-			g_send_st.send_index += length;
-			if(g_send_st.send_index >= g_send_st.data_len)
+			p_tx->send_index += length;
+			if(p_tx->send_index >= p_tx->data_len)
 			{
-				g_send_st.send_flg = 0;
+				p_tx->send_flg = 0;
 			}
-			QPRINTF("transfer:send_index=%d,\r\n",g_send_st.send_index);
+			QPRINTF("transfer:link=%d,send_index=%d,\r\n",link,p_tx->send_index);
 		}
 	}
-	return g_send_st.send_flg;
+	return p_tx->send_flg;
+}
+
+/*****************************************************************************
+ *    : transfer_periodic_send_data
+ *  : 
+ *  : void  void
+ *  : void
+ *   ֵ : 	0:ɻûݷ		
+ 				1:ݷ
+ * ޸ʷ : 
+ * ˵     : A500 1ݷֶ֡ͣÿ֡20bytemainloopѭ淢
+ 				ÿÿ෢һ֡ʼֻһӵĳݲռһ
+*****************************************************************************/
+uint8_t transfer_periodic_send_data(void)
+{
+	static uint8_t first = 0;
+	uint8_t i,statue = 0;
+
+	for(i=0;i<LINK_MAX;i++)
+	{
+		statue |= transfer_link_send_data((first + i) % LINK_MAX);
+	}
+	first = (first + 1) % LINK_MAX;
+
+	return statue;
 }
 
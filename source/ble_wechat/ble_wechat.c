@@ -23,6 +23,7 @@
 #include "app_util.h"
 #include "debug.h"
 #include "wechat_usrdesign.h"
+#include "channel_select.h"
 
 
 ble_wechat_t   m_wechat;
@@ -38,7 +39,7 @@ extern ble_gap_addr_t device_mac;
  */
 static void wechat_on_connect(ble_wechat_t * p_wechat, ble_evt_t * p_ble_evt)
 {
-    p_wechat->conn_handle = p_ble_evt->evt.gatts_evt.conn_handle;
+    UNUSED_PARAMETER(p_ble_evt);
 	wechat_connection();
 }
 
@@ -51,7 +52,6 @@ static void wechat_on_connect(ble_wechat_t * p_wechat, ble_evt_t * p_ble_evt)
 static void wechat_on_disconnect(ble_wechat_t * p_wechat, ble_evt_t * p_ble_evt)
 {
     UNUSED_PARAMETER(p_ble_evt);
-    p_wechat->conn_handle = BLE_CONN_HANDLE_INVALID;
 	wechat_disconnection();
 }
 
@@ -323,7 +323,6 @@ uint32_t ble_wechat_init(ble_wechat_t * p_wechat, const ble_wechat_init_t * p_we
 
     // Initialize service structure
     p_wechat->evt_handler = p_wechat_init->evt_handler;
-    p_wechat->conn_handle = BLE_CONN_HANDLE_INVALID;
 
 
     // Add service
@@ -364,17 +363,18 @@ uint32_t ble_wechat_init(ble_wechat_t * p_wechat, const ble_wechat_init_t * p_we
  *     : ble_wechat_indicate_send
  *   : ΢ŷindicateͨ
  *   : p_wechat    wechat Service structure.
+ * 				 conn_handle --͵
  * 				 data --跢͵
  *   : 
  *   ֵ  : 
 
 *****************************************************************************/
-uint32_t ble_wechat_indicate_send(ble_wechat_t * p_wechat, uint8_t *data)
+uint32_t ble_wechat_indicate_send(ble_wechat_t * p_wechat, uint16_t conn_handle, uint8_t *data)
 {
     uint32_t err_code;
  
     // Send value if connected
-    if (p_wechat->conn_handle != BLE_CONN_HANDLE_INVALID)
+    if (conn_handle != BLE_CONN_HANDLE_INVALID)
     {
         uint16_t               len;
         uint16_t               hvx_len;
@@ -392,7 +392,7 @@ uint32_t ble_wechat_indicate_send(ble_wechat_t * p_wechat, uint8_t *data)
         hvx_params.p_len  = &hvx_len;
         hvx_params.p_data = data;
         
-        err_code = sd_ble_gatts_hvx(p_wechat->conn_handle, &hvx_params);
+        err_code = sd_ble_gatts_hvx(conn_handle, &hvx_params);
         if ((err_code == NRF_SUCCESS) && (hvx_len != len))
         {
             err_code = NRF_ERROR_DATA_SIZE;
@@ -417,6 +417,16 @@ uint32_t ble_wechat_indicate_send(ble_wechat_t * p_wechat, uint8_t *data)
 *****************************************************************************/
 void ble_wechat_on_ble_evt(ble_wechat_t * p_wechat, ble_evt_t * p_ble_evt)
 {
+    uint8_t link;
+    uint8_t prev;
+
+    link = link_index(p_ble_evt->evt.gap_evt.conn_handle);
+    if (link >= LINK_MAX)
+    {
+        return;
+    }
+    prev = link_select(link);
+
     switch (p_ble_evt->header.evt_id)
     {
         case BLE_GAP_EVT_CONNECTED:
@@ -441,6 +451,8 @@ void ble_wechat_on_ble_evt(ble_wechat_t * p_wechat, ble_evt_t * p_ble_evt)
             // No implementation needed.
             break;
     }
+
+    (void)link_select(prev);
 }
 
 /**@brief Function for handling the wechat Service events.
@@ -85,7 +85,6 @@ typedef struct ble_wechat_s
     ble_gatts_char_handles_t     write_handles;                              /**< Handles related to the Wechat Write characteristic. */
     ble_gatts_char_handles_t     indicate_handles;                           /**< Handles related to the Wechat Indicate characteristic. */
     ble_gatts_char_handles_t     read_handles;                           		/**< Handles related to the Wechat Read characteristic. */
-    uint16_t                     conn_handle;                               /**< Handle of the current connection (as provided by the BLE stack, is BLE_CONN_HANDLE_INVALID if not in a connection). */
     uint8_t                      *data;                                   	/**< Value of read. */
 } ble_wechat_t;
 
@@ -99,6 +98,6 @@ extern ble_wechat_t   m_wechat;
 uint32_t ble_wechat_init(ble_wechat_t * p_wechat, const ble_wechat_init_t * p_wechat_init);
 void ble_wechat_on_ble_evt(ble_wechat_t * p_wechat, ble_evt_t * p_ble_evt);
 
-uint32_t ble_wechat_indicate_send(ble_wechat_t * p_wechat, uint8_t *data);
+uint32_t ble_wechat_indicate_send(ble_wechat_t * p_wechat, uint16_t conn_handle, uint8_t *data);
 void on_wechat_evt(ble_wechat_t * p_wechat, ble_wechat_evt_t *p_evt);
 #endif // BLE_BPS_H__
@@ -12,21 +12,94 @@
 #include "ble_wechat.h"
 #include "app_wechat.h"
 #include "debug.h"
+#include "channel_select.h"
+#include "app_wechat_common.h"
+#include "aes_session.h"
 #define WECHAT_PACKAGE_HEAP_SIZE		(8)
 
 #if DATA_TYPE == DATA_POINTER_TYPE
-uint8_t g_wechat_common_tx_buffer[WECHAT_TX_SIZE];
-uint8_t g_wechat_common_rx_buffer[WECHAT_RX_SIZE];
+uint8_t g_wechat_common_tx_buffer[LINK_MAX][WECHAT_TX_SIZE];
+uint8_t g_wechat_common_rx_buffer[LINK_MAX][WECHAT_RX_SIZE];
 #endif
-static wechat_receive_pack_st g_receive_st = {0};
-static wechat_send_pack_st g_send_st = {0};
+//ÿһշ״̬, ±channel_selectlinkһ
+static wechat_receive_pack_st g_receive_st[LINK_MAX] = {0};
+static wechat_send_pack_st g_send_st[LINK_MAX] = {0};
+static uint8_t m_session_iv[AES_SESSION_BLOCK_SIZE];		//AirSyncûỰԿIV
 
-static uint32_t wechat_indicate_send(uint8_t *data,uint16_t length)
+static uint16_t wechat_pack_cmd(const uint8_t *pack)
 {
-	return ble_wechat_indicate_send(&m_wechat, data);
+	return ((uint16_t)pack[4] << 8) | pack[5];
 }
 
-static uint32_t wechat_notify_send(uint8_t *data,uint16_t length,uint8_t chnl)
+/*****************************************************************************
+ *    : wechat_body_encrypt
+ *  : лỰԿʱѰͷ֮İAES-CBC
+ *  : uint8_t *pack        , ͷǰ
+               uint16_t *p_length  , ؼܺĳ
+               uint16_t size       packĴС
+ *  : 
+ *   ֵ : NRF_SUCCESS, NRF_ERROR_NO_MEM:Ų
+ * ޸ʷ : 
+ * ˵     : PKCS#7, ͷĳȸĳɼܺ. ¼Կ֮ǰ, 
+*****************************************************************************/
+static uint32_t wechat_body_encrypt(uint8_t *pack,uint16_t *p_length,uint16_t size)
+{
+	uint8_t iv[AES_SESSION_BLOCK_SIZE];
+	uint16_t body_len;
+	uint32_t error;
+
+	if(!aes_session_key_valid() || *p_length < WECHAT_PACKAGE_HEAP_SIZE || wechat_pack_cmd(pack) == WECHAT_CMDID_REQ_ENTRY)
+		return NRF_SUCCESS;
+
+	memcpy(iv,m_session_iv,sizeof(iv));
+	error = aes_session_cbc_pad_encrypt(iv,pack + WECHAT_PACKAGE_HEAP_SIZE,*p_length - WECHAT_PACKAGE_HEAP_SIZE,
+										size - WECHAT_PACKAGE_HEAP_SIZE,&body_len);
+	if(error != NRF_SUCCESS)
+		return error;
+
+	*p_length = body_len + WECHAT_PACKAGE_HEAP_SIZE;
+	pack[2] = (uint8_t)(*p_length >> 8);
+	pack[3] = (uint8_t)(*p_length);
+	return NRF_SUCCESS;
+}
+
+//¼ظԿ, ; Ҫ, ܺȥ
+static uint32_t wechat_body_decrypt(wechat_receive_pack_st *p_rx)
+{
+	uint8_t iv[AES_SESSION_BLOCK_SIZE];
+	uint16_t body_len;
+	uint32_t error;
+
+	if(!aes_session_key_valid() || p_rx->cmd_no == WECHAT_CMDID_RESQ_ENTRY)
+		return NRF_SUCCESS;
+
+	memcpy(iv,m_session_iv,sizeof(iv));
+	error = aes_session_cbc_pad_decrypt(iv,p_rx->data,p_rx->data_len,&body_len);
+	if(error != NRF_SUCCESS)
+		return error;
+
+	p_rx->data_len = (uint8_t)body_len;
+	return NRF_SUCCESS;
+}
+
+void wechat_session_key_set(const uint8_t *key)
+{
+	memcpy(m_session_iv,key,AES_SESSION_KEY_SIZE);
+	aes_session_key_set(key);
+}
+
+void wechat_session_key_clear(void)
+{
+	memset(m_session_iv,0,sizeof(m_session_iv));
+	aes_session_key_clear();
+}
+
+static uint32_t wechat_indicate_send(uint16_t conn_handle,uint8_t *data,uint16_t length)
+{
+	return ble_wechat_indicate_send(&m_wechat, conn_handle, data);
+}
+
+static uint32_t wechat_notify_send(uint16_t conn_handle,uint8_t *data,uint16_t length,uint8_t chnl)
 {
 	return 0;
 }
@@ -46,80 +119,86 @@ static uint32_t wechat_notify_send(uint8_t *data,uint16_t length,uint8_t chnl)
 static uint8_t wechat_receive_parse(uint8_t *data,uint16_t length)
 {
 	uint8_t data_len = 0,offset = 0;
+	uint8_t link = link_current();
+	wechat_receive_pack_st *p_rx = &g_receive_st[link];
 	
-	if(g_receive_st.rec_flg == WECHAT_RECEIVE_ED)
+	if(p_rx->rec_flg == WECHAT_RECEIVE_ED)
 	{
 		if(*data == 0xFE && *(data+1) == 0x01)
 		{
-			g_receive_st.package_len 	= *(data+2);
-			g_receive_st.package_len 	<<= 8;
-			g_receive_st.package_len 	+= *(data+3);
-			g_receive_st.cmd_no 		= *(data+4);
-			g_receive_st.cmd_no 		<<= 8;
-			g_receive_st.cmd_no 		+= *(data+5);
-
-			g_receive_st.send_i 		= *(data+6);
-			g_receive_st.send_i 		<<= 8;
-			g_receive_st.send_i 		+= *(data+7);
-
-			g_receive_st.data_len		= length - WECHAT_PACKAGE_HEAP_SIZE;
+			p_rx->package_len 	= *(data+2);
+			p_rx->package_len 	<<= 8;
+			p_rx->package_len 	+= *(data+3);
+			p_rx->cmd_no 		= *(data+4);
+			p_rx->cmd_no 		<<= 8;
+			p_rx->cmd_no 		+= *(data+5);
+
+			p_rx->send_i 		= *(data+6);
+			p_rx->send_i 		<<= 8;
+			p_rx->send_i 		+= *(data+7);
+
+			p_rx->data_len		= length - WECHAT_PACKAGE_HEAP_SIZE;
 			
-			if(g_receive_st.package_len > WECHAT_RECEIVE_DATA_SIZE)
-				g_receive_st.package_len = WECHAT_RECEIVE_DATA_SIZE;
+			if(p_rx->package_len > WECHAT_RECEIVE_DATA_SIZE)
+				p_rx->package_len = WECHAT_RECEIVE_DATA_SIZE;
 
 			#if DATA_TYPE == DATA_BUFFER_TYPE
-			memset(g_receive_st.data, 0, sizeof(g_receive_st.data)); 
-        	memcpy(g_receive_st.data, data + WECHAT_PACKAGE_HEAP_SIZE, g_receive_st.data_len); 
+			memset(p_rx->data, 0, sizeof(p_rx->data)); 
+        	memcpy(p_rx->data, data + WECHAT_PACKAGE_HEAP_SIZE, p_rx->data_len); 
         	#elif DATA_TYPE == DATA_POINTER_TYPE
-			if(g_receive_st.data_len > WECHAT_RX_SIZE)
-				g_receive_st.data_len = WECHAT_RX_SIZE;
-			memset(&g_wechat_common_rx_buffer[WECHAT_RX_START_ADDR], 0, WECHAT_RX_SIZE); 
-        	memcpy(&g_wechat_common_rx_buffer[WECHAT_RX_START_ADDR], data + WECHAT_PACKAGE_HEAP_SIZE, g_receive_st.data_len);
-			g_receive_st.data = &(g_wechat_common_rx_buffer[WECHAT_RX_START_ADDR]);
+			if(p_rx->data_len > WECHAT_RX_SIZE)
+				p_rx->data_len = WECHAT_RX_SIZE;
+			memset(&g_wechat_common_rx_buffer[link][WECHAT_RX_START_ADDR], 0, WECHAT_RX_SIZE); 
+        	memcpy(&g_wechat_common_rx_buffer[link][WECHAT_RX_START_ADDR], data + WECHAT_PACKAGE_HEAP_SIZE, p_rx->data_len);
+			p_rx->data = &(g_wechat_common_rx_buffer[link][WECHAT_RX_START_ADDR]);
 			#endif
 			
-			g_receive_st.rec_flg = WECHAT_RECEIVE_ING;
+			p_rx->rec_flg = WECHAT_RECEIVE_ING;
 		}
 		else
 			return 3;
 	}
-	else if(g_receive_st.rec_flg == WECHAT_RECEIVE_ING)
+	else if(p_rx->rec_flg == WECHAT_RECEIVE_ING)
 	{
-        offset = g_receive_st.data_len; // bufferƫƵַ
+        offset = p_rx->data_len; // bufferƫƵַ
 		data_len = length;
 		
-        if((g_receive_st.data_len + length + WECHAT_PACKAGE_HEAP_SIZE) > g_receive_st.package_len) // ݳȳǰȣض϶
+        if((p_rx->data_len + length + WECHAT_PACKAGE_HEAP_SIZE) > p_rx->package_len) // ݳȳǰȣض϶
         {
-            data_len = g_receive_st.package_len - g_receive_st.data_len - WECHAT_PACKAGE_HEAP_SIZE;
+            data_len = p_rx->package_len - p_rx->data_len - WECHAT_PACKAGE_HEAP_SIZE;
         }
 		
-        g_receive_st.data_len += data_len;
-        memcpy(&g_receive_st.data[offset], data, data_len); //      
+        p_rx->data_len += data_len;
+        memcpy(&p_rx->data[offset], data, data_len); //      
 	}
 
 	// жϵǰǷ
-    if((g_receive_st.data_len+WECHAT_PACKAGE_HEAP_SIZE) < g_receive_st.package_len)
+    if((p_rx->data_len+WECHAT_PACKAGE_HEAP_SIZE) < p_rx->package_len)
     {
         return 1;
     }
 	else
 	{
-		g_receive_st.rec_flg = WECHAT_RECEIVE_ED;
+		p_rx->rec_flg = WECHAT_RECEIVE_ED;
 		return 0;
 	}	
 }
 
 void wechat_connection(void)
 {
-	memset(&g_send_st, 0, sizeof(g_send_st));
-	memset(&g_receive_st, 0, sizeof(g_receive_st));
+	uint8_t link = link_current();
+
+	memset(&g_send_st[link], 0, sizeof(wechat_send_pack_st));
+	memset(&g_receive_st[link], 0, sizeof(wechat_receive_pack_st));
 	app_wechat_connection();
 }
 
 void wechat_disconnection(void)
 {
-	memset(&g_send_st, 0, sizeof(g_send_st));
-	memset(&g_receive_st, 0, sizeof(g_receive_st));
+	uint8_t link = link_current();
+
+	memset(&g_send_st[link], 0, sizeof(wechat_send_pack_st));
+	memset(&g_receive_st[link], 0, sizeof(wechat_receive_pack_st));
 	app_wechat_disconnection();
 }
 
@@ -127,7 +206,7 @@ void wechat_indicate_statue_set(ble_wechat_evt_type_t statue)
 {
 	app_wechat_indicate_statue_set(statue);
 	if(statue == BLE_WECHAT_EVT_INDICATION_CONFIRMED)
-		g_send_st.indicate_available_flg = 0;
+		g_send_st[link_current()].indicate_available_flg = 0;
 }
 
 /*****************************************************************************
@@ -145,23 +224,30 @@ void wechat_indicate_statue_set(ble_wechat_evt_type_t statue)
 uint32_t wechat_receive(uint8_t *data,uint16_t length)
 {
 	uint32_t error = 0,i=0;
+	wechat_receive_pack_st *p_rx = &g_receive_st[link_current()];
+
 	error = wechat_receive_parse(data,length);
+	if(error == 0 && wechat_body_decrypt(p_rx) != NRF_SUCCESS)
+	{
+		QPRINTF("wechat decrypt error\r\n");
+		return 3;
+	}
 	if(error == 0)
 	{
 		QPRINTF("\r\nwechat recevie:*************************************\r\n");
-		QPRINTF("rec_flg=%d,\r\n",	g_receive_st.rec_flg);
-		QPRINTF("package_len=%d,\r\n",g_receive_st.package_len);
-		QPRINTF("cmd_no=%d,\r\n",	g_receive_st.cmd_no);
-		QPRINTF("send_i=%d,\r\n",	g_receive_st.send_i);
-		QPRINTF("data_len=%d,\r\n",	g_receive_st.data_len);
+		QPRINTF("rec_flg=%d,\r\n",	p_rx->rec_flg);
+		QPRINTF("package_len=%d,\r\n",p_rx->package_len);
+		QPRINTF("cmd_no=%d,\r\n",	p_rx->cmd_no);
+		QPRINTF("send_i=%d,\r\n",	p_rx->send_i);
+		QPRINTF("data_len=%d,\r\n",	p_rx->data_len);
 		QPRINTF("data:\r\n");
-		for(i=0;i<g_receive_st.data_len;i++)
+		for(i=0;i<p_rx->data_len;i++)
 		{
-			QPRINTF("%02x,",g_receive_st.data[i]);
+			QPRINTF("%02x,",p_rx->data[i]);
 		}
 		QPRINTF("\r\n");
 		QPRINTF("*************************************\r\n\r\n");
-		app_wechat_receive(g_receive_st.cmd_no,g_receive_st.data,g_receive_st.data_len);
+		app_wechat_receive(p_rx->cmd_no,p_rx->data,p_rx->data_len);
 	}
 
 	return error;
@@ -178,12 +264,15 @@ uint32_t wechat_receive(uint8_t *data,uint16_t length)
  *   ֵ : 	0:OK 	
  				1:ͨѡ	
  				2:ϴεݻûз
+ 				3:ܺŲ
  * ޸ʷ : 
- * ˵     : 
+ * ˵     : лỰԿʱܺٷ
 *****************************************************************************/
 uint32_t wechat_send_data(uint8_t *data,uint16_t length,wechat_channel_enum channel_type,uint8_t channel)
 {
 	uint32_t error = 0,i = 0;
+	uint8_t link = link_current();
+	wechat_send_pack_st *p_tx = &g_send_st[link];
 
 	if(length > WECHAT_SEND_DATA_SIZE)
 		length = WECHAT_SEND_DATA_SIZE;
@@ -191,80 +280,104 @@ uint32_t wechat_send_data(uint8_t *data,uint16_t length,wechat_channel_enum chan
 	if(channel_type >= WECHAT_CHANNEL_MAX)
 		return 1;
 	
-	if(g_send_st.send_flg)//ϴû
+	if(p_tx->send_flg)//ϴû
 		return 2;
 	
 	#if DATA_TYPE == DATA_BUFFER_TYPE
-	memset(g_send_st.data,0,WECHAT_SEND_DATA_SIZE);
+	memset(p_tx->data,0,WECHAT_SEND_DATA_SIZE);
 	
 	for(i=0;i<length;i++)
-		g_send_st.data[i] = data[i];
+		p_tx->data[i] = data[i];
 	#elif DATA_TYPE == DATA_POINTER_TYPE
-	memset(&g_wechat_common_tx_buffer[WECHAT_TX_START_ADDR], 0, WECHAT_TX_SIZE);
+	memset(&g_wechat_common_tx_buffer[link][WECHAT_TX_START_ADDR], 0, WECHAT_TX_SIZE);
 	for(i=0;i<length;i++)
-		g_wechat_common_tx_buffer[WECHAT_TX_START_ADDR+i] = data[i];
-	g_send_st.data = &g_wechat_common_tx_buffer[WECHAT_TX_START_ADDR];
+		g_wechat_common_tx_buffer[link][WECHAT_TX_START_ADDR+i] = data[i];
+	p_tx->data = &g_wechat_common_tx_buffer[link][WECHAT_TX_START_ADDR];
 	#endif
+
+	if(wechat_body_encrypt(p_tx->data,&length,WECHAT_TX_SIZE) != NRF_SUCCESS)
+		return 3;
 	
-	g_send_st.data_len 		= length;
-	g_send_st.send_index 	= 0;
-	g_send_st.channel_type 	= channel_type;
-	g_send_st.channel 		= channel;
-	g_send_st.send_flg 		= 1;
+	p_tx->data_len 		= length;
+	p_tx->send_index 	= 0;
+	p_tx->channel_type 	= channel_type;
+	p_tx->channel 		= channel;
+	p_tx->send_flg 		= 1;
 
 	return error;
 }
 
-/*****************************************************************************
- *    : wechat_periodic_send_data
- *  : 
- *  : void  void
- *  : void
- *   ֵ : 	0:ɻûݷ		
- 				1:ݷ
- * ޸ʷ : 
- * ˵     : ΢1ݷֶ֡ͣÿ֡20bytemainloopѭ淢
-*****************************************************************************/
-uint8_t wechat_periodic_send_data(void)
+static uint8_t wechat_link_send_data(uint8_t link)
 {
-	uint32_t error;
+	uint32_t error = NRF_SUCCESS;
 	uint16_t length = 0;
+	uint16_t conn_handle = link_conn_handle(link);
+	wechat_send_pack_st *p_tx = &g_send_st[link];
+
+	if(conn_handle == BLE_CONN_HANDLE_INVALID)
+	{
+		p_tx->send_flg = 0;
+		return 0;
+	}
 
-	if(g_send_st.send_flg == 1 && g_send_st.channel_type < WECHAT_CHANNEL_MAX)
+	if(p_tx->send_flg == 1 && p_tx->channel_type < WECHAT_CHANNEL_MAX)
 	{
-		length = g_send_st.data_len - g_send_st.send_index;
+		length = p_tx->data_len - p_tx->send_index;
 		if(length > 20)
 		{
 			length = 20;
 		}
 		
-		if(g_send_st.channel_type == WECHAT_INDICATE_CHANNEL)
+		if(p_tx->channel_type == WECHAT_INDICATE_CHANNEL)
 		{
-			if(g_send_st.indicate_available_flg == 0)
+			if(p_tx->indicate_available_flg == 0)
 			{
-				g_send_st.indicate_available_flg = 1;
-				error = wechat_indicate_send(&g_send_st.data[g_send_st.send_index],length);
+				p_tx->indicate_available_flg = 1;
+				error = wechat_indicate_send(conn_handle,&p_tx->data[p_tx->send_index],length);
 			}
 			else
-				error = g_send_st.indicate_available_flg;
+				error = p_tx->indicate_available_flg;
 			
 		}
-		else if(g_send_st.channel_type == WECHAT_NOTIFI_CHANNEL)
+		else if(p_tx->channel_type == WECHAT_NOTIFI_CHANNEL)
 		{
-			error = wechat_notify_send(&g_send_st.data[g_send_st.send_index],length,g_send_st.channel);
+			error = wechat_notify_send(conn_handle,&p_tx->data[p_tx->send_index],length,p_tx->channel);
 		}
 
 		if(error == NRF_SUCCESS)
 		{
-			g_send_st.send_index += length;
-			if(g_send_st.send_index >= g_send_st.data_len)
+			p_tx->send_index += length;
+			if(p_tx->send_index >= p_tx->data_len)
 			{
-				g_send_st.send_flg = 0;
+				p_tx->send_flg = 0;
 			}
-			QPRINTF("wechat:send_index=%d,\r\n",g_send_st.send_index);
+			QPRINTF("wechat:link=%d,send_index=%d,\r\n",link,p_tx->send_index);
 		}	
 	}
-	return g_send_st.send_flg;
+	return p_tx->send_flg;
 }
 
+/*****************************************************************************
+ *    : wechat_periodic_send_data
+ *  : 
+ *  : void  void
+ *  : void
+ *   ֵ : 	0:ɻûݷ		
+ 				1:ݷ
+ * ޸ʷ : 
+ * ˵     : ΢1ݷֶ֡ͣÿ֡20bytemainloopѭ淢
+ 				ÿÿ෢һ֡ʼֻ
+*****************************************************************************/
+uint8_t wechat_periodic_send_data(void)
+{
+	static uint8_t first = 0;
+	uint8_t i,statue = 0;
 
+	for(i=0;i<LINK_MAX;i++)
+	{
+		statue |= wechat_link_send_data((first + i) % LINK_MAX);
+	}
+	first = (first + 1) % LINK_MAX;
+
+	return statue;
+}
@@ -60,6 +60,8 @@ typedef struct
 void wechat_connection(void);
 void wechat_disconnection(void);
 void wechat_indicate_statue_set(ble_wechat_evt_type_t statue);
+void wechat_session_key_set(const uint8_t *key);		//¼ظĻỰԿ, ֮շİ嶼
+void wechat_session_key_clear(void);
 
 
 
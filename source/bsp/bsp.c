@@ -26,21 +26,10 @@
 #ifndef BSP_SIMPLE
 #include "app_timer.h"
 #include "app_button.h"
+#include "indicate.h"
 #endif // BSP_SIMPLE
 
-#define ADVERTISING_LED_ON_INTERVAL            200
-#define ADVERTISING_LED_OFF_INTERVAL           1800
-
-#define ADVERTISING_DIRECTED_LED_ON_INTERVAL   200
-#define ADVERTISING_DIRECTED_LED_OFF_INTERVAL  200
-
-#define ADVERTISING_WHITELIST_LED_ON_INTERVAL  200
-#define ADVERTISING_WHITELIST_LED_OFF_INTERVAL 800
-
-#define ADVERTISING_SLOW_LED_ON_INTERVAL       400
-#define ADVERTISING_SLOW_LED_OFF_INTERVAL      4000
-
-#define BONDING_INTERVAL                       100
+// The LED_0 blink timings are the INDICATE_LED_* patterns in indicate.c
 
 #define SENT_OK_INTERVAL                       100
 #define SEND_ERROR_INTERVAL                    500
@@ -232,8 +221,10 @@ static uint32_t bsp_led_indication(bsp_indication_t indicate)
 
     switch (indicate)
     {
+        // LED_0 is driven by the PWM1 pattern player, the patterns loop in hardware
         case BSP_INDICATE_IDLE:
-            LEDS_OFF(LEDS_MASK & ~m_alert_mask);
+            LEDS_OFF(LEDS_MASK & ~BSP_LED_0_MASK & ~m_alert_mask);
+            err_code       = indicate_play(INDICATE_LED_OFF);
             m_stable_state = indicate;
             break;
 
@@ -242,116 +233,46 @@ static uint32_t bsp_led_indication(bsp_indication_t indicate)
             LEDS_OFF(LEDS_MASK & ~BSP_LED_0_MASK & ~m_alert_mask);
 
             // in advertising blink LED_0
-            if (LED_IS_ON(BSP_LED_0_MASK))
-            {
-                LEDS_OFF(BSP_LED_0_MASK);
-                next_delay = indicate ==
-                             BSP_INDICATE_ADVERTISING ? ADVERTISING_LED_OFF_INTERVAL :
-                             ADVERTISING_SLOW_LED_OFF_INTERVAL;
-            }
-            else
-            {
-                LEDS_ON(BSP_LED_0_MASK);
-                next_delay = indicate ==
-                             BSP_INDICATE_ADVERTISING ? ADVERTISING_LED_ON_INTERVAL :
-                             ADVERTISING_SLOW_LED_ON_INTERVAL;
-            }
-
+            err_code       = indicate_play(indicate == BSP_INDICATE_ADVERTISING ?
+                                           INDICATE_LED_ADVERTISING : INDICATE_LED_SLOW);
             m_stable_state = indicate;
-            err_code       = app_timer_start(m_leds_timer_id, BSP_MS_TO_TICK(next_delay), NULL);
             break;
 
         case BSP_INDICATE_ADVERTISING_WHITELIST:
             LEDS_OFF(LEDS_MASK & ~BSP_LED_0_MASK & ~m_alert_mask);
 
             // in advertising quickly blink LED_0
-            if (LED_IS_ON(BSP_LED_0_MASK))
-            {
-                LEDS_OFF(BSP_LED_0_MASK);
-                next_delay = indicate ==
-                             BSP_INDICATE_ADVERTISING_WHITELIST ?
-                             ADVERTISING_WHITELIST_LED_OFF_INTERVAL :
-                             ADVERTISING_SLOW_LED_OFF_INTERVAL;
-            }
-            else
-            {
-                LEDS_ON(BSP_LED_0_MASK);
-                next_delay = indicate ==
-                             BSP_INDICATE_ADVERTISING_WHITELIST ?
-                             ADVERTISING_WHITELIST_LED_ON_INTERVAL :
-                             ADVERTISING_SLOW_LED_ON_INTERVAL;
-            }
+            err_code       = indicate_play(INDICATE_LED_WHITELIST);
             m_stable_state = indicate;
-            err_code       = app_timer_start(m_leds_timer_id, BSP_MS_TO_TICK(next_delay), NULL);
             break;
 
         case BSP_INDICATE_ADVERTISING_SLOW:
             LEDS_OFF(LEDS_MASK & ~BSP_LED_0_MASK & ~m_alert_mask);
 
             // in advertising slowly blink LED_0
-            if (LED_IS_ON(BSP_LED_0_MASK))
-            {
-                LEDS_OFF(BSP_LED_0_MASK);
-                next_delay = indicate ==
-                             BSP_INDICATE_ADVERTISING_SLOW ? ADVERTISING_SLOW_LED_OFF_INTERVAL :
-                             ADVERTISING_SLOW_LED_OFF_INTERVAL;
-            }
-            else
-            {
-                LEDS_ON(BSP_LED_0_MASK);
-                next_delay = indicate ==
-                             BSP_INDICATE_ADVERTISING_SLOW ? ADVERTISING_SLOW_LED_ON_INTERVAL :
-                             ADVERTISING_SLOW_LED_ON_INTERVAL;
-            }
+            err_code       = indicate_play(INDICATE_LED_SLOW);
             m_stable_state = indicate;
-            err_code       = app_timer_start(m_leds_timer_id, BSP_MS_TO_TICK(next_delay), NULL);
             break;
 
         case BSP_INDICATE_ADVERTISING_DIRECTED:
             LEDS_OFF(LEDS_MASK & ~BSP_LED_0_MASK & ~m_alert_mask);
 
             // in advertising very quickly blink LED_0
-            if (LED_IS_ON(BSP_LED_0_MASK))
-            {
-                LEDS_OFF(BSP_LED_0_MASK);
-                next_delay = indicate ==
-                             BSP_INDICATE_ADVERTISING_DIRECTED ?
-                             ADVERTISING_DIRECTED_LED_OFF_INTERVAL :
-                             ADVERTISING_SLOW_LED_OFF_INTERVAL;
-            }
-            else
-            {
-                LEDS_ON(BSP_LED_0_MASK);
-                next_delay = indicate ==
-                             BSP_INDICATE_ADVERTISING_DIRECTED ?
-                             ADVERTISING_DIRECTED_LED_ON_INTERVAL :
-                             ADVERTISING_SLOW_LED_ON_INTERVAL;
-            }
+            err_code       = indicate_play(INDICATE_LED_DIRECTED);
             m_stable_state = indicate;
-            err_code       = app_timer_start(m_leds_timer_id, BSP_MS_TO_TICK(next_delay), NULL);
             break;
 
         case BSP_INDICATE_BONDING:
             LEDS_OFF(LEDS_MASK & ~BSP_LED_0_MASK & ~m_alert_mask);
 
             // in bonding fast blink LED_0
-            if (LED_IS_ON(BSP_LED_0_MASK))
-            {
-                LEDS_OFF(BSP_LED_0_MASK);
-            }
-            else
-            {
-                LEDS_ON(BSP_LED_0_MASK);
-            }
-
+            err_code       = indicate_play(INDICATE_LED_BONDING);
             m_stable_state = indicate;
-            err_code       =
-                app_timer_start(m_leds_timer_id, BSP_MS_TO_TICK(BONDING_INTERVAL), NULL);
             break;
 
         case BSP_INDICATE_CONNECTED:
             LEDS_OFF(LEDS_MASK & ~BSP_LED_0_MASK & ~m_alert_mask);
-            LEDS_ON(BSP_LED_0_MASK);
+            err_code       = indicate_play(INDICATE_LED_CONNECTED);
             m_stable_state = indicate;
             break;
 
@@ -6,22 +6,126 @@
 #include "debug.h"
 #include <string.h>
 
-communication_statue_st g_communication_statue = {0};
+#if LINK_MAX > 2
+#error "g_link initializes two links"
+#endif
+link_ctx_st g_link[LINK_MAX] = {
+	{BLE_CONN_HANDLE_INVALID},
+#if LINK_MAX > 1
+	{BLE_CONN_HANDLE_INVALID},
+#endif
+};
+communication_statue_st *g_communication_statue = &g_link[0].statue;
+trans_evt_st *g_trans_evt_hander = &g_link[0].evt;
+
+static uint8_t m_link_current = 0;
+
+uint8_t link_open(uint16_t conn_handle,ble_gap_addr_t const *p_peer_addr)
+{
+	uint8_t i;
+
+	for(i=0;i<LINK_MAX;i++)
+	{
+		if(g_link[i].conn_handle == BLE_CONN_HANDLE_INVALID)
+		{
+			memset(&g_link[i],0,sizeof(link_ctx_st));
+			g_link[i].conn_handle = conn_handle;
+			g_link[i].peer_addr = *p_peer_addr;
+			g_link[i].bond_id = LINK_BOND_NONE;
+			QPRINTF("link %d open,conn_handle=%d\r\n",i,conn_handle);
+			break;
+		}
+	}
+	return i;
+}
+
+void link_close(uint16_t conn_handle)
+{
+	uint8_t i = link_index(conn_handle);
+
+	if(i < LINK_MAX)
+	{
+		g_link[i].conn_handle = BLE_CONN_HANDLE_INVALID;
+		g_link[i].evt.evt = 0;
+		QPRINTF("link %d close\r\n",i);
+	}
+}
+
+//the device manager knows the bond of a peer once it connects or pairs
+void link_bond_set(uint16_t conn_handle,uint8_t bond_id)
+{
+	uint8_t i = link_index(conn_handle);
+
+	if(i < LINK_MAX)
+		g_link[i].bond_id = bond_id;
+}
+
+uint8_t link_index(uint16_t conn_handle)
+{
+	uint8_t i;
+
+	if(conn_handle == BLE_CONN_HANDLE_INVALID)
+		return LINK_MAX;
+
+	for(i=0;i<LINK_MAX;i++)
+	{
+		if(g_link[i].conn_handle == conn_handle)
+			break;
+	}
+	return i;
+}
+
+uint16_t link_conn_handle(uint8_t index)
+{
+	if(index >= LINK_MAX)
+		return BLE_CONN_HANDLE_INVALID;
+	return g_link[index].conn_handle;
+}
+
+uint8_t link_count(void)
+{
+	uint8_t i,count = 0;
+
+	for(i=0;i<LINK_MAX;i++)
+	{
+		if(g_link[i].conn_handle != BLE_CONN_HANDLE_INVALID)
+			count++;
+	}
+	return count;
+}
+
+uint8_t link_select(uint8_t index)
+{
+	uint8_t prev = m_link_current;
+
+	if(index < LINK_MAX)
+	{
+		m_link_current 			= index;
+		g_communication_statue 	= &g_link[index].statue;
+		g_trans_evt_hander 		= &g_link[index].evt;
+	}
+	return prev;
+}
+
+uint8_t link_current(void)
+{
+	return m_link_current;
+}
 
 void usr_set_app_type(app_enum type)
 {
-	g_communication_statue.app_type |= type;
+	g_communication_statue->app_type |= type;
 }
 
 uint32_t app_send_data(uint8_t *data,uint16_t length)
 {
 	uint32_t error;
 
-	if(g_communication_statue.app_type == WECHAT_APP)
+	if(g_communication_statue->app_type == WECHAT_APP)
 	{	
 		error = wechat_send_data(data, length,WECHAT_INDICATE_CHANNEL,0);
 	}
-	else if(g_communication_statue.app_type == LIFESENSE_APP)
+	else if(g_communication_statue->app_type == LIFESENSE_APP)
 	{	
 		error = transfer_send_data(data, length,TRANS_INDICATE_CHANNEL,0);
 	}
@@ -40,7 +144,7 @@ uint32_t usr_send_data(uint8_t *data,uint16_t length)
 	
 	memset(send_buffer, 0, sizeof(send_buffer));
 
-	if(g_communication_statue.app_type == LIFESENSE_APP)
+	if(g_communication_statue->app_type == LIFESENSE_APP)
 	{	
 		p_in_data 	= data;
 		
@@ -51,7 +155,7 @@ uint32_t usr_send_data(uint8_t *data,uint16_t length)
 	    
 	    out_len = app_add_pack_head(trans_header,p_in_data,send_buffer, 0);
 	}
-	else if(g_communication_statue.app_type == WECHAT_APP)
+	else if(g_communication_statue->app_type == WECHAT_APP)
 	{	
 		wechat_head.ucMagicNumber= WECHAT_PACK_HEAD_MAGICNUM;       	//ͷmagic numberֵǹ̶
 		wechat_head.ucVersion	= WECHAT_PACK_HEAD_VERSIOM;			//ͷversionrֵǹ̶	
@@ -78,11 +182,11 @@ uint32_t usr_send_data(uint8_t *data,uint16_t length)
 		out_len = app_add_wechat_head(wechat_head, ucDataAfterPack, send_buffer);
 	}
 
-	if(g_communication_statue.app_type == LIFESENSE_APP)
+	if(g_communication_statue->app_type == LIFESENSE_APP)
 	{	
 		error = transfer_send_data(send_buffer, out_len,TRANS_INDICATE_CHANNEL,0);
 	}
-	else if(g_communication_statue.app_type == WECHAT_APP)
+	else if(g_communication_statue->app_type == WECHAT_APP)
 	{			
 		error = wechat_send_data(send_buffer, out_len,WECHAT_INDICATE_CHANNEL,0);
 	}
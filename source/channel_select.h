@@ -1,7 +1,11 @@
 #ifndef _CHANNEL_SELECT_H_
 #define _CHANNEL_SELECT_H_
 #include <stdint.h>
+#include "ble.h"
+#include "usr_design.h"
 
+#define LINK_BOND_NONE		(0xFF)	//link_ctx_st.bond_id of a peer with no bond, DM_INVALID_ID
+#define LINK_MAX			(1)		//links served at the same time, PERIPHERAL_LINK_COUNT in main.c. S132 2.0.0 supports one peripheral link, 2 needs S132 v3 or later
 
 typedef enum
 {
@@ -40,7 +44,33 @@ typedef struct
 	uint8_t app_statue;			//ǰ̨Ą̊́
 }communication_statue_st;
 
-extern communication_statue_st g_communication_statue;
+typedef struct
+{
+	uint16_t conn_handle;				//BLE_CONN_HANDLE_INVALID while the slot is free
+	ble_gap_addr_t peer_addr;			//address the peer connected with
+	uint8_t bond_id;					//device manager device_id of a bonded peer, LINK_BOND_NONE if none
+	communication_statue_st statue;
+	trans_evt_st evt;					//usr_*_evt still to run on this link
+}link_ctx_st;
+
+extern link_ctx_st g_link[LINK_MAX];
+
+/*****************************************************************************
+ * The channel code serves one link at a time: g_communication_statue and
+ * g_trans_evt_hander point into the selected link. A BLE event handler
+ * selects the link of its event and restores the previous one before it
+ * returns, so the link the main loop works on never changes under it.
+*****************************************************************************/
+extern communication_statue_st *g_communication_statue;
+
+uint8_t link_open(uint16_t conn_handle,ble_gap_addr_t const *p_peer_addr);
+void link_bond_set(uint16_t conn_handle,uint8_t bond_id);
+void link_close(uint16_t conn_handle);
+uint8_t link_index(uint16_t conn_handle);	//LINK_MAX if conn_handle has no link
+uint16_t link_conn_handle(uint8_t index);
+uint8_t link_count(void);
+uint8_t link_select(uint8_t index);			//returns the link selected before
+uint8_t link_current(void);
 
 void usr_set_app_type(app_enum type);
 uint32_t app_send_data(uint8_t *data,uint16_t length);
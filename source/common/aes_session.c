@@ -0,0 +1,481 @@
+#include "aes_session.h"
+#include <string.h>
+#include "nrf_error.h"
+#if AES_SESSION_ECB_HW
+#ifdef SOFTDEVICE_PRESENT
+#include "nrf_soc.h"
+#include "nrf_sdm.h"
+#endif
+#include "nrf_ecb.h"
+#endif
+
+#define AES_ROUNDS			(10)
+#define AES_ROUND_KEY_SIZE	(AES_SESSION_BLOCK_SIZE*(AES_ROUNDS+1))
+
+static const uint8_t sbox[256] = {
+	0x63,0x7c,0x77,0x7b,0xf2,0x6b,0x6f,0xc5,0x30,0x01,0x67,0x2b,0xfe,0xd7,0xab,0x76,
+	0xca,0x82,0xc9,0x7d,0xfa,0x59,0x47,0xf0,0xad,0xd4,0xa2,0xaf,0x9c,0xa4,0x72,0xc0,
+	0xb7,0xfd,0x93,0x26,0x36,0x3f,0xf7,0xcc,0x34,0xa5,0xe5,0xf1,0x71,0xd8,0x31,0x15,
+	0x04,0xc7,0x23,0xc3,0x18,0x96,0x05,0x9a,0x07,0x12,0x80,0xe2,0xeb,0x27,0xb2,0x75,
+	0x09,0x83,0x2c,0x1a,0x1b,0x6e,0x5a,0xa0,0x52,0x3b,0xd6,0xb3,0x29,0xe3,0x2f,0x84,
+	0x53,0xd1,0x00,0xed,0x20,0xfc,0xb1,0x5b,0x6a,0xcb,0xbe,0x39,0x4a,0x4c,0x58,0xcf,
+	0xd0,0xef,0xaa,0xfb,0x43,0x4d,0x33,0x85,0x45,0xf9,0x02,0x7f,0x50,0x3c,0x9f,0xa8,
+	0x51,0xa3,0x40,0x8f,0x92,0x9d,0x38,0xf5,0xbc,0xb6,0xda,0x21,0x10,0xff,0xf3,0xd2,
+	0xcd,0x0c,0x13,0xec,0x5f,0x97,0x44,0x17,0xc4,0xa7,0x7e,0x3d,0x64,0x5d,0x19,0x73,
+	0x60,0x81,0x4f,0xdc,0x22,0x2a,0x90,0x88,0x46,0xee,0xb8,0x14,0xde,0x5e,0x0b,0xdb,
+	0xe0,0x32,0x3a,0x0a,0x49,0x06,0x24,0x5c,0xc2,0xd3,0xac,0x62,0x91,0x95,0xe4,0x79,
+	0xe7,0xc8,0x37,0x6d,0x8d,0xd5,0x4e,0xa9,0x6c,0x56,0xf4,0xea,0x65,0x7a,0xae,0x08,
+	0xba,0x78,0x25,0x2e,0x1c,0xa6,0xb4,0xc6,0xe8,0xdd,0x74,0x1f,0x4b,0xbd,0x8b,0x8a,
+	0x70,0x3e,0xb5,0x66,0x48,0x03,0xf6,0x0e,0x61,0x35,0x57,0xb9,0x86,0xc1,0x1d,0x9e,
+	0xe1,0xf8,0x98,0x11,0x69,0xd9,0x8e,0x94,0x9b,0x1e,0x87,0xe9,0xce,0x55,0x28,0xdf,
+	0x8c,0xa1,0x89,0x0d,0xbf,0xe6,0x42,0x68,0x41,0x99,0x2d,0x0f,0xb0,0x54,0xbb,0x16
+};
+
+static const uint8_t rsbox[256] = {
+	0x52,0x09,0x6a,0xd5,0x30,0x36,0xa5,0x38,0xbf,0x40,0xa3,0x9e,0x81,0xf3,0xd7,0xfb,
+	0x7c,0xe3,0x39,0x82,0x9b,0x2f,0xff,0x87,0x34,0x8e,0x43,0x44,0xc4,0xde,0xe9,0xcb,
+	0x54,0x7b,0x94,0x32,0xa6,0xc2,0x23,0x3d,0xee,0x4c,0x95,0x0b,0x42,0xfa,0xc3,0x4e,
+	0x08,0x2e,0xa1,0x66,0x28,0xd9,0x24,0xb2,0x76,0x5b,0xa2,0x49,0x6d,0x8b,0xd1,0x25,
+	0x72,0xf8,0xf6,0x64,0x86,0x68,0x98,0x16,0xd4,0xa4,0x5c,0xcc,0x5d,0x65,0xb6,0x92,
+	0x6c,0x70,0x48,0x50,0xfd,0xed,0xb9,0xda,0x5e,0x15,0x46,0x57,0xa7,0x8d,0x9d,0x84,
+	0x90,0xd8,0xab,0x00,0x8c,0xbc,0xd3,0x0a,0xf7,0xe4,0x58,0x05,0xb8,0xb3,0x45,0x06,
+	0xd0,0x2c,0x1e,0x8f,0xca,0x3f,0x0f,0x02,0xc1,0xaf,0xbd,0x03,0x01,0x13,0x8a,0x6b,
+	0x3a,0x91,0x11,0x41,0x4f,0x67,0xdc,0xea,0x97,0xf2,0xcf,0xce,0xf0,0xb4,0xe6,0x73,
+	0x96,0xac,0x74,0x22,0xe7,0xad,0x35,0x85,0xe2,0xf9,0x37,0xe8,0x1c,0x75,0xdf,0x6e,
+	0x47,0xf1,0x1a,0x71,0x1d,0x29,0xc5,0x89,0x6f,0xb7,0x62,0x0e,0xaa,0x18,0xbe,0x1b,
+	0xfc,0x56,0x3e,0x4b,0xc6,0xd2,0x79,0x20,0x9a,0xdb,0xc0,0xfe,0x78,0xcd,0x5a,0xf4,
+	0x1f,0xdd,0xa8,0x33,0x88,0x07,0xc7,0x31,0xb1,0x12,0x10,0x59,0x27,0x80,0xec,0x5f,
+	0x60,0x51,0x7f,0xa9,0x19,0xb5,0x4a,0x0d,0x2d,0xe5,0x7a,0x9f,0x93,0xc9,0x9c,0xef,
+	0xa0,0xe0,0x3b,0x4d,0xae,0x2a,0xf5,0xb0,0xc8,0xeb,0xbb,0x3c,0x83,0x53,0x99,0x61,
+	0x17,0x2b,0x04,0x7e,0xba,0x77,0xd6,0x26,0xe1,0x69,0x14,0x63,0x55,0x21,0x0c,0x7d
+};
+
+static const uint8_t rcon[AES_ROUNDS+1] = {0x8d,0x01,0x02,0x04,0x08,0x10,0x20,0x40,0x80,0x1b,0x36};
+
+static uint8_t m_key[AES_SESSION_KEY_SIZE];
+static uint8_t m_round_key[AES_ROUND_KEY_SIZE];		//expanded key, needed by the inverse cipher
+static bool    m_key_valid = false;
+
+#if AES_SESSION_ECB_HW && defined(SOFTDEVICE_PRESENT)
+static nrf_ecb_hal_data_block_t m_ecb_blocks[AES_SESSION_BATCH_BLOCKS];
+#endif
+
+static uint8_t xtime(uint8_t x)
+{
+	return (uint8_t)((x<<1) ^ ((x & 0x80) ? 0x1b : 0x00));
+}
+
+static uint8_t gf_mul(uint8_t x,uint8_t y)
+{
+	uint8_t r = 0;
+	while(y)
+	{
+		if(y & 0x01)
+			r ^= x;
+		x = xtime(x);
+		y >>= 1;
+	}
+	return r;
+}
+
+static void key_expansion(const uint8_t *key)
+{
+	uint8_t i,j,t[4],tmp;
+
+	memcpy(m_round_key,key,AES_SESSION_KEY_SIZE);
+	for(i=4;i<4*(AES_ROUNDS+1);i++)
+	{
+		for(j=0;j<4;j++)
+			t[j] = m_round_key[(i-1)*4+j];
+
+		if(i%4 == 0)
+		{
+			tmp  = t[0];
+			t[0] = sbox[t[1]] ^ rcon[i/4];
+			t[1] = sbox[t[2]];
+			t[2] = sbox[t[3]];
+			t[3] = sbox[tmp];
+		}
+
+		for(j=0;j<4;j++)
+			m_round_key[i*4+j] = m_round_key[(i-4)*4+j] ^ t[j];
+	}
+}
+
+static void add_round_key(uint8_t *state,uint8_t round)
+{
+	uint8_t i;
+	for(i=0;i<AES_SESSION_BLOCK_SIZE;i++)
+		state[i] ^= m_round_key[round*AES_SESSION_BLOCK_SIZE+i];
+}
+
+#if !AES_SESSION_ECB_HW
+static void soft_block_encrypt(uint8_t *state)
+{
+	uint8_t round,i,c,tmp[AES_SESSION_BLOCK_SIZE],a0,a1,a2,a3,all;
+
+	add_round_key(state,0);
+	for(round=1;round<=AES_ROUNDS;round++)
+	{
+		//SubBytes + ShiftRows
+		for(c=0;c<4;c++)
+			for(i=0;i<4;i++)
+				tmp[i+4*c] = sbox[state[i+4*((c+i)&0x03)]];
+
+		if(round != AES_ROUNDS)
+		{
+			//MixColumns
+			for(c=0;c<4;c++)
+			{
+				a0 = tmp[4*c];
+				a1 = tmp[4*c+1];
+				a2 = tmp[4*c+2];
+				a3 = tmp[4*c+3];
+				all = a0 ^ a1 ^ a2 ^ a3;
+				tmp[4*c]   ^= all ^ xtime(a0 ^ a1);
+				tmp[4*c+1] ^= all ^ xtime(a1 ^ a2);
+				tmp[4*c+2] ^= all ^ xtime(a2 ^ a3);
+				tmp[4*c+3] ^= all ^ xtime(a3 ^ a0);
+			}
+		}
+		memcpy(state,tmp,AES_SESSION_BLOCK_SIZE);
+		add_round_key(state,round);
+	}
+}
+#endif
+
+static void soft_block_decrypt(uint8_t *state)
+{
+	uint8_t round,i,c,tmp[AES_SESSION_BLOCK_SIZE],a0,a1,a2,a3;
+
+	add_round_key(state,AES_ROUNDS);
+	for(round=AES_ROUNDS;round>0;round--)
+	{
+		//InvShiftRows + InvSubBytes
+		for(c=0;c<4;c++)
+			for(i=0;i<4;i++)
+				tmp[i+4*((c+i)&0x03)] = rsbox[state[i+4*c]];
+
+		memcpy(state,tmp,AES_SESSION_BLOCK_SIZE);
+		add_round_key(state,round-1);
+
+		if(round != 1)
+		{
+			//InvMixColumns
+			for(c=0;c<4;c++)
+			{
+				a0 = state[4*c];
+				a1 = state[4*c+1];
+				a2 = state[4*c+2];
+				a3 = state[4*c+3];
+				state[4*c]   = gf_mul(a0,0x0e) ^ gf_mul(a1,0x0b) ^ gf_mul(a2,0x0d) ^ gf_mul(a3,0x09);
+				state[4*c+1] = gf_mul(a0,0x09) ^ gf_mul(a1,0x0e) ^ gf_mul(a2,0x0b) ^ gf_mul(a3,0x0d);
+				state[4*c+2] = gf_mul(a0,0x0d) ^ gf_mul(a1,0x09) ^ gf_mul(a2,0x0e) ^ gf_mul(a3,0x0b);
+				state[4*c+3] = gf_mul(a0,0x0b) ^ gf_mul(a1,0x0d) ^ gf_mul(a2,0x09) ^ gf_mul(a3,0x0e);
+			}
+		}
+	}
+}
+
+/*****************************************************************************
+ * encrypt count consecutive 16 byte blocks in place with the session key.
+ * With the SoftDevice enabled the ECB peripheral belongs to the stack, so
+ * the blocks are handed over in one sd_ecb_blocks_encrypt call; otherwise
+ * the peripheral is driven directly.
+*****************************************************************************/
+static uint32_t blocks_encrypt(uint8_t *blocks,uint8_t count)
+{
+	uint8_t i;
+#if AES_SESSION_ECB_HW
+#ifdef SOFTDEVICE_PRESENT
+	uint8_t enabled = 0;
+
+	(void)sd_softdevice_is_enabled(&enabled);
+	if(enabled)
+	{
+		for(i=0;i<count;i++)
+		{
+			m_ecb_blocks[i].p_key        = (soc_ecb_key_t *)m_key;
+			m_ecb_blocks[i].p_cleartext  = (soc_ecb_cleartext_t *)(blocks + i*AES_SESSION_BLOCK_SIZE);
+			m_ecb_blocks[i].p_ciphertext = (soc_ecb_ciphertext_t *)(blocks + i*AES_SESSION_BLOCK_SIZE);
+		}
+		return sd_ecb_blocks_encrypt(count,m_ecb_blocks);
+	}
+#endif
+	(void)nrf_ecb_init();
+	nrf_ecb_set_key(m_key);
+	for(i=0;i<count;i++)
+	{
+		if(!nrf_ecb_crypt(blocks + i*AES_SESSION_BLOCK_SIZE,blocks + i*AES_SESSION_BLOCK_SIZE))
+			return NRF_ERROR_TIMEOUT;
+	}
+#else
+	for(i=0;i<count;i++)
+		soft_block_encrypt(blocks + i*AES_SESSION_BLOCK_SIZE);
+#endif
+	return NRF_SUCCESS;
+}
+
+static void block_xor(uint8_t *dst,const uint8_t *src,uint16_t length)
+{
+	while(length--)
+		*dst++ ^= *src++;
+}
+
+void aes_session_key_set(const uint8_t *key)
+{
+	memcpy(m_key,key,AES_SESSION_KEY_SIZE);
+	key_expansion(key);
+	m_key_valid = true;
+}
+
+void aes_session_key_clear(void)
+{
+	memset(m_key,0,sizeof(m_key));
+	memset(m_round_key,0,sizeof(m_round_key));
+	m_key_valid = false;
+}
+
+bool aes_session_key_valid(void)
+{
+	return m_key_valid;
+}
+
+uint32_t aes_session_cbc_encrypt(uint8_t *iv,uint8_t *data,uint16_t length)
+{
+	uint32_t error;
+	const uint8_t *prev = iv;
+
+	if(!m_key_valid)
+		return NRF_ERROR_INVALID_STATE;
+	if(length % AES_SESSION_BLOCK_SIZE)
+		return NRF_ERROR_INVALID_LENGTH;
+
+	//each block chains on the previous ciphertext, so CBC encryption cannot be batched
+	for(;length;length-=AES_SESSION_BLOCK_SIZE,data+=AES_SESSION_BLOCK_SIZE)
+	{
+		block_xor(data,prev,AES_SESSION_BLOCK_SIZE);
+		error = blocks_encrypt(data,1);
+		if(error != NRF_SUCCESS)
+			return error;
+		prev = data;
+	}
+	if(prev != iv)
+		memcpy(iv,prev,AES_SESSION_BLOCK_SIZE);
+	return NRF_SUCCESS;
+}
+
+uint32_t aes_session_cbc_decrypt(uint8_t *iv,uint8_t *data,uint16_t length)
+{
+	uint8_t cipher[AES_SESSION_BLOCK_SIZE];
+
+	if(!m_key_valid)
+		return NRF_ERROR_INVALID_STATE;
+	if(length % AES_SESSION_BLOCK_SIZE)
+		return NRF_ERROR_INVALID_LENGTH;
+
+	//the ECB peripheral only runs the forward cipher
+	for(;length;length-=AES_SESSION_BLOCK_SIZE,data+=AES_SESSION_BLOCK_SIZE)
+	{
+		memcpy(cipher,data,AES_SESSION_BLOCK_SIZE);
+		soft_block_decrypt(data);
+		block_xor(data,iv,AES_SESSION_BLOCK_SIZE);
+		memcpy(iv,cipher,AES_SESSION_BLOCK_SIZE);
+	}
+	return NRF_SUCCESS;
+}
+
+uint32_t aes_session_cbc_pad_encrypt(uint8_t *iv,uint8_t *data,uint16_t length,uint16_t size,uint16_t *p_length)
+{
+	uint8_t pad = (uint8_t)(AES_SESSION_BLOCK_SIZE - length % AES_SESSION_BLOCK_SIZE);
+
+	if((uint32_t)length + pad > size)
+		return NRF_ERROR_NO_MEM;
+
+	memset(&data[length],pad,pad);
+	*p_length = length + pad;
+	return aes_session_cbc_encrypt(iv,data,*p_length);
+}
+
+uint32_t aes_session_cbc_pad_decrypt(uint8_t *iv,uint8_t *data,uint16_t length,uint16_t *p_length)
+{
+	uint32_t error;
+	uint8_t pad,bad = 0,i;
+
+	if(length == 0)
+		return NRF_ERROR_INVALID_LENGTH;
+	error = aes_session_cbc_decrypt(iv,data,length);
+	if(error != NRF_SUCCESS)
+		return error;
+
+	pad = data[length-1];
+	if(pad == 0 || pad > AES_SESSION_BLOCK_SIZE)
+		return NRF_ERROR_INVALID_DATA;
+	for(i=1;i<=pad;i++)
+		bad |= (uint8_t)(data[length-i] ^ pad);
+	if(bad)
+		return NRF_ERROR_INVALID_DATA;
+
+	*p_length = length - pad;
+	return NRF_SUCCESS;
+}
+
+static uint32_t ccm_mac(const uint8_t *nonce,
+						const uint8_t *aad,uint16_t aad_len,
+						const uint8_t *data,uint16_t length,
+						uint8_t mic_len,uint8_t *tag)
+{
+	uint32_t error;
+	uint8_t pos,n;
+
+	//B0: flags | nonce | l(m)
+	tag[0] = (uint8_t)(((aad_len ? 1 : 0)<<6) | (((mic_len-2)/2)<<3) | (2-1));
+	memcpy(&tag[1],nonce,AES_SESSION_CCM_NONCE_SIZE);
+	tag[14] = (uint8_t)(length>>8);
+	tag[15] = (uint8_t)length;
+	error = blocks_encrypt(tag,1);
+	if(error != NRF_SUCCESS)
+		return error;
+
+	if(aad_len)
+	{
+		tag[0] ^= (uint8_t)(aad_len>>8);
+		tag[1] ^= (uint8_t)aad_len;
+		pos = 2;
+		while(aad_len)
+		{
+			n = AES_SESSION_BLOCK_SIZE - pos;
+			if(n > aad_len)
+				n = aad_len;
+			block_xor(&tag[pos],aad,n);
+			aad += n;
+			aad_len -= n;
+			pos = 0;
+			error = blocks_encrypt(tag,1);
+			if(error != NRF_SUCCESS)
+				return error;
+		}
+	}
+
+	while(length)
+	{
+		n = (length > AES_SESSION_BLOCK_SIZE) ? AES_SESSION_BLOCK_SIZE : length;
+		block_xor(tag,data,n);
+		data += n;
+		length -= n;
+		error = blocks_encrypt(tag,1);
+		if(error != NRF_SUCCESS)
+			return error;
+	}
+	return NRF_SUCCESS;
+}
+
+/*****************************************************************************
+ * CTR pass of CCM. Counter blocks A1..An are generated AES_SESSION_BATCH_BLOCKS
+ * at a time so one ECB request covers several blocks of the frame; A0 is
+ * used to encrypt the MIC.
+*****************************************************************************/
+static uint32_t ccm_ctr(const uint8_t *nonce,uint8_t *data,uint16_t length,uint8_t *tag,uint8_t mic_len)
+{
+	uint8_t stream[AES_SESSION_BATCH_BLOCKS*AES_SESSION_BLOCK_SIZE];
+	uint16_t counter = 1,chunk;
+	uint8_t i,blocks;
+	uint32_t error;
+
+	while(length)
+	{
+		blocks = 0;
+		chunk  = 0;
+		while(blocks < AES_SESSION_BATCH_BLOCKS && chunk < length)
+		{
+			stream[blocks*AES_SESSION_BLOCK_SIZE] = 2-1;
+			memcpy(&stream[blocks*AES_SESSION_BLOCK_SIZE+1],nonce,AES_SESSION_CCM_NONCE_SIZE);
+			stream[blocks*AES_SESSION_BLOCK_SIZE+14] = (uint8_t)(counter>>8);
+			stream[blocks*AES_SESSION_BLOCK_SIZE+15] = (uint8_t)counter;
+			counter++;
+			blocks++;
+			chunk += AES_SESSION_BLOCK_SIZE;
+		}
+		if(chunk > length)
+			chunk = length;
+
+		error = blocks_encrypt(stream,blocks);
+		if(error != NRF_SUCCESS)
+			return error;
+		block_xor(data,stream,chunk);
+		data += chunk;
+		length -= chunk;
+	}
+
+	stream[0] = 2-1;
+	memcpy(&stream[1],nonce,AES_SESSION_CCM_NONCE_SIZE);
+	stream[14] = 0;
+	stream[15] = 0;
+	error = blocks_encrypt(stream,1);
+	if(error != NRF_SUCCESS)
+		return error;
+	for(i=0;i<mic_len;i++)
+		tag[i] ^= stream[i];
+	return NRF_SUCCESS;
+}
+
+static bool ccm_params_valid(uint8_t mic_len)
+{
+	return (mic_len >= 4) && (mic_len <= AES_SESSION_CCM_MIC_MAX) && ((mic_len & 0x01) == 0);
+}
+
+uint32_t aes_session_ccm_encrypt(const uint8_t *nonce,
+								 const uint8_t *aad,uint16_t aad_len,
+								 uint8_t *data,uint16_t length,
+								 uint8_t *mic,uint8_t mic_len)
+{
+	uint8_t tag[AES_SESSION_BLOCK_SIZE];
+	uint32_t error;
+
+	if(!m_key_valid)
+		return NRF_ERROR_INVALID_STATE;
+	if(!ccm_params_valid(mic_len))
+		return NRF_ERROR_INVALID_PARAM;
+
+	error = ccm_mac(nonce,aad,aad_len,data,length,mic_len,tag);
+	if(error != NRF_SUCCESS)
+		return error;
+	error = ccm_ctr(nonce,data,length,tag,mic_len);
+	if(error != NRF_SUCCESS)
+		return error;
+	memcpy(mic,tag,mic_len);
+	return NRF_SUCCESS;
+}
+
+uint32_t aes_session_ccm_decrypt(const uint8_t *nonce,
+								 const uint8_t *aad,uint16_t aad_len,
+								 uint8_t *data,uint16_t length,
+								 const uint8_t *mic,uint8_t mic_len)
+{
+	uint8_t tag[AES_SESSION_BLOCK_SIZE],ctr_tag[AES_SESSION_BLOCK_SIZE],diff = 0,i;
+	uint32_t error;
+
+	if(!m_key_valid)
+		return NRF_ERROR_INVALID_STATE;
+	if(!ccm_params_valid(mic_len))
+		return NRF_ERROR_INVALID_PARAM;
+
+	//CTR first to recover the plaintext, the MIC is computed over the plaintext
+	memset(ctr_tag,0,sizeof(ctr_tag));
+	error = ccm_ctr(nonce,data,length,ctr_tag,mic_len);
+	if(error != NRF_SUCCESS)
+		return error;
+	error = ccm_mac(nonce,aad,aad_len,data,length,mic_len,tag);
+	if(error != NRF_SUCCESS)
+		return error;
+
+	for(i=0;i<mic_len;i++)
+		diff |= (uint8_t)(tag[i] ^ ctr_tag[i] ^ mic[i]);
+	if(diff)
+	{
+		memset(data,0,length);
+		return NRF_ERROR_INVALID_DATA;
+	}
+	return NRF_SUCCESS;
+}
+
@@ -0,0 +1,54 @@
+#ifndef _AES_SESSION_H_
+#define _AES_SESSION_H_
+#include <stdint.h>
+#include <stdbool.h>
+
+#define AES_SESSION_KEY_SIZE		(16)
+#define AES_SESSION_BLOCK_SIZE		(16)
+#define AES_SESSION_CCM_NONCE_SIZE	(13)		//CCM with L=2, payload up to 65535 bytes
+#define AES_SESSION_CCM_MIC_MAX		(16)
+
+#ifndef AES_SESSION_ECB_HW
+#define AES_SESSION_ECB_HW			(1)			//1:ECB peripheral (or SoftDevice) for forward cipher  0:software only
+#endif
+#define AES_SESSION_BATCH_BLOCKS	(8)			//keystream blocks generated per ECB request
+
+
+void aes_session_key_set(const uint8_t *key);
+void aes_session_key_clear(void);
+bool aes_session_key_valid(void);
+
+/*****************************************************************************
+ * in place AES-CBC, length must be a multiple of AES_SESSION_BLOCK_SIZE.
+ * iv is updated with the last cipher block so a stream can be chained
+ * across frames.
+*****************************************************************************/
+uint32_t aes_session_cbc_encrypt(uint8_t *iv,uint8_t *data,uint16_t length);
+uint32_t aes_session_cbc_decrypt(uint8_t *iv,uint8_t *data,uint16_t length);
+
+/*****************************************************************************
+ * AES-CBC with PKCS#7 padding, as used for WeChat AirSync bodies.
+ * encrypt pads data in place to the next whole block (a full block when
+ * length is already aligned); size is the room in data and *p_length
+ * returns the padded length. decrypt removes the padding and returns
+ * NRF_ERROR_INVALID_DATA if it is malformed.
+*****************************************************************************/
+uint32_t aes_session_cbc_pad_encrypt(uint8_t *iv,uint8_t *data,uint16_t length,uint16_t size,uint16_t *p_length);
+uint32_t aes_session_cbc_pad_decrypt(uint8_t *iv,uint8_t *data,uint16_t length,uint16_t *p_length);
+
+/*****************************************************************************
+ * in place AES-CCM (RFC 3610, L=2). mic_len is 4,6,...,16.
+ * aes_session_ccm_decrypt returns NRF_ERROR_INVALID_DATA and wipes data
+ * if the MIC does not match.
+*****************************************************************************/
+uint32_t aes_session_ccm_encrypt(const uint8_t *nonce,
+								 const uint8_t *aad,uint16_t aad_len,
+								 uint8_t *data,uint16_t length,
+								 uint8_t *mic,uint8_t mic_len);
+uint32_t aes_session_ccm_decrypt(const uint8_t *nonce,
+								 const uint8_t *aad,uint16_t aad_len,
+								 uint8_t *data,uint16_t length,
+								 const uint8_t *mic,uint8_t mic_len);
+
+#endif
+
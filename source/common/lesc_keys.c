@@ -0,0 +1,307 @@
+#include "lesc_keys.h"
+#include <string.h>
+#include "nrf_error.h"
+#include "nrf_soc.h"
+#include "ble_hci.h"
+#include "app_error.h"
+#include "app_scheduler.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "pstorage.h"
+#include "device_manager.h"
+#include "p256.h"
+#include "debug.h"
+
+#define APP_TIMER_PRESCALER	0
+#define LESC_KEY_MAGIC		(0x4B53454C)		//"LESK"
+#define LESC_RNG_RETRY		APP_TIMER_TICKS(10, APP_TIMER_PRESCALER)	//RNG pool refill wait
+
+typedef struct
+{
+	uint32_t				magic;
+	uint32_t				uses;				//DHKeys computed with this pair, counted in RAM: flash holds 0, a reset starts over
+	uint8_t					sk[P256_SCALAR_SIZE];
+	ble_gap_lesc_p256_pk_t	pk;
+} lesc_key_t;
+
+static lesc_key_t				m_key;						//pair handed to the SoftDevice
+static lesc_key_t				m_next;						//pair being generated
+static lesc_key_t				m_record;					//copy being written to flash
+static bool						m_key_valid     = false;
+static bool						m_next_ready    = false;
+static bool						m_keygen_active = false;
+static bool						m_keygen_seeded = false;
+static volatile bool			m_pairing       = false;	//m_key must not change while set
+static pstorage_handle_t		m_storage;
+
+static p256_mul_t				m_keygen;
+static p256_mul_t				m_dhkey;
+static bool						m_dhkey_active  = false;
+static volatile bool			m_dhkey_request = false;
+static volatile uint16_t		m_dhkey_conn    = BLE_CONN_HANDLE_INVALID;
+static ble_gap_lesc_p256_pk_t	m_peer_pk;
+static ble_gap_lesc_dhkey_t		m_dhkey_result;
+
+static volatile bool			m_step_queued   = false;
+static volatile bool			m_rng_wait      = false;	//keygen waits for the RNG timer, not the scheduler
+
+APP_TIMER_DEF(m_rng_timer_id);
+
+static void lesc_step(void *p_event_data,uint16_t event_size);
+
+static void lesc_storage_cb(pstorage_handle_t *p_handle,uint8_t op_code,uint32_t result,
+							uint8_t *p_data,uint32_t data_len)
+{
+	if(result != NRF_SUCCESS)
+		QPRINTF("lesc key store failed 0x%x\r\n",result);
+}
+
+static void lesc_key_store(void)
+{
+	uint32_t err_code;
+
+	m_record = m_key;
+	err_code = pstorage_update(&m_storage,(uint8_t *)&m_record,sizeof(m_record),0);
+	if(err_code != NRF_SUCCESS)
+		QPRINTF("lesc key store 0x%x\r\n",err_code);
+}
+
+//may be called from the SoftDevice event handler
+static void lesc_step_queue(void)
+{
+	bool     queue = false;
+	uint32_t err_code;
+
+	CRITICAL_REGION_ENTER();
+	if(!m_step_queued)
+	{
+		m_step_queued = true;
+		queue         = true;
+	}
+	CRITICAL_REGION_EXIT();
+
+	if(queue)
+	{
+		err_code = app_sched_event_put(NULL,0,lesc_step);
+		APP_ERROR_CHECK(err_code);
+	}
+}
+
+static void lesc_keygen_start(void)
+{
+	if(m_keygen_active || m_next_ready)
+		return;
+
+	m_keygen_active = true;
+	m_keygen_seeded = false;
+	lesc_step_queue();
+}
+
+static void lesc_rng_timeout_handler(void *p_context)
+{
+	m_rng_wait = false;
+	lesc_step_queue();
+}
+
+//the RNG pool refills in the background: wait for it on a timer so the CPU can sleep
+static void lesc_rng_wait(void)
+{
+	uint32_t err_code;
+
+	m_rng_wait = true;
+	err_code = app_timer_start(m_rng_timer_id,LESC_RNG_RETRY,NULL);
+	APP_ERROR_CHECK(err_code);
+}
+
+static void lesc_keygen_step(void)
+{
+	uint8_t  available;
+	uint8_t  point[P256_POINT_SIZE];
+
+	if(m_rng_wait)
+		return;
+
+	if(!m_keygen_seeded)
+	{
+		(void)sd_rand_application_bytes_available_get(&available);
+		if(available < P256_SCALAR_SIZE ||
+		   sd_rand_application_vector_get(m_next.sk,P256_SCALAR_SIZE) != NRF_SUCCESS)
+		{
+			lesc_rng_wait();
+			return;
+		}
+		m_keygen_seeded = (p256_mul_start(&m_keygen,m_next.sk,NULL) == NRF_SUCCESS);
+		return;
+	}
+
+	if(!p256_mul_step(&m_keygen,LESC_LADDER_STEPS))
+		return;
+
+	p256_mul_finish(&m_keygen,point);
+	memcpy(m_next.pk.pk,point,P256_POINT_SIZE);
+	m_next.magic    = LESC_KEY_MAGIC;
+	m_next.uses     = 0;
+	m_keygen_active = false;
+	m_next_ready    = true;
+	QPRINTF("lesc key pair generated\r\n");
+}
+
+static void lesc_key_rotate(void)
+{
+	bool rotated = false;
+
+	CRITICAL_REGION_ENTER();
+	if(!m_pairing)
+	{
+		m_key        = m_next;
+		m_key_valid  = true;
+		m_next_ready = false;
+		rotated      = true;
+	}
+	CRITICAL_REGION_EXIT();
+
+	if(rotated)
+	{
+		memset(&m_next,0,sizeof(m_next));
+		(void)dm_lesc_public_key_set(&m_key.pk);
+		lesc_key_store();
+	}
+}
+
+static void lesc_dhkey_start(void)
+{
+	uint16_t conn_handle;
+
+	CRITICAL_REGION_ENTER();
+	m_dhkey_request = false;
+	conn_handle     = m_dhkey_conn;
+	CRITICAL_REGION_EXIT();
+
+	m_dhkey_active = false;
+	if(conn_handle == BLE_CONN_HANDLE_INVALID)
+		return;
+
+	//an invalid peer key could leak the private key, so the pairing is dropped
+	if(!m_key_valid || p256_mul_start(&m_dhkey,m_key.sk,m_peer_pk.pk) != NRF_SUCCESS)
+	{
+		QPRINTF("lesc peer key rejected\r\n");
+		(void)sd_ble_gap_disconnect(conn_handle,BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+		return;
+	}
+	m_dhkey_active = true;
+}
+
+static void lesc_dhkey_step(void)
+{
+	uint8_t  point[P256_POINT_SIZE];
+	uint32_t err_code;
+
+	if(m_dhkey_conn == BLE_CONN_HANDLE_INVALID)
+	{
+		m_dhkey_active = false;
+		return;
+	}
+	if(!p256_mul_step(&m_dhkey,LESC_LADDER_STEPS))
+		return;
+
+	p256_mul_finish(&m_dhkey,point);
+	memcpy(m_dhkey_result.key,point,BLE_GAP_LESC_DHKEY_LEN);
+	memset(point,0,sizeof(point));
+	m_dhkey_active = false;
+
+	err_code = sd_ble_gap_lesc_dhkey_reply(m_dhkey_conn,&m_dhkey_result);
+	memset(&m_dhkey_result,0,sizeof(m_dhkey_result));
+	QPRINTF("lesc dhkey reply 0x%x\r\n",err_code);
+
+	//no flash write per pairing: the record is written with a new pair only
+	m_key.uses++;
+	if(m_key.uses >= LESC_KEY_MAX_USES)
+		lesc_keygen_start();
+}
+
+/*****************************************************************************
+ * one scheduler event: a DHKey the peer waits for goes before key generation
+*****************************************************************************/
+static void lesc_step(void *p_event_data,uint16_t event_size)
+{
+	m_step_queued = false;
+
+	if(m_next_ready)
+		lesc_key_rotate();
+
+	if(m_dhkey_request)
+		lesc_dhkey_start();
+
+	if(m_dhkey_active)
+		lesc_dhkey_step();
+	else if(m_keygen_active)
+		lesc_keygen_step();
+
+	if(m_dhkey_active || (m_keygen_active && !m_rng_wait) || (m_next_ready && !m_pairing))
+		lesc_step_queue();
+}
+
+void lesc_keys_init(void)
+{
+	pstorage_module_param_t param;
+	uint32_t                err_code;
+
+	param.block_size  = sizeof(lesc_key_t);
+	param.block_count = 1;
+	param.cb          = lesc_storage_cb;
+	err_code = pstorage_register(&param,&m_storage);
+	APP_ERROR_CHECK(err_code);
+	err_code = app_timer_create(&m_rng_timer_id,APP_TIMER_MODE_SINGLE_SHOT,lesc_rng_timeout_handler);
+	APP_ERROR_CHECK(err_code);
+
+	err_code = pstorage_load((uint8_t *)&m_key,&m_storage,sizeof(m_key),0);
+	if(err_code == NRF_SUCCESS && m_key.magic == LESC_KEY_MAGIC &&
+	   p256_scalar_valid(m_key.sk) && p256_point_valid(m_key.pk.pk))
+	{
+		m_key_valid = true;
+		(void)dm_lesc_public_key_set(&m_key.pk);
+		if(m_key.uses >= LESC_KEY_MAX_USES)
+			lesc_keygen_start();
+	}
+	else
+	{
+		//LESC pairing fails until the first pair is ready, a few hundred ms after boot
+		memset(&m_key,0,sizeof(m_key));
+		lesc_keygen_start();
+	}
+}
+
+void lesc_keys_on_ble_evt(ble_evt_t *p_ble_evt)
+{
+	switch(p_ble_evt->header.evt_id)
+	{
+		case BLE_GAP_EVT_SEC_PARAMS_REQUEST:
+			m_pairing = true;
+			break;
+
+		case BLE_GAP_EVT_LESC_DHKEY_REQUEST:
+			memcpy(&m_peer_pk,p_ble_evt->evt.gap_evt.params.lesc_dhkey_request.p_pk_peer,sizeof(m_peer_pk));
+			m_dhkey_conn    = p_ble_evt->evt.gap_evt.conn_handle;
+			m_dhkey_request = true;
+			lesc_step_queue();
+			break;
+
+		case BLE_GAP_EVT_AUTH_STATUS:
+			m_pairing = false;
+			if(m_next_ready)
+				lesc_step_queue();
+			break;
+
+		case BLE_GAP_EVT_DISCONNECTED:
+			m_pairing = false;
+			if(p_ble_evt->evt.gap_evt.conn_handle == m_dhkey_conn)
+				m_dhkey_conn = BLE_CONN_HANDLE_INVALID;
+			if(m_next_ready)
+				lesc_step_queue();
+			break;
+
+		default:
+			break;
+	}
+}
+
@@ -0,0 +1,22 @@
+#ifndef _LESC_KEYS_H_
+#define _LESC_KEYS_H_
+#include <stdint.h>
+#include "ble.h"
+
+#define LESC_KEY_MAX_USES		(8)			//LESC pairings done with one key pair before a new one is generated
+#define LESC_LADDER_STEPS		(16)		//P-256 ladder steps run per scheduler event, 256 per key
+
+
+/*****************************************************************************
+ * Local P-256 key pair for LE Secure Connections pairing. The pair is kept in
+ * flash and replaced in the background after LESC_KEY_MAX_USES pairings, so
+ * key generation never runs while a peer is waiting. The DHKey is computed in
+ * LESC_LADDER_STEPS chunks from the scheduler.
+ * Call lesc_keys_init after device_manager_init: it registers its own
+ * pstorage block after the Device Manager's.
+*****************************************************************************/
+void lesc_keys_init(void);
+void lesc_keys_on_ble_evt(ble_evt_t *p_ble_evt);
+
+#endif
+
@@ -0,0 +1,399 @@
+#include "p256.h"
+#include <string.h>
+#include "nrf_error.h"
+
+//all numbers are little endian arrays of 32 bit words
+static const uint32_t curve_p[P256_WORDS] = {
+	0xFFFFFFFF,0xFFFFFFFF,0xFFFFFFFF,0x00000000,0x00000000,0x00000000,0x00000001,0xFFFFFFFF
+};
+static const uint32_t curve_p_minus_2[P256_WORDS] = {
+	0xFFFFFFFD,0xFFFFFFFF,0xFFFFFFFF,0x00000000,0x00000000,0x00000000,0x00000001,0xFFFFFFFF
+};
+static const uint32_t curve_n[P256_WORDS] = {
+	0xFC632551,0xF3B9CAC2,0xA7179E84,0xBCE6FAAD,0xFFFFFFFF,0xFFFFFFFF,0x00000000,0xFFFFFFFF
+};
+static const uint32_t curve_b[P256_WORDS] = {
+	0x27D2604B,0x3BCE3C3E,0xCC53B0F6,0x651D06B0,0x769886BC,0xB3EBBD55,0xAA3A93E7,0x5AC635D8
+};
+static const uint32_t curve_gx[P256_WORDS] = {
+	0xD898C296,0xF4A13945,0x2DEB33A0,0x77037D81,0x63A440F2,0xF8BCE6E5,0xE12C4247,0x6B17D1F2
+};
+static const uint32_t curve_gy[P256_WORDS] = {
+	0x37BF51F5,0xCBB64068,0x6B315ECE,0x2BCE3357,0x7C0F9E16,0x8EE7EB4A,0xFE1A7F9B,0x4FE342E2
+};
+
+static void vli_from_bytes(uint32_t *r,const uint8_t *bytes)
+{
+	for(uint8_t i=0; i<P256_WORDS; i++)
+	{
+		r[i] = (uint32_t)bytes[4*i] | ((uint32_t)bytes[4*i+1]<<8) |
+			   ((uint32_t)bytes[4*i+2]<<16) | ((uint32_t)bytes[4*i+3]<<24);
+	}
+}
+
+static void vli_to_bytes(uint8_t *bytes,const uint32_t *a)
+{
+	for(uint8_t i=0; i<P256_WORDS; i++)
+	{
+		bytes[4*i]   = (uint8_t)a[i];
+		bytes[4*i+1] = (uint8_t)(a[i]>>8);
+		bytes[4*i+2] = (uint8_t)(a[i]>>16);
+		bytes[4*i+3] = (uint8_t)(a[i]>>24);
+	}
+}
+
+static uint32_t vli_add(uint32_t *r,const uint32_t *a,const uint32_t *b)
+{
+	uint64_t acc = 0;
+	for(uint8_t i=0; i<P256_WORDS; i++)
+	{
+		acc += (uint64_t)a[i] + b[i];
+		r[i] = (uint32_t)acc;
+		acc >>= 32;
+	}
+	return (uint32_t)acc;
+}
+
+static uint32_t vli_sub(uint32_t *r,const uint32_t *a,const uint32_t *b)
+{
+	int64_t acc = 0;
+	for(uint8_t i=0; i<P256_WORDS; i++)
+	{
+		acc += (int64_t)a[i] - b[i];
+		r[i] = (uint32_t)acc;
+		acc >>= 32;
+	}
+	return (uint32_t)(-acc);
+}
+
+//-1, 0 or 1 as a<b, a==b or a>b, in the same time whatever the values
+static int8_t vli_cmp(const uint32_t *a,const uint32_t *b)
+{
+	uint32_t t[P256_WORDS];
+	uint32_t less    = vli_sub(t,a,b);
+	uint32_t greater = vli_sub(t,b,a);
+
+	return (int8_t)greater - (int8_t)less;
+}
+
+//r = a if select is 1, r unchanged if 0, without a branch
+static void vli_select(uint32_t *r,const uint32_t *a,uint32_t select)
+{
+	uint32_t mask = 0 - select;
+
+	for(uint8_t i=0; i<P256_WORDS; i++)
+		r[i] ^= (r[i] ^ a[i]) & mask;
+}
+
+/*****************************************************************************
+ * field operations take the same path whatever the values: the modulus is
+ * subtracted or added as a masked copy, never under a branch
+*****************************************************************************/
+static void fe_add(uint32_t *r,const uint32_t *a,const uint32_t *b)
+{
+	uint32_t t[P256_WORDS];
+	uint32_t carry  = vli_add(r,a,b);
+	uint32_t borrow = vli_sub(t,r,curve_p);
+
+	vli_select(r,t,carry | (borrow ^ 1));
+}
+
+static void fe_sub(uint32_t *r,const uint32_t *a,const uint32_t *b)
+{
+	uint32_t t[P256_WORDS];
+	uint32_t borrow = vli_sub(r,a,b);
+
+	vli_add(t,r,curve_p);
+	vli_select(r,t,borrow);
+}
+
+/*****************************************************************************
+ * reduction of a 512 bit product, FIPS 186-4 D.2.3: the upper words are
+ * folded in using 2^256 = 2^224 - 2^192 - 2^96 + 1 (mod p).
+ * The first pass leaves a carry within +-8, folding it in leaves one within
+ * +-1, and folding that one in leaves none, so the passes are always three.
+ * The result is then below 2^256 < 2p, one masked subtraction of p is enough.
+*****************************************************************************/
+#define FE_REDUCE_PASSES	(3)
+
+static void fe_reduce(uint32_t *r,const uint32_t *c)
+{
+	int64_t  w[P256_WORDS];
+	int64_t  carry = 0;
+	uint32_t t[P256_WORDS];
+
+	w[0] = (int64_t)c[0] + c[8]  + c[9]  - c[11] - c[12] - c[13] - c[14];
+	w[1] = (int64_t)c[1] + c[9]  + c[10] - c[12] - c[13] - c[14] - c[15];
+	w[2] = (int64_t)c[2] + c[10] + c[11] - c[13] - c[14] - c[15];
+	w[3] = (int64_t)c[3] + 2*(int64_t)c[11] + 2*(int64_t)c[12] + c[13] - c[15] - c[8] - c[9];
+	w[4] = (int64_t)c[4] + 2*(int64_t)c[12] + 2*(int64_t)c[13] + c[14] - c[9] - c[10];
+	w[5] = (int64_t)c[5] + 2*(int64_t)c[13] + 2*(int64_t)c[14] + c[15] - c[10] - c[11];
+	w[6] = (int64_t)c[6] + 3*(int64_t)c[14] + 2*(int64_t)c[15] + c[13] - c[8] - c[9];
+	w[7] = (int64_t)c[7] + 3*(int64_t)c[15] + c[8] - c[10] - c[11] - c[12] - c[13];
+
+	for(uint8_t pass=0; pass<FE_REDUCE_PASSES; pass++)
+	{
+		w[0] += carry;
+		w[3] -= carry;
+		w[6] -= carry;
+		w[7] += carry;
+		carry = 0;
+		for(uint8_t i=0; i<P256_WORDS; i++)
+		{
+			carry += w[i];
+			w[i]   = (uint32_t)carry;
+			carry >>= 32;
+		}
+	}
+
+	for(uint8_t i=0; i<P256_WORDS; i++)
+		r[i] = (uint32_t)w[i];
+	vli_select(r,t,vli_sub(t,r,curve_p) ^ 1);
+}
+
+static void fe_mul(uint32_t *r,const uint32_t *a,const uint32_t *b)
+{
+	uint32_t c[2*P256_WORDS];
+
+	memset(c,0,sizeof(c));
+	for(uint8_t i=0; i<P256_WORDS; i++)
+	{
+		uint64_t acc = 0;
+		for(uint8_t j=0; j<P256_WORDS; j++)
+		{
+			acc     += (uint64_t)a[i]*b[j] + c[i+j];
+			c[i+j]   = (uint32_t)acc;
+			acc    >>= 32;
+		}
+		c[i+P256_WORDS] = (uint32_t)acc;
+	}
+	fe_reduce(r,c);
+}
+
+static void fe_sqr(uint32_t *r,const uint32_t *a)
+{
+	fe_mul(r,a,a);
+}
+
+//a^(p-2)
+static void fe_inv(uint32_t *r,const uint32_t *a)
+{
+	uint32_t t[P256_WORDS];
+
+	memset(t,0,sizeof(t));
+	t[0] = 1;
+	for(int16_t i=256-1; i>=0; i--)
+	{
+		fe_sqr(t,t);
+		if(curve_p_minus_2[i/32] & (1UL<<(i%32)))
+			fe_mul(t,t,a);
+	}
+	memcpy(r,t,sizeof(t));
+}
+
+//dbl-2001-b, a = -3
+static void point_double(p256_jacobian_t *r,const p256_jacobian_t *a)
+{
+	uint32_t delta[P256_WORDS],gamma[P256_WORDS],beta[P256_WORDS],alpha[P256_WORDS];
+	uint32_t t1[P256_WORDS],t2[P256_WORDS];
+
+	fe_sqr(delta,a->z);
+	fe_sqr(gamma,a->y);
+	fe_mul(beta,a->x,gamma);
+
+	fe_sub(t1,a->x,delta);
+	fe_add(t2,a->x,delta);
+	fe_mul(t1,t1,t2);
+	fe_add(alpha,t1,t1);
+	fe_add(alpha,alpha,t1);
+
+	fe_add(r->z,a->y,a->z);
+	fe_sqr(r->z,r->z);
+	fe_sub(r->z,r->z,gamma);
+	fe_sub(r->z,r->z,delta);
+
+	fe_add(beta,beta,beta);
+	fe_add(beta,beta,beta);					//4*beta
+	fe_sqr(r->x,alpha);
+	fe_add(t1,beta,beta);
+	fe_sub(r->x,r->x,t1);
+
+	fe_sub(t1,beta,r->x);
+	fe_mul(r->y,alpha,t1);
+	fe_sqr(t2,gamma);
+	fe_add(t2,t2,t2);
+	fe_add(t2,t2,t2);
+	fe_add(t2,t2,t2);						//8*gamma^2
+	fe_sub(r->y,r->y,t2);
+}
+
+//add-2007-bl, a != +-b and neither at infinity, which the ladder guarantees
+static void point_add(p256_jacobian_t *r,const p256_jacobian_t *a,const p256_jacobian_t *b)
+{
+	uint32_t z1z1[P256_WORDS],z2z2[P256_WORDS],u1[P256_WORDS],u2[P256_WORDS];
+	uint32_t s1[P256_WORDS],s2[P256_WORDS],h[P256_WORDS],i[P256_WORDS];
+	uint32_t j[P256_WORDS],v[P256_WORDS],t[P256_WORDS];
+
+	fe_sqr(z1z1,a->z);
+	fe_sqr(z2z2,b->z);
+	fe_mul(u1,a->x,z2z2);
+	fe_mul(u2,b->x,z1z1);
+	fe_mul(s1,a->y,b->z);
+	fe_mul(s1,s1,z2z2);
+	fe_mul(s2,b->y,a->z);
+	fe_mul(s2,s2,z1z1);
+
+	fe_sub(h,u2,u1);
+	fe_add(i,h,h);
+	fe_sqr(i,i);
+	fe_mul(j,h,i);
+	fe_sub(s2,s2,s1);
+	fe_add(s2,s2,s2);						//r
+	fe_mul(v,u1,i);
+
+	fe_add(t,a->z,b->z);
+	fe_sqr(t,t);
+	fe_sub(t,t,z1z1);
+	fe_sub(t,t,z2z2);
+	fe_mul(r->z,t,h);
+
+	fe_sqr(r->x,s2);
+	fe_sub(r->x,r->x,j);
+	fe_sub(r->x,r->x,v);
+	fe_sub(r->x,r->x,v);
+
+	fe_sub(t,v,r->x);
+	fe_mul(t,s2,t);
+	fe_mul(s1,s1,j);
+	fe_add(s1,s1,s1);
+	fe_sub(r->y,t,s1);
+}
+
+static void point_swap(p256_jacobian_t *a,p256_jacobian_t *b,uint32_t swap)
+{
+	uint32_t mask = 0 - swap;
+	uint32_t *pa = (uint32_t *)a;
+	uint32_t *pb = (uint32_t *)b;
+
+	for(uint8_t i=0; i<3*P256_WORDS; i++)
+	{
+		uint32_t t = (pa[i] ^ pb[i]) & mask;
+		pa[i] ^= t;
+		pb[i] ^= t;
+	}
+}
+
+static bool point_on_curve(const uint32_t *x,const uint32_t *y)
+{
+	uint32_t lhs[P256_WORDS],rhs[P256_WORDS],t[P256_WORDS];
+
+	if(vli_cmp(x,curve_p) >= 0 || vli_cmp(y,curve_p) >= 0)
+		return false;
+
+	fe_sqr(lhs,y);
+	fe_sqr(rhs,x);
+	fe_mul(rhs,rhs,x);
+	fe_add(t,x,x);
+	fe_add(t,t,x);
+	fe_sub(rhs,rhs,t);
+	fe_add(rhs,rhs,curve_b);
+	return vli_cmp(lhs,rhs) == 0;
+}
+
+/*****************************************************************************
+ * 1, n-2 and n-1 are rejected as well: with them the last ladder step would
+ * meet the point at infinity, which the formulas above do not handle.
+*****************************************************************************/
+bool p256_scalar_valid(const uint8_t *k)
+{
+	uint32_t w[P256_WORDS];
+	uint32_t t[P256_WORDS];
+
+	vli_from_bytes(w,k);
+	memset(t,0,sizeof(t));
+	t[0] = 1;
+	if(vli_cmp(w,t) <= 0)
+		return false;
+	t[0] = 2;
+	if(vli_add(t,w,t))
+		return false;
+	return vli_cmp(t,curve_n) < 0;
+}
+
+bool p256_point_valid(const uint8_t *point)
+{
+	uint32_t x[P256_WORDS],y[P256_WORDS];
+
+	vli_from_bytes(x,point);
+	vli_from_bytes(y,point+P256_SCALAR_SIZE);
+	return point_on_curve(x,y);
+}
+
+uint32_t p256_mul_start(p256_mul_t *ctx,const uint8_t *k,const uint8_t *point)
+{
+	uint32_t kn[P256_WORDS+1],k2n[P256_WORDS+1];
+
+	if(!p256_scalar_valid(k))
+		return NRF_ERROR_INVALID_PARAM;
+
+	if(point == NULL)
+	{
+		memcpy(ctx->r[0].x,curve_gx,sizeof(curve_gx));
+		memcpy(ctx->r[0].y,curve_gy,sizeof(curve_gy));
+	}
+	else
+	{
+		vli_from_bytes(ctx->r[0].x,point);
+		vli_from_bytes(ctx->r[0].y,point+P256_SCALAR_SIZE);
+		if(!point_on_curve(ctx->r[0].x,ctx->r[0].y))
+			return NRF_ERROR_INVALID_DATA;
+	}
+	memset(ctx->r[0].z,0,sizeof(ctx->r[0].z));
+	ctx->r[0].z[0] = 1;
+	point_double(&ctx->r[1],&ctx->r[0]);
+
+	//fixed length scalar: k+n has bit 256 set, or else k+2n does
+	vli_from_bytes(kn,k);
+	kn[P256_WORDS]  = vli_add(kn,kn,curve_n);
+	k2n[P256_WORDS] = kn[P256_WORDS] + vli_add(k2n,kn,curve_n);
+	ctx->k[P256_WORDS] = 1;
+	memcpy(ctx->k,k2n,sizeof(k2n[0])*P256_WORDS);
+	vli_select(ctx->k,kn,kn[P256_WORDS]);
+	memset(kn,0,sizeof(kn));
+	memset(k2n,0,sizeof(k2n));
+
+	ctx->bit = 255;
+	return NRF_SUCCESS;
+}
+
+bool p256_mul_step(p256_mul_t *ctx,uint16_t steps)
+{
+	while(steps-- && ctx->bit >= 0)
+	{
+		uint32_t b = (ctx->k[ctx->bit/32] >> (ctx->bit%32)) & 1;
+
+		point_swap(&ctx->r[0],&ctx->r[1],b);
+		point_add(&ctx->r[1],&ctx->r[0],&ctx->r[1]);
+		point_double(&ctx->r[0],&ctx->r[0]);
+		point_swap(&ctx->r[0],&ctx->r[1],b);
+		ctx->bit--;
+	}
+	return ctx->bit < 0;
+}
+
+void p256_mul_finish(p256_mul_t *ctx,uint8_t *point)
+{
+	uint32_t zi[P256_WORDS],zi2[P256_WORDS],t[P256_WORDS];
+
+	fe_inv(zi,ctx->r[0].z);
+	fe_sqr(zi2,zi);
+	fe_mul(t,ctx->r[0].x,zi2);
+	vli_to_bytes(point,t);
+	fe_mul(zi2,zi2,zi);
+	fe_mul(t,ctx->r[0].y,zi2);
+	vli_to_bytes(point+P256_SCALAR_SIZE,t);
+
+	memset(ctx,0,sizeof(p256_mul_t));
+	ctx->bit = -1;
+}
+
@@ -0,0 +1,42 @@
+#ifndef _P256_H_
+#define _P256_H_
+#include <stdint.h>
+#include <stdbool.h>
+
+#define P256_WORDS			(8)
+#define P256_SCALAR_SIZE	(32)		//little endian
+#define P256_POINT_SIZE		(64)		//X then Y, both little endian as in SMP
+
+
+typedef struct
+{
+	uint32_t x[P256_WORDS];
+	uint32_t y[P256_WORDS];
+	uint32_t z[P256_WORDS];
+} p256_jacobian_t;
+
+/*****************************************************************************
+ * k*P on the NIST P-256 curve as a Montgomery ladder of 256 steps, so the
+ * caller can spread one multiplication over several scheduler events.
+*****************************************************************************/
+typedef struct
+{
+	uint32_t		k[P256_WORDS+1];	//k+n or k+2n, bit 256 always set
+	p256_jacobian_t	r[2];				//r[1]-r[0] == P
+	int16_t			bit;				//next bit of k, -1 when the ladder is done
+} p256_mul_t;
+
+
+bool p256_scalar_valid(const uint8_t *k);
+bool p256_point_valid(const uint8_t *point);
+
+/*****************************************************************************
+ * point NULL multiplies the base point. Returns NRF_ERROR_INVALID_PARAM if k
+ * is not in [2,n-3] and NRF_ERROR_INVALID_DATA if point is not on the curve.
+*****************************************************************************/
+uint32_t p256_mul_start(p256_mul_t *ctx,const uint8_t *k,const uint8_t *point);
+bool     p256_mul_step(p256_mul_t *ctx,uint16_t steps);		//true when the ladder is done
+void     p256_mul_finish(p256_mul_t *ctx,uint8_t *point);	//affine result, one field inversion
+
+#endif
+
@@ -1,125 +1,170 @@
 #include "time.h"
+#include <stdbool.h>
+#include "app_timer.h"
+#include "app_util_platform.h"
 #include "debug.h"
 
-#define YEAR_BASE 		(1970)
 #define DAY_SEC      	(86400)		/* one day second = 24*60*60 */
 
 #define APP_TIMER_PRESCALER         0
 
-static unsigned int gTime_sec = 0;
+#define TIME_TICK_SHIFT				(15)		/* RTC1 runs at 32768Hz without prescaler */
+#define TIME_COUNTER_MASK			(0x00FFFFFF)	/* RTC1 is 24 bit and wraps every 512s */
+#define TIME_GUARD_INTERVAL			APP_TIMER_TICKS(240000, APP_TIMER_PRESCALER)
+
+#define TIME_DRIFT_CORRECTION		1			/* learn the LFCLK error from phone time syncs */
+#define TIME_DRIFT_SHIFT			(24)		/* drift unit is 2^-24, about 0.06ppm */
+#define TIME_DRIFT_MAX				((int32_t)((500LL << TIME_DRIFT_SHIFT) / 1000000))	/* 500ppm, worse than the RC oscillator */
+#define TIME_DRIFT_MIN_SPAN			((uint64_t)12 * 3600 << TIME_TICK_SHIFT)	/* 1s sync resolution is 23ppm over 12h */
+
+APP_TIMER_DEF(m_time_guard_id);
+
+static uint64_t m_ticks = 0;			/* RTC1 ticks with the wraps added back */
+static uint32_t m_last_cnt = 0;
+static uint64_t m_base_ticks = 0;		/* m_ticks when the time was last set */
+static unsigned int m_base_sec = 0;		/* local time at m_base_ticks */
+static int32_t m_drift = 0;				/* positive when the LFCLK runs slow */
+static bool m_synced = false;			/* m_base_sec came from the phone */
 static unsigned char g_timezone = 0x50;//8
 
-static char isleap(unsigned short year)
+/* must be called at least once per RTC1 wrap, the guard timer makes sure of that */
+static uint64_t time_ticks_get(void)
 {
-    return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+	uint32_t cnt;
+
+	(void)app_timer_cnt_get(&cnt);
+	m_ticks += (cnt - m_last_cnt) & TIME_COUNTER_MASK;
+	m_last_cnt = cnt;
+	return m_ticks;
 }
 
-static unsigned short get_yeardays(unsigned short year) 
+/* ticks since m_base_ticks, corrected for the LFCLK error */
+static int64_t time_elapsed_get(uint64_t ticks)
 {
-    if (isleap(year))
-        return 366;
-    return 365;
+	int64_t elapsed = (int64_t)(ticks - m_base_ticks);
+
+	return elapsed + ((elapsed * m_drift) >> TIME_DRIFT_SHIFT);
 }
 
-static unsigned char CaculateWeekDay(unsigned short y,unsigned char m, unsigned char d)
+/* days since 1970-01-01 to civil date and back, constant time (H. Hinnant's algorithms) */
+static unsigned int days_from_civil(unsigned short y,unsigned char m,unsigned char d)
 {
-	unsigned char week = 0;
-    if(m==1||m==2) {
-        m+=12;
-        y--;
-    }
-    week=(d+2*m+3*(m+1)/5+y+y/4-y/100+y/400)%7;	
-	return week;
+	unsigned int era,yoe,doy,doe;
+
+	y  -= (m <= 2);
+	era = y / 400;
+	yoe = y - era * 400;
+	doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
 }
 
-void system_time_set(s_tm tm)
+static void civil_from_days(unsigned int days,s_tm *tm)
 {
-	unsigned int retDay = 0;
-	unsigned short year = tm.year;
-	unsigned char i,mons[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
-	if(tm.month>12 || tm.month==0 || tm.day>31 || tm.day == 0 || tm.hour > 23 || tm.minute >59)
-		return;
-	if(tm.second > 59)
-		tm.second = 0;
-	
-	while((year--)>YEAR_BASE)
-	{
-		retDay += get_yeardays(year);
-	}
+	unsigned int era,doe,yoe,doy,mp;
+
+	days += 719468;
+	era = days / 146097;
+	doe = days - era * 146097;
+	yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	mp  = (5 * doy + 2) / 153;
+
+	tm->day   = doy - (153 * mp + 2) / 5 + 1;
+	tm->month = (mp < 10) ? mp + 3 : mp - 9;
+	tm->year  = yoe + era * 400 + (tm->month <= 2);
+}
 
-	if (isleap(tm.year)) 
-		mons[1] += 1;
-	
-	for (i = 1; i < tm.month; i++) 
+static void time_base_set(unsigned int sec,bool synced)
+{
+	uint64_t ticks;
+#if TIME_DRIFT_CORRECTION
+	uint64_t span;
+	int64_t error;
+	int32_t measured;
+#endif
+
+	CRITICAL_REGION_ENTER();
+	ticks = time_ticks_get();
+#if TIME_DRIFT_CORRECTION
+	/* the phone's time against ours since the last sync, both truncated to 1s */
+	span = ticks - m_base_ticks;
+	if(synced && m_synced && span >= TIME_DRIFT_MIN_SPAN)
 	{
-		retDay += mons[i-1];
+		error = ((int64_t)(int32_t)(sec - m_base_sec) << TIME_TICK_SHIFT) - time_elapsed_get(ticks);
+		if(error <= (int64_t)(span >> 10) && error >= -(int64_t)(span >> 10))		/* otherwise the time was changed */
+		{
+			measured = (int32_t)((error << TIME_DRIFT_SHIFT) / (int64_t)span);
+			m_drift += measured / 2;
+			if(m_drift > TIME_DRIFT_MAX)
+				m_drift = TIME_DRIFT_MAX;
+			if(m_drift < -TIME_DRIFT_MAX)
+				m_drift = -TIME_DRIFT_MAX;
+		}
 	}
+#endif
+	m_base_ticks = ticks;
+	m_base_sec = sec;
+	m_synced = synced;
+	CRITICAL_REGION_EXIT();
+}
+
+static void time_guard_handler(void * p_context)
+{
+	CRITICAL_REGION_ENTER();
+	(void)time_ticks_get();
+	CRITICAL_REGION_EXIT();
+}
 
-	retDay += tm.day-1;
+void system_time_set(s_tm tm)
+{
+	unsigned int days;
 
-	retDay *= DAY_SEC;
+	if(tm.month>12 || tm.month==0 || tm.day>31 || tm.day == 0 || tm.hour > 23 || tm.minute >59 || tm.year < 1970)
+		return;
+	if(tm.second > 59)
+		tm.second = 0;
 
-	retDay += tm.hour*3600;
-	retDay += tm.minute*60;
-	retDay += tm.second;
-	gTime_sec = retDay;
+	days = days_from_civil(tm.year,tm.month,tm.day);
+	time_base_set(days * DAY_SEC + tm.hour * 3600 + tm.minute * 60 + tm.second,false);
 }
 
 void system_time_get(s_tm *tm) 
 {
-	unsigned char i, mons[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
-	unsigned short curr_day = 0;
-	unsigned int days = 0;
-	days = gTime_sec/DAY_SEC;
-	
-	curr_day = get_yeardays(tm->year = YEAR_BASE);
-    while (days >= curr_day)
-	{
-        days -= curr_day;
-        tm->year += 1;
-        curr_day = get_yeardays(tm->year);
-    }
-	
-    if (isleap(tm->year))
-		mons[1] += 1;
-    for (i = 0; i < 12; i++) 
-	{
-        if (days < mons[i]) 
-		{
-            tm->month = i+1;
-            tm->day = days+1;
-            break;
-        }
-		else
-        	days -= mons[i];
-    }
-	
-	tm->hour = (gTime_sec % DAY_SEC)/(3600);
-    tm->minute = (gTime_sec % DAY_SEC)%(3600)/60;
-    tm->second = (gTime_sec % DAY_SEC)%60;
-	tm->weekdays = CaculateWeekDay(tm->year,tm->month,tm->day);
+	unsigned int sec = system_sec_get();
+
+	civil_from_days(sec / DAY_SEC,tm);
+	tm->hour = (sec % DAY_SEC)/(3600);
+	tm->minute = (sec % DAY_SEC)%(3600)/60;
+	tm->second = (sec % DAY_SEC)%60;
+	tm->weekdays = (sec / DAY_SEC + 3) % 7;	/* 1970-01-01 was a Thursday, Monday is 0 */
 }
 
 void system_sec_set(unsigned int time)
 {
 	unsigned int timezone = 0;
-  	gTime_sec = time;
 
 	if(g_timezone > 0x30)
 	{
 		timezone = (g_timezone - 0x30)*900;
-		gTime_sec += timezone;
+		time += timezone;
 	}
 	else
 	{
 		timezone = (0x30 - g_timezone)*900;
-		gTime_sec -= timezone;
+		time -= timezone;
 	}
+	time_base_set(time,true);
 }
 
 unsigned int system_sec_get(void)
 {
-	return gTime_sec;
+	unsigned int sec;
+
+	CRITICAL_REGION_ENTER();
+	sec = m_base_sec + (unsigned int)(time_elapsed_get(time_ticks_get()) >> TIME_TICK_SHIFT);
+	CRITICAL_REGION_EXIT();
+	return sec;
 }
 
 void system_timezone_set(unsigned char timezone)
@@ -132,15 +177,28 @@ unsigned char system_timezone_get(void)
 	return g_timezone;
 }
 
-
-void system_time_tick(void * p_context)
+int32_t system_time_drift_get(void)
 {
-	gTime_sec++;
+	return m_drift;
 }
 
-void system_time_init(void)
+/*
+ * No tick: the time is worked out from the RTC1 counter when asked for. The guard
+ * timer only folds the counter wraps in and keeps app_timer from stopping RTC1,
+ * which would clear the counter.
+ */
+uint32_t system_time_init(void)
 {
+	uint32_t err_code;
 	s_tm tm;
+
+	err_code = app_timer_create(&m_time_guard_id, APP_TIMER_MODE_REPEATED, time_guard_handler);
+	if(err_code != NRF_SUCCESS)
+		return err_code;
+	err_code = app_timer_start(m_time_guard_id, TIME_GUARD_INTERVAL, NULL);
+	if(err_code != NRF_SUCCESS)
+		return err_code;
+
 	tm.year 	= 2016;
 	tm.month 	= 1;
 	tm.day 		= 1;
@@ -148,7 +206,5 @@ void system_time_init(void)
 	tm.minute 	= 0;
 	tm.second	= 0;
 	system_time_set(tm);
+	return NRF_SUCCESS;
 }
-
-
-
@@ -22,11 +22,9 @@ void system_timezone_set(unsigned char timezone);
 
 unsigned char system_timezone_get(void);
 
-extern void system_time_init(void);
+extern uint32_t system_time_init(void);
 
-
-
-void system_time_tick(void * p_context);
+int32_t system_time_drift_get(void);	/* learnt LFCLK error in 2^-24, positive when slow */
 
 #endif
 
@@ -56,10 +56,10 @@
 #define TIMER0_INSTANCE_INDEX      0
 #endif
 
-#define TIMER1_ENABLED 0
+#define TIMER1_ENABLED 1			//PPG sampling clock
 
 #if (TIMER1_ENABLED == 1)
-#define TIMER1_CONFIG_FREQUENCY    NRF_TIMER_FREQ_16MHz
+#define TIMER1_CONFIG_FREQUENCY    NRF_TIMER_FREQ_1MHz
 #define TIMER1_CONFIG_MODE         TIMER_MODE_MODE_Timer
 #define TIMER1_CONFIG_BIT_WIDTH    TIMER_BITMODE_BITMODE_16Bit
 #define TIMER1_CONFIG_IRQ_PRIORITY APP_IRQ_PRIORITY_LOW
@@ -150,13 +150,13 @@
 
 /* PWM */
 
-#define PWM0_ENABLED 0
+#define PWM0_ENABLED 1
 
 #if (PWM0_ENABLED == 1)
-#define PWM0_CONFIG_OUT0_PIN        2
-#define PWM0_CONFIG_OUT1_PIN        3
-#define PWM0_CONFIG_OUT2_PIN        4
-#define PWM0_CONFIG_OUT3_PIN        5
+#define PWM0_CONFIG_OUT0_PIN        18      // vibration motor driver, high = on. PLACEHOLDER: BSP_LED_1 of pca10040.h, not the band's pin
+#define PWM0_CONFIG_OUT1_PIN        NRF_DRV_PWM_PIN_NOT_USED
+#define PWM0_CONFIG_OUT2_PIN        NRF_DRV_PWM_PIN_NOT_USED
+#define PWM0_CONFIG_OUT3_PIN        NRF_DRV_PWM_PIN_NOT_USED
 #define PWM0_CONFIG_IRQ_PRIORITY    APP_IRQ_PRIORITY_LOW
 #define PWM0_CONFIG_BASE_CLOCK      NRF_PWM_CLK_1MHz
 #define PWM0_CONFIG_COUNT_MODE      NRF_PWM_MODE_UP
@@ -167,13 +167,13 @@
 #define PWM0_INSTANCE_INDEX 0
 #endif
 
-#define PWM1_ENABLED 0
+#define PWM1_ENABLED 1
 
 #if (PWM1_ENABLED == 1)
-#define PWM1_CONFIG_OUT0_PIN        2
-#define PWM1_CONFIG_OUT1_PIN        3
-#define PWM1_CONFIG_OUT2_PIN        4
-#define PWM1_CONFIG_OUT3_PIN        5
+#define PWM1_CONFIG_OUT0_PIN        (17 | NRF_DRV_PWM_PIN_INVERTED) // BSP_LED_0, low = on, idles high
+#define PWM1_CONFIG_OUT1_PIN        NRF_DRV_PWM_PIN_NOT_USED
+#define PWM1_CONFIG_OUT2_PIN        NRF_DRV_PWM_PIN_NOT_USED
+#define PWM1_CONFIG_OUT3_PIN        NRF_DRV_PWM_PIN_NOT_USED
 #define PWM1_CONFIG_IRQ_PRIORITY    APP_IRQ_PRIORITY_LOW
 #define PWM1_CONFIG_BASE_CLOCK      NRF_PWM_CLK_1MHz
 #define PWM1_CONFIG_COUNT_MODE      NRF_PWM_MODE_UP
@@ -314,14 +314,14 @@
 #define TWI0_INSTANCE_INDEX      0
 #endif
 
-#define TWI1_ENABLED 0
+#define TWI1_ENABLED 1			//TWI0 shares its peripheral with SPIS0
 
 #if (TWI1_ENABLED == 1)
-#define TWI1_USE_EASY_DMA 0
+#define TWI1_USE_EASY_DMA 1
 
-#define TWI1_CONFIG_FREQUENCY    NRF_TWI_FREQ_100K
-#define TWI1_CONFIG_SCL          0
-#define TWI1_CONFIG_SDA          1
+#define TWI1_CONFIG_FREQUENCY    NRF_TWI_FREQ_400K
+#define TWI1_CONFIG_SCL          27      // UNVERIFIED: ARDUINO_SCL_PIN of pca10040.h, not the band's pin
+#define TWI1_CONFIG_SDA          26      // UNVERIFIED: ARDUINO_SDA_PIN of pca10040.h
 #define TWI1_CONFIG_IRQ_PRIORITY APP_IRQ_PRIORITY_LOW
 
 #define TWI1_INSTANCE_INDEX      (TWI0_ENABLED)
@@ -385,10 +385,10 @@
 
 
 /* SAADC */
-#define SAADC_ENABLED 0
+#define SAADC_ENABLED 1
 
 #if (SAADC_ENABLED == 1)
-#define SAADC_CONFIG_RESOLUTION      NRF_SAADC_RESOLUTION_10BIT
+#define SAADC_CONFIG_RESOLUTION      NRF_SAADC_RESOLUTION_12BIT
 #define SAADC_CONFIG_OVERSAMPLE      NRF_SAADC_OVERSAMPLE_DISABLED
 #define SAADC_CONFIG_IRQ_PRIORITY    APP_IRQ_PRIORITY_LOW
 #endif
@@ -459,6 +459,42 @@
 #define I2S_CONFIG_RATIO        NRF_I2S_RATIO_256X
 #endif
 
+/* Pin checks */
+/* The band's schematic is not in this tree. Pins marked PLACEHOLDER or UNVERIFIED above come
+ * from the PCA10040 board the project builds for; these keep them off pins a bus already drives. */
+#include "twi_master_config.h"
+
+#if (PWM0_ENABLED == 1) && \
+    ((PWM0_CONFIG_OUT0_PIN == TWI_MASTER_CONFIG_CLOCK_PIN_NUMBER) || \
+     (PWM0_CONFIG_OUT0_PIN == TWI_MASTER_CONFIG_DATA_PIN_NUMBER))
+#error "PWM0_CONFIG_OUT0_PIN is a TWI master pin, see twi_master_config.h."
+#endif
+
+#if (PWM0_ENABLED == 1) && (TWI1_ENABLED == 1) && \
+    ((PWM0_CONFIG_OUT0_PIN == TWI1_CONFIG_SCL) || (PWM0_CONFIG_OUT0_PIN == TWI1_CONFIG_SDA))
+#error "PWM0_CONFIG_OUT0_PIN is a TWI1 pin."
+#endif
+
+#if (PWM0_ENABLED == 1) && (I2S_ENABLED == 1) && \
+    ((PWM0_CONFIG_OUT0_PIN == I2S_CONFIG_SCK_PIN) || (PWM0_CONFIG_OUT0_PIN == I2S_CONFIG_LRCK_PIN) || \
+     (PWM0_CONFIG_OUT0_PIN == I2S_CONFIG_SDOUT_PIN) || (PWM0_CONFIG_OUT0_PIN == I2S_CONFIG_SDIN_PIN))
+#error "PWM0_CONFIG_OUT0_PIN is an I2S pin."
+#endif
+
+#if (TWI1_ENABLED == 1) && \
+    ((TWI1_CONFIG_SCL == TWI_MASTER_CONFIG_CLOCK_PIN_NUMBER) || (TWI1_CONFIG_SCL == TWI_MASTER_CONFIG_DATA_PIN_NUMBER) || \
+     (TWI1_CONFIG_SDA == TWI_MASTER_CONFIG_CLOCK_PIN_NUMBER) || (TWI1_CONFIG_SDA == TWI_MASTER_CONFIG_DATA_PIN_NUMBER))
+#error "TWI1 shares a pin with the TWI master, see twi_master_config.h."
+#endif
+
+#if (TWI1_ENABLED == 1) && (I2S_ENABLED == 1) && \
+    ((TWI1_CONFIG_SCL == I2S_CONFIG_SCK_PIN) || (TWI1_CONFIG_SCL == I2S_CONFIG_LRCK_PIN) || \
+     (TWI1_CONFIG_SCL == I2S_CONFIG_SDOUT_PIN) || (TWI1_CONFIG_SCL == I2S_CONFIG_SDIN_PIN) || \
+     (TWI1_CONFIG_SDA == I2S_CONFIG_SCK_PIN) || (TWI1_CONFIG_SDA == I2S_CONFIG_LRCK_PIN) || \
+     (TWI1_CONFIG_SDA == I2S_CONFIG_SDOUT_PIN) || (TWI1_CONFIG_SDA == I2S_CONFIG_SDIN_PIN))
+#error "TWI1 shares a pin with I2S."
+#endif
+
 #include "nrf_drv_config_validation.h"
 
 #endif // NRF_DRV_CONFIG_H
@@ -40,7 +40,7 @@ static __INLINE uint32_t pstorage_flash_page_end()
 
 #define PSTORAGE_FLASH_PAGE_END     pstorage_flash_page_end()
 
-#define PSTORAGE_NUM_OF_PAGES       2                                                           /**< Number of flash pages allocated for the pstorage module excluding the swap page, configurable based on system requirements. */
+#define PSTORAGE_NUM_OF_PAGES       3                                                           /**< Number of flash pages allocated for the pstorage module excluding the swap page, configurable based on system requirements. One per registered module: device manager, LESC keys, activity rollup. */
 #define PSTORAGE_MIN_BLOCK_SIZE     0x0010                                                      /**< Minimum size of block that can be registered with the module. Should be configured based on system requirements, recommendation is not have this value to be at least size of word. */
 
 #define PSTORAGE_DATA_START_ADDR    ((PSTORAGE_FLASH_PAGE_END - PSTORAGE_NUM_OF_PAGES - 1) \
@@ -51,6 +51,17 @@ static __INLINE uint32_t pstorage_flash_page_end()
 #define PSTORAGE_MAX_BLOCK_SIZE     PSTORAGE_FLASH_PAGE_SIZE                                    /**< Maximum size of block that can be registered with the module. Should be configured based on system requirements. And should be greater than or equal to the minimum size. */
 #define PSTORAGE_CMD_QUEUE_SIZE     10                                                          /**< Maximum number of flash access commands that can be maintained by the module for all applications. Configurable. */
 
+#define PSTORAGE_REMAP_ENABLE                                                                   /**< Updates of small blocks are appended to a log instead of going through the swap page. Comment out to disable. */
+#define PSTORAGE_REMAP_MAX_BLOCK_SIZE   0x0100                                                  /**< Blocks up to this size, in bytes, are remapped into the log. Larger blocks are always updated in place. */
+#define PSTORAGE_REMAP_MAX_BLOCKS       8                                                       /**< Maximum number of blocks that can be remapped into the log at the same time. */
+#define PSTORAGE_REMAP_LOG_PAGES    2                                                           /**< Number of flash pages used for the log. The log alternates between two pages, do not change. */
+#define PSTORAGE_REMAP_LOG_ADDR     (PSTORAGE_DATA_START_ADDR - (PSTORAGE_REMAP_LOG_PAGES * PSTORAGE_FLASH_PAGE_SIZE)) /**< Start of the flash pages used for the log, right below the data pages. */
+
+#define PSTORAGE_RESERVED_PAGES     (PSTORAGE_REMAP_LOG_PAGES + PSTORAGE_NUM_OF_PAGES + 1)      /**< Flash pages below PSTORAGE_FLASH_PAGE_END used by the module: log, data and swap. The application must not be linked into them: the IROM1 size in project/MamboHR2.0.uvprojx ends the application at 0x7A000. */
+// Layout versions: 1, the log pages reserved; 2, 16 bytes of application context per bond in
+// the device manager blocks; 3, a third data page, for the activity rollup.
+#define PSTORAGE_LAYOUT_VERSION     0x00000003                                                  /**< Version of the layout of the reserved pages, kept in the log page headers. Increase when the pages, the registered modules or their block sizes change: at init, pages written with another version are erased. */
+
 
 /** Abstracts persistently memory block identifier. */
 typedef uint32_t pstorage_block_t;
@@ -0,0 +1,159 @@
+#include "deep_idle.h"
+#include <string.h>
+#include "app_scheduler.h"
+#include "app_util_platform.h"
+#include "ble_advertising.h"
+#include "channel_select.h"
+#include "motion.h"
+#include "ppg.h"
+#include "adv_summary.h"
+#include "time.h"
+#include "fds.h"
+#include "debug.h"
+
+static bool m_active;
+static uint16_t m_still;					//ķ
+static uint32_t m_from;						//һȿпʼͽı
+static uint32_t m_to;
+static bool m_wake_pending;
+static deep_idle_stats_st m_stats;
+
+static void deep_idle_exit(void *p_event_data,uint16_t event_size)
+{
+	uint8_t reason = *(uint8_t *)p_event_data;
+	uint32_t err_code;
+
+	CRITICAL_REGION_ENTER();
+	m_wake_pending = false;
+	CRITICAL_REGION_EXIT();
+
+	if(!m_active)
+		return;
+
+	err_code = motion_stream_resume();
+	if(err_code != NRF_SUCCESS)
+		QPRINTF("deep idle resume 0x%x\r\n",err_code);
+	ble_advertising_idle_set(false);
+	adv_summary_suspend(false);
+
+	m_active = false;
+	m_still  = 0;
+	m_to     = system_sec_get();
+	m_stats.idle_sec += m_to - m_from;
+	if(reason == DEEP_IDLE_WAKE_MOTION)
+		m_stats.motion_wakes++;
+	else
+		m_stats.link_wakes++;
+	QPRINTF("deep idle exit %d after %d s\r\n",reason,m_to - m_from);
+}
+
+static void deep_idle_motion_handler(void)
+{
+	deep_idle_wake(DEEP_IDLE_WAKE_MOTION);
+}
+
+static void deep_idle_enter(void)
+{
+	uint32_t err_code;
+
+	err_code = motion_wake_enable(deep_idle_motion_handler);
+	if(err_code != NRF_SUCCESS)
+	{
+		//ڲɼ, ٵһβʱ
+		m_stats.errors++;
+		m_still = 0;
+		QPRINTF("deep idle enter 0x%x\r\n",err_code);
+		return;
+	}
+	ble_advertising_idle_set(true);
+	adv_summary_suspend(true);
+	//ֹڼܶϵ, Ȱӳٵfdsдflash
+	(void)fds_flush();
+
+	m_active = true;
+	m_from   = system_sec_get();
+	m_to     = m_from;
+	m_stats.entries++;
+	QPRINTF("deep idle enter\r\n");
+}
+
+void deep_idle_init(void)
+{
+	m_active = false;
+	m_still = 0;
+	m_from = 0;
+	m_to = 0;
+	m_wake_pending = false;
+	memset(&m_stats,0,sizeof(m_stats));
+}
+
+/*****************************************************************************
+ *    : deep_idle_minute
+ *  : ķ, ˽ȿ
+ *  : uint16_t activity  սһӵĻ
+ *  : 
+ *   ֵ : 
+ * ޸ʷ : 
+ * ˵     : ѭ, ʱҪüٶȼ
+*****************************************************************************/
+void deep_idle_minute(uint16_t activity)
+{
+	if(m_active)
+		return;
+
+	if(activity > DEEP_IDLE_STILL_ACTIVITY)
+	{
+		m_still = 0;
+		return;
+	}
+	if(m_still < DEEP_IDLE_STILL_MIN)
+		m_still++;
+
+	//ֻڲʱҪһֱɼ, һٿ
+	if(m_still >= DEEP_IDLE_STILL_MIN && link_count() == 0 && !ppg_is_running())
+		deep_idle_enter();
+}
+
+/*****************************************************************************
+ *    : deep_idle_wake
+ *  : ˳ȿ
+ *  : uint8_t reason  DEEP_IDLE_WAKE_MOTION/DEEP_IDLE_WAKE_LINK
+ *  : 
+ *   ֵ : 
+ * ޸ʷ : 
+ * ˵     : GPIOTEжϺЭջ¼, ָҪTWI, ŵѭ;
+ *            ȿʱʲô
+*****************************************************************************/
+void deep_idle_wake(uint8_t reason)
+{
+	bool post;
+
+	if(!m_active)
+		return;
+
+	CRITICAL_REGION_ENTER();
+	post = !m_wake_pending;
+	m_wake_pending = true;
+	CRITICAL_REGION_EXIT();
+
+	if(post && app_sched_event_put(&reason,sizeof(reason),deep_idle_exit) != NRF_SUCCESS)
+	{
+		m_wake_pending = false;
+		QPRINTF("deep idle wake dropped\r\n");
+	}
+}
+
+bool deep_idle_active(void)
+{
+	return m_active;
+}
+
+bool deep_idle_covers(uint32_t minute_utc)
+{
+	return !m_active && minute_utc >= m_from && minute_utc + 60 <= m_to;
+}
+
+void deep_idle_stats_get(deep_idle_stats_st *p_stats)
+{
+	*p_stats = m_stats;
+}
@@ -0,0 +1,37 @@
+#ifndef _DEEP_IDLE_H_
+#define _DEEP_IDLE_H_
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DEEP_IDLE_STILL_MIN			(30)		//ôӲŽȿ
+#define DEEP_IDLE_STILL_ACTIVITY	(0)			//ӻ㲻, ʱ0
+
+#define DEEP_IDLE_WAKE_MOTION		(0)			//ٶȼƵ˶ж
+#define DEEP_IDLE_WAKE_LINK			(1)			//ֻ
+
+typedef struct
+{
+	uint32_t entries;			//ȿеĴ
+	uint32_t motion_wakes;		//˳Ĵ
+	uint32_t link_wakes;		//ֻ˳Ĵ
+	uint32_t idle_sec;			//ȿʱ, ǰһ
+	uint32_t errors;			//ٶȼûйȥ, û
+}deep_idle_stats_st;
+
+
+/*****************************************************************************
+ * ȿ: DEEP_IDLE_STILL_MINӻΪ0, ûҲûڲʱ,
+ * ٶȼƴ25Hz FIFOɼ10Hz͹˶ж(زÿ), ٹ㲥
+ * 10.24, ͣɨӦˢ¶ʱ. ӺʱĶʱճ.
+ * ˻ֻʱָ, ʱ䰴Ϊ0ķӲ˯, ˯߲.
+ * System ON, RAMȫ, λ//Ӽ¼; System OFF,
+ * ͣRTC͹㲥, Ҫλ.
+*****************************************************************************/
+void deep_idle_init(void);
+void deep_idle_minute(uint16_t activity);			//ÿӵĻ, ѭ
+void deep_idle_wake(uint8_t reason);				//ж, ѭָ
+bool deep_idle_active(void);
+bool deep_idle_covers(uint32_t minute_utc);			//һһȿ
+void deep_idle_stats_get(deep_idle_stats_st *p_stats);
+
+#endif
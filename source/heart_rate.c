@@ -0,0 +1,230 @@
+#include "heart_rate.h"
+#include <string.h>
+#include "dsp_kernels.h"
+
+#define HR_ADC_SHIFT				(3)							//12λSAADCתQ15
+#define HR_HP_COEF					(31130)						//0.95(Q15), ֹԼ0.4Hz
+#define HR_LP_SHIFT					(14)						//ͨϵQ14
+#define HR_THRESH_MIN				(4 << HR_ADC_SHIFT)			//4ADC LSB
+#define HR_PEAK_AVG_SHIFT			(3)
+#define HR_FRAC_BITS				(4)							//λþȷ1/16
+#define HR_INTERVAL_MIN				((60 * PPG_SAMPLE_HZ << HR_FRAC_BITS) / HEART_RATE_BPM_MAX)
+#define HR_INTERVAL_MAX				((60 * PPG_SAMPLE_HZ << HR_FRAC_BITS) / HEART_RATE_BPM_MIN)
+#define HR_REJECT_RESET				(4)							//ô˵ı
+
+//4HzButterworthͨ @50Hz, Q14: b0 b1 b2 -a1 -a2
+static const q15_t m_lp_coef[5] = {756, 1512, 756, 21419, -8058};
+
+static dsp_dcblock_q15_t m_hp;
+static dsp_biquad_q15_t m_lp;
+
+static q15_t m_f1;					//ǰһ˲
+static q15_t m_f2;					//ǰһ
+static q15_t m_trough;				//һ֮͵, ߴ, ܻƯӰ
+static q15_t m_peak_avg;			//ƽ, ֵȡһ
+
+static uint32_t m_n;				//ʱ
+static bool m_have_peak;
+static uint32_t m_last_peak;		//һλ, 1/16
+
+static uint16_t m_intervals[HEART_RATE_INTERVALS];	//1/16
+static uint8_t m_interval_next;
+static uint8_t m_interval_count;
+static uint16_t m_estimate;			//ǰ, 0ʾû
+static uint8_t m_rejects;
+
+static heart_rate_stats_st m_stats;
+
+//SSAT #16һ, M4ϾSSAT; __SSAT, Ҳܱ
+static q15_t hr_sat16(q31_t value)
+{
+	if(value > 32767)
+		return 32767;
+	if(value < -32768)
+		return -32768;
+	return (q15_t)value;
+}
+
+static void hr_reset(void)
+{
+	m_interval_next  = 0;
+	m_interval_count = 0;
+	m_estimate       = 0;
+	m_rejects        = 0;
+	m_stats.resets++;
+}
+
+//ȡмһƽֵ, ļӰ첻
+static void hr_estimate_update(void)
+{
+	uint16_t sorted[HEART_RATE_INTERVALS];
+	uint16_t value;
+	uint32_t sum = 0;
+	uint8_t i,j,first,last;
+
+	for(i=0;i<m_interval_count;i++)
+	{
+		value = m_intervals[i];
+		for(j=i;j>0 && sorted[j-1]>value;j--)
+			sorted[j] = sorted[j-1];
+		sorted[j] = value;
+	}
+
+	first = m_interval_count / 4;
+	last  = m_interval_count - first;
+	for(i=first;i<last;i++)
+		sum += sorted[i];
+
+	m_estimate = (m_interval_count >= HEART_RATE_MIN_BEATS) ? (uint16_t)(sum / (last - first)) : 0;
+}
+
+static void hr_interval(uint16_t interval)
+{
+	uint16_t diff;
+
+	if(m_estimate)
+	{
+		diff = (interval > m_estimate) ? interval - m_estimate : m_estimate - interval;
+		if(diff * 4 > m_estimate)
+		{
+			m_stats.rejected++;
+			if(++m_rejects < HR_REJECT_RESET)
+				return;
+			hr_reset();
+		}
+	}
+
+	m_rejects = 0;
+	m_intervals[m_interval_next] = interval;
+	m_interval_next = (m_interval_next + 1) % HEART_RATE_INTERVALS;
+	if(m_interval_count < HEART_RATE_INTERVALS)
+		m_interval_count++;
+	m_stats.beats++;
+	hr_estimate_update();
+}
+
+static void hr_peak(q15_t y0,q15_t y1,q15_t y2)
+{
+	int32_t denom = (int32_t)y0 - 2 * y1 + y2;
+	int32_t offset = 0;
+	uint32_t peak;
+	uint32_t interval;
+
+	//(-1,y0),(0,y1),(1,y2)߶
+	if(denom != 0)
+		offset = (((int32_t)y0 - y2) << (HR_FRAC_BITS - 1)) / denom;
+	if(offset > (1 << (HR_FRAC_BITS - 1)))
+		offset = 1 << (HR_FRAC_BITS - 1);
+	if(offset < -(1 << (HR_FRAC_BITS - 1)))
+		offset = -(1 << (HR_FRAC_BITS - 1));
+
+	peak = ((m_n - 1) << HR_FRAC_BITS) + offset;
+	if(m_have_peak)
+	{
+		interval = peak - m_last_peak;
+		if(interval < HR_INTERVAL_MIN)			//ز֮С
+			return;
+		if(interval <= HR_INTERVAL_MAX)
+			hr_interval((uint16_t)interval);
+	}
+	m_have_peak = true;
+	m_last_peak = peak;
+}
+
+static void hr_sample(q15_t f)
+{
+	q15_t thresh = m_peak_avg >> 1;
+
+	if(thresh < HR_THRESH_MIN)
+		thresh = HR_THRESH_MIN;
+
+	//ûź, û
+	if(m_have_peak && (m_n << HR_FRAC_BITS) - m_last_peak > (HEART_RATE_LOST_SEC * PPG_SAMPLE_HZ << HR_FRAC_BITS))
+	{
+		m_have_peak = false;
+		m_peak_avg  = HR_THRESH_MIN * 2;
+		if(m_interval_count)
+			hr_reset();
+	}
+
+	if(f < m_trough)
+		m_trough = f;
+
+	if(m_f1 > m_f2 && m_f1 >= f && m_f1 - m_trough > thresh)
+	{
+		m_peak_avg += (m_f1 - m_trough - m_peak_avg) >> HR_PEAK_AVG_SHIFT;
+		m_trough = m_f1;
+		hr_peak(m_f2,m_f1,f);
+	}
+
+	m_f2 = m_f1;
+	m_f1 = f;
+	m_n++;
+	m_stats.samples++;
+}
+
+/*****************************************************************************
+ *    : heart_rate_init
+ *  : ˲, ÿοʼǰ
+ *  : 
+ *  : 
+ *   ֵ : 
+ * ޸ʷ : 
+ * ˵     : 
+*****************************************************************************/
+void heart_rate_init(void)
+{
+	dsp_dcblock_q15_init(&m_hp,HR_HP_COEF);
+	dsp_biquad_q15_init(&m_lp,m_lp_coef,HR_LP_SHIFT);
+	m_f1 = m_f2 = 0;
+	m_trough = 0;
+	m_peak_avg = HR_THRESH_MIN * 2;
+	m_n = 0;
+	m_have_peak = false;
+
+	memset(&m_stats,0,sizeof(m_stats));
+	hr_reset();
+	m_stats.resets = 0;
+}
+
+/*****************************************************************************
+ *    : heart_rate_process
+ *  : һPPG
+ *  : const int16_t *p_block  SAADC 12λ, PPG_SAMPLE_HZ
+               uint16_t count          
+ *  : 
+ *   ֵ : 
+ * ޸ʷ : 
+ * ˵     : յĹʱ, ԷҲ
+*****************************************************************************/
+void heart_rate_process(const int16_t *p_block,uint16_t count)
+{
+	q15_t filtered[PPG_BLOCK_SAMPLES];
+	uint16_t i,n;
+
+	//ͨȥֱ, ͨȥƵ, ʣ0.4~4Hz, 24~240/
+	for(;count;count-=n,p_block+=n)
+	{
+		n = (count > PPG_BLOCK_SAMPLES) ? PPG_BLOCK_SAMPLES : count;
+		for(i=0;i<n;i++)
+			filtered[i] = hr_sat16((q31_t)p_block[i] << HR_ADC_SHIFT);
+		dsp_dcblock_q15(&m_hp,filtered,filtered,n);
+		dsp_biquad_q15(&m_lp,filtered,filtered,n);
+		for(i=0;i<n;i++)
+			hr_sample(hr_sat16(-(q31_t)filtered[i]));
+	}
+}
+
+uint8_t heart_rate_get(void)
+{
+	if(m_estimate == 0)
+		return 0;
+
+	return (uint8_t)(((60 * PPG_SAMPLE_HZ << HR_FRAC_BITS) + m_estimate / 2) / m_estimate);
+}
+
+void heart_rate_stats_get(heart_rate_stats_st *p_stats)
+{
+	*p_stats = m_stats;
+}
+
@@ -0,0 +1,33 @@
+#ifndef _HEART_RATE_H_
+#define _HEART_RATE_H_
+#include <stdint.h>
+#include "ppg.h"
+
+#define HEART_RATE_BPM_MIN			(35)
+#define HEART_RATE_BPM_MAX			(200)
+#define HEART_RATE_INTERVALS		(8)			//õ
+#define HEART_RATE_MIN_BEATS		(4)			//ܹôų
+#define HEART_RATE_LOST_SEC			(3)			//ôûͲٸ
+
+typedef struct
+{
+	uint32_t samples;
+	uint32_t beats;				//, 
+	uint32_t rejected;			//͵ǰʲ̫౻
+	uint32_t resets;			//߶ź, ¿ʼ
+}heart_rate_stats_st;
+
+
+/*****************************************************************************
+ * ʹ: ppgһһش, ڴ̶. תQ15, 0.4Hzͨ
+ * ȥֱ4Hz׵ͨ, Ҳ, ߴǰһȵ, ƽߵһ
+ * , λֵ߲1/16. HEART_RATE_INTERVALSȡмһƽֵ
+ * , ͵ǰʲ25%ϵļҪ.
+ * ֻ, , Ҳ.
+*****************************************************************************/
+void heart_rate_init(void);
+void heart_rate_process(const int16_t *p_block,uint16_t count);
+uint8_t heart_rate_get(void);			//ûпŵʱ0
+void heart_rate_stats_get(heart_rate_stats_st *p_stats);
+
+#endif
@@ -0,0 +1,229 @@
+#include "indicate.h"
+#include <string.h>
+#include "nrf_drv_pwm.h"
+#include "pwm_pattern.h"
+#include "debug.h"
+
+typedef struct
+{
+	pwm_pattern_t pattern;
+	uint8_t out;
+}indicate_pattern_st;
+
+typedef struct
+{
+	nrf_drv_pwm_t pwm;
+	bool active_low;
+	uint16_t off_value;						//Ϊʱһ, ҪRAM
+	pwm_pattern_compiled_t compiled;
+	nrf_pwm_sequence_t seq[2];
+	uint32_t plays;							//һҪĶ, 0ʾһֱ
+	uint32_t next;							//һװSEQǵڼ
+	volatile bool playing;
+}indicate_out_st;
+
+//޴εЧһǹ: ֹͣһֵװʱ, ֵֻһ
+static const pwm_pattern_step_t m_call[] =
+{
+	PWM_PATTERN_RAMP(0, 1000, 200), PWM_PATTERN_HOLD(1000, 600), PWM_PATTERN_HOLD(0, 400),
+};
+static const pwm_pattern_step_t m_message[] =
+{
+	PWM_PATTERN_HOLD(800, 150), PWM_PATTERN_HOLD(0, 100), PWM_PATTERN_HOLD(800, 150), PWM_PATTERN_HOLD(0, 100),
+};
+static const pwm_pattern_step_t m_alarm[] =
+{
+	PWM_PATTERN_RAMP(0, 1000, 1000), PWM_PATTERN_HOLD(1000, 500), PWM_PATTERN_HOLD(0, 300),
+	PWM_PATTERN_HOLD(1000, 100), PWM_PATTERN_HOLD(0, 100), PWM_PATTERN_HOLD(1000, 100), PWM_PATTERN_HOLD(0, 900),
+};
+static const pwm_pattern_step_t m_long_sit[] =
+{
+	PWM_PATTERN_RAMP(0, 1000, 600), PWM_PATTERN_HOLD(1000, 1500), PWM_PATTERN_RAMP(1000, 0, 600), PWM_PATTERN_HOLD(0, 300),
+};
+static const pwm_pattern_step_t m_led_off[]        = {PWM_PATTERN_HOLD(0, 10)};
+static const pwm_pattern_step_t m_led_advertising[] = {PWM_PATTERN_HOLD(1000, 200), PWM_PATTERN_HOLD(0, 1800)};
+static const pwm_pattern_step_t m_led_whitelist[]  = {PWM_PATTERN_HOLD(1000, 200), PWM_PATTERN_HOLD(0, 800)};
+static const pwm_pattern_step_t m_led_slow[]       = {PWM_PATTERN_HOLD(1000, 400), PWM_PATTERN_HOLD(0, 4000)};
+static const pwm_pattern_step_t m_led_directed[]   = {PWM_PATTERN_HOLD(1000, 200), PWM_PATTERN_HOLD(0, 200)};
+static const pwm_pattern_step_t m_led_bonding[]    = {PWM_PATTERN_HOLD(1000, 100), PWM_PATTERN_HOLD(0, 100)};
+static const pwm_pattern_step_t m_led_connected[]  = {PWM_PATTERN_HOLD(1000, 1000)};
+
+#define INDICATE_PATTERN(steps, repeats, out)	{{steps, sizeof(steps) / sizeof(steps[0]), repeats}, out}
+
+//
+static const indicate_pattern_st m_patterns[INDICATE_COUNT] =
+{
+	INDICATE_PATTERN(m_call,            15,                  INDICATE_OUT_MOTOR),
+	INDICATE_PATTERN(m_message,         1,                   INDICATE_OUT_MOTOR),
+	INDICATE_PATTERN(m_alarm,           30,                  INDICATE_OUT_MOTOR),
+	INDICATE_PATTERN(m_long_sit,        2,                   INDICATE_OUT_MOTOR),
+	INDICATE_PATTERN(m_led_off,         1,                   INDICATE_OUT_LED),
+	INDICATE_PATTERN(m_led_advertising, PWM_PATTERN_FOREVER, INDICATE_OUT_LED),
+	INDICATE_PATTERN(m_led_whitelist,   PWM_PATTERN_FOREVER, INDICATE_OUT_LED),
+	INDICATE_PATTERN(m_led_slow,        PWM_PATTERN_FOREVER, INDICATE_OUT_LED),
+	INDICATE_PATTERN(m_led_directed,    PWM_PATTERN_FOREVER, INDICATE_OUT_LED),
+	INDICATE_PATTERN(m_led_bonding,     PWM_PATTERN_FOREVER, INDICATE_OUT_LED),
+	INDICATE_PATTERN(m_led_connected,   PWM_PATTERN_FOREVER, INDICATE_OUT_LED),
+};
+
+//ߵƽ, LED͵ƽ
+static indicate_out_st m_out[INDICATE_OUT_COUNT] =
+{
+	{.pwm = NRF_DRV_PWM_INSTANCE(0), .active_low = false},
+	{.pwm = NRF_DRV_PWM_INSTANCE(1), .active_low = true},
+};
+
+static indicate_stats_st m_stats;
+
+//playװSEQ[slot], ǲĹ
+static void indicate_seq_load(indicate_out_st *p_out,uint8_t slot,uint32_t play)
+{
+	nrf_pwm_sequence_t *p_seq = &p_out->seq[slot];
+	const pwm_pattern_segment_t *p_segment;
+
+	if(p_out->plays != 0 && play >= p_out->plays)
+	{
+		p_seq->values.p_raw = &p_out->off_value;
+		p_seq->length       = 1;
+		p_seq->repeats      = 0;
+	}
+	else
+	{
+		p_segment = &p_out->compiled.segments[play % p_out->compiled.segment_count];
+		p_seq->values.p_raw = &p_out->compiled.values[p_segment->first];
+		p_seq->length       = p_segment->length;
+		p_seq->repeats      = p_segment->refresh;
+	}
+	p_seq->end_delay = 0;
+}
+
+//PWMж: ӲѾڲһSEQ, Ѻڶλղ
+static void indicate_pwm_evt(indicate_out_st *p_out,nrf_drv_pwm_evt_type_t event_type)
+{
+	uint8_t slot;
+
+	m_stats.wakeups++;
+	if(event_type == NRF_DRV_PWM_EVT_STOPPED)
+	{
+		p_out->playing = false;
+		return;
+	}
+	if(event_type != NRF_DRV_PWM_EVT_END_SEQ0 && event_type != NRF_DRV_PWM_EVT_END_SEQ1)
+		return;
+
+	slot = (event_type == NRF_DRV_PWM_EVT_END_SEQ0) ? 0 : 1;
+	if(p_out->plays != 0 && p_out->next > p_out->plays)
+		return;
+	indicate_seq_load(p_out,slot,p_out->next++);
+	nrf_drv_pwm_sequence_update(&p_out->pwm,slot,&p_out->seq[slot]);
+}
+
+static void indicate_motor_handler(nrf_drv_pwm_evt_type_t event_type)
+{
+	indicate_pwm_evt(&m_out[INDICATE_OUT_MOTOR],event_type);
+}
+
+static void indicate_led_handler(nrf_drv_pwm_evt_type_t event_type)
+{
+	indicate_pwm_evt(&m_out[INDICATE_OUT_LED],event_type);
+}
+
+/*****************************************************************************
+ *    : indicate_init
+ *  : ʼLEDPWM
+ *  : 
+ *  : 
+ *   ֵ : NRF_SUCCESSصĴ
+ * ޸ʷ : 
+ * ˵     : ź1kHzʱnrf_drv_config.hPWM0/PWM1
+*****************************************************************************/
+uint32_t indicate_init(void)
+{
+	uint32_t err_code;
+	uint8_t i;
+
+	memset(&m_stats,0,sizeof(m_stats));
+	for(i=0;i<INDICATE_OUT_COUNT;i++)
+	{
+		m_out[i].off_value = pwm_pattern_off_value(m_out[i].active_low);
+		m_out[i].playing   = false;
+	}
+
+	err_code = nrf_drv_pwm_init(&m_out[INDICATE_OUT_MOTOR].pwm,NULL,indicate_motor_handler);
+	if(err_code != NRF_SUCCESS)
+		return err_code;
+	return nrf_drv_pwm_init(&m_out[INDICATE_OUT_LED].pwm,NULL,indicate_led_handler);
+}
+
+/*****************************************************************************
+ *    : indicate_play
+ *  : ŲһЧ
+ *  : uint8_t id  INDICATE_CALL
+ *  : 
+ *   ֵ : NRF_SUCCESS, NRF_ERROR_INVALID_PARAM:û, Ĵ
+ * ޸ʷ : 
+ * ˵     : ͬһڲͣ(һPWM). һεЧPWM
+ *            Լѭ, ʱSEQ0/SEQ1װ, ʱһڵĹ
+*****************************************************************************/
+uint32_t indicate_play(uint8_t id)
+{
+	const indicate_pattern_st *p_pattern;
+	indicate_out_st *p_out;
+	uint32_t err_code;
+	uint32_t flags;
+	uint8_t segments;
+
+	if(id >= INDICATE_COUNT)
+		return NRF_ERROR_INVALID_PARAM;
+
+	p_pattern = &m_patterns[id];
+	p_out = &m_out[p_pattern->out];
+	(void)nrf_drv_pwm_stop(&p_out->pwm,true);
+
+	err_code = pwm_pattern_compile(&p_pattern->pattern,p_out->active_low,&p_out->compiled);
+	if(err_code != NRF_SUCCESS)
+	{
+		m_stats.errors++;
+		QPRINTF("indicate %d compile 0x%x\r\n",id,err_code);
+		return err_code;
+	}
+
+	segments = p_out->compiled.segment_count;
+	p_out->plays = (uint32_t)segments * p_out->compiled.repeats;
+	p_out->next  = 2;
+	indicate_seq_load(p_out,0,0);
+	indicate_seq_load(p_out,1,1);
+
+	//ֻͣʱһ; һֱĲͣ, Ҳ
+	flags = NRF_DRV_PWM_FLAG_NO_EVT_FINISHED;
+	flags |= (p_out->plays != 0) ? NRF_DRV_PWM_FLAG_STOP : NRF_DRV_PWM_FLAG_LOOP;
+
+	p_out->playing = true;
+	m_stats.plays++;
+	if(segments == 1)
+		nrf_drv_pwm_simple_playback(&p_out->pwm,&p_out->seq[0],p_out->plays ? p_out->plays : 1,flags);
+	else if(segments == 2)
+		nrf_drv_pwm_complex_playback(&p_out->pwm,&p_out->seq[0],&p_out->seq[1],
+									 p_out->plays ? p_out->compiled.repeats : 1,flags);
+	else
+		nrf_drv_pwm_complex_playback(&p_out->pwm,&p_out->seq[0],&p_out->seq[1],
+									 p_out->plays ? (p_out->plays + 1) / 2 : 1,
+									 flags | NRF_DRV_PWM_FLAG_SIGNAL_END_SEQ0 | NRF_DRV_PWM_FLAG_SIGNAL_END_SEQ1);
+	return NRF_SUCCESS;
+}
+
+void indicate_stop(uint8_t out)
+{
+	if(out < INDICATE_OUT_COUNT)
+		(void)nrf_drv_pwm_stop(&m_out[out].pwm,false);
+}
+
+bool indicate_is_playing(uint8_t out)
+{
+	return out < INDICATE_OUT_COUNT && m_out[out].playing;
+}
+
+void indicate_stats_get(indicate_stats_st *p_stats)
+{
+	*p_stats = m_stats;
+}
@@ -0,0 +1,45 @@
+#ifndef _INDICATE_H_
+#define _INDICATE_H_
+#include <stdint.h>
+#include <stdbool.h>
+
+#define INDICATE_OUT_MOTOR			(0)			//PWM0, 
+#define INDICATE_OUT_LED			(1)			//PWM1, BSP_LED_0
+#define INDICATE_OUT_COUNT			(2)
+
+//
+#define INDICATE_CALL				(0)			//: ǿ, ظ15
+#define INDICATE_MESSAGE			(1)			///΢/QQ: ¶
+#define INDICATE_ALARM				(2)			//: ǿ, ظ30
+#define INDICATE_LONG_SIT			(3)			//: ǿһ, 
+//LED
+#define INDICATE_LED_OFF			(4)
+#define INDICATE_LED_ADVERTISING	(5)
+#define INDICATE_LED_WHITELIST		(6)
+#define INDICATE_LED_SLOW			(7)
+#define INDICATE_LED_DIRECTED		(8)
+#define INDICATE_LED_BONDING		(9)
+#define INDICATE_LED_CONNECTED		(10)
+#define INDICATE_COUNT				(11)
+
+typedef struct
+{
+	uint32_t plays;				//ʼŵĴ
+	uint32_t wakeups;			//PWMжϴ, ζʱÿһ, ټӽһ
+	uint32_t errors;			//ʧܵĴ
+}indicate_stats_st;
+
+
+/*****************************************************************************
+ * ʾ: 𶯺LEDЧŲ. ÿЧǼι̶ռձȻԽ, 
+ * PWMEasyDMA, Ӳ: һεЧӲѭ, CPUֻڲʱ
+ * һ; SEQENDжһλղǸSEQ. ͬһ
+ * ЧϾɵ, LEDӰ.
+*****************************************************************************/
+uint32_t indicate_init(void);
+uint32_t indicate_play(uint8_t id);				//ѭ, NRF_ERROR_INVALID_PARAM: û
+void indicate_stop(uint8_t out);				//INDICATE_OUT_MOTOR/INDICATE_OUT_LED
+bool indicate_is_playing(uint8_t out);
+void indicate_stats_get(indicate_stats_st *p_stats);
+
+#endif
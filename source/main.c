@@ -45,6 +45,7 @@
 #include "device_manager.h"
 #include "app_timer.h"
 #include "pstorage.h"
+#include "flash_sched.h"
 #include "nrf_soc.h"
 #include "bsp.h"
 #include "bsp_btn_ble.h"
@@ -63,9 +64,22 @@
 #include "usr_device.h"
 #include "time.h"
 #include "transfer_driver.h"
+#include "lesc_keys.h"
+#include "channel_select.h"
+#include "usr_login.h"
+#include "adv_summary.h"
+#include "motion.h"
+#include "step_counter.h"
+#include "ppg.h"
+#include "heart_rate.h"
+#include "sleep_stage.h"
+#include "rollup.h"
+#include "alarm.h"
+#include "deep_idle.h"
+#include "indicate.h"
 
 #define CENTRAL_LINK_COUNT              0                                           /**< The number of central links used by the application. When changing this number remember to adjust the RAM settings. */
-#define PERIPHERAL_LINK_COUNT           1                                           /**< The number of peripheral links used by the application. When changing this number remember to adjust the RAM settings. */
+#define PERIPHERAL_LINK_COUNT           1                                           /**< The number of peripheral links used by the application, equal to LINK_MAX. S132 2.0.0 supports one. When changing this number remember to adjust the RAM settings. */
 #define VENDOR_SPECIFIC_UUID_COUNT      4                                           /**< The number of vendor specific UUIDs used by this example. */
 #define DISPLAY_MESSAGE_BUTTON_ID       1                                           /**< Button used to request notification attributes. */
 
@@ -92,11 +106,10 @@
 
 #define SECURITY_REQUEST_DELAY          APP_TIMER_TICKS(1500, APP_TIMER_PRESCALER)  /**< Delay after connection until security request is sent, if necessary (ticks). */
 #define FIND_ANCS_SERVER_REQUEST_DELAY  APP_TIMER_TICKS(1500, APP_TIMER_PRESCALER)  /**< Delay after connection until security request is sent, if necessary (ticks). */
-#define ONE_SECOND_INTERVAL         	APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER)
 
 #define SEC_PARAM_BOND                  1                                           /**< Perform bonding. */
 #define SEC_PARAM_MITM                  0                                           /**< Man In The Middle protection not required. */
-#define SEC_PARAM_LESC                  0                                           /**< LE Secure Connections not enabled. */
+#define SEC_PARAM_LESC                  1                                           /**< LE Secure Connections enabled, see lesc_keys.h. */
 #define SEC_PARAM_KEYPRESS              0                                           /**< Keypress notifications not enabled. */
 #define SEC_PARAM_IO_CAPABILITIES       BLE_GAP_IO_CAPS_NONE                        /**< No I/O capabilities. */
 #define SEC_PARAM_OOB                   0                                           /**< Out Of Band data not available. */
@@ -116,14 +129,12 @@ extern ble_ancs_c_t              m_ios_ancs;
 static ble_db_discovery_t        m_ble_db_discovery;                       /**< Structure used to identify the DB Discovery module. */
 
 static dm_application_instance_t m_app_handle;                             /**< Application identifier allocated by the Device Manager. */
-static dm_handle_t               m_peer_handle;                            /**< Identifies the peer that is currently connected. */
 static ble_gap_sec_params_t      m_sec_param;                              /**< Security parameter for use in security requests. */
+static uint32_t                  m_minute_fed;                             /**< Start of the last minute handed to sleep staging, 0 before the first. */
 APP_TIMER_DEF(m_sec_req_timer_id);                                         /**< Security request timer. The timer lets us start pairing request if one does not arrive from the Central. */
 APP_TIMER_DEF(m_ancs_server_find_timer_id);                                         /**< Security request timer. The timer lets us start pairing request if one does not arrive from the Central. */
-APP_TIMER_DEF(m_time_timer_id);
 
 
-uint16_t g_connect_handle;
 /**@brief Callback function for handling asserts in the SoftDevice.
  *
  * @details This function is called in case of an assert in the SoftDevice.
@@ -145,24 +156,25 @@ void assert_nrf_callback(uint16_t line_num, const uint8_t * p_file_name)
  *
  * @details This function is called each time the security request timer expires.
  *
- * @param[in] p_context  Pointer used for passing context information from the
- *                       app_start_timer() call to the time-out handler.
+ * @param[in] p_context  Connection handle of the link to secure.
  */
 static void sec_req_timeout_handler(void * p_context)
 {
     
     uint32_t             err_code;
     dm_security_status_t status;
+    dm_handle_t          handle;
 
-    if (m_peer_handle.connection_id != DM_INVALID_ID)
+    handle.appl_id = m_app_handle;
+    if (dm_handle_get((uint16_t)(uint32_t)p_context, &handle) == NRF_SUCCESS)
     {
-        err_code = dm_security_status_req(&m_peer_handle, &status);
+        err_code = dm_security_status_req(&handle, &status);
         APP_ERROR_CHECK(err_code);
 
         // If the link is still not secured by the peer, initiate security procedure.
         if (status == NOT_ENCRYPTED)
         {
-            err_code = dm_security_setup_req(&m_peer_handle);
+            err_code = dm_security_setup_req(&handle);
             APP_ERROR_CHECK(err_code);
         }
     }
@@ -172,9 +184,19 @@ static void ancs_find_timeout_handler(void * p_context)
 {
     
     uint32_t             err_code;
+    uint16_t             conn_handle = (uint16_t)(uint32_t)p_context;
+
 	QPRINTF("ancs_find_timeout_handler\r\n");
-	err_code = ble_db_discovery_start(&m_ble_db_discovery,g_connect_handle);
-    APP_ERROR_CHECK(err_code);
+	if (m_ios_ancs.conn_handle != conn_handle)
+	{
+		return;
+	}
+	// LINK_SECURED may already have started discovery.
+	err_code = ble_db_discovery_start(&m_ble_db_discovery,conn_handle);
+    if (err_code != NRF_ERROR_BUSY)
+    {
+        APP_ERROR_CHECK(err_code);
+    }
 }
 
 
@@ -197,11 +219,6 @@ static void timers_init(void)
     err_code = app_timer_create(&m_ancs_server_find_timer_id,
                                 APP_TIMER_MODE_SINGLE_SHOT,
                                 ancs_find_timeout_handler);
-
-	err_code = app_timer_create(&m_time_timer_id, APP_TIMER_MODE_REPEATED, system_time_tick);
-    APP_ERROR_CHECK(err_code);
-
-    err_code = app_timer_start(m_time_timer_id, ONE_SECOND_INTERVAL, NULL);
     APP_ERROR_CHECK(err_code);
 }
 
@@ -296,18 +313,40 @@ static uint32_t device_manager_evt_handler(dm_handle_t const * p_handle,
     {
         case DM_EVT_CONNECTION:
 			QPRINTF("DM_EVT_CONNECTION\r\n");
-            m_peer_handle = (*p_handle);
-
-			g_connect_handle = p_evt->event_param.p_gap_param->conn_handle;
-			err_code      = app_timer_start(m_ancs_server_find_timer_id, FIND_ANCS_SERVER_REQUEST_DELAY, NULL);
+			// Known once the peer is found among the bonds, the session cache keys on it.
+			link_bond_set(p_evt->event_param.p_gap_param->conn_handle, p_handle->device_id);
+			// The iOS ANCS client serves one link, it takes this one only when it is free.
+			if (m_ios_ancs.conn_handle != BLE_CONN_HANDLE_INVALID)
+			{
+				break;
+			}
+			err_code      = app_timer_start(m_ancs_server_find_timer_id, FIND_ANCS_SERVER_REQUEST_DELAY,
+			                                (void *)(uint32_t)p_evt->event_param.p_gap_param->conn_handle);
             APP_ERROR_CHECK(err_code);
             break;
 
         case DM_EVT_LINK_SECURED:
 			QPRINTF("DM_EVT_LINK_SECURED\r\n");
+			link_bond_set(p_evt->event_param.p_gap_param->conn_handle, p_handle->device_id);
+			if (m_ios_ancs.conn_handle != p_evt->event_param.p_gap_param->conn_handle)
+			{
+				break;
+			}
+            err_code = app_timer_stop(m_ancs_server_find_timer_id);
+            APP_ERROR_CHECK(err_code);
+
+            if (ios_ancs_handles_restore(p_handle, p_evt->event_param.p_gap_param->conn_handle))
+            {
+                break;
+            }
+
+            // The find timer may already have started discovery.
             err_code = ble_db_discovery_start(&m_ble_db_discovery,
                                               p_evt->event_param.p_gap_param->conn_handle);
-            APP_ERROR_CHECK(err_code);
+            if (err_code != NRF_ERROR_BUSY)
+            {
+                APP_ERROR_CHECK(err_code);
+            }
             break; 
 
         default:
@@ -367,11 +406,23 @@ static void on_ble_evt(ble_evt_t * p_ble_evt)
     {
         case BLE_GAP_EVT_CONNECTED:
             QPRINTF("Connected.\r\n");
+			deep_idle_wake(DEEP_IDLE_WAKE_LINK);
+			// Advertising stops on connect, keep it up while a link is free.
+			if (link_count() < LINK_MAX)
+			{
+				advertising_start();
+			}
             break;
 
         case BLE_GAP_EVT_DISCONNECTED:
             QPRINTF("Disconnected.\r\n");
-			clear_all_remainder_info();
+			// The link is closed at the end of ble_evt_dispatch, it is still counted here.
+			if (link_count() == 1)
+			{
+				clear_all_remainder_info();
+			}
+			// Starts advertising if all links were in use, and switches to the reconnection
+			// stages if a bonded phone dropped out.
 			advertising_start();
             break;
 
@@ -409,9 +460,18 @@ static void on_ble_evt(ble_evt_t * p_ble_evt)
  */
 static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
 {
+    // First, so the device manager events of the connect find the link.
+    if (p_ble_evt->header.evt_id == BLE_GAP_EVT_CONNECTED)
+    {
+        (void)link_open(p_ble_evt->evt.gap_evt.conn_handle,
+                        &p_ble_evt->evt.gap_evt.params.connected.peer_addr);
+    }
+
     dm_ble_evt_handler(p_ble_evt);
+    lesc_keys_on_ble_evt(p_ble_evt);
     ble_db_discovery_on_ble_evt(&m_ble_db_discovery, p_ble_evt);
     ble_conn_params_on_ble_evt(p_ble_evt);
+    ble_advertising_on_ble_evt(p_ble_evt);
     on_ble_evt(p_ble_evt);
 	
 	ble_ancs_c_on_ble_evt(&m_ios_ancs, p_ble_evt);
@@ -419,6 +479,12 @@ static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
     ble_ancs_on_ble_evt(&m_android_ancs, p_ble_evt);
     ble_trans_on_ble_evt(&m_trans, p_ble_evt);
     ble_ota_on_ble_evt(&m_ota,p_ble_evt);
+
+    // Last, so the services above still find the link of the disconnect.
+    if (p_ble_evt->header.evt_id == BLE_GAP_EVT_DISCONNECTED)
+    {
+        link_close(p_ble_evt->evt.gap_evt.conn_handle);
+    }
 }
 
 
@@ -470,6 +536,46 @@ static void ble_stack_init(void)
     // Register with the SoftDevice handler module for System events.
     err_code = softdevice_sys_evt_handler_set(sys_evt_dispatch);
     APP_ERROR_CHECK(err_code);
+
+    // Time flash operations in between radio events.
+    err_code = flash_sched_init(APP_IRQ_PRIORITY_LOW);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for handling advertising events.
+ *
+ * @details The whitelist holds the bonded phones that are not connected, so that the one which
+ *          just dropped out can reconnect before any other phone.
+ *
+ * @param[in] ble_adv_evt  Advertising event.
+ */
+static void on_adv_evt(ble_adv_evt_t ble_adv_evt)
+{
+    uint32_t            err_code;
+    ble_gap_whitelist_t whitelist;
+    ble_gap_addr_t    * p_whitelist_addr[BLE_GAP_WHITELIST_ADDR_MAX_COUNT];
+    ble_gap_irk_t     * p_whitelist_irk[BLE_GAP_WHITELIST_IRK_MAX_COUNT];
+
+    switch (ble_adv_evt)
+    {
+        case BLE_ADV_EVT_WHITELIST_REQUEST:
+            whitelist.addr_count = BLE_GAP_WHITELIST_ADDR_MAX_COUNT;
+            whitelist.irk_count  = BLE_GAP_WHITELIST_IRK_MAX_COUNT;
+            whitelist.pp_addrs   = p_whitelist_addr;
+            whitelist.pp_irks    = p_whitelist_irk;
+
+            err_code = dm_whitelist_create(&m_app_handle, &whitelist);
+            APP_ERROR_CHECK(err_code);
+
+            err_code = ble_advertising_whitelist_reply(&whitelist);
+            APP_ERROR_CHECK(err_code);
+            break;
+
+        default:
+            QPRINTF("adv stage %d\r\n", ble_adv_evt);
+            break;
+    }
 }
 
 
@@ -517,7 +623,8 @@ static void advertising_init(void)
     srdata.uuids_solicited.p_uuids  = NULL;//&ancs_uuid;
 
     ble_adv_modes_config_t options = {0};
-    options.ble_adv_whitelist_enabled = BLE_ADV_WHITELIST_DISABLED;//BLE_ADV_WHITELIST_ENABLED;
+    options.ble_adv_whitelist_enabled = BLE_ADV_WHITELIST_ENABLED;
+    options.ble_adv_directed_enabled  = BLE_ADV_DIRECTED_ENABLED;
     options.ble_adv_fast_enabled      = BLE_ADV_FAST_ENABLED;
     options.ble_adv_fast_interval     = APP_ADV_FAST_INTERVAL;
     options.ble_adv_fast_timeout      = APP_ADV_FAST_TIMEOUT;
@@ -525,7 +632,7 @@ static void advertising_init(void)
     options.ble_adv_slow_interval     = APP_ADV_SLOW_INTERVAL;
     options.ble_adv_slow_timeout      = APP_ADV_SLOW_TIMEOUT;
 
-    err_code = ble_advertising_init(&advdata, &srdata, &options);
+    err_code = ble_advertising_init(&advdata, &srdata, &options, on_adv_evt, NULL);
     APP_ERROR_CHECK(err_code);
 }
 
@@ -558,7 +665,8 @@ void sys_start_pair_mode(void)
 	uint32_t err_code;
 
 	QPRINTF("system start pair mode\r\n\r\n");
-	err_code      = app_timer_start(m_sec_req_timer_id, SECURITY_REQUEST_DELAY, NULL);
+	err_code      = app_timer_start(m_sec_req_timer_id, SECURITY_REQUEST_DELAY,
+	                                (void *)(uint32_t)link_conn_handle(link_current()));
 	APP_ERROR_CHECK(err_code);
 }
 
@@ -653,11 +761,100 @@ void device_informayion_server_add(void)
     APP_ERROR_CHECK(err_code);
 }
 
+/**@brief Function for handling alarm and long-sit deadlines.
+ *
+ * @details Called from the main loop. Starts the matching vibration pattern.
+ */
+static void alarm_evt_handler(uint8_t evt, uint8_t index)
+{
+    if (evt == ALARM_EVT_ALARM)
+    {
+        QPRINTF("alarm %d\r\n", index);
+        (void)indicate_play(INDICATE_ALARM);
+    }
+    else
+    {
+        QPRINTF("long sit\r\n");
+        (void)indicate_play(INDICATE_LONG_SIT);
+    }
+}
+
+/**@brief Function for running the step counter on the accelerometer blocks.
+ *
+ * @details Per-minute records are taken off the queue here until the flash writer for
+ *          STEP_DATA exists, and the daily total goes into the scan response summary.
+ */
+static void step_data_process(void)
+{
+    motion_sample_st block[MOTION_BLOCK_SAMPLES];
+    step_record_st   record;
+    sleep_record_st  sleep_record;
+    adv_summary_st   summary;
+    rollup_day_st    today;
+    bool             processed = false;
+    uint32_t         minute_utc;
+    uint32_t         utc;
+    uint16_t         activity;
+    uint8_t          heart_rate;
+
+    while (motion_block_get(block))
+    {
+        step_counter_process(block, MOTION_BLOCK_SAMPLES, system_sec_get());
+        processed = true;
+
+        if (step_minute_activity_get(&minute_utc, &activity))
+        {
+            // Deep idle leaves a gap in the minutes. The band did not move during it, so
+            // sleep staging gets those minutes as still, in order, and a sleep goes on.
+            for (utc = m_minute_fed + 60; (m_minute_fed != 0) && (utc < minute_utc) && deep_idle_covers(utc); utc += 60)
+            {
+                sleep_stage_minute(utc, 0, 0);
+            }
+            m_minute_fed = minute_utc;
+
+            heart_rate = ppg_is_running() ? heart_rate_get() : 0;
+            sleep_stage_minute(minute_utc, activity, heart_rate);
+            rollup_minute(minute_utc, heart_rate);
+            deep_idle_minute(activity);
+        }
+    }
+
+    while (step_record_get(&record))
+    {
+        QPRINTF("step record %d: %d steps, cadence %d\r\n", record.utc, record.steps, record.cadence);
+        rollup_steps(record.utc, record.steps);
+        alarm_activity(record.utc + 60);
+    }
+
+    while (sleep_record_get(&sleep_record))
+    {
+        QPRINTF("sleep record %d: %d min, stage %d, hr %d\r\n", sleep_record.utc, sleep_record.minutes, sleep_record.stage, sleep_record.heart_rate);
+        rollup_sleep(sleep_record.minutes, sleep_record.stage);
+    }
+
+    if (processed)
+    {
+        adv_summary_get(&summary);
+        if (!rollup_day_get(system_sec_get(), &today))
+        {
+            today.active_minutes = summary.active_minutes;
+        }
+        if (summary.steps != step_counter_today() || summary.active_minutes != today.active_minutes)
+        {
+            summary.steps          = step_counter_today();
+            summary.active_minutes = today.active_minutes;
+            adv_summary_set(&summary);
+        }
+    }
+}
+
 /**@brief Function for application main entry.
  */
 int main(void)
 {
-    bool erase_bonds;
+    bool erase_bonds = false;
+    uint32_t err_code;
+    uint8_t summary_key[AUTH_MD5_LENGTH];
 
     // Initialize.
 #if DEBUG_TYPE == DEBUG_UART_TYPE
@@ -672,16 +869,39 @@ int main(void)
     timers_init();
     ble_stack_init();
 
-	system_time_init();
+	err_code = system_time_init();
+	APP_ERROR_CHECK(err_code);
 	device_id_init();
+	usr_login_init();
     device_manager_init(erase_bonds);
     db_discovery_init();
     scheduler_init();
+    lesc_keys_init();
+	err_code = rollup_init();
+	if(err_code != NRF_SUCCESS)
+		QPRINTF("rollup init 0x%x\r\n",err_code);
+	err_code = motion_init();
+	if(err_code != NRF_SUCCESS)
+		QPRINTF("motion init 0x%x\r\n",err_code);
+	step_counter_init();
+	sleep_stage_init();
+	err_code = indicate_init();
+	if(err_code != NRF_SUCCESS)
+		QPRINTF("indicate init 0x%x\r\n",err_code);
+	err_code = alarm_init(alarm_evt_handler);
+	if(err_code != NRF_SUCCESS)
+		QPRINTF("alarm init 0x%x\r\n",err_code);
+	deep_idle_init();
+	err_code = ppg_init(heart_rate_process);
+	if(err_code != NRF_SUCCESS)
+		QPRINTF("ppg init 0x%x\r\n",err_code);
     gap_params_init();
-    ios_ancs_service_init();
+    ios_ancs_service_init(&m_ble_db_discovery);
 	services_add();
 	device_informayion_server_add();
     advertising_init();
+    usr_login_key_get(summary_key);
+    adv_summary_init(summary_key);
     conn_params_init();
 
     // Start execution.
@@ -692,9 +912,14 @@ int main(void)
     for (;;)
     {
         app_sched_execute();
-		remaind_do();
-		trans_evt_call_back();
-		usrdesign_send_data();	
+		// No link is up in deep idle, so only the accelerometer and the timers have work.
+		if (!deep_idle_active())
+		{
+			remaind_do();
+			trans_evt_call_back();
+			usrdesign_send_data();	
+		}
+		step_data_process();
 		
         power_manage();
     }
@@ -0,0 +1,394 @@
+#include "motion.h"
+#include <string.h>
+#include "nrf_drv_gpiote.h"
+#include "app_twi.h"
+#include "app_util.h"
+#include "app_util_platform.h"
+#include "debug.h"
+
+#define MOTION_TWI_QUEUE_SIZE		(2)
+
+#define LIS3DH_WHO_AM_I				(0x0F)
+#define LIS3DH_WHO_AM_I_VALUE		(0x33)
+#define LIS3DH_CTRL_REG1			(0x20)
+#define LIS3DH_CTRL_REG3			(0x22)
+#define LIS3DH_CTRL_REG4			(0x23)
+#define LIS3DH_CTRL_REG5			(0x24)
+#define LIS3DH_REFERENCE			(0x26)
+#define LIS3DH_OUT_X_L				(0x28)
+#define LIS3DH_FIFO_CTRL_REG		(0x2E)
+#define LIS3DH_FIFO_SRC_REG			(0x2F)
+#define LIS3DH_INT1_CFG				(0x30)
+#define LIS3DH_INT1_SRC				(0x31)
+#define LIS3DH_INT1_THS				(0x32)
+#define LIS3DH_AUTO_INCREMENT		(0x80)
+
+#define LIS3DH_ODR_10HZ				(0x20)
+#define LIS3DH_ODR_25HZ				(0x30)
+#define LIS3DH_LP_EN				(0x08)
+#define LIS3DH_XYZ_EN				(0x07)
+#define LIS3DH_HP_IA1				(0x01)		//CTRL_REG2: INT1ֵֻͨ, Ӱ
+#define LIS3DH_I1_IA1				(0x40)
+#define LIS3DH_I1_WTM				(0x04)
+#define LIS3DH_FS_4G				(0x10)
+#define LIS3DH_FS_4G_HR				(0x18)
+#define LIS3DH_FIFO_EN				(0x40)
+#define LIS3DH_LIR_INT1				(0x08)
+#define LIS3DH_INT1_XYZ_HIGH		(0x2A)		//һᳬֵ
+#define LIS3DH_THS_MG_PER_LSB		(32)		//4g
+#define LIS3DH_FIFO_STREAM			(0x80)
+#define LIS3DH_FIFO_SRC_WTM			(0x80)
+#define LIS3DH_FIFO_SRC_OVRN		(0x40)
+
+#define LIS3DH_MG_PER_LSB			(2)			//4g߷ֱģʽ, 12λ
+
+#define MOTION_SAMPLE_BYTES			(6)
+#define MOTION_DRAIN_BYTES			(MOTION_FIFO_WATERMARK * MOTION_SAMPLE_BYTES)
+
+//δֻԭͼʵ, ٲܺߡﹲһ
+#if (MOTION_INT_PIN == TWI1_CONFIG_SCL) || (MOTION_INT_PIN == TWI1_CONFIG_SDA) || \
+	(MOTION_INT_PIN == TWI_MASTER_CONFIG_CLOCK_PIN_NUMBER) || (MOTION_INT_PIN == TWI_MASTER_CONFIG_DATA_PIN_NUMBER) || \
+	((PWM0_ENABLED == 1) && (MOTION_INT_PIN == PWM0_CONFIG_OUT0_PIN))
+#error "MOTION_INT_PINTWIųͻ"
+#endif
+#if (I2S_ENABLED == 1) && \
+	((MOTION_INT_PIN == I2S_CONFIG_SCK_PIN) || (MOTION_INT_PIN == I2S_CONFIG_LRCK_PIN) || \
+	 (MOTION_INT_PIN == I2S_CONFIG_SDOUT_PIN) || (MOTION_INT_PIN == I2S_CONFIG_SDIN_PIN))
+#error "MOTION_INT_PINI2Sųͻ"
+#endif
+
+STATIC_ASSERT(MOTION_FIFO_WATERMARK < 32);
+STATIC_ASSERT(MOTION_DRAIN_BYTES <= 255);
+STATIC_ASSERT((MOTION_RING_SAMPLES & (MOTION_RING_SAMPLES - 1)) == 0);
+STATIC_ASSERT(MOTION_WAKE_ODR_HZ == 10);
+STATIC_ASSERT(MOTION_WAKE_THS_MG >= LIS3DH_THS_MG_PER_LSB && MOTION_WAKE_THS_MG / LIS3DH_THS_MG_PER_LSB < 128);
+
+static app_twi_t m_app_twi = APP_TWI_INSTANCE(1);
+
+//FIFO: FIFO_SRC(־ʱ), OUT_X_Lˮλ,
+//ٶһFIFO_SRCʣ
+static uint8_t m_reg_out  = LIS3DH_OUT_X_L | LIS3DH_AUTO_INCREMENT;
+static uint8_t m_reg_src  = LIS3DH_FIFO_SRC_REG;
+static uint8_t m_drain_buf[MOTION_DRAIN_BYTES];		//EasyDMAֻܷRAM
+static uint8_t m_fifo_src_before;
+static uint8_t m_fifo_src_after;
+
+static app_twi_transfer_t const m_drain_transfers[] =
+{
+	APP_TWI_WRITE(MOTION_TWI_ADDR, &m_reg_src, 1, APP_TWI_NO_STOP),
+	APP_TWI_READ (MOTION_TWI_ADDR, &m_fifo_src_before, 1, 0),
+	APP_TWI_WRITE(MOTION_TWI_ADDR, &m_reg_out, 1, APP_TWI_NO_STOP),
+	APP_TWI_READ (MOTION_TWI_ADDR, m_drain_buf, MOTION_DRAIN_BYTES, 0),
+	APP_TWI_WRITE(MOTION_TWI_ADDR, &m_reg_src, 1, APP_TWI_NO_STOP),
+	APP_TWI_READ (MOTION_TWI_ADDR, &m_fifo_src_after, 1, 0),
+};
+
+//ɼ: ȰREG1~REG5дFIFOˮλж, ص˶ж, FIFObypassպstream, ODR
+static uint8_t const m_stream_ctrl[] = {LIS3DH_CTRL_REG1 | LIS3DH_AUTO_INCREMENT, 0x00, 0x00, LIS3DH_I1_WTM, LIS3DH_FS_4G_HR, LIS3DH_FIFO_EN};
+static uint8_t const m_int1_off[]    = {LIS3DH_INT1_CFG, 0x00};
+static uint8_t const m_fifo_bypass[] = {LIS3DH_FIFO_CTRL_REG, 0x00};
+static uint8_t const m_fifo_stream[] = {LIS3DH_FIFO_CTRL_REG, LIS3DH_FIFO_STREAM | MOTION_FIFO_WATERMARK};
+static uint8_t const m_stream_odr[]  = {LIS3DH_CTRL_REG1, LIS3DH_ODR_25HZ | LIS3DH_XYZ_EN};
+
+//˶: 10Hz͹, FIFO, ͨһᳬֵһINT1; REFERENCEøͨ
+//ӵǰ̬¿ʼ, INT1_SRC
+static uint8_t const m_wake_ctrl[]   = {LIS3DH_CTRL_REG1 | LIS3DH_AUTO_INCREMENT, LIS3DH_ODR_10HZ | LIS3DH_LP_EN | LIS3DH_XYZ_EN,
+										LIS3DH_HP_IA1, LIS3DH_I1_IA1, LIS3DH_FS_4G, LIS3DH_LIR_INT1};
+static uint8_t const m_wake_ths[]    = {LIS3DH_INT1_THS | LIS3DH_AUTO_INCREMENT, MOTION_WAKE_THS_MG / LIS3DH_THS_MG_PER_LSB, 1};
+static uint8_t const m_wake_on[]     = {LIS3DH_INT1_CFG, LIS3DH_INT1_XYZ_HIGH};
+static uint8_t m_reg_reference = LIS3DH_REFERENCE;
+static uint8_t m_reg_int1_src  = LIS3DH_INT1_SRC;
+static uint8_t m_discard;
+
+static app_twi_transfer_t const m_stream_setup[] =
+{
+	APP_TWI_WRITE(MOTION_TWI_ADDR, m_stream_ctrl, sizeof(m_stream_ctrl), 0),
+	APP_TWI_WRITE(MOTION_TWI_ADDR, m_int1_off, sizeof(m_int1_off), 0),
+	APP_TWI_WRITE(MOTION_TWI_ADDR, m_fifo_bypass, sizeof(m_fifo_bypass), 0),
+	APP_TWI_WRITE(MOTION_TWI_ADDR, m_fifo_stream, sizeof(m_fifo_stream), 0),
+	APP_TWI_WRITE(MOTION_TWI_ADDR, m_stream_odr, sizeof(m_stream_odr), 0),
+	APP_TWI_WRITE(MOTION_TWI_ADDR, &m_reg_int1_src, 1, APP_TWI_NO_STOP),
+	APP_TWI_READ (MOTION_TWI_ADDR, &m_discard, 1, 0),
+};
+
+static app_twi_transfer_t const m_wake_setup[] =
+{
+	APP_TWI_WRITE(MOTION_TWI_ADDR, m_wake_ctrl, sizeof(m_wake_ctrl), 0),
+	APP_TWI_WRITE(MOTION_TWI_ADDR, m_fifo_bypass, sizeof(m_fifo_bypass), 0),
+	APP_TWI_WRITE(MOTION_TWI_ADDR, m_wake_ths, sizeof(m_wake_ths), 0),
+	APP_TWI_WRITE(MOTION_TWI_ADDR, &m_reg_reference, 1, APP_TWI_NO_STOP),
+	APP_TWI_READ (MOTION_TWI_ADDR, &m_discard, 1, 0),
+	APP_TWI_WRITE(MOTION_TWI_ADDR, &m_reg_int1_src, 1, APP_TWI_NO_STOP),
+	APP_TWI_READ (MOTION_TWI_ADDR, &m_discard, 1, 0),
+	APP_TWI_WRITE(MOTION_TWI_ADDR, m_wake_on, sizeof(m_wake_on), 0),
+};
+
+static void motion_drain_done(ret_code_t result, void *p_user_data);
+
+static app_twi_transaction_t const m_drain_transaction =
+{
+	.callback            = motion_drain_done,
+	.p_user_data         = NULL,
+	.p_transfers         = m_drain_transfers,
+	.number_of_transfers = sizeof(m_drain_transfers) / sizeof(m_drain_transfers[0]),
+};
+
+//λ: m_ring_headֻTWIжд, m_ring_tailֻѭд
+static motion_sample_st 	m_ring[MOTION_RING_SAMPLES];
+static volatile uint16_t 	m_ring_head;
+static volatile uint16_t 	m_ring_tail;
+
+static volatile bool 		m_drain_busy;
+static motion_wake_handler_t volatile m_wake_handler;	//ΪNULLʱINT1˶ж
+static motion_stats_st 		m_stats;
+
+//ϵֽ, ÿδһַֽ
+static uint32_t transfer_bytes(app_twi_transfer_t const *p_transfers, uint8_t count)
+{
+	uint32_t bytes = 0;
+
+	while(count--)
+		bytes += 1 + p_transfers[count].length;
+	return bytes;
+}
+
+//ѭִе
+static ret_code_t motion_perform(app_twi_transfer_t const *p_transfers, uint8_t count)
+{
+	m_stats.transactions++;
+	m_stats.bus_bytes += transfer_bytes(p_transfers, count);
+	return app_twi_perform(&m_app_twi, p_transfers, count, NULL);
+}
+
+static int16_t raw_to_mg(const uint8_t *p)
+{
+	int16_t raw = (int16_t)((uint16_t)p[0] | ((uint16_t)p[1] << 8));
+
+	return (int16_t)((raw >> 4) * LIS3DH_MG_PER_LSB);
+}
+
+static void motion_drain_start(void)
+{
+	ret_code_t err_code;
+
+	m_drain_busy = true;
+	err_code = app_twi_schedule(&m_app_twi, &m_drain_transaction);
+	if(err_code != NRF_SUCCESS)
+	{
+		m_drain_busy = false;
+		m_stats.errors++;
+		return;
+	}
+	m_stats.transactions++;
+	m_stats.bus_bytes += transfer_bytes(m_drain_transfers, m_drain_transaction.number_of_transfers);
+}
+
+static void motion_drain_done(ret_code_t result, void *p_user_data)
+{
+	uint16_t head = m_ring_head;
+	uint16_t i;
+
+	m_drain_busy = false;
+	if(result != NRF_SUCCESS)
+	{
+		m_stats.errors++;
+		return;
+	}
+
+	for(i = 0; i < MOTION_FIFO_WATERMARK; i++)
+	{
+		if((uint16_t)(head - m_ring_tail) >= MOTION_RING_SAMPLES)
+		{
+			m_stats.dropped += MOTION_FIFO_WATERMARK - i;
+			break;
+		}
+		m_ring[head & (MOTION_RING_SAMPLES - 1)].x = raw_to_mg(&m_drain_buf[i * MOTION_SAMPLE_BYTES + 0]);
+		m_ring[head & (MOTION_RING_SAMPLES - 1)].y = raw_to_mg(&m_drain_buf[i * MOTION_SAMPLE_BYTES + 2]);
+		m_ring[head & (MOTION_RING_SAMPLES - 1)].z = raw_to_mg(&m_drain_buf[i * MOTION_SAMPLE_BYTES + 4]);
+		head++;
+	}
+	m_stats.samples += (uint16_t)(head - m_ring_head);
+	__DMB();					//д߿µhead
+	m_ring_head = head;
+
+	if(m_fifo_src_before & LIS3DH_FIFO_SRC_OVRN)
+		m_stats.overruns++;
+
+	//INT1ǵƽ, 껹ˮλ֮ʱ, ֱٶһ
+	if(m_fifo_src_after & LIS3DH_FIFO_SRC_WTM)
+		motion_drain_start();
+}
+
+static void motion_int_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action)
+{
+	motion_wake_handler_t handler = m_wake_handler;
+
+	m_stats.wakeups++;
+	if(handler != NULL)
+	{
+		//INT1浽motion_stream_resumeINT1_SRC, ڼֻ֪ͨһ
+		m_wake_handler = NULL;
+		m_stats.motion_wakes++;
+		handler();
+		return;
+	}
+	if(!m_drain_busy)
+		motion_drain_start();
+}
+
+/*****************************************************************************
+ *    : motion_init
+ *  : ʼTWILIS3DH, FIFOˮλж
+ *  : 
+ *  : 
+ *   ֵ : NRF_SUCCESS, TWI/GPIOTEĴ, NRF_ERROR_NOT_FOUND:LIS3DH
+ * ޸ʷ : 
+ * ˵     : LIS3DH, GPIOTEûʼʱʼ
+*****************************************************************************/
+uint32_t motion_init(void)
+{
+	ret_code_t err_code;
+	nrf_drv_twi_config_t const twi_config =
+	{
+		.scl                = TWI1_CONFIG_SCL,
+		.sda                = TWI1_CONFIG_SDA,
+		.frequency          = TWI1_CONFIG_FREQUENCY,
+		.interrupt_priority = TWI1_CONFIG_IRQ_PRIORITY,
+	};
+	static uint8_t const reg_who      = LIS3DH_WHO_AM_I;
+	static uint8_t who_am_i;
+	app_twi_transfer_t const probe[] =
+	{
+		APP_TWI_WRITE(MOTION_TWI_ADDR, &reg_who, 1, APP_TWI_NO_STOP),
+		APP_TWI_READ (MOTION_TWI_ADDR, &who_am_i, 1, 0),
+	};
+	nrf_drv_gpiote_in_config_t int_config = GPIOTE_CONFIG_IN_SENSE_LOTOHI(false);
+
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_ring_head = 0;
+	m_ring_tail = 0;
+	m_wake_handler = NULL;
+
+	APP_TWI_INIT(&m_app_twi, &twi_config, MOTION_TWI_QUEUE_SIZE, err_code);
+	if(err_code != NRF_SUCCESS)
+		return err_code;
+
+	err_code = motion_perform(probe, sizeof(probe) / sizeof(probe[0]));
+	if(err_code != NRF_SUCCESS)
+		return err_code;
+	if(who_am_i != LIS3DH_WHO_AM_I_VALUE)
+	{
+		QPRINTF("motion: no LIS3DH, who_am_i=0x%x\r\n", who_am_i);
+		return NRF_ERROR_NOT_FOUND;
+	}
+
+	err_code = motion_perform(m_stream_setup, sizeof(m_stream_setup) / sizeof(m_stream_setup[0]));
+	if(err_code != NRF_SUCCESS)
+		return err_code;
+
+	if(!nrf_drv_gpiote_is_init())
+	{
+		err_code = nrf_drv_gpiote_init();
+		if(err_code != NRF_SUCCESS)
+			return err_code;
+	}
+
+	//senseʽPORT¼, ռ߾GPIOTEͨ, ߵ
+	err_code = nrf_drv_gpiote_in_init(MOTION_INT_PIN, &int_config, motion_int_handler);
+	if(err_code != NRF_SUCCESS)
+		return err_code;
+	nrf_drv_gpiote_in_event_enable(MOTION_INT_PIN, true);
+
+	QPRINTF("motion: %dHz, wake every %d samples\r\n", MOTION_ODR_HZ, MOTION_FIFO_WATERMARK);
+	return NRF_SUCCESS;
+}
+
+uint16_t motion_available(void)
+{
+	return (uint16_t)(m_ring_head - m_ring_tail);
+}
+
+/*****************************************************************************
+ *    : motion_block_get
+ *  : ӻλȡһ
+ *  : 
+ *  : motion_sample_st *p_block  MOTION_BLOCK_SAMPLES
+ *   ֵ : true:ȡ  false:һ
+ * ޸ʷ : 
+ * ˵     : ֻѭ(Ψһ)
+*****************************************************************************/
+bool motion_block_get(motion_sample_st *p_block)
+{
+	uint16_t tail = m_ring_tail;
+	uint16_t i;
+
+	if((uint16_t)(m_ring_head - tail) < MOTION_BLOCK_SAMPLES)
+		return false;
+
+	for(i = 0; i < MOTION_BLOCK_SAMPLES; i++)
+	{
+		p_block[i] = m_ring[tail & (MOTION_RING_SAMPLES - 1)];
+		tail++;
+	}
+	__DMB();					//ٰλû
+	m_ring_tail = tail;
+	return true;
+}
+
+/*****************************************************************************
+ *    : motion_wake_enable
+ *  : ֹͣɼ, LIS3DHֻڶʱж
+ *  : motion_wake_handler_t handler  ʱGPIOTEжһ
+ *  : 
+ *   ֵ : NRF_SUCCESSTWIĴ, ʱڲɼ
+ * ޸ʷ : 
+ * ˵     : ѭ, ; λʣµȡ
+*****************************************************************************/
+uint32_t motion_wake_enable(motion_wake_handler_t handler)
+{
+	ret_code_t err_code;
+
+	//ڼINT1ˮλ˶, жϿһ״̬
+	nrf_drv_gpiote_in_event_disable(MOTION_INT_PIN);
+	err_code = motion_perform(m_wake_setup, sizeof(m_wake_setup) / sizeof(m_wake_setup[0]));
+	if(err_code != NRF_SUCCESS)
+	{
+		m_stats.errors++;
+		(void)motion_perform(m_stream_setup, sizeof(m_stream_setup) / sizeof(m_stream_setup[0]));
+	}
+	else
+		m_wake_handler = handler;
+
+	//Ѿ˵Ļsenseϳ, ©
+	nrf_drv_gpiote_in_event_enable(MOTION_INT_PIN, true);
+	return err_code;
+}
+
+/*****************************************************************************
+ *    : motion_stream_resume
+ *  : ˶ѻصFIFOɼ
+ *  : 
+ *  : 
+ *   ֵ : NRF_SUCCESSTWIĴ
+ * ޸ʷ : 
+ * ˵     : ѭ, ûʱҲԵ; һ1
+*****************************************************************************/
+uint32_t motion_stream_resume(void)
+{
+	ret_code_t err_code;
+
+	nrf_drv_gpiote_in_event_disable(MOTION_INT_PIN);
+	m_wake_handler = NULL;
+	err_code = motion_perform(m_stream_setup, sizeof(m_stream_setup) / sizeof(m_stream_setup[0]));
+	if(err_code != NRF_SUCCESS)
+		m_stats.errors++;
+	nrf_drv_gpiote_in_event_enable(MOTION_INT_PIN, true);
+	return err_code;
+}
+
+void motion_stats_get(motion_stats_st *p_stats)
+{
+	CRITICAL_REGION_ENTER();
+	*p_stats = m_stats;
+	CRITICAL_REGION_EXIT();
+}
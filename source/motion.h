@@ -0,0 +1,51 @@
+#ifndef _MOTION_H_
+#define _MOTION_H_
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MOTION_TWI_ADDR				(0x19)		//LIS3DH, SA0Ӹ
+#define MOTION_INT_PIN				(11)		//LIS3DH INT1, FIFOˮλж. δʵ: ȡpca10040.hARDUINO_0_PIN, ֻԭͼϵ
+#define MOTION_ODR_HZ				(25)
+#define MOTION_FIFO_WATERMARK		(25)		//FIFOﳬôʱж, LIS3DH FIFO32
+#define MOTION_BLOCK_SAMPLES		(25)		//㷨һ
+#define MOTION_RING_SAMPLES			(128)		//2, 㷨ʱ໺5
+#define MOTION_WAKE_ODR_HZ			(10)		//˶ʱ͹ģʽĲ
+#define MOTION_WAKE_THS_MG			(64)		//ͨһᳬֵ㶯, 32mgһ
+
+typedef struct
+{
+	int16_t x;		//mg, 4g
+	int16_t y;
+	int16_t z;
+}motion_sample_st;
+
+typedef struct
+{
+	uint32_t wakeups;			//FIFOˮλжϴ
+	uint32_t transactions;		//TWI, ʼ
+	uint32_t bus_bytes;			//TWIϴֽ
+	uint32_t samples;			//Žλ
+	uint32_t dropped;			//λʱ
+	uint32_t overruns;			//FIFOڶ֮ǰѾ, ඪ
+	uint32_t errors;			//ʧܵTWI
+	uint32_t motion_wakes;		//˶Ѵ
+}motion_stats_st;
+
+typedef void (*motion_wake_handler_t)(void);
+
+/*****************************************************************************
+ * ٶȲɼ: ԼMOTION_ODR_HZFIFO, ˮλʱINT1GPIOTE
+ * , һapp_twi(TWIM EasyDMA)MOTION_FIFO_WATERMARK
+ * FIFO״̬, mgŽߵߵλ. TWIж,
+ * ѭ㷨, ÿȡMOTION_BLOCK_SAMPLES.
+ * ˶: صFIFO, MOTION_WAKE_ODR_HZ͹ģʽ, ֻڶʱ
+ * INT1һж, ֮ǰһֱ; motion_stream_resumeصɼ.
+*****************************************************************************/
+uint32_t motion_init(void);
+uint16_t motion_available(void);							//λ
+bool motion_block_get(motion_sample_st *p_block);			//һʱfalse
+uint32_t motion_wake_enable(motion_wake_handler_t handler);	//handlerGPIOTEжһ
+uint32_t motion_stream_resume(void);
+void motion_stats_get(motion_stats_st *p_stats);
+
+#endif
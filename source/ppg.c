@@ -0,0 +1,207 @@
+#include "ppg.h"
+#include <string.h>
+#include "nrf_drv_saadc.h"
+#include "nrf_drv_timer.h"
+#include "nrf_drv_ppi.h"
+#include "nrf_drv_gpiote.h"
+#include "nrf_gpio.h"
+#include "app_scheduler.h"
+#include "app_util_platform.h"
+#include "debug.h"
+
+#define PPG_ADC_INPUT				NRF_SAADC_INPUT_AIN6
+#define PPG_ADC_CHANNEL				(0)
+#define PPG_PERIOD_US				(1000000 / PPG_SAMPLE_HZ)
+
+//TIMER11MHz, ƵPPG_PERIOD_US; Ƚֵ1ʼ, һĲ©
+#define PPG_CC_LED_ON				(1)
+#define PPG_CC_SAMPLE				(PPG_CC_LED_ON + PPG_LED_SETTLE_US)
+#define PPG_CC_LED_OFF				(PPG_CC_LED_ON + PPG_LED_ON_US)
+
+STATIC_ASSERT(PPG_LED_ON_US > PPG_LED_SETTLE_US);
+STATIC_ASSERT(PPG_CC_LED_OFF < PPG_PERIOD_US);
+
+static const nrf_drv_timer_t m_timer = NRF_DRV_TIMER_INSTANCE(1);
+
+static nrf_saadc_value_t m_buffer[2][PPG_BLOCK_SAMPLES];
+static nrf_ppi_channel_t m_ppi_led_on;
+static nrf_ppi_channel_t m_ppi_sample;
+static nrf_ppi_channel_t m_ppi_led_off;
+
+static ppg_block_handler_t m_handler;
+static bool m_running = false;
+static volatile uint8_t m_pending;		//ѾûĿ
+static ppg_stats_st m_stats;
+
+static void ppg_block_process(void *p_event_data,uint16_t event_size)
+{
+	nrf_saadc_value_t *p_block = *(nrf_saadc_value_t **)p_event_data;
+
+	if(m_running)
+		m_handler(p_block,PPG_BLOCK_SAMPLES);
+
+	CRITICAL_REGION_ENTER();
+	m_pending--;
+	CRITICAL_REGION_EXIT();
+}
+
+static void ppg_saadc_handler(nrf_drv_saadc_evt_t const *p_event)
+{
+	nrf_saadc_value_t *p_block;
+
+	if(p_event->type != NRF_DRV_SAADC_EVT_DONE)
+		return;
+
+	//Ѿһ黺沢START, ŵ
+	p_block = p_event->data.done.p_buffer;
+	if(nrf_drv_saadc_buffer_convert(p_block,PPG_BLOCK_SAMPLES) != NRF_SUCCESS)
+		m_stats.errors++;
+
+	m_stats.blocks++;
+	if(m_pending)
+		m_stats.overruns++;
+
+	if(app_sched_event_put(&p_block,sizeof(p_block),ppg_block_process) == NRF_SUCCESS)
+		m_pending++;
+}
+
+static void ppg_timer_handler(nrf_timer_event_t event_type,void *p_context)
+{
+	//Ƚ¼PPI, ж
+}
+
+static uint32_t ppg_ppi_connect(nrf_ppi_channel_t *p_channel,uint32_t eep,uint32_t tep)
+{
+	uint32_t err_code;
+
+	err_code = nrf_drv_ppi_channel_alloc(p_channel);
+	if(err_code != NRF_SUCCESS)
+		return err_code;
+
+	return nrf_drv_ppi_channel_assign(*p_channel,eep,tep);
+}
+
+/*****************************************************************************
+ *    : ppg_init
+ *  : ʼSAADC, TIMER1, PPILED, ʼ
+ *  : ppg_block_handler_t handler  ѭﴦһĺ
+ *  : 
+ *   ֵ : NRF_SUCCESSصĴ
+ * ޸ʷ : 
+ * ˵     : Ҫscheduler_initGPIOTEʼ֮
+*****************************************************************************/
+uint32_t ppg_init(ppg_block_handler_t handler)
+{
+	uint32_t err_code;
+	nrf_drv_saadc_config_t saadc_config = NRF_DRV_SAADC_DEFAULT_CONFIG;
+	nrf_saadc_channel_config_t channel_config = NRF_DRV_SAADC_DEFAULT_CHANNEL_CONFIG_SE(PPG_ADC_INPUT);
+	nrf_drv_timer_config_t timer_config = NRF_DRV_TIMER_DEFAULT_CONFIG(1);
+	nrf_drv_gpiote_out_config_t led_config = GPIOTE_CONFIG_OUT_TASK_TOGGLE(false);
+
+	m_handler = handler;
+	memset(&m_stats,0,sizeof(m_stats));
+
+	err_code = nrf_drv_saadc_init(&saadc_config,ppg_saadc_handler);
+	if(err_code != NRF_SUCCESS)
+		return err_code;
+	err_code = nrf_drv_saadc_channel_init(PPG_ADC_CHANNEL,&channel_config);
+	if(err_code != NRF_SUCCESS)
+		return err_code;
+
+	err_code = nrf_drv_timer_init(&m_timer,&timer_config,ppg_timer_handler);
+	if(err_code != NRF_SUCCESS)
+		return err_code;
+	nrf_drv_timer_compare(&m_timer,NRF_TIMER_CC_CHANNEL0,PPG_CC_LED_ON,false);
+	nrf_drv_timer_compare(&m_timer,NRF_TIMER_CC_CHANNEL1,PPG_CC_SAMPLE,false);
+	nrf_drv_timer_compare(&m_timer,NRF_TIMER_CC_CHANNEL2,PPG_CC_LED_OFF,false);
+	nrf_drv_timer_extended_compare(&m_timer,NRF_TIMER_CC_CHANNEL3,PPG_PERIOD_US,
+								   NRF_TIMER_SHORT_COMPARE3_CLEAR_MASK,false);
+
+	//LED÷ת, ÿڿظһ
+	if(!nrf_drv_gpiote_is_init())
+	{
+		err_code = nrf_drv_gpiote_init();
+		if(err_code != NRF_SUCCESS)
+			return err_code;
+	}
+	err_code = nrf_drv_gpiote_out_init(PPG_LED_PIN,&led_config);
+	if(err_code != NRF_SUCCESS)
+		return err_code;
+
+	err_code = nrf_drv_ppi_init();
+	if(err_code != NRF_SUCCESS && err_code != MODULE_ALREADY_INITIALIZED)
+		return err_code;
+	err_code = ppg_ppi_connect(&m_ppi_led_on,
+							   nrf_drv_timer_compare_event_address_get(&m_timer,NRF_TIMER_CC_CHANNEL0),
+							   nrf_drv_gpiote_out_task_addr_get(PPG_LED_PIN));
+	if(err_code != NRF_SUCCESS)
+		return err_code;
+	err_code = ppg_ppi_connect(&m_ppi_sample,
+							   nrf_drv_timer_compare_event_address_get(&m_timer,NRF_TIMER_CC_CHANNEL1),
+							   nrf_drv_saadc_sample_task_get());
+	if(err_code != NRF_SUCCESS)
+		return err_code;
+	return ppg_ppi_connect(&m_ppi_led_off,
+						   nrf_drv_timer_compare_event_address_get(&m_timer,NRF_TIMER_CC_CHANNEL2),
+						   nrf_drv_gpiote_out_task_addr_get(PPG_LED_PIN));
+}
+
+uint32_t ppg_start(void)
+{
+	uint32_t err_code;
+
+	if(m_running)
+		return NRF_SUCCESS;
+
+	err_code = nrf_drv_saadc_buffer_convert(m_buffer[0],PPG_BLOCK_SAMPLES);
+	if(err_code != NRF_SUCCESS)
+		return err_code;
+	err_code = nrf_drv_saadc_buffer_convert(m_buffer[1],PPG_BLOCK_SAMPLES);
+	if(err_code != NRF_SUCCESS)
+	{
+		nrf_drv_saadc_abort();
+		return err_code;
+	}
+
+	(void)nrf_drv_ppi_channel_enable(m_ppi_led_on);
+	(void)nrf_drv_ppi_channel_enable(m_ppi_sample);
+	(void)nrf_drv_ppi_channel_enable(m_ppi_led_off);
+	nrf_drv_gpiote_out_task_enable(PPG_LED_PIN);
+
+	m_running = true;
+	nrf_drv_timer_clear(&m_timer);
+	nrf_drv_timer_enable(&m_timer);
+	QPRINTF("ppg start\r\n");
+	return NRF_SUCCESS;
+}
+
+void ppg_stop(void)
+{
+	if(!m_running)
+		return;
+
+	m_running = false;
+	nrf_drv_timer_disable(&m_timer);
+	(void)nrf_drv_ppi_channel_disable(m_ppi_led_on);
+	(void)nrf_drv_ppi_channel_disable(m_ppi_sample);
+	(void)nrf_drv_ppi_channel_disable(m_ppi_led_off);
+
+	//ͣCC0CC2֮, صŻصGPIOĵ͵ƽ, ´οִӵͿʼת
+	nrf_drv_gpiote_out_task_disable(PPG_LED_PIN);
+	nrf_gpio_pin_clear(PPG_LED_PIN);
+	nrf_drv_saadc_abort();
+	QPRINTF("ppg stop\r\n");
+}
+
+bool ppg_is_running(void)
+{
+	return m_running;
+}
+
+void ppg_stats_get(ppg_stats_st *p_stats)
+{
+	CRITICAL_REGION_ENTER();
+	*p_stats = m_stats;
+	CRITICAL_REGION_EXIT();
+}
+
@@ -0,0 +1,35 @@
+#ifndef _PPG_H_
+#define _PPG_H_
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PPG_LED_PIN					(24)		//̹LED, ߵƽ
+#define PPG_ADC_PIN					(30)		//AIN6, ܷŴ
+#define PPG_SAMPLE_HZ				(50)
+#define PPG_BLOCK_SAMPLES			(50)		//һ黽CPUһ
+#define PPG_LED_SETTLE_US			(100)		//LEDôٲ
+#define PPG_LED_ON_US				(150)		//ÿβLEDʱ
+
+typedef void (*ppg_block_handler_t)(const int16_t *p_block,uint16_t count);
+
+typedef struct
+{
+	uint32_t blocks;			//Ŀ
+	uint32_t overruns;			//һ黹ûһ͵
+	uint32_t errors;			//SAADCŻʧ
+}ppg_stats_st;
+
+
+/*****************************************************************************
+ * PPGɼ: TIMER1ÿ1/PPG_SAMPLE_HZһ, PPICC0LED, CC1
+ * SAADC, CC2LED, ̲CPU. SAADCEasyDMAװ,
+ * һ˽жϰŵβ, پapp_schedulerѭhandler.
+ * handlerҪһ֮ǰ. ppg_stopҪSAADCж, ֻѭ.
+*****************************************************************************/
+uint32_t ppg_init(ppg_block_handler_t handler);
+uint32_t ppg_start(void);
+void ppg_stop(void);
+bool ppg_is_running(void);
+void ppg_stats_get(ppg_stats_st *p_stats);
+
+#endif
@@ -0,0 +1,405 @@
+#include "rollup.h"
+#include <string.h>
+#include <stddef.h>
+#include "nordic_common.h"
+#include "pstorage.h"
+#include "app_util.h"
+#include "sleep_stage.h"
+#include "debug.h"
+
+#define ROLLUP_MAGIC				(0xDA7A)
+#define ROLLUP_DAY_SEC				(86400)
+#define ROLLUP_HOUR_SEC				(3600)
+#define ROLLUP_HOUR_EMPTY			(0xFFFF)		//ûдСʱ, flashֵ
+#define ROLLUP_DAY_OPEN				(0xFFFFFFFF)	//ܻûд
+
+typedef struct
+{
+	uint16_t day;
+	uint16_t magic;
+	rollup_day_st summary;			//һβʱдflash
+}rollup_header_st;
+
+typedef struct
+{
+	rollup_header_st header;
+	rollup_hour_st hours[ROLLUP_HOURS];
+}rollup_block_st;
+
+STATIC_ASSERT(sizeof(rollup_header_st) == 16);
+STATIC_ASSERT(sizeof(rollup_block_st) * ROLLUP_DAYS <= 4096);
+
+static pstorage_handle_t m_storage;
+static rollup_header_st m_days[ROLLUP_DAYS];		//ÿ, magicǿտ
+static rollup_block_st m_blocks[2];				//Ŀֻ, ǰһŶдݲᱻǵ
+static rollup_block_st *m_today;				//NULL: ûжԹʱ
+static bool m_today_closed;						//ĻѾдflash, д
+
+static uint8_t m_hour;							//ǰСʱ
+static uint32_t m_hour_steps;
+static uint8_t m_hour_active;
+static uint16_t m_hour_hr_sum;
+static uint8_t m_hour_hr_count;
+
+static rollup_stats_st m_stats;
+
+static void rollup_storage_cb(pstorage_handle_t *p_handle,uint8_t op_code,uint32_t result,
+							  uint8_t *p_data,uint32_t data_len)
+{
+	if(result != NRF_SUCCESS)
+	{
+		m_stats.errors++;
+		QPRINTF("rollup flash op %d failed 0x%x\r\n",op_code,result);
+	}
+}
+
+static uint32_t rollup_load(uint16_t index,void *p_dest,uint16_t size,uint16_t offset)
+{
+	pstorage_handle_t handle;
+	uint32_t err_code;
+
+	err_code = pstorage_block_identifier_get(&m_storage,index,&handle);
+	if(err_code == NRF_SUCCESS)
+		err_code = pstorage_load((uint8_t *)p_dest,&handle,size,offset);
+	m_stats.flash_reads++;
+	return err_code;
+}
+
+//p_srcΪNULLʱ; ΪNULLʱҪһֱЧpstorageд
+static void rollup_store(uint16_t index,void *p_src,uint16_t size,uint16_t offset)
+{
+	pstorage_handle_t handle;
+	uint32_t err_code;
+
+	err_code = pstorage_block_identifier_get(&m_storage,index,&handle);
+	if(err_code == NRF_SUCCESS)
+	{
+		if(p_src == NULL)
+			err_code = pstorage_clear(&handle,sizeof(rollup_block_st));
+		else
+			err_code = pstorage_store(&handle,(uint8_t *)p_src,size,offset);
+	}
+	m_stats.flash_writes++;
+	if(err_code != NRF_SUCCESS)
+	{
+		m_stats.errors++;
+		QPRINTF("rollup flash 0x%x\r\n",err_code);
+	}
+}
+
+//ʶСʱ, ˯ۼӵ, 
+static void rollup_summary_build(const rollup_hour_st *p_hours,rollup_day_st *p_summary)
+{
+	uint16_t hr_sum = 0;
+	uint8_t hr_count = 0;
+	uint8_t i;
+
+	p_summary->steps          = 0;
+	p_summary->active_minutes = 0;
+	p_summary->heart_rate_min = 0;
+	for(i=0;i<ROLLUP_HOURS;i++)
+	{
+		if(p_hours[i].steps == ROLLUP_HOUR_EMPTY)
+			continue;
+		p_summary->steps          += p_hours[i].steps;
+		p_summary->active_minutes += p_hours[i].active_minutes;
+		if(p_hours[i].heart_rate)
+		{
+			hr_sum += p_hours[i].heart_rate;
+			hr_count++;
+			if(p_summary->heart_rate_min == 0 || p_hours[i].heart_rate < p_summary->heart_rate_min)
+				p_summary->heart_rate_min = p_hours[i].heart_rate;
+		}
+	}
+	p_summary->heart_rate = hr_count ? (uint8_t)((hr_sum + hr_count / 2) / hr_count) : 0;
+}
+
+static bool rollup_block_erased(const rollup_block_st *p_block)
+{
+	const uint32_t *p_word = (const uint32_t *)p_block;
+	uint8_t i;
+
+	for(i=0;i<sizeof(rollup_block_st)/sizeof(uint32_t);i++)
+	{
+		if(p_word[i] != 0xFFFFFFFF)
+			return false;
+	}
+	return true;
+}
+
+static void rollup_day_open(uint16_t day)
+{
+	uint16_t index = day % ROLLUP_DAYS;
+
+	m_today = (m_today == &m_blocks[0]) ? &m_blocks[1] : &m_blocks[0];
+	(void)rollup_load(index,m_today,sizeof(rollup_block_st),0);
+
+	if(m_today->header.magic == ROLLUP_MAGIC && m_today->header.day == day)
+	{
+		//λǰʱص֮ǰһ, , ûдСʱд.
+		//ûβ˯ֻRAM, ; β˯flash, ܲд
+		m_today_closed = (m_today->header.summary.steps != ROLLUP_DAY_OPEN);
+		if(!m_today_closed)
+		{
+			m_today->header.summary.sleep_minutes = 0;
+			m_today->header.summary.deep_minutes  = 0;
+		}
+	}
+	else
+	{
+		m_today_closed = false;
+		if(!rollup_block_erased(m_today))
+			rollup_store(index,NULL,0,0);
+
+		memset(m_today,0xFF,sizeof(rollup_block_st));
+		m_today->header.day   = day;
+		m_today->header.magic = ROLLUP_MAGIC;
+		m_today->header.summary.sleep_minutes = 0;
+		m_today->header.summary.deep_minutes  = 0;
+		rollup_store(index,&m_today->header,offsetof(rollup_header_st,summary),0);
+	}
+
+	rollup_summary_build(m_today->hours,&m_today->header.summary);
+	m_days[index] = m_today->header;
+}
+
+static void rollup_hour_close(void)
+{
+	uint16_t index = m_today->header.day % ROLLUP_DAYS;
+	rollup_hour_st *p_hour = &m_today->hours[m_hour];
+
+	if(m_hour_steps == 0 && m_hour_active == 0 && m_hour_hr_count == 0)
+		return;
+
+	m_hour_steps = MIN(m_hour_steps,ROLLUP_HOUR_EMPTY - 1);
+	if(p_hour->steps != ROLLUP_HOUR_EMPTY)
+	{
+		//ʱص, СʱѾд
+		m_stats.late += m_hour_steps;
+	}
+	else
+	{
+		p_hour->steps          = (uint16_t)m_hour_steps;
+		p_hour->active_minutes = m_hour_active;
+		p_hour->heart_rate     = m_hour_hr_count ? (uint8_t)((m_hour_hr_sum + m_hour_hr_count / 2) / m_hour_hr_count) : 0;
+		rollup_store(index,p_hour,sizeof(rollup_hour_st),offsetof(rollup_block_st,hours) + m_hour * sizeof(rollup_hour_st));
+		m_stats.hours++;
+
+		rollup_summary_build(m_today->hours,&m_today->header.summary);
+		m_days[index] = m_today->header;
+	}
+
+	m_hour_steps    = 0;
+	m_hour_active   = 0;
+	m_hour_hr_sum   = 0;
+	m_hour_hr_count = 0;
+}
+
+static void rollup_day_close(void)
+{
+	uint16_t index = m_today->header.day % ROLLUP_DAYS;
+
+	rollup_hour_close();
+	if(!m_today_closed)
+		rollup_store(index,&m_today->header.summary,sizeof(rollup_day_st),offsetof(rollup_header_st,summary));
+	m_today_closed = true;
+	m_days[index] = m_today->header;
+	m_stats.days++;
+}
+
+//βutc֮ǰСʱ, ûԹʱfalse
+static bool rollup_advance(uint32_t utc)
+{
+	uint16_t day = utc / ROLLUP_DAY_SEC;
+	uint8_t hour = (utc % ROLLUP_DAY_SEC) / ROLLUP_HOUR_SEC;
+
+	if(utc < ROLLUP_EPOCH_MIN)
+		return false;
+
+	if(m_today == NULL)
+	{
+		rollup_day_open(day);
+		m_hour = hour;
+	}
+	else if(day != m_today->header.day)
+	{
+		rollup_day_close();
+		rollup_day_open(day);
+		m_hour = hour;
+	}
+	else if(hour != m_hour)
+	{
+		rollup_hour_close();
+		m_hour = hour;
+	}
+	return true;
+}
+
+static bool rollup_is_late(uint32_t utc)
+{
+	uint16_t day = utc / ROLLUP_DAY_SEC;
+	uint8_t hour = (utc % ROLLUP_DAY_SEC) / ROLLUP_HOUR_SEC;
+
+	if(m_today == NULL)
+		return false;
+
+	return day < m_today->header.day || (day == m_today->header.day && hour < m_hour);
+}
+
+/*****************************************************************************
+ *    : rollup_init
+ *  : עflash, ÿ
+ *  : 
+ *  : 
+ *   ֵ : pstorage_registerĽ
+ * ޸ʷ : 
+ * ˵     : ʶдȥСʱ, βֲдСʱҲ,
+ *            ÿflash. ûβ˯ߴ0ʼ
+*****************************************************************************/
+uint32_t rollup_init(void)
+{
+	pstorage_module_param_t param;
+	rollup_block_st block;
+	uint32_t err_code;
+	uint16_t i;
+
+	memset(&m_stats,0,sizeof(m_stats));
+	memset(m_days,0,sizeof(m_days));
+	m_today = NULL;
+	m_hour_steps    = 0;
+	m_hour_active   = 0;
+	m_hour_hr_sum   = 0;
+	m_hour_hr_count = 0;
+
+	param.block_size  = sizeof(rollup_block_st);
+	param.block_count = ROLLUP_DAYS;
+	param.cb          = rollup_storage_cb;
+	err_code = pstorage_register(&param,&m_storage);
+	if(err_code != NRF_SUCCESS)
+		return err_code;
+
+	for(i=0;i<ROLLUP_DAYS;i++)
+	{
+		if(rollup_load(i,&block.header,sizeof(rollup_header_st),0) != NRF_SUCCESS ||
+		   block.header.magic != ROLLUP_MAGIC || block.header.day % ROLLUP_DAYS != i ||
+		   rollup_load(i,block.hours,sizeof(block.hours),offsetof(rollup_block_st,hours)) != NRF_SUCCESS)
+			continue;
+
+		if(block.header.summary.steps == ROLLUP_DAY_OPEN)
+		{
+			block.header.summary.sleep_minutes = 0;
+			block.header.summary.deep_minutes  = 0;
+		}
+		rollup_summary_build(block.hours,&block.header.summary);
+		m_days[i] = block.header;
+	}
+	return NRF_SUCCESS;
+}
+
+void rollup_minute(uint32_t utc,uint8_t heart_rate)
+{
+	//ʱص: ΪһӰѵβ, ٴǰһ
+	if(rollup_is_late(utc) || !rollup_advance(utc))
+		return;
+
+	if(heart_rate)
+	{
+		m_hour_hr_sum += heart_rate;
+		m_hour_hr_count++;
+	}
+}
+
+void rollup_steps(uint32_t utc,uint16_t steps)
+{
+	if(rollup_is_late(utc))
+	{
+		m_stats.late += steps;
+		return;
+	}
+	if(!rollup_advance(utc))
+		return;
+
+	m_hour_steps += steps;
+	if(steps && m_hour_active < 60)
+		m_hour_active++;
+}
+
+void rollup_sleep(uint16_t minutes,uint8_t stage)
+{
+	rollup_day_st *p_summary;
+
+	if(m_today == NULL || stage == SLEEP_STAGE_WAKE)
+		return;
+
+	p_summary = &m_today->header.summary;
+	p_summary->sleep_minutes += minutes;
+	if(stage == SLEEP_STAGE_DEEP)
+		p_summary->deep_minutes += minutes;
+	m_days[m_today->header.day % ROLLUP_DAYS] = m_today->header;
+}
+
+/*****************************************************************************
+ *    : rollup_day_get
+ *  : ȡһĻ
+ *  : uint32_t utc  һʱ()
+ *  : rollup_day_st *p_day  , İûβСʱ
+ *   ֵ : һݷtrue
+ * ޸ʷ : 
+ * ˵     : ֻRAMĻܱ, flash
+*****************************************************************************/
+bool rollup_day_get(uint32_t utc,rollup_day_st *p_day)
+{
+	uint16_t day = utc / ROLLUP_DAY_SEC;
+	const rollup_header_st *p_header = &m_days[day % ROLLUP_DAYS];
+
+	if(p_header->magic != ROLLUP_MAGIC || p_header->day != day)
+		return false;
+
+	*p_day = p_header->summary;
+	if(m_today != NULL && day == m_today->header.day)
+	{
+		p_day->steps          += m_hour_steps;
+		p_day->active_minutes += m_hour_active;
+	}
+	return true;
+}
+
+/*****************************************************************************
+ *    : rollup_hour_get
+ *  : ȡһСʱĻ
+ *  : uint32_t utc  ǸСʱʱ()
+ *  : rollup_hour_st *p_hour  
+ *   ֵ : Сʱݷtrue
+ * ޸ʷ : 
+ * ˵     : RAM, ǰĴflash4ֽ
+*****************************************************************************/
+bool rollup_hour_get(uint32_t utc,rollup_hour_st *p_hour)
+{
+	uint16_t day = utc / ROLLUP_DAY_SEC;
+	uint8_t hour = (utc % ROLLUP_DAY_SEC) / ROLLUP_HOUR_SEC;
+	uint16_t index = day % ROLLUP_DAYS;
+
+	if(m_days[index].magic != ROLLUP_MAGIC || m_days[index].day != day)
+		return false;
+
+	if(m_today != NULL && day == m_today->header.day)
+	{
+		if(hour == m_hour)
+		{
+			p_hour->steps          = (uint16_t)MIN(m_hour_steps,ROLLUP_HOUR_EMPTY - 1);
+			p_hour->active_minutes = m_hour_active;
+			p_hour->heart_rate     = m_hour_hr_count ? (uint8_t)((m_hour_hr_sum + m_hour_hr_count / 2) / m_hour_hr_count) : 0;
+			return true;
+		}
+		*p_hour = m_today->hours[hour];
+	}
+	else if(rollup_load(index,p_hour,sizeof(rollup_hour_st),offsetof(rollup_block_st,hours) + hour * sizeof(rollup_hour_st)) != NRF_SUCCESS)
+		return false;
+
+	return p_hour->steps != ROLLUP_HOUR_EMPTY;
+}
+
+void rollup_stats_get(rollup_stats_st *p_stats)
+{
+	*p_stats = m_stats;
+}
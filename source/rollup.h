@@ -0,0 +1,56 @@
+#ifndef _ROLLUP_H_
+#define _ROLLUP_H_
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ROLLUP_DAYS					(32)		//flashﱣ, һһ, һҳ
+#define ROLLUP_HOURS				(24)
+#define ROLLUP_EPOCH_MIN			(1451606400)	//2016-01-01, ֮ǰʱǻûʱ, ͳ
+
+typedef struct
+{
+	uint16_t steps;
+	uint8_t active_minutes;		//вķ
+	uint8_t heart_rate;			//һСʱƽ, 0ʾû
+}rollup_hour_st;
+
+typedef struct
+{
+	uint32_t steps;
+	uint16_t active_minutes;
+	uint16_t sleep_minutes;		//һ˯߷ֶ, мѵ
+	uint16_t deep_minutes;
+	uint8_t heart_rate;			//ʵСʱƽֵ
+	uint8_t heart_rate_min;		//͵Сʱƽ, Ϣ
+}rollup_day_st;
+
+typedef struct
+{
+	uint32_t hours;				//βСʱ
+	uint32_t days;				//β
+	uint32_t late;				//ڵСʱѾβ, ûĲ
+	uint32_t flash_reads;		//ѯʱflashĴ
+	uint32_t flash_writes;		//pstorageдͲ
+	uint32_t errors;			//pstorageصĴ
+}rollup_stats_st;
+
+
+/*****************************************************************************
+ * ->Сʱ->Ļ: ǰСʱRAMﰴۼ, Сʱβʱдǿ
+ * flashСʱ(4ֽ, ֻдһ, ), һβʱдĻ(12ֽ).
+ * ÿflashRAMһ, ĳ첻flash, ĳСʱ4ֽ,
+ * ɨԭʼ¼. һһ鰴ȡģѭ, һʱһ. λ
+ * flashָܱ, ѾдȥСʱ; ûдȥһСʱᶪ.
+ * ֻصflashѾеһ(λ, ʱص)ʱһ, .
+ * СʱѾβ(ʱص).
+ * ʱ䶼Ǳ(system_sec_get), Ǳʱ.
+*****************************************************************************/
+uint32_t rollup_init(void);												//pstorage_init֮
+void rollup_minute(uint32_t utc,uint8_t heart_rate);					//ÿһ, utcһӿʼʱ
+void rollup_steps(uint32_t utc,uint16_t steps);							//һӼƲ¼
+void rollup_sleep(uint16_t minutes,uint8_t stage);						//һ˯߷ֶμ¼, 㵽
+bool rollup_day_get(uint32_t utc,rollup_day_st *p_day);				//utcڵ, ûݷfalse
+bool rollup_hour_get(uint32_t utc,rollup_hour_st *p_hour);				//utcڵǸСʱ, ûݷfalse
+void rollup_stats_get(rollup_stats_st *p_stats);
+
+#endif
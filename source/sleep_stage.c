@@ -0,0 +1,303 @@
+#include "sleep_stage.h"
+#include <string.h>
+
+#define SLEEP_WINDOW				(7)							//ǰ4, ǰ, 2
+#define SLEEP_LAG					(2)							//ҪȺ2Ӳеǰ
+#define SLEEP_WAKE_D				(10 * 665)					//Ȩƽ10mg
+#define SLEEP_DEEP_D				(1 * 665)					//Ȩƽ1mg²ſ˯
+#define SLEEP_ACTIVITY_CAP			(40)						//һӶٶҲֻô, ǰ󼸷Ӷ
+#define SLEEP_HR_AVG_SHIFT			(5)
+#define SLEEP_HR_FRAC				(4)							//ƽʴQ4
+#define SLEEP_INVALID				(0xFFFFFFFF)
+
+//Cole-KripkeȨ, A-4 ~ A+2, 665
+static const uint8_t m_weights[SLEEP_WINDOW] = {106, 54, 58, 76, 230, 74, 67};
+//ٷӲŻ, SLEEP_STAGE_WAKE/LIGHT/DEEP
+static const uint8_t m_stage_run[3] = {3, 3, 10};
+
+typedef struct
+{
+	uint32_t utc;
+	uint16_t minutes;
+	uint8_t stage;
+	uint16_t hr_sum;		//ʵķӵʺ
+	uint8_t hr_count;
+}sleep_segment_st;
+
+static uint8_t m_window[SLEEP_WINDOW];		//, ʱ价δ
+static uint8_t m_window_hr[SLEEP_WINDOW];
+static uint8_t m_window_next;
+static uint8_t m_window_count;
+static uint32_t m_last_utc;
+
+static bool m_in_sleep;
+static uint16_t m_onset_run;				//û˯ʱ˯ķ
+static uint32_t m_onset_utc;
+static uint16_t m_hr_avg;					//˯ߵƽ, Q4, 0ʾû
+static sleep_segment_st m_current;			//ڽеһ
+static sleep_segment_st m_pending;			//·, minutesΪ0ʾû
+
+static sleep_record_st m_records[SLEEP_RECORD_QUEUE];
+static uint8_t m_record_head;
+static uint8_t m_record_count;
+
+static sleep_stats_st m_stats;
+
+static void sleep_record_put(const sleep_segment_st *p_segment)
+{
+	sleep_record_st *p_record;
+
+	if(m_record_count == SLEEP_RECORD_QUEUE)
+	{
+		m_record_head = (m_record_head + 1) % SLEEP_RECORD_QUEUE;
+		m_record_count--;
+		m_stats.records_lost++;
+	}
+	p_record = &m_records[(m_record_head + m_record_count) % SLEEP_RECORD_QUEUE];
+	p_record->utc        = p_segment->utc;
+	p_record->minutes    = p_segment->minutes;
+	p_record->stage      = p_segment->stage;
+	p_record->heart_rate = p_segment->hr_count ? (uint8_t)((p_segment->hr_sum + p_segment->hr_count / 2) / p_segment->hr_count) : 0;
+	m_record_count++;
+	m_stats.records++;
+}
+
+static void sleep_segment_add(sleep_segment_st *p_segment,uint16_t minutes,uint16_t hr_sum,uint8_t hr_count)
+{
+	p_segment->minutes += minutes;
+	//һκܳʱʺͻ, С, ƽֵ
+	while(p_segment->hr_sum + hr_sum < p_segment->hr_sum || p_segment->hr_count + hr_count > 0xFF)
+	{
+		p_segment->hr_sum   >>= 1;
+		p_segment->hr_count >>= 1;
+	}
+	p_segment->hr_sum   += hr_sum;
+	p_segment->hr_count += hr_count;
+}
+
+static void sleep_session_end(void)
+{
+	//ŵǶ, ¼; ݶ˽, ˯ŵǶ
+	if(m_in_sleep)
+	{
+		if(m_current.stage != SLEEP_STAGE_WAKE)
+		{
+			sleep_segment_add(&m_current,m_pending.minutes,m_pending.hr_sum,m_pending.hr_count);
+			sleep_record_put(&m_current);
+		}
+		m_stats.sessions++;
+	}
+
+	m_in_sleep  = false;
+	m_onset_run = 0;
+	m_hr_avg    = 0;
+	m_pending.minutes = 0;
+}
+
+static uint8_t sleep_classify(uint32_t d,uint8_t hr)
+{
+	if(d >= SLEEP_WAKE_D)
+		return SLEEP_STAGE_WAKE;
+
+	if(d >= SLEEP_DEEP_D)
+		return SLEEP_STAGE_LIGHT;
+
+	//˯ʱʽ˯ߵƽֵ, ûֻ
+	if(hr && m_hr_avg && ((uint16_t)hr << SLEEP_HR_FRAC) > m_hr_avg)
+		return SLEEP_STAGE_LIGHT;
+
+	return SLEEP_STAGE_DEEP;
+}
+
+static void sleep_stage_step(uint8_t stage,uint32_t utc,uint8_t hr)
+{
+	sleep_segment_st *p_add;
+
+	if(stage == m_current.stage)
+	{
+		//мĶ̷ڲصǰ
+		sleep_segment_add(&m_current,m_pending.minutes,m_pending.hr_sum,m_pending.hr_count);
+		m_pending.minutes = 0;
+		p_add = &m_current;
+	}
+	else
+	{
+		//ŵʱǳ˯˯, ǳ˯, Ȼѵν
+		if(m_pending.minutes && stage != m_pending.stage && stage != SLEEP_STAGE_WAKE && m_pending.stage != SLEEP_STAGE_WAKE)
+			m_pending.stage = SLEEP_STAGE_LIGHT;
+		else if(m_pending.minutes && stage != m_pending.stage)
+		{
+			sleep_segment_add(&m_current,m_pending.minutes,m_pending.hr_sum,m_pending.hr_count);
+			m_pending.minutes = 0;
+		}
+		if(m_pending.minutes == 0)
+		{
+			m_pending.utc      = utc;
+			m_pending.stage    = stage;
+			m_pending.hr_sum   = 0;
+			m_pending.hr_count = 0;
+		}
+		p_add = &m_pending;
+	}
+	sleep_segment_add(p_add,1,hr,hr ? 1 : 0);
+
+	if(m_pending.minutes >= m_stage_run[m_pending.stage])
+	{
+		sleep_record_put(&m_current);
+		m_current = m_pending;
+		m_pending.minutes = 0;
+	}
+
+	if(m_current.stage == SLEEP_STAGE_WAKE && m_current.minutes >= SLEEP_END_WAKE_MIN)
+		sleep_session_end();
+}
+
+static void sleep_minute_scored(bool asleep,uint32_t d,uint32_t utc,uint8_t hr)
+{
+	if(!m_in_sleep)
+	{
+		if(!asleep)
+		{
+			m_onset_run = 0;
+			return;
+		}
+		if(m_onset_run++ == 0)
+		{
+			m_onset_utc = utc;
+			m_current.hr_sum   = 0;
+			m_current.hr_count = 0;
+		}
+		sleep_segment_add(&m_current,0,hr,hr ? 1 : 0);
+		if(m_onset_run < SLEEP_ONSET_MIN)
+			return;
+
+		//˯⼸ǳ˯
+		m_in_sleep        = true;
+		m_current.utc     = m_onset_utc;
+		m_current.minutes = m_onset_run;
+		m_current.stage   = SLEEP_STAGE_LIGHT;
+		m_pending.minutes = 0;
+		if(m_current.hr_count)
+			m_hr_avg = (m_current.hr_sum << SLEEP_HR_FRAC) / m_current.hr_count;
+		return;
+	}
+
+	if(hr)
+		m_hr_avg = m_hr_avg ? m_hr_avg + ((int16_t)(((uint16_t)hr << SLEEP_HR_FRAC) - m_hr_avg) >> SLEEP_HR_AVG_SHIFT)
+		                    : (uint16_t)hr << SLEEP_HR_FRAC;
+
+	sleep_stage_step(sleep_classify(d,hr),utc,hr);
+}
+
+/*****************************************************************************
+ *    : sleep_stage_init
+ *  : , ǰ˯ߺͼ¼
+ *  : 
+ *  : 
+ *   ֵ : 
+ * ޸ʷ : 
+ * ˵     : 
+*****************************************************************************/
+void sleep_stage_init(void)
+{
+	m_window_next  = 0;
+	m_window_count = 0;
+	m_last_utc     = SLEEP_INVALID;
+
+	m_in_sleep = false;
+	memset(&m_current,0,sizeof(m_current));
+	memset(&m_pending,0,sizeof(m_pending));
+	sleep_session_end();
+
+	m_record_head  = 0;
+	m_record_count = 0;
+	memset(&m_stats,0,sizeof(m_stats));
+}
+
+/*****************************************************************************
+ *    : sleep_stage_minute
+ *  : ιһӵ, г2ǰһӵķ
+ *  : uint32_t utc         һӿʼʱ()
+               uint16_t activity    һӵĻ, mg
+               uint8_t heart_rate   һӵ, 0ʾû
+ *  : 
+ *   ֵ : 
+ * ޸ʷ : 
+ * ˵     : ݶ˳SLEEP_GAP_MAX_MIN, ʱص, ǰ˯
+              ֱӽ, ¿ʼ
+*****************************************************************************/
+void sleep_stage_minute(uint32_t utc,uint16_t activity,uint8_t heart_rate)
+{
+	uint32_t d = 0;
+	uint8_t i,slot,center;
+
+	if(m_last_utc != SLEEP_INVALID && (utc <= m_last_utc || utc - m_last_utc > SLEEP_GAP_MAX_MIN * 60))
+	{
+		sleep_session_end();
+		m_window_count = 0;
+	}
+	m_last_utc = utc;
+	m_stats.minutes++;
+
+	m_window[m_window_next]    = (activity > SLEEP_ACTIVITY_CAP) ? SLEEP_ACTIVITY_CAP : activity;
+	m_window_hr[m_window_next] = heart_rate;
+	m_window_next = (m_window_next + 1) % SLEEP_WINDOW;
+	if(m_window_count < SLEEP_WINDOW)
+		m_window_count++;
+	if(m_window_count <= SLEEP_LAG)
+		return;
+
+	//m_weights[0]һ, ûʱǰȱĵ0
+	for(i=SLEEP_WINDOW-m_window_count;i<SLEEP_WINDOW;i++)
+	{
+		slot = (m_window_next + i) % SLEEP_WINDOW;
+		d += (uint32_t)m_weights[i] * m_window[slot];
+	}
+
+	center = (m_window_next + SLEEP_WINDOW - 1 - SLEEP_LAG) % SLEEP_WINDOW;
+	sleep_minute_scored(d < SLEEP_WAKE_D,d,utc - SLEEP_LAG * 60,m_window_hr[center]);
+}
+
+bool sleep_record_get(sleep_record_st *p_record)
+{
+	if(m_record_count == 0)
+		return false;
+
+	*p_record = m_records[m_record_head];
+	m_record_head = (m_record_head + 1) % SLEEP_RECORD_QUEUE;
+	m_record_count--;
+	return true;
+}
+
+/*****************************************************************************
+ *    : sleep_record_encode
+ *  : ѷֶμ¼SLEEP_DATAĸʽ
+ *  : const sleep_record_st *p_record  ¼
+ *  : uint8_t *p_out                   SLEEP_RECORD_SIZEֽ
+ *   ֵ : дֽ
+ * ޸ʷ : 
+ * ˵     : [utc 4][minutes 2][stage][heart_rate], 
+*****************************************************************************/
+uint8_t sleep_record_encode(const sleep_record_st *p_record,uint8_t *p_out)
+{
+	p_out[0] = (uint8_t)(p_record->utc >> 24);
+	p_out[1] = (uint8_t)(p_record->utc >> 16);
+	p_out[2] = (uint8_t)(p_record->utc >> 8);
+	p_out[3] = (uint8_t)(p_record->utc);
+	p_out[4] = (uint8_t)(p_record->minutes >> 8);
+	p_out[5] = (uint8_t)(p_record->minutes);
+	p_out[6] = p_record->stage;
+	p_out[7] = p_record->heart_rate;
+
+	return SLEEP_RECORD_SIZE;
+}
+
+uint8_t sleep_stage_current(void)
+{
+	return m_in_sleep ? m_current.stage : SLEEP_STAGE_NONE;
+}
+
+void sleep_stage_stats_get(sleep_stats_st *p_stats)
+{
+	*p_stats = m_stats;
+}
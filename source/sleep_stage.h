@@ -0,0 +1,49 @@
+#ifndef _SLEEP_STAGE_H_
+#define _SLEEP_STAGE_H_
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SLEEP_RECORD_SIZE			(8)			//sleep_record_encodeֽ
+#define SLEEP_RECORD_QUEUE			(16)		//ûȡߵķֶμ¼, ˶
+#define SLEEP_ONSET_MIN				(10)		//ôΪ˯Ų˯
+#define SLEEP_END_WAKE_MIN			(15)		//˯ô
+#define SLEEP_GAP_MAX_MIN			(10)		//ݶô, ǰ˯ֱӽ
+
+#define SLEEP_STAGE_WAKE			(0)
+#define SLEEP_STAGE_LIGHT			(1)
+#define SLEEP_STAGE_DEEP			(2)
+#define SLEEP_STAGE_NONE			(0xFF)		//˯
+
+typedef struct
+{
+	uint32_t utc;			//һοʼʱ()
+	uint16_t minutes;
+	uint8_t stage;			//SLEEP_STAGE_WAKE/LIGHT/DEEP
+	uint8_t heart_rate;		//һεƽ, 0ʾû
+}sleep_record_st;
+
+typedef struct
+{
+	uint32_t minutes;			//յķ
+	uint32_t sessions;			//˯ߴ
+	uint32_t records;			//ķֶμ¼
+	uint32_t records_lost;		//¼ʱļ¼
+}sleep_stats_st;
+
+
+/*****************************************************************************
+ * ˯߷: ÿιһλ(), ÿӵļڴ涼ǹ̶.
+ * ǰ4ӵ2ӵļȨ(Cole-KripkeȨ)˯/, ÿӵ
+ * 2ӳ. ˯ʱĻƽܵ, ʲ˯ߵƽ
+ * ʱΪ˯. ڰκϲ: µķҪֹ(3, ǳ˯3,
+ * ˯10)Žǰ, ̵Ĳǰ. һνͳһ¼, ʱ
+ * һŵĲ¼, ϲ·һ.
+*****************************************************************************/
+void sleep_stage_init(void);
+void sleep_stage_minute(uint32_t utc,uint16_t activity,uint8_t heart_rate);	//utcһӿʼʱ
+bool sleep_record_get(sleep_record_st *p_record);								//ûм¼ʱfalse
+uint8_t sleep_record_encode(const sleep_record_st *p_record,uint8_t *p_out);	//, SLEEP_RECORD_SIZE
+uint8_t sleep_stage_current(void);												//ǰεķ, ˯SLEEP_STAGE_NONE
+void sleep_stage_stats_get(sleep_stats_st *p_stats);
+
+#endif
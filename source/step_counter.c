@@ -0,0 +1,328 @@
+#include "step_counter.h"
+#include <string.h>
+#include "dsp_kernels.h"
+
+#define STEP_Q15_PER_MG				(4)							//ϼٶԼ6.9g, ᱥ
+#define STEP_MAG_SHIFT				(2)							//2λǳSTEP_Q15_PER_MG
+#define STEP_HP_COEF				(29491)						//0.9(Q15), ֹԼ0.4Hz
+#define STEP_LP_SHIFT				(14)						//ͨϵQ14
+#define STEP_THRESH_MIN				(50 * STEP_Q15_PER_MG)		//50mg
+#define STEP_PEAK_AVG_SHIFT			(3)
+#define STEP_INTERVAL_MIN			(MOTION_ODR_HZ / 4)			//0.25
+#define STEP_INTERVAL_MAX			(MOTION_ODR_HZ * 2)			//2, ͣ
+#define STEP_INVALID				(0xFFFFFFFF)
+#define STEP_ACTIVITY_DEADBAND		(10 * STEP_Q15_PER_MG)		//10mgµû
+#define STEP_ACTIVITY_SHIFT			(7)							//Լڳ(4LSB/mg * 25Hz), λmg
+
+//3HzButterworthͨ @25Hz, Q14: b0 b1 b2 -a1 -a2
+static const q15_t m_lp_coef[5] = {1496, 2992, 1496, 16096, -5696};
+
+static dsp_dcblock_q15_t m_hp;
+static dsp_biquad_q15_t m_lp;
+
+static q15_t m_f1;					//ǰһ˲
+static q15_t m_f2;					//ǰһ
+static bool m_armed;				//һ֮źѾ
+static q15_t m_peak_avg;			//Ĳƽ߶, ֵȡһ
+
+static uint32_t m_n;				//ʱ
+static bool m_walking;
+static uint32_t m_last_step;
+static uint16_t m_interval_avg;		//ƽ, 
+static uint8_t m_pending;			//ȷǰݴĲ
+static bool m_confirmed;
+
+static uint32_t m_minute;
+static uint16_t m_minute_steps;
+static uint8_t m_minute_cadence;
+static uint32_t m_day;
+static uint32_t m_today;
+static uint32_t m_minute_activity;	//һӳĲۼ, Q15
+
+static bool m_activity_ready;		//һӵĻûȡ
+static uint32_t m_activity_utc;
+static uint16_t m_activity;
+
+static step_record_st m_records[STEP_RECORD_QUEUE];
+static uint8_t m_record_head;
+static uint8_t m_record_count;
+
+static step_stats_st m_stats;
+
+static void step_credit(uint8_t steps)
+{
+	uint16_t cadence = (60 * MOTION_ODR_HZ) / m_interval_avg;
+
+	m_minute_steps  += steps;
+	m_minute_cadence = (cadence > 0xFF) ? 0xFF : cadence;
+	m_today         += steps;
+	m_stats.steps   += steps;
+}
+
+static void step_bout_end(void)
+{
+	if(!m_confirmed)
+		m_stats.rejected += m_pending;
+
+	m_walking    = false;
+	m_confirmed  = false;
+	m_pending    = 0;
+	m_peak_avg   = STEP_THRESH_MIN * 2;
+}
+
+static bool step_interval_regular(uint32_t interval,uint8_t tolerance)
+{
+	uint32_t diff = (interval > m_interval_avg) ? interval - m_interval_avg : m_interval_avg - interval;
+
+	return diff * tolerance <= m_interval_avg;
+}
+
+static void step_peak(uint32_t t)
+{
+	uint32_t interval;
+
+	if(!m_walking)
+	{
+		m_walking      = true;
+		m_last_step    = t;
+		m_interval_avg = 0;
+		m_pending      = 1;
+		return;
+	}
+
+	interval = t - m_last_step;
+	if(interval < STEP_INTERVAL_MIN)			//ͬһĵڶ
+		return;
+	m_last_step = t;
+
+	//ȷǰҪƽֵġ25%, ȷϺſ50%, ˴һȷ
+	if(m_interval_avg && !step_interval_regular(interval,m_confirmed ? 2 : 4))
+	{
+		if(!m_confirmed)
+			m_stats.rejected += m_pending;
+		m_confirmed    = false;
+		m_pending      = 1;
+		m_interval_avg = interval;
+		return;
+	}
+
+	m_interval_avg = m_interval_avg ? (m_interval_avg * 3 + interval + 2) / 4 : interval;
+
+	if(m_confirmed)
+		step_credit(1);
+	else if(++m_pending >= STEP_CONFIRM_STEPS)
+	{
+		m_confirmed = true;
+		step_credit(m_pending);
+		m_pending = 0;
+	}
+}
+
+static void step_sample(q15_t f)
+{
+	q15_t thresh = m_peak_avg >> 1;
+
+	if(thresh < STEP_THRESH_MIN)
+		thresh = STEP_THRESH_MIN;
+
+	if(m_walking && m_n - m_last_step > STEP_INTERVAL_MAX)
+		step_bout_end();
+
+	if(f < 0)
+		m_armed = true;
+
+	if(f > STEP_ACTIVITY_DEADBAND)
+		m_minute_activity += f - STEP_ACTIVITY_DEADBAND;
+	else if(f < -STEP_ACTIVITY_DEADBAND)
+		m_minute_activity += -STEP_ACTIVITY_DEADBAND - f;
+
+	//m_f1ǰһ, ȵǰС, ǲ
+	if(m_armed && m_f1 > thresh && m_f1 > m_f2 && m_f1 >= f)
+	{
+		m_armed = false;
+		m_stats.peaks++;
+		m_peak_avg += (m_f1 - m_peak_avg) >> STEP_PEAK_AVG_SHIFT;
+		step_peak(m_n - 1);
+	}
+
+	m_f2 = m_f1;
+	m_f1 = f;
+	m_n++;
+	m_stats.samples++;
+}
+
+static void step_record_put(const step_record_st *p_record)
+{
+	if(m_record_count == STEP_RECORD_QUEUE)
+	{
+		m_record_head = (m_record_head + 1) % STEP_RECORD_QUEUE;
+		m_record_count--;
+		m_stats.records_lost++;
+	}
+	m_records[(m_record_head + m_record_count) % STEP_RECORD_QUEUE] = *p_record;
+	m_record_count++;
+	m_stats.records++;
+}
+
+static void step_minute_close(uint32_t minute)
+{
+	step_record_st record;
+	uint32_t day = minute / (24 * 60);
+
+	if(m_minute != STEP_INVALID && m_minute_steps)
+	{
+		record.utc     = m_minute * 60;
+		record.steps   = m_minute_steps;
+		record.cadence = m_minute_cadence;
+		record.type    = (m_minute_cadence >= STEP_RUN_CADENCE) ? STEP_TYPE_RUN : STEP_TYPE_WALK;
+		step_record_put(&record);
+	}
+	if(m_minute != STEP_INVALID)
+	{
+		m_minute_activity >>= STEP_ACTIVITY_SHIFT;
+		m_activity       = (m_minute_activity > 0xFFFF) ? 0xFFFF : (uint16_t)m_minute_activity;
+		m_activity_utc   = m_minute * 60;
+		m_activity_ready = true;
+	}
+	m_minute          = minute;
+	m_minute_steps    = 0;
+	m_minute_activity = 0;
+
+	if(day != m_day)
+	{
+		m_day   = day;
+		m_today = 0;
+	}
+}
+
+/*****************************************************************************
+ *    : step_counter_init
+ *  : ˲ͼƲ״̬
+ *  : 
+ *  : 
+ *   ֵ : 
+ * ޸ʷ : 
+ * ˵     : ĲҲһ
+*****************************************************************************/
+void step_counter_init(void)
+{
+	dsp_dcblock_q15_init(&m_hp,STEP_HP_COEF);
+	dsp_biquad_q15_init(&m_lp,m_lp_coef,STEP_LP_SHIFT);
+	m_f1 = m_f2 = 0;
+	m_armed = false;
+	m_n = 0;
+	m_walking = false;
+	m_confirmed = false;
+	m_pending = 0;
+	m_interval_avg = 0;
+	m_peak_avg = STEP_THRESH_MIN * 2;
+
+	m_minute = STEP_INVALID;
+	m_minute_steps = 0;
+	m_minute_cadence = 0;
+	m_day = STEP_INVALID;
+	m_today = 0;
+	m_minute_activity = 0;
+	m_activity_ready = false;
+
+	m_record_head = 0;
+	m_record_count = 0;
+	memset(&m_stats,0,sizeof(m_stats));
+}
+
+/*****************************************************************************
+ *    : step_counter_process
+ *  : һٶ
+ *  : const motion_sample_st *p_block  , mg
+               uint16_t count                   
+               uint32_t sec                     һʱıʱ, 
+ *  : 
+ *   ֵ : 
+ * ޸ʷ : 
+ * ˵     : ӱȰһɼ¼, һĲ㵽µһ
+*****************************************************************************/
+void step_counter_process(const motion_sample_st *p_block,uint16_t count,uint32_t sec)
+{
+	q15_t filtered[MOTION_BLOCK_SAMPLES];
+	uint16_t i,n;
+
+	if(sec / 60 != m_minute)
+		step_minute_close(sec / 60);
+
+	//ϼٶ, ͨȥ, ٵͨȥ, ʣ0.4~3Hz
+	for(;count;count-=n,p_block+=n)
+	{
+		n = (count > MOTION_BLOCK_SAMPLES) ? MOTION_BLOCK_SAMPLES : count;
+		dsp_vmag3_q15(&p_block->x,filtered,n,STEP_MAG_SHIFT);			//motion_sample_stŵx,y,z
+		dsp_dcblock_q15(&m_hp,filtered,filtered,n);
+		dsp_biquad_q15(&m_lp,filtered,filtered,n);
+		for(i=0;i<n;i++)
+			step_sample(filtered[i]);
+	}
+}
+
+bool step_record_get(step_record_st *p_record)
+{
+	if(m_record_count == 0)
+		return false;
+
+	*p_record = m_records[m_record_head];
+	m_record_head = (m_record_head + 1) % STEP_RECORD_QUEUE;
+	m_record_count--;
+	return true;
+}
+
+/*****************************************************************************
+ *    : step_record_encode
+ *  : ѷӼ¼STEP_DATAĸʽ
+ *  : const step_record_st *p_record  ¼
+ *  : uint8_t *p_out                  STEP_RECORD_SIZEֽ
+ *   ֵ : дֽ
+ * ޸ʷ : 
+ * ˵     : [utc 4][steps 2][cadence][type], 
+*****************************************************************************/
+uint8_t step_record_encode(const step_record_st *p_record,uint8_t *p_out)
+{
+	p_out[0] = (uint8_t)(p_record->utc >> 24);
+	p_out[1] = (uint8_t)(p_record->utc >> 16);
+	p_out[2] = (uint8_t)(p_record->utc >> 8);
+	p_out[3] = (uint8_t)(p_record->utc);
+	p_out[4] = (uint8_t)(p_record->steps >> 8);
+	p_out[5] = (uint8_t)(p_record->steps);
+	p_out[6] = p_record->cadence;
+	p_out[7] = p_record->type;
+
+	return STEP_RECORD_SIZE;
+}
+
+/*****************************************************************************
+ *    : step_minute_activity_get
+ *  : ȡһӵĻ, ˯߷
+ *  : 
+ *  : uint32_t *p_utc       һӿʼʱ()
+               uint16_t *p_activity  , mg
+ *   ֵ : µһӷtrue
+ * ޸ʷ : 
+ * ˵     : ֻһ, Ҫÿstep_counter_process֮ȡ
+*****************************************************************************/
+bool step_minute_activity_get(uint32_t *p_utc,uint16_t *p_activity)
+{
+	if(!m_activity_ready)
+		return false;
+
+	*p_utc = m_activity_utc;
+	*p_activity = m_activity;
+	m_activity_ready = false;
+	return true;
+}
+
+uint32_t step_counter_today(void)
+{
+	return m_today;
+}
+
+void step_counter_stats_get(step_stats_st *p_stats)
+{
+	*p_stats = m_stats;
+}
+
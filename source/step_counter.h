@@ -0,0 +1,51 @@
+#ifndef _STEP_COUNTER_H_
+#define _STEP_COUNTER_H_
+#include <stdint.h>
+#include <stdbool.h>
+#include "motion.h"
+
+#define STEP_RECORD_SIZE			(8)			//step_record_encodeֽ
+#define STEP_RECORD_QUEUE			(8)			//ûȡߵķӼ¼, ˶
+#define STEP_CONFIRM_STEPS			(5)			//ôಽȶſʼ
+#define STEP_RUN_CADENCE			(140)		//Ƶﵽֵ(/)Ϊܲ
+
+#define STEP_TYPE_WALK				(0)
+#define STEP_TYPE_RUN				(1)
+
+typedef struct
+{
+	uint32_t utc;			//һӿʼʱ()
+	uint16_t steps;
+	uint8_t cadence;		//һһ·ĲƵ, /
+	uint8_t type;			//STEP_TYPE_WALK/STEP_TYPE_RUN
+}step_record_st;
+
+typedef struct
+{
+	uint32_t samples;			//
+	uint32_t peaks;				//ֵĲ
+	uint32_t steps;				//Ĳ
+	uint32_t rejected;			//಻ȶûмĲ
+	uint32_t records;			//ķӼ¼
+	uint32_t records_lost;		//¼ʱļ¼
+}step_stats_st;
+
+
+/*****************************************************************************
+ * Ʋ: motionһһش, ڴ̶. ÿϼٶ, תQ15
+ * (1mg = 4LSB), 0.4Hzͨȥ3Hz׵ͨ, ڲ崦ӦֵҲ,
+ * 0.25~2֮STEP_CONFIRM_STEPSȶż. ÿһ
+ * һӵĲһSTEP_DATA¼Ž, ûвķӲ¼.
+ * ÿӻ˲󳬳10mgĲۼӳɻ, û·ķҲ, ˯.
+ * ֻʱ, RTC, Ҳ.
+*****************************************************************************/
+void step_counter_init(void);
+void step_counter_process(const motion_sample_st *p_block,uint16_t count,uint32_t sec);
+bool step_record_get(step_record_st *p_record);							//ûм¼ʱfalse
+uint8_t step_record_encode(const step_record_st *p_record,uint8_t *p_out);	//, STEP_RECORD_SIZE
+bool step_minute_activity_get(uint32_t *p_utc,uint16_t *p_activity);		//ÿһ, ûʱfalse
+uint32_t step_counter_today(void);											//(ʱ)Ĳ
+void step_counter_stats_get(step_stats_st *p_stats);
+
+#endif
+
@@ -6,6 +6,8 @@
 #include "usr_device.h"
 #include "crc_32.h"
 #include "usr_design.h"
+#include "rollup.h"
+#include "alarm.h"
 
 #define PRODUCT_TYPE               '4','1','5','B','0'
 #define HW_VERSION                 'H','0','1'
@@ -122,10 +124,91 @@ uint32_t usr_wechat_send_data_evt(void *data)
 }
 
 
-void wechat_push_data_process(uint8_t *rcv_data,uint8_t length)
+static uint8_t usr_data_put(uint8_t *p_buf,uint32_t value,uint8_t size)
 {
 	uint8_t i;
+
+	for(i=0;i<size;i++)
+		p_buf[i] = (uint8_t)(value >> (8 * (size - 1 - i)));
+	return size;
+}
+
+static uint32_t usr_data_frame_send(uint8_t *p_buf,uint8_t length)
+{
+	uint32_t crc32_check = crc32(p_buf,length);
+
+	length += usr_data_put(&p_buf[length],crc32_check,4);
+	return usr_send_data(p_buf,length);
+}
+
+/*****************************************************************************
+ *    : usr_send_day_data
+ *  : ظAPPѯһĻ
+ *  : uint32_t utc  APPҪһʱ()
+ *  : 
+ *   ֵ : usr_send_dataĽ
+ * ޸ʷ : 
+ * ˵     : [AA][01][51][utc 4][steps 4][active 2][sleep 2][deep 2][hr][hr min][crc32 4],
+              ûһʱȫ0
+*****************************************************************************/
+uint32_t usr_send_day_data(uint32_t utc)
+{
+	rollup_day_st day;
+	uint8_t i = 0,ucBUF[32];
+
+	if(!rollup_day_get(utc,&day))
+		memset(&day,0,sizeof(day));
+
+	ucBUF[i++] = COMMAND_VERSION;
+	ucBUF[i++] = VERSION_NUM;
+	ucBUF[i++] = BLE_SEND_DAY_DATA_CMD;
+	i += usr_data_put(&ucBUF[i],utc,4);
+	i += usr_data_put(&ucBUF[i],day.steps,4);
+	i += usr_data_put(&ucBUF[i],day.active_minutes,2);
+	i += usr_data_put(&ucBUF[i],day.sleep_minutes,2);
+	i += usr_data_put(&ucBUF[i],day.deep_minutes,2);
+	ucBUF[i++] = day.heart_rate;
+	ucBUF[i++] = day.heart_rate_min;
+
+	return usr_data_frame_send(ucBUF,i);
+}
+
+/*****************************************************************************
+ *    : usr_send_hour_data
+ *  : ظAPPѯһСʱĻ
+ *  : uint32_t utc  APPҪǸСʱʱ()
+ *  : 
+ *   ֵ : usr_send_dataĽ
+ * ޸ʷ : 
+ * ˵     : [AA][01][57][utc 4][steps 2][active][hr][crc32 4], ûʱȫ0
+*****************************************************************************/
+uint32_t usr_send_hour_data(uint32_t utc)
+{
+	rollup_hour_st hour;
+	uint8_t i = 0,ucBUF[20];
+
+	if(!rollup_hour_get(utc,&hour))
+		memset(&hour,0,sizeof(hour));
+
+	ucBUF[i++] = COMMAND_VERSION;
+	ucBUF[i++] = VERSION_NUM;
+	ucBUF[i++] = BLE_SEND_ONE_HOUR_DATA_CMD;
+	i += usr_data_put(&ucBUF[i],utc,4);
+	i += usr_data_put(&ucBUF[i],hour.steps,2);
+	ucBUF[i++] = hour.active_minutes;
+	ucBUF[i++] = hour.heart_rate;
+
+	return usr_data_frame_send(ucBUF,i);
+}
+
+
+void wechat_push_data_process(uint8_t *rcv_data,uint8_t length)
+{
+	uint8_t i = 0;
 	
+	if(length < 3)			//汾ֽڼ
+		return;
+
     if((rcv_data[i] == COMMAND_VERSION) && (rcv_data[i+1] == VERSION_NUM))          //汾ʶ
     {
         i=0x02;
@@ -136,6 +219,7 @@ void wechat_push_data_process(uint8_t *rcv_data,uint8_t length)
         else if(rcv_data[i] == APP_PUSH_ALARM_SETTING_CMD)   //  0X69
         {
             QPRINTF("APP_PUSH_ALARM_SETTING_CMD\r\n");
+            alarm_setting_put(&rcv_data[i+1],length - (i+1));
         }
         else if(rcv_data[i] == APP_PUSH_CALL_SETTING_CMD)   //  0X6A
         {
@@ -144,6 +228,7 @@ void wechat_push_data_process(uint8_t *rcv_data,uint8_t length)
         else if(rcv_data[i] == APP_PUSH_LONG_SIT_SETTING_CMD)  //  0x6E
         {
             QPRINTF("APP_PUSH_LONG_SIT_SETTING_CMD\r\n");
+            alarm_long_sit_put(&rcv_data[i+1],length - (i+1));
         }
         else if(rcv_data[i] == BLE_PUSH_HR_SMART_SWITCH_INFO_CMD)
         {
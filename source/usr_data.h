@@ -32,6 +32,8 @@ typedef struct
 
 
 uint32_t usr_wechat_send_data_evt(void *data);
+uint32_t usr_send_day_data(uint32_t utc);		//ظAPP_RETURN_GET_DAY_CMD
+uint32_t usr_send_hour_data(uint32_t utc);		//ظAPP_RETURN_GET_HOUR_DATA_CMD
 
 void wechat_push_data_process(uint8_t *data,uint8_t length);
 
@@ -10,11 +10,16 @@
 #include "app_android_ancs.h"
 #include "usr_init.h"
 #include "usr_data.h"
+#include "channel_select.h"
+#include "usr_session.h"
+#include "app_scheduler.h"
+#include "ppg.h"
+#include "heart_rate.h"
+#include "alarm.h"
 
 #define USRDESIGN_SEND_DATA_INDEX_MAX		(4)
 typedef uint8_t (*ble_send_data)(void);
 
-trans_evt_st g_trans_evt_hander;
 typedef uint32_t (*trans_evt)(void *data);
 const trans_evt trans_evt_hander[] = {
 	usr_lifesense_login_evt,
@@ -45,25 +50,83 @@ uint32_t usrdesign_send_data(void)
 
 void trans_evt_call_back(void)
 {
-	uint8_t i,error;
-	
-	if(g_trans_evt_hander.evt)
+	uint8_t i,link,prev,error;
+
+	for(link=0;link<LINK_MAX;link++)
 	{
-		for(i=0;i<32;i++)
+		if(g_link[link].conn_handle == BLE_CONN_HANDLE_INVALID)
+			continue;
+
+		prev = link_select(link);
+		usr_session_timeout_check();
+		for(i=0;i<sizeof(trans_evt_hander)/sizeof(trans_evt_hander[0]);i++)
 		{
-			if((1<<i) & g_trans_evt_hander.evt)
+			if((1<<i) & g_trans_evt_hander->evt)
 			{
 				error = trans_evt_hander[i](NULL);
 				if(error == 0)
 				{
-					g_trans_evt_hander.evt &= ~(1<<i);
+					g_trans_evt_hander->evt &= ~(1<<i);
 				}
 			}
 		}
+		link_select(prev);
+	}
+}
+
+
+
+//ѭ￪: ͣSAADCҪж, Эջ¼Ȳ
+static void heart_rate_turn(void *p_event_data,uint16_t event_size)
+{
+	if(*(uint8_t *)p_event_data)
+	{
+		heart_rate_init();
+		(void)ppg_start();
 	}
+	else
+		ppg_stop();
 }
 
+typedef struct
+{
+	uint16_t conn_handle;
+	uint8_t cmd;
+	uint32_t utc;
+}rollup_query_st;
 
+//ѭظ, лطѯ
+static void rollup_query_reply(void *p_event_data,uint16_t event_size)
+{
+	rollup_query_st *p_query = (rollup_query_st *)p_event_data;
+	uint8_t link,prev;
+
+	link = link_index(p_query->conn_handle);
+	if(link == LINK_MAX)
+		return;
+
+	prev = link_select(link);
+	if(p_query->cmd == APP_RETURN_GET_DAY_CMD)
+		(void)usr_send_day_data(p_query->utc);
+	else
+		(void)usr_send_hour_data(p_query->utc);
+	link_select(prev);
+}
+
+//[cmd][utc 4], utcҪǸСʱıʱ
+static void rollup_query_put(uint8_t cmd,uint8_t *pData,uint8_t length)
+{
+	rollup_query_st query;
+
+	if(length < 5)
+		return;
+
+	query.conn_handle = link_conn_handle(link_current());
+	query.cmd = cmd;
+	query.utc = ((uint32_t)pData[0] << 24) | ((uint32_t)pData[1] << 16) | ((uint32_t)pData[2] << 8) | pData[3];
+	if(app_sched_event_put(&query,sizeof(query),rollup_query_reply) != NRF_SUCCESS)
+		QPRINTF("rollup query dropped\r\n");
+}
 
 void data_process(uint8_t *data,uint8_t length)
 {
@@ -78,6 +141,7 @@ void data_process(uint8_t *data,uint8_t length)
 			
 		case APP_RETURN_GET_DAY_CMD:
 			QPRINTF("APP_RETURN_GET_DAY_CMD\r\n");
+			rollup_query_put(cmd,pData,length);
 			break;
 			
 		case APP_RETURN_SLEEP_DATA_CMD:
@@ -94,6 +158,7 @@ void data_process(uint8_t *data,uint8_t length)
 			
 		case APP_RETURN_GET_HOUR_DATA_CMD:
 			QPRINTF("APP_RETURN_GET_HOUR_DATA_CMD\r\n");
+			rollup_query_put(cmd,pData,length);
 			break;
 			
 		case APP_RETURN_USER_INFO_CONFIRE_CMD:
@@ -161,6 +226,7 @@ void data_process(uint8_t *data,uint8_t length)
 			
 		case APP_PUSH_ALARM_SETTING_CMD:
 			QPRINTF("APP_PUSH_ALARM_SETTING_CMD\r\n");
+			alarm_setting_put(pData,length - 1);
 			break;
 			
 		case APP_PUSH_CALL_SETTING_CMD:
@@ -173,6 +239,7 @@ void data_process(uint8_t *data,uint8_t length)
 			
 		case APP_PUSH_LONG_SIT_SETTING_CMD:
 			QPRINTF("APP_PUSH_LONG_SIT_SETTING_CMD\r\n");
+			alarm_long_sit_put(pData,length - 1);
 			break;
 			
 		case APP_PUSH_FIND_ME_SETTING_CMD:
@@ -204,7 +271,8 @@ void data_process(uint8_t *data,uint8_t length)
 			break;
 			
 		case APP_PUSH_HEART_TURN_CMD:
-			QPRINTF("APP_PUSH_HEART_TURN_CMD\r\n");
+			QPRINTF("APP_PUSH_HEART_TURN_CMD %d\r\n",*pData);
+			(void)app_sched_event_put(pData,1,heart_rate_turn);
 			break;
 			
 		default:
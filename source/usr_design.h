@@ -57,7 +57,7 @@ typedef enum
 }get_setting_cmd_enum;
 
 
-extern trans_evt_st g_trans_evt_hander;
+extern trans_evt_st *g_trans_evt_hander;		//evt of the selected link, see channel_select.h
 
 void trans_evt_call_back(void);
 
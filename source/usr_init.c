@@ -3,6 +3,7 @@
 #include "app_wechat_common.h"
 #include "channel_select.h"
 #include "debug.h"
+#include "usr_session.h"
 
 uint32_t usr_wechat_init_evt(void *data)
 {
@@ -44,6 +45,8 @@ uint32_t usr_wechat_init_evt(void *data)
 	for(uint8_t i=0;i<20;i++)
 		QPRINTF("%02x,",UploadInfoValue[i]);
 	QPRINTF("\r\n");
+	if(error == 0)
+		usr_session_request_sent();
 
 	return error;
 }
@@ -6,24 +6,66 @@
 #include "md5.h"
 #include "crc_32.h"
 #include "app_wechat_common.h"
+#include "usr_session.h"
 
 #define COMMAND_VERSION                       0xAA
 #define VERSION_NUM                           0x01
 
-uint32_t usr_lifesense_login_evt(void *data)
+static uint8_t m_login_md5[AUTH_MD5_LENGTH + USR_LOGIN_TOKEN_LENGTH];	//MD5(device type+device ID), ָʱ
+
+/*****************************************************************************
+ *    : usr_login_init
+ *  : һε¼õMD5, ÿε¼
+ *  : 
+ *  : 
+ *   ֵ : 
+ * ޸ʷ : 
+ * ˵     : device_id_init֮
+*****************************************************************************/
+void usr_login_init(void)
 {
-	trans_header_st	 struAppPackHead;
-	static uint8_t AppUploadInfoValue[20];
-	uint8_t UploadInfoLen , i =0,out_len,length,*pInData,*pOutData;
-	uint8_t ucDeviceIDandTypeMD5[AUTH_MD5_LENGTH];
-	uint32_t error;
 	uint8_t ucDeviceIDandType[27];	   /* ڴdevice typedevice ID */
 
     memcpy(ucDeviceIDandType, device_type, sizeof(device_type));
     memcpy(ucDeviceIDandType + sizeof(device_type), device_id, sizeof(device_id));
-    md5_Code(ucDeviceIDandType, sizeof(ucDeviceIDandType), ucDeviceIDandTypeMD5);
+    md5_Code(ucDeviceIDandType, sizeof(ucDeviceIDandType), m_login_md5);
+}
 
-    pInData = ucDeviceIDandTypeMD5;
+//㲥ժҪǩԿ, APPԼҲó
+void usr_login_key_get(uint8_t *key)
+{
+	memcpy(key, m_login_md5, AUTH_MD5_LENGTH);
+}
+
+//appֻܴӵ¼ظUTC, ·
+uint32_t usr_login_token(uint8_t *utc)
+{
+	uint8_t buf[AUTH_MD5_LENGTH + 4];
+
+	memcpy(buf, m_login_md5, AUTH_MD5_LENGTH);
+	memcpy(buf + AUTH_MD5_LENGTH, utc, 4);
+	return crc32(buf, sizeof(buf));
+}
+
+uint32_t usr_lifesense_login_evt(void *data)
+{
+	trans_header_st	 struAppPackHead;
+	static uint8_t AppUploadInfoValue[20];
+	uint8_t UploadInfoLen , i =0,out_len,length,*pInData,*pOutData;
+	uint8_t in_len = AUTH_MD5_LENGTH;
+	uint32_t error,token;
+
+	if(usr_session_resuming())		//ָ¼: MD5
+	{
+		token = usr_session_token();
+		m_login_md5[AUTH_MD5_LENGTH + 0] = (uint8_t)(token >> 24);
+		m_login_md5[AUTH_MD5_LENGTH + 1] = (uint8_t)(token >> 16);
+		m_login_md5[AUTH_MD5_LENGTH + 2] = (uint8_t)(token >> 8);
+		m_login_md5[AUTH_MD5_LENGTH + 3] = (uint8_t)(token);
+		in_len += USR_LOGIN_TOKEN_LENGTH;
+	}
+
+    pInData = m_login_md5;
     pOutData = ucDataAfterPack;
 
     uint8_t command_version[2];
@@ -31,7 +73,7 @@ uint32_t usr_lifesense_login_evt(void *data)
     command_version[1] = VERSION_NUM;
     memcpy(pOutData,command_version,sizeof(command_version));
 
-    out_len=app_pack_data(pInData, AUTH_MD5_LENGTH, pOutData+2);
+    out_len=app_pack_data(pInData, in_len, pOutData+2);
     length = out_len+sizeof(command_version);
 
 	struAppPackHead.usTxDataType = 0;
@@ -46,6 +88,8 @@ uint32_t usr_lifesense_login_evt(void *data)
 	for(i=0;i<UploadInfoLen;i++)
 		QPRINTF("%02x,",ucDataAfterPack[i]);
 	QPRINTF("\r\n");
+	if(error == 0)
+		usr_session_request_sent();
 
 	return error;
 }
@@ -110,6 +154,8 @@ uint32_t usr_wechat_login_evt(void *data)
 	for(uint8_t i=0;i<UploadInfoLen;i++)
 		QPRINTF("%02x,",UploadInfoValue[i]);
 	QPRINTF("\r\n");
+	if(error == 0)
+		usr_session_request_sent();
 	
 	return error;
 }
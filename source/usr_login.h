@@ -45,7 +45,12 @@ typedef struct
 #define AUTH_MAC_ADDRESS_LENGTH               0X06
 #define AUTH_AES_SIGN_LENGTH                  0X00
 
+#define USR_LOGIN_TOKEN_LENGTH                0X04		//Ļָ¼ʱMD5ĻỰ
 
+
+void usr_login_init(void);
+void usr_login_key_get(uint8_t *key);
+uint32_t usr_login_token(uint8_t *utc);
 uint32_t usr_lifesense_login_evt(void *data);
 uint32_t usr_wechat_login_evt(void *data);
 #endif
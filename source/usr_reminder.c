@@ -8,6 +8,7 @@
 #include "usr_reminder.h"
 #include "time.h"
 #include "debug.h"
+#include "indicate.h"
 
 remainder_head_st g_call_st = {0};//?????
 remainder_st g_remainder_st = {0};//?????????
@@ -339,7 +340,7 @@ void remaind_do(void)
 
 	if(g_call_st.remaind_flg)
 	{
-
+		(void)indicate_play(INDICATE_CALL);
 		QPRINTF("CALL remainder:\r\n");
 		QPRINTF( "msgid=%d\r\n",		g_call_st.msg_id);
 		QPRINTF( "phone_type=%d\r\n",	g_call_st.phone_type);
@@ -356,6 +357,7 @@ void remaind_do(void)
 			remaind_type == WECHAT_REMAIND ||
 			remaind_type == QQ_REMAIND)
 		{
+			(void)indicate_play(INDICATE_MESSAGE);
 			#if 1
 			QPRINTF( "g_index=%d\r\n",		index);
 			QPRINTF( "message_count=%d\r\n",g_remainder_st.message_count);
@@ -0,0 +1,263 @@
+#include "usr_session.h"
+#include <string.h>
+#include "app_timer.h"
+#include "usr_design.h"
+#include "time.h"
+#include "debug.h"
+
+#define APP_TIMER_PRESCALER         0
+
+typedef struct
+{
+	uint8_t  valid;
+	uint8_t  app;
+	uint8_t  bond_id;			//LINK_BOND_NONE: û, peer_addr
+	ble_gap_addr_t peer_addr;
+	uint8_t  phone_type;
+	uint8_t  timezone;
+	uint8_t  resume_cap;		//APP, ΢Ų
+	uint32_t token;				//ĵ¼ظ, ΢Ų
+	uint32_t used;				//ʹõ˳, ʱС
+}session_cache_st;
+
+typedef struct
+{
+	uint16_t conn_handle;		//link this handshake runs on, stale once the link is reused
+	uint8_t  app;				//0 when no handshake is running
+	uint8_t  cache;				//entry of m_cache, USR_SESSION_CACHE_SIZE if none
+	uint8_t  resume;
+	uint8_t  pending;			//requests waiting for a reply
+	uint8_t  round_trips;
+	uint32_t begin_tick;
+	uint32_t sent_tick;
+}session_link_st;
+
+static session_cache_st m_cache[USR_SESSION_CACHE_SIZE];
+static uint32_t m_cache_used;
+static session_link_st m_link[LINK_MAX];
+static usr_session_stats_st m_stats;
+
+//entry of the peer on link 'link' for 'app', USR_SESSION_CACHE_SIZE if none
+static uint8_t cache_find(uint8_t link,uint8_t app)
+{
+	link_ctx_st const *l = &g_link[link];
+	session_cache_st const *c;
+	uint8_t i;
+
+	for(i=0;i<USR_SESSION_CACHE_SIZE;i++)
+	{
+		c = &m_cache[i];
+		if(!c->valid || c->app != app || c->bond_id != l->bond_id)
+			continue;
+		if(l->bond_id != LINK_BOND_NONE)
+			break;
+		if(c->peer_addr.addr_type == l->peer_addr.addr_type &&
+		   memcmp(c->peer_addr.addr,l->peer_addr.addr,BLE_GAP_ADDR_LEN) == 0)
+			break;
+	}
+	return i;
+}
+
+//free entry, or the one used longest ago
+static uint8_t cache_alloc(void)
+{
+	uint8_t i,oldest = 0;
+
+	for(i=0;i<USR_SESSION_CACHE_SIZE;i++)
+	{
+		if(!m_cache[i].valid)
+			return i;
+		if(m_cache[i].used < m_cache[oldest].used)
+			oldest = i;
+	}
+	return oldest;
+}
+
+//handshake state of the selected link, NULL if none is running
+static session_link_st *link_get(void)
+{
+	uint8_t link = link_current();
+	session_link_st *p = &m_link[link];
+
+	if(p->app == 0 || p->conn_handle != link_conn_handle(link))
+		return NULL;
+	return p;
+}
+
+static uint32_t ms_since(uint32_t tick)
+{
+	uint32_t now,diff;
+
+	(void)app_timer_cnt_get(&now);
+	(void)app_timer_cnt_diff_compute(now,tick,&diff);
+	return (uint32_t)(((uint64_t)diff * 1000 * (APP_TIMER_PRESCALER + 1)) / APP_TIMER_CLOCK_FREQ);
+}
+
+/*****************************************************************************
+ *    : usr_session_begin
+ *  : ʼһε¼, лʱûʱֻ
+ *  : app_enum app  ¼APP
+ *  : 
+ *   ֵ : true:ָ  false:¼
+ * ޸ʷ : 
+ * ˵     : 
+*****************************************************************************/
+bool usr_session_begin(app_enum app)
+{
+	uint8_t link = link_current();
+	session_link_st *p = &m_link[link];
+	session_cache_st *c;
+
+	memset(p,0,sizeof(session_link_st));
+	p->conn_handle 	= link_conn_handle(link);
+	p->app 			= app;
+	p->cache 		= cache_find(link,app);
+	(void)app_timer_cnt_get(&p->begin_tick);
+
+	if(p->cache < USR_SESSION_CACHE_SIZE)
+	{
+		c = &m_cache[p->cache];
+		c->used = ++m_cache_used;
+		g_communication_statue->phone_type = c->phone_type;
+		system_timezone_set(c->timezone);
+		//ʶƵAPPظƵĵ¼, ֻAPP
+		p->resume = (app == WECHAT_APP) || c->resume_cap;
+	}
+
+	if(p->resume)
+		m_stats.resumes++;
+	else
+		m_stats.full_logins++;
+	QPRINTF("session begin:app=%d,cached=%d,resume=%d\r\n",app,p->cache < USR_SESSION_CACHE_SIZE,p->resume);
+	return p->cache < USR_SESSION_CACHE_SIZE;
+}
+
+bool usr_session_cached(void)
+{
+	session_link_st *p = link_get();
+
+	return (p != NULL) && (p->cache < USR_SESSION_CACHE_SIZE);
+}
+
+bool usr_session_resuming(void)
+{
+	session_link_st *p = link_get();
+
+	return (p != NULL) && p->resume;
+}
+
+uint32_t usr_session_token(void)
+{
+	session_link_st *p = link_get();
+
+	if(p == NULL || p->cache >= USR_SESSION_CACHE_SIZE)
+		return 0;
+	return m_cache[p->cache].token;
+}
+
+//¼ɹµǰlinkֻ
+void usr_session_save(app_enum app,uint8_t phone_type,uint8_t timezone,uint32_t token,uint8_t resume_cap)
+{
+	uint8_t link = link_current();
+	uint8_t i = cache_find(link,app);
+	session_cache_st *c;
+
+	if(i >= USR_SESSION_CACHE_SIZE)
+		i = cache_alloc();
+	c = &m_cache[i];
+
+	c->app 			= app;
+	c->bond_id 		= g_link[link].bond_id;
+	c->peer_addr 	= g_link[link].peer_addr;
+	c->phone_type 	= phone_type;
+	c->timezone 	= timezone;
+	c->resume_cap 	= resume_cap;
+	c->token 		= token;
+	c->used 		= ++m_cache_used;
+	c->valid 		= 1;
+}
+
+void usr_session_request_sent(void)
+{
+	session_link_st *p = link_get();
+
+	if(p == NULL)
+		return;
+	if(p->pending == 0)
+		p->round_trips++;
+	p->pending++;
+	(void)app_timer_cnt_get(&p->sent_tick);
+}
+
+void usr_session_reply(void)
+{
+	session_link_st *p = link_get();
+
+	if(p != NULL && p->pending)
+		p->pending--;
+}
+
+void usr_session_ready(void)
+{
+	session_link_st *p = link_get();
+
+	if(p == NULL)
+		return;
+
+	m_stats.round_trips = p->round_trips;
+	m_stats.ready_ms 	= ms_since(p->begin_tick);
+	if(m_stats.ready_ms > m_stats.ready_ms_max)
+		m_stats.ready_ms_max = m_stats.ready_ms;
+	p->app = 0;
+
+	QPRINTF("session ready:resume=%d,round trips=%d,%dms\r\n",p->resume,m_stats.round_trips,m_stats.ready_ms);
+}
+
+/*****************************************************************************
+ *    : usr_session_fallback
+ *  : ָʧ, , ·¼
+ *  : 
+ *  : 
+ *   ֵ : 
+ * ޸ʷ : 
+ * ˵     : ΢ŵĵ¼Ѿͨʱֻطinit
+*****************************************************************************/
+void usr_session_fallback(void)
+{
+	session_link_st *p = link_get();
+
+	if(p == NULL || !p->resume)
+		return;
+
+	if(p->cache < USR_SESSION_CACHE_SIZE)
+		m_cache[p->cache].valid = 0;
+	p->resume 	= 0;
+	p->pending 	= 0;
+	m_stats.fallbacks++;
+	QPRINTF("session resume failed,full login\r\n");
+
+	if(p->app == LIFESENSE_APP)
+		g_trans_evt_hander->bit.lifesense_login_bit_0 = 1;
+	else if(g_communication_statue->transfer_statue == INIT_STATUE)
+		g_trans_evt_hander->bit.wechat_init_bit_2 = 1;
+	else
+		g_trans_evt_hander->bit.wechat_login_bit_1 = 1;
+}
+
+//main loop, an app that does not know the resume request never answers it
+void usr_session_timeout_check(void)
+{
+	session_link_st *p = link_get();
+
+	if(p == NULL || !p->resume || p->pending == 0)
+		return;
+	if(ms_since(p->sent_tick) >= USR_SESSION_RESUME_TIMEOUT)
+		usr_session_fallback();
+}
+
+void usr_session_stats_get(usr_session_stats_st *p_stats)
+{
+	if(p_stats != NULL)
+		*p_stats = m_stats;
+}
+
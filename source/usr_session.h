@@ -0,0 +1,42 @@
+#ifndef _USR_SESSION_H_
+#define _USR_SESSION_H_
+#include <stdint.h>
+#include <stdbool.h>
+#include "channel_select.h"
+
+#define USR_SESSION_RESUME_TIMEOUT	(2000)		//ms without a reply before a resume falls back to full login
+#define USR_SESSION_CACHE_SIZE		(4)			//phones remembered, all apps together
+#define USR_SESSION_CAP_RESUME		(0x01)		//ĵ¼ظ7ֽ: APPܵ¼ĻỰ
+
+typedef struct
+{
+	uint32_t full_logins;		//handshakes started without a cached session
+	uint32_t resumes;			//handshakes started from the cached session
+	uint32_t fallbacks;			//resumes rejected or timed out
+	uint8_t  round_trips;		//replies waited for in series, last handshake
+	uint32_t ready_ms;			//indication enabled to DATA_STATUE, last handshake
+	uint32_t ready_ms_max;
+}usr_session_stats_st;
+
+/*****************************************************************************
+ * Ự: ¼ɹֻ͡ʱͻỰ(ֻRAM). ֻAPP
+ * һ: Ѱ󶨵ֻ豸bond id, û󶨵İӵַ.
+ * ʱusr_session_beginûĲ. APPڵ¼ظ
+ * USR_SESSION_CAP_RESUMEŷƵĵ¼, ¼, õȳʱ.
+ * ΢Űѵ¼initһ𷢳, ֻһλظ. ظʧܻʱ˻¼.
+ * ڵǰѡеlink.
+*****************************************************************************/
+bool usr_session_begin(app_enum app);		//indicateʱ, true:ֻ̨л
+bool usr_session_cached(void);				//ǰ˻ֻͺʱ
+bool usr_session_resuming(void);			//ǰְָ: ķ, ΢ǰinit
+uint32_t usr_session_token(void);
+void usr_session_save(app_enum app,uint8_t phone_type,uint8_t timezone,uint32_t token,uint8_t resume_cap);
+void usr_session_request_sent(void);
+void usr_session_reply(void);
+void usr_session_ready(void);
+void usr_session_fallback(void);
+void usr_session_timeout_check(void);
+void usr_session_stats_get(usr_session_stats_st *p_stats);
+
+#endif
+
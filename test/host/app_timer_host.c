@@ -0,0 +1,186 @@
+/* Host implementation of the app_timer API, see app_timer_host.h. */
+
+#include "app_timer_host.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "nrf_error.h"
+
+#define HOST_MAX_TIMERS     (16)
+#define HOST_COUNTER_MASK   (0x00FFFFFF)   // RTC1 is a 24-bit counter.
+
+
+// Lives in the app_timer_t storage of each timer.
+typedef struct
+{
+    app_timer_timeout_handler_t handler;
+    void                      * p_context;
+    uint64_t                    expiry;
+    uint32_t                    period;     // Zero for a single shot timer.
+    bool                        repeated;
+    bool                        active;
+} host_timer_t;
+
+typedef char host_timer_fits[(sizeof(host_timer_t) <= sizeof(app_timer_t)) ? 1 : -1];
+
+
+static host_timer_t * m_timers[HOST_MAX_TIMERS];   // Timers created since the last reset.
+static uint32_t       m_timer_count;
+static uint64_t       m_now;
+
+
+uint32_t app_timer_init(uint32_t                      prescaler,
+                        uint8_t                       op_queues_size,
+                        void                        * p_buffer,
+                        app_timer_evt_schedule_func_t evt_schedule_func)
+{
+    app_timer_host_reset();
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_create(app_timer_id_t const *      p_timer_id,
+                          app_timer_mode_t            mode,
+                          app_timer_timeout_handler_t timeout_handler)
+{
+    host_timer_t * p_timer;
+
+    if ((p_timer_id == NULL) || (timeout_handler == NULL))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    p_timer = (host_timer_t *)*p_timer_id;
+
+    for (uint32_t i = 0; i < m_timer_count; i++)
+    {
+        if (m_timers[i] == p_timer)
+        {
+            return NRF_ERROR_INVALID_STATE;
+        }
+    }
+
+    if (m_timer_count == HOST_MAX_TIMERS)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    memset(p_timer, 0, sizeof(*p_timer));
+    p_timer->handler  = timeout_handler;
+    p_timer->repeated = (mode == APP_TIMER_MODE_REPEATED);
+
+    m_timers[m_timer_count++] = p_timer;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void * p_context)
+{
+    host_timer_t * const p_timer = (host_timer_t *)timer_id;
+
+    if ((timeout_ticks < APP_TIMER_MIN_TIMEOUT_TICKS) || (timeout_ticks > HOST_COUNTER_MASK))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    if (p_timer->handler == NULL)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    p_timer->p_context = p_context;
+    p_timer->expiry    = m_now + timeout_ticks;
+    p_timer->period    = p_timer->repeated ? timeout_ticks : 0;
+    p_timer->active    = true;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_stop(app_timer_id_t timer_id)
+{
+    ((host_timer_t *)timer_id)->active = false;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_stop_all(void)
+{
+    for (uint32_t i = 0; i < m_timer_count; i++)
+    {
+        m_timers[i]->active = false;
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_cnt_get(uint32_t * p_ticks)
+{
+    *p_ticks = (uint32_t)(m_now & HOST_COUNTER_MASK);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_cnt_diff_compute(uint32_t   ticks_to,
+                                    uint32_t   ticks_from,
+                                    uint32_t * p_ticks_diff)
+{
+    *p_ticks_diff = (ticks_to - ticks_from) & HOST_COUNTER_MASK;
+    return NRF_SUCCESS;
+}
+
+
+void app_timer_host_reset(void)
+{
+    m_timer_count = 0;
+    m_now         = 0;
+}
+
+
+void app_timer_host_run(uint64_t ticks)
+{
+    uint64_t const end = m_now + ticks;
+
+    for (;;)
+    {
+        host_timer_t * p_next = NULL;
+
+        for (uint32_t i = 0; i < m_timer_count; i++)
+        {
+            if (m_timers[i]->active &&
+                (m_timers[i]->expiry <= end) &&
+                ((p_next == NULL) || (m_timers[i]->expiry < p_next->expiry)))
+            {
+                p_next = m_timers[i];
+            }
+        }
+
+        if (p_next == NULL)
+        {
+            break;
+        }
+
+        m_now = p_next->expiry;
+
+        if (p_next->period != 0)
+        {
+            p_next->expiry += p_next->period;
+        }
+        else
+        {
+            p_next->active = false;
+        }
+
+        p_next->handler(p_next->p_context);
+    }
+
+    m_now = end;
+}
+
+
+uint64_t app_timer_host_ticks(void)
+{
+    return m_now;
+}
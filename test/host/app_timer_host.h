@@ -0,0 +1,29 @@
+/* Host implementation of the app_timer API, driven by a simulated RTC1.
+ *
+ * Time only advances when a test calls app_timer_host_run(). Timers expire in order of their
+ * deadlines and their handlers run directly, as with a NULL scheduler function.
+ */
+
+#ifndef APP_TIMER_HOST_H__
+#define APP_TIMER_HOST_H__
+
+#include <stdint.h>
+#include "app_timer.h"
+
+
+/**@brief   Function for stopping all timers and setting the counter back to zero. */
+void app_timer_host_reset(void);
+
+
+/**@brief   Function for advancing the counter and running the handlers of the timers that expire.
+ *
+ * @param[in]   ticks   Number of RTC1 ticks to advance.
+ */
+void app_timer_host_run(uint64_t ticks);
+
+
+/**@brief   Function for getting the number of ticks since the last reset, without wrapping. */
+uint64_t app_timer_host_ticks(void);
+
+
+#endif // APP_TIMER_HOST_H__
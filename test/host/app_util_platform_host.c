@@ -0,0 +1,22 @@
+/* Host stand-in for the critical regions of app_util_platform.c.
+ *
+ * The tests run in a single thread, and simulated interrupts are called from it, so there
+ * is nothing to mask.
+ */
+
+#include "app_util_platform.h"
+
+
+void app_util_critical_region_enter(uint8_t * p_nested)
+{
+    if (p_nested != NULL)
+    {
+        *p_nested = 0;
+    }
+}
+
+
+void app_util_critical_region_exit(uint8_t nested)
+{
+    (void)nested;
+}
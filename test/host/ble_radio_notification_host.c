@@ -0,0 +1,27 @@
+/* Host implementation of ble_radio_notification, see ble_radio_notification_host.h. */
+
+#include "ble_radio_notification_host.h"
+
+#include <stddef.h>
+#include "nrf_error.h"
+
+
+static ble_radio_notification_evt_handler_t m_evt_handler;
+
+
+uint32_t ble_radio_notification_init(uint32_t                             irq_priority,
+                                     uint8_t                              distance,
+                                     ble_radio_notification_evt_handler_t evt_handler)
+{
+    m_evt_handler = evt_handler;
+    return NRF_SUCCESS;
+}
+
+
+void ble_radio_notification_host_signal(bool radio_active)
+{
+    if (m_evt_handler != NULL)
+    {
+        m_evt_handler(radio_active);
+    }
+}
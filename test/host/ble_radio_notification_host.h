@@ -0,0 +1,21 @@
+/* Host implementation of ble_radio_notification.
+ *
+ * The SoftDevice interrupt is replaced by ble_radio_notification_host_signal(), which a test
+ * calls at the start and at the end of each simulated radio event.
+ */
+
+#ifndef BLE_RADIO_NOTIFICATION_HOST_H__
+#define BLE_RADIO_NOTIFICATION_HOST_H__
+
+#include <stdbool.h>
+#include "ble_radio_notification.h"
+
+
+/**@brief   Function for sending a radio notification to the registered handler, if any.
+ *
+ * @param[in]   radio_active    True before a radio event, false after it.
+ */
+void ble_radio_notification_host_signal(bool radio_active);
+
+
+#endif // BLE_RADIO_NOTIFICATION_HOST_H__
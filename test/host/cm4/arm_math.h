@@ -0,0 +1,74 @@
+/* Host stand-in for the parts of CMSIS arm_math.h that the DSP kernels use.
+ *
+ * Lets the ARM_MATH_CM4 paths of dsp_kernels.c run on a host. Each intrinsic follows the
+ * Cortex-M4 instruction: SMUAD and SMLAD add two 16x16 products into 32 bits and wrap,
+ * SMLALD and SMLALDX into 64 bits, QADD16 saturates each half, PKHBT packs a bottom and a
+ * shifted top half. Words hold the sample at the lower address in their low half, as on the
+ * little-endian target.
+ */
+
+#ifndef _ARM_MATH_H
+#define _ARM_MATH_H
+
+#include <stdint.h>
+
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+typedef int64_t q63_t;
+
+#define __SIMD32_CONST(p)   ((int32_t *)(p))
+#define __PKHBT(a, b, s)    ((((uint32_t)(a)) & 0x0000FFFFUL) | ((((uint32_t)(b)) << (s)) & 0xFFFF0000UL))
+
+#define HALF_LO(w)          ((int16_t)((uint32_t)(w) & 0xFFFF))
+#define HALF_HI(w)          ((int16_t)((uint32_t)(w) >> 16))
+
+
+static inline int32_t __SSAT(int32_t value, uint32_t bits)
+{
+    int32_t const max = (1L << (bits - 1)) - 1;
+
+    if (value > max)
+    {
+        return max;
+    }
+    if (value < -max - 1)
+    {
+        return -max - 1;
+    }
+    return value;
+}
+
+
+static inline int32_t __SMUAD(uint32_t x, uint32_t y)
+{
+    return (int32_t)((uint32_t)(HALF_LO(x) * HALF_LO(y)) + (uint32_t)(HALF_HI(x) * HALF_HI(y)));
+}
+
+
+static inline int32_t __SMLAD(uint32_t x, uint32_t y, int32_t acc)
+{
+    return (int32_t)((uint32_t)acc + (uint32_t)__SMUAD(x, y));
+}
+
+
+static inline int64_t __SMLALD(uint32_t x, uint32_t y, int64_t acc)
+{
+    return acc + (int64_t)HALF_LO(x) * HALF_LO(y) + (int64_t)HALF_HI(x) * HALF_HI(y);
+}
+
+
+static inline int64_t __SMLALDX(uint32_t x, uint32_t y, int64_t acc)
+{
+    return acc + (int64_t)HALF_LO(x) * HALF_HI(y) + (int64_t)HALF_HI(x) * HALF_LO(y);
+}
+
+
+static inline uint32_t __QADD16(uint32_t x, uint32_t y)
+{
+    uint32_t const lo = (uint16_t)__SSAT(HALF_LO(x) + HALF_LO(y), 16);
+    uint32_t const hi = (uint16_t)__SSAT(HALF_HI(x) + HALF_HI(y), 16);
+
+    return lo | (hi << 16);
+}
+
+#endif // _ARM_MATH_H
@@ -0,0 +1,40 @@
+/* Host stand-in for components/device/nrf.h.
+ *
+ * The device headers are included as on the target, so register layouts and bitfields are
+ * available. The peripherals that the modules under test read or write are redirected to
+ * RAM instances, defined in nrf_host.c, which the tests set up.
+ */
+
+#ifndef NRF_H
+#define NRF_H
+
+#include "nrf52.h"
+#include "nrf52_bitfields.h"
+#include "nrf52_name_change.h"
+#include "compiler_abstraction.h"
+
+// nrf51_to_nrf52.h comes with the device pack, not with the tree. Names the drivers use:
+#define NRF_GPIO    NRF_P0
+
+// Cortex-M barriers, for code that calls them directly.
+#define __DMB()     __sync_synchronize()
+#define __DSB()     __sync_synchronize()
+
+extern NRF_FICR_Type host_nrf_ficr;
+extern NRF_UICR_Type host_nrf_uicr;
+extern NRF_RTC_Type  host_nrf_rtc1;
+extern NRF_PWM_Type  host_nrf_pwm0;
+extern NRF_PWM_Type  host_nrf_pwm1;
+
+#undef  NRF_FICR
+#define NRF_FICR    (&host_nrf_ficr)
+#undef  NRF_UICR
+#define NRF_UICR    (&host_nrf_uicr)
+#undef  NRF_RTC1
+#define NRF_RTC1    (&host_nrf_rtc1)
+#undef  NRF_PWM0
+#define NRF_PWM0    (&host_nrf_pwm0)
+#undef  NRF_PWM1
+#define NRF_PWM1    (&host_nrf_pwm1)
+
+#endif // NRF_H
@@ -0,0 +1,23 @@
+/* RAM instances of the peripherals redirected by the host nrf.h.
+ *
+ * They start out as on a blank chip: no bootloader address in UICR and 128 pages of
+ * 4 kB flash in FICR.
+ */
+
+#include "nrf.h"
+
+
+NRF_FICR_Type host_nrf_ficr =
+{
+    .CODEPAGESIZE = 4096,
+    .CODESIZE     = 128,
+};
+
+NRF_UICR_Type host_nrf_uicr =
+{
+    .NRFFW = { [0 ... 14] = 0xFFFFFFFF },
+};
+
+NRF_RTC_Type host_nrf_rtc1;
+NRF_PWM_Type host_nrf_pwm0;
+NRF_PWM_Type host_nrf_pwm1;
@@ -0,0 +1,20 @@
+/* Host settings for the SDK modules which read sdk_config.h.
+ *
+ * The firmware has no sdk_config.h: SDK 11 modules take their settings from
+ * source/config. Only the modules built by the host tests read this one.
+ */
+
+#ifndef SDK_CONFIG_H
+#define SDK_CONFIG_H
+
+// mem_manager: two small categories and one large enough to need every summary bit.
+#define MEMORY_MANAGER_XXSMALL_BLOCK_COUNT  (40)
+#define MEMORY_MANAGER_XXSMALL_BLOCK_SIZE   (16)
+#define MEMORY_MANAGER_SMALL_BLOCK_COUNT    (8)
+#define MEMORY_MANAGER_SMALL_BLOCK_SIZE     (64)
+#define MEMORY_MANAGER_LARGE_BLOCK_COUNT    (1024)
+#define MEMORY_MANAGER_LARGE_BLOCK_SIZE     (128)
+#define MEM_MANAGER_ENABLE_LOGS             (0)
+#define MEM_MANAGER_DISABLE_API_PARAM_CHECK (0)
+
+#endif // SDK_CONFIG_H
@@ -0,0 +1,120 @@
+/* Host test of the accelerometer simulator, with the motion acquisition of source/motion.c.
+ *
+ * Replays a trace through the simulated LIS3DH FIFO and checks that motion.c hands every
+ * sample over in order and in mg, without overruns, with one wakeup and one transaction per
+ * watermark. Then prints the bus and wakeup cost per hour against reading each sample on
+ * its own.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "unit_test.h"
+#include "nrf_error.h"
+#include "accel_sim.h"
+#include "motion.h"
+
+#define TRACE_LENGTH        (MOTION_ODR_HZ * 60)
+#define RUN_SECONDS         (600)
+
+
+static accel_sim_sample_t m_trace[TRACE_LENGTH];
+
+
+// A sample the LIS3DH can represent: 12 bits of 2 mg at +-4 g.
+static int16_t mg_quantize(int32_t mg)
+{
+    return (int16_t)((mg / 2) * 2);
+}
+
+
+static void trace_build(void)
+{
+    for (uint32_t i = 0; i < TRACE_LENGTH; i++)
+    {
+        m_trace[i].x = mg_quantize((int32_t)(i % 200) * 10 - 1000);
+        m_trace[i].y = mg_quantize(100 + (int32_t)(i % 7));
+        m_trace[i].z = mg_quantize(1000 - (int32_t)(i % 50));
+    }
+}
+
+
+static void test_stream(void)
+{
+    accel_sim_config_t const config =
+    {
+        .p_trace       = m_trace,
+        .trace_length  = TRACE_LENGTH,
+        .loop          = true,
+        .twi_frequency = 400000,
+    };
+    motion_sample_st  block[MOTION_BLOCK_SAMPLES];
+    accel_sim_stats_t sim;
+    motion_stats_st   stats;
+    uint32_t          received = 0;
+    uint32_t          mismatches = 0;
+
+    trace_build();
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, accel_sim_init(&config));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, motion_init());
+    accel_sim_stats_reset();
+
+    for (uint32_t s = 0; s < RUN_SECONDS; s++)
+    {
+        accel_sim_run_for(1000000);
+
+        while (motion_block_get(block))
+        {
+            for (uint32_t k = 0; k < MOTION_BLOCK_SAMPLES; k++)
+            {
+                accel_sim_sample_t const * p_expected = &m_trace[(received + k) % TRACE_LENGTH];
+
+                if ((block[k].x != p_expected->x) ||
+                    (block[k].y != p_expected->y) ||
+                    (block[k].z != p_expected->z))
+                {
+                    mismatches++;
+                }
+            }
+            received += MOTION_BLOCK_SAMPLES;
+        }
+    }
+
+    accel_sim_stats_get(&sim);
+    motion_stats_get(&stats);
+
+    TEST_ASSERT_EQUAL(0, mismatches);
+    TEST_ASSERT_EQUAL(0, sim.overruns);
+    TEST_ASSERT_EQUAL(0, stats.overruns);
+    TEST_ASSERT_EQUAL(0, stats.dropped);
+    TEST_ASSERT_EQUAL(0, stats.errors);
+
+    // Everything the sensor sampled reached the algorithm, bar what is still in the FIFO.
+    TEST_ASSERT_EQUAL(MOTION_ODR_HZ * RUN_SECONDS, sim.samples);
+    TEST_ASSERT(received + MOTION_FIFO_WATERMARK + MOTION_BLOCK_SAMPLES > sim.samples);
+    TEST_ASSERT(received <= sim.samples);
+
+    // One wakeup and one transaction per watermark. The last batch may still be sampling.
+    TEST_ASSERT(sim.wakeups <= sim.samples / MOTION_FIFO_WATERMARK);
+    TEST_ASSERT(sim.wakeups + 1 >= sim.samples / MOTION_FIFO_WATERMARK);
+    TEST_ASSERT_EQUAL(sim.wakeups, sim.transactions);
+
+    printf("per hour      wakeups  transactions  bus bytes\n");
+    printf("FIFO batches  %7u  %12u  %9u\n",
+           accel_sim_per_hour(sim.wakeups, &sim),
+           accel_sim_per_hour(sim.transactions, &sim),
+           accel_sim_per_hour(sim.bus_bytes, &sim));
+    printf("per sample    %7u  %12u  %9u\n",
+           accel_sim_per_hour(sim.poll_wakeups, &sim),
+           accel_sim_per_hour(sim.poll_transactions, &sim),
+           accel_sim_per_hour(sim.poll_bus_bytes, &sim));
+
+    TEST_ASSERT(sim.wakeups * 20 < sim.poll_wakeups);
+    TEST_ASSERT(sim.bus_bytes < sim.poll_bus_bytes);
+}
+
+
+int main(void)
+{
+    test_stream();
+    TEST_EXIT();
+}
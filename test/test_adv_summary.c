@@ -0,0 +1,216 @@
+/* Host test of the scan response summary encoder of source/adv_summary.c.
+ *
+ * Checks the encoded AD structure byte by byte, that fields with no data yet go out as 0xFF
+ * and the sync state as unknown, the clamps, and the integrity tag against AES-128 of the
+ * body. The ECB of the SoftDevice is played by the software AES of aes_session.c, checked
+ * first against the FIPS-197 vector. Then runs the refresh timer and checks that only
+ * changes reach the SoftDevice.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "unit_test.h"
+#include "app_timer_host.h"
+#include "nrf_soc.h"
+#include "ble_gap.h"
+#include "app_error.h"
+#include "aes_session.h"
+#include "adv_summary.h"
+
+#define AD_HEAD             (4)     // len, type, company
+#define BODY_LENGTH         (13)
+#define REFRESH_TICKS       (((uint64_t)ADV_SUMMARY_REFRESH_MS * APP_TIMER_CLOCK_FREQ) / 1000)
+
+
+static uint8_t  m_sr[BLE_GAP_ADV_MAX_SIZE];
+static uint8_t  m_sr_len;
+static uint32_t m_sr_count;
+
+
+void app_error_handler_bare(ret_code_t error_code)
+{
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, error_code);
+}
+
+
+// What the SoftDevice provides on target.
+uint32_t sd_ecb_block_encrypt(nrf_ecb_hal_data_t * p_ecb_data)
+{
+    uint8_t iv[16] = {0};
+
+    aes_session_key_set(p_ecb_data->key);
+    memcpy(p_ecb_data->ciphertext, p_ecb_data->cleartext, sizeof(p_ecb_data->ciphertext));
+    return aes_session_cbc_encrypt(iv, p_ecb_data->ciphertext, sizeof(p_ecb_data->ciphertext));
+}
+
+
+uint32_t sd_ble_gap_adv_data_set(uint8_t const * p_data, uint8_t dlen, uint8_t const * p_sr_data, uint8_t srdlen)
+{
+    // The advertising packet is never touched.
+    TEST_ASSERT(p_data == NULL);
+    TEST_ASSERT_EQUAL(0, dlen);
+
+    memcpy(m_sr, p_sr_data, srdlen);
+    m_sr_len = srdlen;
+    m_sr_count++;
+    return NRF_SUCCESS;
+}
+
+
+static void test_ecb_stub(void)
+{
+    static uint8_t const key[16]      = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                                         0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+    static uint8_t const plain[16]    = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+                                         0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff};
+    static uint8_t const expected[16] = {0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+                                         0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a};
+    nrf_ecb_hal_data_t   ecb;
+
+    memcpy(ecb.key, key, sizeof(key));
+    memcpy(ecb.cleartext, plain, sizeof(plain));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_ecb_block_encrypt(&ecb));
+    TEST_ASSERT_MEMORY(expected, ecb.ciphertext, sizeof(expected));
+}
+
+
+static void test_encode(void)
+{
+    static uint8_t const expected[AD_HEAD + BODY_LENGTH] =
+    {
+        16, BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA, 0x00, 0x00,
+        0xFE, 0x02, ADV_SUMMARY_VERSION, ADV_SUMMARY_FLAG_SYNC,
+        0x0A, 0x0B,                 // seq
+        0x01, 0x23, 0x45,           // steps
+        0x01, 0x02,                 // active minutes
+        80, 55,                     // sleep score, battery
+    };
+    adv_summary_st summary =
+    {
+        .steps          = 0x012345,
+        .active_minutes = 0x0102,
+        .sleep_score    = 80,
+        .battery        = 55,
+        .sync_needed    = 1,
+    };
+    uint8_t        out[BLE_GAP_ADV_MAX_SIZE];
+
+    app_timer_host_reset();
+    adv_summary_init(NULL);
+
+    TEST_ASSERT_EQUAL(sizeof(expected), adv_summary_encode(&summary, 0x0A0B, out));
+    TEST_ASSERT_MEMORY(expected, out, sizeof(expected));
+
+    // Nothing known yet: 0xFF, and the sync state flagged as unknown rather than as no sync.
+    adv_summary_get(&summary);
+    TEST_ASSERT_EQUAL(0, summary.steps);
+    TEST_ASSERT_EQUAL(ADV_SUMMARY_UNKNOWN, summary.sleep_score);
+    TEST_ASSERT_EQUAL(ADV_SUMMARY_UNKNOWN, summary.battery);
+    TEST_ASSERT_EQUAL(ADV_SUMMARY_UNKNOWN, summary.sync_needed);
+    TEST_ASSERT_EQUAL(sizeof(expected), adv_summary_encode(&summary, 1, out));
+    TEST_ASSERT_EQUAL(ADV_SUMMARY_FLAG_SYNC_UNKNOWN, out[AD_HEAD + 3]);
+    TEST_ASSERT_EQUAL(0xFF, out[AD_HEAD + 11]);
+    TEST_ASSERT_EQUAL(0xFF, out[AD_HEAD + 12]);
+
+    // The scan response sent at init is the same.
+    TEST_ASSERT_EQUAL(1, m_sr_count);
+    TEST_ASSERT_EQUAL(sizeof(expected), m_sr_len);
+    TEST_ASSERT_EQUAL(1, m_sr[AD_HEAD + 5]);
+    TEST_ASSERT_MEMORY(out + AD_HEAD + 6, m_sr + AD_HEAD + 6, BODY_LENGTH - 6);
+
+    // Clamps: steps to 24 bits, a battery reading above 100 to 100.
+    summary.steps       = 0x1000000;
+    summary.battery     = 150;
+    summary.sync_needed = 0;
+    adv_summary_encode(&summary, 1, out);
+    TEST_ASSERT_EQUAL(0, out[AD_HEAD + 3]);
+    TEST_ASSERT_EQUAL(0xFF, out[AD_HEAD + 6]);
+    TEST_ASSERT_EQUAL(0xFF, out[AD_HEAD + 7]);
+    TEST_ASSERT_EQUAL(0xFF, out[AD_HEAD + 8]);
+    TEST_ASSERT_EQUAL(100, out[AD_HEAD + 12]);
+}
+
+
+static void test_tag(void)
+{
+    static uint8_t const key[16] = "0123456789abcdef";
+    adv_summary_st       summary = { .steps = 1000, .active_minutes = 20, .sleep_score = 70, .battery = 90 };
+    nrf_ecb_hal_data_t   ecb;
+    uint8_t              out[BLE_GAP_ADV_MAX_SIZE];
+    uint8_t              length;
+
+    app_timer_host_reset();
+    adv_summary_init(key);
+
+    length = adv_summary_encode(&summary, 7, out);
+    TEST_ASSERT_EQUAL(AD_HEAD + BODY_LENGTH + ADV_SUMMARY_TAG_LENGTH, length);
+    TEST_ASSERT_EQUAL(length - 1, out[0]);
+    TEST_ASSERT_EQUAL(ADV_SUMMARY_FLAG_TAG, out[AD_HEAD + 3]);
+
+    // The tag is AES-128 of the body padded with zeros, truncated.
+    memset(&ecb, 0, sizeof(ecb));
+    memcpy(ecb.key, key, sizeof(key));
+    memcpy(ecb.cleartext, out + AD_HEAD, BODY_LENGTH);
+    sd_ecb_block_encrypt(&ecb);
+    TEST_ASSERT_MEMORY(ecb.ciphertext, out + AD_HEAD + BODY_LENGTH, ADV_SUMMARY_TAG_LENGTH);
+
+    // Any change of the body, the sequence number included, changes the tag.
+    memcpy(ecb.cleartext, out + AD_HEAD + BODY_LENGTH, ADV_SUMMARY_TAG_LENGTH);
+    adv_summary_encode(&summary, 8, out);
+    TEST_ASSERT(memcmp(ecb.cleartext, out + AD_HEAD + BODY_LENGTH, ADV_SUMMARY_TAG_LENGTH) != 0);
+}
+
+
+static void test_refresh(void)
+{
+    adv_summary_st       summary;
+    adv_summary_stats_st stats;
+    uint8_t              seq;
+
+    app_timer_host_reset();
+    m_sr_count = 0;
+    adv_summary_init(NULL);
+    TEST_ASSERT_EQUAL(1, m_sr_count);
+    seq = m_sr[AD_HEAD + 5];
+
+    // No change: the timer wakes up and sends nothing.
+    app_timer_host_run(REFRESH_TICKS * 3);
+    TEST_ASSERT_EQUAL(1, m_sr_count);
+
+    // Changes are only recorded until the next period, and setting the same values is not one.
+    adv_summary_get(&summary);
+    summary.steps = 500;
+    adv_summary_set(&summary);
+    adv_summary_set(&summary);
+    TEST_ASSERT_EQUAL(1, m_sr_count);
+    app_timer_host_run(REFRESH_TICKS);
+    TEST_ASSERT_EQUAL(2, m_sr_count);
+    TEST_ASSERT_EQUAL((uint8_t)(seq + 1), m_sr[AD_HEAD + 5]);
+    TEST_ASSERT_EQUAL(500 & 0xFF, m_sr[AD_HEAD + 8]);
+
+    // Suspended, nothing is sent; the change goes out on resume.
+    adv_summary_suspend(true);
+    summary.battery = 40;
+    adv_summary_set(&summary);
+    app_timer_host_run(REFRESH_TICKS * 10);
+    TEST_ASSERT_EQUAL(2, m_sr_count);
+    adv_summary_suspend(false);
+    TEST_ASSERT_EQUAL(3, m_sr_count);
+    TEST_ASSERT_EQUAL(40, m_sr[AD_HEAD + 12]);
+
+    adv_summary_stats_get(&stats);
+    TEST_ASSERT_EQUAL(3, stats.refreshes);
+    TEST_ASSERT_EQUAL(3, stats.skipped);
+    TEST_ASSERT_EQUAL(3 * (AD_HEAD + BODY_LENGTH), stats.bytes);
+}
+
+
+int main(void)
+{
+    test_ecb_stub();
+    test_encode();
+    test_tag();
+    test_refresh();
+    TEST_EXIT();
+}
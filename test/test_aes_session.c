@@ -0,0 +1,175 @@
+/* Host test of aes_session against the NIST SP800-38A CBC and RFC 3610 CCM vectors,
+ * built with the software forward cipher (AES_SESSION_ECB_HW 0).
+ */
+
+#include <stdint.h>
+#include "unit_test.h"
+#include "nrf_error.h"
+#include "aes_session.h"
+
+static const uint8_t m_cbc_key[16] =
+{
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static const uint8_t m_cbc_iv[16] =
+{
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+};
+
+// SP800-38A F.2.1
+static const uint8_t m_cbc_plain[64] =
+{
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+};
+
+static const uint8_t m_cbc_cipher[64] =
+{
+    0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46, 0xce, 0xe9, 0x8e, 0x9b, 0x12, 0xe9, 0x19, 0x7d,
+    0x50, 0x86, 0xcb, 0x9b, 0x50, 0x72, 0x19, 0xee, 0x95, 0xdb, 0x11, 0x3a, 0x91, 0x76, 0x78, 0xb2,
+    0x73, 0xbe, 0xd6, 0xb8, 0xe3, 0xc1, 0x74, 0x3b, 0x71, 0x16, 0xe6, 0x9e, 0x22, 0x22, 0x95, 0x16,
+    0x3f, 0xf1, 0xca, 0xa1, 0x68, 0x1f, 0xac, 0x09, 0x12, 0x0e, 0xca, 0x30, 0x75, 0x86, 0xe1, 0xa7
+};
+
+// RFC 3610 packet vector #1: 8 bytes of AAD, 23 bytes of payload, M = 8
+static const uint8_t m_ccm_key[16] =
+{
+    0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xcb, 0xcc, 0xcd, 0xce, 0xcf
+};
+
+static const uint8_t m_ccm_nonce[13] =
+{
+    0x00, 0x00, 0x00, 0x03, 0x02, 0x01, 0x00, 0xa0, 0xa1, 0xa2, 0xa3, 0xa4, 0xa5
+};
+
+static const uint8_t m_ccm_cipher[23] =
+{
+    0x58, 0x8c, 0x97, 0x9a, 0x61, 0xc6, 0x63, 0xd2, 0xf0, 0x66, 0xd0, 0xc2, 0xc0, 0xf9, 0x89, 0x80,
+    0x6d, 0x5f, 0x6b, 0x61, 0xda, 0xc3, 0x84
+};
+
+static const uint8_t m_ccm_mic[8] = {0x17, 0xe8, 0xd1, 0x2c, 0xfd, 0xf9, 0x26, 0xe0};
+
+
+static void test_cbc_vectors(void)
+{
+    uint8_t iv[16];
+    uint8_t data[64];
+
+    aes_session_key_set(m_cbc_key);
+
+    memcpy(iv, m_cbc_iv, sizeof(iv));
+    memcpy(data, m_cbc_plain, sizeof(data));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, aes_session_cbc_encrypt(iv, data, sizeof(data)));
+    TEST_ASSERT_MEMORY(m_cbc_cipher, data, sizeof(data));
+    TEST_ASSERT_MEMORY(&m_cbc_cipher[48], iv, sizeof(iv));
+
+    // Chaining the IV across two calls gives the same stream.
+    memcpy(iv, m_cbc_iv, sizeof(iv));
+    memcpy(data, m_cbc_plain, sizeof(data));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, aes_session_cbc_encrypt(iv, data, 32));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, aes_session_cbc_encrypt(iv, &data[32], 32));
+    TEST_ASSERT_MEMORY(m_cbc_cipher, data, sizeof(data));
+
+    memcpy(iv, m_cbc_iv, sizeof(iv));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, aes_session_cbc_decrypt(iv, data, sizeof(data)));
+    TEST_ASSERT_MEMORY(m_cbc_plain, data, sizeof(data));
+
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_LENGTH, aes_session_cbc_encrypt(iv, data, 15));
+}
+
+
+static void test_cbc_padding(void)
+{
+    uint8_t  iv[16];
+    uint8_t  data[48];
+    uint16_t length;
+    uint16_t n;
+
+    aes_session_key_set(m_cbc_key);
+
+    for (n = 0; n <= 32; n++)
+    {
+        memcpy(data, m_cbc_plain, n);
+        memcpy(iv, m_cbc_key, sizeof(iv));
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, aes_session_cbc_pad_encrypt(iv, data, n, sizeof(data), &length));
+        TEST_ASSERT_EQUAL((n / 16 + 1) * 16, length);
+
+        memcpy(iv, m_cbc_key, sizeof(iv));
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, aes_session_cbc_pad_decrypt(iv, data, length, &length));
+        TEST_ASSERT_EQUAL(n, length);
+        TEST_ASSERT_MEMORY(m_cbc_plain, data, n);
+    }
+
+    // No room for the padding block.
+    TEST_ASSERT_EQUAL(NRF_ERROR_NO_MEM, aes_session_cbc_pad_encrypt(iv, data, 32, 32, &length));
+
+    // A block without valid padding, here the NIST ciphertext of unpadded data, is rejected.
+    memcpy(data, m_cbc_cipher, 16);
+    memcpy(iv, m_cbc_iv, sizeof(iv));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_DATA, aes_session_cbc_pad_decrypt(iv, data, 16, &length));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_LENGTH, aes_session_cbc_pad_decrypt(iv, data, 0, &length));
+}
+
+
+static void test_ccm_vector(void)
+{
+    uint8_t packet[31];
+    uint8_t mic[8];
+    uint8_t i;
+
+    for (i = 0; i < sizeof(packet); i++)
+    {
+        packet[i] = i;
+    }
+    aes_session_key_set(m_ccm_key);
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, aes_session_ccm_encrypt(m_ccm_nonce, packet, 8, &packet[8], 23, mic, 8));
+    TEST_ASSERT_MEMORY(m_ccm_cipher, &packet[8], 23);
+    TEST_ASSERT_MEMORY(m_ccm_mic, mic, 8);
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, aes_session_ccm_decrypt(m_ccm_nonce, packet, 8, &packet[8], 23, mic, 8));
+    for (i = 8; i < sizeof(packet); i++)
+    {
+        TEST_ASSERT_EQUAL(i, packet[i]);
+    }
+
+    // A flipped ciphertext bit fails the MIC and wipes the payload.
+    memcpy(&packet[8], m_ccm_cipher, 23);
+    packet[10] ^= 0x01;
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_DATA,
+                      aes_session_ccm_decrypt(m_ccm_nonce, packet, 8, &packet[8], 23, mic, 8));
+    for (i = 8; i < sizeof(packet); i++)
+    {
+        TEST_ASSERT_EQUAL(0, packet[i]);
+    }
+
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_PARAM,
+                      aes_session_ccm_encrypt(m_ccm_nonce, packet, 8, &packet[8], 23, mic, 5));
+}
+
+
+static void test_key_state(void)
+{
+    uint8_t iv[16] = {0};
+    uint8_t data[16] = {0};
+
+    aes_session_key_clear();
+    TEST_ASSERT(!aes_session_key_valid());
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_STATE, aes_session_cbc_encrypt(iv, data, sizeof(data)));
+    aes_session_key_set(m_cbc_key);
+    TEST_ASSERT(aes_session_key_valid());
+}
+
+
+int main(void)
+{
+    test_cbc_vectors();
+    test_cbc_padding();
+    test_ccm_vector();
+    test_key_state();
+    TEST_EXIT();
+}
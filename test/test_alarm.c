@@ -0,0 +1,323 @@
+/* Host test of the alarm and long-sit scheduling of source/alarm.c.
+ *
+ * Runs a month of simulated RTC through app_timer_host: weekday, weekend and one-shot alarms,
+ * a long-sit window on weekdays, random walking during the day, new settings on day 10 and
+ * the clock set forward an hour on day 20. Every fire is compared with a reference that checks
+ * each second of the month by brute force. Also checks that malformed setting frames are
+ * ignored and that a burst of changes is rebuilt once. Then prints how often the timer woke
+ * up, against a poll every second.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "unit_test.h"
+#include "app_timer_host.h"
+#include "app_scheduler.h"
+#include "alarm.h"
+
+#define TICKS_PER_SEC       (32768)
+#define START_SEC           (1477872000)    // 2016-10-31 00:00, a Monday.
+#define DAYS                (31)
+#define DAY_SEC             (86400)
+#define FIRES_MAX           (2000)
+#define EVT_LONG_SIT        (0xFF)          // Index logged for a long-sit fire.
+
+#define SCHED_QUEUE_SIZE    (4)
+
+
+typedef struct
+{
+    uint32_t sec;
+    uint8_t  index;
+} fire_t;
+
+
+static int64_t  m_offset;                   // Seconds the clock was set forward.
+static uint32_t m_seed;
+
+static fire_t   m_fired[FIRES_MAX];
+static uint32_t m_fired_count;
+static fire_t   m_expected[FIRES_MAX];
+static uint32_t m_expected_count;
+
+static app_sched_event_handler_t m_sched_queue[SCHED_QUEUE_SIZE];
+static uint32_t                  m_sched_count;
+
+// The reference state.
+static alarm_st    m_ref_alarms[ALARM_MAX];
+static long_sit_st m_ref_long_sit;
+static uint32_t    m_ref_sit_since;
+
+
+unsigned int system_sec_get(void)
+{
+    return (unsigned int)(START_SEC + app_timer_host_ticks() / TICKS_PER_SEC + m_offset);
+}
+
+
+// The app_scheduler event header holds a 32-bit function pointer, so the queue is played here.
+uint32_t app_sched_event_put(void * p_event_data, uint16_t event_size, app_sched_event_handler_t handler)
+{
+    TEST_ASSERT(m_sched_count < SCHED_QUEUE_SIZE);
+    m_sched_queue[m_sched_count++] = handler;
+    return NRF_SUCCESS;
+}
+
+
+void app_sched_execute(void)
+{
+    for (uint32_t i = 0; i < m_sched_count; i++)
+    {
+        m_sched_queue[i](NULL, 0);
+    }
+    m_sched_count = 0;
+}
+
+
+static uint32_t random_below(uint32_t n)
+{
+    m_seed = m_seed * 1103515245 + 12345;
+    return (m_seed >> 16) % n;
+}
+
+
+static void alarm_handler(uint8_t evt, uint8_t index)
+{
+    TEST_ASSERT(m_fired_count < FIRES_MAX);
+    m_fired[m_fired_count].sec   = system_sec_get();
+    m_fired[m_fired_count].index = (evt == ALARM_EVT_LONG_SIT) ? EVT_LONG_SIT : index;
+    m_fired_count++;
+}
+
+
+static void expect(uint32_t sec, uint8_t index)
+{
+    TEST_ASSERT(m_expected_count < FIRES_MAX);
+    m_expected[m_expected_count].sec   = sec;
+    m_expected[m_expected_count].index = index;
+    m_expected_count++;
+}
+
+
+// Monday is bit 0.
+static bool week_match(uint8_t week, uint32_t sec)
+{
+    return (week == 0) || ((week >> ((sec / DAY_SEC + 3) % 7)) & 1);
+}
+
+
+// What should happen at this second.
+static void reference_second(uint32_t sec)
+{
+    uint32_t const midnight = sec / DAY_SEC * DAY_SEC;
+
+    for (uint8_t i = 0; i < ALARM_MAX; i++)
+    {
+        alarm_st * const p_alarm = &m_ref_alarms[i];
+
+        if (p_alarm->enable &&
+            (sec == midnight + p_alarm->hour * 3600 + p_alarm->minute * 60) &&
+            week_match(p_alarm->week, sec))
+        {
+            expect(sec, i);
+            p_alarm->enable = (p_alarm->week != 0);
+        }
+    }
+
+    if (m_ref_long_sit.enable && week_match(m_ref_long_sit.week, sec))
+    {
+        uint32_t const start = midnight + m_ref_long_sit.start * 60;
+        uint32_t const end   = midnight + m_ref_long_sit.end * 60;
+        uint32_t const since = (m_ref_sit_since > start) ? m_ref_sit_since : start;
+
+        if ((sec >= start) && (sec <= end) && (sec - since >= m_ref_long_sit.minutes * 60))
+        {
+            expect(sec, EVT_LONG_SIT);
+            m_ref_sit_since = sec;
+        }
+    }
+}
+
+
+static void settings_put(uint8_t const * p_alarms, uint8_t alarms_length, uint8_t const * p_long_sit)
+{
+    alarm_setting_put(p_alarms, alarms_length);
+    alarm_long_sit_put(p_long_sit, 7);
+    app_sched_execute();
+
+    memset(m_ref_alarms, 0, sizeof(m_ref_alarms));
+    for (uint8_t i = 0; i < p_alarms[0]; i++)
+    {
+        m_ref_alarms[i].enable = (p_alarms[1 + 3 * i] & 0x80) != 0;
+        m_ref_alarms[i].week   = p_alarms[1 + 3 * i] & 0x7F;
+        m_ref_alarms[i].hour   = p_alarms[2 + 3 * i];
+        m_ref_alarms[i].minute = p_alarms[3 + 3 * i];
+    }
+    m_ref_long_sit.enable  = (p_long_sit[0] != 0);
+    m_ref_long_sit.week    = p_long_sit[1];
+    m_ref_long_sit.start   = p_long_sit[2] * 60 + p_long_sit[3];
+    m_ref_long_sit.end     = p_long_sit[4] * 60 + p_long_sit[5];
+    m_ref_long_sit.minutes = p_long_sit[6];
+    m_ref_sit_since        = system_sec_get();
+}
+
+
+static void test_month(void)
+{
+    // Weekdays 7:00, weekends 9:30, once at 12:15.
+    static uint8_t const alarms_1[]   = {3, 0x80 | 0x1F, 7, 0, 0x80 | 0x60, 9, 30, 0x80, 12, 15};
+    // Every day 6:45, Mondays 22:00, one switched off, Monday, Wednesday and Friday 18:05.
+    static uint8_t const alarms_2[]   = {4, 0x80 | 0x7F, 6, 45, 0x80 | 0x01, 22, 0, 0x00, 8, 0, 0x80 | 0x15, 18, 5};
+    // Weekdays 9:00 to 18:00 after an hour, then every day 8:30 to 20:30 after 45 minutes.
+    static uint8_t const long_sit_1[] = {1, 0x1F, 9, 0, 18, 0, 60};
+    static uint8_t const long_sit_2[] = {1, 0, 8, 30, 20, 30, 45};
+    // Events fall inside a second, after the timers of that second.
+    uint64_t const       settings_at  = (uint64_t)10 * DAY_SEC * TICKS_PER_SEC + 777;
+    uint64_t const       jump_at      = ((uint64_t)20 * DAY_SEC + 3 * 3600) * TICKS_PER_SEC + 999;
+    uint64_t const       end          = (uint64_t)DAYS * DAY_SEC * TICKS_PER_SEC;
+    uint32_t             walk_sec     = 600;
+    uint32_t             checked      = START_SEC;     // The reference has run up to here.
+    uint32_t             walks        = 0;
+    uint32_t             alarms       = 0;
+    alarm_stats_st       stats;
+
+    m_seed           = 7;
+    m_offset         = 0;
+    m_fired_count    = 0;
+    m_expected_count = 0;
+    app_timer_host_reset();
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, alarm_init(alarm_handler));
+    settings_put(alarms_1, sizeof(alarms_1), long_sit_1);
+
+    while (app_timer_host_ticks() < end)
+    {
+        uint64_t const walk_at = (uint64_t)walk_sec * TICKS_PER_SEC + 12345;
+        uint64_t       next    = walk_at;
+        uint32_t       now;
+
+        if ((app_timer_host_ticks() < settings_at) && (settings_at < next))
+        {
+            next = settings_at;
+        }
+        if ((app_timer_host_ticks() < jump_at) && (jump_at < next))
+        {
+            next = jump_at;
+        }
+
+        app_timer_host_run(next - app_timer_host_ticks());
+        now = system_sec_get();
+        while (checked < now)
+        {
+            reference_second(++checked);
+        }
+
+        if (next == settings_at)
+        {
+            settings_put(alarms_2, sizeof(alarms_2), long_sit_2);
+        }
+        else if (next == jump_at)
+        {
+            // The seconds skipped are not checked, and the sitting time starts over.
+            m_offset += 3600;
+            alarm_time_changed();
+            app_sched_execute();
+            checked         = system_sec_get();
+            m_ref_sit_since = checked;
+        }
+        else
+        {
+            // Steps counted in this minute: more often in the day, in bursts.
+            uint32_t const hour = (now % DAY_SEC) / 3600;
+
+            alarm_activity(now);
+            m_ref_sit_since = (now > m_ref_sit_since) ? now : m_ref_sit_since;
+            walks++;
+            if ((hour >= 8) && (hour < 22))
+            {
+                walk_sec += (random_below(100) < 70) ? 60 : 30 * 60 + random_below(90 * 60);
+            }
+            else
+            {
+                walk_sec += 3600;
+            }
+        }
+    }
+
+    TEST_ASSERT_EQUAL(m_expected_count, m_fired_count);
+    for (uint32_t i = 0; (i < m_fired_count) && (i < m_expected_count); i++)
+    {
+        TEST_ASSERT_EQUAL(m_expected[i].sec, m_fired[i].sec);
+        TEST_ASSERT_EQUAL(m_expected[i].index, m_fired[i].index);
+        alarms += (m_fired[i].index != EVT_LONG_SIT);
+    }
+
+    alarm_stats_get(&stats);
+    TEST_ASSERT_EQUAL(alarms, stats.alarms);
+    TEST_ASSERT_EQUAL(m_fired_count - alarms, stats.long_sits);
+    TEST_ASSERT_EQUAL(3, stats.reschedules);
+    TEST_ASSERT(alarms > 40);
+    TEST_ASSERT(stats.long_sits > 100);
+    TEST_ASSERT(stats.deferred > 0);
+    // One wakeup per fire or per ALARM_TIMER_MAX_SEC hop, give or take.
+    TEST_ASSERT(stats.wakeups <= DAYS * DAY_SEC / ALARM_TIMER_MAX_SEC + stats.alarms + stats.long_sits + stats.deferred + 10);
+
+    printf("%u days, %u walk minutes: %u alarms, %u long-sit, %u deferred\n",
+           DAYS, walks, stats.alarms, stats.long_sits, stats.deferred);
+    printf("timer wakeups %u (%u hops), polling each second would wake %u times\n",
+           stats.wakeups, stats.idle_wakeups, DAYS * DAY_SEC);
+}
+
+
+static void test_bad_frames(void)
+{
+    static uint8_t const too_many[]  = {ALARM_MAX + 1, 0x80, 7, 0};
+    static uint8_t const truncated[] = {2, 0x80, 7, 0, 0x80, 8};
+    static uint8_t const bad_time[]  = {2, 0x80, 24, 0, 0x80, 8, 0};
+    static uint8_t const long_sit[]  = {1, 0, 9, 0, 18, 0};
+    alarm_stats_st       stats;
+    uint32_t             fired;
+
+    m_offset      = 0;
+    m_fired_count = 0;
+    app_timer_host_reset();
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, alarm_init(alarm_handler));
+
+    // Nothing is staged from a frame that is too short or lists too many alarms.
+    alarm_setting_put(too_many, 0);
+    alarm_setting_put(too_many, sizeof(too_many));
+    alarm_setting_put(truncated, sizeof(truncated));
+    alarm_long_sit_put(long_sit, sizeof(long_sit));
+    app_sched_execute();
+    alarm_stats_get(&stats);
+    TEST_ASSERT_EQUAL(0, stats.reschedules);
+
+    // An entry with a time out of range is dropped, the others are kept.
+    alarm_setting_put(bad_time, sizeof(bad_time));
+    app_sched_execute();
+    app_timer_host_run((uint64_t)DAY_SEC * TICKS_PER_SEC);
+    alarm_stats_get(&stats);
+    TEST_ASSERT_EQUAL(1, stats.reschedules);
+    TEST_ASSERT_EQUAL(1, stats.alarms);
+    TEST_ASSERT_EQUAL(1, m_fired_count);
+    TEST_ASSERT_EQUAL(START_SEC + 8 * 3600, m_fired[0].sec);
+    TEST_ASSERT_EQUAL(1, m_fired[0].index);
+
+    // Several changes in a row are rebuilt once.
+    fired = m_fired_count;
+    alarm_setting_put(bad_time, sizeof(bad_time));
+    alarm_time_changed();
+    alarm_setting_put(bad_time, sizeof(bad_time));
+    app_sched_execute();
+    alarm_stats_get(&stats);
+    TEST_ASSERT_EQUAL(2, stats.reschedules);
+    TEST_ASSERT_EQUAL(fired, m_fired_count);
+}
+
+
+int main(void)
+{
+    test_month();
+    test_bad_frames();
+    TEST_EXIT();
+}
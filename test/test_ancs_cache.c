@@ -0,0 +1,547 @@
+/* Host test of the ANCS handle cache of source/ble_ancs_ios.
+ *
+ * Runs the client and components/ble/ble_db_discovery on the BLE link simulator against a
+ * phone with the GATT service and ANCS. The Device Manager application context of the bond
+ * is held in RAM. Checks that the handles are stored only once the phone acknowledged the
+ * Notification Source, Data Source and Service Changed CCCD writes, that a record with a bad
+ * magic or a wrong length is not restored, and that a Service Changed indication drops the
+ * record and discovers the phone again. Then prints the time from the connection to the first
+ * attribute request on the Control Point, with and without the stored handles.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "unit_test.h"
+#include "app_error.h"
+#include "ble_sim.h"
+#include "ble_hci.h"
+#include "ble_db_discovery.h"
+#include "device_manager.h"
+#include "nrf_delay.h"
+#include "ble_ancs_ios.h"
+#include "ancs_ios_usrdesign.h"
+
+#define CONN_INTERVAL       24      // 30 ms, as iOS picks.
+#define SUP_TIMEOUT_10MS    400
+#define RUN_EVENTS          60      // Enough for a full discovery and the CCCD writes.
+#define LOG_SIZE            8
+#define NOTIF_UID           0x12345678
+
+
+typedef struct
+{
+    uint16_t handle;
+    uint32_t store_count;       // Records stored once the client handled the response.
+} write_rsp_log_t;
+
+extern ble_ancs_c_t       m_ios_ancs;
+
+static ble_db_discovery_t m_db_discovery;
+static uint16_t           m_conn_handle;
+static dm_handle_t        m_peer;
+
+static uint8_t            m_context[DEVICE_MANAGER_APP_CONTEXT_SIZE];   // Application context of the bond.
+static uint32_t           m_context_len;
+static bool               m_context_valid;
+static uint32_t           m_store_count;
+static uint32_t           m_delete_count;
+
+static write_rsp_log_t    m_write_rsp_log[LOG_SIZE];
+static uint32_t           m_write_rsp_count;
+static uint32_t           m_sc_hvx_count;
+static uint32_t           m_fetch_count;
+static uint64_t           m_connect_us;
+static uint64_t           m_first_fetch_us;
+
+static uint16_t           m_ns_handle;
+static uint16_t           m_ns_cccd_handle;
+static uint16_t           m_ds_cccd_handle;
+static uint16_t           m_cp_handle;
+static uint16_t           m_sc_handle;
+static uint16_t           m_sc_cccd_handle;
+
+
+void app_error_handler_bare(ret_code_t error_code)
+{
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, error_code);
+}
+
+
+// Application context of the bond, held in RAM as the Device Manager holds it in flash.
+ret_code_t dm_application_context_set(dm_handle_t const              * p_handle,
+                                      dm_application_context_t const * p_context)
+{
+    TEST_ASSERT(p_handle->device_id != DM_INVALID_ID);
+    TEST_ASSERT(p_context->len <= sizeof(m_context));
+
+    memcpy(m_context, p_context->p_data, p_context->len);
+    m_context_len   = p_context->len;
+    m_context_valid = true;
+    m_store_count++;
+
+    return NRF_SUCCESS;
+}
+
+
+// As the Device Manager, copies a whole context and reports the stored length.
+ret_code_t dm_application_context_get(dm_handle_t const        * p_handle,
+                                      dm_application_context_t * p_context)
+{
+    if ((p_handle->device_id == DM_INVALID_ID) || !m_context_valid)
+    {
+        return DM_NO_APP_CONTEXT;
+    }
+
+    memcpy(p_context->p_data, m_context, sizeof(m_context));
+    p_context->len = m_context_len;
+
+    return NRF_SUCCESS;
+}
+
+
+ret_code_t dm_application_context_delete(dm_handle_t const * p_handle)
+{
+    TEST_ASSERT_EQUAL(m_peer.device_id, p_handle->device_id);
+
+    m_context_valid = false;
+    m_delete_count++;
+
+    return NRF_SUCCESS;
+}
+
+
+ret_code_t dm_handle_initialize(dm_handle_t * p_handle)
+{
+    p_handle->appl_id       = DM_INVALID_ID;
+    p_handle->connection_id = DM_INVALID_ID;
+    p_handle->device_id     = DM_INVALID_ID;
+    p_handle->service_id    = DM_INVALID_ID;
+
+    return NRF_SUCCESS;
+}
+
+
+// The CPU waits while the radio keeps running, events are sent once the handler returns.
+void nrf_delay_ms(uint32_t volatile number_of_ms)
+{
+    ble_sim_run_for(number_of_ms * 1000);
+}
+
+
+// Requests the attributes of every new notification, as source/ancs_ios_usrdesign.c does.
+void parse_notif(const uint8_t * p_data_src, const uint16_t hvx_data_len)
+{
+    ble_ancs_c_evt_notif_t notif;
+
+    TEST_ASSERT_EQUAL(8, hvx_data_len);
+
+    notif.evt_id         = (ble_ancs_c_evt_id_values_t)p_data_src[0];
+    notif.evt_flags      = (ble_ancs_c_notif_flags_t){0};
+    notif.category_id    = (ble_ancs_c_category_id_values_t)p_data_src[2];
+    notif.category_count = p_data_src[3];
+    notif.notif_uid      = uint32_decode(&p_data_src[4]);
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_ancs_c_request_attrs(&m_ios_ancs, &notif));
+}
+
+
+void parse_get_notif_attrs_response(const uint8_t * p_data_src, const uint16_t hvx_data_len)
+{
+}
+
+
+static void db_disc_handler(ble_db_discovery_evt_t * p_evt)
+{
+    ble_ancs_c_on_db_disc_evt(&m_ios_ancs, p_evt);
+}
+
+
+// As source/main.c dispatches the events.
+static void ble_evt_handler(ble_evt_t * p_ble_evt)
+{
+    if (p_ble_evt->header.evt_id == BLE_GAP_EVT_CONNECTED)
+    {
+        m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+    }
+    else if (p_ble_evt->header.evt_id == BLE_GAP_EVT_DISCONNECTED)
+    {
+        m_conn_handle = BLE_CONN_HANDLE_INVALID;
+    }
+    else if ((p_ble_evt->header.evt_id == BLE_GATTC_EVT_HVX) &&
+             (p_ble_evt->evt.gattc_evt.params.hvx.handle == m_sc_handle))
+    {
+        m_sc_hvx_count++;
+    }
+
+    ble_db_discovery_on_ble_evt(&m_db_discovery, p_ble_evt);
+    ble_ancs_c_on_ble_evt(&m_ios_ancs, p_ble_evt);
+
+    if ((p_ble_evt->header.evt_id == BLE_GATTC_EVT_WRITE_RSP) && (m_write_rsp_count < LOG_SIZE))
+    {
+        m_write_rsp_log[m_write_rsp_count].handle      = p_ble_evt->evt.gattc_evt.params.write_rsp.handle;
+        m_write_rsp_log[m_write_rsp_count].store_count = m_store_count;
+        m_write_rsp_count++;
+    }
+}
+
+
+// The phone sends its pending notification once the Notification Source is enabled.
+static void phone_notify(uint16_t conn_handle)
+{
+    uint8_t const notif[8] =
+    {
+        BLE_ANCS_EVENT_ID_NOTIFICATION_ADDED, 0, BLE_ANCS_CATEGORY_ID_INCOMING_CALL, 1,
+        (uint8_t)NOTIF_UID, (uint8_t)(NOTIF_UID >> 8), (uint8_t)(NOTIF_UID >> 16), (uint8_t)(NOTIF_UID >> 24),
+    };
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS,
+                      ble_sim_peer_hvx(conn_handle, m_ns_handle, BLE_GATT_HVX_NOTIFICATION, notif, sizeof(notif)));
+}
+
+
+static void peer_write_handler(uint16_t        conn_handle,
+                               uint16_t        handle,
+                               uint8_t         write_op,
+                               uint8_t const * p_data,
+                               uint16_t        len)
+{
+    if ((handle == m_ns_cccd_handle) && (p_data[0] == BLE_GATT_HVX_NOTIFICATION))
+    {
+        phone_notify(conn_handle);
+    }
+    else if (handle == m_cp_handle)
+    {
+        TEST_ASSERT_EQUAL(BLE_GATT_OP_WRITE_REQ, write_op);
+        TEST_ASSERT_EQUAL(BLE_ANCS_COMMAND_ID_GET_NOTIF_ATTRIBUTES, p_data[0]);
+        TEST_ASSERT_EQUAL(NOTIF_UID, uint32_decode(&p_data[1]));
+
+        if (m_fetch_count++ == 0)
+        {
+            m_first_fetch_us = ble_sim_time_us();
+        }
+    }
+}
+
+
+/**@brief Builds the phone's database, with a Battery Service before ANCS if @p shifted.
+ *
+ * @details The ANCS characteristics use the vendor UUID types the client registered.
+ */
+static void phone_db_set(bool with_service_changed, bool shifted)
+{
+    ble_sim_peer_char_t const gap_chars[] =
+    {
+        {{BLE_UUID_GAP_CHARACTERISTIC_DEVICE_NAME, BLE_UUID_TYPE_BLE}, {.read = 1}},
+    };
+    ble_sim_peer_char_t const gatt_chars[] =
+    {
+        {{BLE_UUID_GATT_CHARACTERISTIC_SERVICE_CHANGED, BLE_UUID_TYPE_BLE}, {.indicate = 1}},
+    };
+    ble_sim_peer_char_t const bas_chars[] =
+    {
+        {{BLE_UUID_BATTERY_LEVEL_CHAR, BLE_UUID_TYPE_BLE}, {.read = 1, .notify = 1}},
+    };
+    ble_sim_peer_char_t const ancs_chars[] =
+    {
+        {{ANCS_UUID_CHAR_NOTIFICATION_SOURCE, m_ios_ancs.service.notif_source_char.uuid.type}, {.notify = 1}},
+        {{ANCS_UUID_CHAR_CONTROL_POINT, m_ios_ancs.service.control_point_char.uuid.type}, {.write = 1}},
+        {{ANCS_UUID_CHAR_DATA_SOURCE, m_ios_ancs.service.data_source_char.uuid.type}, {.notify = 1}},
+    };
+    ble_sim_peer_service_t services[4];
+    uint8_t                count = 0;
+    ble_uuid_t             uuid;
+
+    services[count++] = (ble_sim_peer_service_t){{BLE_UUID_GAP, BLE_UUID_TYPE_BLE}, gap_chars, 1};
+    if (with_service_changed)
+    {
+        services[count++] = (ble_sim_peer_service_t){{BLE_UUID_GATT, BLE_UUID_TYPE_BLE}, gatt_chars, 1};
+    }
+    if (shifted)
+    {
+        services[count++] = (ble_sim_peer_service_t){{BLE_UUID_BATTERY_SERVICE, BLE_UUID_TYPE_BLE}, bas_chars, 1};
+    }
+    services[count++] = (ble_sim_peer_service_t){m_ios_ancs.service.service.uuid, ancs_chars, 3};
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_peer_db_set(services, count));
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_peer_char_handles_get(&ancs_chars[0].uuid, &m_ns_handle, &m_ns_cccd_handle));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_peer_char_handles_get(&ancs_chars[1].uuid, &m_cp_handle, &uuid.uuid));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_peer_char_handles_get(&ancs_chars[2].uuid, &uuid.uuid, &m_ds_cccd_handle));
+
+    m_sc_handle      = BLE_GATT_HANDLE_INVALID;
+    m_sc_cccd_handle = BLE_GATT_HANDLE_INVALID;
+    if (with_service_changed)
+    {
+        TEST_ASSERT_EQUAL(NRF_SUCCESS,
+                          ble_sim_peer_char_handles_get(&gatt_chars[0].uuid, &m_sc_handle, &m_sc_cccd_handle));
+    }
+}
+
+
+// A reset of the band, the bond and its application context survive.
+static void stack_init(bool with_service_changed)
+{
+    ble_sim_config_t const config =
+    {
+        .evt_handler        = ble_evt_handler,
+        .peer_write_handler = peer_write_handler,
+        .seed               = 1,
+    };
+    ble_enable_params_t    enable = {0};
+    uint32_t               app_ram_base = 0;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_init(&config));
+
+    enable.gap_enable_params.periph_conn_count = 1;
+    enable.common_enable_params.vs_uuid_count  = 4;
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_ble_enable(&enable, &app_ram_base));
+
+    memset(&m_db_discovery, 0, sizeof(m_db_discovery));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_db_discovery_init(db_disc_handler));
+    ios_ancs_service_init(&m_db_discovery);
+
+    phone_db_set(with_service_changed, false);
+
+    m_conn_handle     = BLE_CONN_HANDLE_INVALID;
+    m_peer            = (dm_handle_t){.appl_id = 0, .connection_id = 0, .device_id = 0, .service_id = 0};
+    m_store_count     = 0;
+    m_delete_count    = 0;
+    m_write_rsp_count = 0;
+    m_sc_hvx_count    = 0;
+}
+
+
+/**@brief Connects the phone and secures the link, as DM_EVT_LINK_SECURED in source/main.c.
+ *
+ * @details Encryption takes as long on both paths and is left out.
+ *
+ * @return  Whether the handles were restored.
+ */
+static bool connect(void)
+{
+    ble_gap_adv_params_t const adv =
+    {
+        .type     = BLE_GAP_ADV_TYPE_ADV_IND,
+        .interval = 40,
+    };
+    ble_gap_conn_params_t const params =
+    {
+        .min_conn_interval = CONN_INTERVAL,
+        .max_conn_interval = CONN_INTERVAL,
+        .conn_sup_timeout  = SUP_TIMEOUT_10MS,
+    };
+    uint16_t conn_handle;
+    bool     restored;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_ble_gap_adv_start(&adv));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_peer_connect(&params, &conn_handle));
+    TEST_ASSERT_EQUAL(conn_handle, m_conn_handle);
+
+    m_fetch_count  = 0;
+    m_connect_us   = ble_sim_time_us();
+
+    restored = ios_ancs_handles_restore(&m_peer, m_conn_handle);
+    if (restored)
+    {
+        // The phone keeps the CCCDs of a bond.
+        phone_notify(m_conn_handle);
+    }
+    else
+    {
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_db_discovery_start(&m_db_discovery, m_conn_handle));
+    }
+
+    return restored;
+}
+
+
+static void disconnect(void)
+{
+    TEST_ASSERT_EQUAL(NRF_SUCCESS,
+                      ble_sim_peer_disconnect(m_conn_handle, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION));
+    ble_sim_run_for(100000);
+    TEST_ASSERT_EQUAL(BLE_CONN_HANDLE_INVALID, m_conn_handle);
+    TEST_ASSERT_EQUAL(BLE_CONN_HANDLE_INVALID, m_ios_ancs.conn_handle);
+}
+
+
+static void handles_check(void)
+{
+    TEST_ASSERT_EQUAL(m_cp_handle, m_ios_ancs.service.control_point_char.handle_value);
+    TEST_ASSERT_EQUAL(m_ns_handle, m_ios_ancs.service.notif_source_char.handle_value);
+    TEST_ASSERT_EQUAL(m_ns_cccd_handle, m_ios_ancs.service.notif_source_cccd.handle);
+    TEST_ASSERT_EQUAL(m_ds_cccd_handle, m_ios_ancs.service.data_source_cccd.handle);
+}
+
+
+static void test_store_after_acks(void)
+{
+    stack_init(true);
+
+    TEST_ASSERT(!connect());
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_run_events(m_conn_handle, RUN_EVENTS));
+    handles_check();
+    TEST_ASSERT_EQUAL(1, m_fetch_count);
+
+    // The record follows the last of the three CCCD acknowledgements, then the fetch.
+    TEST_ASSERT_EQUAL(4, m_write_rsp_count);
+    TEST_ASSERT_EQUAL(m_ns_cccd_handle, m_write_rsp_log[0].handle);
+    TEST_ASSERT_EQUAL(0, m_write_rsp_log[0].store_count);
+    TEST_ASSERT_EQUAL(m_ds_cccd_handle, m_write_rsp_log[1].handle);
+    TEST_ASSERT_EQUAL(0, m_write_rsp_log[1].store_count);
+    TEST_ASSERT_EQUAL(m_sc_cccd_handle, m_write_rsp_log[2].handle);
+    TEST_ASSERT_EQUAL(1, m_write_rsp_log[2].store_count);
+    TEST_ASSERT_EQUAL(m_cp_handle, m_write_rsp_log[3].handle);
+    TEST_ASSERT_EQUAL(1, m_store_count);
+    TEST_ASSERT(m_context_valid);
+    disconnect();
+
+    // Without Service Changed, the Notification and Data Source acknowledgements are enough.
+    m_context_valid = false;
+    stack_init(false);
+
+    TEST_ASSERT(!connect());
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_run_events(m_conn_handle, RUN_EVENTS));
+    TEST_ASSERT_EQUAL(3, m_write_rsp_count);
+    TEST_ASSERT_EQUAL(0, m_write_rsp_log[0].store_count);
+    TEST_ASSERT_EQUAL(m_ds_cccd_handle, m_write_rsp_log[1].handle);
+    TEST_ASSERT_EQUAL(1, m_write_rsp_log[1].store_count);
+    TEST_ASSERT_EQUAL(1, m_store_count);
+    disconnect();
+}
+
+
+static void test_restore_checks(void)
+{
+    dm_handle_t const unknown = {.device_id = DM_INVALID_ID};
+    uint8_t           record[DEVICE_MANAGER_APP_CONTEXT_SIZE];
+    uint32_t          record_len;
+
+    // A record from a first connection.
+    m_context_valid = false;
+    stack_init(true);
+    TEST_ASSERT(!connect());
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_run_events(m_conn_handle, RUN_EVENTS));
+    disconnect();
+    TEST_ASSERT_EQUAL(1, m_store_count);
+    memcpy(record, m_context, sizeof(record));
+    record_len = m_context_len;
+
+    // No record.
+    stack_init(true);
+    m_context_valid = false;
+    TEST_ASSERT(!ios_ancs_handles_restore(&m_peer, 0));
+    TEST_ASSERT_EQUAL(BLE_GATT_HANDLE_INVALID, m_ios_ancs.service.control_point_char.handle_value);
+
+    // The magic is the first half-word of the record.
+    m_context_valid = true;
+    m_context[0]   ^= 0xFF;
+    TEST_ASSERT(!ios_ancs_handles_restore(&m_peer, 0));
+    TEST_ASSERT_EQUAL(BLE_GATT_HANDLE_INVALID, m_ios_ancs.service.control_point_char.handle_value);
+
+    // A record of another length, e.g. written by another firmware.
+    memcpy(m_context, record, sizeof(m_context));
+    m_context_len = record_len - 4;
+    TEST_ASSERT(!ios_ancs_handles_restore(&m_peer, 0));
+    TEST_ASSERT_EQUAL(BLE_GATT_HANDLE_INVALID, m_ios_ancs.service.control_point_char.handle_value);
+
+    m_context_len = record_len;
+    TEST_ASSERT(ios_ancs_handles_restore(&m_peer, 0));
+    handles_check();
+    TEST_ASSERT_EQUAL(0, m_ios_ancs.conn_handle);
+
+    // Nothing is stored for a peer that did not bond.
+    stack_init(true);
+    m_peer = unknown;
+    TEST_ASSERT(!connect());
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_run_events(m_conn_handle, RUN_EVENTS));
+    TEST_ASSERT_EQUAL(1, m_fetch_count);
+    TEST_ASSERT_EQUAL(0, m_store_count);
+    disconnect();
+}
+
+
+static void test_service_changed(void)
+{
+    uint8_t const range[4] = {0x01, 0x00, 0xFF, 0xFF};
+    uint16_t      sc_handle;
+    uint16_t      old_cp_handle;
+
+    m_context_valid = false;
+    stack_init(true);
+    sc_handle = m_sc_handle;
+    TEST_ASSERT(!connect());
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_run_events(m_conn_handle, RUN_EVENTS));
+    disconnect();
+    TEST_ASSERT_EQUAL(1, m_store_count);
+    old_cp_handle = m_cp_handle;
+
+    // An update of the phone adds a service before ANCS. The stored handles are used until
+    // the phone indicates the change.
+    phone_db_set(true, true);
+    TEST_ASSERT_EQUAL(sc_handle, m_sc_handle);
+    TEST_ASSERT(m_cp_handle != old_cp_handle);
+
+    TEST_ASSERT(connect());
+    TEST_ASSERT_EQUAL(old_cp_handle, m_ios_ancs.service.control_point_char.handle_value);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS,
+                      ble_sim_peer_hvx(m_conn_handle, m_sc_handle, BLE_GATT_HVX_INDICATION, range, sizeof(range)));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_run_events(m_conn_handle, RUN_EVENTS));
+
+    // Confirmed, dropped and discovered again, then stored with the new handles.
+    TEST_ASSERT_EQUAL(1, m_sc_hvx_count);
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_STATE, sd_ble_gattc_hv_confirm(m_conn_handle, m_sc_handle));
+    TEST_ASSERT_EQUAL(1, m_delete_count);
+    handles_check();
+    TEST_ASSERT_EQUAL(2, m_store_count);
+    TEST_ASSERT(m_context_valid);
+    disconnect();
+
+    // The next connection uses the new record.
+    TEST_ASSERT(connect());
+    handles_check();
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_run_events(m_conn_handle, RUN_EVENTS));
+    TEST_ASSERT_EQUAL(1, m_fetch_count);
+    TEST_ASSERT_EQUAL(2, m_store_count);
+    disconnect();
+}
+
+
+static void test_connect_to_first_fetch(void)
+{
+    uint64_t discovery_us;
+    uint64_t restored_us;
+
+    m_context_valid = false;
+    stack_init(true);
+
+    TEST_ASSERT(!connect());
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_run_events(m_conn_handle, RUN_EVENTS));
+    TEST_ASSERT_EQUAL(1, m_fetch_count);
+    discovery_us = m_first_fetch_us - m_connect_us;
+    disconnect();
+
+    TEST_ASSERT(connect());
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_run_events(m_conn_handle, RUN_EVENTS));
+    TEST_ASSERT_EQUAL(1, m_fetch_count);
+    restored_us = m_first_fetch_us - m_connect_us;
+    disconnect();
+
+    TEST_ASSERT(restored_us < discovery_us);
+
+    printf("connection to first attribute request, %u ms interval\n", CONN_INTERVAL * 5 / 4);
+    printf("  discovery        %6u ms\n", (unsigned)(discovery_us / 1000));
+    printf("  stored handles   %6u ms\n", (unsigned)(restored_us / 1000));
+}
+
+
+int main(void)
+{
+    test_store_after_acks();
+    test_restore_checks();
+    test_service_changed();
+    test_connect_to_first_fetch();
+    TEST_EXIT();
+}
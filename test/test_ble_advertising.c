@@ -0,0 +1,451 @@
+/* Host test of the advertising stages of components/ble/ble_advertising.
+ *
+ * Runs the module on the BLE link simulator with the options of source/main.c, and a phone
+ * that is bonded and then drops out of range. Checks the stages the module goes through while
+ * the phone stays away: directed, fast with the whitelist, fast, then slow with the interval
+ * doubling every BLE_ADV_SLOW_STEP_TIMEOUT. Checks that a phone with a resolvable private
+ * address gets no directed advertising, that a phone which leaves on purpose gets no
+ * reconnection stages, and that the whitelist stage follows the learned reconnection time.
+ * Then prints the time to reconnect and the advertising charge for phones that come back
+ * after a range of delays, against advertising at 62.5 ms until the phone is back.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "unit_test.h"
+#include "app_timer_host.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "ble_sim.h"
+#include "ble_hci.h"
+#include "ble_advertising.h"
+
+#define MSEC_TO_UNITS_1_25(ms)  ((ms) * 4 / 5)
+#define ADV_FAST_INTERVAL       40      // As APP_ADV_FAST_INTERVAL in source/main.c, 25 ms.
+#define ADV_SLOW_INTERVAL       3200    // 2 s.
+#define ADV_FAST_TIMEOUT        180
+#define ADV_SLOW_TIMEOUT        180
+#define DIRECTED_EVENT_US       3750
+#define DIRECTED_US             1280000
+#define LEGACY_INTERVAL_US      62500   // What the firmware advertised at before the stages.
+#define LOG_SIZE                32
+
+
+typedef struct
+{
+    ble_adv_evt_t stage;
+    uint64_t      start_us;     // Since the phone dropped out.
+    uint16_t      interval;
+    uint16_t      timeout;
+} adv_log_t;
+
+extern ble_gap_adv_params_t g_adv_params;
+
+static adv_log_t      m_log[LOG_SIZE];
+static uint32_t       m_log_count;
+static uint32_t       m_whitelist_requests;
+static uint64_t       m_drop_us;
+static uint16_t       m_conn_handle;
+static ble_gap_addr_t m_phone_addr;
+static ble_gap_irk_t  m_phone_irk;
+
+
+void app_error_handler_bare(ret_code_t error_code)
+{
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, error_code);
+}
+
+
+// The module reads the RTC1 counter, which follows the simulated radio time.
+static void timer_sync(void)
+{
+    uint64_t const ticks = (ble_sim_time_us() * APP_TIMER_CLOCK_FREQ) / 1000000;
+
+    if (ticks > app_timer_host_ticks())
+    {
+        app_timer_host_run(ticks - app_timer_host_ticks());
+    }
+}
+
+
+// As ble_evt_dispatch() and on_ble_evt() in source/main.c.
+static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
+{
+    timer_sync();
+    ble_advertising_on_ble_evt(p_ble_evt);
+
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GAP_EVT_CONNECTED:
+            m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            m_conn_handle = BLE_CONN_HANDLE_INVALID;
+            advertising_start();
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+static void on_adv_evt(ble_adv_evt_t const adv_evt)
+{
+    ble_gap_addr_t    * p_addr = &m_phone_addr;
+    ble_gap_irk_t     * p_irk  = &m_phone_irk;
+    ble_gap_whitelist_t whitelist =
+    {
+        .pp_addrs   = &p_addr,
+        .addr_count = 1,
+        .pp_irks    = &p_irk,
+        .irk_count  = 1,
+    };
+
+    switch (adv_evt)
+    {
+        case BLE_ADV_EVT_WHITELIST_REQUEST:
+            m_whitelist_requests++;
+            TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_advertising_whitelist_reply(&whitelist));
+            break;
+
+        case BLE_ADV_EVT_IDLE:
+            break;
+
+        default:
+            TEST_ASSERT(m_log_count < LOG_SIZE);
+            if (m_log_count < LOG_SIZE)
+            {
+                m_log[m_log_count].stage    = adv_evt;
+                m_log[m_log_count].start_us = ble_sim_time_us() - m_drop_us;
+                m_log[m_log_count].interval = g_adv_params.interval;
+                m_log[m_log_count].timeout  = g_adv_params.timeout;
+                m_log_count++;
+            }
+            break;
+    }
+}
+
+
+// Resets the simulator and the module, as the application does after a reset.
+static void adv_init(void)
+{
+    ble_sim_config_t const config   = {.evt_handler = ble_evt_dispatch};
+    ble_enable_params_t    enable   = {0};
+    uint32_t               app_ram_base = 0;
+    ble_advdata_t          advdata  = {0};
+    ble_adv_modes_config_t options  = {0};
+
+    app_timer_host_reset();
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_init(&config));
+    enable.gap_enable_params.periph_conn_count = 1;
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_ble_enable(&enable, &app_ram_base));
+
+    advdata.name_type = BLE_ADVDATA_FULL_NAME;
+    advdata.flags     = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+
+    options.ble_adv_whitelist_enabled = BLE_ADV_WHITELIST_ENABLED;
+    options.ble_adv_directed_enabled  = BLE_ADV_DIRECTED_ENABLED;
+    options.ble_adv_fast_enabled      = BLE_ADV_FAST_ENABLED;
+    options.ble_adv_fast_interval     = ADV_FAST_INTERVAL;
+    options.ble_adv_fast_timeout      = ADV_FAST_TIMEOUT;
+    options.ble_adv_slow_enabled      = BLE_ADV_SLOW_ENABLED;
+    options.ble_adv_slow_interval     = ADV_SLOW_INTERVAL;
+    options.ble_adv_slow_timeout      = ADV_SLOW_TIMEOUT;
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_advertising_init(&advdata, NULL, &options, on_adv_evt, NULL));
+
+    m_log_count          = 0;
+    m_whitelist_requests = 0;
+    m_drop_us            = 0;
+    m_conn_handle        = BLE_CONN_HANDLE_INVALID;
+    memset(&m_phone_irk, 0x5A, sizeof(m_phone_irk));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_peer_addr_set(NULL));
+}
+
+
+static void run_until_us(uint64_t time_us)
+{
+    if (time_us > ble_sim_time_us())
+    {
+        ble_sim_run_for((uint32_t)(time_us - ble_sim_time_us()));
+    }
+    timer_sync();
+}
+
+
+static void phone_connect(void)
+{
+    ble_gap_conn_params_t const params =
+    {
+        .min_conn_interval = MSEC_TO_UNITS_1_25(30),
+        .max_conn_interval = MSEC_TO_UNITS_1_25(30),
+        .slave_latency     = 0,
+        .conn_sup_timeout  = 400,
+    };
+    uint16_t conn_handle;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_peer_connect(&params, &conn_handle));
+    TEST_ASSERT_EQUAL(conn_handle, m_conn_handle);
+    TEST_ASSERT_EQUAL(BLE_ADV_EVT_IDLE, ble_advertising_stage_get());
+}
+
+
+// Encryption with the bonded key; the simulator does not model pairing.
+static void phone_encrypt(void)
+{
+    ble_evt_t evt;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.header.evt_id                                   = BLE_GAP_EVT_CONN_SEC_UPDATE;
+    evt.evt.gap_evt.conn_handle                         = m_conn_handle;
+    evt.evt.gap_evt.params.conn_sec_update.conn_sec.sec_mode.sm = 1;
+    evt.evt.gap_evt.params.conn_sec_update.conn_sec.sec_mode.lv = 2;
+    ble_evt_dispatch(&evt);
+}
+
+
+// The phone connects to fresh advertising unless it is connected, then the link drops for the
+// given reason.
+static void phone_drop(uint8_t addr_type, bool bonded, uint8_t reason)
+{
+    memset(&m_phone_addr, 0, sizeof(m_phone_addr));
+    m_phone_addr.addr_type = addr_type;
+    m_phone_addr.addr[0]   = 0x21;
+    m_phone_addr.addr[5]   = (addr_type == BLE_GAP_ADDR_TYPE_RANDOM_PRIVATE_RESOLVABLE) ? 0x4B : 0xCB;
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_peer_addr_set(&m_phone_addr));
+
+    if (m_conn_handle == BLE_CONN_HANDLE_INVALID)
+    {
+        advertising_start();
+        run_until_us(ble_sim_time_us() + 50000);
+        phone_connect();
+    }
+    if (bonded)
+    {
+        phone_encrypt();
+    }
+    run_until_us(ble_sim_time_us() + 1000000);
+
+    m_log_count          = 0;
+    m_whitelist_requests = 0;
+    m_drop_us            = ble_sim_time_us();
+    ble_sim_stats_reset();
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_peer_disconnect(m_conn_handle, reason));
+    TEST_ASSERT(m_log_count > 0);
+}
+
+
+// The phone is back after_ms after the drop and connects at the next advertising event.
+static void phone_return(uint32_t after_ms)
+{
+    uint32_t log_count;
+
+    run_until_us(m_drop_us + (uint64_t)after_ms * 1000);
+    do
+    {
+        adv_log_t const * p_log    = &m_log[m_log_count - 1];
+        uint64_t const    start_us = m_drop_us + p_log->start_us;
+        uint64_t const    event_us = (p_log->stage == BLE_ADV_EVT_DIRECTED) ?
+                                     DIRECTED_EVENT_US : (uint64_t)p_log->interval * 625;
+        uint64_t const    events   = (ble_sim_time_us() - start_us + event_us - 1) / event_us;
+
+        // A stage that ends first starts the next one, with an event at its start.
+        log_count = m_log_count;
+        run_until_us(start_us + events * event_us);
+    } while (log_count != m_log_count);
+
+    phone_connect();
+}
+
+
+static void stage_check(uint32_t index, ble_adv_evt_t stage, uint32_t start_ms,
+                        uint16_t interval, uint16_t timeout)
+{
+    TEST_ASSERT(index < m_log_count);
+    TEST_ASSERT_EQUAL(stage, m_log[index].stage);
+    TEST_ASSERT_EQUAL((uint64_t)start_ms * 1000, m_log[index].start_us);
+    TEST_ASSERT_EQUAL(interval, m_log[index].interval);
+    TEST_ASSERT_EQUAL(timeout, m_log[index].timeout);
+}
+
+
+// A bonded phone with a static address goes out of range for ten minutes.
+static void test_stages(void)
+{
+    uint32_t const  fast_ms = 1280 + BLE_ADV_WHITELIST_TIMEOUT_INIT * 1000;
+    uint32_t const  slow_ms = fast_ms + ADV_FAST_TIMEOUT * 1000;
+    uint16_t        interval;
+    uint32_t        i;
+    ble_sim_stats_t sim;
+    ble_adv_stats_t before;
+    ble_adv_stats_t stats;
+
+    adv_init();
+    phone_drop(BLE_GAP_ADDR_TYPE_RANDOM_STATIC, true, BLE_HCI_CONNECTION_TIMEOUT);
+    ble_advertising_stats_get(&before);
+
+    stage_check(0, BLE_ADV_EVT_DIRECTED, 0, 0, 0);
+    TEST_ASSERT_MEMORY(&m_phone_addr, g_adv_params.p_peer_addr, sizeof(m_phone_addr));
+
+    run_until_us(m_drop_us + 600000000ULL);
+    stage_check(1, BLE_ADV_EVT_FAST_WHITELIST, 1280, ADV_FAST_INTERVAL, BLE_ADV_WHITELIST_TIMEOUT_INIT);
+    TEST_ASSERT_EQUAL(1, m_whitelist_requests);
+    stage_check(2, BLE_ADV_EVT_FAST, fast_ms, ADV_FAST_INTERVAL, ADV_FAST_TIMEOUT);
+
+    // 50 ms, 100 ms, ... 1.6 s for 30 s each, then 2 s.
+    interval = ADV_FAST_INTERVAL;
+    for (i = 3; 2 * interval < ADV_SLOW_INTERVAL; i++)
+    {
+        interval *= 2;
+        stage_check(i, BLE_ADV_EVT_SLOW, slow_ms + (i - 3) * BLE_ADV_SLOW_STEP_TIMEOUT * 1000,
+                    interval, BLE_ADV_SLOW_STEP_TIMEOUT);
+    }
+    TEST_ASSERT_EQUAL(9, i);
+    stage_check(i, BLE_ADV_EVT_SLOW, slow_ms + 6 * BLE_ADV_SLOW_STEP_TIMEOUT * 1000,
+                ADV_SLOW_INTERVAL, ADV_SLOW_TIMEOUT);
+    stage_check(i + 1, BLE_ADV_EVT_SLOW, slow_ms + (6 * BLE_ADV_SLOW_STEP_TIMEOUT + ADV_SLOW_TIMEOUT) * 1000,
+                ADV_SLOW_INTERVAL, ADV_SLOW_TIMEOUT);
+    TEST_ASSERT_EQUAL(i + 2, m_log_count);
+
+    ble_advertising_stats_get(&stats);
+    TEST_ASSERT(stats.stage_ms[BLE_ADV_EVT_DIRECTED] - 1279 <= 2);
+    TEST_ASSERT(stats.stage_ms[BLE_ADV_EVT_FAST_WHITELIST] - 9999 <= 2);
+    TEST_ASSERT(stats.stage_ms[BLE_ADV_EVT_FAST] - before.stage_ms[BLE_ADV_EVT_FAST] - 179999 <= 2);
+
+    // Back after ten minutes, longer than the RTC1 counter runs before it wraps.
+    phone_return(600000);
+    ble_advertising_stats_get(&stats);
+    TEST_ASSERT_EQUAL(1, stats.reconnects);
+    TEST_ASSERT_EQUAL(BLE_ADV_EVT_SLOW, stats.last_reconnect_stage);
+    TEST_ASSERT(stats.last_reconnect_ms - 599999 <= 2002);
+
+    ble_sim_stats_get(&sim);
+    TEST_ASSERT_EQUAL(DIRECTED_US / DIRECTED_EVENT_US + 1, sim.directed_adv_events);
+}
+
+
+// A phone with a resolvable private address may have moved on to another one.
+static void test_rpa(void)
+{
+    ble_sim_stats_t sim;
+
+    adv_init();
+    phone_drop(BLE_GAP_ADDR_TYPE_RANDOM_PRIVATE_RESOLVABLE, true, BLE_HCI_CONNECTION_TIMEOUT);
+
+    stage_check(0, BLE_ADV_EVT_FAST_WHITELIST, 0, ADV_FAST_INTERVAL, BLE_ADV_WHITELIST_TIMEOUT_INIT);
+    TEST_ASSERT_EQUAL(1, m_whitelist_requests);
+    TEST_ASSERT(g_adv_params.p_peer_addr == NULL);
+    TEST_ASSERT((g_adv_params.p_whitelist != NULL) && (g_adv_params.p_whitelist->irk_count == 1));
+
+    phone_return(500);
+    ble_sim_stats_get(&sim);
+    TEST_ASSERT_EQUAL(0, sim.directed_adv_events);
+}
+
+
+// Nobody to wait for: the phone left on purpose, or never bonded.
+static void test_no_reconnect(void)
+{
+    adv_init();
+    phone_drop(BLE_GAP_ADDR_TYPE_RANDOM_STATIC, true, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+    stage_check(0, BLE_ADV_EVT_FAST, 0, ADV_FAST_INTERVAL, ADV_FAST_TIMEOUT);
+    TEST_ASSERT_EQUAL(0, m_whitelist_requests);
+
+    adv_init();
+    phone_drop(BLE_GAP_ADDR_TYPE_RANDOM_STATIC, false, BLE_HCI_CONNECTION_TIMEOUT);
+    stage_check(0, BLE_ADV_EVT_FAST, 0, ADV_FAST_INTERVAL, ADV_FAST_TIMEOUT);
+    TEST_ASSERT_EQUAL(0, m_whitelist_requests);
+}
+
+
+// A phone that always takes 1.9 s to come back gets a 4 s whitelist stage.
+static void test_learned_timeout(void)
+{
+    ble_adv_stats_t stats;
+
+    adv_init();
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        phone_drop(BLE_GAP_ADDR_TYPE_RANDOM_STATIC, true, BLE_HCI_CONNECTION_TIMEOUT);
+        phone_return(1900);
+        stage_check(1, BLE_ADV_EVT_FAST_WHITELIST, 1280, ADV_FAST_INTERVAL,
+                    (i == 0) ? BLE_ADV_WHITELIST_TIMEOUT_INIT : 4);
+        ble_advertising_stats_get(&stats);
+        TEST_ASSERT_EQUAL(i + 1, stats.reconnects);
+        TEST_ASSERT_EQUAL(BLE_ADV_EVT_FAST_WHITELIST, stats.last_reconnect_stage);
+        TEST_ASSERT(stats.learned_reconnect_ms - 1900 <= 25);
+    }
+}
+
+
+static char const * stage_name(ble_adv_evt_t stage)
+{
+    switch (stage)
+    {
+        case BLE_ADV_EVT_DIRECTED:       return "directed";
+        case BLE_ADV_EVT_FAST_WHITELIST: return "whitelist";
+        case BLE_ADV_EVT_FAST:           return "fast";
+        case BLE_ADV_EVT_SLOW:           return "slow";
+        default:                         return "-";
+    }
+}
+
+
+// Time to reconnect and charge, per delay before the phone is back in range.
+static void bench_reconnect(void)
+{
+    static uint32_t const after_ms[] = {200, 1000, 3000, 8000, 20000, 60000, 240000, 600000, 1800000};
+    ble_adv_stats_t stats;
+    ble_sim_stats_t sim;
+    uint32_t        sim_uc;
+    uint32_t        latency_ms;
+    uint32_t        legacy_events;
+
+    printf("back after s  stage      reconnect ms  charge uC  simulated uC   62.5 ms: reconnect ms  charge uC\n");
+    for (uint32_t i = 0; i < sizeof(after_ms) / sizeof(after_ms[0]); i++)
+    {
+        adv_init();
+        phone_drop(BLE_GAP_ADDR_TYPE_RANDOM_STATIC, true, BLE_HCI_CONNECTION_TIMEOUT);
+        phone_return(after_ms[i]);
+
+        ble_advertising_stats_get(&stats);
+        ble_sim_stats_get(&sim);
+        sim_uc = (sim.directed_adv_events * BLE_ADV_DIRECTED_EVENT_CHARGE_NC +
+                  sim.adv_events * BLE_ADV_EVENT_CHARGE_NC) / 1000;
+        legacy_events = (after_ms[i] * 1000 + LEGACY_INTERVAL_US - 1) / LEGACY_INTERVAL_US;
+
+        printf("%12.1f  %-9s  %12u  %9u  %12u   %21u  %9u\n",
+               after_ms[i] / 1000.0, stage_name(stats.last_reconnect_stage),
+               stats.last_reconnect_ms, stats.last_reconnect_charge_uc, sim_uc,
+               legacy_events * LEGACY_INTERVAL_US / 1000,
+               ((legacy_events + 1) * BLE_ADV_EVENT_CHARGE_NC) / 1000);
+
+        // The estimate leaves out the event at the start of each stage.
+        TEST_ASSERT(stats.last_reconnect_charge_uc <= sim_uc);
+        TEST_ASSERT(sim_uc - stats.last_reconnect_charge_uc <= m_log_count * 10);
+
+        // Until slow advertising, a phone that is back finds the device within 25 ms.
+        latency_ms = (uint32_t)((ble_sim_time_us() - m_drop_us) / 1000) - after_ms[i];
+        if (after_ms[i] < 1280 + BLE_ADV_WHITELIST_TIMEOUT_INIT * 1000 + ADV_FAST_TIMEOUT * 1000)
+        {
+            TEST_ASSERT(latency_ms <= ADV_FAST_INTERVAL * 625 / 1000);
+        }
+        else if (after_ms[i] >= 1800000)
+        {
+            TEST_ASSERT(sim_uc < ((legacy_events + 1) * BLE_ADV_EVENT_CHARGE_NC) / 1000);
+        }
+    }
+}
+
+
+int main(void)
+{
+    test_stages();
+    test_rpa();
+    test_no_reconnect();
+    test_learned_timeout();
+    bench_reconnect();
+    TEST_EXIT();
+}
@@ -0,0 +1,605 @@
+/* Host test of the BLE link simulator.
+ *
+ * Drives the simulated SoftDevice the way the application does: one service with a notify
+ * and an indicate characteristic, advertising, a phone that connects and enables the CCCDs.
+ * Checks notification flow control, the one outstanding indication, connection parameter
+ * updates at the instant, the advertising and supervision timeouts, and that packet loss is
+ * repeatable for a given seed. Then runs two sessions at once, as the link table in
+ * source/channel_select.c would with a SoftDevice that allows two peripheral links. Last,
+ * discovers the phone's GATT server with the GATT client API, writes its CCCD and receives
+ * its indications.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "unit_test.h"
+#include "ble_sim.h"
+#include "ble_hci.h"
+
+#define MSEC_TO_UNITS_1_25(ms)  ((ms) * 4 / 5)
+#define CONN_INTERVAL           MSEC_TO_UNITS_1_25(30)
+#define SUP_TIMEOUT_10MS        (400)   // 4 s.
+#define NOTIFY_LEN              (20)    // Fills one packet at the default ATT MTU.
+
+
+static uint16_t m_conn_handle;          // Latest link.
+static uint16_t m_notify_handle;
+static uint16_t m_indicate_handle;
+static uint32_t m_sent[BLE_SIM_LINK_COUNT];     // Notifications queued by the application.
+static uint32_t m_received[BLE_SIM_LINK_COUNT]; // Notifications seen by the peer, checked for order.
+static bool     m_streaming;
+static uint8_t  m_sessions;             // Links streaming at once.
+static uint8_t  m_first_session;
+static uint32_t m_hvc_count;
+static uint32_t m_write_count;
+static uint32_t m_timeout_count;
+static uint8_t  m_disconnect_reason;
+static uint16_t m_update_interval;
+static uint32_t m_gattc_evt[(sizeof(ble_evt_t) + 64) / 4];     // Latest GATT client event.
+static uint32_t m_gattc_count;
+static uint32_t m_hvx_count;
+static uint16_t m_peer_write_handle;
+static uint16_t m_peer_write_len;
+
+
+static bool notification_send(uint16_t conn_handle)
+{
+    uint8_t                data[NOTIFY_LEN] = {0};
+    uint16_t               len              = sizeof(data);
+    ble_gatts_hvx_params_t hvx              =
+    {
+        .handle = m_notify_handle,
+        .type   = BLE_GATT_HVX_NOTIFICATION,
+        .p_len  = &len,
+        .p_data = data,
+    };
+
+    memcpy(data, &m_sent[conn_handle], sizeof(m_sent[conn_handle]));
+    if (sd_ble_gatts_hvx(conn_handle, &hvx) != NRF_SUCCESS)
+    {
+        return false;
+    }
+    m_sent[conn_handle]++;
+
+    return true;
+}
+
+
+static void notifications_queue(void)
+{
+    while (notification_send(m_conn_handle))
+    {
+    }
+}
+
+
+// One notification per session per pass, starting from a rotating session, as the main loop
+// sends one frame per link per pass.
+static void sessions_queue(void)
+{
+    bool sent;
+
+    do
+    {
+        sent = false;
+        for (uint8_t i = 0; i < m_sessions; i++)
+        {
+            sent |= notification_send((m_first_session + i) % m_sessions);
+        }
+        m_first_session = (m_first_session + 1) % m_sessions;
+    } while (sent);
+}
+
+
+static void ble_evt_handler(ble_evt_t * p_ble_evt)
+{
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GAP_EVT_CONNECTED:
+            m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+            TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_ble_gatts_sys_attr_set(m_conn_handle, NULL, 0, 0));
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            m_disconnect_reason = p_ble_evt->evt.gap_evt.params.disconnected.reason;
+            m_conn_handle       = BLE_CONN_HANDLE_INVALID;
+            break;
+
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+            m_update_interval = p_ble_evt->evt.gap_evt.params.conn_param_update.conn_params.max_conn_interval;
+            break;
+
+        case BLE_GAP_EVT_TIMEOUT:
+            m_timeout_count++;
+            break;
+
+        case BLE_GATTS_EVT_WRITE:
+            m_write_count++;
+            break;
+
+        case BLE_GATTS_EVT_HVC:
+            m_hvc_count++;
+            break;
+
+        case BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP:
+        case BLE_GATTC_EVT_CHAR_DISC_RSP:
+        case BLE_GATTC_EVT_DESC_DISC_RSP:
+        case BLE_GATTC_EVT_WRITE_RSP:
+        case BLE_GATTC_EVT_HVX:
+            TEST_ASSERT(p_ble_evt->header.evt_len <= sizeof(m_gattc_evt));
+            memcpy(m_gattc_evt, p_ble_evt, p_ble_evt->header.evt_len);
+            m_gattc_count++;
+            m_hvx_count += (p_ble_evt->header.evt_id == BLE_GATTC_EVT_HVX) ? 1 : 0;
+            break;
+
+        case BLE_EVT_TX_COMPLETE:
+            if (m_streaming && (m_sessions > 1))
+            {
+                sessions_queue();
+            }
+            else if (m_streaming)
+            {
+                notifications_queue();
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+static void peer_rx_handler(uint16_t conn_handle, uint16_t handle, uint8_t type,
+                            uint8_t const * p_data, uint16_t len)
+{
+    uint32_t seq;
+
+    if (type != BLE_GATT_HVX_NOTIFICATION)
+    {
+        return;
+    }
+
+    TEST_ASSERT_EQUAL(m_notify_handle, handle);
+    TEST_ASSERT_EQUAL(NOTIFY_LEN, len);
+    memcpy(&seq, p_data, sizeof(seq));
+    TEST_ASSERT_EQUAL(m_received[conn_handle], seq);
+    m_received[conn_handle]++;
+}
+
+
+static void peer_write_handler(uint16_t conn_handle, uint16_t handle, uint8_t write_op,
+                               uint8_t const * p_data, uint16_t len)
+{
+    TEST_ASSERT_EQUAL(BLE_GATT_OP_WRITE_REQ, write_op);
+    m_peer_write_handle = handle;
+    m_peer_write_len    = len;
+}
+
+
+static uint16_t characteristic_add(uint16_t service_handle, uint16_t uuid16, bool indicate)
+{
+    static uint8_t           value[NOTIFY_LEN];
+    ble_uuid_t               uuid    = {uuid16, BLE_UUID_TYPE_BLE};
+    ble_gatts_char_md_t      char_md = {0};
+    ble_gatts_attr_md_t      cccd_md = {0};
+    ble_gatts_attr_md_t      attr_md = {0};
+    ble_gatts_attr_t         attr    = {0};
+    ble_gatts_char_handles_t handles;
+
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.write_perm);
+    cccd_md.vloc = BLE_GATTS_VLOC_STACK;
+
+    char_md.char_props.notify   = !indicate;
+    char_md.char_props.indicate = indicate;
+    char_md.p_cccd_md           = &cccd_md;
+
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&attr_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&attr_md.write_perm);
+    attr_md.vloc = BLE_GATTS_VLOC_STACK;
+
+    attr.p_uuid    = &uuid;
+    attr.p_attr_md = &attr_md;
+    attr.init_len  = sizeof(value);
+    attr.max_len   = sizeof(value);
+    attr.p_value   = value;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS,
+                      sd_ble_gatts_characteristic_add(service_handle, &char_md, &attr, &handles));
+
+    return handles.value_handle;
+}
+
+
+// Resets the simulator and builds the services, as the application does after a reset.
+static void stack_init(uint32_t seed, uint16_t loss_permille, uint8_t links)
+{
+    ble_sim_config_t const config =
+    {
+        .evt_handler        = ble_evt_handler,
+        .peer_rx_handler    = peer_rx_handler,
+        .peer_write_handler = peer_write_handler,
+        .seed               = seed,
+        .loss_permille      = loss_permille,
+    };
+    ble_enable_params_t    enable = {0};
+    uint32_t               app_ram_base = 0;
+    ble_uuid_t             uuid   = {0x180D, BLE_UUID_TYPE_BLE};
+    uint16_t               service_handle;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_init(&config));
+
+    enable.gap_enable_params.periph_conn_count = links;
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_ble_enable(&enable, &app_ram_base));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS,
+                      sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY, &uuid, &service_handle));
+
+    m_notify_handle   = characteristic_add(service_handle, 0x2A37, false);
+    m_indicate_handle = characteristic_add(service_handle, 0x2A38, true);
+
+    m_conn_handle       = BLE_CONN_HANDLE_INVALID;
+    memset(m_sent, 0, sizeof(m_sent));
+    memset(m_received, 0, sizeof(m_received));
+    m_streaming         = false;
+    m_sessions          = 1;
+    m_first_session     = 0;
+    m_hvc_count         = 0;
+    m_write_count       = 0;
+    m_timeout_count     = 0;
+    m_disconnect_reason = 0;
+    m_update_interval   = 0;
+    m_gattc_count       = 0;
+    m_hvx_count         = 0;
+    m_peer_write_handle = BLE_GATT_HANDLE_INVALID;
+    m_peer_write_len    = 0;
+}
+
+
+static void advertise(uint16_t timeout_s)
+{
+    ble_gap_adv_params_t adv =
+    {
+        .type     = BLE_GAP_ADV_TYPE_ADV_IND,
+        .interval = 160,    // 100 ms.
+        .timeout  = timeout_s,
+    };
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_ble_gap_adv_start(&adv));
+}
+
+
+static void connect(void)
+{
+    ble_gap_conn_params_t const params =
+    {
+        .min_conn_interval = CONN_INTERVAL,
+        .max_conn_interval = CONN_INTERVAL,
+        .slave_latency     = 0,
+        .conn_sup_timeout  = SUP_TIMEOUT_10MS,
+    };
+    uint16_t       conn_handle;
+    uint32_t const write_count = m_write_count;
+
+    advertise(0);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_peer_connect(&params, &conn_handle));
+    TEST_ASSERT_EQUAL(conn_handle, m_conn_handle);
+    TEST_ASSERT(!ble_sim_is_advertising());
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS,
+                      ble_sim_peer_cccd_write(m_conn_handle, m_notify_handle, BLE_GATT_HVX_NOTIFICATION));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS,
+                      ble_sim_peer_cccd_write(m_conn_handle, m_indicate_handle, BLE_GATT_HVX_INDICATION));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_run_events(m_conn_handle, 4));
+    TEST_ASSERT_EQUAL(write_count + 2, m_write_count);
+}
+
+
+static void test_notification_flow(void)
+{
+    ble_sim_stats_t stats;
+
+    stack_init(1, 0, 1);
+    connect();
+    ble_sim_stats_reset();
+
+    // Keep the TX buffers full for one second.
+    m_streaming = true;
+    notifications_queue();
+    TEST_ASSERT_EQUAL(7, m_sent[m_conn_handle]);
+    TEST_ASSERT_EQUAL(7, ble_sim_tx_queued(m_conn_handle));
+    ble_sim_run_for(1000000);
+    m_streaming = false;
+
+    ble_sim_stats_get(&stats);
+    printf("30 ms interval, 1 s: %u events, %u notifications, %u bytes\n",
+           stats.conn_events, stats.notifications, stats.bytes_to_peer);
+
+    // Six packets per event, every buffer refilled at TX complete, none lost.
+    TEST_ASSERT_EQUAL(1000000 / 30000, stats.conn_events);
+    TEST_ASSERT_EQUAL(6 * stats.conn_events, stats.notifications);
+    TEST_ASSERT_EQUAL(stats.notifications, m_received[m_conn_handle]);
+    TEST_ASSERT_EQUAL(m_sent[m_conn_handle], m_received[m_conn_handle] + ble_sim_tx_queued(m_conn_handle));
+    TEST_ASSERT_EQUAL(NOTIFY_LEN * stats.notifications, stats.bytes_to_peer);
+    TEST_ASSERT(stats.no_tx_packets > 0);
+}
+
+
+static void test_indication(void)
+{
+    uint8_t                data[4] = {1, 2, 3, 4};
+    uint16_t               len     = sizeof(data);
+    ble_gatts_hvx_params_t hvx     =
+    {
+        .handle = m_indicate_handle,
+        .type   = BLE_GATT_HVX_INDICATION,
+        .p_len  = &len,
+        .p_data = data,
+    };
+
+    stack_init(1, 0, 1);
+    connect();
+
+    // Only one indication may be outstanding until the peer confirms it.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_ble_gatts_hvx(m_conn_handle, &hvx));
+    TEST_ASSERT_EQUAL(NRF_ERROR_BUSY, sd_ble_gatts_hvx(m_conn_handle, &hvx));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_run_events(m_conn_handle, 3));
+    TEST_ASSERT_EQUAL(1, m_hvc_count);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_ble_gatts_hvx(m_conn_handle, &hvx));
+}
+
+
+static void test_conn_param_update(void)
+{
+    ble_gap_conn_params_t const request =
+    {
+        .min_conn_interval = MSEC_TO_UNITS_1_25(10),
+        .max_conn_interval = MSEC_TO_UNITS_1_25(20),
+        .slave_latency     = 0,
+        .conn_sup_timeout  = SUP_TIMEOUT_10MS,
+    };
+    ble_gap_conn_params_t params;
+
+    stack_init(1, 0, 1);
+    connect();
+
+    // The peer picks its shortest interval, 15 ms, at the instant.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_ble_gap_conn_param_update(m_conn_handle, &request));
+    TEST_ASSERT_EQUAL(NRF_ERROR_BUSY, sd_ble_gap_conn_param_update(m_conn_handle, &request));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_run_events(m_conn_handle, BLE_SIM_CONN_PARAM_INSTANT));
+    TEST_ASSERT_EQUAL(0, m_update_interval);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_run_events(m_conn_handle, 1));
+    TEST_ASSERT_EQUAL(12, m_update_interval);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_conn_params_get(m_conn_handle, &params));
+    TEST_ASSERT_EQUAL(12, params.max_conn_interval);
+}
+
+
+static void test_timeouts(void)
+{
+    ble_sim_stats_t stats;
+
+    // Advertising stops after its timeout, having sent one event per interval.
+    stack_init(1, 0, 1);
+    advertise(2);
+    ble_sim_run_for(1999000);
+    TEST_ASSERT(ble_sim_is_advertising());
+    ble_sim_run_for(2000);
+    TEST_ASSERT(!ble_sim_is_advertising());
+    TEST_ASSERT_EQUAL(1, m_timeout_count);
+    ble_sim_stats_get(&stats);
+    TEST_ASSERT_EQUAL(2000000 / 100000 + 1, stats.adv_events);
+
+    // A link which loses every packet ends at the supervision timeout.
+    connect();
+    ble_sim_loss_set(1000);
+    ble_sim_run_for(SUP_TIMEOUT_10MS * 10000 - 30000);
+    TEST_ASSERT(m_conn_handle != BLE_CONN_HANDLE_INVALID);
+    ble_sim_run_for(2 * 30000);
+    TEST_ASSERT_EQUAL(BLE_CONN_HANDLE_INVALID, m_conn_handle);
+    TEST_ASSERT_EQUAL(BLE_HCI_CONNECTION_TIMEOUT, m_disconnect_reason);
+    ble_sim_stats_get(&stats);
+    TEST_ASSERT_EQUAL(1, stats.supervision_timeouts);
+}
+
+
+// Streams for one second with 10 % of the exchanges lost.
+static void lossy_run(uint32_t seed, ble_sim_stats_t * p_stats)
+{
+    stack_init(seed, 100, 1);
+    connect();
+    ble_sim_stats_reset();
+
+    m_streaming = true;
+    notifications_queue();
+    ble_sim_run_for(1000000);
+    m_streaming = false;
+
+    ble_sim_stats_get(p_stats);
+}
+
+
+static void test_loss_repeatable(void)
+{
+    ble_sim_stats_t first;
+    ble_sim_stats_t second;
+    ble_sim_stats_t other;
+
+    lossy_run(7, &first);
+    lossy_run(7, &second);
+    lossy_run(8, &other);
+
+    printf("10 %% loss, 1 s: %u notifications, %u exchanges lost\n",
+           first.notifications, first.lost_exchanges);
+
+    TEST_ASSERT(first.lost_exchanges > 0);
+    TEST_ASSERT(first.notifications < 6 * first.conn_events);
+    TEST_ASSERT_MEMORY(&first, &second, sizeof(first));
+    TEST_ASSERT(memcmp(&first, &other, sizeof(first)) != 0);
+}
+
+
+// Two phones streaming at once, one notification per link per pass. Each link keeps the rate
+// of a single session. The model gives each link its own radio time, so the aggregate is an
+// upper bound for two links on one radio.
+static void test_two_sessions(void)
+{
+    ble_sim_stats_t      stats;
+    ble_sim_link_stats_t link[2];
+
+    stack_init(1, 0, 2);
+    connect();
+    connect();
+    TEST_ASSERT_EQUAL(1, m_conn_handle);
+
+    // No advertising for a third phone.
+    {
+        ble_gap_adv_params_t adv = { .type = BLE_GAP_ADV_TYPE_ADV_IND, .interval = 160 };
+
+        TEST_ASSERT_EQUAL(NRF_ERROR_CONN_COUNT, sd_ble_gap_adv_start(&adv));
+    }
+
+    ble_sim_stats_reset();
+    m_sessions  = 2;
+    m_streaming = true;
+    sessions_queue();
+    ble_sim_run_for(1000000);
+    m_streaming = false;
+
+    ble_sim_stats_get(&stats);
+    for (uint16_t i = 0; i < 2; i++)
+    {
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_link_stats_get(i, &link[i]));
+        printf("link %u, 1 s: %u events, %u notifications, %u bytes\n",
+               i, link[i].conn_events, link[i].notifications, link[i].bytes_to_peer);
+
+        TEST_ASSERT_EQUAL(1000000 / 30000, link[i].conn_events);
+        TEST_ASSERT_EQUAL(6 * link[i].conn_events, link[i].notifications);
+        TEST_ASSERT_EQUAL(link[i].notifications, m_received[i]);
+        TEST_ASSERT_EQUAL(m_sent[i], m_received[i] + ble_sim_tx_queued(i));
+    }
+    printf("both links, 1 s: %u notifications, %u bytes\n", stats.notifications, stats.bytes_to_peer);
+
+    TEST_ASSERT_EQUAL(link[0].notifications + link[1].notifications, stats.notifications);
+    TEST_ASSERT_EQUAL(link[0].bytes_to_peer + link[1].bytes_to_peer, stats.bytes_to_peer);
+}
+
+
+// Runs one GATT client procedure, which takes two connection events, and returns its response.
+static ble_gattc_evt_t const * gattc_run(void)
+{
+    uint32_t const count = m_gattc_count;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_run_events(m_conn_handle, 2));
+    TEST_ASSERT_EQUAL(count + 1, m_gattc_count);
+
+    return &((ble_evt_t const *)m_gattc_evt)->evt.gattc_evt;
+}
+
+
+static void test_peer_server(void)
+{
+    ble_uuid_t const          hrs_uuid = {0x180D, BLE_UUID_TYPE_BLE};
+    ble_uuid_t const          hrm_uuid = {0x2A37, BLE_UUID_TYPE_BLE};
+    ble_sim_peer_char_t const chars[]  =
+    {
+        {hrm_uuid, {.notify = 1}},
+        {{0x2A39, BLE_UUID_TYPE_BLE}, {.write = 1}},
+    };
+    ble_sim_peer_service_t const service = {hrs_uuid, chars, 2};
+    ble_gattc_handle_range_t     range   = {1, 0xFFFF};
+    uint8_t                      cccd[2] = {BLE_GATT_HVX_INDICATION, 0};
+    ble_gattc_write_params_t     write   =
+    {
+        .write_op = BLE_GATT_OP_WRITE_REQ,
+        .len      = sizeof(cccd),
+        .p_value  = cccd,
+    };
+    ble_gattc_evt_t const      * p_rsp;
+    uint16_t                     value_handle;
+    uint16_t                     cccd_handle;
+
+    stack_init(1, 0, 1);
+    connect();
+
+    // Without services the server answers with an ATT error.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_ble_gattc_primary_services_discover(m_conn_handle, 1, &hrs_uuid));
+    TEST_ASSERT_EQUAL(NRF_ERROR_BUSY, sd_ble_gattc_primary_services_discover(m_conn_handle, 1, &hrs_uuid));
+    p_rsp = gattc_run();
+    TEST_ASSERT_EQUAL(BLE_GATT_STATUS_ATTERR_ATTRIBUTE_NOT_FOUND, p_rsp->gatt_status);
+
+    // Declaration, value and CCCD of the measurement, declaration and value of the control point.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_peer_db_set(&service, 1));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_peer_char_handles_get(&hrm_uuid, &value_handle, &cccd_handle));
+    TEST_ASSERT_EQUAL(3, value_handle);
+    TEST_ASSERT_EQUAL(4, cccd_handle);
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_ble_gattc_primary_services_discover(m_conn_handle, 1, &hrs_uuid));
+    p_rsp = gattc_run();
+    TEST_ASSERT_EQUAL(BLE_GATT_STATUS_SUCCESS, p_rsp->gatt_status);
+    TEST_ASSERT_EQUAL(1, p_rsp->params.prim_srvc_disc_rsp.count);
+    TEST_ASSERT_EQUAL(1, p_rsp->params.prim_srvc_disc_rsp.services[0].handle_range.start_handle);
+    TEST_ASSERT_EQUAL(6, p_rsp->params.prim_srvc_disc_rsp.services[0].handle_range.end_handle);
+
+    // Both 16-bit characteristics fit in one response.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_ble_gattc_characteristics_discover(m_conn_handle, &range));
+    p_rsp = gattc_run();
+    TEST_ASSERT_EQUAL(2, p_rsp->params.char_disc_rsp.count);
+    TEST_ASSERT_EQUAL(3, p_rsp->params.char_disc_rsp.chars[0].handle_value);
+    TEST_ASSERT(p_rsp->params.char_disc_rsp.chars[0].char_props.notify);
+    TEST_ASSERT_EQUAL(0x2A39, p_rsp->params.char_disc_rsp.chars[1].uuid.uuid);
+    TEST_ASSERT_EQUAL(6, p_rsp->params.char_disc_rsp.chars[1].handle_value);
+
+    range.start_handle = 4;
+    range.end_handle   = 4;
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_ble_gattc_descriptors_discover(m_conn_handle, &range));
+    p_rsp = gattc_run();
+    TEST_ASSERT_EQUAL(1, p_rsp->params.desc_disc_rsp.count);
+    TEST_ASSERT_EQUAL(BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG, p_rsp->params.desc_disc_rsp.descs[0].uuid.uuid);
+
+    // The server takes the CCCD write, and refuses one to a declaration.
+    write.handle = cccd_handle;
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_ble_gattc_write(m_conn_handle, &write));
+    p_rsp = gattc_run();
+    TEST_ASSERT_EQUAL(BLE_GATT_STATUS_SUCCESS, p_rsp->gatt_status);
+    TEST_ASSERT_EQUAL(cccd_handle, p_rsp->params.write_rsp.handle);
+    TEST_ASSERT_EQUAL(cccd_handle, m_peer_write_handle);
+    TEST_ASSERT_EQUAL(sizeof(cccd), m_peer_write_len);
+
+    write.handle = 2;
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_ble_gattc_write(m_conn_handle, &write));
+    p_rsp = gattc_run();
+    TEST_ASSERT_EQUAL(BLE_GATT_STATUS_ATTERR_WRITE_NOT_PERMITTED, p_rsp->gatt_status);
+    TEST_ASSERT_EQUAL(cccd_handle, m_peer_write_handle);
+
+    // The second indication waits for the confirmation of the first.
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_STATE, sd_ble_gattc_hv_confirm(m_conn_handle, value_handle));
+    TEST_ASSERT_EQUAL(BLE_ERROR_INVALID_ATTR_HANDLE,
+                      ble_sim_peer_hvx(m_conn_handle, cccd_handle, BLE_GATT_HVX_INDICATION, cccd, 1));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_peer_hvx(m_conn_handle, value_handle, BLE_GATT_HVX_INDICATION, cccd, 1));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_peer_hvx(m_conn_handle, value_handle, BLE_GATT_HVX_INDICATION, cccd, 2));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_run_events(m_conn_handle, 3));
+    TEST_ASSERT_EQUAL(1, m_hvx_count);
+    p_rsp = &((ble_evt_t const *)m_gattc_evt)->evt.gattc_evt;
+    TEST_ASSERT_EQUAL(value_handle, p_rsp->params.hvx.handle);
+    TEST_ASSERT_EQUAL(1, p_rsp->params.hvx.len);
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_ble_gattc_hv_confirm(m_conn_handle, value_handle));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_STATE, sd_ble_gattc_hv_confirm(m_conn_handle, value_handle));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_sim_run_events(m_conn_handle, 2));
+    TEST_ASSERT_EQUAL(2, m_hvx_count);
+    TEST_ASSERT_EQUAL(2, p_rsp->params.hvx.len);
+}
+
+
+int main(void)
+{
+    test_notification_flow();
+    test_indication();
+    test_conn_param_update();
+    test_timeouts();
+    test_loss_repeatable();
+    test_two_sessions();
+    test_peer_server();
+    TEST_EXIT();
+}
@@ -0,0 +1,499 @@
+/* Host test of the motion-gated deep idle of source/deep_idle.c.
+ *
+ * The accelerometer, advertising, scan response, link count, PPG and fds are played by the
+ * test. Checks when deep idle is entered and left: after DEEP_IDLE_STILL_MIN still minutes,
+ * not with a link up or a measurement running, again later when the accelerometer cannot be
+ * switched, once per burst of wake-ups. Then runs three days minute by minute through the
+ * minute handling of main.c: worn with a still stretch of sleep, off the wrist at night and in
+ * a drawer, each ended by a movement the next midnight. Checks that sleep staging is fed every
+ * minute in order, the idle ones filled in on wake-up, and prints the average current of a model of the band with and
+ * without deep idle.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "unit_test.h"
+#include "nrf_error.h"
+#include "app_scheduler.h"
+#include "fds.h"
+#include "motion.h"
+#include "deep_idle.h"
+
+#define DAY_MIN             (1440)
+#define DAY_START           (17000UL * 86400)           // Any midnight.
+#define SCHED_QUEUE_SIZE    (4)
+
+// Current model, in uA or uC per event. Orders of magnitude from the datasheets.
+#define I_BASE_UA           (2.5)       // System ON with RTC1 and LFXO, RAM retained.
+#define I_ACC_STREAM_UA     (11.0)      // LIS3DH at 25 Hz, high resolution.
+#define I_ACC_WAKE_UA       (3.0)       // LIS3DH at 10 Hz, low power, wake-on-motion.
+#define Q_DRAIN_UC          (3.0)       // One FIFO drain and the step and sleep code, every second.
+#define Q_ADV_UC            (9.0)       // One connectable advertising event.
+#define ADV_SLOW_SEC        (2.0)
+#define ADV_IDLE_SEC        (10.24)
+#define Q_SUMMARY_UC        (0.05)      // One scan response refresh, every minute.
+#define I_LINK_UA           (60.0)      // A link up at a 30 ms interval, with sync traffic.
+
+
+typedef struct
+{
+    char const * p_name;
+    uint16_t     activity[DAY_MIN];
+    bool         link[DAY_MIN];
+} day_t;
+
+typedef enum
+{
+    STILL,                              // On a table.
+    ASLEEP,                             // On the wrist, with small movements.
+    DESK,
+    WALKING,
+} wear_t;
+
+
+static uint32_t m_now;
+static uint32_t m_seed;
+
+static uint8_t               m_links;
+static bool                  m_ppg_running;
+static bool                  m_adv_idle;
+static bool                  m_summary_suspended;
+static bool                  m_streaming;
+static uint32_t              m_wake_error;
+static uint32_t              m_flushes;
+static motion_wake_handler_t m_wake_handler;
+
+static app_sched_event_handler_t m_sched_handler[SCHED_QUEUE_SIZE];
+static uint8_t                   m_sched_data[SCHED_QUEUE_SIZE];
+static uint32_t                  m_sched_count;
+
+// What sleep staging is fed.
+static uint32_t m_fed_last;
+static uint32_t m_fed_count;
+static uint32_t m_fed_filled;
+static uint32_t m_fed_gaps;
+static uint32_t m_fed_disorder;
+static uint32_t m_minute_fed;
+
+
+// What the other modules provide on target.
+uint32_t app_sched_event_put(void * p_event_data, uint16_t event_size, app_sched_event_handler_t handler)
+{
+    TEST_ASSERT(m_sched_count < SCHED_QUEUE_SIZE);
+    TEST_ASSERT_EQUAL(1, event_size);
+    m_sched_data[m_sched_count]      = *(uint8_t *)p_event_data;
+    m_sched_handler[m_sched_count++] = handler;
+    return NRF_SUCCESS;
+}
+
+
+void app_sched_execute(void)
+{
+    for (uint32_t i = 0; i < m_sched_count; i++)
+    {
+        m_sched_handler[i](&m_sched_data[i], 1);
+    }
+    m_sched_count = 0;
+}
+
+
+unsigned int system_sec_get(void)
+{
+    return m_now;
+}
+
+
+uint8_t link_count(void)
+{
+    return m_links;
+}
+
+
+bool ppg_is_running(void)
+{
+    return m_ppg_running;
+}
+
+
+void ble_advertising_idle_set(bool idle)
+{
+    m_adv_idle = idle;
+}
+
+
+void adv_summary_suspend(bool suspend)
+{
+    m_summary_suspended = suspend;
+}
+
+
+ret_code_t fds_flush(void)
+{
+    m_flushes++;
+    return FDS_SUCCESS;
+}
+
+
+uint32_t motion_wake_enable(motion_wake_handler_t handler)
+{
+    if (m_wake_error != NRF_SUCCESS)
+    {
+        return m_wake_error;
+    }
+    m_wake_handler = handler;
+    m_streaming    = false;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t motion_stream_resume(void)
+{
+    m_wake_handler = NULL;
+    m_streaming    = true;
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t random_below(uint32_t n)
+{
+    m_seed = m_seed * 1103515245 + 12345;
+    return (m_seed >> 16) % n;
+}
+
+
+static void band_reset(void)
+{
+    m_now               = DAY_START;
+    m_links             = 0;
+    m_ppg_running       = false;
+    m_adv_idle          = false;
+    m_summary_suspended = false;
+    m_streaming         = true;
+    m_wake_error        = NRF_SUCCESS;
+    m_flushes           = 0;
+    m_wake_handler      = NULL;
+    m_sched_count       = 0;
+    deep_idle_init();
+}
+
+
+static void still_minutes(uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        m_now += 60;
+        deep_idle_minute(0);
+    }
+}
+
+
+static void test_enter_exit(void)
+{
+    deep_idle_stats_st stats;
+
+    band_reset();
+
+    // One minute short, then a movement starts the count over.
+    still_minutes(DEEP_IDLE_STILL_MIN - 1);
+    deep_idle_minute(DEEP_IDLE_STILL_ACTIVITY + 1);
+    still_minutes(DEEP_IDLE_STILL_MIN - 1);
+    TEST_ASSERT(!deep_idle_active());
+    TEST_ASSERT(m_streaming);
+
+    // Not while a phone is connected or a measurement runs; the next free minute enters.
+    m_links = 1;
+    still_minutes(5);
+    TEST_ASSERT(!deep_idle_active());
+    m_links       = 0;
+    m_ppg_running = true;
+    still_minutes(1);
+    TEST_ASSERT(!deep_idle_active());
+    m_ppg_running = false;
+    still_minutes(1);
+    TEST_ASSERT(deep_idle_active());
+    TEST_ASSERT(!m_streaming);
+    TEST_ASSERT(m_adv_idle);
+    TEST_ASSERT(m_summary_suspended);
+    TEST_ASSERT_EQUAL(1, m_flushes);
+
+    // Minutes in deep idle are not counted.
+    still_minutes(10);
+    TEST_ASSERT(deep_idle_active());
+
+    // A burst of interrupts posts one exit, which restores everything in the main loop.
+    m_now += 30;
+    m_wake_handler();
+    m_wake_handler();
+    deep_idle_wake(DEEP_IDLE_WAKE_LINK);
+    TEST_ASSERT_EQUAL(1, m_sched_count);
+    TEST_ASSERT(deep_idle_active());
+    app_sched_execute();
+    TEST_ASSERT(!deep_idle_active());
+    TEST_ASSERT(m_streaming);
+    TEST_ASSERT(!m_adv_idle);
+    TEST_ASSERT(!m_summary_suspended);
+
+    // The minutes wholly inside the idle stretch are covered, not the ones at its ends.
+    TEST_ASSERT(!deep_idle_covers(m_now - 11 * 60 - 30 - 60));
+    TEST_ASSERT(deep_idle_covers(m_now - 10 * 60 - 30));
+    TEST_ASSERT(deep_idle_covers(m_now - 30 - 60));
+    TEST_ASSERT(!deep_idle_covers(m_now - 30));
+
+    // Waking when awake does nothing.
+    deep_idle_wake(DEEP_IDLE_WAKE_LINK);
+    TEST_ASSERT_EQUAL(0, m_sched_count);
+
+    // The accelerometer refuses: the band keeps streaming and tries again a still stretch later.
+    m_wake_error = NRF_ERROR_BUSY;
+    still_minutes(DEEP_IDLE_STILL_MIN);
+    TEST_ASSERT(!deep_idle_active());
+    m_wake_error = NRF_SUCCESS;
+    still_minutes(DEEP_IDLE_STILL_MIN - 1);
+    TEST_ASSERT(!deep_idle_active());
+    still_minutes(1);
+    TEST_ASSERT(deep_idle_active());
+
+    // A phone connecting wakes it too.
+    m_now += 120;
+    deep_idle_wake(DEEP_IDLE_WAKE_LINK);
+    app_sched_execute();
+    TEST_ASSERT(!deep_idle_active());
+
+    deep_idle_stats_get(&stats);
+    TEST_ASSERT_EQUAL(2, stats.entries);
+    TEST_ASSERT_EQUAL(1, stats.motion_wakes);
+    TEST_ASSERT_EQUAL(1, stats.link_wakes);
+    TEST_ASSERT_EQUAL(1, stats.errors);
+    TEST_ASSERT_EQUAL(10 * 60 + 30 + 120, stats.idle_sec);
+}
+
+
+static void day_fill(day_t * p_day, uint32_t from_hour, uint32_t to_hour, wear_t wear)
+{
+    for (uint32_t t = from_hour * 60; t < to_hour * 60; t++)
+    {
+        switch (wear)
+        {
+            case STILL:
+                p_day->activity[t] = 0;
+                break;
+
+            case ASLEEP:
+                p_day->activity[t] = (random_below(10) < 3) ? 1 + random_below(4) : 0;
+                break;
+
+            case DESK:
+                p_day->activity[t] = 5 + random_below(60);
+                break;
+
+            default:
+                p_day->activity[t] = 200 + random_below(200);
+                break;
+        }
+    }
+}
+
+
+static void day_link(day_t * p_day, uint32_t hour, uint32_t minute, uint32_t minutes)
+{
+    for (uint32_t t = hour * 60 + minute; t < hour * 60 + minute + minutes; t++)
+    {
+        p_day->link[t] = true;
+    }
+}
+
+
+static void sleep_feed(uint32_t utc, bool filled)
+{
+    if ((m_fed_count != 0) && (utc != m_fed_last + 60))
+    {
+        if (utc <= m_fed_last)
+        {
+            m_fed_disorder++;
+        }
+        else
+        {
+            m_fed_gaps++;
+        }
+    }
+    m_fed_last = utc;
+    m_fed_count++;
+    m_fed_filled += filled;
+}
+
+
+// The minute part of step_data_process in main.c.
+static void minute_closed(uint32_t minute_utc, uint16_t activity)
+{
+    for (uint32_t utc = m_minute_fed + 60; (m_minute_fed != 0) && (utc < minute_utc) && deep_idle_covers(utc); utc += 60)
+    {
+        sleep_feed(utc, true);
+    }
+    m_minute_fed = minute_utc;
+    sleep_feed(minute_utc, false);
+    deep_idle_minute(activity);
+}
+
+
+// Returns the average current over the day, and without deep idle in p_plain_ua.
+static double day_run(day_t const * p_day, uint32_t entries, double * p_plain_ua)
+{
+    double const       stream_ua   = I_BASE_UA + I_ACC_STREAM_UA + Q_DRAIN_UC;
+    double             active_sec  = 0;
+    double             idle_sec    = 0;
+    double             link_charge = 0;
+    double             charge      = 0;
+    uint32_t           open_minute = DAY_START / 60;  // The minute the step counter adds up.
+    uint16_t           open_activity = 0;
+    deep_idle_stats_st stats;
+
+    band_reset();
+    m_minute_fed  = 0;
+    m_fed_last    = 0;
+    m_fed_count   = 0;
+    m_fed_filled  = 0;
+    m_fed_gaps    = 0;
+    m_fed_disorder = 0;
+
+    // And the first minute of the next day, with a movement that ends any idle stretch.
+    for (uint32_t t = 0; t <= DAY_MIN; t++)
+    {
+        uint32_t const minute   = DAY_START / 60 + t;
+        uint16_t const activity = (t < DAY_MIN) ? p_day->activity[t] : DEEP_IDLE_STILL_ACTIVITY + 1;
+        bool const     link     = (t < DAY_MIN) && p_day->link[t];
+
+        // Links come and go at the start of a minute, from the SoftDevice interrupt.
+        if (link != (m_links != 0))
+        {
+            m_links = link;
+            if (m_links)
+            {
+                m_now = minute * 60 + 1;
+                deep_idle_wake(DEEP_IDLE_WAKE_LINK);
+                app_sched_execute();
+            }
+        }
+
+        // In deep idle, movement latches INT1 a few seconds into the minute.
+        if (!m_streaming && (activity > DEEP_IDLE_STILL_ACTIVITY))
+        {
+            m_now = minute * 60 + 5;
+            m_wake_handler();
+            app_sched_execute();
+        }
+
+        // The first block after a wake-up closes the minute left open on entry.
+        if (m_streaming && (open_minute != minute))
+        {
+            m_now = minute * 60 + 6;
+            minute_closed(open_minute * 60, open_activity);
+            open_minute   = minute;
+            open_activity = 0;
+        }
+
+        if (t == DAY_MIN)
+        {
+            // Not counted in the day.
+        }
+        else if (m_links)
+        {
+            link_charge += 60 * (I_LINK_UA + stream_ua);
+        }
+        else if (m_streaming)
+        {
+            active_sec += 60;
+            charge     += 60 * (stream_ua + Q_ADV_UC / ADV_SLOW_SEC) + (m_summary_suspended ? 0 : Q_SUMMARY_UC);
+        }
+        else
+        {
+            idle_sec += 60;
+            charge   += 60 * (I_BASE_UA + I_ACC_WAKE_UA + Q_ADV_UC / (m_adv_idle ? ADV_IDLE_SEC : ADV_SLOW_SEC)) +
+                        (m_summary_suspended ? 0 : Q_SUMMARY_UC);
+        }
+
+        // The block at second 0 of the next minute closes this one.
+        if (m_streaming)
+        {
+            open_activity = activity;
+            m_now         = (minute + 1) * 60 + 1;
+            minute_closed(minute * 60, open_activity);
+            open_minute   = minute + 1;
+            open_activity = 0;
+        }
+    }
+
+    deep_idle_stats_get(&stats);
+    *p_plain_ua = ((active_sec + idle_sec) * (stream_ua + Q_ADV_UC / ADV_SLOW_SEC) +
+                   (active_sec + idle_sec) / 60 * Q_SUMMARY_UC + link_charge) / 86400;
+    printf("%-19s deep idle %5.2f h, %2u entries, %2u motion and %u link wakes, %u minutes filled in\n",
+           p_day->p_name, idle_sec / 3600, stats.entries, stats.motion_wakes, stats.link_wakes, m_fed_filled);
+    printf("%-19s average %5.2f uA, %5.2f uA without deep idle\n", "",
+           (charge + link_charge) / 86400, *p_plain_ua);
+
+    // Sleep staging sees every minute, in order.
+    TEST_ASSERT_EQUAL(DAY_MIN + 1, m_fed_count);
+    TEST_ASSERT_EQUAL(0, m_fed_gaps);
+    TEST_ASSERT_EQUAL(0, m_fed_disorder);
+    TEST_ASSERT(!deep_idle_active());
+    TEST_ASSERT_EQUAL(entries, stats.entries);
+    TEST_ASSERT_EQUAL(stats.entries, stats.motion_wakes + stats.link_wakes);
+    TEST_ASSERT_EQUAL(stats.entries, m_flushes);
+
+    return (charge + link_charge) / 86400;
+}
+
+
+static void test_days(void)
+{
+    static day_t worn       = { .p_name = "worn, still sleep" };
+    static day_t nightstand = { .p_name = "off the wrist" };
+    static day_t drawer     = { .p_name = "in a drawer" };
+    double       plain;
+    double       average;
+
+    m_seed = 49;
+
+    day_fill(&worn, 0, 7, ASLEEP);
+    day_fill(&worn, 2, 4, STILL);                       // Two hours without a twitch.
+    day_fill(&worn, 7, 9, WALKING);
+    day_fill(&worn, 9, 12, DESK);
+    day_fill(&worn, 12, 13, WALKING);
+    day_fill(&worn, 13, 23, DESK);
+    day_fill(&worn, 23, 24, ASLEEP);
+    day_link(&worn, 7, 30, 5);
+    day_link(&worn, 21, 0, 5);
+
+    day_fill(&nightstand, 0, 7, STILL);
+    day_fill(&nightstand, 7, 9, WALKING);
+    day_fill(&nightstand, 9, 22, DESK);
+    day_fill(&nightstand, 22, 24, STILL);
+    day_link(&nightstand, 3, 0, 2);
+    day_link(&nightstand, 7, 30, 5);
+    day_link(&nightstand, 21, 0, 5);
+
+    day_fill(&drawer, 0, 24, STILL);
+    day_link(&drawer, 6, 0, 2);
+    day_link(&drawer, 12, 0, 2);
+    day_link(&drawer, 18, 0, 2);
+
+    // Sleep on the wrist is rarely still for half an hour.
+    average = day_run(&worn, 1, &plain);
+    TEST_ASSERT(average < plain);
+
+    // Put down at night, woken by the 3:00 sync, and put down again in the evening.
+    average = day_run(&nightstand, 3, &plain);
+    TEST_ASSERT(average < plain * 0.85);
+
+    // Connected at 6:00, 12:00 and 18:00: four stretches of idle.
+    average = day_run(&drawer, 4, &plain);
+    TEST_ASSERT(average < plain * 0.5);
+}
+
+
+int main(void)
+{
+    test_enter_exit();
+    test_days();
+    TEST_EXIT();
+}
@@ -0,0 +1,486 @@
+/* Host test of the fixed-point kernels of components/libraries/dsp_kernels.
+ *
+ * Built twice: as the portable C, and with ARM_MATH_CM4 against the intrinsics of
+ * test/host/cm4/arm_math.h, so the SIMD paths run with the wrapping and saturation of the
+ * Cortex-M4 instructions. Both builds check every kernel against its plain formula on random
+ * blocks with full-scale samples, odd lengths, odd addresses, in-place output, several blocks
+ * in a row and biquad coefficients that wrap the sum. Both then hash the outputs of one random
+ * sweep and compare with the same golden value, so the two builds are bit-identical. Then
+ * prints the cost per sample of the biquad and the FIR.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "unit_test.h"
+#include "dsp_kernels.h"
+
+#define BLOCK_MAX           (256)
+#define TAPS_MAX            (40)
+#define LAGS_MAX            (64)
+#define BLOCKS              (4)             // Blocks in a row through one filter.
+#define SWEEP_CASES         (20000)
+#define SWEEP_HASH          (0x9c114a3415781215ULL)     // FNV-1a 64 of the sweep outputs.
+#define REFERENCE_CASES     (2000)
+#define BENCH_SAMPLES       (4000000)
+
+#define ARRAY_SIZE(a)       (sizeof(a) / sizeof((a)[0]))
+
+
+static uint32_t m_seed;
+static uint64_t m_hash;
+
+
+// One sample in eight is full scale, the others anything.
+static q15_t random_q15(void)
+{
+    m_seed = m_seed * 1103515245 + 12345;
+    switch ((m_seed >> 8) % 16)
+    {
+        case 0:
+            return INT16_MAX;
+
+        case 1:
+            return INT16_MIN;
+
+        default:
+            return (q15_t)(m_seed >> 12);
+    }
+}
+
+
+static uint32_t random_below(uint32_t n)
+{
+    m_seed = m_seed * 1103515245 + 12345;
+    return (m_seed >> 16) % n;
+}
+
+
+static void random_fill(q15_t * p_dst, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        p_dst[i] = random_q15();
+    }
+}
+
+
+static void hash_mix(void const * p_data, uint32_t length)
+{
+    uint8_t const * p_byte = p_data;
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        m_hash ^= p_byte[i];
+        m_hash *= 1099511628211ULL;
+    }
+}
+
+
+static int32_t sat16(int64_t value)
+{
+    return (value > INT16_MAX) ? INT16_MAX : ((value < INT16_MIN) ? INT16_MIN : (int32_t)value);
+}
+
+
+static int32_t sat32(int64_t value)
+{
+    return (value > INT32_MAX) ? INT32_MAX : ((value < INT32_MIN) ? INT32_MIN : (int32_t)value);
+}
+
+
+// The low 32 bits, which is what a 32-bit accumulator keeps.
+static int32_t wrap32(int64_t value)
+{
+    return (int32_t)(uint32_t)(uint64_t)value;
+}
+
+
+// y[n] of a FIR over the whole input so far, zeros before the start.
+static int32_t fir_reference(q15_t const * p_coef, uint16_t taps, q15_t const * p_x, uint32_t n)
+{
+    int64_t acc = 0;
+
+    for (uint32_t k = 0; (k < taps) && (k <= n); k++)
+    {
+        acc += (int64_t)p_coef[k] * p_x[n - k];
+    }
+    return sat16(acc >> 15);
+}
+
+
+static void test_add(void)
+{
+    q15_t a[BLOCK_MAX];
+    q15_t b[BLOCK_MAX];
+    q15_t out[BLOCK_MAX];
+
+    m_seed = 1;
+    for (uint32_t it = 0; it < REFERENCE_CASES; it++)
+    {
+        uint16_t const count  = 2 + random_below(BLOCK_MAX - 1);
+        uint16_t const offset = it & 1;     // Pairs straddle words.
+
+        random_fill(a, BLOCK_MAX);
+        random_fill(b, BLOCK_MAX);
+        memset(out, 0, sizeof(out));
+        dsp_add_q15(a + offset, b, out + offset, count - offset);
+        for (uint32_t i = 0; i + offset < count; i++)
+        {
+            TEST_ASSERT_EQUAL(sat16(a[i + offset] + b[i]), out[i + offset]);
+        }
+
+        memcpy(out, a, sizeof(out));
+        dsp_add_q15(out, b, out, count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            TEST_ASSERT_EQUAL(sat16(a[i] + b[i]), out[i]);
+        }
+    }
+}
+
+
+static void test_dcblock(void)
+{
+    q15_t x[BLOCKS * BLOCK_MAX];
+    q15_t out[BLOCKS * BLOCK_MAX];
+
+    m_seed = 2;
+    for (uint32_t it = 0; it < REFERENCE_CASES; it++)
+    {
+        dsp_dcblock_q15_t filter;
+        uint32_t          total = 0;
+        int32_t           x1;
+        int32_t           y1    = 0;
+
+        dsp_dcblock_q15_init(&filter, random_q15());
+        random_fill(x, ARRAY_SIZE(x));
+        for (uint32_t b = 0; b < BLOCKS; b++)
+        {
+            uint16_t const count = random_below(BLOCK_MAX);
+
+            dsp_dcblock_q15(&filter, &x[total], &out[total], count);
+            total += count;
+        }
+
+        // Primed with the first sample, so a constant input gives zero.
+        x1 = x[0];
+        for (uint32_t i = 0; i < total; i++)
+        {
+            y1 = sat16(wrap32(((int64_t)x[i] - x1) * 32768 + (int64_t)filter.a * y1) >> 15);
+            x1 = x[i];
+            TEST_ASSERT_EQUAL(y1, out[i]);
+        }
+    }
+}
+
+
+static void test_biquad(void)
+{
+    q15_t x[BLOCKS * BLOCK_MAX];
+    q15_t out[BLOCKS * BLOCK_MAX];
+
+    m_seed = 3;
+    for (uint32_t it = 0; it < REFERENCE_CASES; it++)
+    {
+        dsp_biquad_q15_t filter;
+        q15_t            coef[5];
+        uint8_t const    frac_bits = 10 + it % 6;
+        uint32_t         total     = 0;
+        int64_t          x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+
+        // Any coefficients: most of these wrap the 32-bit sum.
+        random_fill(coef, ARRAY_SIZE(coef));
+        random_fill(x, ARRAY_SIZE(x));
+        dsp_biquad_q15_init(&filter, coef, frac_bits);
+        for (uint32_t b = 0; b < BLOCKS; b++)
+        {
+            uint16_t const count = random_below(BLOCK_MAX);
+
+            // In place every other block.
+            memcpy(&out[total], &x[total], count * sizeof(q15_t));
+            dsp_biquad_q15(&filter, (b & 1) ? &out[total] : &x[total], &out[total], count);
+            total += count;
+        }
+
+        for (uint32_t i = 0; i < total; i++)
+        {
+            int64_t const acc = coef[0] * x[i] + coef[1] * x1 + coef[2] * x2 + coef[3] * y1 + coef[4] * y2;
+            int32_t const y   = sat16(wrap32(acc) >> frac_bits);
+
+            TEST_ASSERT_EQUAL(y, out[i]);
+            x2 = x1;
+            x1 = x[i];
+            y2 = y1;
+            y1 = y;
+        }
+    }
+}
+
+
+static void test_fir(void)
+{
+    q15_t x[BLOCKS * BLOCK_MAX];
+    q15_t out[BLOCKS * BLOCK_MAX];
+    q15_t state[TAPS_MAX - 1 + BLOCK_MAX];
+    q15_t coef[TAPS_MAX];
+
+    m_seed = 4;
+    for (uint32_t it = 0; it < REFERENCE_CASES; it++)
+    {
+        dsp_fir_q15_t  filter;
+        uint16_t const taps  = 1 + random_below(TAPS_MAX);
+        uint32_t       total = 0;
+
+        random_fill(coef, taps);
+        random_fill(x, ARRAY_SIZE(x));
+
+        // Even and odd tap counts, blocks of any length, in place every other block.
+        dsp_fir_q15_init(&filter, coef, taps, state, BLOCK_MAX);
+        for (uint32_t b = 0; b < BLOCKS; b++)
+        {
+            uint16_t const count = random_below(BLOCK_MAX + 1);
+
+            memcpy(&out[total], &x[total], count * sizeof(q15_t));
+            dsp_fir_q15(&filter, (b & 1) ? &out[total] : &x[total], &out[total], count);
+            total += count;
+        }
+        for (uint32_t i = 0; i < total; i++)
+        {
+            TEST_ASSERT_EQUAL(fir_reference(coef, taps, x, i), out[i]);
+        }
+
+        // Decimation keeps the last output of each group, in blocks of a multiple of factor.
+        {
+            uint8_t const factor = 1 + it % 4;
+            uint32_t      kept   = 0;
+
+            total = 0;
+            dsp_fir_q15_init(&filter, coef, taps, state, BLOCK_MAX);
+            for (uint32_t b = 0; b < BLOCKS; b++)
+            {
+                uint16_t const count = random_below(BLOCK_MAX / factor + 1) * factor;
+
+                dsp_fir_decimate_q15(&filter, factor, &x[total], &out[kept], count);
+                total += count;
+                kept  += count / factor;
+            }
+            for (uint32_t j = 0; j < kept; j++)
+            {
+                TEST_ASSERT_EQUAL(fir_reference(coef, taps, x, j * factor + factor - 1), out[j]);
+            }
+        }
+    }
+}
+
+
+static void test_vmag3(void)
+{
+    int16_t xyz[3 * BLOCK_MAX + 1];
+    q15_t   out[BLOCK_MAX];
+
+    m_seed = 5;
+    for (uint32_t it = 0; it < REFERENCE_CASES; it++)
+    {
+        uint16_t const count  = random_below(BLOCK_MAX + 1);
+        uint8_t const  shift  = it % 4;
+        uint16_t const offset = it & 1;
+
+        random_fill(xyz, ARRAY_SIZE(xyz));
+        if (it == 0)
+        {
+            // The largest sum, 3 * 2^30, is above INT32_MAX.
+            for (uint32_t i = 0; i < ARRAY_SIZE(xyz); i++)
+            {
+                xyz[i] = INT16_MIN;
+            }
+        }
+
+        dsp_vmag3_q15(xyz + offset, out, count, shift);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            int16_t const * p_v = &xyz[offset + 3 * i];
+            double const    sum = (double)p_v[0] * p_v[0] + (double)p_v[1] * p_v[1] + (double)p_v[2] * p_v[2];
+            uint32_t const  mag = (uint32_t)floor(sqrt(sum)) << shift;
+
+            TEST_ASSERT_EQUAL((mag > INT16_MAX) ? INT16_MAX : mag, out[i]);
+        }
+    }
+}
+
+
+static void test_autocorr(void)
+{
+    q15_t x[BLOCK_MAX + 1];
+    q31_t out[LAGS_MAX];
+
+    m_seed = 6;
+    for (uint32_t it = 0; it < REFERENCE_CASES; it++)
+    {
+        uint16_t const count  = 1 + random_below(BLOCK_MAX);
+        uint16_t const lags   = 1 + random_below(LAGS_MAX);
+        uint8_t const  shift  = it % 20;
+        uint16_t const offset = it & 1;
+
+        random_fill(x, ARRAY_SIZE(x));
+        dsp_autocorr_q15(x + offset, count, out, lags, shift);
+        for (uint32_t k = 0; k < lags; k++)
+        {
+            int64_t acc = 0;
+
+            for (uint32_t i = 0; i + k < count; i++)
+            {
+                acc += (int64_t)x[offset + i] * x[offset + i + k];
+            }
+            TEST_ASSERT_EQUAL(sat32(acc >> shift), out[k]);
+        }
+    }
+}
+
+
+// Every kernel on random blocks; the hash is the same for both builds.
+static void test_sweep(void)
+{
+    q15_t a[BLOCK_MAX];
+    q15_t b[BLOCK_MAX];
+    q15_t out[BLOCK_MAX];
+    q31_t corr[LAGS_MAX];
+    q15_t state[TAPS_MAX + BLOCK_MAX];
+
+    m_seed = 12345;
+    m_hash = 1469598103934665603ULL;
+    for (uint32_t it = 0; it < SWEEP_CASES; it++)
+    {
+        uint16_t const count = 1 + ((uint16_t)random_q15() & 0xFF) % BLOCK_MAX;
+
+        random_fill(a, BLOCK_MAX);
+        random_fill(b, BLOCK_MAX);
+
+        {
+            int16_t xyz[3 * BLOCK_MAX];
+
+            random_fill(xyz, ARRAY_SIZE(xyz));
+            dsp_vmag3_q15(xyz, out, count / 3, it % 4);
+            hash_mix(out, count / 3 * sizeof(q15_t));
+        }
+
+        dsp_add_q15(a, b, out, count);
+        hash_mix(out, count * sizeof(q15_t));
+        dsp_add_q15(a + 1, b, out + 1, count - 1);
+        hash_mix(out, count * sizeof(q15_t));
+
+        {
+            dsp_biquad_q15_t filter;
+            q15_t            coef[5];
+
+            random_fill(coef, ARRAY_SIZE(coef));
+            dsp_biquad_q15_init(&filter, coef, 10 + it % 6);
+            dsp_biquad_q15(&filter, a, out, count / 2);
+            dsp_biquad_q15(&filter, a + count / 2, out + count / 2, count - count / 2);
+            hash_mix(out, count * sizeof(q15_t));
+        }
+
+        {
+            dsp_dcblock_q15_t filter;
+
+            dsp_dcblock_q15_init(&filter, random_q15());
+            dsp_dcblock_q15(&filter, a, out, count);
+            hash_mix(out, count * sizeof(q15_t));
+        }
+
+        {
+            dsp_fir_q15_t  filter;
+            q15_t          coef[TAPS_MAX];
+            uint16_t const taps   = 1 + it % 33;
+            uint8_t const  factor = 1 + it % 4;
+            uint16_t const kept   = count / factor * factor;
+
+            random_fill(coef, taps);
+            dsp_fir_q15_init(&filter, coef, taps, state, BLOCK_MAX);
+            dsp_fir_q15(&filter, a, out, count);
+            hash_mix(out, count * sizeof(q15_t));
+            dsp_fir_q15(&filter, b, b, count);
+            hash_mix(b, count * sizeof(q15_t));
+            dsp_fir_decimate_q15(&filter, factor, a, out, kept);
+            hash_mix(out, kept / factor * sizeof(q15_t));
+        }
+
+        {
+            uint16_t const lags   = 1 + it % LAGS_MAX;
+            uint16_t const offset = it & 1;
+
+            dsp_autocorr_q15(a + offset, (count > offset) ? count - offset : 1, corr, lags, it % 20);
+            hash_mix(corr, lags * sizeof(q31_t));
+        }
+    }
+
+    printf("%s sweep %016llx\n", DSP_KERNELS_SIMD ? "cm4" : "portable", (unsigned long long)m_hash);
+    TEST_ASSERT(m_hash == SWEEP_HASH);
+}
+
+
+static double bench_ns(struct timespec const * p_start, struct timespec const * p_end)
+{
+    return ((p_end->tv_sec - p_start->tv_sec) * 1e9 + (p_end->tv_nsec - p_start->tv_nsec)) / BENCH_SAMPLES;
+}
+
+
+static void bench_filters(void)
+{
+    static q15_t const biquad_coef[5] = {1496, 2992, 1496, 16096, -5696};   // Q14 low-pass
+    static uint16_t const sizes[]     = {25, 250};
+    q15_t           x[BLOCK_MAX];
+    q15_t           out[BLOCK_MAX];
+    q15_t           fir_coef[16];
+    q15_t           state[ARRAY_SIZE(fir_coef) - 1 + BLOCK_MAX];
+    struct timespec start;
+    struct timespec end;
+
+    m_seed = 7;
+    random_fill(x, ARRAY_SIZE(x));
+    random_fill(fir_coef, ARRAY_SIZE(fir_coef));
+
+    for (uint32_t s = 0; s < ARRAY_SIZE(sizes); s++)
+    {
+        uint16_t const   count = sizes[s];
+        dsp_biquad_q15_t biquad;
+        dsp_fir_q15_t    fir;
+        double           biquad_ns;
+
+        dsp_biquad_q15_init(&biquad, biquad_coef, 14);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (uint32_t n = 0; n < BENCH_SAMPLES; n += count)
+        {
+            dsp_biquad_q15(&biquad, x, out, count);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        biquad_ns = bench_ns(&start, &end);
+
+        dsp_fir_q15_init(&fir, fir_coef, ARRAY_SIZE(fir_coef), state, BLOCK_MAX);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (uint32_t n = 0; n < BENCH_SAMPLES; n += count)
+        {
+            dsp_fir_q15(&fir, x, out, count);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        printf("host %3u-sample blocks: biquad %.2f ns/sample, 16-tap FIR %.2f ns/sample\n",
+               count, biquad_ns, bench_ns(&start, &end));
+    }
+}
+
+
+int main(void)
+{
+    test_add();
+    test_dcblock();
+    test_biquad();
+    test_fir();
+    test_vmag3();
+    test_autocorr();
+    test_sweep();
+    bench_filters();
+    TEST_EXIT();
+}
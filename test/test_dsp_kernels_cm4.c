@@ -0,0 +1,3 @@
+/* test_dsp_kernels.c built with ARM_MATH_CM4, against the intrinsics of test/host/cm4. */
+
+#include "test_dsp_kernels.c"
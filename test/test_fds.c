@@ -0,0 +1,823 @@
+/* Host test of the fds RAM index on top of fstorage and the flash simulator.
+ *
+ * fds.c is included, rather than linked, so that the test can look at the index. Checks
+ * that lookups agree with flash before and after the index overflows, and that deleting or
+ * updating records rebuilds an overflowed index without waiting for garbage collection,
+ * and that deferred updates are merged on file ID and record key.
+ * Checks that time-sliced garbage collection lets a queued write land in the middle of a page,
+ * that crossing the free space watermark starts garbage collection once, and that a reset at
+ * any word of a garbage collection loses no record.
+ * Then prints the cost of a lookup by key with the index and with a scan of flash, and the
+ * longest write stall and flash operations of garbage collection.
+ */
+
+#include "fds.c"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "unit_test.h"
+#include "flash_sim.h"
+#include "fstorage_config.h"
+#include "nrf_soc.h"
+
+#define FLASH_BASE          (0x70000)   // Last 16 pages below the 512 kB of the nRF52832.
+#define FLASH_PAGES         (16)
+#define FILE_ID             (0x1111)
+#define OTHER_FILE_ID       (0x2222)
+#define KEY_BASE            (0x0100)
+#define LOOKUPS             (20000)
+#define GC_FILE_ID          (0x3333)
+#define GC_KEY_BASE         (0x0800)
+#define GC_DATA_WORDS       (16)
+#define GC_RECORD_WORDS     (FDS_HEADER_SIZE + GC_DATA_WORDS)
+#define GC_RECORDS_MAX      (128)
+
+
+static uint32_t   m_data[512];          // Record data; record n stores the value n.
+static uint32_t   m_evt_count;
+static ret_code_t m_evt_result;
+static uint32_t   m_evt_id_count[FDS_EVT_GC + 1];
+static uint64_t   m_evt_time_us;        // Flash time of the latest event.
+
+static uint32_t   m_gc_data[GC_RECORDS_MAX][GC_DATA_WORDS];
+static uint16_t   m_write_gc_state;     // GC state when the latest write completed.
+static uint16_t   m_write_swap_offset;  // Words in swap when the latest write completed.
+
+
+static void fds_evt_handler(fds_evt_t const * const p_evt)
+{
+    m_evt_count++;
+    m_evt_result = p_evt->result;
+    m_evt_id_count[p_evt->id]++;
+    m_evt_time_us = flash_sim_time_us();
+
+    if (p_evt->id == FDS_EVT_WRITE)
+    {
+        m_write_gc_state    = m_gc.state;
+        m_write_swap_offset = m_swap_page.write_offset;
+    }
+}
+
+
+// Runs the flash operations queued by fds, then checks the result of the operation.
+static void op_complete(ret_code_t ret)
+{
+    uint32_t const count = m_evt_count;
+
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, ret);
+    flash_sim_run();
+    TEST_ASSERT_EQUAL(count + 1, m_evt_count);
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, m_evt_result);
+}
+
+
+static void record_write(uint16_t file_id, uint16_t n)
+{
+    fds_record_desc_t  desc;
+    fds_record_chunk_t chunk;
+    fds_record_t       record;
+
+    m_data[n] = n;
+
+    chunk.p_data       = &m_data[n];
+    chunk.length_words = 1;
+
+    record.file_id           = file_id;
+    record.key               = KEY_BASE + n;
+    record.data.p_chunks     = &chunk;
+    record.data.num_chunks   = 1;
+
+    op_complete(fds_record_write(&desc, &record));
+}
+
+
+static bool record_find_value(uint16_t n, uint32_t * p_value, fds_record_desc_t * p_desc)
+{
+    fds_find_token_t tok = {0};
+
+    if (fds_record_find_by_key(KEY_BASE + n, p_desc, &tok) != FDS_SUCCESS)
+    {
+        return false;
+    }
+
+    *p_value = p_desc->p_record[FDS_HEADER_SIZE];
+
+    return true;
+}
+
+
+// Checks that the first count records can be found, and that the ones marked deleted cannot.
+static void records_check(uint16_t count, bool const * p_deleted)
+{
+    for (uint16_t n = 0; n < count; n++)
+    {
+        fds_record_desc_t desc;
+        uint32_t          value = 0;
+        bool const        found = record_find_value(n, &value, &desc);
+
+        if ((p_deleted != NULL) && p_deleted[n])
+        {
+            TEST_ASSERT(!found);
+        }
+        else
+        {
+            TEST_ASSERT(found);
+            TEST_ASSERT_EQUAL(m_data[n], value);
+        }
+    }
+}
+
+
+static void fds_setup(void)
+{
+    flash_sim_config_t const config =
+    {
+        .base_addr   = FLASH_BASE,
+        .page_count  = FLASH_PAGES,
+        .evt_handler = fs_sys_event_handler,
+    };
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, flash_sim_init(&config));
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, fds_register(fds_evt_handler));
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, fds_init());
+    flash_sim_run();
+    TEST_ASSERT(flag_is_set(FDS_FLAG_INITIALIZED));
+}
+
+
+static void test_index_overflow_and_rebuild(void)
+{
+    bool              deleted[FDS_RAM_INDEX_SIZE + 8] = {false};
+    uint16_t const    count = FDS_RAM_INDEX_SIZE + 4;
+    fds_record_desc_t desc;
+    uint32_t          value;
+
+    for (uint16_t n = 0; n < FDS_RAM_INDEX_SIZE; n++)
+    {
+        record_write(FILE_ID, n);
+    }
+    TEST_ASSERT(m_index.valid);
+    TEST_ASSERT_EQUAL(FDS_RAM_INDEX_SIZE, m_index.count);
+    records_check(FDS_RAM_INDEX_SIZE, NULL);
+
+    // Overflow the index: lookups fall back to scanning flash.
+    for (uint16_t n = FDS_RAM_INDEX_SIZE; n < count; n++)
+    {
+        record_write(OTHER_FILE_ID, n);
+    }
+    TEST_ASSERT(!m_index.valid);
+    records_check(count, NULL);
+
+    // Deleting records which do not make enough room leaves the index invalid.
+    for (uint16_t n = 0; n < 3; n++)
+    {
+        TEST_ASSERT(record_find_value(n, &value, &desc));
+        op_complete(fds_record_delete(&desc));
+        deleted[n] = true;
+    }
+    TEST_ASSERT(!m_index.valid);
+    records_check(count, deleted);
+
+    // The next deletion makes room. The index is rebuilt at once, with no garbage collection.
+    TEST_ASSERT(record_find_value(3, &value, &desc));
+    op_complete(fds_record_delete(&desc));
+    deleted[3] = true;
+    TEST_ASSERT(m_index.valid);
+    TEST_ASSERT_EQUAL(FDS_RAM_INDEX_SIZE, m_index.count);
+    TEST_ASSERT_EQUAL(0, m_gc.run_count);
+    records_check(count, deleted);
+
+    // Overflow again, then delete a whole file.
+    record_write(OTHER_FILE_ID, count);
+    TEST_ASSERT(!m_index.valid);
+    op_complete(fds_file_delete(OTHER_FILE_ID));
+    for (uint16_t n = FDS_RAM_INDEX_SIZE; n <= count; n++)
+    {
+        deleted[n] = true;
+    }
+    TEST_ASSERT(m_index.valid);
+    TEST_ASSERT_EQUAL(FDS_RAM_INDEX_SIZE - 4, m_index.count);
+    records_check(count + 1, deleted);
+
+    // Updates keep a valid index in step with flash.
+    TEST_ASSERT(record_find_value(10, &value, &desc));
+    {
+        fds_record_chunk_t chunk  = { .p_data = &m_data[10], .length_words = 1 };
+        fds_record_t       record =
+        {
+            .file_id         = FILE_ID,
+            .key             = KEY_BASE + 10,
+            .data.p_chunks   = &chunk,
+            .data.num_chunks = 1,
+        };
+
+        m_data[10] = 0xA5A5A5A5;
+        op_complete(fds_record_update(&desc, &record));
+    }
+    TEST_ASSERT(m_index.valid);
+    TEST_ASSERT_EQUAL(FDS_RAM_INDEX_SIZE - 4, m_index.count);
+    records_check(count + 1, deleted);
+
+    // Garbage collection moves records; the index follows.
+    op_complete(fds_gc());
+    TEST_ASSERT(m_index.valid);
+    TEST_ASSERT_EQUAL(FDS_RAM_INDEX_SIZE - 4, m_index.count);
+    records_check(count + 1, deleted);
+}
+
+
+// Deferred updates to the same file ID and record key reach flash as one update.
+static void test_write_behind_merge(void)
+{
+    static uint32_t    versions[3] = {0xAAAA0001, 0xAAAA0002, 0xAAAA0003};
+    uint16_t const     n           = 200;
+    fds_record_desc_t  desc;
+    fds_record_desc_t  stale;
+    fds_record_chunk_t chunk       = { .length_words = 1 };
+    fds_record_t       record      =
+    {
+        .file_id         = FILE_ID,
+        .key             = KEY_BASE + n,
+        .data.p_chunks   = &chunk,
+        .data.num_chunks = 1,
+    };
+    flash_sim_stats_t  before;
+    flash_sim_stats_t  after;
+    uint32_t           value;
+    uint32_t           evt_count;
+
+    record_write(FILE_ID, n);
+    flash_sim_stats_get(&before);
+    evt_count = m_evt_count;
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        // Look the record up each time, as separate callers would.
+        TEST_ASSERT(record_find_value(n, &value, &desc));
+        TEST_ASSERT_EQUAL(n, value);
+
+        chunk.p_data = &versions[i];
+        TEST_ASSERT_EQUAL(FDS_SUCCESS, fds_record_update_deferred(&desc, &record));
+        flash_sim_run();
+    }
+
+    flash_sim_stats_get(&after);
+    TEST_ASSERT_EQUAL(before.write_ops, after.write_ops);
+    TEST_ASSERT_EQUAL(evt_count, m_evt_count);
+
+    op_complete(fds_flush());
+    TEST_ASSERT_EQUAL(evt_count + 1, m_evt_count);
+    stale = desc;
+    TEST_ASSERT(record_find_value(n, &value, &desc));
+    TEST_ASSERT_EQUAL(versions[2], value);
+
+    // A caller still holding the descriptor of the copy replaced by the flush merges with the
+    // held back update, rather than queueing an update of a record which no longer exists.
+    chunk.p_data = &versions[1];
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, fds_record_update_deferred(&desc, &record));
+    chunk.p_data = &versions[0];
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, fds_record_update_deferred(&stale, &record));
+    op_complete(fds_flush());
+    TEST_ASSERT(record_find_value(n, &value, &desc));
+    TEST_ASSERT_EQUAL(versions[0], value);
+
+    // Held back updates to a deleted file are discarded.
+    chunk.p_data = &versions[0];
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, fds_record_update_deferred(&desc, &record));
+    op_complete(fds_file_delete(FILE_ID));
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, fds_flush());
+    flash_sim_run();
+    TEST_ASSERT(!record_find_value(n, &value, &desc));
+}
+
+
+static double lookup_ns(uint16_t count)
+{
+    struct timespec   start;
+    struct timespec   end;
+    fds_record_desc_t desc;
+    uint32_t          value;
+    uint32_t          sum = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+    {
+        if (record_find_value((uint16_t)((i * 7) % count), &value, &desc))
+        {
+            sum += value;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    TEST_ASSERT(sum > 0);
+
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / LOOKUPS;
+}
+
+
+// Lookup cost by key as the store fills up. Above FDS_RAM_INDEX_SIZE records only the scan
+// is available. Times are host times; on target the ratio is what matters.
+static void bench_lookup(void)
+{
+    static uint16_t const fills[] = {16, 32, FDS_RAM_INDEX_SIZE, 128, 256, 384};
+    uint16_t              written = 0;
+
+    // Start from an empty store.
+    op_complete(fds_gc());
+    TEST_ASSERT(m_index.valid);
+    TEST_ASSERT_EQUAL(0, m_index.count);
+
+    printf("records  index ns  scan ns\n");
+
+    for (uint32_t i = 0; i < sizeof(fills) / sizeof(fills[0]); i++)
+    {
+        double indexed = 0;
+        double scanned;
+
+        while (written < fills[i])
+        {
+            record_write(FILE_ID, written++);
+        }
+
+        if (m_index.valid)
+        {
+            indexed        = lookup_ns(written);
+            m_index.valid  = false;
+            scanned        = lookup_ns(written);
+            m_index.valid  = true;
+        }
+        else
+        {
+            scanned = lookup_ns(written);
+        }
+
+        if (indexed > 0)
+        {
+            printf("%7u  %8.0f  %7.0f\n", written, indexed, scanned);
+        }
+        else
+        {
+            printf("%7u  %8s  %7.0f\n", written, "-", scanned);
+        }
+    }
+
+    records_check(written, NULL);
+}
+
+
+// Free words across the data pages, as gc_auto_trigger() counts them.
+static uint32_t free_words(void)
+{
+    uint32_t words = 0;
+
+    for (uint16_t i = 0; i < FDS_MAX_PAGES; i++)
+    {
+        if (m_pages[i].page_type == FDS_PAGE_DATA)
+        {
+            words += FDS_PAGE_SIZE - (m_pages[i].write_offset + m_pages[i].words_reserved);
+        }
+    }
+
+    return words;
+}
+
+
+static ret_code_t gc_record_queue(uint16_t n)
+{
+    fds_record_desc_t  desc;
+    fds_record_chunk_t chunk;
+    fds_record_t       record;
+
+    for (uint32_t i = 0; i < GC_DATA_WORDS; i++)
+    {
+        m_gc_data[n][i] = ((uint32_t)n << 16) | i;
+    }
+
+    chunk.p_data       = m_gc_data[n];
+    chunk.length_words = GC_DATA_WORDS;
+
+    record.file_id         = GC_FILE_ID;
+    record.key             = GC_KEY_BASE + n;
+    record.data.p_chunks   = &chunk;
+    record.data.num_chunks = 1;
+
+    return fds_record_write(&desc, &record);
+}
+
+
+static void gc_record_delete(uint16_t n)
+{
+    fds_record_desc_t desc;
+    fds_find_token_t  tok = {0};
+
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, fds_record_find(GC_FILE_ID, GC_KEY_BASE + n, &desc, &tok));
+    op_complete(fds_record_delete(&desc));
+}
+
+
+// Checks that the first count records hold their data, except the ones marked deleted, and
+// that no record is stored twice.
+static void gc_records_check(uint16_t count, bool const * p_deleted)
+{
+    fds_record_desc_t desc;
+    fds_find_token_t  tok   = {0};
+    uint16_t          found = 0;
+    uint16_t          live  = 0;
+
+    for (uint16_t n = 0; n < count; n++)
+    {
+        fds_find_token_t tok_key = {0};
+        bool const       present = (fds_record_find(GC_FILE_ID, GC_KEY_BASE + n,
+                                                    &desc, &tok_key) == FDS_SUCCESS);
+
+        if (p_deleted[n])
+        {
+            TEST_ASSERT(!present);
+            continue;
+        }
+
+        live++;
+        TEST_ASSERT(present);
+        TEST_ASSERT_EQUAL(GC_DATA_WORDS, ((fds_header_t const *)desc.p_record)->tl.length_words);
+        TEST_ASSERT_MEMORY(m_gc_data[n], desc.p_record + FDS_HEADER_SIZE,
+                           GC_DATA_WORDS * sizeof(uint32_t));
+    }
+
+    while (fds_record_find_in_file(GC_FILE_ID, &desc, &tok) == FDS_SUCCESS)
+    {
+        found++;
+    }
+    TEST_ASSERT_EQUAL(live, found);
+}
+
+
+// Runs GC to completion. With nothing to collect, fds_gc() sends its event before it returns.
+static void gc_complete(void)
+{
+    uint32_t const count = m_evt_count;
+
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, fds_gc());
+    flash_sim_run();
+    TEST_ASSERT_EQUAL(count + 1, m_evt_count);
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, m_evt_result);
+}
+
+
+// Deletes every record and collects all pages, so that each test starts from an empty store.
+// Deleting a file with no records completes before fds_file_delete() returns, too.
+static void store_clear(void)
+{
+    uint32_t const count = m_evt_count;
+
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, fds_file_delete(FILE_ID));
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, fds_file_delete(OTHER_FILE_ID));
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, fds_file_delete(GC_FILE_ID));
+    flash_sim_run();
+    TEST_ASSERT_EQUAL(count + 3, m_evt_count);
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, m_evt_result);
+
+    gc_complete();
+    TEST_ASSERT_EQUAL(2 * (FDS_PAGE_SIZE - FDS_PAGE_TAG_SIZE), free_words());
+}
+
+
+// Writes count records from the first page on, then deletes every other one.
+static void store_fill_dirty(uint16_t count, bool * p_deleted)
+{
+    store_clear();
+
+    for (uint16_t n = 0; n < count; n++)
+    {
+        op_complete(gc_record_queue(n));
+        p_deleted[n] = false;
+    }
+    for (uint16_t n = 1; n < count; n += 2)
+    {
+        gc_record_delete(n);
+        p_deleted[n] = true;
+    }
+}
+
+
+// A write queued while GC copies a page is appended to that page in between two record copies,
+// and is then copied to swap like the records before it.
+static void test_gc_yield_write(void)
+{
+    uint16_t const    count = 50;     // 950 words, most of the first page.
+    bool              deleted[GC_RECORDS_MAX];
+    flash_sim_stats_t before;
+    flash_sim_stats_t after;
+    uint32_t          writes;
+    uint32_t          gcs;
+    fds_record_desc_t desc;
+    fds_find_token_t  tok = {0};
+
+    store_fill_dirty(count, deleted);
+    flash_sim_stats_get(&before);
+    writes = m_evt_id_count[FDS_EVT_WRITE];
+    gcs    = m_evt_id_count[FDS_EVT_GC];
+
+    // Let GC copy part of its slice.
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, fds_gc());
+    while (m_swap_page.write_offset < FDS_PAGE_TAG_SIZE + (FDS_GC_SLICE_WORDS / 2))
+    {
+        TEST_ASSERT(flash_sim_process());
+    }
+
+    // The write goes to the page being collected, behind the records GC has yet to copy.
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, gc_record_queue(count));
+    deleted[count] = false;
+    TEST_ASSERT_EQUAL(FDS_OP_WRITE,
+                      m_op_queue.op[(m_op_queue.rp + 1) % FDS_OP_QUEUE_SIZE].op_code);
+    TEST_ASSERT_EQUAL(m_gc.cur_page,
+                      m_op_queue.op[(m_op_queue.rp + 1) % FDS_OP_QUEUE_SIZE].write.page);
+
+    while (m_evt_id_count[FDS_EVT_WRITE] == writes)
+    {
+        TEST_ASSERT(flash_sim_process());
+    }
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, m_evt_result);
+    TEST_ASSERT_EQUAL(gcs, m_evt_id_count[FDS_EVT_GC]);
+    TEST_ASSERT_EQUAL(GC_FIND_NEXT_RECORD, m_write_gc_state);
+    TEST_ASSERT(m_write_swap_offset >= FDS_PAGE_TAG_SIZE + FDS_GC_SLICE_WORDS);
+    TEST_ASSERT(m_write_swap_offset < FDS_PAGE_TAG_SIZE + (count / 2) * GC_RECORD_WORDS);
+
+    flash_sim_run();
+    flash_sim_stats_get(&after);
+    TEST_ASSERT_EQUAL(gcs + 1, m_evt_id_count[FDS_EVT_GC]);
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, m_evt_result);
+    TEST_ASSERT_EQUAL(1, after.erase_ops - before.erase_ops);
+    gc_records_check(count + 1, deleted);
+
+    // The new record now lives in the old swap, which took the place of the collected page.
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, fds_record_find(GC_FILE_ID, GC_KEY_BASE + count, &desc, &tok));
+    TEST_ASSERT(desc.p_record >= m_pages[m_gc.cur_page].p_addr);
+    TEST_ASSERT(desc.p_record <  m_pages[m_gc.cur_page].p_addr + FDS_PAGE_SIZE);
+}
+
+
+// The write which takes free space below FDS_GC_WATERMARK_WORDS queues one GC of the dirtiest
+// page. Writes queued behind it do not queue another, and once it has run writes stop asking.
+static void test_gc_watermark(void)
+{
+    uint16_t const    first = 53;     // 1007 words, all the room the first page has for them.
+    bool              deleted[GC_RECORDS_MAX];
+    uint16_t          n;
+    uint16_t          run_count;
+    uint32_t          writes;
+    uint32_t          gcs;
+    flash_sim_stats_t before;
+    flash_sim_stats_t after;
+
+    store_clear();
+    for (n = 0; n < first; n++)
+    {
+        op_complete(gc_record_queue(n));
+        deleted[n] = false;
+    }
+    for (uint16_t i = 0; i < first; i += 3)
+    {
+        gc_record_delete(i);
+        deleted[i] = true;
+    }
+
+    // Fill the second page up to the watermark. Each write completes with its own event only.
+    gcs = m_evt_id_count[FDS_EVT_GC];
+    while (free_words() >= FDS_GC_WATERMARK_WORDS + GC_RECORD_WORDS)
+    {
+        op_complete(gc_record_queue(n));
+        deleted[n++] = false;
+    }
+    TEST_ASSERT_EQUAL(gcs, m_evt_id_count[FDS_EVT_GC]);
+    TEST_ASSERT(!gc_op_queued());
+
+    // The first write of the burst crosses the watermark.
+    run_count = m_gc.run_count;
+    writes    = m_evt_id_count[FDS_EVT_WRITE];
+    flash_sim_stats_get(&before);
+    for (uint16_t i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_EQUAL(FDS_SUCCESS, gc_record_queue(n));
+        deleted[n++] = false;
+        TEST_ASSERT(gc_op_queued());
+    }
+    TEST_ASSERT(free_words() < FDS_GC_WATERMARK_WORDS);
+
+    flash_sim_run();
+    flash_sim_stats_get(&after);
+    TEST_ASSERT_EQUAL(writes + 3, m_evt_id_count[FDS_EVT_WRITE]);
+    TEST_ASSERT_EQUAL(gcs + 1, m_evt_id_count[FDS_EVT_GC]);
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, m_evt_result);
+    TEST_ASSERT_EQUAL(run_count + 1, m_gc.run_count);
+    TEST_ASSERT_EQUAL(GC_BEGIN, m_gc.state);
+    TEST_ASSERT(!gc_op_queued());
+    TEST_ASSERT_EQUAL(1, after.erase_ops - before.erase_ops);
+    TEST_ASSERT(free_words() >= FDS_GC_WATERMARK_WORDS);
+    gc_records_check(n, deleted);
+
+    // Back above the watermark, a write does not start GC.
+    op_complete(gc_record_queue(n));
+    deleted[n++] = false;
+    TEST_ASSERT_EQUAL(gcs + 1, m_evt_id_count[FDS_EVT_GC]);
+    TEST_ASSERT_EQUAL(run_count + 1, m_gc.run_count);
+    gc_records_check(n, deleted);
+}
+
+
+// Starts fds again from what is in flash, as after a reset. fstorage has no reset of its own:
+// the operation lost with power is failed back through it, and the GC which issued it is
+// reported as timed out, after which neither module has anything queued.
+static void fds_reset(void)
+{
+    uint32_t count;
+
+    flash_sim_power_restore();
+    flash_sim_fail_next(FS_OP_MAX_RETRIES);
+    fs_sys_event_handler(NRF_EVT_FLASH_OPERATION_ERROR);
+    flash_sim_run();
+    TEST_ASSERT_EQUAL(FS_SUCCESS, fs_queued_op_count_get(&count));
+    TEST_ASSERT_EQUAL(0, count);
+    TEST_ASSERT(!flag_is_set(FDS_FLAG_PROCESSING));
+
+    m_flags         = 0;
+    m_users         = 0;
+    m_latest_rec_id = 0;
+    memset(m_cb_table,    0x00, sizeof(m_cb_table));
+    memset(&m_op_queue,   0x00, sizeof(m_op_queue));
+    memset(&m_chunk_queue, 0x00, sizeof(m_chunk_queue));
+    memset(m_pages,       0x00, sizeof(m_pages));
+    memset(&m_swap_page,  0x00, sizeof(m_swap_page));
+    memset(&m_gc,         0x00, sizeof(m_gc));
+#if (FDS_RAM_INDEX_SIZE > 0)
+    memset(&m_index,      0x00, sizeof(m_index));
+#endif
+#if (FDS_WRITE_BEHIND_SIZE > 0)
+    memset(m_pending,     0x00, sizeof(m_pending));
+#endif
+
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, fds_register(fds_evt_handler));
+    TEST_ASSERT_EQUAL(FDS_SUCCESS, fds_init());
+    flash_sim_run();
+    TEST_ASSERT(flag_is_set(FDS_FLAG_INITIALIZED));
+}
+
+
+// Power is lost after each word GC programs in turn, the tags of the swap and data pages and
+// the page erase included. After the reset every live record is there once, and GC completes.
+static void test_gc_reset(void)
+{
+    uint16_t const count = 40;
+    bool           deleted[GC_RECORDS_MAX];
+    uint32_t       resets = 0;
+
+    for (uint32_t words = 0; ; words++)
+    {
+        store_fill_dirty(count, deleted);
+
+        TEST_ASSERT_EQUAL(FDS_SUCCESS, fds_gc());
+        flash_sim_power_loss_arm(words);
+        flash_sim_run();
+
+        if (!flash_sim_power_lost())
+        {
+            // GC completed before the words ran out.
+            flash_sim_power_restore();
+            gc_records_check(count, deleted);
+            break;
+        }
+
+        fds_reset();
+        resets++;
+        gc_records_check(count, deleted);
+
+        gc_complete();
+        gc_records_check(count, deleted);
+        TEST_ASSERT_EQUAL(2 * (FDS_PAGE_SIZE - FDS_PAGE_TAG_SIZE) -
+                          (count / 2) * GC_RECORD_WORDS, free_words());
+    }
+
+    printf("gc reset at each of %u words: no record lost or duplicated\n", resets);
+
+    store_clear();
+}
+
+
+typedef struct
+{
+    uint32_t gc_us;         // From fds_gc() to its event.
+    uint32_t write_ops;
+    uint32_t erase_ops;
+    uint32_t writes;        // Records written while GC ran.
+    uint32_t stall_us;      // Longest time from queueing a write to its event.
+} gc_figures_t;
+
+
+// Collects the two pages filled by store_fill_dirty(). With streaming set, a new write is
+// queued each time the previous one completes, for as long as GC runs and there is room.
+static void gc_measure(bool single_page, bool streaming, gc_figures_t * p_figures)
+{
+    bool              deleted[GC_RECORDS_MAX];
+    uint16_t const    count = 90;     // 45 records, 855 words, on each page.
+    uint16_t          n     = count;
+    uint32_t const    gcs   = (store_fill_dirty(count, deleted), m_evt_id_count[FDS_EVT_GC]);
+    flash_sim_stats_t before;
+    flash_sim_stats_t after;
+    uint64_t          start;
+    fds_op_t          op    = { .op_code = FDS_OP_GC };
+
+    memset(p_figures, 0x00, sizeof(*p_figures));
+    flash_sim_stats_get(&before);
+    start = flash_sim_time_us();
+
+    // gc_auto_trigger() queues the single page operation.
+    op.gc.single_page = single_page;
+    TEST_ASSERT(op_enqueue(&op, 0, NULL));
+    queue_start();
+
+    while (m_evt_id_count[FDS_EVT_GC] == gcs)
+    {
+        uint32_t const writes = m_evt_id_count[FDS_EVT_WRITE];
+        uint64_t const queued = flash_sim_time_us();
+
+        if (!streaming || (gc_record_queue(n) != FDS_SUCCESS))
+        {
+            flash_sim_run();
+            break;
+        }
+        deleted[n++] = false;
+
+        while (m_evt_id_count[FDS_EVT_WRITE] == writes)
+        {
+            TEST_ASSERT(flash_sim_process());
+        }
+        p_figures->writes++;
+        if (m_evt_time_us - queued > p_figures->stall_us)
+        {
+            p_figures->stall_us = (uint32_t)(m_evt_time_us - queued);
+        }
+    }
+    flash_sim_run();
+
+    flash_sim_stats_get(&after);
+    TEST_ASSERT_EQUAL(gcs + 1, m_evt_id_count[FDS_EVT_GC]);
+    p_figures->gc_us     = (uint32_t)(flash_sim_time_us() - start);
+    p_figures->write_ops = after.write_ops - before.write_ops;
+    p_figures->erase_ops = after.erase_ops - before.erase_ops;
+    gc_records_check(n, deleted);
+}
+
+
+// Longest write stall and flash operations of garbage collection. With no write queued, GC
+// runs as the single-shot fds_gc() did, and a write queued behind it waited for all of it.
+// Times are simulated flash times.
+static void bench_gc(void)
+{
+    gc_figures_t single;
+    gc_figures_t sliced;
+    gc_figures_t one_page;
+    uint64_t     start;
+
+    // One write on its own, to add to the single-shot stall.
+    store_clear();
+    start = flash_sim_time_us();
+    op_complete(gc_record_queue(0));
+    single.stall_us = (uint32_t)(flash_sim_time_us() - start);
+
+    {
+        uint32_t const write_us = single.stall_us;
+
+        gc_measure(false, false, &single);
+        single.stall_us = single.gc_us + write_us;
+    }
+    gc_measure(false, true, &sliced);
+    gc_measure(true,  true, &one_page);
+
+    printf("gc                    ms  writes  flash writes  erases  longest stall ms\n");
+    printf("single-shot fds_gc %5.1f  %6u  %12u  %6u  %16.1f\n",
+           single.gc_us / 1000.0, single.writes, single.write_ops, single.erase_ops,
+           single.stall_us / 1000.0);
+    printf("sliced fds_gc      %5.1f  %6u  %12u  %6u  %16.1f\n",
+           sliced.gc_us / 1000.0, sliced.writes, sliced.write_ops, sliced.erase_ops,
+           sliced.stall_us / 1000.0);
+    printf("watermark, 1 page  %5.1f  %6u  %12u  %6u  %16.1f\n",
+           one_page.gc_us / 1000.0, one_page.writes, one_page.write_ops, one_page.erase_ops,
+           one_page.stall_us / 1000.0);
+
+    TEST_ASSERT(sliced.stall_us < single.stall_us);
+    TEST_ASSERT(one_page.erase_ops < sliced.erase_ops);
+}
+
+
+int main(void)
+{
+    fds_setup();
+    test_index_overflow_and_rebuild();
+    test_write_behind_merge();
+    test_gc_yield_write();
+    test_gc_watermark();
+    test_gc_reset();
+    bench_lookup();
+    bench_gc();
+    TEST_EXIT();
+}
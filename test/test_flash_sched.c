@@ -0,0 +1,167 @@
+/* Host test of flash_sched on a synthetic radio timeline.
+ *
+ * Radio events are replayed through the radio notification stand-in, with time kept by the
+ * host app_timer. For each timeline an erase is requested at a given point of a gap and
+ * retried each time flash_sched resumes its users, as fstorage does. Prints how many gaps
+ * the erase waited and the delay, and checks that erases are only held back when a gap can
+ * hold them.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "unit_test.h"
+#include "nrf_error.h"
+#include "app_timer_host.h"
+#include "ble_radio_notification_host.h"
+#include "flash_sched.h"
+
+#define TICKS_PER_SEC   (32768)
+
+
+static uint32_t m_resumes;
+
+
+static void resume_handler(void)
+{
+    m_resumes++;
+}
+
+
+static void advance_us(uint32_t us)
+{
+    app_timer_host_run(((uint64_t)us * TICKS_PER_SEC + 500000) / 1000000);
+}
+
+
+static void radio_event(uint32_t event_us)
+{
+    ble_radio_notification_host_signal(true);
+    advance_us(event_us);
+    ble_radio_notification_host_signal(false);
+}
+
+
+// Replays radio events every interval_us, each event_us long, and requests an erase offset_us
+// after the end of one. Returns the delay until the erase is allowed, in microseconds.
+static uint32_t erase_delay_us(uint32_t   interval_us,
+                               uint32_t   event_us,
+                               uint32_t   offset_us,
+                               uint32_t * p_gaps)
+{
+    uint64_t start;
+    uint32_t pos;
+    bool     allowed;
+
+    // Let the scheduler forget the previous timeline.
+    advance_us(FLASH_SCHED_IDLE_TIMEOUT_US + interval_us);
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        radio_event(event_us);
+        advance_us(interval_us - event_us);
+    }
+    radio_event(event_us);
+    advance_us(offset_us);
+
+    start    = app_timer_host_ticks();
+    pos      = event_us + offset_us;
+    *p_gaps  = 0;
+    allowed  = flash_sched_erase_allowed();
+
+    while (!allowed && (*p_gaps < 100))
+    {
+        uint32_t const resumes = m_resumes;
+
+        advance_us(interval_us - pos);
+        radio_event(event_us);
+        pos = event_us;
+
+        if (m_resumes != resumes)
+        {
+            (*p_gaps)++;
+            allowed = flash_sched_erase_allowed();
+        }
+    }
+
+    TEST_ASSERT(allowed);
+
+    return (uint32_t)((app_timer_host_ticks() - start) * 1000000 / TICKS_PER_SEC);
+}
+
+
+static void test_erase_timelines(void)
+{
+    static struct
+    {
+        char const * name;
+        uint32_t     interval_us;
+        uint32_t     event_us;
+        uint32_t     offset_us;
+        uint32_t     gaps;          // Expected gaps waited.
+    } const cases[] =
+    {
+        {"conn 7.5 ms",     7500,    1500,   500,    0},
+        {"conn 30 ms",      30000,   2500,   500,    0},
+        {"conn 50 ms",      50000,   2500,   500,    0},
+        {"conn 90 ms",      90000,   2500,   500,    0},
+        {"conn 400 ms",     400000,  2500,   500,    0},
+        {"conn 400 ms late",400000,  2500,   350000, 1},
+        {"adv 500 ms",      500000,  3000,   500,    0},
+        {"adv 500 ms late", 500000,  3000,   450000, 1},
+    };
+
+    printf("timeline          gaps  delay ms\n");
+
+    for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        uint32_t gaps;
+        uint32_t delay = erase_delay_us(cases[i].interval_us,
+                                        cases[i].event_us,
+                                        cases[i].offset_us,
+                                        &gaps);
+
+        printf("%-16s  %4u  %8.1f\n", cases[i].name, gaps, delay / 1000.0);
+        TEST_ASSERT_EQUAL(cases[i].gaps, gaps);
+    }
+}
+
+
+// Writes are still split to fit the gap, and held back while the radio is active.
+static void test_write_words(void)
+{
+    uint16_t words;
+
+    advance_us(FLASH_SCHED_IDLE_TIMEOUT_US + 30000);
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        radio_event(2500);
+        advance_us(30000 - 2500);
+    }
+
+    // 1 ms into a 27.5 ms gap.
+    radio_event(2500);
+    advance_us(1000);
+    words = flash_sched_write_words(1024);
+    TEST_ASSERT(words > 0);
+    TEST_ASSERT(words * FLASH_SCHED_WRITE_WORD_US <= 30000 - 2500 - 1000);
+
+    // During a radio event.
+    ble_radio_notification_host_signal(true);
+    TEST_ASSERT_EQUAL(0, flash_sched_write_words(1024));
+    TEST_ASSERT(!flash_sched_write_allowed(1));
+    advance_us(2500);
+    ble_radio_notification_host_signal(false);
+    TEST_ASSERT(flash_sched_write_allowed(1));
+}
+
+
+int main(void)
+{
+    app_timer_host_reset();
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, flash_sched_init(0));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, flash_sched_register(resume_handler));
+
+    test_erase_timelines();
+    test_write_words();
+    TEST_EXIT();
+}
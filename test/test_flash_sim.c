@@ -0,0 +1,181 @@
+/* Host test of the flash simulator itself.
+ *
+ * The storage tests rely on it behaving like the nRF52 flash behind the SoftDevice: writes
+ * only clear bits, operations complete one at a time with a system event, and power loss or
+ * SoftDevice timeouts are injected where asked.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "unit_test.h"
+#include "flash_sim.h"
+#include "nrf_error.h"
+#include "nrf_soc.h"
+
+#define FLASH_BASE          (0x70000)
+#define FLASH_PAGES         (4)
+#define FIRST_PAGE          (FLASH_BASE / FLASH_SIM_PAGE_SIZE)
+
+
+static uint32_t m_success_count;
+static uint32_t m_error_count;
+
+
+static void sys_evt_handler(uint32_t sys_evt)
+{
+    if (sys_evt == NRF_EVT_FLASH_OPERATION_SUCCESS)
+    {
+        m_success_count++;
+    }
+    else if (sys_evt == NRF_EVT_FLASH_OPERATION_ERROR)
+    {
+        m_error_count++;
+    }
+}
+
+
+static void sim_setup(void)
+{
+    flash_sim_config_t const config =
+    {
+        .base_addr   = FLASH_BASE,
+        .page_count  = FLASH_PAGES,
+        .evt_handler = sys_evt_handler,
+    };
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, flash_sim_init(&config));
+    m_success_count = 0;
+    m_error_count   = 0;
+}
+
+
+static void test_arguments(void)
+{
+    static uint32_t const data = 0;
+    flash_sim_config_t    config = { .base_addr = FLASH_BASE + 4, .page_count = 1 };
+
+    TEST_ASSERT_EQUAL(NRF_ERROR_NULL, flash_sim_init(NULL));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_ADDR, flash_sim_init(&config));
+
+    sim_setup();
+    TEST_ASSERT_EQUAL(0xFFFFFFFF, *(uint32_t *)FLASH_BASE);
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_ADDR, sd_flash_write((uint32_t *)(FLASH_BASE + 2), &data, 1));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_LENGTH, sd_flash_write((uint32_t *)FLASH_BASE, &data, 0));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_LENGTH,
+                      sd_flash_write((uint32_t *)FLASH_BASE, &data, FLASH_SIM_MAX_WRITE_WORDS + 1));
+    TEST_ASSERT_EQUAL(NRF_ERROR_FORBIDDEN,
+                      sd_flash_write((uint32_t *)(FLASH_BASE + FLASH_PAGES * FLASH_SIM_PAGE_SIZE - 4),
+                                     &data, 2));
+    TEST_ASSERT_EQUAL(NRF_ERROR_FORBIDDEN, sd_flash_page_erase(FIRST_PAGE - 1));
+    TEST_ASSERT_EQUAL(NRF_ERROR_FORBIDDEN, sd_flash_page_erase(FIRST_PAGE + FLASH_PAGES));
+}
+
+
+static void test_write_and_erase(void)
+{
+    static uint32_t const first[2]  = {0x12345678, 0xFFFF0000};
+    static uint32_t const second[2] = {0xFFFFFFFF, 0x0000FFFF};
+    static uint32_t const zero      = 0;
+    uint32_t * const      p_flash   = (uint32_t *)(FLASH_BASE + FLASH_SIM_PAGE_SIZE);
+    flash_sim_stats_t     stats;
+
+    sim_setup();
+
+    // Nothing happens until the operation is processed, and only one runs at a time.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_flash_write(p_flash, first, 2));
+    TEST_ASSERT_EQUAL(NRF_ERROR_BUSY, sd_flash_page_erase(FIRST_PAGE));
+    TEST_ASSERT_EQUAL(0xFFFFFFFF, p_flash[0]);
+    TEST_ASSERT(flash_sim_process());
+    TEST_ASSERT(!flash_sim_process());
+    TEST_ASSERT_EQUAL(1, m_success_count);
+    TEST_ASSERT_EQUAL(0x12345678, p_flash[0]);
+    TEST_ASSERT_EQUAL(0xFFFF0000, p_flash[1]);
+
+    // A second write can only clear bits. Both words of it try to set some.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_flash_write(p_flash, second, 2));
+    flash_sim_run();
+    TEST_ASSERT_EQUAL(0x12345678, p_flash[0]);
+    TEST_ASSERT_EQUAL(0x00000000, p_flash[1]);
+
+    // A third write of the same word exceeds the nRF52 limit.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_flash_write(p_flash, &zero, 1));
+    flash_sim_run();
+
+    flash_sim_stats_get(&stats);
+    TEST_ASSERT_EQUAL(3, stats.write_ops);
+    TEST_ASSERT_EQUAL(5, stats.words_written);
+    TEST_ASSERT_EQUAL(2, stats.bit_set_attempts);
+    TEST_ASSERT_EQUAL(1, stats.overwrites);
+    TEST_ASSERT_EQUAL(1, stats.busy_rejects);
+    TEST_ASSERT_EQUAL(5 * FLASH_SIM_WRITE_WORD_US, stats.busy_time_us);
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_flash_page_erase(FIRST_PAGE + 1));
+    flash_sim_run();
+    TEST_ASSERT_EQUAL(0xFFFFFFFF, p_flash[0]);
+    TEST_ASSERT_EQUAL(0xFFFFFFFF, p_flash[1]);
+    TEST_ASSERT_EQUAL(1, flash_sim_page_erase_count(FIRST_PAGE + 1));
+    TEST_ASSERT_EQUAL(0, flash_sim_page_erase_count(FIRST_PAGE));
+    TEST_ASSERT_EQUAL(5 * FLASH_SIM_WRITE_WORD_US + FLASH_SIM_ERASE_PAGE_US, flash_sim_time_us());
+
+    // The write count starts over after an erase.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_flash_write(p_flash, &zero, 1));
+    flash_sim_run();
+    flash_sim_stats_get(&stats);
+    TEST_ASSERT_EQUAL(1, stats.overwrites);
+}
+
+
+static void test_failures(void)
+{
+    static uint32_t const data[4] = {1, 2, 3, 4};
+    uint32_t * const      p_flash = (uint32_t *)FLASH_BASE;
+
+    sim_setup();
+
+    // An operation the SoftDevice gives up on leaves flash untouched.
+    flash_sim_fail_next(1);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_flash_write(p_flash, data, 4));
+    flash_sim_run();
+    TEST_ASSERT_EQUAL(1, m_error_count);
+    TEST_ASSERT_EQUAL(0xFFFFFFFF, p_flash[0]);
+
+    // Power loss stops a write at the armed word, and sends no event.
+    flash_sim_power_loss_arm(2);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_flash_write(p_flash, data, 4));
+    flash_sim_run();
+    TEST_ASSERT(flash_sim_power_lost());
+    TEST_ASSERT_EQUAL(0, m_success_count);
+    TEST_ASSERT_EQUAL(1, p_flash[0]);
+    TEST_ASSERT_EQUAL(2, p_flash[1]);
+    TEST_ASSERT_EQUAL(0xFFFFFFFF, p_flash[2]);
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_STATE, sd_flash_page_erase(FIRST_PAGE));
+
+    // An erase in progress at power loss leaves the page as it was.
+    flash_sim_power_restore();
+    flash_sim_power_loss_arm(0);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_flash_page_erase(FIRST_PAGE));
+    flash_sim_run();
+    TEST_ASSERT(flash_sim_power_lost());
+    TEST_ASSERT_EQUAL(1, p_flash[0]);
+
+    // Flash content survives the reset.
+    flash_sim_power_restore();
+    TEST_ASSERT(!flash_sim_process());
+    TEST_ASSERT_EQUAL(2, p_flash[1]);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_flash_page_erase(FIRST_PAGE));
+    flash_sim_run();
+    TEST_ASSERT_EQUAL(1, m_success_count);
+    TEST_ASSERT_EQUAL(0xFFFFFFFF, p_flash[0]);
+
+    flash_sim_uninit();
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_STATE, sd_flash_page_erase(FIRST_PAGE));
+}
+
+
+int main(void)
+{
+    test_arguments();
+    test_write_and_erase();
+    test_failures();
+    TEST_EXIT();
+}
@@ -0,0 +1,386 @@
+/* Host test of the vibration and LED effects of source/indicate.c.
+ *
+ * The PWM driver is a model of the peripheral, period by period: a sequence is taken from the
+ * SEQ[n] registers of the RAM instance when it starts, its last value raises SEQEND and counts
+ * down LOOP, and at the end the peripheral stops or starts over. Each effect is played and its
+ * output compared, millisecond by millisecond, with the steps it is made of. Checks that the
+ * finite effects end off and stopped, that a new effect cuts the one on the same output and
+ * leaves the other alone, and counts the PWM interrupts. Prints them next to the wakeups of
+ * the app_timer blinking the effects replaced.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unit_test.h"
+#include "nrf_error.h"
+#include "nrf_drv_pwm.h"
+#include "pwm_pattern.h"
+#include "indicate.h"
+
+#define ARRAY_SIZE(a)       (sizeof(a) / sizeof((a)[0]))
+#define STEPS_MAX           (8)
+#define FOREVER_MS          (60000)     // How long the effects played until stopped are run.
+#define AFTER_MS            (50)        // Run after a finite effect, to see it stay off.
+#define ERROR_MAX           (50)        // Half the step of the ramp values, in permille.
+
+typedef struct
+{
+    nrf_drv_pwm_handler_t    handler;
+    NRF_PWM_Type           * p_reg;
+    bool                     active_low;    // As wired: the LED is on when its pin is low.
+    uint32_t                 flags;
+    bool                     running;
+    uint8_t                  seq;
+    uint16_t const         * p_values;      // The sequence playing, as taken from SEQ[seq].
+    uint16_t                 length;
+    uint32_t                 refresh;
+    uint16_t                 index;
+    uint32_t                 repeat;
+    uint16_t                 loops;
+    bool                     stop;
+    bool                     restart;
+    uint8_t                  restart_seq;
+} pwm_model_t;
+
+typedef struct
+{
+    char const         * p_name;
+    pwm_pattern_step_t   steps[STEPS_MAX];
+    uint8_t              step_count;
+    uint16_t             repeats;
+    uint8_t              out;
+    uint32_t             wakeups;
+} effect_t;
+
+#define H   PWM_PATTERN_HOLD
+#define R   PWM_PATTERN_RAMP
+
+// The effects of indicate.c, and the interrupts each takes: one when it stops, and one per
+// segment played for those longer than two segments. Effects played until stopped take none.
+static effect_t const m_effects[INDICATE_COUNT] =
+{
+    {"call",        {R(0, 1000, 200), H(1000, 600), H(0, 400)}, 3, 15, INDICATE_OUT_MOTOR, 1},
+    {"message",     {H(800, 150), H(0, 100), H(800, 150), H(0, 100)}, 4, 1, INDICATE_OUT_MOTOR, 1},
+    {"alarm",       {R(0, 1000, 1000), H(1000, 500), H(0, 300), H(1000, 100), H(0, 100), H(1000, 100),
+                     H(0, 900)}, 7, 30, INDICATE_OUT_MOTOR, 1},
+    {"long sit",    {R(0, 1000, 600), H(1000, 1500), R(1000, 0, 600), H(0, 300)}, 4, 2, INDICATE_OUT_MOTOR, 7},
+    {"led off",     {H(0, 10)}, 1, 1, INDICATE_OUT_LED, 1},
+    {"advertising", {H(1000, 200), H(0, 1800)}, 2, PWM_PATTERN_FOREVER, INDICATE_OUT_LED, 0},
+    {"whitelist",   {H(1000, 200), H(0, 800)}, 2, PWM_PATTERN_FOREVER, INDICATE_OUT_LED, 0},
+    {"slow",        {H(1000, 400), H(0, 4000)}, 2, PWM_PATTERN_FOREVER, INDICATE_OUT_LED, 0},
+    {"directed",    {H(1000, 200), H(0, 200)}, 2, PWM_PATTERN_FOREVER, INDICATE_OUT_LED, 0},
+    {"bonding",     {H(1000, 100), H(0, 100)}, 2, PWM_PATTERN_FOREVER, INDICATE_OUT_LED, 0},
+    {"connected",   {H(1000, 1000)}, 1, PWM_PATTERN_FOREVER, INDICATE_OUT_LED, 0},
+};
+
+static pwm_model_t m_pwm[INDICATE_OUT_COUNT] =
+{
+    {.active_low = false},
+    {.active_low = true},
+};
+
+
+/* The PWM driver, on the model of the peripheral. */
+
+uint32_t nrf_drv_pwm_init(nrf_drv_pwm_t const * const p_instance,
+                          nrf_drv_pwm_config_t const * p_config,
+                          nrf_drv_pwm_handler_t        handler)
+{
+    pwm_model_t * p_pwm = &m_pwm[p_instance->drv_inst_idx];
+
+    p_pwm->handler = handler;
+    p_pwm->p_reg   = p_instance->p_registers;
+    p_pwm->running = false;
+    return NRF_SUCCESS;
+}
+
+
+static void seq_start(pwm_model_t * p_pwm, uint8_t seq)
+{
+    p_pwm->seq      = seq;
+    p_pwm->p_values = (uint16_t const *)(uintptr_t)p_pwm->p_reg->SEQ[seq].PTR;
+    p_pwm->length   = (uint16_t)p_pwm->p_reg->SEQ[seq].CNT;
+    p_pwm->refresh  = p_pwm->p_reg->SEQ[seq].REFRESH;
+    p_pwm->index    = 0;
+    p_pwm->repeat   = 0;
+}
+
+
+static void playback_start(pwm_model_t * p_pwm, uint8_t seq, uint32_t flags)
+{
+    TEST_ASSERT(flags & (NRF_DRV_PWM_FLAG_STOP | NRF_DRV_PWM_FLAG_LOOP));
+    p_pwm->flags   = flags;
+    p_pwm->running = true;
+    p_pwm->stop    = false;
+    p_pwm->restart = false;
+    p_pwm->loops   = (uint16_t)p_pwm->p_reg->LOOP;
+    seq_start(p_pwm, seq);
+}
+
+
+void nrf_drv_pwm_simple_playback(nrf_drv_pwm_t const * const p_instance,
+                                 nrf_pwm_sequence_t const *  p_sequence,
+                                 uint16_t                    playback_count,
+                                 uint32_t                    flags)
+{
+    pwm_model_t * p_pwm = &m_pwm[p_instance->drv_inst_idx];
+    bool const    odd   = (playback_count & 1);
+
+    // Both sequences play it, an odd count starts on SEQ[1].
+    nrf_pwm_sequence_set(p_pwm->p_reg, 0, p_sequence);
+    nrf_pwm_sequence_set(p_pwm->p_reg, 1, p_sequence);
+    nrf_pwm_loop_set(p_pwm->p_reg, playback_count / 2 + odd);
+    p_pwm->restart_seq = odd;
+    playback_start(p_pwm, odd, flags);
+}
+
+
+void nrf_drv_pwm_complex_playback(nrf_drv_pwm_t const * const p_instance,
+                                  nrf_pwm_sequence_t const *  p_sequence_0,
+                                  nrf_pwm_sequence_t const *  p_sequence_1,
+                                  uint16_t                    playback_count,
+                                  uint32_t                    flags)
+{
+    pwm_model_t * p_pwm = &m_pwm[p_instance->drv_inst_idx];
+
+    nrf_pwm_sequence_set(p_pwm->p_reg, 0, p_sequence_0);
+    nrf_pwm_sequence_set(p_pwm->p_reg, 1, p_sequence_1);
+    nrf_pwm_loop_set(p_pwm->p_reg, playback_count);
+    p_pwm->restart_seq = 0;
+    playback_start(p_pwm, 0, flags);
+}
+
+
+bool nrf_drv_pwm_stop(nrf_drv_pwm_t const * const p_instance, bool wait_until_stopped)
+{
+    pwm_model_t * p_pwm = &m_pwm[p_instance->drv_inst_idx];
+
+    if (p_pwm->running)
+    {
+        p_pwm->running = false;
+        p_pwm->handler(NRF_DRV_PWM_EVT_STOPPED);
+    }
+    return true;
+}
+
+
+// Plays one PWM period of 1 ms and returns the time the output was on, in permille.
+static uint16_t pwm_period(pwm_model_t * p_pwm)
+{
+    uint16_t value;
+    uint16_t high;
+
+    if (!p_pwm->running)
+    {
+        return 0;
+    }
+    value = p_pwm->p_values[p_pwm->index];
+    high  = (value & 0x8000) ? (value & 0x7FFF) : (PWM_PATTERN_TOP - (value & 0x7FFF));
+
+    // The last value is loaded: SEQEND, and the end of a loop after SEQ[1].
+    if ((p_pwm->index == p_pwm->length - 1) && (p_pwm->repeat == 0))
+    {
+        uint32_t const signal = p_pwm->seq ? NRF_DRV_PWM_FLAG_SIGNAL_END_SEQ1 : NRF_DRV_PWM_FLAG_SIGNAL_END_SEQ0;
+
+        if (p_pwm->flags & signal)
+        {
+            p_pwm->handler(p_pwm->seq ? NRF_DRV_PWM_EVT_END_SEQ1 : NRF_DRV_PWM_EVT_END_SEQ0);
+        }
+        if ((p_pwm->seq == 1) && (--p_pwm->loops == 0))
+        {
+            if (!(p_pwm->flags & NRF_DRV_PWM_FLAG_NO_EVT_FINISHED))
+            {
+                p_pwm->handler(NRF_DRV_PWM_EVT_FINISHED);
+            }
+            p_pwm->stop    = (p_pwm->flags & NRF_DRV_PWM_FLAG_STOP);
+            p_pwm->restart = !p_pwm->stop;
+        }
+    }
+
+    // STOP takes effect at the end of the period, cutting the repeats of the last value.
+    if (p_pwm->stop)
+    {
+        p_pwm->running = false;
+        p_pwm->handler(NRF_DRV_PWM_EVT_STOPPED);
+    }
+    else if (++p_pwm->repeat > p_pwm->refresh)
+    {
+        p_pwm->repeat = 0;
+        if (++p_pwm->index == p_pwm->length)
+        {
+            if (p_pwm->restart)
+            {
+                p_pwm->restart = false;
+                p_pwm->loops   = (uint16_t)p_pwm->p_reg->LOOP;
+                seq_start(p_pwm, p_pwm->restart_seq);
+            }
+            else
+            {
+                seq_start(p_pwm, p_pwm->seq ^ 1);
+            }
+        }
+    }
+    return p_pwm->active_low ? (PWM_PATTERN_TOP - high) : high;
+}
+
+
+static void run(uint32_t ms)
+{
+    while (ms-- > 0)
+    {
+        (void)pwm_period(&m_pwm[INDICATE_OUT_MOTOR]);
+        (void)pwm_period(&m_pwm[INDICATE_OUT_LED]);
+    }
+}
+
+
+// The duty cycle the steps give at a millisecond, taken at its middle.
+static int32_t effect_duty(effect_t const * p_effect, uint32_t ms)
+{
+    uint32_t start = 0;
+
+    for (uint8_t i = 0; i < p_effect->step_count; i++)
+    {
+        pwm_pattern_step_t const * p_step = &p_effect->steps[i];
+
+        if (ms < start + p_step->ms)
+        {
+            int32_t const span = (int32_t)p_step->to - p_step->from;
+
+            return p_step->from + span * (int32_t)(2 * (ms - start) + 1) / (2 * p_step->ms);
+        }
+        start += p_step->ms;
+    }
+    return 0;
+}
+
+
+static uint32_t effect_ms(effect_t const * p_effect)
+{
+    uint32_t ms = 0;
+
+    for (uint8_t i = 0; i < p_effect->step_count; i++)
+    {
+        ms += p_effect->steps[i].ms;
+    }
+    return ms;
+}
+
+
+// Wakeups of an app_timer driving the output: one per change between on and off, two per
+// 7.8125 ms period of a software PWM at a partial duty cycle, and one per 20 ms ramp value.
+static double app_timer_wakeups(effect_t const * p_effect, uint32_t total_ms)
+{
+    double   wakeups = 0;
+    int32_t  level   = -1;
+    uint32_t t       = 0;
+
+    while (t < total_ms)
+    {
+        for (uint8_t i = 0; (i < p_effect->step_count) && (t < total_ms); i++)
+        {
+            pwm_pattern_step_t const * p_step = &p_effect->steps[i];
+            uint32_t const             ms     = (t + p_step->ms > total_ms) ? (total_ms - t) : p_step->ms;
+
+            if ((p_step->from == p_step->to) && ((p_step->from == 0) || (p_step->from == PWM_PATTERN_TOP)))
+            {
+                wakeups += (p_step->from != level);
+                level    = p_step->from;
+            }
+            else
+            {
+                wakeups += 2.0 * ms / 7.8125 + ms / 20.0;
+                level    = -1;
+            }
+            t += ms;
+        }
+    }
+    return wakeups;
+}
+
+
+static void test_effects(void)
+{
+    indicate_stats_st stats;
+
+    printf("%-12s %8s %6s %5s %10s\n", "effect", "ms", "error", "pwm", "app_timer");
+    for (uint8_t id = 0; id < INDICATE_COUNT; id++)
+    {
+        effect_t const * p_effect = &m_effects[id];
+        pwm_model_t    * p_pwm    = &m_pwm[p_effect->out];
+        uint32_t const   play_ms  = effect_ms(p_effect);
+        uint32_t const   total_ms = p_effect->repeats ? play_ms * p_effect->repeats : FOREVER_MS;
+        uint32_t         wakeups;
+        int32_t          error_max = 0;
+
+        indicate_stop(p_effect->out);
+        indicate_stats_get(&stats);
+        wakeups = stats.wakeups;
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, indicate_play(id));
+        TEST_ASSERT(indicate_is_playing(p_effect->out));
+
+        for (uint32_t t = 0; t < total_ms + AFTER_MS; t++)
+        {
+            int32_t const duty = (t < total_ms) ? effect_duty(p_effect, t % play_ms) : 0;
+            int32_t const out  = pwm_period(p_pwm);
+
+            if ((t < total_ms) || p_effect->repeats)
+            {
+                error_max = (abs(out - duty) > error_max) ? abs(out - duty) : error_max;
+            }
+        }
+        indicate_stats_get(&stats);
+        wakeups = stats.wakeups - wakeups;
+        printf("%-12s %8u %6d %5u %10.0f\n", p_effect->p_name, (unsigned)total_ms, (int)error_max,
+               (unsigned)wakeups, app_timer_wakeups(p_effect, total_ms));
+
+        TEST_ASSERT(error_max <= ERROR_MAX);
+        TEST_ASSERT_EQUAL(p_effect->wakeups, wakeups);
+        TEST_ASSERT_EQUAL(p_effect->repeats != PWM_PATTERN_FOREVER, !indicate_is_playing(p_effect->out));
+    }
+
+    // Stopped, the LED is off.
+    indicate_stop(INDICATE_OUT_LED);
+    TEST_ASSERT(!indicate_is_playing(INDICATE_OUT_LED));
+    TEST_ASSERT_EQUAL(0, pwm_period(&m_pwm[INDICATE_OUT_LED]));
+}
+
+
+static void test_cut(void)
+{
+    indicate_stats_st stats;
+    indicate_stats_st before;
+
+    // A message cuts the call; the LED blinks on.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, indicate_play(INDICATE_LED_BONDING));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, indicate_play(INDICATE_CALL));
+    run(500);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, indicate_play(INDICATE_MESSAGE));
+    TEST_ASSERT_EQUAL(800, pwm_period(&m_pwm[INDICATE_OUT_MOTOR]));
+    run(600);
+    TEST_ASSERT(!indicate_is_playing(INDICATE_OUT_MOTOR));
+    TEST_ASSERT(indicate_is_playing(INDICATE_OUT_LED));
+
+    // No such effect, or output.
+    indicate_stats_get(&before);
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_PARAM, indicate_play(INDICATE_COUNT));
+    indicate_stop(INDICATE_OUT_COUNT);
+    TEST_ASSERT(!indicate_is_playing(INDICATE_OUT_COUNT));
+    TEST_ASSERT(indicate_is_playing(INDICATE_OUT_LED));
+    indicate_stats_get(&stats);
+    TEST_ASSERT_EQUAL(before.plays, stats.plays);
+    TEST_ASSERT_EQUAL(0, stats.errors);
+
+    indicate_stop(INDICATE_OUT_LED);
+}
+
+
+int main(void)
+{
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, indicate_init());
+    test_effects();
+    test_cut();
+    TEST_EXIT();
+}
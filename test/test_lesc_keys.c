@@ -0,0 +1,366 @@
+/* Host test of the LESC key pair of source/common/lesc_keys.c, on pstorage and the flash
+ * simulator.
+ *
+ * Boots with an empty RNG pool and checks that key generation waits for it on a timer, not
+ * by queueing scheduler events in a loop. Then pairs LESC_KEY_MAX_USES + 1 times with the
+ * RFC 5903 responder key and checks each DHKey against the peer side: no pairing writes
+ * flash, the pair is rotated once after the last use, and its record is written once. A
+ * reset loads the new pair without generating one. A peer key off the curve drops the
+ * link. Prints the scheduler events and host time from the DHKey request to the reply.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "unit_test.h"
+#include "app_timer_host.h"
+#include "app_scheduler.h"
+#include "app_error.h"
+#include "flash_sim.h"
+#include "pstorage.h"
+#include "nrf_soc.h"
+#include "ble.h"
+#include "device_manager.h"
+#include "p256.h"
+#include "lesc_keys.h"
+
+#define FLASH_BASE          (0x70000)       // Last 16 pages below the 512 kB of the nRF52832.
+#define FLASH_PAGES         (16)
+#define TICKS_PER_MS        (33)
+#define RNG_POOL_SIZE       (64)            // Bytes the SoftDevice keeps ready.
+#define RNG_BYTES_PER_SEC   (8000)          // About 120 us per byte with bias correction.
+#define EVENTS_MAX          (1000)
+#define RUN_MS_MAX          (1000)
+#define CONN_HANDLE         (0)
+
+#define SCHED_QUEUE_SIZE    (4)
+
+
+static app_sched_event_handler_t m_sched_queue[SCHED_QUEUE_SIZE];
+static uint32_t                  m_sched_count;
+
+static uint32_t                  m_rng_level;
+static uint64_t                  m_rng_ticks;
+static uint32_t                  m_rng_polls;
+
+static ble_gap_lesc_p256_pk_t    m_public_key;
+static uint32_t                  m_public_key_sets;
+static ble_gap_lesc_dhkey_t      m_dhkey;
+static uint32_t                  m_dhkey_replies;
+static uint32_t                  m_disconnects;
+
+// The RFC 5903 responder, as the phone.
+static uint8_t const m_peer_sk[P256_SCALAR_SIZE] =
+{
+    0x53, 0xEE, 0x6B, 0x47, 0x46, 0xAB, 0x83, 0xB2, 0xE0, 0x9B, 0xBF, 0x06, 0x8F, 0x5D, 0x68, 0x88,
+    0x20, 0xCE, 0x97, 0xB3, 0xAC, 0x64, 0x11, 0x01, 0x2A, 0x01, 0xAE, 0x78, 0x5D, 0x9C, 0xEF, 0xC6,
+};
+static ble_gap_lesc_p256_pk_t m_peer_pk;
+
+
+void app_error_handler_bare(ret_code_t error_code)
+{
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, error_code);
+}
+
+
+// The app_scheduler event header holds a 32-bit function pointer, so the queue is played here.
+uint32_t app_sched_event_put(void * p_event_data, uint16_t event_size, app_sched_event_handler_t handler)
+{
+    TEST_ASSERT(m_sched_count < SCHED_QUEUE_SIZE);
+    m_sched_queue[m_sched_count++] = handler;
+    return NRF_SUCCESS;
+}
+
+
+// Runs one queued event, false if there was none.
+static bool sched_run_one(void)
+{
+    app_sched_event_handler_t handler;
+
+    if (m_sched_count == 0)
+    {
+        return false;
+    }
+    handler = m_sched_queue[0];
+    memmove(&m_sched_queue[0], &m_sched_queue[1], --m_sched_count * sizeof(m_sched_queue[0]));
+    handler(NULL, 0);
+    return true;
+}
+
+
+// What the SoftDevice provides on target: an RNG pool that refills with time.
+static void rng_refill(void)
+{
+    uint64_t const now   = app_timer_host_ticks();
+    uint64_t const bytes = (now - m_rng_ticks) * RNG_BYTES_PER_SEC / 32768;
+
+    if (bytes > 0)
+    {
+        m_rng_level = (m_rng_level + bytes > RNG_POOL_SIZE) ? RNG_POOL_SIZE : (uint32_t)(m_rng_level + bytes);
+        m_rng_ticks = now;
+    }
+}
+
+
+uint32_t sd_rand_application_bytes_available_get(uint8_t * p_bytes_available)
+{
+    rng_refill();
+    m_rng_polls++;
+    *p_bytes_available = (uint8_t)m_rng_level;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_rand_application_vector_get(uint8_t * p_buff, uint8_t length)
+{
+    static uint32_t seed = 36;
+
+    rng_refill();
+    if (length > m_rng_level)
+    {
+        return NRF_ERROR_SOC_RAND_NOT_ENOUGH_VALUES;
+    }
+    m_rng_level -= length;
+    while (length-- > 0)
+    {
+        seed      = seed * 1103515245 + 12345;
+        *p_buff++ = (uint8_t)(seed >> 16);
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_lesc_dhkey_reply(uint16_t conn_handle, ble_gap_lesc_dhkey_t const * p_dhkey)
+{
+    TEST_ASSERT_EQUAL(CONN_HANDLE, conn_handle);
+    m_dhkey = *p_dhkey;
+    m_dhkey_replies++;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_disconnect(uint16_t conn_handle, uint8_t hci_status_code)
+{
+    m_disconnects++;
+    return NRF_SUCCESS;
+}
+
+
+// What the Device Manager provides on target.
+ret_code_t dm_lesc_public_key_set(ble_gap_lesc_p256_pk_t * p_public_key)
+{
+    m_public_key = *p_public_key;
+    m_public_key_sets++;
+    return NRF_SUCCESS;
+}
+
+
+// Runs the scheduler, and 1 ms of time when it is idle, until a count is reached. Returns
+// the scheduler events that took.
+static uint32_t run_until(uint32_t const * p_count, uint32_t count)
+{
+    uint32_t events = 0;
+    uint32_t ms     = 0;
+
+    while ((*p_count < count) && (events < EVENTS_MAX) && (ms < RUN_MS_MAX))
+    {
+        if (sched_run_one())
+        {
+            events++;
+        }
+        else
+        {
+            app_timer_host_run(TICKS_PER_MS);
+            flash_sim_run();
+            ms++;
+        }
+    }
+    TEST_ASSERT(*p_count >= count);
+    return events;
+}
+
+
+static void run_idle(void)
+{
+    uint32_t events = 0;
+
+    while (sched_run_one() && (++events < EVENTS_MAX))
+    {
+    }
+    TEST_ASSERT_EQUAL(0, m_sched_count);
+    flash_sim_run();
+}
+
+
+static void gap_evt_send(uint16_t evt_id, ble_gap_lesc_p256_pk_t * p_pk_peer)
+{
+    ble_evt_t evt;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.header.evt_id           = evt_id;
+    evt.evt.gap_evt.conn_handle = CONN_HANDLE;
+    if (p_pk_peer != NULL)
+    {
+        evt.evt.gap_evt.params.lesc_dhkey_request.p_pk_peer = p_pk_peer;
+    }
+    lesc_keys_on_ble_evt(&evt);
+}
+
+
+// A reset: RAM is lost, flash stays.
+static void band_reset(void)
+{
+    flash_sim_run();
+    app_timer_host_reset();
+    m_sched_count = 0;
+    m_rng_level   = 0;
+    m_rng_ticks   = 0;
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_init());
+    lesc_keys_init();
+    flash_sim_run();
+}
+
+
+static double us_now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+
+// One LESC pairing; returns the scheduler events from the DHKey request to the reply.
+static uint32_t pairing(double * p_us)
+{
+    p256_mul_t     ctx;
+    uint8_t        expected[P256_POINT_SIZE];
+    uint32_t const replies = m_dhkey_replies;
+    uint32_t       events;
+    double         start;
+
+    gap_evt_send(BLE_GAP_EVT_SEC_PARAMS_REQUEST, NULL);
+    start  = us_now();
+    gap_evt_send(BLE_GAP_EVT_LESC_DHKEY_REQUEST, &m_peer_pk);
+    events = run_until(&m_dhkey_replies, replies + 1);
+    *p_us  = us_now() - start;
+    gap_evt_send(BLE_GAP_EVT_AUTH_STATUS, NULL);
+
+    // The phone's side of the exchange.
+    TEST_ASSERT(p256_point_valid(m_public_key.pk));
+    if (p256_mul_start(&ctx, m_peer_sk, m_public_key.pk) != NRF_SUCCESS)
+    {
+        return events;
+    }
+    while (!p256_mul_step(&ctx, 256))
+    {
+    }
+    p256_mul_finish(&ctx, expected);
+    TEST_ASSERT_MEMORY(expected, m_dhkey.key, BLE_GAP_LESC_DHKEY_LEN);
+    return events;
+}
+
+
+static void test_boot(void)
+{
+    uint32_t events;
+
+    // Key generation waits for the RNG pool on a timer: a few polls, not one per event.
+    band_reset();
+    events = run_until(&m_public_key_sets, 1);
+    TEST_ASSERT(p256_point_valid(m_public_key.pk));
+    TEST_ASSERT(m_rng_polls <= 3);
+    TEST_ASSERT(events <= 256 / LESC_LADDER_STEPS + 4);
+    printf("key generation: %u scheduler events, %u RNG polls, %.1f ms\n",
+           (unsigned)events, (unsigned)m_rng_polls, app_timer_host_ticks() / 32.768);
+}
+
+
+static void test_pairings(void)
+{
+    flash_sim_stats_t      stats;
+    ble_gap_lesc_p256_pk_t first = m_public_key;
+    double                 us;
+    double                 us_max     = 0;
+    uint32_t               events_max = 0;
+
+    flash_sim_stats_reset();
+    for (uint32_t i = 0; i < LESC_KEY_MAX_USES; i++)
+    {
+        uint32_t const events = pairing(&us);
+
+        events_max = (events > events_max) ? events : events_max;
+        us_max     = (us > us_max) ? us : us_max;
+        if (i < LESC_KEY_MAX_USES - 1)
+        {
+            TEST_ASSERT_EQUAL(0, m_sched_count);
+        }
+    }
+    TEST_ASSERT_EQUAL(256 / LESC_LADDER_STEPS, events_max);
+    TEST_ASSERT_MEMORY(&first, &m_public_key, sizeof(first));
+    flash_sim_stats_get(&stats);
+    TEST_ASSERT_EQUAL(0, stats.write_ops);
+    TEST_ASSERT_EQUAL(0, stats.erase_ops);
+    printf("%u pairings: DHKey reply after %u scheduler events, %.0f us on the host, no flash writes\n",
+           LESC_KEY_MAX_USES, (unsigned)events_max, us_max);
+
+    // The last use starts a new pair; it is handed over and written once.
+    run_until(&m_public_key_sets, 2);
+    TEST_ASSERT(memcmp(&first, &m_public_key, sizeof(first)) != 0);
+    run_idle();
+    flash_sim_stats_get(&stats);
+    TEST_ASSERT(stats.write_ops >= 1);
+    TEST_ASSERT(stats.erase_ops <= 1);
+    printf("rotation: %u flash writes, %u page erases\n", (unsigned)stats.write_ops, (unsigned)stats.erase_ops);
+
+    // The new pair pairs, and a reset loads it as it is.
+    (void)pairing(&us);
+    first = m_public_key;
+    band_reset();
+    TEST_ASSERT_EQUAL(3, m_public_key_sets);
+    TEST_ASSERT_MEMORY(&first, &m_public_key, sizeof(first));
+    TEST_ASSERT_EQUAL(0, m_sched_count);
+    (void)pairing(&us);
+}
+
+
+static void test_invalid_peer(void)
+{
+    ble_gap_lesc_p256_pk_t bad     = m_peer_pk;
+    uint32_t const         replies = m_dhkey_replies;
+
+    bad.pk[P256_SCALAR_SIZE] ^= 1;
+    gap_evt_send(BLE_GAP_EVT_SEC_PARAMS_REQUEST, NULL);
+    gap_evt_send(BLE_GAP_EVT_LESC_DHKEY_REQUEST, &bad);
+    run_until(&m_disconnects, 1);
+    gap_evt_send(BLE_GAP_EVT_DISCONNECTED, NULL);
+    run_idle();
+    TEST_ASSERT_EQUAL(replies, m_dhkey_replies);
+}
+
+
+int main(void)
+{
+    flash_sim_config_t const config =
+    {
+        .base_addr   = FLASH_BASE,
+        .page_count  = FLASH_PAGES,
+        .evt_handler = pstorage_sys_event_handler,
+    };
+    p256_mul_t ctx;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, flash_sim_init(&config));
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, p256_mul_start(&ctx, m_peer_sk, NULL));
+    while (!p256_mul_step(&ctx, 256))
+    {
+    }
+    p256_mul_finish(&ctx, m_peer_pk.pk);
+
+    test_boot();
+    test_pairings();
+    test_invalid_peer();
+    TEST_EXIT();
+}
@@ -0,0 +1,221 @@
+/* Host test of the mem_manager bitmap allocator.
+ *
+ * Checks that blocks are handed out lowest address first from the smallest category that
+ * fits, that exhausted categories fall through to larger ones and are counted, that frees of
+ * addresses which are not reserved block starts are ignored, and that a category of 1024
+ * blocks is served across all its bitmap words. Then prints the cost of a reserve and free
+ * pair as the pool fills up, which stays flat.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "unit_test.h"
+#include "sdk_config.h"
+#include "sdk_errors.h"
+#include "mem_manager.h"
+
+#define CAT_XXSMALL         (0)
+#define CAT_SMALL           (2)
+#define CAT_LARGE           (4)
+#define PAIRS               (200000)
+
+
+static uint8_t * m_large[MEMORY_MANAGER_LARGE_BLOCK_COUNT];
+
+
+static uint8_t * reserve(uint32_t size, uint32_t expected_size)
+{
+    uint8_t * p_buffer = NULL;
+    uint32_t  actual   = size;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, nrf_mem_reserve(&p_buffer, &actual));
+    TEST_ASSERT_EQUAL(expected_size, actual);
+    TEST_ASSERT(p_buffer != NULL);
+
+    return p_buffer;
+}
+
+
+static void stats_check(uint32_t block_cat, uint32_t in_use, uint32_t failures, uint32_t fallthroughs)
+{
+    nrf_mem_block_stats_t stats;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, nrf_mem_stats_get(block_cat, &stats));
+    TEST_ASSERT_EQUAL(in_use, stats.in_use);
+    TEST_ASSERT_EQUAL(failures, stats.failures);
+    TEST_ASSERT_EQUAL(fallthroughs, stats.fallthroughs);
+}
+
+
+static void test_arguments(void)
+{
+    uint8_t             * p_buffer;
+    uint32_t              size = 8;
+    nrf_mem_block_stats_t stats;
+
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_STATE | MEMORY_MANAGER_ERR_BASE, nrf_mem_reserve(&p_buffer, &size));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, nrf_mem_init());
+
+    size = 0;
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_PARAM | MEMORY_MANAGER_ERR_BASE, nrf_mem_reserve(&p_buffer, &size));
+    size = MEMORY_MANAGER_LARGE_BLOCK_SIZE + 1;
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_PARAM | MEMORY_MANAGER_ERR_BASE, nrf_mem_reserve(&p_buffer, &size));
+    TEST_ASSERT_EQUAL(NRF_ERROR_NULL | MEMORY_MANAGER_ERR_BASE, nrf_mem_reserve(NULL, &size));
+    TEST_ASSERT_EQUAL(NRF_ERROR_NULL | MEMORY_MANAGER_ERR_BASE, nrf_mem_stats_get(0, NULL));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_PARAM | MEMORY_MANAGER_ERR_BASE,
+                      nrf_mem_stats_get(NRF_MEM_BLOCK_CAT_COUNT, &stats));
+
+    // Unused categories report no blocks.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, nrf_mem_stats_get(1, &stats));
+    TEST_ASSERT_EQUAL(0, stats.block_count);
+}
+
+
+static void test_fallthrough(void)
+{
+    uint8_t * p_first;
+    uint8_t * p_block;
+    uint8_t * p_small[MEMORY_MANAGER_SMALL_BLOCK_COUNT];
+    uint8_t * p_buffer;
+    uint32_t  size;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, nrf_mem_init());
+
+    // Lowest address first, from the smallest category that fits.
+    p_first = reserve(10, MEMORY_MANAGER_XXSMALL_BLOCK_SIZE);
+    p_block = reserve(16, MEMORY_MANAGER_XXSMALL_BLOCK_SIZE);
+    TEST_ASSERT(p_block == p_first + MEMORY_MANAGER_XXSMALL_BLOCK_SIZE);
+    nrf_free(p_first);
+    TEST_ASSERT(reserve(1, MEMORY_MANAGER_XXSMALL_BLOCK_SIZE) == p_first);
+    stats_check(CAT_XXSMALL, 2, 0, 0);
+
+    // The category spans two bitmap words.
+    for (uint32_t i = 2; i < MEMORY_MANAGER_XXSMALL_BLOCK_COUNT; i++)
+    {
+        p_block = reserve(16, MEMORY_MANAGER_XXSMALL_BLOCK_SIZE);
+        TEST_ASSERT(p_block == p_first + i * MEMORY_MANAGER_XXSMALL_BLOCK_SIZE);
+    }
+
+    // Exhausted: the next request is served by the small category, and counted against xxsmall.
+    p_small[0] = reserve(16, MEMORY_MANAGER_SMALL_BLOCK_SIZE);
+    stats_check(CAT_XXSMALL, MEMORY_MANAGER_XXSMALL_BLOCK_COUNT, 0, 1);
+    stats_check(CAT_SMALL, 1, 0, 0);
+
+    for (uint32_t i = 1; i < MEMORY_MANAGER_SMALL_BLOCK_COUNT; i++)
+    {
+        p_small[i] = reserve(40, MEMORY_MANAGER_SMALL_BLOCK_SIZE);
+    }
+    stats_check(CAT_SMALL, MEMORY_MANAGER_SMALL_BLOCK_COUNT, 0, 0);
+
+    // Then by the large one. A request for a full category with none above it fails.
+    for (uint32_t i = 0; i < MEMORY_MANAGER_LARGE_BLOCK_COUNT; i++)
+    {
+        m_large[i] = reserve(40, MEMORY_MANAGER_LARGE_BLOCK_SIZE);
+    }
+    stats_check(CAT_SMALL, MEMORY_MANAGER_SMALL_BLOCK_COUNT, 0, MEMORY_MANAGER_LARGE_BLOCK_COUNT);
+
+    size = 16;
+    TEST_ASSERT_EQUAL(NRF_ERROR_NO_MEM | MEMORY_MANAGER_ERR_BASE, nrf_mem_reserve(&p_buffer, &size));
+    TEST_ASSERT(nrf_malloc(100) == NULL);
+    stats_check(CAT_XXSMALL, MEMORY_MANAGER_XXSMALL_BLOCK_COUNT, 1, 1);
+    stats_check(CAT_LARGE, MEMORY_MANAGER_LARGE_BLOCK_COUNT, 1, 0);
+
+    // Freed blocks are served again, the smallest fitting category first.
+    nrf_free(p_small[3]);
+    nrf_free(m_large[700]);
+    TEST_ASSERT(reserve(16, MEMORY_MANAGER_SMALL_BLOCK_SIZE) == p_small[3]);
+    TEST_ASSERT(reserve(16, MEMORY_MANAGER_LARGE_BLOCK_SIZE) == m_large[700]);
+
+    nrf_mem_stats_reset();
+    stats_check(CAT_XXSMALL, MEMORY_MANAGER_XXSMALL_BLOCK_COUNT, 0, 0);
+}
+
+
+static void test_free(void)
+{
+    nrf_mem_block_stats_t stats;
+    uint8_t             * p_block;
+    int                   local;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, nrf_mem_init());
+    p_block = reserve(100, MEMORY_MANAGER_LARGE_BLOCK_SIZE);
+    (void)reserve(100, MEMORY_MANAGER_LARGE_BLOCK_SIZE);
+
+    // Not a block start, not managed, or not reserved: ignored.
+    nrf_free(p_block + 1);
+    nrf_free(&local);
+    nrf_free(NULL);
+    nrf_free(p_block + 2 * MEMORY_MANAGER_LARGE_BLOCK_SIZE);
+    stats_check(CAT_LARGE, 2, 0, 0);
+
+    nrf_free(p_block);
+    nrf_free(p_block);
+    stats_check(CAT_LARGE, 1, 0, 0);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, nrf_mem_stats_get(CAT_LARGE, &stats));
+    TEST_ASSERT_EQUAL(2, stats.peak);
+
+    // calloc hands out zeroed memory.
+    memset(p_block, 0xA5, MEMORY_MANAGER_LARGE_BLOCK_SIZE);
+    p_block = nrf_calloc(10, 10);
+    TEST_ASSERT(p_block != NULL);
+    for (uint32_t i = 0; i < MEMORY_MANAGER_LARGE_BLOCK_SIZE; i++)
+    {
+        TEST_ASSERT_EQUAL(0, p_block[i]);
+    }
+}
+
+
+// Reserve and free pairs in the large category with 'filled' of its blocks in use, so each
+// reserve has to skip them. Times are host times; the point is that they stay flat.
+static double pair_ns(uint32_t filled)
+{
+    struct timespec start;
+    struct timespec end;
+    uint32_t        failed = 0;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, nrf_mem_init());
+    for (uint32_t i = 0; i < filled; i++)
+    {
+        m_large[i] = reserve(100, MEMORY_MANAGER_LARGE_BLOCK_SIZE);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < PAIRS; i++)
+    {
+        void * p_block = nrf_malloc(100);
+
+        if (p_block == NULL)
+        {
+            failed++;
+        }
+        nrf_free(p_block);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    TEST_ASSERT_EQUAL(0, failed);
+
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / PAIRS;
+}
+
+
+static void bench_reserve_free(void)
+{
+    static uint32_t const fills[] = {0, 32, 256, 512, 1000, MEMORY_MANAGER_LARGE_BLOCK_COUNT - 1};
+
+    printf("blocks in use  ns per reserve and free\n");
+    for (uint32_t i = 0; i < sizeof(fills) / sizeof(fills[0]); i++)
+    {
+        printf("%13u  %23.0f\n", fills[i], pair_ns(fills[i]));
+    }
+}
+
+
+int main(void)
+{
+    test_arguments();
+    test_fallthrough();
+    test_free();
+    bench_reserve_free();
+    TEST_EXIT();
+}
@@ -0,0 +1,371 @@
+/* Host test of the P-256 arithmetic of source/common/p256.c.
+ *
+ * Checks key generation and ECDH on the RFC 5903 and NIST CAVS P-256 vectors and the SMP
+ * debug key pair of the Bluetooth Core specification, that both sides of random exchanges
+ * agree, and that the result does not depend on how the ladder is split into steps. Checks
+ * the edge scalars 0, 1, 2, n-3, n-2 and n-1, and peer points that are not on the curve.
+ * Then prints the host time of a key generation and of a DHKey, and of the longest scheduler
+ * event at LESC_LADDER_STEPS steps, and how many events a DHKey takes from the request to
+ * the reply.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "unit_test.h"
+#include "nrf_error.h"
+#include "p256.h"
+#include "lesc_keys.h"
+
+#define EXCHANGES           (100)
+#define BENCH_MULS          (50)
+
+typedef struct
+{
+    char const * p_name;
+    char const * p_sk;          // Big endian hex, as printed in the documents.
+    char const * p_pk_x;
+    char const * p_pk_y;
+    char const * p_peer_x;
+    char const * p_peer_y;
+    char const * p_dhkey;       // X of the shared point.
+} vector_t;
+
+static vector_t const m_vectors[] =
+{
+    {
+        "RFC 5903 i",
+        "C88F01F510D9AC3F70A292DAA2316DE544E9AAB8AFE84049C62A9C57862D1433",
+        "DAD0B65394221CF9B051E1FECA5787D098DFE637FC90B9EF945D0C3772581180",
+        "5271A0461CDB8252D61F1C456FA3E59AB1F45B33ACCF5F58389E0577B8990BB3",
+        "D12DFB5289C8D4F81208B70270398C342296970A0BCCB74C736FC7554494BF63",
+        "56FBF3CA366CC23E8157854C13C58D6AAC23F046ADA30F8353E74F33039872AB",
+        "D6840F6B42F6EDAFD13116E0E12565202FEF8E9ECE7DCE03812464D04B9442DE",
+    },
+    {
+        "RFC 5903 r",
+        "C6EF9C5D78AE012A011164ACB397CE2088685D8F06BF9BE0B283AB46476BEE53",
+        "D12DFB5289C8D4F81208B70270398C342296970A0BCCB74C736FC7554494BF63",
+        "56FBF3CA366CC23E8157854C13C58D6AAC23F046ADA30F8353E74F33039872AB",
+        "DAD0B65394221CF9B051E1FECA5787D098DFE637FC90B9EF945D0C3772581180",
+        "5271A0461CDB8252D61F1C456FA3E59AB1F45B33ACCF5F58389E0577B8990BB3",
+        "D6840F6B42F6EDAFD13116E0E12565202FEF8E9ECE7DCE03812464D04B9442DE",
+    },
+    {
+        "CAVS 0",
+        "7D7DC5F71EB29DDAF80D6214632EEAE03D9058AF1FB6D22ED80BADB62BC1A534",
+        "EAD218590119E8876B29146FF89CA61770C4EDBBF97D38CE385ED281D8A6B230",
+        "28AF61281FD35E2FA7002523ACC85A429CB06EE6648325389F59EDFCE1405141",
+        "700C48F77F56584C5CC632CA65640DB91B6BACCE3A4DF6B42CE7CC838833D287",
+        "DB71E509E3FD9B060DDB20BA5C51DCC5948D46FBF640DFE0441782CAB85FA4AC",
+        "46FC62106420FF012E54A434FBDD2D25CCC5852060561E68040DD7778997BD7B",
+    },
+    {
+        "SMP debug",
+        "3F49F6D4A3C55F3874C9B3E3D2103F504AFF607BEB40B7995899B8A6CD3C1ABD",
+        "20B003D2F297BE2C5E2C83A7E9F9A5B9EFF49111ACF4FDDBCC0301480E359DE6",
+        "DC809C49652AEB6D63329ABF5A52155C766345C28FED3024741C8ED01589D28B",
+        NULL, NULL, NULL,
+    },
+};
+
+static char const m_n[]  = "FFFFFFFF00000000FFFFFFFFFFFFFFFFBCE6FAADA7179E84F3B9CAC2FC632551";
+static char const m_p[]  = "FFFFFFFF00000001000000000000000000000000FFFFFFFFFFFFFFFFFFFFFFFF";
+static char const m_gx[] = "6B17D1F2E12C4247F8BCE6E563A440F277037D812DEB33A0F4A13945D898C296";
+static char const m_gy[] = "4FE342E2FE1A7F9B8EE7EB4A7C0F9E162BCE33576B315ECECBB6406837BF51F5";
+
+static uint32_t m_seed;
+
+
+// 64 hex digits, big endian, to 32 bytes little endian as SMP sends them.
+static void hex_le(uint8_t * p_out, char const * p_hex)
+{
+    for (uint8_t i = 0; i < P256_SCALAR_SIZE; i++)
+    {
+        unsigned int byte;
+
+        sscanf(&p_hex[2 * (P256_SCALAR_SIZE - 1 - i)], "%2x", &byte);
+        p_out[i] = (uint8_t)byte;
+    }
+}
+
+
+// Adds a small number to a little endian scalar, negative to subtract.
+static void scalar_add(uint8_t * p_k, int32_t value)
+{
+    int32_t carry = value;
+
+    for (uint8_t i = 0; i < P256_SCALAR_SIZE; i++)
+    {
+        carry  += p_k[i];
+        p_k[i]  = (uint8_t)carry;
+        carry >>= 8;
+    }
+}
+
+
+static void random_scalar(uint8_t * p_k)
+{
+    for (uint8_t i = 0; i < P256_SCALAR_SIZE; i++)
+    {
+        m_seed = m_seed * 1103515245 + 12345;
+        p_k[i] = (uint8_t)(m_seed >> 16);
+    }
+    p_k[P256_SCALAR_SIZE - 1] &= 0x7F;      // Below n.
+}
+
+
+// k * point, point NULL for the base point, in steps of the given size.
+static uint32_t mul(uint8_t * p_out, uint8_t const * p_k, uint8_t const * p_point, uint16_t steps)
+{
+    p256_mul_t ctx;
+    uint32_t   err_code;
+    uint16_t   events = 0;
+
+    err_code = p256_mul_start(&ctx, p_k, p_point);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+    while (!p256_mul_step(&ctx, steps))
+    {
+        events++;
+    }
+    TEST_ASSERT_EQUAL((256 + steps - 1) / steps - 1, events);
+    p256_mul_finish(&ctx, p_out);
+    TEST_ASSERT_EQUAL(-1, ctx.bit);
+    return NRF_SUCCESS;
+}
+
+
+static void test_vectors(void)
+{
+    for (uint8_t v = 0; v < sizeof(m_vectors) / sizeof(m_vectors[0]); v++)
+    {
+        vector_t const * p_vector = &m_vectors[v];
+        uint8_t          sk[P256_SCALAR_SIZE];
+        uint8_t          expected[P256_POINT_SIZE];
+        uint8_t          point[P256_POINT_SIZE];
+
+        hex_le(sk, p_vector->p_sk);
+        TEST_ASSERT(p256_scalar_valid(sk));
+
+        hex_le(expected, p_vector->p_pk_x);
+        hex_le(expected + P256_SCALAR_SIZE, p_vector->p_pk_y);
+        TEST_ASSERT(p256_point_valid(expected));
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, mul(point, sk, NULL, LESC_LADDER_STEPS));
+        TEST_ASSERT_MEMORY(expected, point, P256_POINT_SIZE);
+
+        if (p_vector->p_peer_x != NULL)
+        {
+            uint8_t peer[P256_POINT_SIZE];
+
+            hex_le(peer, p_vector->p_peer_x);
+            hex_le(peer + P256_SCALAR_SIZE, p_vector->p_peer_y);
+            hex_le(expected, p_vector->p_dhkey);
+            TEST_ASSERT_EQUAL(NRF_SUCCESS, mul(point, sk, peer, LESC_LADDER_STEPS));
+            TEST_ASSERT_MEMORY(expected, point, P256_SCALAR_SIZE);
+        }
+        printf("%-10s ok\n", p_vector->p_name);
+    }
+}
+
+
+// Both sides agree, and the steps per event do not change the result.
+static void test_exchanges(void)
+{
+    m_seed = 36;
+    for (uint32_t i = 0; i < EXCHANGES; i++)
+    {
+        uint8_t a[P256_SCALAR_SIZE];
+        uint8_t b[P256_SCALAR_SIZE];
+        uint8_t pk_a[P256_POINT_SIZE];
+        uint8_t pk_b[P256_POINT_SIZE];
+        uint8_t dh_a[P256_POINT_SIZE];
+        uint8_t dh_b[P256_POINT_SIZE];
+
+        random_scalar(a);
+        random_scalar(b);
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, mul(pk_a, a, NULL, 256));
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, mul(pk_b, b, NULL, 1 + i % 40));
+        TEST_ASSERT(p256_point_valid(pk_a));
+        TEST_ASSERT(p256_point_valid(pk_b));
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, mul(dh_a, a, pk_b, LESC_LADDER_STEPS));
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, mul(dh_b, b, pk_a, 7));
+        TEST_ASSERT_MEMORY(dh_a, dh_b, P256_POINT_SIZE);
+    }
+}
+
+
+static void test_edges(void)
+{
+    uint8_t    k[P256_SCALAR_SIZE];
+    uint8_t    point[P256_POINT_SIZE];
+    uint8_t    three_g[P256_POINT_SIZE];
+    uint8_t    twice_peer[P256_POINT_SIZE];
+    uint8_t    sum[P256_SCALAR_SIZE];
+    uint8_t    p[P256_SCALAR_SIZE];
+    p256_mul_t ctx;
+
+    // 0 and 1; with 1, n-2 and n-1 the ladder would meet the point at infinity.
+    memset(k, 0, sizeof(k));
+    TEST_ASSERT(!p256_scalar_valid(k));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_PARAM, p256_mul_start(&ctx, k, NULL));
+    k[0] = 1;
+    TEST_ASSERT(!p256_scalar_valid(k));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_PARAM, p256_mul_start(&ctx, k, NULL));
+    k[0] = 2;
+    TEST_ASSERT(p256_scalar_valid(k));
+
+    hex_le(k, m_n);
+    TEST_ASSERT(!p256_scalar_valid(k));
+    scalar_add(k, -1);
+    TEST_ASSERT(!p256_scalar_valid(k));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_PARAM, p256_mul_start(&ctx, k, NULL));
+    scalar_add(k, -1);
+    TEST_ASSERT(!p256_scalar_valid(k));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_PARAM, p256_mul_start(&ctx, k, NULL));
+    memset(k, 0xFF, sizeof(k));
+    TEST_ASSERT(!p256_scalar_valid(k));
+
+    // n-3 is the last scalar taken: (n-3)G = -3G, the same X and Y = p - Y(3G).
+    hex_le(k, m_n);
+    scalar_add(k, -3);
+    TEST_ASSERT(p256_scalar_valid(k));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, mul(point, k, NULL, LESC_LADDER_STEPS));
+    memset(k, 0, sizeof(k));
+    k[0] = 3;
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, mul(three_g, k, NULL, LESC_LADDER_STEPS));
+    TEST_ASSERT_MEMORY(three_g, point, P256_SCALAR_SIZE);
+    memcpy(sum, point + P256_SCALAR_SIZE, sizeof(sum));
+    {
+        uint16_t carry = 0;
+
+        for (uint8_t i = 0; i < P256_SCALAR_SIZE; i++)
+        {
+            carry  += sum[i] + three_g[P256_SCALAR_SIZE + i];
+            sum[i]  = (uint8_t)carry;
+            carry >>= 8;
+        }
+    }
+    hex_le(p, m_p);
+    TEST_ASSERT_MEMORY(p, sum, P256_SCALAR_SIZE);
+
+    // 2 is the first scalar taken, and G given as a peer point is the base point.
+    memset(k, 0, sizeof(k));
+    k[0] = 2;
+    hex_le(point, m_gx);
+    hex_le(point + P256_SCALAR_SIZE, m_gy);
+    TEST_ASSERT(p256_point_valid(point));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, mul(twice_peer, k, point, LESC_LADDER_STEPS));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, mul(point, k, NULL, LESC_LADDER_STEPS));
+    TEST_ASSERT_MEMORY(point, twice_peer, P256_POINT_SIZE);
+}
+
+
+static void test_invalid_points(void)
+{
+    uint8_t    k[P256_SCALAR_SIZE];
+    uint8_t    point[P256_POINT_SIZE];
+    p256_mul_t ctx;
+
+    hex_le(k, m_vectors[0].p_sk);
+
+    // Off the curve by one.
+    hex_le(point, m_gx);
+    hex_le(point + P256_SCALAR_SIZE, m_gy);
+    point[P256_SCALAR_SIZE] ^= 1;
+    TEST_ASSERT(!p256_point_valid(point));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_DATA, p256_mul_start(&ctx, k, point));
+
+    // The point at infinity as some stacks send it.
+    memset(point, 0, sizeof(point));
+    TEST_ASSERT(!p256_point_valid(point));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_DATA, p256_mul_start(&ctx, k, point));
+
+    // Coordinates not below p.
+    hex_le(point, m_p);
+    hex_le(point + P256_SCALAR_SIZE, m_gy);
+    TEST_ASSERT(!p256_point_valid(point));
+    memset(point, 0xFF, sizeof(point));
+    TEST_ASSERT(!p256_point_valid(point));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_DATA, p256_mul_start(&ctx, k, point));
+
+    // X of G with the Y of another point.
+    hex_le(point, m_gx);
+    hex_le(point + P256_SCALAR_SIZE, m_vectors[0].p_pk_y);
+    TEST_ASSERT(!p256_point_valid(point));
+}
+
+
+static double elapsed_us(struct timespec const * p_start, struct timespec const * p_end)
+{
+    return (p_end->tv_sec - p_start->tv_sec) * 1e6 + (p_end->tv_nsec - p_start->tv_nsec) / 1e3;
+}
+
+
+// Host times; the events are what the target schedules, each of LESC_LADDER_STEPS steps.
+static void bench_mul(void)
+{
+    uint8_t         k[P256_SCALAR_SIZE];
+    uint8_t         peer[P256_POINT_SIZE];
+    uint8_t         point[P256_POINT_SIZE];
+    double          keygen_us = 0;
+    double          dhkey_us  = 0;
+    double          event_us  = 0;
+    uint16_t        events    = 0;
+    struct timespec start;
+    struct timespec end;
+
+    hex_le(peer, m_vectors[0].p_pk_x);
+    hex_le(peer + P256_SCALAR_SIZE, m_vectors[0].p_pk_y);
+    m_seed = 5903;
+
+    for (uint32_t i = 0; i < BENCH_MULS; i++)
+    {
+        p256_mul_t ctx;
+
+        random_scalar(k);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        (void)mul(point, k, NULL, 256);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        keygen_us += elapsed_us(&start, &end) / BENCH_MULS;
+
+        // A DHKey as lesc_keys runs it: the check of the peer key, then one event per chunk.
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        (void)p256_mul_start(&ctx, k, peer);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        dhkey_us += elapsed_us(&start, &end) / BENCH_MULS;
+        events    = 0;
+        for (bool done = false; !done; events++)
+        {
+            struct timespec event_start;
+
+            clock_gettime(CLOCK_MONOTONIC, &event_start);
+            done = p256_mul_step(&ctx, LESC_LADDER_STEPS);
+            if (done)
+            {
+                p256_mul_finish(&ctx, point);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            dhkey_us += elapsed_us(&event_start, &end) / BENCH_MULS;
+            event_us  = (elapsed_us(&event_start, &end) > event_us) ? elapsed_us(&event_start, &end) : event_us;
+        }
+    }
+
+    TEST_ASSERT_EQUAL(256 / LESC_LADDER_STEPS, events);
+    printf("host key generation %.0f us, DHKey %.0f us in %u events of %u steps, longest event %.0f us\n",
+           keygen_us, dhkey_us, events, LESC_LADDER_STEPS, event_us);
+}
+
+
+int main(void)
+{
+    test_vectors();
+    test_exchanges();
+    test_edges();
+    test_invalid_points();
+    bench_mul();
+    TEST_EXIT();
+}
@@ -0,0 +1,261 @@
+/* Host test of the pstorage layout check on top of the flash simulator.
+ *
+ * Checks that pages written with another layout are erased at init, log pages included,
+ * that loads return erased data and commands wait until then, that a reset during the erase
+ * starts it over, and that pages written with the current layout are kept.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "unit_test.h"
+#include "flash_sim.h"
+#include "pstorage.h"
+#include "nrf_soc.h"
+
+#define FLASH_BASE          (0x70000)   // Last 16 pages below the 512 kB of the nRF52832.
+#define FLASH_PAGES         (16)
+#define FLASH_END           (0x80000)
+#define PAGE_SIZE           (4096)
+#define BLOCK_SIZE          (16)
+#define BLOCK_COUNT         (4)
+
+
+static pstorage_handle_t m_handle;
+static uint32_t          m_evt_count;
+static uint32_t          m_evt_result;
+static uint8_t           m_evt_op_code;
+
+
+static void pstorage_cb(pstorage_handle_t * p_handle,
+                        uint8_t             op_code,
+                        uint32_t            result,
+                        uint8_t           * p_data,
+                        uint32_t            data_len)
+{
+    if (op_code != PSTORAGE_LOAD_OP_CODE)
+    {
+        m_evt_count++;
+        m_evt_result  = result;
+        m_evt_op_code = op_code;
+    }
+}
+
+
+// Writes data the way an older layout would have left it.
+static void flash_fill(uint32_t addr, uint32_t words, uint32_t value)
+{
+    static uint32_t buf[PAGE_SIZE / sizeof(uint32_t)];
+
+    for (uint32_t i = 0; i < words; i++)
+    {
+        buf[i] = value + i;
+    }
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_flash_write((uint32_t *)addr, buf, words));
+    flash_sim_run();
+}
+
+
+static bool page_is_erased(uint32_t addr)
+{
+    uint32_t const * p_word = (uint32_t const *)addr;
+
+    for (uint32_t i = 0; i < PAGE_SIZE / sizeof(uint32_t); i++)
+    {
+        if (p_word[i] != 0xFFFFFFFF)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Initializes the module as after a reset, and registers one module.
+static void storage_init(void)
+{
+    pstorage_module_param_t param =
+    {
+        .cb          = pstorage_cb,
+        .block_size  = BLOCK_SIZE,
+        .block_count = BLOCK_COUNT,
+    };
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_init());
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_register(&param, &m_handle));
+}
+
+
+static void block_load(uint16_t n, uint32_t * p_dest)
+{
+    pstorage_handle_t block;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_block_identifier_get(&m_handle, n, &block));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_load((uint8_t *)p_dest, &block, BLOCK_SIZE, 0));
+}
+
+
+static void pending_check(uint32_t expected)
+{
+    uint32_t count;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_access_status_get(&count));
+    TEST_ASSERT_EQUAL(expected, count);
+}
+
+
+static void test_reserved_pages(void)
+{
+    // The Keil project ends the application where the reserved pages start.
+    TEST_ASSERT_EQUAL(FLASH_END - (PSTORAGE_RESERVED_PAGES * PAGE_SIZE), PSTORAGE_REMAP_LOG_ADDR);
+    TEST_ASSERT_EQUAL(0x7A000, PSTORAGE_REMAP_LOG_ADDR);
+    TEST_ASSERT_EQUAL(FLASH_END - PAGE_SIZE, PSTORAGE_SWAP_ADDR);
+}
+
+
+static void test_foreign_layout_erased(void)
+{
+    static uint32_t   data[BLOCK_SIZE / sizeof(uint32_t)] = {0x11111111, 0x22222222, 0x33333333, 0x44444444};
+    uint32_t          loaded[BLOCK_SIZE / sizeof(uint32_t)];
+    pstorage_handle_t block;
+
+    // An older build: a log page with a one word header, followed by a record, and data pages
+    // starting one page lower than the current layout.
+    flash_fill(PSTORAGE_REMAP_LOG_ADDR, 1, 0x00000001);
+    flash_fill(PSTORAGE_REMAP_LOG_ADDR + 4, 7, 0x5A5A0000);
+    flash_fill(PSTORAGE_REMAP_LOG_ADDR + PAGE_SIZE, 64, 0x5A5A0000);
+    for (uint32_t addr = PSTORAGE_DATA_START_ADDR; addr < FLASH_END; addr += PAGE_SIZE)
+    {
+        flash_fill(addr, 64, addr);
+    }
+
+    storage_init();
+    pending_check(1);
+
+    // The old data is not handed out while it is being erased.
+    block_load(0, loaded);
+    TEST_ASSERT_EQUAL(0xFFFFFFFF, loaded[0]);
+    TEST_ASSERT_EQUAL(0xFFFFFFFF, loaded[3]);
+
+    // A store is queued behind the erase.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_block_identifier_get(&m_handle, 1, &block));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_store(&block, (uint8_t *)data, BLOCK_SIZE, 0));
+    pending_check(2);
+    TEST_ASSERT_EQUAL(0, m_evt_count);
+
+    flash_sim_run();
+    pending_check(0);
+    TEST_ASSERT_EQUAL(1, m_evt_count);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, m_evt_result);
+    TEST_ASSERT_EQUAL(PSTORAGE_STORE_OP_CODE, m_evt_op_code);
+
+    for (uint32_t page = PSTORAGE_REMAP_LOG_ADDR / PAGE_SIZE; page < FLASH_END / PAGE_SIZE; page++)
+    {
+        TEST_ASSERT_EQUAL(1, flash_sim_page_erase_count(page));
+    }
+    TEST_ASSERT_EQUAL(0, flash_sim_page_erase_count(PSTORAGE_REMAP_LOG_ADDR / PAGE_SIZE - 1));
+    TEST_ASSERT(page_is_erased(PSTORAGE_REMAP_LOG_ADDR + PAGE_SIZE));
+    TEST_ASSERT(page_is_erased(PSTORAGE_SWAP_ADDR));
+
+    block_load(0, loaded);
+    TEST_ASSERT_EQUAL(0xFFFFFFFF, loaded[0]);
+    block_load(1, loaded);
+    TEST_ASSERT_MEMORY(data, loaded, BLOCK_SIZE);
+}
+
+
+static void test_current_layout_kept(void)
+{
+    static uint32_t   data[BLOCK_SIZE / sizeof(uint32_t)] = {0xA1, 0xA2, 0xA3, 0xA4};
+    uint32_t          loaded[BLOCK_SIZE / sizeof(uint32_t)];
+    pstorage_handle_t block;
+    flash_sim_stats_t stats;
+
+    flash_sim_stats_reset();
+    storage_init();
+    pending_check(0);
+
+    flash_sim_stats_get(&stats);
+    TEST_ASSERT_EQUAL(0, stats.erase_ops);
+    block_load(1, loaded);
+    TEST_ASSERT_EQUAL(0x11111111, loaded[0]);
+
+    // Updates go through the log and survive a reset.
+    m_evt_count = 0;
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_block_identifier_get(&m_handle, 1, &block));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_update(&block, (uint8_t *)data, BLOCK_SIZE, 0));
+    flash_sim_run();
+    TEST_ASSERT_EQUAL(1, m_evt_count);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, m_evt_result);
+
+    storage_init();
+    pending_check(0);
+    block_load(1, loaded);
+    TEST_ASSERT_MEMORY(data, loaded, BLOCK_SIZE);
+    flash_sim_stats_get(&stats);
+    TEST_ASSERT_EQUAL(0, stats.erase_ops);
+}
+
+
+static void test_reset_during_erase(void)
+{
+    static uint32_t const zero = 0;
+    uint32_t              loaded[BLOCK_SIZE / sizeof(uint32_t)];
+
+    // Clear the layout word of both log pages, as a build with another layout would see them.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_flash_write((uint32_t *)PSTORAGE_REMAP_LOG_ADDR + 1, &zero, 1));
+    flash_sim_run();
+    TEST_ASSERT_EQUAL(NRF_SUCCESS,
+                      sd_flash_write((uint32_t *)(PSTORAGE_REMAP_LOG_ADDR + PAGE_SIZE) + 1, &zero, 1));
+    flash_sim_run();
+
+    flash_sim_stats_reset();
+    storage_init();
+    pending_check(1);
+
+    // Power is lost after both log pages and the first data page are erased.
+    TEST_ASSERT(flash_sim_process());
+    TEST_ASSERT(flash_sim_process());
+    TEST_ASSERT(flash_sim_process());
+    flash_sim_power_loss_arm(0);
+    (void)flash_sim_process();
+    TEST_ASSERT(flash_sim_power_lost());
+    flash_sim_power_restore();
+
+    // With no log header written, the erase starts over.
+    storage_init();
+    pending_check(1);
+    block_load(1, loaded);
+    TEST_ASSERT_EQUAL(0xFFFFFFFF, loaded[0]);
+    flash_sim_run();
+    pending_check(0);
+
+    for (uint32_t page = PSTORAGE_REMAP_LOG_ADDR / PAGE_SIZE; page < FLASH_END / PAGE_SIZE; page++)
+    {
+        TEST_ASSERT(flash_sim_page_erase_count(page) >= 1);
+    }
+    block_load(1, loaded);
+    TEST_ASSERT_EQUAL(0xFFFFFFFF, loaded[0]);
+    TEST_ASSERT_EQUAL(0xFFFFFFFF, *((uint32_t *)PSTORAGE_DATA_START_ADDR + (BLOCK_SIZE / 4)));
+
+    storage_init();
+    pending_check(0);
+}
+
+
+int main(void)
+{
+    flash_sim_config_t const config =
+    {
+        .base_addr   = FLASH_BASE,
+        .page_count  = FLASH_PAGES,
+        .evt_handler = pstorage_sys_event_handler,
+    };
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, flash_sim_init(&config));
+
+    test_reserved_pages();
+    test_foreign_layout_erased();
+    test_current_layout_kept();
+    test_reset_during_erase();
+    TEST_EXIT();
+}
@@ -0,0 +1,217 @@
+/* Host test of the PWM pattern compiler of components/libraries/pwm_pattern.
+ *
+ * Checks the values of holds and ramps, the polarity bit, how steps share segments on the
+ * greatest common divisor of their ticks and when they start a new one, that the segments
+ * play for the length of the pattern, and the errors on bad steps and on patterns that do
+ * not fit. Prints the layout of the patterns checked.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "unit_test.h"
+#include "nrf_error.h"
+#include "pwm_pattern.h"
+
+#define ARRAY_SIZE(a)       (sizeof(a) / sizeof((a)[0]))
+#define FALLING_EDGE        (0x8000)
+
+#define PATTERN(steps, repeats)     {steps, ARRAY_SIZE(steps), repeats}
+
+
+static pwm_pattern_compiled_t m_compiled;
+
+
+// Compiles and checks that the segments follow each other and last as long as the pattern.
+static uint32_t compile(char const * p_name, pwm_pattern_t const * p_pattern, bool active_low)
+{
+    uint32_t err_code;
+    uint32_t ms    = 0;
+    uint16_t first = 0;
+
+    memset(&m_compiled, 0xA5, sizeof(m_compiled));
+    err_code = pwm_pattern_compile(p_pattern, active_low, &m_compiled);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    printf("%-10s %u segments, %3u values:", p_name, m_compiled.segment_count, m_compiled.value_count);
+    for (uint8_t i = 0; i < m_compiled.segment_count; i++)
+    {
+        pwm_pattern_segment_t const * p_segment = &m_compiled.segments[i];
+
+        printf(" %u x %u ms", p_segment->length, (unsigned)p_segment->refresh + 1);
+        TEST_ASSERT_EQUAL(first, p_segment->first);
+        TEST_ASSERT(p_segment->length <= PWM_PATTERN_SEGMENT_VALUES_MAX);
+        first += p_segment->length;
+        ms    += p_segment->length * (p_segment->refresh + 1);
+    }
+    printf("\n");
+    TEST_ASSERT_EQUAL(m_compiled.value_count, first);
+    TEST_ASSERT_EQUAL(m_compiled.duration_ms, ms);
+    TEST_ASSERT_EQUAL(p_pattern->repeats, m_compiled.repeats);
+    return NRF_SUCCESS;
+}
+
+
+static void test_values(void)
+{
+    static pwm_pattern_step_t const call[] =
+    {
+        PWM_PATTERN_RAMP(0, 1000, 200), PWM_PATTERN_HOLD(1000, 600), PWM_PATTERN_HOLD(0, 400),
+    };
+    static pwm_pattern_step_t const fall[]  = {PWM_PATTERN_RAMP(1000, 0, 200)};
+    static pwm_pattern_step_t const short_ramp[] = {PWM_PATTERN_RAMP(0, 1000, 30)};
+    pwm_pattern_t const call_pattern  = PATTERN(call, 15);
+    pwm_pattern_t const fall_pattern  = PATTERN(fall, 1);
+    pwm_pattern_t const short_pattern = PATTERN(short_ramp, 1);
+    uint16_t            rise[10];
+
+    // Motor: on at the compare value from a low start. A ramp takes the middle of each tick.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, compile("call", &call_pattern, false));
+    TEST_ASSERT_EQUAL(1, m_compiled.segment_count);
+    TEST_ASSERT_EQUAL(60, m_compiled.value_count);
+    TEST_ASSERT_EQUAL(19, m_compiled.segments[0].refresh);
+    TEST_ASSERT_EQUAL(1200, m_compiled.duration_ms);
+    for (uint16_t k = 0; k < 10; k++)
+    {
+        TEST_ASSERT_EQUAL((50 + 100 * k) | FALLING_EDGE, m_compiled.values[k]);
+    }
+    for (uint16_t k = 10; k < 40; k++)
+    {
+        TEST_ASSERT_EQUAL(1000 | FALLING_EDGE, m_compiled.values[k]);
+    }
+    for (uint16_t k = 40; k < 60; k++)
+    {
+        TEST_ASSERT_EQUAL(0 | FALLING_EDGE, m_compiled.values[k]);
+    }
+    TEST_ASSERT_EQUAL(FALLING_EDGE, pwm_pattern_off_value(false));
+
+    // LED: the same duty cycles without the polarity bit.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, compile("call led", &call_pattern, true));
+    memcpy(rise, m_compiled.values, sizeof(rise));
+    for (uint16_t k = 0; k < 10; k++)
+    {
+        TEST_ASSERT_EQUAL(50 + 100 * k, rise[k]);
+    }
+    TEST_ASSERT_EQUAL(0, pwm_pattern_off_value(true));
+
+    // A ramp reversed gives the same values in reverse.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, compile("fall", &fall_pattern, true));
+    TEST_ASSERT_EQUAL(10, m_compiled.value_count);
+    for (uint16_t k = 0; k < 10; k++)
+    {
+        TEST_ASSERT_EQUAL(rise[9 - k], m_compiled.values[k]);
+    }
+
+    // A ramp that is not a multiple of the ramp tick is held on the common divisor.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, compile("30 ms ramp", &short_pattern, true));
+    TEST_ASSERT_EQUAL(3, m_compiled.value_count);
+    TEST_ASSERT_EQUAL(9, m_compiled.segments[0].refresh);
+    TEST_ASSERT_EQUAL(166, m_compiled.values[0]);
+    TEST_ASSERT_EQUAL(500, m_compiled.values[1]);
+    TEST_ASSERT_EQUAL(833, m_compiled.values[2]);
+}
+
+
+static void test_segments(void)
+{
+    static pwm_pattern_step_t const alarm[] =
+    {
+        PWM_PATTERN_RAMP(0, 1000, 1000), PWM_PATTERN_HOLD(1000, 500), PWM_PATTERN_HOLD(0, 300),
+        PWM_PATTERN_HOLD(1000, 100), PWM_PATTERN_HOLD(0, 100), PWM_PATTERN_HOLD(1000, 100),
+        PWM_PATTERN_HOLD(0, 900),
+    };
+    static pwm_pattern_step_t const long_sit[] =
+    {
+        PWM_PATTERN_RAMP(0, 1000, 600), PWM_PATTERN_HOLD(1000, 1500), PWM_PATTERN_RAMP(1000, 0, 600),
+        PWM_PATTERN_HOLD(0, 300),
+    };
+    static pwm_pattern_step_t const blink[] = {PWM_PATTERN_HOLD(1000, 400), PWM_PATTERN_HOLD(0, 4000)};
+    pwm_pattern_t const alarm_pattern    = PATTERN(alarm, 30);
+    pwm_pattern_t const long_sit_pattern = PATTERN(long_sit, 2);
+    pwm_pattern_t const blink_pattern    = PATTERN(blink, PWM_PATTERN_FOREVER);
+
+    // The holds after the ramp would take it past 64 values at 20 ms; they share 100 ms.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, compile("alarm", &alarm_pattern, false));
+    TEST_ASSERT_EQUAL(2, m_compiled.segment_count);
+    TEST_ASSERT_EQUAL(50, m_compiled.segments[0].length);
+    TEST_ASSERT_EQUAL(19, m_compiled.segments[0].refresh);
+    TEST_ASSERT_EQUAL(20, m_compiled.segments[1].length);
+    TEST_ASSERT_EQUAL(99, m_compiled.segments[1].refresh);
+    TEST_ASSERT_EQUAL(3000, m_compiled.duration_ms);
+
+    // The long hold is one value between the ramps; the last hold joins the falling ramp.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, compile("long sit", &long_sit_pattern, false));
+    TEST_ASSERT_EQUAL(3, m_compiled.segment_count);
+    TEST_ASSERT_EQUAL(30, m_compiled.segments[0].length);
+    TEST_ASSERT_EQUAL(1, m_compiled.segments[1].length);
+    TEST_ASSERT_EQUAL(1499, m_compiled.segments[1].refresh);
+    TEST_ASSERT_EQUAL(45, m_compiled.segments[2].length);
+    TEST_ASSERT_EQUAL(19, m_compiled.segments[2].refresh);
+    TEST_ASSERT_EQUAL(76, m_compiled.value_count);
+
+    // Holds share the common divisor of their lengths.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, compile("blink", &blink_pattern, true));
+    TEST_ASSERT_EQUAL(1, m_compiled.segment_count);
+    TEST_ASSERT_EQUAL(11, m_compiled.value_count);
+    TEST_ASSERT_EQUAL(399, m_compiled.segments[0].refresh);
+    TEST_ASSERT_EQUAL(1000, m_compiled.values[0]);
+    TEST_ASSERT_EQUAL(0, m_compiled.values[1]);
+    TEST_ASSERT_EQUAL(PWM_PATTERN_FOREVER, m_compiled.repeats);
+}
+
+
+static void test_errors(void)
+{
+    static pwm_pattern_step_t const zero[]    = {PWM_PATTERN_HOLD(1000, 100), PWM_PATTERN_HOLD(0, 0)};
+    static pwm_pattern_step_t const odd[]     = {PWM_PATTERN_HOLD(1000, 15)};
+    static pwm_pattern_step_t const over[]    = {PWM_PATTERN_HOLD(1001, 100)};
+    static pwm_pattern_step_t const over_to[] = {PWM_PATTERN_RAMP(0, 1001, 100)};
+    static pwm_pattern_step_t const ramps[]   =
+    {
+        PWM_PATTERN_RAMP(0, 1000, 1000), PWM_PATTERN_RAMP(1000, 0, 1000), PWM_PATTERN_RAMP(0, 1000, 1000),
+    };
+    pwm_pattern_step_t  steps[PWM_PATTERN_SEGMENTS_MAX + 1];
+    pwm_pattern_t const none         = {NULL, 1, 1};
+    pwm_pattern_t const empty        = {zero, 0, 1};
+    pwm_pattern_t const zero_pattern = PATTERN(zero, 1);
+    pwm_pattern_t const odd_pattern  = PATTERN(odd, 1);
+    pwm_pattern_t const over_pattern = PATTERN(over, 1);
+    pwm_pattern_t const to_pattern   = PATTERN(over_to, 1);
+    pwm_pattern_t const ramp_pattern = PATTERN(ramps, 1);
+    pwm_pattern_t       seg_pattern  = {steps, PWM_PATTERN_SEGMENTS_MAX, 1};
+
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_PARAM, compile("no steps", &none, false));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_PARAM, compile("empty", &empty, false));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_PARAM, compile("0 ms", &zero_pattern, false));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_PARAM, compile("15 ms", &odd_pattern, false));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_PARAM, compile("over", &over_pattern, false));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_PARAM, compile("over to", &to_pattern, false));
+
+    // 150 ramp values do not fit.
+    TEST_ASSERT_EQUAL(NRF_ERROR_NO_MEM, compile("ramps", &ramp_pattern, false));
+
+    // Short and long holds in turn do not share a segment: eight fit, nine do not.
+    for (uint8_t i = 0; i < ARRAY_SIZE(steps); i++)
+    {
+        pwm_pattern_step_t const step = (i & 1) ? (pwm_pattern_step_t)PWM_PATTERN_HOLD(0, 650)
+                                                : (pwm_pattern_step_t)PWM_PATTERN_HOLD(1000, 10);
+
+        steps[i] = step;
+    }
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, compile("8 holds", &seg_pattern, false));
+    TEST_ASSERT_EQUAL(PWM_PATTERN_SEGMENTS_MAX, m_compiled.segment_count);
+    seg_pattern.step_count = ARRAY_SIZE(steps);
+    TEST_ASSERT_EQUAL(NRF_ERROR_NO_MEM, compile("9 holds", &seg_pattern, false));
+}
+
+
+int main(void)
+{
+    test_values();
+    test_segments();
+    test_errors();
+    TEST_EXIT();
+}
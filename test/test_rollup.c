@@ -0,0 +1,346 @@
+/* Host test of the minute/hour/day rollup of source/rollup.c, on pstorage and the flash
+ * simulator.
+ *
+ * Feeds 40 days of minutes, step records and sleep records, with a reset in the middle of a
+ * day, and checks every day and hour of the last 30 against a reference built from the same
+ * records: only the hour in progress at the reset may be lost. Checks that flash words are
+ * written once between erases, that a clock set back neither closes the day nor erases a
+ * block, and that a day already closed is reopened as it is. Then prints the cost of GET_DAY
+ * and GET_HOUR from the rollup against a scan of the raw 8-byte step records.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "unit_test.h"
+#include "flash_sim.h"
+#include "pstorage.h"
+#include "nrf_soc.h"
+#include "sleep_stage.h"
+#include "rollup.h"
+
+#define FLASH_BASE          (0x70000)       // Last 16 pages below the 512 kB of the nRF52832.
+#define FLASH_PAGES         (16)
+#define DAYS                (40)
+#define QUERY_DAYS          (30)
+#define RESET_DAY           (20)
+#define RESET_MINUTE        (12 * 60 + 30)
+#define DAY_SEC             (86400)
+#define START               (1700006400)    // A local midnight.
+
+
+typedef struct
+{
+    uint32_t utc;
+    uint16_t steps;
+    uint8_t  cadence;
+    uint8_t  type;
+} raw_record_t;                             // A STEP_DATA record as the band logs it.
+
+
+static raw_record_t m_raw[DAYS * 1440];
+static uint32_t     m_raw_count;
+static uint32_t     m_ref_day[DAYS];
+static uint16_t     m_ref_active[DAYS];
+static uint32_t     m_ref_hour[DAYS][24];
+static uint32_t     m_lost_steps;
+static uint16_t     m_lost_active;
+static uint32_t     m_seed;
+
+
+static uint32_t random_below(uint32_t n)
+{
+    m_seed = m_seed * 1103515245 + 12345;
+    return (m_seed >> 16) % n;
+}
+
+
+static double ns_now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+
+// A reset: RAM is lost, flash and what was queued before it stay.
+static void band_reset(void)
+{
+    flash_sim_run();
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_init());
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, rollup_init());
+    flash_sim_run();
+}
+
+
+static void days_feed(void)
+{
+    m_seed = 7;
+
+    for (uint32_t d = 0; d < DAYS; d++)
+    {
+        for (uint32_t m = 0; m < 1440; m++)
+        {
+            uint32_t const utc  = START + d * DAY_SEC + m * 60;
+            uint32_t const hour = m / 60;
+            uint8_t const  hr   = ((hour >= 9 && hour < 11) || hour == 20) ? 60 + random_below(40) : 0;
+            uint16_t const steps = (hour >= 7 && hour < 22 && random_below(4) == 0) ? 20 + random_below(100) : 0;
+
+            rollup_minute(utc, hr);
+            if (steps)
+            {
+                rollup_steps(utc, steps);
+                m_raw[m_raw_count].utc   = utc;
+                m_raw[m_raw_count].steps = steps;
+                m_raw_count++;
+
+                m_ref_day[d] += steps;
+                m_ref_active[d]++;
+                m_ref_hour[d][hour] += steps;
+                if ((d == RESET_DAY) && (hour == RESET_MINUTE / 60) && (m < RESET_MINUTE))
+                {
+                    m_lost_steps += steps;
+                    m_lost_active++;
+                }
+            }
+            if (m == 7 * 60)
+            {
+                rollup_sleep(300, SLEEP_STAGE_LIGHT);
+                rollup_sleep(120, SLEEP_STAGE_DEEP);
+            }
+            flash_sim_run();
+
+            if ((d == RESET_DAY) && (m == RESET_MINUTE))
+            {
+                band_reset();
+            }
+        }
+    }
+
+    // The next minute closes the last day.
+    rollup_minute(START + DAYS * DAY_SEC, 0);
+    flash_sim_run();
+}
+
+
+static void test_days_and_hours(void)
+{
+    rollup_stats_st   rollup;
+    flash_sim_stats_t flash;
+
+    days_feed();
+    rollup_stats_get(&rollup);
+    flash_sim_stats_get(&flash);
+    printf("%u days, %u raw records (%u B); flash writes %u, erases %u\n",
+           DAYS, m_raw_count, m_raw_count * (uint32_t)sizeof(raw_record_t), flash.write_ops, flash.erase_ops);
+
+    TEST_ASSERT_EQUAL(0, rollup.errors);
+    TEST_ASSERT_EQUAL(0, rollup.late);
+    TEST_ASSERT_EQUAL(0, flash.bit_set_attempts);
+    TEST_ASSERT_EQUAL(0, flash.overwrites);
+
+    band_reset();
+
+    for (uint32_t d = DAYS - QUERY_DAYS; d < DAYS; d++)
+    {
+        rollup_day_st day;
+        bool const    reset_day = (d == RESET_DAY);
+
+        TEST_ASSERT(rollup_day_get(START + d * DAY_SEC + 3600, &day));
+        TEST_ASSERT_EQUAL(m_ref_day[d] - (reset_day ? m_lost_steps : 0), day.steps);
+        TEST_ASSERT_EQUAL(m_ref_active[d] - (reset_day ? m_lost_active : 0), day.active_minutes);
+        // The sleep of the reset day was in RAM when the band reset.
+        TEST_ASSERT_EQUAL(reset_day ? 0 : 420, day.sleep_minutes);
+        TEST_ASSERT_EQUAL(reset_day ? 0 : 120, day.deep_minutes);
+        TEST_ASSERT(day.heart_rate >= 60 && day.heart_rate < 100);
+        TEST_ASSERT(day.heart_rate_min >= 60 && day.heart_rate_min <= day.heart_rate);
+
+        for (uint32_t h = 0; h < 24; h++)
+        {
+            rollup_hour_st hour;
+            bool const     found = rollup_hour_get(START + d * DAY_SEC + h * 3600, &hour);
+
+            if (reset_day && (h == RESET_MINUTE / 60))
+            {
+                TEST_ASSERT_EQUAL(m_ref_hour[d][h] - m_lost_steps, found ? hour.steps : 0);
+            }
+            else
+            {
+                TEST_ASSERT_EQUAL(m_ref_hour[d][h], found ? hour.steps : 0);
+            }
+        }
+    }
+
+    // Older days are gone from the ring.
+    {
+        rollup_day_st day;
+
+        TEST_ASSERT(!rollup_day_get(START + (DAYS - ROLLUP_DAYS - 1) * DAY_SEC, &day));
+    }
+}
+
+
+static void test_clock_set_back(void)
+{
+    uint32_t const    today = START + DAYS * DAY_SEC;
+    rollup_stats_st   before;
+    rollup_stats_st   after;
+    flash_sim_stats_t flash;
+    rollup_day_st     day;
+    rollup_hour_st    hour;
+
+    // Some steps at 10:00 today, then the clock goes back to yesterday evening.
+    rollup_steps(today + 10 * 3600, 100);
+    rollup_minute(today + 11 * 3600, 0);
+    flash_sim_run();
+    rollup_stats_get(&before);
+    flash_sim_stats_reset();
+
+    rollup_minute(today - 3600, 70);
+    rollup_steps(today - 3600, 50);
+    rollup_minute(today + 9 * 3600, 0);
+    flash_sim_run();
+
+    rollup_stats_get(&after);
+    flash_sim_stats_get(&flash);
+    TEST_ASSERT_EQUAL(before.days, after.days);
+    TEST_ASSERT_EQUAL(before.late + 50, after.late);
+    TEST_ASSERT_EQUAL(0, flash.erase_ops);
+    TEST_ASSERT(rollup_day_get(today, &day));
+    TEST_ASSERT_EQUAL(100, day.steps);
+
+    // After a reset on a day already closed, the block is used as it is: no erase, the hours
+    // already written kept, and the empty ones filled in. The summary is not written again.
+    flash_sim_stats_reset();
+    band_reset();
+    rollup_minute(today - DAY_SEC + 23 * 3600, 0);
+    rollup_steps(today - DAY_SEC + 23 * 3600, 40);
+    rollup_minute(today - DAY_SEC + 23 * 3600 + 60, 0);
+    rollup_minute(today - DAY_SEC + 22 * 3600, 0);
+    rollup_steps(today - DAY_SEC + 22 * 3600, 30);
+    flash_sim_run();
+
+    flash_sim_stats_get(&flash);
+    TEST_ASSERT_EQUAL(0, flash.erase_ops);
+    TEST_ASSERT_EQUAL(0, flash.bit_set_attempts);
+    TEST_ASSERT(rollup_hour_get(today - DAY_SEC + 10 * 3600, &hour));
+    TEST_ASSERT_EQUAL(m_ref_hour[DAYS - 1][10], hour.steps);
+    TEST_ASSERT(rollup_day_get(today - DAY_SEC, &day));
+    TEST_ASSERT_EQUAL(m_ref_day[DAYS - 1] + 40, day.steps);
+    TEST_ASSERT_EQUAL(420, day.sleep_minutes);
+
+    // Going forward again closes that day without writing its summary twice, and today is
+    // reopened with its steps.
+    rollup_minute(today + 12 * 3600, 0);
+    flash_sim_run();
+    flash_sim_stats_get(&flash);
+    TEST_ASSERT_EQUAL(0, flash.erase_ops);
+    TEST_ASSERT_EQUAL(0, flash.bit_set_attempts);
+    TEST_ASSERT(rollup_day_get(today, &day));
+    TEST_ASSERT_EQUAL(100, day.steps);
+
+    band_reset();
+    TEST_ASSERT(rollup_day_get(today - DAY_SEC, &day));
+    TEST_ASSERT_EQUAL(m_ref_day[DAYS - 1] + 40, day.steps);
+}
+
+
+static uint32_t raw_steps(uint32_t from, uint32_t length)
+{
+    uint32_t steps = 0;
+
+    for (uint32_t i = 0; i < m_raw_count; i++)
+    {
+        if ((m_raw[i].utc >= from) && (m_raw[i].utc < from + length))
+        {
+            steps += m_raw[i].steps;
+        }
+    }
+    return steps;
+}
+
+
+static void bench_queries(void)
+{
+    uint32_t const  days  = QUERY_DAYS - 1;     // Closed days; today is still open.
+    uint32_t const  hours = days * 24;
+    rollup_stats_st before;
+    rollup_stats_st after;
+    uint32_t        day_reads;
+    uint32_t        hour_reads;
+    double          day_ns       = 0;
+    double          hour_ns      = 0;
+    double          scan_day_ns  = 0;
+    double          scan_hour_ns = 0;
+    uint32_t        sum          = 0;
+
+    rollup_stats_get(&before);
+    for (uint32_t d = DAYS - QUERY_DAYS; d < DAYS - 1; d++)
+    {
+        uint32_t const utc = START + d * DAY_SEC;
+        rollup_day_st  day;
+        double         t   = ns_now();
+
+        TEST_ASSERT(rollup_day_get(utc, &day));
+        day_ns += ns_now() - t;
+        sum    += day.steps;
+
+        t = ns_now();
+        sum += raw_steps(utc, DAY_SEC);
+        scan_day_ns += ns_now() - t;
+    }
+    rollup_stats_get(&after);
+    day_reads = after.flash_reads - before.flash_reads;
+
+    before = after;
+    for (uint32_t h = 0; h < hours; h++)
+    {
+        uint32_t const utc = START + (DAYS - QUERY_DAYS) * DAY_SEC + h * 3600;
+        rollup_hour_st hour;
+        double         t   = ns_now();
+
+        if (rollup_hour_get(utc, &hour))
+        {
+            sum += hour.steps;
+        }
+        hour_ns += ns_now() - t;
+
+        t = ns_now();
+        sum += raw_steps(utc, 3600);
+        scan_hour_ns += ns_now() - t;
+    }
+    rollup_stats_get(&after);
+    hour_reads = after.flash_reads - before.flash_reads;
+    TEST_ASSERT(sum > 0);
+
+    printf("query     rollup ns  flash reads  raw scan ns  raw bytes\n");
+    printf("GET_DAY   %9.0f  %11.2f  %11.0f  %9u\n", day_ns / days, (double)day_reads / days,
+           scan_day_ns / days, m_raw_count * (uint32_t)sizeof(raw_record_t));
+    printf("GET_HOUR  %9.0f  %11.2f  %11.0f  %9u\n", hour_ns / hours, (double)hour_reads / hours,
+           scan_hour_ns / hours, m_raw_count * (uint32_t)sizeof(raw_record_t));
+
+    // Day queries never read flash; hour queries read one 4-byte record.
+    TEST_ASSERT_EQUAL(0, day_reads);
+    TEST_ASSERT_EQUAL(hours, hour_reads);
+}
+
+
+int main(void)
+{
+    flash_sim_config_t const config =
+    {
+        .base_addr   = FLASH_BASE,
+        .page_count  = FLASH_PAGES,
+        .evt_handler = pstorage_sys_event_handler,
+    };
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, flash_sim_init(&config));
+    band_reset();
+
+    test_days_and_hours();
+    test_clock_set_back();
+    bench_queries();
+    TEST_EXIT();
+}
@@ -0,0 +1,286 @@
+/* Host test of the online sleep staging of source/sleep_stage.c.
+ *
+ * Builds labelled synthetic nights minute by minute: three awake hours, seven to eight hours
+ * of light and deep sleep cycles with short awakenings, then an hour and a half awake. Awake
+ * minutes have activity and a higher heart rate, deep minutes almost none and the lowest.
+ * Feeds every night with and without heart rate, rebuilds the stage of every minute from the
+ * records, and checks the agreement with the labels and that each night is one sleep. Also
+ * checks that a gap in the data ends a sleep, and the record encoding. Then prints the
+ * confusion matrix and the cost per minute.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "unit_test.h"
+#include "sleep_stage.h"
+
+#define NIGHTS              (30)
+#define NIGHT_MINUTES_MAX   (1440)
+#define DAY_START           (1700006400)    // A local midnight.
+#define PREDICTED_NONE      (3)             // Minutes outside every record.
+
+
+typedef struct
+{
+    uint32_t minutes;
+    uint32_t agree;
+    uint32_t sleep;                         // Minutes labelled light or deep.
+    uint32_t sleep_found;                   // Of those, staged light or deep.
+    uint32_t wake;
+    uint32_t wake_found;
+    uint32_t sessions;
+    uint32_t confusion[3][3];               // Label rows, stage columns: wake, light, deep.
+    double   ns;
+} night_result_t;
+
+
+static uint8_t  m_label[NIGHT_MINUTES_MAX];
+static uint16_t m_activity[NIGHT_MINUTES_MAX];
+static uint8_t  m_heart_rate[NIGHT_MINUTES_MAX];
+static uint8_t  m_predicted[NIGHT_MINUTES_MAX];
+static uint32_t m_seed;
+
+
+static uint32_t random_below(uint32_t n)
+{
+    m_seed = m_seed * 1103515245 + 12345;
+    return (m_seed >> 16) % n;
+}
+
+
+static void label_fill(uint32_t * p_m, uint32_t end, uint32_t length, uint8_t stage)
+{
+    for (uint32_t i = 0; (i < length) && (*p_m < end); i++)
+    {
+        m_label[(*p_m)++] = stage;
+    }
+}
+
+
+// Returns the number of minutes in the night.
+static uint32_t night_build(uint32_t night, bool with_hr)
+{
+    uint32_t m = 0;
+    uint32_t sleep_end;
+
+    m_seed = night * 7919 + 1;
+
+    label_fill(&m, NIGHT_MINUTES_MAX, 180, SLEEP_STAGE_WAKE);
+    sleep_end = m + 420 + random_below(60);
+    while (m < sleep_end)
+    {
+        label_fill(&m, sleep_end, 20 + random_below(20), SLEEP_STAGE_LIGHT);
+        label_fill(&m, sleep_end, 15 + random_below(30), SLEEP_STAGE_DEEP);
+        label_fill(&m, sleep_end, 10 + random_below(20), SLEEP_STAGE_LIGHT);
+        if (random_below(3) == 0)
+        {
+            label_fill(&m, sleep_end, 2 + random_below(6), SLEEP_STAGE_WAKE);
+        }
+    }
+    label_fill(&m, NIGHT_MINUTES_MAX, 90, SLEEP_STAGE_WAKE);
+
+    for (uint32_t i = 0; i < m; i++)
+    {
+        switch (m_label[i])
+        {
+            case SLEEP_STAGE_WAKE:
+                m_activity[i]   = (random_below(5) == 0) ? random_below(15) : 15 + random_below(400);
+                m_heart_rate[i] = 70 + random_below(15);
+                break;
+
+            case SLEEP_STAGE_LIGHT:
+                m_activity[i]   = (random_below(6) == 0) ? random_below(12) : 0;
+                m_heart_rate[i] = 58 + random_below(8);
+                break;
+
+            default:
+                m_activity[i]   = (random_below(40) == 0) ? random_below(4) : 0;
+                m_heart_rate[i] = 50 + random_below(6);
+                break;
+        }
+        if (!with_hr)
+        {
+            m_heart_rate[i] = 0;
+        }
+    }
+
+    return m;
+}
+
+
+static void records_apply(uint32_t count)
+{
+    sleep_record_st record;
+
+    while (sleep_record_get(&record))
+    {
+        uint32_t const start = (record.utc - DAY_START) / 60;
+
+        TEST_ASSERT(record.stage <= SLEEP_STAGE_DEEP);
+        for (uint32_t k = 0; (k < record.minutes) && (start + k < count); k++)
+        {
+            m_predicted[start + k] = record.stage;
+        }
+    }
+}
+
+
+static void nights_run(bool with_hr, night_result_t * p_result)
+{
+    memset(p_result, 0, sizeof(*p_result));
+
+    for (uint32_t night = 0; night < NIGHTS; night++)
+    {
+        uint32_t const count = night_build(night, with_hr);
+        sleep_stats_st stats;
+
+        memset(m_predicted, PREDICTED_NONE, sizeof(m_predicted));
+        sleep_stage_init();
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            struct timespec start;
+            struct timespec end;
+
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            sleep_stage_minute(DAY_START + i * 60, m_activity[i], m_heart_rate[i]);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            p_result->ns += (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+
+            // Drained every minute, as the main loop does.
+            records_apply(count);
+        }
+
+        // Half an hour later: the gap closes whatever is still open.
+        sleep_stage_minute(DAY_START + (count + 30) * 60, 0, 0);
+        records_apply(count);
+        TEST_ASSERT_EQUAL(SLEEP_STAGE_NONE, sleep_stage_current());
+
+        sleep_stage_stats_get(&stats);
+        TEST_ASSERT_EQUAL(count + 1, stats.minutes);
+        TEST_ASSERT_EQUAL(0, stats.records_lost);
+        p_result->sessions += stats.sessions;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint8_t const stage = (m_predicted[i] == PREDICTED_NONE) ? SLEEP_STAGE_WAKE : m_predicted[i];
+
+            p_result->confusion[m_label[i]][stage]++;
+            p_result->minutes++;
+            p_result->agree += (stage == m_label[i]);
+            if (m_label[i] == SLEEP_STAGE_WAKE)
+            {
+                p_result->wake++;
+                p_result->wake_found += (stage == SLEEP_STAGE_WAKE);
+            }
+            else
+            {
+                p_result->sleep++;
+                p_result->sleep_found += (stage != SLEEP_STAGE_WAKE);
+            }
+        }
+    }
+}
+
+
+static void result_print(char const * p_name, night_result_t const * p_result)
+{
+    printf("%s: %u minutes, 3-class %.1f%%, sleep %.1f%%, wake %.1f%%, %u sessions, %.0f ns/minute\n",
+           p_name, p_result->minutes,
+           100.0 * p_result->agree / p_result->minutes,
+           100.0 * p_result->sleep_found / p_result->sleep,
+           100.0 * p_result->wake_found / p_result->wake,
+           p_result->sessions, p_result->ns / p_result->minutes);
+    printf("  label  wake  light   deep\n");
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        printf("  %5s %5u %6u %6u\n", (char const *[]){"wake", "light", "deep"}[i],
+               p_result->confusion[i][0], p_result->confusion[i][1], p_result->confusion[i][2]);
+    }
+}
+
+
+static void test_nights(void)
+{
+    night_result_t result;
+
+    // With heart rate the deep minutes are told from the light ones.
+    nights_run(true, &result);
+    result_print("with heart rate", &result);
+    TEST_ASSERT_EQUAL(NIGHTS, result.sessions);
+    TEST_ASSERT(result.sleep_found * 1000 >= result.sleep * 985);
+    TEST_ASSERT(result.wake_found * 1000 >= result.wake * 995);
+    TEST_ASSERT(result.agree * 1000 >= result.minutes * 970);
+
+    // Without it, still light minutes are often called deep.
+    nights_run(false, &result);
+    result_print("without heart rate", &result);
+    TEST_ASSERT_EQUAL(NIGHTS, result.sessions);
+    TEST_ASSERT(result.sleep_found * 1000 >= result.sleep * 985);
+    TEST_ASSERT(result.wake_found * 1000 >= result.wake * 995);
+    TEST_ASSERT(result.agree * 1000 >= result.minutes * 800);
+    TEST_ASSERT(result.confusion[SLEEP_STAGE_DEEP][SLEEP_STAGE_DEEP] * 100 >=
+                (result.confusion[SLEEP_STAGE_DEEP][0] + result.confusion[SLEEP_STAGE_DEEP][1] +
+                 result.confusion[SLEEP_STAGE_DEEP][2]) * 95);
+}
+
+
+static void test_gap_ends_sleep(void)
+{
+    sleep_record_st record;
+    sleep_stats_st  stats;
+    uint32_t        minute = 0;
+    uint32_t        slept  = 0;
+
+    // An hour asleep, then the data stops for longer than SLEEP_GAP_MAX_MIN.
+    sleep_stage_init();
+    for (; minute < 60; minute++)
+    {
+        sleep_stage_minute(DAY_START + minute * 60, 0, 0);
+    }
+    TEST_ASSERT(sleep_stage_current() != SLEEP_STAGE_NONE);
+
+    minute += SLEEP_GAP_MAX_MIN + 1;
+    sleep_stage_minute(DAY_START + minute * 60, 0, 0);
+    TEST_ASSERT_EQUAL(SLEEP_STAGE_NONE, sleep_stage_current());
+
+    while (sleep_record_get(&record))
+    {
+        TEST_ASSERT(record.stage != SLEEP_STAGE_WAKE);
+        TEST_ASSERT_EQUAL(0, record.heart_rate);
+        slept += record.minutes;
+    }
+    TEST_ASSERT(slept > 60 - SLEEP_ONSET_MIN - 5);
+    TEST_ASSERT(slept <= 60);
+
+    sleep_stage_stats_get(&stats);
+    TEST_ASSERT_EQUAL(1, stats.sessions);
+}
+
+
+static void test_record_encode(void)
+{
+    static uint8_t const  expected[SLEEP_RECORD_SIZE] = {0x65, 0x53, 0x2D, 0x3C, 0x01, 0x0E, SLEEP_STAGE_DEEP, 52};
+    sleep_record_st const record =
+    {
+        .utc        = 0x65532D3C,
+        .minutes    = 270,
+        .stage      = SLEEP_STAGE_DEEP,
+        .heart_rate = 52,
+    };
+    uint8_t               out[SLEEP_RECORD_SIZE];
+
+    TEST_ASSERT_EQUAL(SLEEP_RECORD_SIZE, sleep_record_encode(&record, out));
+    TEST_ASSERT_MEMORY(expected, out, SLEEP_RECORD_SIZE);
+}
+
+
+int main(void)
+{
+    test_nights();
+    test_gap_ends_sleep();
+    test_record_encode();
+    TEST_EXIT();
+}
@@ -0,0 +1,351 @@
+/* Host test of the step counter of source/step_counter.c.
+ *
+ * Feeds labelled synthetic traces at the motion block rate: walking, running, random arm
+ * motion with no steps, and short walks broken by pauses. Each step is a half sine push
+ * followed by a longer, smaller pull back, with jitter on the step interval and noise on
+ * every axis. Checks the count against the number of steps in the trace, the minute records
+ * and their encoding, the activity of still and moving minutes, and the day rollover. Then
+ * prints the cost per sample.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "unit_test.h"
+#include "step_counter.h"
+
+#define DAY_START           (1700006400)    // A local midnight.
+#define BENCH_BLOCKS        (400000)
+#define ARRAY_SIZE(a)       (sizeof(a) / sizeof((a)[0]))
+
+
+typedef enum
+{
+    SEGMENT_STILL,
+    SEGMENT_STEPS,
+    SEGMENT_ARM,                            // Random motion, no steps.
+} segment_kind_t;
+
+typedef struct
+{
+    uint32_t       seconds;
+    segment_kind_t kind;
+    double         step_hz;
+    double         amplitude_g;
+} segment_t;
+
+typedef struct
+{
+    uint32_t steps;                         // Steps in the trace.
+    uint32_t counted;
+    uint32_t records;
+    uint32_t run_records;
+    uint32_t record_steps;
+    uint8_t  last_cadence;
+} trace_result_t;
+
+
+static uint32_t m_seed;
+
+
+// Same numbers on every host, unlike rand().
+static double uniform(void)
+{
+    m_seed = m_seed * 1664525 + 1013904223;
+    return ((m_seed >> 8) + 1.0) / (double)(1 << 24);
+}
+
+
+static double gaussian(void)
+{
+    double const u = uniform();
+    double const v = uniform();
+
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+
+// Takes the minute records as the main loop does, after each block.
+static void records_drain(trace_result_t * p_result)
+{
+    step_record_st record;
+
+    while (step_record_get(&record))
+    {
+        p_result->records++;
+        p_result->record_steps += record.steps;
+        p_result->last_cadence  = record.cadence;
+        if (record.type == STEP_TYPE_RUN)
+        {
+            p_result->run_records++;
+        }
+        TEST_ASSERT(record.utc % 60 == 0);
+        TEST_ASSERT(record.steps > 0);
+    }
+}
+
+
+static void trace_run(segment_t const * p_segments, uint32_t count, uint32_t start, trace_result_t * p_result)
+{
+    motion_sample_st block[MOTION_BLOCK_SAMPLES];
+    uint32_t         sec   = start;
+    uint32_t         k     = 0;
+    double           phase = 0;
+
+    m_seed = 1;
+    step_counter_init();
+    memset(p_result, 0, sizeof(*p_result));
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        segment_t const * p_seg = &p_segments[i];
+
+        for (uint32_t n = 0; n < p_seg->seconds * MOTION_ODR_HZ; n++)
+        {
+            double a = 0;
+
+            if (p_seg->kind == SEGMENT_STEPS)
+            {
+                double const previous = phase;
+                double       ph;
+
+                phase += p_seg->step_hz * (1 + 0.05 * gaussian()) / MOTION_ODR_HZ;
+                if (floor(phase) > floor(previous))
+                {
+                    p_result->steps++;
+                }
+                ph = phase - floor(phase);
+                a  = p_seg->amplitude_g * ((ph < 0.3) ? sin(ph / 0.3 * M_PI) : -0.3 * sin((ph - 0.3) / 0.7 * M_PI));
+            }
+            else if (p_seg->kind == SEGMENT_ARM)
+            {
+                a = p_seg->amplitude_g * gaussian();
+            }
+
+            block[k].x = (int16_t)(1000 * (0.20 * (1 + a) + 0.02 * gaussian()));
+            block[k].y = (int16_t)(1000 * (0.30 * (1 + a) + 0.02 * gaussian()));
+            block[k].z = (int16_t)(1000 * (0.93 * (1 + a) + 0.02 * gaussian()));
+
+            if (++k == MOTION_BLOCK_SAMPLES)
+            {
+                step_counter_process(block, MOTION_BLOCK_SAMPLES, sec++);
+                records_drain(p_result);
+                k = 0;
+            }
+        }
+    }
+
+    // Two minutes later: the last minute closes.
+    step_counter_process(block, 0, sec + 120);
+    records_drain(p_result);
+    p_result->counted = step_counter_today();
+}
+
+
+// Count within permille of the steps in the trace.
+static void count_check(trace_result_t const * p_result, uint32_t permille)
+{
+    uint32_t const error = (p_result->counted > p_result->steps) ? p_result->counted - p_result->steps
+                                                                 : p_result->steps - p_result->counted;
+
+    TEST_ASSERT(error * 1000 <= p_result->steps * permille);
+}
+
+
+static void test_walk_and_run(void)
+{
+    static segment_t const walk[] =
+    {
+        { 30, SEGMENT_STILL, 0,   0    },
+        {300, SEGMENT_STEPS, 1.8, 0.25 },
+        { 20, SEGMENT_STILL, 0,   0    },
+        {300, SEGMENT_STEPS, 1.6, 0.15 },
+        { 60, SEGMENT_STILL, 0,   0    },
+    };
+    static segment_t const run[] =
+    {
+        { 20, SEGMENT_STILL, 0,   0    },
+        {300, SEGMENT_STEPS, 2.8, 0.9  },
+        { 30, SEGMENT_STILL, 0,   0    },
+    };
+    trace_result_t result;
+    step_stats_st  stats;
+
+    trace_run(walk, ARRAY_SIZE(walk), DAY_START, &result);
+    printf("walk   steps %4u  counted %4u  records %2u\n", result.steps, result.counted, result.records);
+    count_check(&result, 20);
+    TEST_ASSERT_EQUAL(result.counted, result.record_steps);
+    TEST_ASSERT_EQUAL(0, result.run_records);
+    TEST_ASSERT(result.last_cadence > 85 && result.last_cadence < 110);     // 1.6 Hz is 96 steps/min.
+
+    trace_run(run, ARRAY_SIZE(run), DAY_START, &result);
+    printf("run    steps %4u  counted %4u  records %2u\n", result.steps, result.counted, result.records);
+    count_check(&result, 20);
+    TEST_ASSERT_EQUAL(result.counted, result.record_steps);
+    TEST_ASSERT_EQUAL(result.records, result.run_records);
+    TEST_ASSERT(result.last_cadence > 155 && result.last_cadence < 180);    // 2.8 Hz is 168 steps/min.
+
+    step_counter_stats_get(&stats);
+    TEST_ASSERT_EQUAL(result.counted, stats.steps);
+    TEST_ASSERT_EQUAL(result.records, stats.records);
+    TEST_ASSERT_EQUAL(0, stats.records_lost);
+    TEST_ASSERT_EQUAL((20 + 300 + 30) * MOTION_ODR_HZ, stats.samples);
+}
+
+
+static void test_no_steps(void)
+{
+    static segment_t const arm[] =
+    {
+        {600, SEGMENT_ARM, 0, 0.08},
+    };
+    static segment_t const mixed[] =
+    {
+        { 60, SEGMENT_STEPS, 1.9, 0.3  },
+        {  5, SEGMENT_STILL, 0,   0    },
+        {  8, SEGMENT_STEPS, 1.8, 0.3  },
+        { 60, SEGMENT_ARM,   0,   0.05 },
+        {120, SEGMENT_STEPS, 2.2, 0.5  },
+    };
+    trace_result_t result;
+    step_stats_st  stats;
+
+    // Ten minutes of arm motion with no rhythm: most peaks fail the cadence check, and fewer
+    // than three steps a minute get through.
+    trace_run(arm, ARRAY_SIZE(arm), DAY_START, &result);
+    step_counter_stats_get(&stats);
+    printf("arm    steps %4u  counted %4u  peaks %u, rejected %u\n",
+           result.steps, result.counted, stats.peaks, stats.rejected);
+    TEST_ASSERT_EQUAL(0, result.steps);
+    TEST_ASSERT(result.counted < 30);
+    TEST_ASSERT(stats.rejected * 10 > stats.peaks * 9);
+
+    // A few steps between pauses and arm motion.
+    trace_run(mixed, ARRAY_SIZE(mixed), DAY_START, &result);
+    printf("mixed  steps %4u  counted %4u\n", result.steps, result.counted);
+    count_check(&result, 30);
+}
+
+
+static void test_record_encode(void)
+{
+    static uint8_t const expected[STEP_RECORD_SIZE] = {0x65, 0x53, 0x2D, 0x3C, 0x01, 0x02, 166, STEP_TYPE_RUN};
+    step_record_st const record =
+    {
+        .utc     = 0x65532D3C,
+        .steps   = 0x0102,
+        .cadence = 166,
+        .type    = STEP_TYPE_RUN,
+    };
+    uint8_t              out[STEP_RECORD_SIZE];
+
+    TEST_ASSERT_EQUAL(STEP_RECORD_SIZE, step_record_encode(&record, out));
+    TEST_ASSERT_MEMORY(expected, out, STEP_RECORD_SIZE);
+}
+
+
+static void test_minute_activity(void)
+{
+    motion_sample_st block[MOTION_BLOCK_SAMPLES] = {{0}};
+    uint32_t         utc;
+    uint16_t         activity;
+    uint32_t         minutes = 0;
+
+    // A still minute, a minute of 300 mg swings and another still minute. Every minute gets an
+    // activity count, moving or not.
+    step_counter_init();
+    for (uint32_t sec = DAY_START; sec < DAY_START + 180; sec++)
+    {
+        bool const moving = (sec >= DAY_START + 60) && (sec < DAY_START + 120);
+
+        for (uint32_t k = 0; k < MOTION_BLOCK_SAMPLES; k++)
+        {
+            double const t = (double)((sec - DAY_START) * MOTION_ODR_HZ + k) / MOTION_ODR_HZ;
+
+            block[k].z = (int16_t)(1000 + (moving ? 300 * sin(2 * M_PI * 1.8 * t) : 0));
+        }
+        step_counter_process(block, MOTION_BLOCK_SAMPLES, sec);
+        if (step_minute_activity_get(&utc, &activity))
+        {
+            TEST_ASSERT_EQUAL(DAY_START + minutes * 60, utc);
+            if (minutes == 0)
+            {
+                TEST_ASSERT_EQUAL(0, activity);
+            }
+            else
+            {
+                TEST_ASSERT(activity > 1000);
+            }
+            minutes++;
+        }
+    }
+    TEST_ASSERT_EQUAL(2, minutes);
+
+    // The third minute closes with the next block, and is handed out once.
+    step_counter_process(block, 0, DAY_START + 180);
+    TEST_ASSERT(step_minute_activity_get(&utc, &activity));
+    TEST_ASSERT_EQUAL(DAY_START + 120, utc);
+    TEST_ASSERT(activity < 1000);
+    TEST_ASSERT(!step_minute_activity_get(&utc, &activity));
+}
+
+
+static void test_day_rollover(void)
+{
+    static segment_t const walk[] =
+    {
+        {120, SEGMENT_STEPS, 1.8, 0.25},
+    };
+    motion_sample_st block[MOTION_BLOCK_SAMPLES] = {{0}};
+    trace_result_t   result;
+
+    // Walking across midnight: the total starts over, the records keep every step.
+    trace_run(walk, ARRAY_SIZE(walk), DAY_START - 60, &result);
+    TEST_ASSERT(result.counted > 0);
+    TEST_ASSERT(result.counted < result.record_steps);
+    count_check(&(trace_result_t){ .steps = result.steps, .counted = result.record_steps }, 20);
+
+    step_counter_process(block, 0, DAY_START + 24 * 3600);
+    TEST_ASSERT_EQUAL(0, step_counter_today());
+}
+
+
+static void bench_process(void)
+{
+    motion_sample_st block[MOTION_BLOCK_SAMPLES];
+    struct timespec  start;
+    struct timespec  end;
+    double           ns;
+
+    for (uint32_t i = 0; i < MOTION_BLOCK_SAMPLES; i++)
+    {
+        block[i].x = 200;
+        block[i].y = 300;
+        block[i].z = (int16_t)(900 + i * 10);
+    }
+
+    step_counter_init();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < BENCH_BLOCKS; i++)
+    {
+        step_counter_process(block, MOTION_BLOCK_SAMPLES, DAY_START + i);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / ((double)BENCH_BLOCKS * MOTION_BLOCK_SAMPLES);
+    printf("host %.1f ns/sample\n", ns);
+}
+
+
+int main(void)
+{
+    test_walk_and_run();
+    test_no_steps();
+    test_record_encode();
+    test_minute_activity();
+    test_day_rollover();
+    bench_process();
+    TEST_EXIT();
+}
@@ -0,0 +1,210 @@
+/* Host test of the RTC based clock of source/common/time.c.
+ *
+ * Checks the calendar conversions on known dates, on the last second of every month from 1970
+ * to 2106 and back, and the time zone offset. Then runs the LFCLK slow and fast on the
+ * simulated RTC1 of app_timer_host, with the phone time sent as whole seconds every day and a
+ * half. Checks that the error is learnt, that short spans and time changes are not learnt
+ * from, and that the drift stops at +-500 ppm either way. Prints the learnt drift and the
+ * error before a sync.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "unit_test.h"
+#include "app_timer_host.h"
+#include "time.h"
+
+#define TICKS_PER_SEC       (32768)
+#define DRIFT_ONE           (1 << 24)                   // Drift unit is 2^-24.
+#define DRIFT_MAX           (8388)                      // 500 ppm in that unit.
+#define SYNC_HOURS          (36)
+#define SYNCS               (20)
+#define SYNC_ERROR_MAX      (2.0)                       // Seconds: both times are truncated.
+#define TIMEZONE_UTC        (0x30)
+#define TIMEZONE_UTC8       (0x50)
+#define EPOCH               (1475280000)                // 2016-10-01 00:00
+
+
+static double m_phone_sec;                  // The time the phone would send.
+
+
+static double drift_ppm(void)
+{
+    return system_time_drift_get() * 1e6 / DRIFT_ONE;
+}
+
+
+static uint8_t month_days(uint32_t year, uint8_t month)
+{
+    static uint8_t const days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool const           leap     = ((year % 4 == 0) && (year % 100 != 0)) || (year % 400 == 0);
+
+    return days[month - 1] + ((month == 2) && leap);
+}
+
+
+// Lets the LFCLK count a number of its seconds, off by ppm, positive when it runs slow.
+static void lfclk_run(uint32_t seconds, double ppm)
+{
+    app_timer_host_run((uint64_t)seconds * TICKS_PER_SEC);
+    m_phone_sec += seconds * (1 + ppm * 1e-6);
+}
+
+
+static void phone_sync(void)
+{
+    system_sec_set((unsigned int)m_phone_sec);
+}
+
+
+// Runs and syncs, and returns the worst error before a sync over the second half.
+static double syncs_run(double ppm)
+{
+    double worst = 0;
+
+    for (uint32_t i = 0; i < SYNCS; i++)
+    {
+        double error;
+
+        lfclk_run(SYNC_HOURS * 3600, ppm);
+        error = (double)system_sec_get() - m_phone_sec;
+        error = (error < 0) ? -error : error;
+        if ((i >= SYNCS / 2) && (error > worst))
+        {
+            worst = error;
+        }
+        phone_sync();
+    }
+
+    printf("lfclk %+4.0f ppm: learnt %+6.1f ppm, worst error before a sync %5.2f s\n", ppm, drift_ppm(), worst);
+    return worst;
+}
+
+
+static void test_calendar(void)
+{
+    s_tm         tm = { .year = 2016, .month = 2, .day = 29, .hour = 23, .minute = 59, .second = 59 };
+    unsigned int sec;
+
+    system_timezone_set(TIMEZONE_UTC);
+    system_time_set(tm);
+    TEST_ASSERT_EQUAL(1456790399, system_sec_get());
+
+    memset(&tm, 0, sizeof(tm));
+    system_time_get(&tm);
+    TEST_ASSERT_EQUAL(2016, tm.year);
+    TEST_ASSERT_EQUAL(2, tm.month);
+    TEST_ASSERT_EQUAL(29, tm.day);
+    TEST_ASSERT_EQUAL(23, tm.hour);
+    TEST_ASSERT_EQUAL(59, tm.minute);
+    TEST_ASSERT_EQUAL(59, tm.second);
+    TEST_ASSERT_EQUAL(0, tm.weekdays);      // A Monday, Monday is 0.
+
+    // The last second that fits: 2106-02-07 06:28:15, a Sunday.
+    system_sec_set(0xFFFFFFFF);
+    system_time_get(&tm);
+    TEST_ASSERT_EQUAL(2106, tm.year);
+    TEST_ASSERT_EQUAL(2, tm.month);
+    TEST_ASSERT_EQUAL(7, tm.day);
+    TEST_ASSERT_EQUAL(6, tm.hour);
+    TEST_ASSERT_EQUAL(6, tm.weekdays);
+
+    // The last second of every month, and back.
+    for (uint32_t year = 1970; year < 2106; year++)
+    {
+        for (uint8_t month = 1; month <= 12; month++)
+        {
+            s_tm const start = { .year = year, .month = month, .day = 1 };
+
+            system_time_set(start);
+            sec = system_sec_get();
+            if (sec == 0)
+            {
+                continue;
+            }
+            system_sec_set(sec - 1);
+            system_time_get(&tm);
+            TEST_ASSERT_EQUAL((month == 1) ? year - 1 : year, tm.year);
+            TEST_ASSERT_EQUAL((month == 1) ? 12 : month - 1, tm.month);
+            TEST_ASSERT_EQUAL(month_days(tm.year, tm.month), tm.day);
+            TEST_ASSERT_EQUAL(59, tm.second);
+            system_time_set(tm);
+            TEST_ASSERT_EQUAL(sec - 1, system_sec_get());
+        }
+    }
+
+    // Dates out of range are ignored.
+    sec      = system_sec_get();
+    tm.month = 13;
+    system_time_set(tm);
+    TEST_ASSERT_EQUAL(sec, system_sec_get());
+
+    // The phone sends UTC; the time is kept local.
+    system_timezone_set(TIMEZONE_UTC8);
+    system_sec_set(EPOCH);
+    TEST_ASSERT_EQUAL(EPOCH + 8 * 3600, system_sec_get());
+    system_timezone_set(TIMEZONE_UTC);
+}
+
+
+static void test_drift(void)
+{
+    int32_t drift;
+
+    m_phone_sec = EPOCH;
+    phone_sync();
+    TEST_ASSERT_EQUAL(0, system_time_drift_get());
+
+    // A crystal a little slow: learnt to within the 1 s resolution of the syncs. Not
+    // corrected, the error would reach 4.8 s between syncs.
+    TEST_ASSERT(syncs_run(37) <= SYNC_ERROR_MAX);
+    TEST_ASSERT(drift_ppm() > 37 - 8 && drift_ppm() < 37 + 8);
+
+    // Too short a span to learn from.
+    drift = system_time_drift_get();
+    lfclk_run(6 * 3600, 37);
+    phone_sync();
+    TEST_ASSERT_EQUAL(drift, system_time_drift_get());
+
+    // The time set an hour forward is a change, not an error of the clock.
+    lfclk_run(SYNC_HOURS * 3600, 37);
+    m_phone_sec += 3600;
+    phone_sync();
+    TEST_ASSERT_EQUAL(drift, system_time_drift_get());
+
+    // Nor is a time set by hand the base to learn from.
+    {
+        s_tm tm;
+
+        system_time_get(&tm);
+        lfclk_run(SYNC_HOURS * 3600, 37);
+        system_time_set(tm);
+        lfclk_run(SYNC_HOURS * 3600, 37);
+        phone_sync();
+        TEST_ASSERT_EQUAL(drift, system_time_drift_get());
+    }
+
+    // Beyond 500 ppm the drift stops at the bound, either way. The rate is changed by less
+    // than the 1000 ppm that counts as a time change.
+    syncs_run(900);
+    TEST_ASSERT_EQUAL(DRIFT_MAX, system_time_drift_get());
+    syncs_run(-400);
+    TEST_ASSERT(drift_ppm() > -400 - 8 && drift_ppm() < -400 + 8);
+    syncs_run(-900);
+    TEST_ASSERT_EQUAL(-DRIFT_MAX, system_time_drift_get());
+
+    // And is learnt back from there.
+    TEST_ASSERT(syncs_run(-120) <= SYNC_ERROR_MAX);
+    TEST_ASSERT(drift_ppm() > -120 - 8 && drift_ppm() < -120 + 8);
+}
+
+
+int main(void)
+{
+    app_timer_host_reset();
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, system_time_init());
+    test_calendar();
+    test_drift();
+    TEST_EXIT();
+}
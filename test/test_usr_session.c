@@ -0,0 +1,229 @@
+/* Host test of the login session cache of source/usr_session.c.
+ *
+ * Plays the LifeSense login handshake against a scripted app, with the reply one round trip
+ * after each login packet, on the app_timer stand-in. Checks that sessions are kept per phone,
+ * by bond or by address, that the token is only sent to an app that declared it accepts it,
+ * and that an app which does not answer a resume falls back to the full login. Then prints
+ * the time to DATA_STATUE of each case.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "unit_test.h"
+#include "app_timer_host.h"
+#include "channel_select.h"
+#include "usr_session.h"
+
+#define ROUND_TRIP_MS       (90)    // Three connection events at 30 ms.
+#define STEP_MS             (10)
+#define GIVE_UP_MS          (10000)
+#define MS_TO_TICKS(ms)     (((uint64_t)(ms) * APP_TIMER_CLOCK_FREQ) / 1000)
+
+
+// What channel_select.c and time.c provide on target.
+link_ctx_st               g_link[LINK_MAX];
+communication_statue_st * g_communication_statue = &g_link[0].statue;
+trans_evt_st            * g_trans_evt_hander     = &g_link[0].evt;
+static uint8_t            m_timezone;
+
+uint8_t link_current(void)
+{
+    return 0;
+}
+
+uint16_t link_conn_handle(uint8_t index)
+{
+    return g_link[index].conn_handle;
+}
+
+void system_timezone_set(unsigned char timezone)
+{
+    m_timezone = timezone;
+}
+
+
+typedef enum
+{
+    APP_OLD,            // Login reply of 6 bytes, does not know the token.
+    APP_RESUME,         // Declares USR_SESSION_CAP_RESUME and answers the token.
+    APP_SILENT,         // Declares it, but a later version ignores packets with a token.
+} app_kind_t;
+
+typedef struct
+{
+    uint32_t ready_ms;
+    uint8_t  round_trips;
+    bool     cached;
+    bool     token_sent;
+    uint32_t token;
+} login_result_t;
+
+
+static uint16_t m_conn_handle;
+
+
+static void connect(uint8_t addr, uint8_t bond_id)
+{
+    memset(&g_link[0], 0, sizeof(g_link[0]));
+    g_link[0].conn_handle            = ++m_conn_handle;
+    g_link[0].peer_addr.addr_type    = BLE_GAP_ADDR_TYPE_RANDOM_STATIC;
+    g_link[0].peer_addr.addr[0]      = addr;
+    g_link[0].bond_id                = bond_id;
+}
+
+
+// Indication enabled, then login packets and replies until DATA_STATUE, as app_trans.c runs it.
+static login_result_t login(app_kind_t app, uint8_t timezone)
+{
+    login_result_t result = {0};
+    uint32_t       reply_in = 0;
+    bool           waiting = false;
+    usr_session_stats_st stats;
+
+    g_trans_evt_hander->bit.lifesense_login_bit_0 = 1;
+    result.cached = usr_session_begin(LIFESENSE_APP);
+
+    for (uint32_t t = 0; t < GIVE_UP_MS; t += STEP_MS)
+    {
+        usr_session_timeout_check();
+
+        if (g_trans_evt_hander->bit.lifesense_login_bit_0)
+        {
+            // usr_lifesense_login_evt: the token goes after the MD5 when resuming.
+            bool const token = usr_session_resuming();
+
+            g_trans_evt_hander->bit.lifesense_login_bit_0 = 0;
+            usr_session_request_sent();
+            result.token_sent |= token;
+            result.token       = token ? usr_session_token() : result.token;
+            waiting  = !(token && (app == APP_SILENT));
+            reply_in = ROUND_TRIP_MS;
+        }
+
+        if (waiting && (reply_in <= STEP_MS))
+        {
+            uint8_t const cap = (app == APP_OLD) ? 0 : USR_SESSION_CAP_RESUME;
+
+            app_timer_host_run(MS_TO_TICKS(reply_in));
+            usr_session_reply();
+            usr_session_save(LIFESENSE_APP, IOS_TYPE, timezone, 0x12345678, cap);
+            usr_session_ready();
+
+            usr_session_stats_get(&stats);
+            result.ready_ms    = stats.ready_ms;
+            result.round_trips = stats.round_trips;
+            return result;
+        }
+
+        reply_in -= waiting ? STEP_MS : 0;
+        app_timer_host_run(MS_TO_TICKS(STEP_MS));
+    }
+
+    TEST_ASSERT(false);
+    return result;
+}
+
+
+static void test_per_phone(void)
+{
+    login_result_t r;
+
+    // First login of phone 1, then a reconnect.
+    connect(1, LINK_BOND_NONE);
+    r = login(APP_RESUME, 8);
+    TEST_ASSERT(!r.cached);
+    TEST_ASSERT(!r.token_sent);
+
+    connect(1, LINK_BOND_NONE);
+    m_timezone = 0;
+    r = login(APP_RESUME, 8);
+    TEST_ASSERT(r.cached);
+    TEST_ASSERT(r.token_sent);
+    TEST_ASSERT_EQUAL(8, m_timezone);
+    TEST_ASSERT_EQUAL(IOS_TYPE, g_communication_statue->phone_type);
+    TEST_ASSERT_EQUAL(0x12345678, r.token);
+
+    // Another phone with the same app does not get phone 1's session.
+    connect(2, LINK_BOND_NONE);
+    r = login(APP_RESUME, 3);
+    TEST_ASSERT(!r.cached);
+
+    connect(1, LINK_BOND_NONE);
+    r = login(APP_RESUME, 8);
+    TEST_ASSERT(r.cached);
+    TEST_ASSERT_EQUAL(8, m_timezone);
+
+    // A bonded phone is found by its bond whatever address it connects with.
+    connect(3, 0);
+    r = login(APP_RESUME, 5);
+    TEST_ASSERT(!r.cached);
+    connect(4, 0);
+    r = login(APP_RESUME, 5);
+    TEST_ASSERT(r.cached);
+
+    // With the cache full, the phone used longest ago goes.
+    for (uint8_t addr = 10; addr < 10 + USR_SESSION_CACHE_SIZE; addr++)
+    {
+        connect(addr, LINK_BOND_NONE);
+        (void)login(APP_RESUME, 1);
+    }
+    connect(1, LINK_BOND_NONE);
+    r = login(APP_RESUME, 8);
+    TEST_ASSERT(!r.cached);
+}
+
+
+static void test_token_needs_capability(void)
+{
+    usr_session_stats_st before;
+    usr_session_stats_st after;
+    login_result_t       full;
+    login_result_t       old;
+    login_result_t       resumed;
+    login_result_t       silent;
+
+    usr_session_stats_get(&before);
+
+    connect(20, LINK_BOND_NONE);
+    full = login(APP_OLD, 8);
+
+    // An app without the capability gets the full login packet, and answers it at once.
+    connect(20, LINK_BOND_NONE);
+    old = login(APP_OLD, 8);
+    TEST_ASSERT(old.cached);
+    TEST_ASSERT(!old.token_sent);
+    TEST_ASSERT_EQUAL(1, old.round_trips);
+    TEST_ASSERT(old.ready_ms < USR_SESSION_RESUME_TIMEOUT);
+
+    connect(21, LINK_BOND_NONE);
+    (void)login(APP_RESUME, 8);
+    connect(21, LINK_BOND_NONE);
+    resumed = login(APP_RESUME, 8);
+    TEST_ASSERT(resumed.token_sent);
+    TEST_ASSERT_EQUAL(1, resumed.round_trips);
+
+    // An app which stops answering the token costs the timeout once, then the full login.
+    connect(21, LINK_BOND_NONE);
+    silent = login(APP_SILENT, 8);
+    TEST_ASSERT(silent.token_sent);
+    TEST_ASSERT(silent.ready_ms >= USR_SESSION_RESUME_TIMEOUT + ROUND_TRIP_MS);
+
+    usr_session_stats_get(&after);
+    TEST_ASSERT_EQUAL(1, after.fallbacks - before.fallbacks);
+
+    printf("login                          round trips  ms to data\n");
+    printf("first login                    %11u  %10u\n", full.round_trips, full.ready_ms);
+    printf("reconnect, app without token   %11u  %10u\n", old.round_trips, old.ready_ms);
+    printf("reconnect, app with token      %11u  %10u\n", resumed.round_trips, resumed.ready_ms);
+    printf("token sent, no answer          %11u  %10u\n", silent.round_trips, silent.ready_ms);
+}
+
+
+int main(void)
+{
+    app_timer_host_reset();
+    test_per_phone();
+    test_token_needs_capability();
+    TEST_EXIT();
+}
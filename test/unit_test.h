@@ -0,0 +1,62 @@
+/* Copyright (c) 2016 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is property of Nordic Semiconductor ASA.
+ * Terms and conditions of usage are described in detail in NORDIC
+ * SEMICONDUCTOR STANDARD SOFTWARE LICENSE AGREEMENT.
+ *
+ * Licensees are granted free, non-transferable use of the information. NO
+ * WARRANTY of ANY KIND is provided. This heading must NOT be removed from
+ * the file.
+ *
+ */
+
+/** @file
+ *
+ * @brief Minimal assertions for the host tests.
+ *
+ * @details Each test is one executable. Failed assertions are printed and counted, and
+ *          @ref TEST_EXIT returns the count to ctest.
+ */
+
+#ifndef UNIT_TEST_H__
+#define UNIT_TEST_H__
+
+#include <stdio.h>
+#include <string.h>
+
+static int m_test_failures;
+
+#define TEST_ASSERT(cond)                                                       \
+    do                                                                          \
+    {                                                                           \
+        if (!(cond))                                                            \
+        {                                                                       \
+            printf("%s:%d: FAIL: %s\n", __FILE__, __LINE__, #cond);             \
+            m_test_failures++;                                                  \
+        }                                                                       \
+    } while (0)
+
+#define TEST_ASSERT_EQUAL(expected, actual)                                     \
+    do                                                                          \
+    {                                                                           \
+        long long e__ = (long long)(expected);                                  \
+        long long a__ = (long long)(actual);                                    \
+        if (e__ != a__)                                                         \
+        {                                                                       \
+            printf("%s:%d: FAIL: %s == %lld, expected %lld\n",                  \
+                   __FILE__, __LINE__, #actual, a__, e__);                      \
+            m_test_failures++;                                                  \
+        }                                                                       \
+    } while (0)
+
+#define TEST_ASSERT_MEMORY(expected, actual, length)                            \
+    TEST_ASSERT(memcmp((expected), (actual), (length)) == 0)
+
+#define TEST_EXIT()                                                             \
+    do                                                                          \
+    {                                                                           \
+        printf("%s: %s\n", __FILE__, m_test_failures ? "FAILED" : "passed");    \
+        return m_test_failures ? 1 : 0;                                         \
+    } while (0)
+
+#endif // UNIT_TEST_H__